@@ -4,13 +4,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <netinet/in.h>
+#include "dhcp_common.h"
+#include "host_table.h"
 
 #define MAX_SUBNETS 32
-#define MAX_HOSTS_PER_SUBNET 128
 #define MAX_DNS_SERVERS 4
 #define MAX_NTP_SERVERS 4
 #define MAX_NETBIOS_SERVERS 4
-#define MAX_HOSTNAME_LENGTH 256
 #define MAX_DOMAIN_LENGTH 256
 
 typedef enum ddns_update_style_t
@@ -36,6 +36,20 @@ const char *ddns_update_style_to_string(ddns_update_style_t style);
  */
 ddns_update_style_t ddns_update_style_from_string(const char *str);
 
+#define LEASE_IO_DEFAULT_QUEUE_SIZE 4096 // Lease I/O ring slots (rounded up to a power of two)
+#define LEASE_IO_MAX_QUEUE_SIZE (1u << 20)
+
+/**
+ * @brief What a packet worker does when the lease I/O ring is full.
+ */
+typedef enum lease_io_backpressure_t
+{
+    LEASE_IO_BLOCK = 0, // Wait for the I/O thread to free a slot
+    LEASE_IO_COALESCE,  // Set the newest update per IP aside until the ring drains (block when that is full too)
+    LEASE_IO_DROP,      // Count the update as dropped and continue
+    LEASE_IO_BACKPRESSURE_UNKNOWN
+} lease_io_backpressure_t;
+
 struct dhcp_global_options_t
 {
     bool authoritative;    // false by default
@@ -70,14 +84,15 @@ struct dhcp_global_options_t
     bool allow_bootp;           // Allow BOOTP requests (default: true)
 
     bool update_conflict_detection; // false by default
-};
 
-struct dhcp_host_reservation_t
-{
-    char name[MAX_HOSTNAME_LENGTH];
-    uint8_t mac_address[6];
-    struct in_addr fixed_address;
-    char hostname[MAX_HOSTNAME_LENGTH];
+    // Packet worker model
+    uint32_t worker_threads;  // Number of packet workers (default: 4)
+    bool worker_reuseport;    // One SO_REUSEPORT socket and receive loop per worker (default: false)
+    bool worker_cpu_affinity; // Pin worker i to CPU (i % online CPUs) (default: false)
+
+    // Lease persistence queue
+    uint32_t lease_io_queue_size;                 // Ring slots (default: LEASE_IO_DEFAULT_QUEUE_SIZE)
+    lease_io_backpressure_t lease_io_backpressure; // Full-ring policy (default: coalesce)
 };
 
 struct dhcp_subnet_t
@@ -115,9 +130,13 @@ struct dhcp_subnet_t
     uint32_t renewal_time;   // DHCP option 58 (0 means use global)
     uint32_t rebinding_time; // DHCP option 59 (0 means use global)
 
-    // Host reservation
-    struct dhcp_host_reservation_t hosts[MAX_HOSTS_PER_SUBNET];
+    // Host reservations: this subnet's run of host_table->hosts
+    struct dhcp_host_reservation_t *hosts;
     uint32_t host_count;
+    const struct dhcp_host_table_t *host_table;
+
+    // Reply options above, encoded once by parse_config_file()
+    struct dhcp_option_template_t reply_template;
 };
 
 struct dhcp_config_t
@@ -125,6 +144,7 @@ struct dhcp_config_t
     struct dhcp_global_options_t global;
     struct dhcp_subnet_t subnets[MAX_SUBNETS];
     uint32_t subnet_count;
+    struct dhcp_host_table_t host_table; // Reservations of every subnet
 };
 
 // -----------------------------------------------------------------
@@ -159,13 +179,4 @@ void print_config(const struct dhcp_config_t *config);
  */
 struct dhcp_subnet_t *find_subnet_for_ip(const struct dhcp_config_t *config, const struct in_addr ip);
 
-/**
- * @brief Find a host reservation by MAC address within a subnet.
- * @param subnet Pointer to dhcp_subnet_t structure.
- * @param mac MAC address to search for (6 bytes).
- * @return Pointer to dhcp_host_reservation_t if found,
- *         NULL if subnet or mac is NULL, or no matching host is found
- */
-struct dhcp_host_reservation_t *find_host_by_mac(const struct dhcp_subnet_t *subnet, const uint8_t mac[6]);
-
 #endif // CONFIG_V4_H
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef CONFIG_VERSION_H
+#define CONFIG_VERSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_v4.h"
+#include "ip_pool.h"
+#include "lease_v4.h"
+#include "subnet_trie.h"
+
+/**
+ * @brief One generation of the server configuration.
+ *
+ * Everything a packet is handled with: the parsed configuration (with its
+ * encoded reply templates), one pool per subnet and the subnet index. The
+ * server publishes the current generation through an atomic pointer; packet
+ * workers read it inside an epoch (see utils/epoch.h), and a reload builds
+ * the next generation beside it, publishes it, waits out the readers of the
+ * previous one and frees that.
+ *
+ * A subnet whose address plan (network, netmask, range, router) is unchanged
+ * keeps its pool across a reload, allocations and probes in flight included;
+ * the pool then belongs to the new generation. Other subnets get a new pool
+ * synced from the lease database.
+ */
+struct config_version_t
+{
+    uint64_t generation;
+    struct dhcp_config_t config;
+    struct ip_pool_t *pools[MAX_SUBNETS]; // pools[i] serves config.subnets[i]
+    bool owns_pool[MAX_SUBNETS];          // false once a newer generation took the pool over
+    bool pool_rebuilt[MAX_SUBNETS];       // Built for this generation rather than carried over
+    int pool_count;
+    struct subnet_trie_t subnet_trie;
+};
+
+/**
+ * @brief Parse a configuration file into a new generation (no pools yet).
+ * @param filename Path to the configuration file.
+ * @return The new generation, or NULL if the file cannot be parsed.
+ */
+struct config_version_t *config_version_load(const char *filename);
+
+/**
+ * @brief Give a new generation its pools.
+ * @param next Generation from config_version_load().
+ * @param current Generation being replaced, or NULL at startup.
+ * @param lease_db Lease database the pools are synced with.
+ * @return 0 on success, -1 on failure (current is left untouched).
+ *
+ * Pools of unchanged subnets are taken over from current and switched to
+ * their new subnet definitions (ip_pool_update_subnet()) as the last step,
+ * once nothing can fail any more. current stays usable by its readers.
+ * New pools are filled from the lease database one shard at a time
+ * (ip_pool_sync_with_leases()), so workers are never blocked on the whole
+ * database; an address that current's pools hand out meanwhile cannot be
+ * committed over by next's (ip_pool_commit_lease()).
+ */
+int config_version_attach_pools(struct config_version_t *next, struct config_version_t *current,
+                                struct lease_database_t *lease_db);
+
+/**
+ * @brief Sync the newly built pools of a generation with the lease database again.
+ * @param version Published generation.
+ * @param lease_db Lease database.
+ *
+ * Called once readers of the previous generation are gone, to pick up leases
+ * that were committed through the old pools while the new ones were built.
+ */
+void config_version_resync(struct config_version_t *version, struct lease_database_t *lease_db);
+
+/**
+ * @brief Free a generation and the pools it still owns.
+ * @param version Generation to free (may be NULL).
+ */
+void config_version_free(struct config_version_t *version);
+
+#endif // CONFIG_VERSION_H
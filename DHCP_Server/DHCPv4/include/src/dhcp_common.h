@@ -9,6 +9,8 @@
 
 #define DHCP_MAGIC_COOKIE 0x63825363
 
+#define DHCP_BOOTP_MIN_LEN 300 // Smallest BOOTP message relays and old clients accept (RFC 1542)
+
 /* DHCP Message Types (Option 53) */
 #define DHCP_DISCOVER 1
 #define DHCP_OFFER 2
@@ -22,11 +24,14 @@
 /* DHCP Options */
 #define DHCP_OPT_PAD 0
 #define DHCP_OPT_SUBNET_MASK 1
+#define DHCP_OPT_TIME_OFFSET 2
 #define DHCP_OPT_ROUTER 3
 #define DHCP_OPT_DNS_SERVERS 6
 #define DHCP_OPT_HOST_NAME 12
 #define DHCP_OPT_DOMAIN_NAME 15
 #define DHCP_OPT_BROADCAST_ADDR 28
+#define DHCP_OPT_NTP_SERVERS 42
+#define DHCP_OPT_NETBIOS_SERVERS 44
 #define DHCP_OPT_REQUESTED_IP 50
 #define DHCP_OPT_LEASE_TIME 51
 #define DHCP_OPT_MESSAGE_TYPE 53
@@ -35,6 +40,8 @@
 #define DHCP_OPT_RENEWAL_TIME 58
 #define DHCP_OPT_REBINDING_TIME 59
 #define DHCP_OPT_CLIENT_ID 61
+#define DHCP_OPT_TFTP_SERVER_NAME 66
+#define DHCP_OPT_BOOTFILE_NAME 67
 #define DHCP_OPT_END 255
 
 /* BootP op codes */
@@ -64,4 +71,21 @@ struct dhcp_packet
     uint8_t options[312];  /* Optional parameters field. reference to magic cookie is first 4 bytes */
 };
 
+/**
+ * @brief Pre-encoded reply for one subnet (see dhcp_message_build_template()).
+ *
+ * packet is a complete BOOTREPLY: header fields shared by every client of
+ * the subnet (siaddr, file), the magic cookie, fixed slots for the per-lease
+ * options (message type, server id, lease time, T1, T2) and then the subnet
+ * options, encoded once and terminated by END. option_offset[] locates each
+ * subnet option inside packet.options so replies can copy just the ones a
+ * client asks for.
+ */
+struct dhcp_option_template_t
+{
+    struct dhcp_packet packet;
+    uint16_t options_len;        // Bytes of packet.options in use, END included
+    uint16_t option_offset[256]; // Offset of option code in packet.options (0 = not configured)
+};
+
 #endif // DHCP_COMMON_H
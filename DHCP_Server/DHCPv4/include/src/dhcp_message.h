@@ -3,6 +3,7 @@
 
 #include "config_v4.h"
 #include "dhcp_common.h"
+#include "dhcp_options.h"
 #include "lease_v4.h"
 #include <netinet/in.h>
 #include <stdint.h>
@@ -42,26 +43,52 @@ int dhcp_message_add_option32(struct dhcp_packet *packet, uint8_t option_code, u
  */
 int dhcp_message_add_option_ip(struct dhcp_packet *packet, uint8_t option_code, struct in_addr ip);
 
+/**
+ * @brief Encode a subnet's reply options into its template.
+ * @param tpl Template to fill.
+ * @param subnet Subnet configuration (global fallbacks already applied).
+ * @return 0 on success, -1 if some options did not fit (they are left out).
+ *
+ * Called once per subnet when the configuration is loaded. OFFER and ACK
+ * are then built from the template instead of option by option.
+ */
+int dhcp_message_build_template(struct dhcp_option_template_t *tpl, const struct dhcp_subnet_t *subnet);
+
 /**
  * @brief Encapsulate a DHCPOFFER message.
  * @param offer Pointer to offer packet to populate.
  * @param discover Pointer to received DHCPDISCOVER packet.
+ * @param discover_options Option index of the DISCOVER (see dhcp_options_parse()).
  * @param lease Pointer to lease being offered.
  * @param subnet Pointer to subnet configuration.
  * @param global_opts Pointer to global DHCP options.
+ *
+ * @return Number of bytes of offer to send (see dhcp_message_length()).
+ *
+ * Copies subnet->reply_template and fills in the per-lease fields. With a
+ * parameter request list (option 55) in the DISCOVER only the requested
+ * subnet options are included, in the order requested. Bytes of offer past
+ * the returned length are left undefined.
  */
-void dhcp_message_make_offer(struct dhcp_packet *offer, const struct dhcp_packet *discover, struct dhcp_lease_t *lease,
+size_t dhcp_message_make_offer(struct dhcp_packet *offer, const struct dhcp_packet *discover,
+                             const struct dhcp_option_index_t *discover_options, struct dhcp_lease_t *lease,
                              struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts);
 
 /**
  * @brief Encapsulate a DHCPACK message.
  * @param ack Pointer to ACK packet to populate.
  * @param request Pointer to received DHCPREQUEST packet.
+ * @param request_options Option index of the REQUEST (see dhcp_options_parse()).
  * @param lease Pointer to lease being acknowledged.
  * @param subnet Pointer to subnet configuration.
  * @param global_opts Pointer to global DHCP options.
+ *
+ * @return Number of bytes of ack to send.
+ *
+ * Built from subnet->reply_template like dhcp_message_make_offer().
  */
-void dhcp_message_make_ack(struct dhcp_packet *ack, const struct dhcp_packet *request, struct dhcp_lease_t *lease,
+size_t dhcp_message_make_ack(struct dhcp_packet *ack, const struct dhcp_packet *request,
+                           const struct dhcp_option_index_t *request_options, struct dhcp_lease_t *lease,
                            struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts);
 
 /**
@@ -69,8 +96,18 @@ void dhcp_message_make_ack(struct dhcp_packet *ack, const struct dhcp_packet *re
  * @param nak Pointer to NAK packet to populate.
  * @param request Pointer to received DHCPREQUEST packet.
  * @param server_id Server identifier IP address.
+ * @return Number of bytes of nak to send.
+ */
+size_t dhcp_message_make_nak(struct dhcp_packet *nak, const struct dhcp_packet *request, struct in_addr server_id);
+
+/**
+ * @brief Number of bytes of a packet worth sending.
+ * @param packet Packet built with dhcp_message_init()/dhcp_message_add_option().
+ * @return Header plus options up to and including END, at least DHCP_BOOTP_MIN_LEN.
+ *
+ * The rest of the 312-byte options field is padding and is not transmitted.
  */
-void dhcp_message_make_nak(struct dhcp_packet *nak, const struct dhcp_packet *request, struct in_addr server_id);
+size_t dhcp_message_length(const struct dhcp_packet *packet);
 
 /**
  * @brief Validate a DHCP packet (magic cookie, etc.).
@@ -86,6 +123,9 @@ int dhcp_message_validate(struct dhcp_packet *packet, ssize_t len);
  * @param option_code Option code to extract.
  * @param out_len Pointer to store length of option data (can be NULL).
  * @return Pointer to option data or NULL if not found.
+ *
+ * One-off lookup that indexes the whole packet each time; for several
+ * lookups in a received packet use dhcp_options_parse() once instead.
  */
 uint8_t *dhcp_message_get_option(const struct dhcp_packet *packet, uint8_t option_code, uint8_t *out_len);
 
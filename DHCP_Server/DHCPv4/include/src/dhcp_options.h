@@ -0,0 +1,111 @@
+#ifndef DHCP_OPTIONS_H
+#define DHCP_OPTIONS_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "dhcp_common.h"
+
+#define DHCP_OPT_OVERLOAD 52
+
+#define DHCP_OVERLOAD_FILE 1  // Option 52 values: file carries options
+#define DHCP_OVERLOAD_SNAME 2 // sname carries options
+#define DHCP_OVERLOAD_BOTH 3
+
+/**
+ * @brief Where each option of a received packet is, found in one pass.
+ *
+ * offset[code] is the position of the option's data from the start of the
+ * struct dhcp_packet, so an index stays valid when the packet is copied along
+ * with it. offset/len are only meaningful for codes set in present: parsing
+ * clears that 32-byte mask, not the whole table. Options carried
+ * in sname/file through option overload are indexed like the others. When a
+ * code appears more than once the first instance is kept (an RFC 3396 split
+ * option is seen as its first part).
+ */
+struct dhcp_option_index_t
+{
+    uint64_t present[4]; // Bit per option code
+    uint16_t offset[256];
+    uint8_t len[256];
+    uint8_t overload; // Option 52 value, 0 if absent
+};
+
+/**
+ * @brief Index the options of a received packet.
+ * @param packet Received packet.
+ * @param len Bytes actually received into packet.
+ * @param idx Index to fill.
+ * @return 0 on success, -1 if the packet is too short, has no magic cookie,
+ *         or an option runs past the end of its area (idx then holds the
+ *         options found before it).
+ *
+ * Reads nothing beyond len bytes of packet: bytes after a short datagram are
+ * never looked at, whatever the buffer holds from an earlier packet.
+ */
+int dhcp_options_parse(const struct dhcp_packet *packet, ssize_t len, struct dhcp_option_index_t *idx);
+
+/**
+ * @brief Check whether a packet carries an option.
+ * @param idx Index from dhcp_options_parse().
+ * @param code Option code.
+ * @return true if the option is present.
+ */
+static inline bool dhcp_options_has(const struct dhcp_option_index_t *idx, uint8_t code)
+{
+    return (idx->present[code >> 6] >> (code & 63)) & 1;
+}
+
+/**
+ * @brief Look up an option.
+ * @param packet Packet the index was built from (or a copy of it).
+ * @param idx Index from dhcp_options_parse().
+ * @param code Option code.
+ * @param out_len Output: option length (may be NULL).
+ * @return Pointer to the option data, or NULL if the option is absent.
+ */
+static inline const uint8_t *dhcp_options_get(const struct dhcp_packet *packet, const struct dhcp_option_index_t *idx,
+                                              uint8_t code, uint8_t *out_len)
+{
+    if (!dhcp_options_has(idx, code))
+        return NULL;
+    if (out_len)
+        *out_len = idx->len[code];
+    return (const uint8_t *)packet + idx->offset[code];
+}
+
+/**
+ * @brief Look up a one-byte option (e.g. the message type).
+ * @param packet Packet the index was built from.
+ * @param idx Index from dhcp_options_parse().
+ * @param code Option code.
+ * @return The option's value, or 0 if it is absent or not one byte long.
+ */
+static inline uint8_t dhcp_options_get_u8(const struct dhcp_packet *packet, const struct dhcp_option_index_t *idx,
+                                          uint8_t code)
+{
+    return dhcp_options_has(idx, code) && idx->len[code] == 1 ? ((const uint8_t *)packet)[idx->offset[code]] : 0;
+}
+
+/**
+ * @brief Look up an IPv4 address option (requested IP, server id).
+ * @param packet Packet the index was built from.
+ * @param idx Index from dhcp_options_parse().
+ * @param code Option code.
+ * @param ip Output: the address (left untouched when not found).
+ * @return true if the option is present and exactly 4 bytes long.
+ */
+static inline bool dhcp_options_get_ip(const struct dhcp_packet *packet, const struct dhcp_option_index_t *idx,
+                                       uint8_t code, struct in_addr *ip)
+{
+    if (!dhcp_options_has(idx, code) || idx->len[code] != 4)
+        return false;
+    memcpy(&ip->s_addr, (const uint8_t *)packet + idx->offset[code], 4);
+    return true;
+}
+
+#endif // DHCP_OPTIONS_H
@@ -0,0 +1,97 @@
+#ifndef HOST_TABLE_H
+#define HOST_TABLE_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include "lease_index.h"
+#include "../utils/encoding_utils.h"
+
+#define MAX_HOSTNAME_LENGTH 256
+
+struct dhcp_config_t;
+struct dhcp_subnet_t;
+
+struct dhcp_host_reservation_t
+{
+    char name[MAX_HOSTNAME_LENGTH];
+    uint8_t mac_address[6];               // All zero: matched by client identifier only
+    uint8_t client_id[MAX_CLIENT_ID_LEN]; // option dhcp-client-identifier (Option 61)
+    uint32_t client_id_len;               // 0 = none
+    struct in_addr fixed_address;
+    char hostname[MAX_HOSTNAME_LENGTH];
+};
+
+/**
+ * @brief Host reservations of a whole configuration, hash-indexed.
+ *
+ * Every host block of every subnet lands in one array, grouped by subnet in
+ * file order; each subnet sees its own run of it (dhcp_subnet_t.hosts). Three
+ * indexes point into the array: by MAC, by client identifier and by fixed
+ * address, so a reservation lookup costs the same with ten hosts or a
+ * hundred thousand.
+ *
+ * The table is read-only once built, so lookups need no locking.
+ */
+struct dhcp_host_table_t
+{
+    struct dhcp_host_reservation_t *hosts;
+    uint32_t count;
+    uint32_t capacity;
+    struct lease_index_t by_mac;       // MAC -> hosts (a MAC may be reserved in several subnets)
+    struct lease_index_t by_client_id; // Client identifier -> hosts
+    struct lease_index_t by_address;   // Fixed address -> hosts
+};
+
+/**
+ * @brief Append a parsed host reservation, growing the array as needed.
+ * @param table Pointer to the table.
+ * @param host Reservation to copy in; it belongs to the subnet being parsed.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int host_table_append(struct dhcp_host_table_t *table, const struct dhcp_host_reservation_t *host);
+
+/**
+ * @brief Index the table and point every subnet at its run of hosts.
+ * @param table Pointer to the table, holding the hosts of config's subnets in order.
+ * @param config Configuration whose subnets' host_count add up to table->count.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int host_table_build(struct dhcp_host_table_t *table, struct dhcp_config_t *config);
+
+/**
+ * @brief Release the table.
+ * @param table Pointer to the table.
+ */
+void host_table_free(struct dhcp_host_table_t *table);
+
+/**
+ * @brief Find a host reservation by MAC address within a subnet.
+ * @param subnet Pointer to dhcp_subnet_t structure.
+ * @param mac MAC address to search for (6 bytes).
+ * @return Pointer to dhcp_host_reservation_t if found,
+ *         NULL if subnet or mac is NULL, or no matching host is found
+ */
+struct dhcp_host_reservation_t *find_host_by_mac(const struct dhcp_subnet_t *subnet, const uint8_t mac[6]);
+
+/**
+ * @brief Find a host reservation by client identifier (Option 61) within a subnet.
+ * @param subnet Pointer to dhcp_subnet_t structure.
+ * @param client_id Client identifier bytes.
+ * @param len Length of client_id.
+ * @return Pointer to dhcp_host_reservation_t if found,
+ *         NULL if subnet or client_id is NULL, len is 0, or no matching host is found
+ */
+struct dhcp_host_reservation_t *find_host_by_client_id(const struct dhcp_subnet_t *subnet, const uint8_t *client_id,
+                                                       uint32_t len);
+
+/**
+ * @brief Find the host reservation holding a fixed address within a subnet.
+ * @param subnet Pointer to dhcp_subnet_t structure.
+ * @param ip Fixed address to search for.
+ * @return Pointer to dhcp_host_reservation_t if found,
+ *         NULL if subnet is NULL or no host reserves ip
+ */
+struct dhcp_host_reservation_t *find_host_by_address(const struct dhcp_subnet_t *subnet, struct in_addr ip);
+
+#endif // HOST_TABLE_H
@@ -0,0 +1,105 @@
+#ifndef IP_BITMAP_H
+#define IP_BITMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define IP_BITMAP_MAX_LEVELS 6    // 64^6 > 2^32 bits
+#define IP_BITMAP_NONE 0xFFFFFFFFu // Returned when no bit is set
+
+/**
+ * @brief Hierarchical bitmap used by the IP pool to track free addresses.
+ *
+ * levels[0] holds one bit per address. Each word of levels[n + 1] has one
+ * bit per word of levels[n], set while that word is non-zero, up to a single
+ * top word. Finding the lowest set bit is one __builtin_ctzll per level
+ * (three levels for a /16, four for a /8); set and clear only touch the
+ * upper levels when a word becomes empty or non-empty.
+ *
+ * Lock-free: every word is updated with atomic read-modify-write, so many
+ * threads can set, clear and claim bits at once. A set bit in levels[0] is
+ * authoritative; the upper levels are hints kept conservative: a summary bit
+ * is never clear while its word holds set bits for longer than the clear
+ * that races with the set (the clearing thread re-checks the word and puts
+ * the bit back). A summary bit left set over an empty word is repaired by
+ * the next search that lands on it.
+ */
+struct ip_bitmap_t
+{
+    uint64_t *levels[IP_BITMAP_MAX_LEVELS];
+    uint32_t words[IP_BITMAP_MAX_LEVELS]; // Words per level
+    uint32_t depth;                       // Number of levels in use
+    uint32_t bits;                        // Number of addressable bits
+    uint32_t set_count;                   // Bits currently set (updated atomically)
+};
+
+/**
+ * @brief Allocate a bitmap with every bit clear.
+ * @param bm Pointer to the bitmap.
+ * @param bits Number of bits (at least 1).
+ * @return 0 on success, -1 on failure.
+ */
+int ip_bitmap_init(struct ip_bitmap_t *bm, uint32_t bits);
+
+/**
+ * @brief Release the bitmap storage.
+ * @param bm Pointer to the bitmap.
+ */
+void ip_bitmap_free(struct ip_bitmap_t *bm);
+
+/**
+ * @brief Set a bit (no-op if already set).
+ * @param bm Pointer to the bitmap.
+ * @param bit Bit number (< bits).
+ */
+void ip_bitmap_set(struct ip_bitmap_t *bm, uint32_t bit);
+
+/**
+ * @brief Clear a bit (no-op if already clear).
+ * @param bm Pointer to the bitmap.
+ * @param bit Bit number (< bits).
+ */
+void ip_bitmap_clear(struct ip_bitmap_t *bm, uint32_t bit);
+
+/**
+ * @brief Clear a bit and report whether this call cleared it.
+ * @param bm Pointer to the bitmap.
+ * @param bit Bit number (< bits).
+ * @return true if the bit was set and this call cleared it, false otherwise.
+ *
+ * Of several threads clearing the same bit, exactly one gets true: the pool
+ * uses it to take ownership of a free address without a lock.
+ */
+bool ip_bitmap_test_and_clear(struct ip_bitmap_t *bm, uint32_t bit);
+
+/**
+ * @brief Find the lowest set bit.
+ * @param bm Pointer to the bitmap.
+ * @return Bit number, or IP_BITMAP_NONE if the bitmap is empty.
+ *
+ * With concurrent writers the bit may already be clear when this returns;
+ * use ip_bitmap_claim_first() to find and take one.
+ */
+uint32_t ip_bitmap_find_first(struct ip_bitmap_t *bm);
+
+/**
+ * @brief Find the lowest set bit and clear it, atomically.
+ * @param bm Pointer to the bitmap.
+ * @return Bit number cleared by this call, or IP_BITMAP_NONE if the bitmap is empty.
+ *
+ * Retries the search when another thread claims the same bit first.
+ */
+uint32_t ip_bitmap_claim_first(struct ip_bitmap_t *bm);
+
+/**
+ * @brief Test a bit.
+ * @param bm Pointer to the bitmap.
+ * @param bit Bit number (< bits).
+ * @return true if the bit is set.
+ */
+static inline bool ip_bitmap_test(const struct ip_bitmap_t *bm, uint32_t bit)
+{
+    return (__atomic_load_n(&bm->levels[0][bit >> 6], __ATOMIC_ACQUIRE) >> (bit & 63)) & 1;
+}
+
+#endif // IP_BITMAP_H
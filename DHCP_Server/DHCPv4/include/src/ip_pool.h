@@ -2,6 +2,8 @@
 #define IP_POOL_H
 
 #include "config_v4.h"
+#include "ip_bitmap.h"
+#include "lease_index.h"
 #include "lease_v4.h"
 #include <netinet/in.h>
 #include <pthread.h>
@@ -9,8 +11,6 @@
 #include <stdint.h>
 #include <time.h>
 
-#define MAX_POOL_SIZE 1024
-
 typedef enum ip_state_t
 {
     IP_STATE_AVAILABLE = 0,
@@ -18,6 +18,7 @@ typedef enum ip_state_t
     IP_STATE_RESERVED,
     IP_STATE_EXCLUDED,
     IP_STATE_CONFLICT,
+    IP_STATE_PROBING, // Held for a client while its conflict probe is in flight
     IP_STATE_UNKNOWN
 } ip_state_t;
 
@@ -44,43 +45,56 @@ struct ip_pool_entry_t
     uint64_t lease_id; // Lease ID reference (0 = no lease)
 };
 
-struct ip_pool_t
-{
-    struct dhcp_subnet_t *subnet;
-    struct ip_pool_entry_t entries[MAX_POOL_SIZE];
-    uint32_t pool_size;
-    uint32_t allocated_count;
-    uint32_t available_count;
+#define IP_POOL_STRIPE_BITS 6
+#define IP_POOL_STRIPES (1u << IP_POOL_STRIPE_BITS) // Client lock stripes per pool
 
+/**
+ * @brief Lock stripe of a pool: the clients whose MAC hashes to it.
+ */
+struct ip_pool_stripe_t
+{
     pthread_mutex_t mutex;
+    struct lease_index_t mac_index; // hash(MAC) -> entry number (ALLOCATED/PROBING)
 };
 
 /**
- * @brief Synchronization thread for keeping IP pool in sync with lease database.
+ * @brief Address pool for one subnet range.
+ *
+ * entries[] covers range_start..range_end contiguously, so the entry of an
+ * address is entries[ip - range_start]. free_map has a bit set for every
+ * AVAILABLE entry, and the mac_index of each stripe maps the MAC of every
+ * ALLOCATED or PROBING entry held by one of its clients to the entry number;
+ * both are kept in step with the entry state by ip_pool.c.
  *
- * This thread periodically synchronizes the IP pool state with the lease database,
- * ensuring that expired/released leases are reflected in the pool's available count.
+ * There is no pool-wide lock. An AVAILABLE entry belongs to the free map:
+ * the thread that clears its bit (ip_bitmap_test_and_clear/claim_first) owns
+ * it. An ALLOCATED or PROBING entry only changes with the stripe of its MAC
+ * locked, and leaves the MAC index in the same critical section, so two
+ * clients in different stripes never wait for each other. RESERVED, EXCLUDED
+ * and CONFLICT entries, and admin changes to any entry, take every stripe.
+ * Entries released to AVAILABLE are written before their bit is set.
+ * Lock order: lease database shard, then pool stripe.
  */
-struct ip_pool_sync_t
+struct ip_pool_t
 {
-    struct ip_pool_t *pool;
-    struct lease_database_t *lease_db;
-    uint32_t sync_interval_sec;
-
-    pthread_t sync_thread;
-    pthread_mutex_t sync_mutex;
-    pthread_cond_t sync_cond;
-    bool running;
-    bool mutex_initialized;
+    struct dhcp_subnet_t *subnet;     // Read atomically: replaced by ip_pool_update_subnet()
+    struct ip_pool_entry_t *entries;
+    uint32_t range_start;             // First address, host byte order
+    uint32_t pool_size;
+    uint32_t allocated_count;         // Updated atomically
+    uint32_t available_count;         // Updated atomically
+
+    struct ip_bitmap_t free_map;      // Bit i set = entries[i] is AVAILABLE
 
-    // Statistics
-    uint64_t sync_count;
-    uint64_t entries_updated;
+    struct ip_pool_stripe_t stripes[IP_POOL_STRIPES];
+    bool mutex_initialized;
 };
 
 struct ip_allocation_result_t
 {
     bool success;
+    bool needs_probe;   // Address held as PROBING: probe it, then ip_pool_resolve_probe()
+    bool probe_pending; // This client already has a probe in flight (success is false)
     struct in_addr ip_address;
     char error_message[256];
 };
@@ -91,6 +105,8 @@ struct ip_allocation_result_t
  * @param subnet Pointer to dhcp_subnet_t defining the subnet range.
  * @param lease_db Pointer to lease_database_t for syncing existing leases.
  * @return 0 on success, -1 on failure (e.g., invalid parameters).
+ *
+ * The leases are read one shard at a time with that shard locked.
  */
 int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct lease_database_t *lease_db);
 
@@ -100,16 +116,65 @@ int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct le
  */
 void ip_pool_free(struct ip_pool_t *pool);
 
+/**
+ * @brief Switch a pool over to a reloaded definition of its subnet.
+ * @param pool Pointer to ip_pool_t structure.
+ * @param subnet New subnet; must have the same address range as the pool.
+ * @param lease_db Lease database used to keep dropped reservations that are
+ *                 still leased (may be NULL).
+ * @return 0 on success, -1 if the range differs.
+ *
+ * Allocations, leases and probes in flight are kept. Host reservations are
+ * brought in line with the new subnet: an address that is no longer reserved
+ * stays ALLOCATED to its lease holder while the lease is ACTIVE and is freed
+ * otherwise; a new reservation takes its address as at startup. Readers
+ * switch to the new subnet atomically, so the old one must stay valid until
+ * no thread can still be using the pool through it.
+ */
+int ip_pool_update_subnet(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct lease_database_t *lease_db);
+
 /**
  * @brief Allocate an IP address from the pool for the given MAC address.
  * @param pool Pointer to ip_pool_t structure.
  * @param mac Pointer to 6-byte MAC address of the client.
+ * @param client_id Client identifier (Option 61) the client sent, or NULL.
+ * @param client_id_len Length of client_id.
  * @param requested_ip Requested IP address (if available).
  * @param config Pointer to dhcp_config_t for configuration options.
  * @return ip_allocation_result_t structure with allocation result.
+ *
+ * With ping-check enabled a newly chosen address is not allocated yet: it is
+ * held as PROBING and needs_probe is set. The caller probes it (see
+ * ping_probe.h) and reports the outcome with ip_pool_resolve_probe().
+ */
+struct ip_allocation_result_t ip_pool_allocate(struct ip_pool_t *pool, const uint8_t mac[6], const uint8_t *client_id,
+                                               uint32_t client_id_len, struct in_addr requested_ip,
+                                               struct dhcp_config_t *config);
+
+/**
+ * @brief Finish a conflict probe for an address held as PROBING.
+ * @param pool Pointer to ip_pool_t structure.
+ * @param ip Probed IP address.
+ * @param mac MAC address the address is held for.
+ * @param new_state IP_STATE_ALLOCATED (no reply), IP_STATE_CONFLICT (answered)
+ *                  or IP_STATE_AVAILABLE (probe abandoned).
+ * @return 0 on success, -1 if the address is no longer held for this MAC.
+ */
+int ip_pool_resolve_probe(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6], ip_state_t new_state);
+
+/**
+ * @brief Take a specific address for a client, if it may have it.
+ * @param pool Pointer to ip_pool_t structure.
+ * @param ip IP address.
+ * @param mac Pointer to 6-byte MAC address of the client.
+ * @return 0 if the address is now (or already was) ALLOCATED to this MAC or is
+ *         its host reservation (matched by MAC), -1 if it is held by someone
+ *         else, excluded or not in the pool.
+ *
+ * A free address is claimed from the free map; an address being probed for
+ * the client is not taken.
  */
-struct ip_allocation_result_t ip_pool_allocate(struct ip_pool_t *pool, const uint8_t mac[6],
-                                               struct in_addr requested_ip, struct dhcp_config_t *config);
+int ip_pool_claim_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6]);
 
 /**
  * @brief Reserve a specific IP address for a client MAC address.
@@ -124,9 +189,10 @@ int ip_pool_reserve_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t
  * @brief Release an allocated IP address back to the pool.
  * @param pool Pointer to ip_pool_t structure.
  * @param ip IP address to release.
- * @return 0 on success, -1 on failure (e.g., IP not found or not allocated).
+ * @param mac Pointer to 6-byte MAC address of the client holding it.
+ * @return 0 on success, -1 if the IP is not in the pool or not allocated to this MAC.
  */
-int ip_pool_release_ip(struct ip_pool_t *pool, struct in_addr ip);
+int ip_pool_release_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6]);
 
 /**
  * @brief Mark an IP address as in conflict (e.g., ping check failed).
@@ -199,14 +265,6 @@ bool ip_is_gateway(struct in_addr ip, struct in_addr gateway);
  */
 bool ip_is_loopback(struct in_addr ip);
 
-/**
- * @brief Perform a ping check on the given IP address.
- * @param ip IP address to ping.
- * @param timeout_ms Timeout in milliseconds.
- * @return true if the IP responds to ping, false otherwise.
- */
-bool ip_ping_check(struct in_addr ip, uint32_t timeout_ms);
-
 /**
  * @brief Print summary statistics of the IP pool.
  * @param pool Pointer to ip_pool_t structure.
@@ -231,6 +289,10 @@ ip_state_t ip_state_from_lease_state(lease_state_t lease_state);
  * @param pool Pointer to ip_pool_t structure.
  * @param lease_db Pointer to lease_database_t structure.
  * @return 0 on success, -1 on failure.
+ *
+ * Visits the database one shard at a time (lease_db_lock_shard()), taking
+ * every stripe of the pool while it scans that shard; never locks the whole
+ * database.
  */
 int ip_pool_sync_with_leases(struct ip_pool_t *pool, struct lease_database_t *lease_db);
 
@@ -239,58 +301,98 @@ int ip_pool_sync_with_leases(struct ip_pool_t *pool, struct lease_database_t *le
  * @param pool Pointer to ip_pool_t structure.
  * @param lease Pointer to dhcp_lease_t structure.
  * @return 0 on success, -1 on failure.
+ *
+ * Locks every stripe of the pool; call with the shard of the lease locked.
  */
 int ip_pool_update_from_lease(struct ip_pool_t *pool, struct dhcp_lease_t *lease);
 
 /**
- * @brief Initialize the IP pool synchronization thread.
- * @param sync Pointer to ip_pool_sync_t structure to initialize.
- * @param pool Pointer to ip_pool_t structure to synchronize.
- * @param lease_db Pointer to lease_database_t structure.
- * @param sync_interval_sec Interval in seconds between sync operations.
- * @return 0 on success, -1 on failure.
- */
-int ip_pool_sync_init(struct ip_pool_sync_t *sync, struct ip_pool_t *pool,
-                      struct lease_database_t *lease_db, uint32_t sync_interval_sec);
-
-/**
- * @brief Start the IP pool synchronization thread.
- * @param sync Pointer to ip_pool_sync_t structure.
- * @return 0 on success, -1 on failure.
+ * @brief Return the address of a lease that has just expired to the pool.
+ * @param pool Pointer to ip_pool_t structure.
+ * @param lease The expired lease.
+ * @return 0 if the entry was freed, -1 if it is not in this pool or no longer
+ *         allocated to the lease's client.
+ *
+ * Expiry event from the lease timer (see lease_timer_set_expiry_callback()),
+ * called with the shard of the lease locked.
  */
-int ip_pool_sync_start(struct ip_pool_sync_t *sync);
+int ip_pool_expire_lease(struct ip_pool_t *pool, const struct dhcp_lease_t *lease);
 
 /**
- * @brief Stop the IP pool synchronization thread.
- * @param sync Pointer to ip_pool_sync_t structure.
+ * @brief Create or renew the lease for an address the pool allocated to a client.
+ * @param pool Pointer to ip_pool_t structure.
+ * @param lease_db Pointer to lease_database_t structure.
+ * @param mac Pointer to 6-byte MAC address of the client.
+ * @param client_id Client identifier (Option 61) the client sent, or NULL.
+ * @param client_id_len Length of client_id.
+ * @param ip Address returned by ip_pool_allocate() (after its probe, if any).
+ * @param lease_time Lease time in seconds.
+ * @param out_lease Receives a copy of the lease (may be NULL).
+ * @return 0 on success, -1 on failure (the address is released back to the pool).
+ *
+ * Locks the shard of ip, then the stripe of mac, and claims the address for
+ * the client (ip_pool_claim_ip()) before the lease becomes ACTIVE, so a lease
+ * expiring at the same time cannot hand it to anyone else. An ended lease
+ * left on the address by another client is replaced; one still ACTIVE is
+ * never overwritten (the pool of another configuration generation may have
+ * handed the address out) and the commit fails.
  */
-void ip_pool_sync_stop(struct ip_pool_sync_t *sync);
+int ip_pool_commit_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, const uint8_t mac[6],
+                         const uint8_t *client_id, uint32_t client_id_len, struct in_addr ip, uint32_t lease_time,
+                         struct dhcp_lease_t *out_lease);
 
 /**
- * @brief Wake up the sync thread to perform immediate synchronization.
- * @param sync Pointer to ip_pool_sync_t structure.
+ * @brief Renew a client's lease (DHCPREQUEST).
+ * @param pool Pointer to ip_pool_t structure.
+ * @param lease_db Pointer to lease_database_t structure.
+ * @param ip Address of the lease.
+ * @param mac Pointer to 6-byte MAC address of the client.
+ * @param client_id Client identifier (Option 61) the client sent, or NULL.
+ * @param client_id_len Length of client_id.
+ * @param lease_time Lease time in seconds.
+ * @param out_lease Receives a copy of the renewed lease (may be NULL).
+ * @return 0 on success, -1 if there is no lease for this client on ip or the
+ *         address was given to someone else after the lease ended.
+ *
+ * Same locking as ip_pool_commit_lease().
  */
-void ip_pool_sync_wakeup(struct ip_pool_sync_t *sync);
+int ip_pool_renew_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, struct in_addr ip,
+                        const uint8_t mac[6], const uint8_t *client_id, uint32_t client_id_len, uint32_t lease_time,
+                        struct dhcp_lease_t *out_lease);
 
 /**
- * @brief Check if the sync thread is running.
- * @param sync Pointer to ip_pool_sync_t structure.
- * @return true if running, false otherwise.
+ * @brief Release a client's lease and return its address to the pool (DHCPRELEASE).
+ * @param pool Pointer to ip_pool_t structure.
+ * @param lease_db Pointer to lease_database_t structure.
+ * @param ip Address of the lease.
+ * @param mac Pointer to 6-byte MAC address of the client.
+ * @param out_lease Receives a copy of the released lease (may be NULL).
+ * @return 0 on success, -1 if there is no lease for this client on ip.
+ *
+ * Same locking as ip_pool_commit_lease().
  */
-bool ip_pool_sync_is_running(const struct ip_pool_sync_t *sync);
+int ip_pool_release_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, struct in_addr ip,
+                          const uint8_t mac[6], struct dhcp_lease_t *out_lease);
 
 /**
  * @brief Allocate an IP address and create or renew a lease in the lease database.
  * @param pool Pointer to ip_pool_t structure.
  * @param lease_db Pointer to lease_database_t structure.
  * @param mac Pointer to 6-byte MAC address of the client.
+ * @param client_id Client identifier (Option 61) the client sent, or NULL.
+ * @param client_id_len Length of client_id.
  * @param requested_ip Requested IP address (if available).
  * @param config Pointer to dhcp_config_t for configuration options.
  * @param lease_time Lease time in seconds.
- * @return Pointer to dhcp_lease_t structure on success, NULL on failure.
+ * @param out_lease Receives a copy of the lease (may be NULL).
+ * @return 0 on success, -1 on failure.
+ *
+ * Synchronous: an address that would need a conflict probe is taken without
+ * one. The packet path uses ip_pool_allocate() and the prober instead.
  */
-struct dhcp_lease_t *ip_pool_allocate_and_create_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db,
-                                                       const uint8_t mac[6], struct in_addr requested_ip,
-                                                       struct dhcp_config_t *config, uint32_t lease_time);
+int ip_pool_allocate_and_create_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, const uint8_t mac[6],
+                                      const uint8_t *client_id, uint32_t client_id_len, struct in_addr requested_ip,
+                                      struct dhcp_config_t *config, uint32_t lease_time,
+                                      struct dhcp_lease_t *out_lease);
 
 #endif // IP_POOL_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef LEASE_EXPIRY_H
+#define LEASE_EXPIRY_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LEASE_EXPIRY_MIN_CAPACITY 64
+
+/**
+ * @brief Scheduled expiry: the lease for ip ends at end_time.
+ */
+struct lease_expiry_entry_t
+{
+    time_t end_time;
+    struct in_addr ip;
+};
+
+/**
+ * @brief Binary min-heap of lease expiry times.
+ *
+ * Entries are never updated or removed in place: a renewal schedules a new
+ * entry and the old one becomes stale. Whoever pops an entry checks it
+ * against the lease (still ACTIVE with the same end_time) and discards it
+ * otherwise, so the heap needs no back-pointers into the lease store and
+ * survives slots being moved by compaction.
+ */
+struct lease_expiry_heap_t
+{
+    struct lease_expiry_entry_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+/**
+ * @brief Allocate an empty heap.
+ * @param heap Pointer to the heap structure.
+ * @return 0 on success, -1 on failure.
+ */
+int lease_expiry_init(struct lease_expiry_heap_t *heap);
+
+/**
+ * @brief Release the entry array.
+ * @param heap Pointer to the heap structure.
+ */
+void lease_expiry_free(struct lease_expiry_heap_t *heap);
+
+/**
+ * @brief Drop every entry, keeping the allocation.
+ * @param heap Pointer to the heap structure.
+ */
+void lease_expiry_clear(struct lease_expiry_heap_t *heap);
+
+/**
+ * @brief Grow the heap up front so entries fit without reallocating.
+ * @param heap Pointer to the heap structure.
+ * @param entries Total number of entries the heap should hold.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int lease_expiry_reserve(struct lease_expiry_heap_t *heap, uint32_t entries);
+
+/**
+ * @brief Schedule an expiry.
+ * @param heap Pointer to the heap structure.
+ * @param end_time When the lease ends.
+ * @param ip Address of the lease.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int lease_expiry_push(struct lease_expiry_heap_t *heap, time_t end_time, struct in_addr ip);
+
+/**
+ * @brief Remove the earliest entry if it ends before a given time.
+ * @param heap Pointer to the heap structure.
+ * @param before Only entries with end_time < before are taken.
+ * @param entry Output: the removed entry.
+ * @return true if an entry was removed, false if none is due.
+ */
+bool lease_expiry_pop_due(struct lease_expiry_heap_t *heap, time_t before, struct lease_expiry_entry_t *entry);
+
+/**
+ * @brief Earliest scheduled end time.
+ * @param heap Pointer to the heap structure.
+ * @return end_time of the top entry, or 0 when the heap is empty.
+ */
+static inline time_t lease_expiry_next(const struct lease_expiry_heap_t *heap)
+{
+    return heap->count > 0 ? heap->entries[0].end_time : 0;
+}
+
+#endif // LEASE_EXPIRY_H
@@ -0,0 +1,147 @@
+#ifndef LEASE_INDEX_H
+#define LEASE_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LEASE_INDEX_MIN_CAPACITY 64   // Power of two
+#define LEASE_INDEX_EMPTY 0u          // Slot never used
+#define LEASE_INDEX_TOMBSTONE 0xFFFFFFFFu // Slot freed by a removal
+
+/**
+ * @brief One open-addressing slot.
+ *
+ * ref is the lease slot number + 1 (so 0 can mean "empty"). The full 32-bit
+ * hash is kept next to it so probes compare keys only on a hash match.
+ */
+struct lease_index_slot_t
+{
+    uint32_t hash;
+    uint32_t ref;
+};
+
+/**
+ * @brief Open-addressing (linear probing) hash index from a key hash to lease slots.
+ *
+ * The index does not store keys: it maps a hash to candidate lease refs and
+ * the caller confirms the key against the lease itself. The same structure
+ * therefore serves unique keys (IP, lease_id) and multi-valued keys
+ * (MAC, client identifier). Load factor, tombstones included, is kept <= 1/2.
+ */
+struct lease_index_t
+{
+    struct lease_index_slot_t *slots;
+    uint32_t capacity;   // Power of two
+    uint32_t live;       // Slots holding a ref
+    uint32_t used;       // live + tombstones
+};
+
+/**
+ * @brief Cursor over the refs stored under one hash.
+ */
+struct lease_index_iter_t
+{
+    uint32_t hash;
+    uint32_t pos;
+    uint32_t probes;
+};
+
+/**
+ * @brief Allocate an empty index.
+ * @param idx Pointer to the index structure.
+ * @param expected_entries Number of entries to size for (0 for the minimum).
+ * @return 0 on success, -1 on failure.
+ */
+int lease_index_init(struct lease_index_t *idx, uint32_t expected_entries);
+
+/**
+ * @brief Release the slot array.
+ * @param idx Pointer to the index structure.
+ */
+void lease_index_free(struct lease_index_t *idx);
+
+/**
+ * @brief Drop every entry, keeping the allocation.
+ * @param idx Pointer to the index structure.
+ */
+void lease_index_clear(struct lease_index_t *idx);
+
+/**
+ * @brief Grow the index up front so expected_entries fit without a rehash.
+ * @param idx Pointer to the index structure.
+ * @param expected_entries Total number of entries the index should hold.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int lease_index_reserve(struct lease_index_t *idx, uint32_t expected_entries);
+
+/**
+ * @brief Add (hash, slot) to the index, growing it when needed.
+ * @param idx Pointer to the index structure.
+ * @param hash Key hash.
+ * @param slot Lease slot number.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int lease_index_insert(struct lease_index_t *idx, uint32_t hash, uint32_t slot);
+
+/**
+ * @brief Remove (hash, slot) from the index.
+ * @param idx Pointer to the index structure.
+ * @param hash Key hash the entry was inserted with.
+ * @param slot Lease slot number.
+ * @return true if the entry was found and removed.
+ */
+bool lease_index_remove(struct lease_index_t *idx, uint32_t hash, uint32_t slot);
+
+/**
+ * @brief Start iterating the lease slots stored under a hash.
+ * @param idx Pointer to the index structure.
+ * @param hash Key hash to look up.
+ * @param iter Cursor to initialize.
+ */
+void lease_index_find(const struct lease_index_t *idx, uint32_t hash, struct lease_index_iter_t *iter);
+
+/**
+ * @brief Get the next candidate slot for the hash given to lease_index_find().
+ * @param idx Pointer to the index structure.
+ * @param iter Cursor.
+ * @param slot Output: lease slot number.
+ * @return true if a candidate was returned, false when exhausted.
+ *
+ * Candidates share the full 32-bit hash; the caller must compare the key.
+ */
+bool lease_index_next(const struct lease_index_t *idx, struct lease_index_iter_t *iter, uint32_t *slot);
+
+// ----------------------------------------------------------------------------------------------
+// Key hashing
+// ----------------------------------------------------------------------------------------------
+
+/**
+ * @brief Hash a 64-bit integer key (IPv4 address, lease ID, packed MAC).
+ */
+static inline uint32_t lease_index_hash_u64(uint64_t key)
+{
+    // splitmix64 finalizer
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return (uint32_t)key;
+}
+
+/**
+ * @brief Hash a variable-length byte key (client identifier).
+ */
+static inline uint32_t lease_index_hash_bytes(const uint8_t *data, uint32_t len)
+{
+    // FNV-1a, then finalized so short keys still spread over all bits
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return lease_index_hash_u64(h);
+}
+
+#endif // LEASE_INDEX_H
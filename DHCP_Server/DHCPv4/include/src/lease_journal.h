@@ -0,0 +1,169 @@
+#ifndef LEASE_JOURNAL_H
+#define LEASE_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct dhcp_lease_t;
+struct lease_database_t;
+
+#define LEASE_JOURNAL_MAGIC 0x4C4A3444u  // Record marker ("D4JL" little-endian)
+#define LEASE_SNAPSHOT_MAGIC 0x53533444u // Snapshot file marker ("D4SS" little-endian)
+#define LEASE_SNAPSHOT_VERSION 1
+#define LEASE_JOURNAL_RECORD_SIZE 256
+#define LEASE_JOURNAL_DATA_SIZE 176      // client-id + hostname + vendor class bytes
+#define LEASE_JOURNAL_COMPACT_MIN 4096   // Never compact a journal shorter than this
+
+#define LEASE_JOURNAL_FLAG_ABANDONED 0x01
+#define LEASE_JOURNAL_FLAG_BOOTP 0x02
+
+/**
+ * @brief One fixed-size journal / snapshot record (host byte order).
+ *
+ * Holds a full copy of one lease. The variable-length fields are packed back
+ * to back into data[]: client-id, then hostname, then vendor class. A value
+ * that does not fit is truncated (vendor class first); client-id always fits.
+ * crc32 covers the whole record with the crc32 field taken as zero, so a torn
+ * or partly written record is detected on recovery.
+ */
+struct lease_journal_record_t
+{
+    uint32_t magic;              // LEASE_JOURNAL_MAGIC
+    uint32_t crc32;
+    uint64_t seq;                // Journal sequence number (0 in snapshots)
+    uint64_t lease_id;
+    int64_t start_time;
+    int64_t end_time;
+    int64_t tstp;
+    int64_t cltt;
+    uint32_t ip_address;         // Network byte order, as in struct in_addr
+    uint8_t mac_address[6];
+    uint8_t state;
+    uint8_t next_binding_state;
+    uint8_t rewind_binding_state;
+    uint8_t flags;               // LEASE_JOURNAL_FLAG_*
+    uint8_t client_id_len;
+    uint8_t hostname_len;
+    uint8_t vendor_class_len;
+    uint8_t reserved[7];
+    uint8_t data[LEASE_JOURNAL_DATA_SIZE];
+};
+
+_Static_assert(sizeof(struct lease_journal_record_t) == LEASE_JOURNAL_RECORD_SIZE,
+               "journal record must stay fixed-size");
+
+/**
+ * @brief Header of a snapshot file, followed by record_count records.
+ *
+ * journal_seq is the last journal sequence number reflected in the snapshot;
+ * journal records up to it are skipped when the journal is replayed.
+ */
+struct lease_snapshot_header_t
+{
+    uint32_t magic;              // LEASE_SNAPSHOT_MAGIC
+    uint32_t version;            // LEASE_SNAPSHOT_VERSION
+    uint32_t record_size;        // LEASE_JOURNAL_RECORD_SIZE
+    uint32_t crc32;              // CRC-32 of the header with this field zeroed
+    uint64_t record_count;
+    uint64_t journal_seq;
+    uint64_t next_lease_id;
+    uint8_t reserved[24];
+};
+
+_Static_assert(sizeof(struct lease_snapshot_header_t) == 64, "snapshot header must stay 64 bytes");
+
+/**
+ * @brief Write-ahead lease journal with group commit and snapshot compaction.
+ *
+ * Lease changes are appended as fixed-size records to <lease file>.journal.
+ * Records are buffered by lease_journal_append() and made durable together by
+ * lease_journal_commit(): one write() and one fdatasync() per batch.
+ * lease_journal_compact() writes the whole database to <lease file>.snapshot
+ * (temp file + rename) and empties the journal.
+ *
+ * Not thread-safe: the lease I/O thread is the only user once the server runs.
+ */
+struct lease_journal_t
+{
+    int fd;                      // Journal, opened O_APPEND
+    char journal_path[288];
+    char snapshot_path[288];
+
+    uint64_t next_seq;           // Sequence number of the next record
+    uint64_t record_count;       // Records in the journal since the last compaction
+
+    // Batch being assembled for the next commit
+    struct lease_journal_record_t *pending;
+    uint32_t pending_count;
+    uint32_t pending_capacity;
+
+    // Statistics
+    uint64_t commits;            // write + fdatasync rounds
+    uint64_t records_written;
+    uint64_t compactions;
+    uint64_t errors;
+};
+
+/**
+ * @brief Open (or create) the journal that belongs to a lease file.
+ * @param journal Pointer to the journal structure.
+ * @param lease_file Path of the lease file; ".journal"/".snapshot" are appended.
+ * @return 0 on success, -1 on failure.
+ */
+int lease_journal_open(struct lease_journal_t *journal, const char *lease_file);
+
+/**
+ * @brief Commit any buffered records and close the journal.
+ * @param journal Pointer to the journal structure.
+ */
+void lease_journal_close(struct lease_journal_t *journal);
+
+/**
+ * @brief Rebuild the lease database from disk.
+ * @param journal Pointer to an open journal.
+ * @param db Empty, initialized lease database.
+ * @return 0 on success, -1 on failure.
+ *
+ * Loads the snapshot if one exists, otherwise imports the text lease file
+ * with lease_db_load(). Then replays the journal on top. A torn record at the
+ * end of the journal (crash during a write) is cut off so appends continue
+ * after the last complete record. Call before any worker thread starts.
+ */
+int lease_journal_recover(struct lease_journal_t *journal, struct lease_database_t *db);
+
+/**
+ * @brief Buffer one lease record for the next commit.
+ * @param journal Pointer to the journal structure.
+ * @param lease Lease to record (interned strings are read, not kept).
+ * @return 0 on success, -1 on failure (out of memory).
+ */
+int lease_journal_append(struct lease_journal_t *journal, const struct dhcp_lease_t *lease);
+
+/**
+ * @brief Write all buffered records with a single write() and fdatasync().
+ * @param journal Pointer to the journal structure.
+ * @return 0 on success (or nothing to do), -1 on I/O error.
+ */
+int lease_journal_commit(struct lease_journal_t *journal);
+
+/**
+ * @brief Check whether the journal has grown enough to be worth compacting.
+ * @param journal Pointer to the journal structure.
+ * @param lease_count Current number of leases in the database.
+ * @return true once the journal holds more than twice lease_count records.
+ */
+bool lease_journal_should_compact(const struct lease_journal_t *journal, uint32_t lease_count);
+
+/**
+ * @brief Write a snapshot of the database and truncate the journal.
+ * @param journal Pointer to the journal structure.
+ * @param db Lease database (locked only while the leases are copied).
+ * @return 0 on success, -1 on failure (the journal is then left intact).
+ *
+ * Buffered records are committed first. The snapshot is written to a
+ * temporary file, synced and renamed over the old one before the journal
+ * is emptied, so a crash at any point leaves a recoverable pair.
+ */
+int lease_journal_compact(struct lease_journal_t *journal, struct lease_database_t *db);
+
+#endif // LEASE_JOURNAL_H
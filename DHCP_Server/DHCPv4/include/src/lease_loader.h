@@ -0,0 +1,46 @@
+#ifndef LEASE_LOADER_H
+#define LEASE_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct lease_database_t;
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+struct lease_file_map_t
+{
+    const char *data; // NULL for an empty file
+    size_t size;
+};
+
+/**
+ * @brief Map a file read-only for one sequential pass.
+ * @param path File to map.
+ * @param map Output mapping.
+ * @return 0 on success, -1 on failure (errno set; ENOENT if the file is missing).
+ */
+int lease_file_map(const char *path, struct lease_file_map_t *map);
+
+/**
+ * @brief Release a mapping made by lease_file_map().
+ * @param map Mapping to release.
+ */
+void lease_file_unmap(struct lease_file_map_t *map);
+
+/**
+ * @brief Parse an ISC DHCP style lease file image into the database.
+ * @param db Lease database to fill (leases go through lease_db_restore_lease()).
+ * @param data File contents; need not be NUL-terminated and is never written.
+ * @param size Number of bytes at data.
+ * @return Number of lease blocks parsed.
+ *
+ * A hand-written tokenizer walks the buffer once, in place: words, quoted
+ * strings and ; { } are returned as (pointer, length) spans, so lines are
+ * never copied. Unknown statements and nested blocks are skipped; a lease
+ * block that does not parse is dropped and the scan resumes after it.
+ */
+uint32_t lease_loader_parse(struct lease_database_t *db, const char *data, size_t size);
+
+#endif // LEASE_LOADER_H
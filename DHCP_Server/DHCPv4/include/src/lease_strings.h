@@ -0,0 +1,82 @@
+#ifndef LEASE_STRINGS_H
+#define LEASE_STRINGS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lease_index.h"
+
+#define LEASE_STRINGS_BLOCK_SIZE 65536 // Bytes per arena block
+
+/**
+ * @brief One interned value: bytes plus length (a NUL follows the bytes).
+ */
+struct lease_string_entry_t
+{
+    const uint8_t *data;
+    uint32_t len;
+};
+
+/**
+ * @brief Cold side table of interned lease strings (hostname, vendor class, client-id).
+ *
+ * Each distinct value is stored once in append-only arena blocks, so many
+ * leases from the same vendor or re-leases to the same host share storage.
+ * Interned data never moves and is only released by lease_strings_free(),
+ * so pointers may be kept in lease copies (I/O queue, *_safe out-params)
+ * and read without the database lock. Values nobody uses any more are not
+ * released one by one: the lease database rebuilds the table from its
+ * leases instead (lease_db_compact_strings()).
+ *
+ * Interning itself is not thread-safe; the lease database calls it with
+ * its strings_mutex held.
+ */
+struct lease_strings_t
+{
+    uint8_t **blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    uint32_t block_used;         // Bytes used in the newest block
+
+    struct lease_string_entry_t *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    struct lease_index_t index;  // hash(bytes) -> entry number
+
+    uint64_t bytes_stored;       // Payload bytes, NULs included
+};
+
+/**
+ * @brief Initialize an empty string table.
+ * @param strings Pointer to the string table.
+ * @return 0 on success, -1 on failure.
+ */
+int lease_strings_init(struct lease_strings_t *strings);
+
+/**
+ * @brief Release every block. All pointers handed out become invalid.
+ * @param strings Pointer to the string table.
+ */
+void lease_strings_free(struct lease_strings_t *strings);
+
+/**
+ * @brief Return the stored copy of a byte string, adding it if new.
+ * @param strings Pointer to the string table.
+ * @param data Bytes to intern.
+ * @param len Number of bytes (must be < LEASE_STRINGS_BLOCK_SIZE).
+ * @return Pointer to the NUL-terminated stored copy, or NULL on failure.
+ */
+const uint8_t *lease_strings_intern(struct lease_strings_t *strings, const void *data, uint32_t len);
+
+/**
+ * @brief Intern a C string.
+ * @param strings Pointer to the string table.
+ * @param str NUL-terminated string.
+ * @return Pointer to the stored copy, or NULL on failure.
+ */
+static inline const char *lease_strings_intern_str(struct lease_strings_t *strings, const char *str)
+{
+    return (const char *)lease_strings_intern(strings, str, (uint32_t)strlen(str));
+}
+
+#endif // LEASE_STRINGS_H
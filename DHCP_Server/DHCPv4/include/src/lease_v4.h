@@ -8,7 +8,15 @@
 #include <pthread.h>
 #include <signal.h>
 
-#define MAX_LEASES 1024
+#include "config_v4.h"
+#include "lease_expiry.h"
+#include "lease_index.h"
+#include "lease_journal.h"
+#include "lease_strings.h"
+#include "shm_stats.h"
+
+#define LEASE_CHUNK_SHIFT 10
+#define LEASE_CHUNK_SIZE (1u << LEASE_CHUNK_SHIFT) // Leases per storage chunk
 #define MAX_CLIENT_HOSTNAME 256
 #define MAX_CLIENT_ID_LEN 64
 #define MAX_VENDOR_CLASS_LEN 128
@@ -39,63 +47,156 @@ const char *lease_state_to_string(lease_state_t state);
  */
 lease_state_t lease_state_from_string(const char *str);
 
+/**
+ * @brief Compact lease record (80 bytes on LP64).
+ *
+ * Holds only fixed-size fields so scans over the lease store stay in cache.
+ * Variable-length client data lives in the database's interned string table;
+ * the pointers below are NULL when absent and stay valid until lease_db_free().
+ */
 struct dhcp_lease_t
 {
     uint64_t lease_id; // Unique lease identifier (never changes)
     struct in_addr ip_address;
     uint8_t mac_address[6];
 
+    // State management (lease_state_t values)
+    uint8_t state;                // Current state
+    uint8_t next_binding_state;   // State after expiration
+    uint8_t rewind_binding_state; // State to revert to on failure
+
+    // Flags
+    bool is_abandoned; // Marked as abandoned (ping failed)
+    bool is_bootp;     // BOOTP client (no expiration)
+
+    uint8_t client_id_len; // Length of client_id (0 = none)
+
     // Timestamps
     time_t start_time; // Unix timestamp - when lease started (starts)
     time_t end_time;   // Unix timestamp - when lease expires (ends)
     time_t tstp;       // Time State was Put - last state change
     time_t cltt;       // Client Last Transaction Time
 
-    // State management
-    lease_state_t state;                // Current state
-    lease_state_t next_binding_state;   // State after expiration
-    lease_state_t rewind_binding_state; // State to revert to on failure
+    // Interned client data (cold)
+    const uint8_t *client_id;            // Client identifier (Option 61)
+    const char *client_hostname;         // Client hostname (Option 12)
+    const char *vendor_class_identifier; // Vendor information (Option 60)
+};
 
-    // Client identification
-    uint8_t client_id[MAX_CLIENT_ID_LEN];
-    uint32_t client_id_len;
-    char client_hostname[MAX_CLIENT_HOSTNAME];
+#define LEASE_DB_SHARD_BITS 4
+#define LEASE_DB_SHARDS (1u << LEASE_DB_SHARD_BITS) // Lock stripes of the lease store
 
-    // Vendor information (Option 60)
-    char vendor_class_identifier[MAX_VENDOR_CLASS_LEN];
+/**
+ * @brief One lock stripe of the lease database: the leases whose IP hashes to it.
+ *
+ * There is at most one lease per IP and a lease never changes address, so a
+ * lease lives in one shard for its whole life: looking it up by IP, changing
+ * it and expiring it only take that shard's mutex. Lookups by MAC, client
+ * identifier or lease ID visit every shard. Slot numbers in the indexes are
+ * positions in this shard's store.
+ */
+struct lease_shard_t
+{
+    // Hot store: lease records in chunks of LEASE_CHUNK_SIZE, allocated as the
+    // shard grows. Records do move: lease_db_cleanup_expired() compacts the
+    // store, sliding the leases it keeps over the removed ones. A lease
+    // pointer is only valid while this shard's mutex is held; keep a copy
+    // (the *_safe functions) or the IP beyond that.
+    struct dhcp_lease_t **chunks;
+    uint32_t chunk_count;    // Chunks allocated
+    uint32_t chunk_capacity; // Size of chunks[]
+    uint32_t lease_count;
 
-    // Flags
-    bool is_abandoned; // Marked as abandoned (ping failed)
-    bool is_bootp;     // BOOTP client (no expiration)
+    // Hash indexes over the shard's store, kept in sync by every function that
+    // adds, moves or re-keys a lease
+    struct lease_index_t ip_index;        // ip_address -> lease (unique)
+    struct lease_index_t mac_index;       // mac_address -> leases
+    struct lease_index_t client_id_index; // client_id (option 61) -> leases
+    struct lease_index_t id_index;        // lease_id -> lease (unique)
+
+    // End times of the shard's ACTIVE leases, earliest first. Scheduled by
+    // every function that makes a lease ACTIVE or moves its end_time; stale
+    // entries are skipped when popped (see lease_expiry_heap_t)
+    struct lease_expiry_heap_t expiry;
 
-    // For backward compatibility with file format
-    char binding_state[32]; // String representation of state
+    pthread_mutex_t mutex; // Protects everything above
+    char pad[64];          // Keeps the next shard's hot fields off this cache line
 };
 
 struct lease_database_t
 {
-    struct dhcp_lease_t leases[MAX_LEASES];
-    uint32_t lease_count;
+    struct lease_shard_t shards[LEASE_DB_SHARDS];
+
+    // Cold side table for hostname / vendor class / client-id bytes, shared by
+    // all shards (interned values never move, so readers need no lock).
+    // lease_db_compact_strings() rebuilds it from the stored leases once it
+    // has doubled, and keeps the table it replaces until the next rebuild:
+    // the strings of a lease copy stay readable until then.
+    struct lease_strings_t strings;
+    struct lease_strings_t retired_strings; // Replaced by the last rebuild
+    uint64_t strings_live_bytes;            // strings.bytes_stored right after the last rebuild
+    pthread_mutex_t strings_mutex; // Taken while interning, after a shard mutex
+
     char filename[256];     // Path to lease file
     uint64_t next_lease_id; // Counter for generating unique IDs
 
-    // Thread safety
-    pthread_mutex_t db_mutex;     // Protects access to leases[] and lease_count
-    bool mutex_initialized;       // Track if mutex was initialized
+    bool mutex_initialized; // Track if the mutexes were initialized
 };
 
 /**
- * @brief Timer thread for automatic lease expiration checks.
+ * @brief Shard that holds (or would hold) the lease for an IP address.
+ * @param ip IP address.
+ * @return Shard number, < LEASE_DB_SHARDS.
  *
- * This structure manages a background thread that periodically checks
- * for expired leases and marks them as EXPIRED automatically.
+ * Taken from the high hash bits: the indexes inside a shard use the low ones.
+ */
+static inline uint32_t lease_db_shard_of(struct in_addr ip)
+{
+    return lease_index_hash_u64(ip.s_addr) >> (32 - LEASE_DB_SHARD_BITS);
+}
+
+/**
+ * @brief Get the lease stored at a position of a shard.
+ * @param shard Pointer to the shard.
+ * @param index Position, 0 <= index < shard->lease_count.
+ * @return Pointer to the lease.
+ *
+ * Use for full scans, with the database locked:
+ * for (s = 0; s < LEASE_DB_SHARDS; s++)
+ *     for (i = 0; i < db->shards[s].lease_count; i++) lease_shard_get(&db->shards[s], i).
+ */
+static inline struct dhcp_lease_t *lease_shard_get(const struct lease_shard_t *shard, uint32_t index)
+{
+    return &shard->chunks[index >> LEASE_CHUNK_SHIFT][index & (LEASE_CHUNK_SIZE - 1)];
+}
+
+/**
+ * @brief Called for each lease that has just been marked EXPIRED.
+ * @param arg Argument registered with the callback.
+ * @param lease The lease (state already EXPIRED).
+ *
+ * Runs with the shard of the lease locked: it may take other locks (an
+ * ip_pool_t stripe) but must not call lease functions that lock the database.
+ */
+typedef void (*lease_expiry_fn)(void *arg, struct dhcp_lease_t *lease);
+
+/**
+ * @brief Timer thread for automatic lease expiration.
+ *
+ * This structure manages a background thread that sleeps until the earliest
+ * scheduled lease end time (at most check_interval_sec), marks the leases
+ * that are due as EXPIRED and hands each one to on_expire.
  */
 struct lease_timer_t
 {
     struct lease_database_t *db;  // Pointer to the lease database
     pthread_t timer_thread;       // Timer thread handle
     bool running;                 // Thread running flag
-    uint32_t check_interval_sec;  // How often to check (e.g., 60 seconds)
+    uint32_t check_interval_sec;  // Longest sleep between checks (e.g., 60 seconds)
+
+    lease_expiry_fn on_expire;    // Expiry event sink (NULL: none)
+    void *on_expire_arg;
+    uint64_t expired_total;       // Leases expired since start
 
     // Synchronization
     pthread_mutex_t timer_mutex;  // Protects timer state
@@ -104,33 +205,79 @@ struct lease_timer_t
 };
 
 /**
- * @brief I/O queue operation type.
+ * @brief Convert lease I/O backpressure policy to string.
+ * @param policy Backpressure policy.
+ * @return String representation ("block", "coalesce", "drop").
+ */
+const char *lease_io_backpressure_to_string(lease_io_backpressure_t policy);
+
+/**
+ * @brief Convert string to lease I/O backpressure policy.
+ * @param str Policy string ("block", "coalesce", "drop").
+ * @return Policy, or LEASE_IO_BACKPRESSURE_UNKNOWN if str is NULL or unrecognized.
+ */
+lease_io_backpressure_t lease_io_backpressure_from_string(const char *str);
+
+/**
+ * @brief Lease change carried by the I/O queue.
+ *
+ * Only the fixed-size lease record travels: hostname, vendor class and
+ * client-id stay pointers into the interned string table, which never moves
+ * them and frees them no sooner than the second rebuild after the copy (see
+ * lease_db_compact_strings()); the I/O thread runs those rebuilds itself,
+ * and only once the deltas queued before the previous one are written.
+ */
+struct lease_delta_t
+{
+    uint64_t enqueue_ns;       // CLOCK_MONOTONIC when queued (commit latency)
+    struct dhcp_lease_t lease; // Lease as of the change
+};
+
+/**
+ * @brief One ring slot. seq == position: free for the producer claiming that
+ * position; seq == position + 1: filled, ready for the I/O thread.
  */
-typedef enum io_operation_type_t
+struct lease_io_slot_t
 {
-    IO_OP_SAVE_LEASE,   // Append single lease to file
-    IO_OP_SAVE_ALL,     // Save entire database to file
-    IO_OP_SHUTDOWN      // Shutdown signal
-} io_operation_type_t;
+    uint64_t seq;
+    struct lease_delta_t delta;
+};
 
 /**
- * @brief I/O queue operation.
+ * @brief Pending delta set aside by the coalesce policy while the ring is full.
  */
-struct io_operation_t
+struct lease_io_overflow_t
 {
-    io_operation_type_t type;
-    struct dhcp_lease_t lease;  // Lease data (for SAVE_LEASE)
-    time_t timestamp;           // When operation was queued
+    uint64_t stamp;            // Ring tail when set aside: written once the I/O thread gets there
+    struct lease_delta_t delta;
 };
 
-#define IO_QUEUE_SIZE 256
+/**
+ * @brief I/O queue settings (from the lease-io-* global options).
+ */
+struct lease_io_config_t
+{
+    uint32_t queue_size;                  // Ring slots, rounded up to a power of two
+    lease_io_backpressure_t backpressure; // Full-ring policy
+    struct io_queue_stats_t *stats;       // Where to publish statistics (NULL: private copy)
+};
 
 /**
  * @brief Async I/O queue for non-blocking disk writes.
  *
- * This structure manages a background thread that handles all disk I/O
- * asynchronously, preventing the main thread from blocking on write operations.
- * Uses producer-consumer pattern with circular buffer.
+ * Packet workers publish lease deltas into a bounded lock-free
+ * multi-producer/single-consumer ring: a producer claims a position with
+ * one CAS on tail, fills the slot and releases it through the slot's
+ * sequence number; the I/O thread is the only reader and never takes a
+ * lock on the fast path. Mutexes are only touched to park the I/O thread
+ * when the ring is empty and, under the block policy, a worker when it is
+ * full.
+ *
+ * The I/O thread drains every published delta at once and group-commits the
+ * leases to the binary journal: one write() and one fdatasync() per batch.
+ * Without a journal (it failed to open) leases are appended to the text file.
+ * Full saves and shutdown are flags, not ring entries, so they can neither
+ * be dropped nor wait behind a full ring.
  */
 struct lease_io_queue_t
 {
@@ -138,20 +285,44 @@ struct lease_io_queue_t
     pthread_t io_thread;          // I/O thread handle
     bool running;                 // Thread running flag
 
-    // Circular queue for pending operations
-    struct io_operation_t queue[IO_QUEUE_SIZE];
-    uint32_t head;                // Queue head (consumer reads here)
-    uint32_t tail;                // Queue tail (producer writes here)
-    uint32_t count;               // Number of items in queue
-
-    // Synchronization
-    pthread_mutex_t queue_mutex;  // Protects queue state
-    pthread_cond_t queue_cond;    // Signals when items available
+    // Lock-free ring
+    struct lease_io_slot_t *slots;
+    uint32_t capacity;                    // Power of two
+    lease_io_backpressure_t backpressure; // Full-ring policy
+    char pad0[64];
+    uint64_t tail;                // Next position to claim (producers, CAS)
+    char pad1[64];
+    uint64_t head;                // Next position to consume (I/O thread)
+    char pad2[64];
+    struct lease_delta_t *batch;  // I/O thread scratch: deltas being committed
+
+    // Coalesce policy: newest set-aside delta per IP, used only while the ring is full
+    pthread_mutex_t overflow_mutex;
+    struct lease_io_overflow_t *overflow; // capacity entries
+    uint32_t overflow_count;
+    uint64_t overflow_min_stamp;          // Smallest stamp set aside (UINT64_MAX when empty)
+    struct lease_index_t overflow_index;  // hash(ip) -> overflow entry
+
+    // Requests handled by the I/O thread between batches
+    bool save_all_requested;
+    bool stop_requested;
+
+    // Parking
+    pthread_mutex_t wait_mutex;
+    pthread_cond_t data_cond;     // I/O thread sleeps here while the ring is empty
+    pthread_cond_t space_cond;    // Producers sleep here while it is full (block policy)
+    int consumer_sleeping;
+    uint32_t producers_waiting;
     bool mutex_initialized;       // Track if mutex was initialized
 
-    // Statistics
-    uint64_t operations_processed;
-    uint64_t operations_dropped;  // When queue is full
+    // Write-ahead journal (used by the I/O thread only)
+    struct lease_journal_t journal;
+    bool journal_open;
+    uint64_t strings_rebuilt_tail; // tail after the last lease_db_compact_strings()
+
+    // Statistics (shared memory when configured)
+    struct io_queue_stats_t local_stats;
+    struct io_queue_stats_t *stats;
 };
 
 // ----------------------------------------------------------------------------------------------
@@ -182,6 +353,29 @@ void lease_db_free(struct lease_database_t *db);
  */
 int lease_db_load(struct lease_database_t *db);
 
+/**
+ * @brief Size the lease store and indexes for an expected number of leases.
+ * @param db Pointer to the lease database structure.
+ * @param lease_count Number of leases about to be loaded.
+ * @return 0 on success, -1 on allocation failure.
+ *
+ * Only a hint for bulk loads: it avoids repeated index rehashes, and the
+ * database still grows past lease_count when needed.
+ */
+int lease_db_reserve(struct lease_database_t *db, uint32_t lease_count);
+
+/**
+ * @brief Insert a lease read back from disk, replacing any lease for its IP.
+ * @param db Pointer to the lease database structure.
+ * @param lease Lease as parsed; its strings are interned, not referenced.
+ * @return 0 on success, -1 on failure.
+ *
+ * Shared by the text loader and journal/snapshot recovery. Keeps the lease_id
+ * from disk (or assigns one when it is 0) and raises next_lease_id past it.
+ * This function must be called with the database or the shard of ip locked in multi-threaded contexts.
+ */
+int lease_db_restore_lease(struct lease_database_t *db, const struct dhcp_lease_t *lease);
+
 /**
  * @brief Save all leases to the lease file.
  * @param db Pointer to the lease database structure.
@@ -211,7 +405,7 @@ int lease_db_append_lease(struct lease_database_t *db, const struct dhcp_lease_t
  * Generates monotonically increasing lease IDs. These IDs are stable
  * and never change for a lease, even if the lease is renewed.
  *
- * Thread-safe: Uses atomic operations internally, safe to call without holding db_mutex.
+ * Thread-safe: Uses atomic operations internally, safe to call without holding any lock.
  * Note: lease_db_load() should be called before any concurrent ID generation to avoid conflicts.
  */
 uint64_t lease_db_generate_id(struct lease_database_t *db);
@@ -224,6 +418,7 @@ uint64_t lease_db_generate_id(struct lease_database_t *db);
  *
  * Provides stable reference to a lease using its immutable ID.
  * Lease IDs never change, unlike IP addresses or MAC addresses.
+ * Looks in every shard: call with the database locked (lease_db_lock).
  */
 struct dhcp_lease_t *lease_db_find_by_id(struct lease_database_t *db, uint64_t lease_id);
 
@@ -236,11 +431,12 @@ struct dhcp_lease_t *lease_db_find_by_id(struct lease_database_t *db, uint64_t l
  * @return Pointer to the newly created lease, or NULL on failure.
  *
  * Creates a new lease with ACTIVE state. Automatically sets start_time
- * to now and calculates end_time based on lease_time.
+ * to now and calculates end_time based on lease_time. If a lease for ip
+ * already exists its slot is reused, so there is at most one lease per IP.
  *
  * Note: Does NOT automatically persist to disk. Caller must call lease_db_append_lease(),
  * lease_db_save(), or use the I/O queue (lease_io_queue_save_lease) to persist changes.
- * This function must be called with db_mutex held in multi-threaded contexts.
+ * This function must be called with the database or the shard of ip locked in multi-threaded contexts.
  */
 struct dhcp_lease_t *lease_db_add_lease(struct lease_database_t *db, struct in_addr ip, const uint8_t mac[6], uint32_t lease_time);
 
@@ -249,6 +445,8 @@ struct dhcp_lease_t *lease_db_add_lease(struct lease_database_t *db, struct in_a
  * @param db Pointer to the lease database structure.
  * @param ip IP address to search for.
  * @return Pointer to the lease if found, NULL otherwise.
+ *
+ * Only looks in the shard of ip: the database or that shard must be locked.
  */
 struct dhcp_lease_t *lease_db_find_by_ip(struct lease_database_t *db, struct in_addr ip);
 
@@ -259,10 +457,36 @@ struct dhcp_lease_t *lease_db_find_by_ip(struct lease_database_t *db, struct in_
  * @return Pointer to the lease if found, NULL otherwise.
  *
  * Returns the first active lease for this MAC address.
- * A client may have multiple leases in different states.
+ * A client may have multiple leases in different states; if none is active
+ * the first one found is returned. Looks in every shard: call with the
+ * database locked (lease_db_lock).
  */
 struct dhcp_lease_t *lease_db_find_by_mac(struct lease_database_t *db, const uint8_t mac[6]);
 
+/**
+ * @brief Find a lease by client identifier (DHCP option 61).
+ * @param db Pointer to the lease database structure.
+ * @param client_id Client identifier bytes.
+ * @param len Length of client_id.
+ * @return Pointer to the lease if found, NULL otherwise.
+ *
+ * Same preference and locking as lease_db_find_by_mac(): an active lease wins.
+ */
+struct dhcp_lease_t *lease_db_find_by_client_id(struct lease_database_t *db, const uint8_t *client_id, uint32_t len);
+
+/**
+ * @brief Set the client identifier of a lease stored in the database.
+ * @param db Pointer to the lease database structure.
+ * @param lease Lease inside db (as returned by a lease_db_find_* function).
+ * @param client_id Client identifier bytes.
+ * @param len Length of client_id (0 clears it).
+ * @return 0 on success, -1 on failure.
+ *
+ * Interns the bytes and keeps the client-id index in sync.
+ * This function must be called with the database or the shard of the lease locked in multi-threaded contexts.
+ */
+int lease_db_set_client_id(struct lease_database_t *db, struct dhcp_lease_t *lease, const uint8_t *client_id, uint32_t len);
+
 /**
  * @brief Release a lease (mark as FREE).
  * @param db Pointer to the lease database structure.
@@ -273,7 +497,7 @@ struct dhcp_lease_t *lease_db_find_by_mac(struct lease_database_t *db, const uin
  * to FREE state and updates timestamps.
  *
  * Note: Does NOT automatically persist to disk. Caller must save changes manually.
- * This function must be called with db_mutex held in multi-threaded contexts.
+ * This function must be called with the database or the shard of ip locked in multi-threaded contexts.
  */
 int lease_db_release_lease(struct lease_database_t *db, struct in_addr ip);
 
@@ -288,7 +512,7 @@ int lease_db_release_lease(struct lease_database_t *db, struct in_addr ip);
  * transaction time) and recalculates end_time.
  *
  * Note: Does NOT automatically persist to disk. Caller must save changes manually.
- * This function must be called with db_mutex held in multi-threaded contexts.
+ * This function must be called with the database or the shard of ip locked in multi-threaded contexts.
  */
 int lease_db_renew_lease(struct lease_database_t *db, struct in_addr ip, uint32_t lease_time);
 
@@ -297,14 +521,38 @@ int lease_db_renew_lease(struct lease_database_t *db, struct in_addr ip, uint32_
  * @param db Pointer to the lease database structure.
  * @return Number of leases expired.
  *
- * Scans all active leases and transitions expired ones to EXPIRED state.
- * Should be called periodically by the DHCP server main loop.
+ * Same as lease_db_expire_due(db, time(NULL), NULL, NULL).
  *
  * Note: Does NOT automatically persist to disk. Caller must save changes manually.
- * This function must be called with db_mutex held in multi-threaded contexts.
+ * This function must be called with the database locked (lease_db_lock) in multi-threaded contexts.
  */
 int lease_db_expire_old_leases(struct lease_database_t *db);
 
+/**
+ * @brief Mark ACTIVE leases whose end_time is before now as EXPIRED.
+ * @param db Pointer to the lease database structure.
+ * @param now Current time.
+ * @param on_expire Called for each lease expired (may be NULL).
+ * @param arg Passed to on_expire.
+ * @return Number of leases expired.
+ *
+ * Pops due entries off the expiry heap, so the cost follows the number of
+ * leases ending (plus stale entries left by renewals), not the database size.
+ *
+ * Note: Does NOT automatically persist to disk. Caller must save changes manually.
+ * This function must be called with the database locked (lease_db_lock) in multi-threaded contexts.
+ */
+int lease_db_expire_due(struct lease_database_t *db, time_t now, lease_expiry_fn on_expire, void *arg);
+
+/**
+ * @brief Earliest scheduled lease end time.
+ * @param db Pointer to the lease database structure.
+ * @return end_time of the next lease due (possibly stale), or 0 if none is scheduled.
+ *
+ * This function must be called with the database locked (lease_db_lock) in multi-threaded contexts.
+ */
+time_t lease_db_next_expiry(const struct lease_database_t *db);
+
 /**
  * @brief Remove expired leases from the database.
  * @param db Pointer to the lease database structure.
@@ -314,10 +562,28 @@ int lease_db_expire_old_leases(struct lease_database_t *db);
  * Use cautiously - this deletes lease history.
  *
  * Note: Does NOT automatically persist to disk. Caller must save changes manually.
- * This function must be called with db_mutex held in multi-threaded contexts.
+ * This function must be called with the database locked (lease_db_lock) in multi-threaded contexts.
  */
 int lease_db_cleanup_expired(struct lease_database_t *db);
 
+/**
+ * @brief Drop interned strings no stored lease uses any more.
+ * @param db Pointer to the lease database structure.
+ * @return 1 if the table was rebuilt, 0 if it was not worth it yet, -1 on failure.
+ *
+ * The string arena only grows: a hostname or client-id that changes leaves
+ * its old value behind. Once the arena holds twice as many bytes as after
+ * the previous rebuild (and at least one block more), the strings of every
+ * stored lease are interned into a new table and the leases re-pointed.
+ * The old table is freed by the following rebuild, not now, so the strings
+ * of lease copies taken before (I/O queue deltas, *_safe out-params) stay
+ * readable until then.
+ *
+ * Locks the whole database. The I/O thread calls it before a snapshot once
+ * it has written every delta queued before the previous rebuild.
+ */
+int lease_db_compact_strings(struct lease_database_t *db);
+
 /**
  * @brief Print lease database to stdout (for debugging).
  * @param db Pointer to the lease database structure.
@@ -337,27 +603,28 @@ void lease_db_print(const struct lease_database_t *db);
 bool lease_is_expired(const struct dhcp_lease_t *lease);
 
 /**
- * @brief Set client identifier (DHCP option 61) for a lease.
+ * @brief Set vendor class identifier (DHCP option 60) for a lease.
+ * @param db Pointer to the lease database structure (owns the string table).
  * @param lease Pointer to the lease structure.
- * @param client_id Client identifier bytes.
- * @param len Length of client_id.
+ * @param vendor_class Vendor class string (NULL or "" clears it).
  * @return 0 on success, -1 on failure.
  *
- * Stores the client identifier sent in DHCP option 61.
- * Used for more reliable client identification than MAC address.
+ * Stores vendor identification (e.g., "MSFT 5.0", "Cisco Systems").
+ * Useful for applying vendor-specific configurations.
+ * This function must be called with the database or the shard of the lease locked in multi-threaded contexts.
  */
-int lease_set_client_id(struct dhcp_lease_t *lease, const uint8_t *client_id, uint32_t len);
+int lease_db_set_vendor_class(struct lease_database_t *db, struct dhcp_lease_t *lease, const char *vendor_class);
 
 /**
- * @brief Set vendor class identifier (DHCP option 60) for a lease.
+ * @brief Set client hostname (DHCP option 12) for a lease.
+ * @param db Pointer to the lease database structure (owns the string table).
  * @param lease Pointer to the lease structure.
- * @param vendor_class Vendor class string.
+ * @param hostname Hostname string (NULL or "" clears it).
  * @return 0 on success, -1 on failure.
  *
- * Stores vendor identification (e.g., "MSFT 5.0", "Cisco Systems").
- * Useful for applying vendor-specific configurations.
+ * This function must be called with the database or the shard of the lease locked in multi-threaded contexts.
  */
-int lease_set_vendor_class(struct dhcp_lease_t *lease, const char *vendor_class);
+int lease_db_set_hostname(struct lease_database_t *db, struct dhcp_lease_t *lease, const char *hostname);
 
 /**
  * @brief Update lease timestamps to current time.
@@ -436,12 +703,14 @@ void format_lease_time(time_t timestamp, char *output, size_t output_len);
  * 1. **Non-Safe Functions** (e.g., lease_db_add_lease, lease_db_find_by_ip):
  *    - Fast, direct access to database
  *    - Do NOT perform automatic I/O operations (for performance)
- *    - MUST be called with db_mutex held in multi-threaded contexts
+ *    - MUST be called with the database locked in multi-threaded contexts:
+ *      the whole database (lease_db_lock) or, for functions that work on
+ *      one IP, the shard of that IP (lease_db_lock_ip)
  *    - Return pointers to internal data (valid only while lock is held)
  *    - Use when you need to perform multiple operations atomically
  *
  * 2. **Safe Functions** (e.g., lease_db_add_lease_safe, lease_db_find_by_ip_safe):
- *    - Automatically acquire and release db_mutex
+ *    - Automatically lock and unlock the shards they touch, one at a time
  *    - Return copies of data (safe to use after function returns)
  *    - Simpler to use but have more overhead
  *    - Use for single, isolated operations
@@ -461,13 +730,13 @@ void format_lease_time(time_t timestamp, char *output, size_t output_len);
  * **Pattern 2: Using Non-Safe Functions for Atomic Operations**
  * @code
  * // Multiple operations under one lock
- * lease_db_lock(db);
+ * lease_db_lock_ip(db, ip);
  * struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip);
  * if (lease && lease->state == LEASE_STATE_ACTIVE) {
  *     lease_db_release_lease(db, ip);
  *     // Persist changes (outside critical section if using I/O queue)
  * }
- * lease_db_unlock(db);
+ * lease_db_unlock_ip(db, ip);
  * @endcode
  *
  * **Pattern 3: Persisting Changes**
@@ -484,7 +753,13 @@ void format_lease_time(time_t timestamp, char *output, size_t output_len);
  * @warning IMPORTANT: Non-safe functions do NOT automatically save to disk.
  *          Always persist changes manually using I/O queue or lease_db_save().
  *
- * @warning NEVER hold db_mutex while performing I/O operations directly.
+ * @section Lock order
+ *
+ * Shard mutexes are taken in shard order by lease_db_lock(); a thread holding
+ * one shard may take ip_pool_t stripe locks (the expiry callback does) and
+ * the string table mutex, never another shard.
+ *
+ * @warning NEVER hold a shard mutex while performing I/O operations directly.
  *          Use the I/O queue (lease_io_queue_*) for async disk writes.
  *
  * @note lease_db_load() should be called once at initialization, before
@@ -495,8 +770,9 @@ void format_lease_time(time_t timestamp, char *output, size_t output_len);
  * @brief Lock the lease database for exclusive access.
  * @param db Pointer to the lease database structure.
  *
- * Must be called before accessing lease data from multiple threads.
- * Always pair with lease_db_unlock().
+ * Locks every shard, in order. Needed by whole-database operations (full
+ * scans, lookups by MAC, client-id or lease ID, saves); work on a single IP
+ * only needs lease_db_lock_ip(). Always pair with lease_db_unlock().
  */
 void lease_db_lock(struct lease_database_t *db);
 
@@ -508,6 +784,49 @@ void lease_db_lock(struct lease_database_t *db);
  */
 void lease_db_unlock(struct lease_database_t *db);
 
+/**
+ * @brief Lock the shard holding the lease for an IP address.
+ * @param db Pointer to the lease database structure.
+ * @param ip IP address.
+ *
+ * Enough for the non-safe functions that work on that IP (find_by_ip, add,
+ * renew, release, restore and the setters of a lease with that address).
+ * Always pair with lease_db_unlock_ip().
+ */
+void lease_db_lock_ip(struct lease_database_t *db, struct in_addr ip);
+
+/**
+ * @brief Unlock the shard locked by lease_db_lock_ip().
+ * @param db Pointer to the lease database structure.
+ * @param ip IP address given to lease_db_lock_ip().
+ */
+void lease_db_unlock_ip(struct lease_database_t *db, struct in_addr ip);
+
+/**
+ * @brief Lock one shard of the lease database.
+ * @param db Pointer to the lease database structure.
+ * @param shard Shard number, 0 <= shard < LEASE_DB_SHARDS.
+ *
+ * For scans that can take the database one shard at a time, so that other
+ * threads only ever wait for the shard being visited. Always pair with
+ * lease_db_unlock_shard().
+ */
+void lease_db_lock_shard(struct lease_database_t *db, uint32_t shard);
+
+/**
+ * @brief Unlock a shard locked by lease_db_lock_shard().
+ * @param db Pointer to the lease database structure.
+ * @param shard Shard number given to lease_db_lock_shard().
+ */
+void lease_db_unlock_shard(struct lease_database_t *db, uint32_t shard);
+
+/**
+ * @brief Number of leases in the database.
+ * @param db Pointer to the lease database structure.
+ * @return Sum of the shard counts (each read atomically, no lock needed).
+ */
+uint32_t lease_db_count(const struct lease_database_t *db);
+
 /**
  * @brief Thread-safe version of lease_db_add_lease.
  * @param db Pointer to the lease database structure.
@@ -542,8 +861,8 @@ int lease_db_find_by_ip_safe(struct lease_database_t *db, struct in_addr ip, str
  * @param out_lease Output buffer to copy the lease data.
  * @return 0 on success (lease found), -1 on failure (not found).
  *
- * Copies lease data to out_lease to avoid holding the lock.
- * Automatically locks/unlocks the database during operation.
+ * Copies lease data to out_lease to avoid holding the lock. Locks one shard
+ * at a time while it looks through them.
  */
 int lease_db_find_by_mac_safe(struct lease_database_t *db, const uint8_t mac[6], struct dhcp_lease_t *out_lease);
 
@@ -554,8 +873,8 @@ int lease_db_find_by_mac_safe(struct lease_database_t *db, const uint8_t mac[6],
  * @param out_lease Output buffer to copy the lease data.
  * @return 0 on success (lease found), -1 on failure (not found).
  *
- * Copies lease data to out_lease to avoid holding the lock.
- * Automatically locks/unlocks the database during operation.
+ * Copies lease data to out_lease to avoid holding the lock. Locks one shard
+ * at a time while it looks through them.
  */
 int lease_db_find_by_id_safe(struct lease_database_t *db, uint64_t lease_id, struct dhcp_lease_t *out_lease);
 
@@ -589,6 +908,25 @@ int lease_db_renew_lease_safe(struct lease_database_t *db, struct in_addr ip, ui
  */
 int lease_db_expire_old_leases_safe(struct lease_database_t *db);
 
+/**
+ * @brief Thread-safe version of lease_db_expire_due.
+ * @param db Pointer to the lease database structure.
+ * @param now Current time.
+ * @param on_expire Called for each lease expired (may be NULL).
+ * @param arg Passed to on_expire.
+ * @return Number of leases expired.
+ *
+ * Locks one shard at a time, so packet workers keep running on the others.
+ */
+int lease_db_expire_due_safe(struct lease_database_t *db, time_t now, lease_expiry_fn on_expire, void *arg);
+
+/**
+ * @brief Thread-safe version of lease_db_next_expiry.
+ * @param db Pointer to the lease database structure.
+ * @return end_time of the next lease due (possibly stale), or 0 if none is scheduled.
+ */
+time_t lease_db_next_expiry_safe(struct lease_database_t *db);
+
 /**
  * @brief Thread-safe version of lease_db_cleanup_expired.
  * @param db Pointer to the lease database structure.
@@ -615,7 +953,7 @@ int lease_db_save_safe(struct lease_database_t *db);
  * @brief Initialize a lease timer for automatic expiration checks.
  * @param timer Pointer to the lease_timer_t structure.
  * @param db Pointer to the lease database to monitor.
- * @param check_interval_sec How often to check for expired leases (in seconds).
+ * @param check_interval_sec Longest time between checks for expired leases (in seconds).
  * @return 0 on success, -1 on failure.
  *
  * Initializes the timer structure but does not start the thread.
@@ -623,12 +961,23 @@ int lease_db_save_safe(struct lease_database_t *db);
  */
 int lease_timer_init(struct lease_timer_t *timer, struct lease_database_t *db, uint32_t check_interval_sec);
 
+/**
+ * @brief Register where expired leases are reported.
+ * @param timer Pointer to the lease_timer_t structure.
+ * @param on_expire Called for each lease the timer expires (NULL to stop reporting).
+ * @param arg Passed to on_expire.
+ *
+ * Call before lease_timer_start(). Used to return expired addresses to
+ * their ip_pool_t as they expire.
+ */
+void lease_timer_set_expiry_callback(struct lease_timer_t *timer, lease_expiry_fn on_expire, void *arg);
+
 /**
  * @brief Start the timer thread.
  * @param timer Pointer to the lease_timer_t structure.
  * @return 0 on success, -1 on failure.
  *
- * Starts a background thread that periodically checks for expired leases.
+ * Starts a background thread that expires leases as their end time passes.
  * The thread runs until lease_timer_stop() is called.
  */
 int lease_timer_start(struct lease_timer_t *timer);
@@ -666,12 +1015,15 @@ bool lease_timer_is_running(const struct lease_timer_t *timer);
  * @brief Initialize the I/O queue for async disk operations.
  * @param io_queue Pointer to the lease_io_queue_t structure.
  * @param db Pointer to the lease database.
+ * @param config Ring size, backpressure policy and statistics target (NULL for defaults).
  * @return 0 on success, -1 on failure.
  *
- * Initializes the I/O queue structure but does not start the thread.
- * Call lease_io_start() to begin processing operations.
+ * Allocates the ring and opens the lease journal next to db->filename, but
+ * does not start the thread. Call lease_io_start() to begin processing
+ * operations.
  */
-int lease_io_init(struct lease_io_queue_t *io_queue, struct lease_database_t *db);
+int lease_io_init(struct lease_io_queue_t *io_queue, struct lease_database_t *db,
+                  const struct lease_io_config_t *config);
 
 /**
  * @brief Start the I/O thread.
@@ -687,7 +1039,8 @@ int lease_io_start(struct lease_io_queue_t *io_queue);
  * @param io_queue Pointer to the lease_io_queue_t structure.
  *
  * Gracefully stops the I/O thread, processes remaining operations,
- * and destroys all synchronization primitives.
+ * compacts the journal into a snapshot and destroys all synchronization
+ * primitives.
  */
 void lease_io_stop(struct lease_io_queue_t *io_queue);
 
@@ -695,20 +1048,24 @@ void lease_io_stop(struct lease_io_queue_t *io_queue);
  * @brief Queue a lease for async save (append to file).
  * @param io_queue Pointer to the lease_io_queue_t structure.
  * @param lease Pointer to the lease to save.
- * @return 0 on success, -1 on failure (queue full).
+ * @return 0 on success (queued or coalesced), -1 on failure (dropped).
  *
- * Non-blocking: adds the lease to the queue and returns immediately.
- * The I/O thread will append it to the lease file in the background.
+ * Lock-free on the fast path: claims a ring slot and copies the lease record
+ * into it. When the ring is full the configured backpressure policy applies:
+ * block until a slot frees, set the delta aside replacing any pending one
+ * for the same IP (coalesce; blocks once as many IPs as ring slots are set
+ * aside), or drop it.
  */
 int lease_io_queue_save_lease(struct lease_io_queue_t *io_queue, const struct dhcp_lease_t *lease);
 
 /**
  * @brief Queue a full database save operation.
  * @param io_queue Pointer to the lease_io_queue_t structure.
- * @return 0 on success, -1 on failure (queue full).
+ * @return 0 on success, -1 on failure.
  *
- * Non-blocking: queues a complete database save and returns immediately.
- * The I/O thread will perform the save in the background.
+ * Non-blocking: flags a complete database save and returns immediately.
+ * The I/O thread writes a snapshot and empties the journal in the background
+ * (it also does so on its own once the journal outgrows the database).
  */
 int lease_io_queue_save_all(struct lease_io_queue_t *io_queue);
 
@@ -760,14 +1117,14 @@ struct dhcp_server_t
  * @param server Pointer to the dhcp_server_t structure.
  * @param lease_file Path to the lease database file.
  * @param timer_interval Expiration check interval in seconds (0 to disable timer).
- * @param enable_async_io Enable async I/O queue (true/false).
+ * @param io_config Async I/O queue settings (NULL to disable the I/O queue).
  * @return 0 on success, -1 on failure.
  *
  * Initializes all server components but does not start threads.
  * Call dhcp_server_start() to begin operation.
  */
 int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file,
-                     uint32_t timer_interval, bool enable_async_io);
+                     uint32_t timer_interval, const struct lease_io_config_t *io_config);
 
 /**
  * @brief Start all server components.
@@ -0,0 +1,85 @@
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "dhcp_common.h"
+#include "dhcp_options.h"
+
+#define PACKET_POOL_SIZE 2048  // Slots preallocated at startup
+#define PACKET_RECV_BATCH 32   // Max datagrams pulled per recvmmsg() call
+#define PACKET_POOL_NIL 0xFFFFFFFFu
+#define PACKET_CONTROL_SIZE 64 // Ancillary data buffer (IP_PKTINFO)
+
+/**
+ * @brief One received datagram plus the metadata needed to answer it.
+ *
+ * Slots live in a preallocated slab owned by packet_pool_t and are handed to
+ * worker threads by pointer, so the receive path never touches the heap.
+ */
+struct packet_task_t
+{
+    struct dhcp_packet packet;
+    ssize_t len;
+    struct sockaddr_in client_addr;
+    struct in_addr local_addr; // Address of the receiving interface (IP_PKTINFO), 0 if unknown
+    struct dhcp_option_index_t options; // Filled by the worker before any option is looked at
+    int sockfd;        // Socket the datagram arrived on (replies go out the same way)
+    uint64_t recv_ns;  // CLOCK_MONOTONIC when it was received (processing latency)
+    _Alignas(struct cmsghdr) uint8_t control[PACKET_CONTROL_SIZE];
+    uint32_t next;     // Free-list link (slot index), only valid while the slot is free
+};
+
+/**
+ * @brief Fixed-size slab of packet_task_t slots with a lock-free free list.
+ *
+ * The free list is a Treiber stack over slot indices. The head packs a
+ * 32-bit generation tag with the 32-bit index so concurrent pop/push pairs
+ * cannot suffer from ABA.
+ */
+struct packet_pool_t
+{
+    struct packet_task_t *slots;
+    uint32_t capacity;
+    uint64_t free_head;       // (tag << 32) | index, PACKET_POOL_NIL when empty
+
+    // Statistics
+    uint64_t exhausted_count; // acquire() calls that found the pool empty
+};
+
+/**
+ * @brief Allocate the slab and thread every slot onto the free list.
+ * @param pool Pointer to the packet pool structure.
+ * @param capacity Number of slots to preallocate.
+ * @return 0 on success, -1 on failure.
+ */
+int packet_pool_init(struct packet_pool_t *pool, uint32_t capacity);
+
+/**
+ * @brief Release the slab. No slot may be in use when this is called.
+ * @param pool Pointer to the packet pool structure.
+ */
+void packet_pool_free(struct packet_pool_t *pool);
+
+/**
+ * @brief Take a free slot from the pool.
+ * @param pool Pointer to the packet pool structure.
+ * @return Pointer to a slot, or NULL if the pool is exhausted.
+ *
+ * Lock-free, safe to call from any thread.
+ */
+struct packet_task_t *packet_pool_acquire(struct packet_pool_t *pool);
+
+/**
+ * @brief Return a slot to the pool.
+ * @param pool Pointer to the packet pool structure.
+ * @param task Slot previously obtained from packet_pool_acquire().
+ *
+ * Lock-free, safe to call from any thread.
+ */
+void packet_pool_release(struct packet_pool_t *pool, struct packet_task_t *task);
+
+#endif // PACKET_POOL_H
@@ -0,0 +1,124 @@
+#ifndef PING_PROBE_H
+#define PING_PROBE_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PING_PROBE_SLOT_BITS 10
+#define PING_PROBE_MAX (1u << PING_PROBE_SLOT_BITS) // Probes in flight at once
+#define PING_PROBE_WHEEL_SLOTS 256   // Timer wheel buckets
+#define PING_PROBE_TICK_MS 10        // Timer wheel resolution
+#define PING_PROBE_IDLE_MS 1000      // Poll timeout with nothing in flight
+#define PING_PROBE_NIL 0xFFFFFFFFu
+
+typedef enum ping_probe_result_t
+{
+    PING_PROBE_FREE = 0,   // No echo reply before the timeout
+    PING_PROBE_IN_USE,     // Address answered: conflict
+    PING_PROBE_CANCELLED   // Prober stopped while the probe was in flight
+} ping_probe_result_t;
+
+/**
+ * @brief Completion callback, called exactly once per submitted probe.
+ *
+ * Runs on the prober thread (or in ping_prober_stop() for cancelled probes)
+ * without any prober lock held, so it may submit a new probe.
+ */
+typedef void (*ping_probe_cb_t)(void *arg, struct in_addr ip, ping_probe_result_t result);
+
+/**
+ * @brief One outstanding ICMP echo.
+ *
+ * The echo sequence number is (generation << PING_PROBE_SLOT_BITS) | slot,
+ * so a reply maps straight back to its slot and late replies to a reused
+ * slot are recognised by the generation.
+ */
+struct ping_probe_t
+{
+    struct in_addr ip;
+    uint16_t generation;
+    bool active;
+    uint64_t expire_tick;
+    uint32_t prev;        // Wheel bucket links (next doubles as free-list link)
+    uint32_t next;
+    ping_probe_cb_t cb;
+    void *arg;
+};
+
+struct ping_probe_completion_t
+{
+    ping_probe_cb_t cb;
+    void *arg;
+    struct in_addr ip;
+    ping_probe_result_t result;
+};
+
+/**
+ * @brief Asynchronous ICMP conflict prober.
+ *
+ * One long-lived raw ICMP socket and one thread serve every probe: submit
+ * sends the echo and returns immediately, the thread matches echo replies by
+ * id/sequence and expires unanswered probes from a hashed timer wheel, then
+ * runs the callbacks. Many probes can be in flight without holding workers.
+ */
+struct ping_prober_t
+{
+    int sockfd;
+    int wake_fd;                      // eventfd: wakes the thread when work arrives
+    uint16_t echo_id;
+
+    struct ping_probe_t probes[PING_PROBE_MAX];
+    uint32_t free_head;
+    uint32_t in_flight;
+    uint32_t wheel[PING_PROBE_WHEEL_SLOTS]; // Bucket heads
+    uint64_t current_tick;                  // Last tick the wheel was advanced to
+    struct ping_probe_completion_t completions[PING_PROBE_MAX]; // Prober thread scratch
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    bool running;
+    bool mutex_initialized;
+
+    // Statistics
+    uint64_t probes_sent;
+    uint64_t conflicts;
+    uint64_t timeouts;
+    uint64_t rejected;                // Submissions refused (full or send error)
+};
+
+/**
+ * @brief Open the raw ICMP socket and prepare the probe table.
+ * @param prober Pointer to the prober structure.
+ * @return 0 on success, -1 on failure (e.g. no CAP_NET_RAW).
+ */
+int ping_prober_init(struct ping_prober_t *prober);
+
+/**
+ * @brief Start the prober thread.
+ * @param prober Pointer to the prober structure.
+ * @return 0 on success, -1 on failure.
+ */
+int ping_prober_start(struct ping_prober_t *prober);
+
+/**
+ * @brief Stop the thread, cancel outstanding probes and close the socket.
+ * @param prober Pointer to the prober structure.
+ */
+void ping_prober_stop(struct ping_prober_t *prober);
+
+/**
+ * @brief Send an echo request and register its completion.
+ * @param prober Pointer to the prober structure.
+ * @param ip Address to probe.
+ * @param timeout_ms How long to wait for a reply.
+ * @param cb Completion callback.
+ * @param arg Opaque callback argument.
+ * @return 0 if the probe is in flight (cb will run), -1 if it was not started
+ *         (prober stopped, table full or send failure; cb will not run).
+ */
+int ping_prober_submit(struct ping_prober_t *prober, struct in_addr ip, uint32_t timeout_ms,
+                       ping_probe_cb_t cb, void *arg);
+
+#endif // PING_PROBE_H
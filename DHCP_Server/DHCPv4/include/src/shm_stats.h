@@ -1,23 +1,155 @@
 #ifndef SHM_STATS_V4
-#define SHM_STAT_V4
+#define SHM_STATS_V4
 
 #include <stdint.h>
 #include <time.h>
 
 #define SHM_STATS_V4_NAME "/dhcpv4_stats"
+#define SHM_STATS_V4_MAGIC 0x54533444u // "D4ST"
+#define SHM_STATS_V4_VERSION 3         // Bump on any change to the layout below
+
+#define SHM_STATS_HIST_BUCKETS 24 // log2 buckets: [0] = 0, [i] = [2^(i-1), 2^i), last is open-ended
+
+// Log-linear (HDR-style) histograms: values below 16 get a bucket each, every
+// power of two above is split into 8 buckets, so a bucket is at most 12.5%
+// wide. 256 buckets reach 2^34 (17 s in nanoseconds); the last is open-ended.
+#define SHM_STATS_HDR_SUB_BITS 3
+#define SHM_STATS_HDR_SUB_BUCKETS (1u << SHM_STATS_HDR_SUB_BITS)
+#define SHM_STATS_HDR_BUCKETS 256
+
+#define SHM_STATS_MAX_THREADS 80 // Counter slots: packet workers, receive thread, prober
+#define SHM_STATS_MAX_SUBNETS 32 // Matches MAX_SUBNETS of the configuration
+#define SHM_STATS_MSG_TYPES 9    // Indexed by DHCP message type (1 DISCOVER .. 8 INFORM), 0 = other
+
+/**
+ * @brief Lease I/O queue statistics.
+ *
+ * Written by the packet workers (enqueue side) and the lease I/O thread
+ * (commit side) with relaxed atomics; readers see a slightly torn but
+ * monotonic picture, which is fine for a dashboard.
+ */
+struct io_queue_stats_t
+{
+    volatile uint32_t capacity;       // Ring slots
+    volatile uint32_t backpressure;   // lease_io_backpressure_t in force
+    volatile uint64_t enqueued;       // Lease deltas accepted (ring or coalesced)
+    volatile uint64_t committed;      // Lease deltas written to the journal / lease file
+    volatile uint64_t dropped;        // Deltas lost to a full ring (drop policy, or I/O thread stopped)
+    volatile uint64_t coalesced;      // Deltas that replaced a pending delta for the same IP
+    volatile uint64_t blocked;        // Producer waits for space (block, or coalesce with the side table full)
+    volatile uint64_t batches;        // I/O thread wake-ups that committed something
+    volatile uint64_t depth;          // Deltas waiting when the I/O thread last looked
+
+    // Ring depth seen by the I/O thread at the start of each batch
+    volatile uint64_t depth_hist[SHM_STATS_HIST_BUCKETS];
+    // Enqueue -> durable latency per delta, in microseconds
+    volatile uint64_t latency_us_hist[SHM_STATS_HIST_BUCKETS];
+    // write() + fdatasync() of one journal group commit, in nanoseconds (HDR buckets)
+    volatile uint64_t fsync_ns_hist[SHM_STATS_HDR_BUCKETS];
+};
+
+/**
+ * @brief Counters of one server thread.
+ *
+ * Each thread that handles packets claims a slot of its own and is its only
+ * writer, so an update is a plain relaxed load and store: no locked
+ * instruction, and no cache line shared with another thread. The monitor
+ * adds the slots up.
+ */
+struct worker_stats_v4_t
+{
+    volatile uint64_t pkt_received;   // Datagrams pulled off a socket
+    volatile uint64_t pkt_processed;  // Valid DHCPv4 packets handled
+    volatile uint64_t pkt_invalid;    // Datagrams failing validation or option parsing
+    volatile uint64_t pkt_dropped;    // Dropped unanswered: unknown segment, or queue full
+    volatile uint64_t pkt_no_subnet;  // Of those, packets matching no configured subnet
+    volatile uint64_t errors;         // Requests that could not be served (no address, lease failure)
+    volatile uint64_t msg_count[SHM_STATS_MSG_TYPES]; // Received DISCOVER/REQUEST/..., sent OFFER/ACK/NAK
+
+    // Receive -> handled, in nanoseconds (HDR buckets); includes the wait in
+    // the thread pool queue
+    volatile uint64_t processing_ns_hist[SHM_STATS_HDR_BUCKETS];
+} __attribute__((aligned(64)));
+
+/**
+ * @brief Address usage of one subnet's pool, published once a second.
+ */
+struct subnet_stats_v4_t
+{
+    uint32_t network;   // Network byte order
+    uint32_t prefix_len;
+    uint32_t pool_size;
+    uint32_t allocated;
+    uint32_t available;
+    uint32_t reserved;  // pool_size - allocated - available: reserved, excluded, probing, conflict
+};
 
 /**
  * @brief Shared Memory Statistics Structure.
  * This structure is mapped into memory by both Server (RW) and Monitor (RO).
+ *
+ * The header (magic, version, size) lets a monitor refuse a segment laid out
+ * by a different build; magic is written last, once the rest is initialized.
+ * The subnet table changes as a whole on reload, so it is guarded by a
+ * sequence counter: odd while the server rewrites it, readers retry.
  */
 struct server_v4_stats_t
 {
-    time_t start_time; // timestamp when server started
+    volatile uint32_t magic;          // SHM_STATS_V4_MAGIC once the segment is ready
+    uint32_t version;                 // SHM_STATS_V4_VERSION
+    uint64_t size;                    // sizeof(struct server_v4_stats_t)
+    time_t start_time;                // timestamp when server started
+
+    volatile uint32_t thread_count;   // Slots of threads[] claimed so far
+    volatile uint32_t subnet_seq;     // Sequence counter of subnets[]
+    volatile uint32_t subnet_count;
+    volatile uint64_t config_generation;
+    volatile uint64_t leases_active;  // Addresses allocated across all pools
+    volatile time_t published_at;     // Last refresh of the subnet table and gauges
 
-    volatile uint64_t pkt_received;     // Total UDP packets received
-    volatile uint64_t pkt_processed;    // Valid DHCPv4 packets processed
-    volatile uint64_t leases_active;    // Current number of active leases (NA + PD)
-    volatile uint64_t errors_count;     // Total error events logged
+    struct io_queue_stats_t lease_io; // Lease persistence queue
+    struct subnet_stats_v4_t subnets[SHM_STATS_MAX_SUBNETS];
+    struct worker_stats_v4_t threads[SHM_STATS_MAX_THREADS];
 };
 
-#endif // SHM_STATS_V4
\ No newline at end of file
+/**
+ * @brief Histogram bucket for a value (see SHM_STATS_HIST_BUCKETS).
+ * @param value Sample.
+ * @return Bucket index.
+ */
+static inline uint32_t shm_stats_bucket(uint64_t value)
+{
+    uint32_t bucket = value ? 64 - (uint32_t)__builtin_clzll(value) : 0;
+    return bucket < SHM_STATS_HIST_BUCKETS ? bucket : SHM_STATS_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief HDR histogram bucket for a value (see SHM_STATS_HDR_BUCKETS).
+ * @param value Sample.
+ * @return Bucket index.
+ */
+static inline uint32_t shm_stats_hdr_bucket(uint64_t value)
+{
+    if (value < 2 * SHM_STATS_HDR_SUB_BUCKETS)
+        return (uint32_t)value;
+    uint32_t exponent = 63 - (uint32_t)__builtin_clzll(value);
+    uint32_t bucket = (exponent - SHM_STATS_HDR_SUB_BITS) * SHM_STATS_HDR_SUB_BUCKETS +
+                      (uint32_t)(value >> (exponent - SHM_STATS_HDR_SUB_BITS));
+    return bucket < SHM_STATS_HDR_BUCKETS ? bucket : SHM_STATS_HDR_BUCKETS - 1;
+}
+
+/**
+ * @brief Smallest value counted in an HDR histogram bucket.
+ * @param bucket Bucket index.
+ * @return Lower bound of the bucket; bucket + 1 gives the (exclusive) upper bound.
+ */
+static inline uint64_t shm_stats_hdr_lower(uint32_t bucket)
+{
+    if (bucket < 2 * SHM_STATS_HDR_SUB_BUCKETS)
+        return bucket;
+    uint32_t exponent = bucket / SHM_STATS_HDR_SUB_BUCKETS + SHM_STATS_HDR_SUB_BITS - 1;
+    uint64_t mantissa = bucket % SHM_STATS_HDR_SUB_BUCKETS + SHM_STATS_HDR_SUB_BUCKETS;
+    return mantissa << (exponent - SHM_STATS_HDR_SUB_BITS);
+}
+
+#endif // SHM_STATS_V4
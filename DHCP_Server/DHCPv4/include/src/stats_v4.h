@@ -0,0 +1,90 @@
+#ifndef STATS_V4_H
+#define STATS_V4_H
+
+#include <stdint.h>
+
+#include "config_version.h"
+#include "shm_stats.h"
+
+/*
+ * Writer side of the shared-memory metrics segment (see shm_stats.h).
+ *
+ * Hot-path counters go to the calling thread's own slot: the first call of
+ * stats_v4_slot() on a thread claims one, later calls are a thread-local
+ * read. A thread that finds no slot (segment not mapped, or all taken) gets
+ * a private one nobody reads, so callers never check.
+ */
+
+extern _Thread_local struct worker_stats_v4_t *stats_v4_thread_slot;
+
+/**
+ * @brief Create and map the segment, and publish its header.
+ * @return The mapped segment, or NULL if shared memory is unavailable (the
+ *         server then runs without live statistics).
+ */
+struct server_v4_stats_t *stats_v4_open(void);
+
+/**
+ * @brief Unmap and remove the segment.
+ *
+ * Only once every other thread that counted is gone: their slots point into it.
+ */
+void stats_v4_close(void);
+
+/**
+ * @brief Claim a slot for the calling thread (slow path of stats_v4_slot()).
+ * @return The thread's slot.
+ */
+struct worker_stats_v4_t *stats_v4_claim_slot(void);
+
+/**
+ * @brief Slot of the calling thread.
+ * @return Never NULL.
+ */
+static inline struct worker_stats_v4_t *stats_v4_slot(void)
+{
+    struct worker_stats_v4_t *slot = stats_v4_thread_slot;
+    return slot ? slot : stats_v4_claim_slot();
+}
+
+/**
+ * @brief Add to a counter of the calling thread's slot.
+ * @param counter Field of stats_v4_slot(); only this thread writes it.
+ * @param n Amount to add.
+ *
+ * Single writer: a relaxed load and store, atomic only so that the monitor
+ * never reads a torn value.
+ */
+static inline void stats_v4_add(volatile uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Count a DHCP message received or sent by the calling thread.
+ * @param msg_type DHCP message type (Option 53); unknown types count as 0.
+ */
+static inline void stats_v4_count_message(uint8_t msg_type)
+{
+    stats_v4_add(&stats_v4_slot()->msg_count[msg_type < SHM_STATS_MSG_TYPES ? msg_type : 0], 1);
+}
+
+/**
+ * @brief Record the receive -> handled time of one packet.
+ * @param ns Nanoseconds.
+ */
+static inline void stats_v4_record_processing(uint64_t ns)
+{
+    stats_v4_add(&stats_v4_slot()->processing_ns_hist[shm_stats_hdr_bucket(ns)], 1);
+}
+
+/**
+ * @brief Refresh the subnet table and the gauges from a configuration generation.
+ * @param version Generation the caller holds a read section on.
+ *
+ * Reads the pools' atomic counters only; meant to run about once a second
+ * from one thread.
+ */
+void stats_v4_publish(const struct config_version_t *version);
+
+#endif // STATS_V4_H
@@ -0,0 +1,73 @@
+#ifndef SUBNET_TRIE_H
+#define SUBNET_TRIE_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include "config_v4.h"
+
+#define SUBNET_TRIE_STRIDE 8                          // Address bits consumed per level
+#define SUBNET_TRIE_FANOUT (1u << SUBNET_TRIE_STRIDE) // Slots per node
+
+/**
+ * @brief One slot of a trie node.
+ *
+ * subnet is the best (longest) prefix ending at this level that covers the
+ * slot, or -1. child is the node holding longer prefixes below this slot
+ * (0 = none; node 0 is the root and never a child).
+ */
+struct subnet_trie_slot_t
+{
+    int32_t subnet;
+    uint8_t prefix_len;
+    uint32_t child;
+};
+
+struct subnet_trie_node_t
+{
+    struct subnet_trie_slot_t slots[SUBNET_TRIE_FANOUT];
+};
+
+/**
+ * @brief Longest-prefix-match index from an IPv4 address to a configured subnet.
+ *
+ * A multibit trie with 8-bit strides, compiled from dhcp_config_t.subnets:
+ * prefixes that do not end on a stride boundary are expanded into every slot
+ * they cover. A lookup reads at most one slot per address byte (four memory
+ * accesses) regardless of how many subnets are configured.
+ *
+ * The trie is read-only once built, so lookups need no locking.
+ */
+struct subnet_trie_t
+{
+    struct subnet_trie_node_t *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+};
+
+/**
+ * @brief Build the trie from the subnets of a configuration.
+ * @param trie Pointer to the trie to initialize.
+ * @param config Parsed configuration; subnet i maps to value i.
+ * @return 0 on success, -1 on failure.
+ *
+ * When two subnets declare the same prefix the first one wins, as with
+ * find_subnet_for_ip().
+ */
+int subnet_trie_build(struct subnet_trie_t *trie, const struct dhcp_config_t *config);
+
+/**
+ * @brief Release the trie.
+ * @param trie Pointer to the trie.
+ */
+void subnet_trie_free(struct subnet_trie_t *trie);
+
+/**
+ * @brief Find the most specific subnet containing an address.
+ * @param trie Pointer to the trie.
+ * @param ip Address to look up (network byte order).
+ * @return Index into config->subnets, or -1 if no subnet matches.
+ */
+int subnet_trie_lookup(const struct subnet_trie_t *trie, struct in_addr ip);
+
+#endif // SUBNET_TRIE_H
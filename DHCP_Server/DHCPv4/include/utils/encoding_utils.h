@@ -15,6 +15,16 @@
  */
 int parse_client_id_from_string(const char *str, uint8_t *client_id, uint32_t *len);
 
+/**
+ * @brief Parse client ID like parse_client_id_from_string, from a string that need not be NUL-terminated
+ * @param str Start of the input (e.g. a token inside a memory-mapped lease file)
+ * @param str_len Number of bytes available at str
+ * @param client_id Output buffer for client ID bytes (MAX_CLIENT_ID_LEN)
+ * @param len Output length of parsed client ID
+ * @return 0 on success, -1 on failure
+ */
+int parse_client_id_from_span(const char *str, size_t str_len, uint8_t *client_id, uint32_t *len);
+
 /**
  * @brief Format client ID to ISC DHCP octal-escaped string format
  * @param client_id Input client ID bytes
@@ -24,4 +34,13 @@ int parse_client_id_from_string(const char *str, uint8_t *client_id, uint32_t *l
  */
 void format_client_id_to_string(const uint8_t *client_id, uint32_t len, char *output, size_t output_len);
 
+/**
+ * @brief Compute or continue a CRC-32 (IEEE 802.3, as used by zlib)
+ * @param crc 0 to start, or the result of the previous call to continue
+ * @param data Input bytes
+ * @param len Number of bytes
+ * @return Updated CRC-32
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
 #endif // ENCODING_UTILS_H
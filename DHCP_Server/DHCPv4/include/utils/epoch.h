@@ -0,0 +1,72 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define EPOCH_MAX_THREADS 256 // Reader threads per domain
+
+/* Epoch a reader published on entry; 0 while it is outside any read section */
+struct epoch_slot_t
+{
+    _Alignas(64) atomic_uint_fast64_t epoch;
+    atomic_bool in_use;
+};
+
+/*
+ * Epoch-based reclamation for read-mostly data published through an atomic
+ * pointer (RCU style).
+ *
+ * Readers bracket every use of the published object with epoch_enter() and
+ * epoch_exit(). Neither takes a lock: entering stores the current global
+ * epoch in the thread's own slot, exiting clears it. A writer swaps the
+ * pointer, then calls epoch_synchronize(), which advances the global epoch
+ * and waits until every slot is either clear or has entered since; no reader
+ * can still see the old object after that, so the writer frees it.
+ *
+ * A thread claims a slot the first time it enters and keeps it until
+ * epoch_thread_exit(). Threads beyond EPOCH_MAX_THREADS share a reader count
+ * instead, which epoch_synchronize() waits to see drop to zero. Read sections
+ * may nest.
+ */
+struct epoch_domain_t
+{
+    _Alignas(64) atomic_uint_fast64_t global;
+    _Alignas(64) atomic_uint overflow_readers;
+    struct epoch_slot_t slots[EPOCH_MAX_THREADS];
+};
+
+/**
+ * @brief Initialize an epoch domain.
+ * @param domain Pointer to the domain.
+ */
+void epoch_domain_init(struct epoch_domain_t *domain);
+
+/**
+ * @brief Enter a read section.
+ * @param domain Pointer to the domain.
+ */
+void epoch_enter(struct epoch_domain_t *domain);
+
+/**
+ * @brief Leave the read section entered by the matching epoch_enter().
+ * @param domain Pointer to the domain.
+ */
+void epoch_exit(struct epoch_domain_t *domain);
+
+/**
+ * @brief Wait until no reader can still hold what was published before the call.
+ * @param domain Pointer to the domain.
+ *
+ * Must not be called from inside a read section of the same domain.
+ */
+void epoch_synchronize(struct epoch_domain_t *domain);
+
+/**
+ * @brief Give the calling thread's slot back (for threads that come and go).
+ * @param domain Pointer to the domain.
+ */
+void epoch_thread_exit(struct epoch_domain_t *domain);
+
+#endif /* EPOCH_H */
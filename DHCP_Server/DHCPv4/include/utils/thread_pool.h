@@ -2,7 +2,9 @@
 #define THREAD_POOL_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Task function signature */
 typedef void (*thread_func_t)(void *arg);
@@ -14,27 +16,91 @@ struct thread_task_t
     void *argument;
 };
 
+/*
+ * Work-stealing executor. Every worker owns two queues:
+ *  - an inbox (bounded lock-free MPMC ring) that thread_pool_add() and
+ *    thread_pool_add_batch() fill round-robin from any thread;
+ *  - a deque (Chase-Lev) that only the worker itself pushes to, used for
+ *    tasks submitted from inside a task. The owner pops LIFO, thieves take
+ *    FIFO from the other end.
+ * An idle worker runs its deque, then its inbox, then steals from the inboxes
+ * and deques of the others; it spins for a while before parking on a
+ * condition variable that submitters only touch when someone is parked.
+ */
+
+/* One slot of a worker deque; stealers may read it while the owner rewrites it */
+struct thread_deque_slot_t
+{
+    _Atomic(thread_func_t) function;
+    _Atomic(void *) argument;
+};
+
+/* One cell of an inbox ring; seq tells producers and consumers whose turn it is */
+struct thread_inbox_cell_t
+{
+    atomic_size_t seq;
+    struct thread_task_t task;
+};
+
+/* Per-worker counters, as returned by thread_pool_get_stats() */
+struct thread_pool_stats_t
+{
+    uint64_t tasks_run; // Tasks executed by this worker
+    uint64_t steals;    // Tasks taken from another worker's queues
+    uint64_t parks;     // Times the worker went to sleep
+    uint64_t idle_ns;   // Time spent looking for work (spinning or parked), added as each wait ends
+};
+
+struct thread_pool_t;
+
+/* Worker state, one cache line group per worker */
+struct thread_pool_worker_t
+{
+    struct thread_pool_t *pool;
+    pthread_t thread;
+    int id;
+    uint32_t rng; // Victim selection
+
+    // Deque: owner pushes/pops at bottom, thieves take from top
+    struct thread_deque_slot_t *deque;
+    int64_t deque_mask;
+    _Alignas(64) atomic_llong top;
+    _Alignas(64) atomic_llong bottom;
+
+    // Inbox: any thread enqueues, owner and thieves dequeue
+    struct thread_inbox_cell_t *inbox;
+    size_t inbox_mask;
+    _Alignas(64) atomic_size_t enqueue_pos;
+    _Alignas(64) atomic_size_t dequeue_pos;
+
+    // Written by the owner only, read by thread_pool_get_stats()
+    _Alignas(64) _Atomic uint64_t tasks_run;
+    _Atomic uint64_t steals;
+    _Atomic uint64_t parks;
+    _Atomic uint64_t idle_ns;
+};
+
 /* Thread pool structure */
 struct thread_pool_t
 {
-    pthread_mutex_t lock;
-    pthread_cond_t notify;
-    pthread_t *threads;
-    struct thread_task_t *queue;
+    struct thread_pool_worker_t *workers;
     int thread_count;
-    int queue_size;
-    int head;
-    int tail;
-    int count;
-    int shutdown;
     int started;
+    atomic_int shutdown; // 0 running, 1 drain then stop, 2 stop now
+    _Alignas(64) atomic_uint next_inbox; // Round-robin cursor for external submits
+
+    // Parking: submitters only take park_lock when sleepers > 0
+    _Alignas(64) atomic_int sleepers;
+    pthread_mutex_t park_lock;
+    pthread_cond_t park_cond;
 };
 
 /**
  * @brief Initialize the thread pool
  *
  * @param num_threads Number of worker threads to create
- * @param queue_size Maximum number of queued tasks
+ * @param queue_size Maximum number of queued tasks, split across the workers'
+ *                   inboxes (each inbox is rounded up to a power of two)
  * @return thread_pool_t* Pointer to created pool or NULL on failure
  */
 struct thread_pool_t *thread_pool_create(int num_threads, int queue_size);
@@ -42,13 +108,40 @@ struct thread_pool_t *thread_pool_create(int num_threads, int queue_size);
 /**
  * @brief Add work to the thread pool
  *
+ * Called from a worker of this pool, the task goes to that worker's own deque;
+ * from any other thread it goes to the next worker's inbox.
+ *
  * @param pool Pointer to the thread pool
  * @param function Function to execute
  * @param argument Argument to pass to the function
- * @return 0 on success, -1 on failure
+ * @return 0 on success, -1 on failure (queues full or shutting down)
  */
 int thread_pool_add(struct thread_pool_t *pool, thread_func_t function, void *argument);
 
+/**
+ * @brief Add several tasks running the same function
+ *
+ * Tasks are spread over the inboxes and sleeping workers are woken once for
+ * the whole batch rather than once per task.
+ *
+ * @param pool Pointer to the thread pool
+ * @param function Function to execute
+ * @param arguments Argument of each task
+ * @param count Number of tasks
+ * @return Number of tasks queued (a prefix of arguments), -1 on failure
+ */
+int thread_pool_add_batch(struct thread_pool_t *pool, thread_func_t function, void *const *arguments, int count);
+
+/**
+ * @brief Read the per-worker counters
+ *
+ * @param pool Pointer to the thread pool
+ * @param stats Output array
+ * @param max Capacity of stats
+ * @return Number of entries written (one per worker)
+ */
+int thread_pool_get_stats(struct thread_pool_t *pool, struct thread_pool_stats_t *stats, int max);
+
 /**
  * @brief Destroy the thread pool
  *
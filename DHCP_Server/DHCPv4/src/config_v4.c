@@ -4,6 +4,8 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include "../include/src/config_v4.h"
+#include "../include/src/dhcp_message.h"
+#include "../include/src/lease_v4.h"
 #include "../include/utils/string_utils.h"
 #include "../include/utils/file_utils.h"
 #include "../include/utils/network_utils.h"
@@ -33,13 +35,12 @@ static int parse_subnet_option(char *line, struct dhcp_subnet_t *subnet);
 /**
  * @brief Parse a host reservation block within a subnet.
  * @param fp File pointer to read from.
- * @param subnet Pointer to the subnet structure to populate.
- * @return 0 on success (host_count incremented),
- *         -1 if fp or subnet is NULL,
- *         -2 if parsing fails for host options,
- *         -3 if maximum host count is reached
+ * @param host Pointer to the reservation to populate (name already set).
+ * @return 0 on success (closing brace reached),
+ *         -1 if fp or host is NULL,
+ *         -2 if parsing fails for host options or the block is not closed
  */
-static int parse_host_block(FILE *fp, struct dhcp_subnet_t *subnet);
+static int parse_host_block(FILE *fp, struct dhcp_host_reservation_t *host);
 
 /**
  * @brief Parse a subnet block from the configuration file.
@@ -259,6 +260,31 @@ static int parse_global_option(char *line, struct dhcp_global_options_t *global)
     {
         global->update_conflict_detection = (strcmp(value, "true") == 0);
     }
+    else if (strcmp(key, "worker-threads") == 0)
+    {
+        if (parse_uint32(value, &global->worker_threads) != 0 || global->worker_threads == 0)
+            return -2;
+    }
+    else if (strcmp(key, "worker-reuseport") == 0)
+    {
+        global->worker_reuseport = (strcmp(value, "true") == 0);
+    }
+    else if (strcmp(key, "worker-cpu-affinity") == 0)
+    {
+        global->worker_cpu_affinity = (strcmp(value, "true") == 0);
+    }
+    else if (strcmp(key, "lease-io-queue-size") == 0)
+    {
+        if (parse_uint32(value, &global->lease_io_queue_size) != 0 || global->lease_io_queue_size == 0 ||
+            global->lease_io_queue_size > LEASE_IO_MAX_QUEUE_SIZE)
+            return -2;
+    }
+    else if (strcmp(key, "lease-io-backpressure") == 0)
+    {
+        global->lease_io_backpressure = lease_io_backpressure_from_string(value);
+        if (global->lease_io_backpressure == LEASE_IO_BACKPRESSURE_UNKNOWN)
+            return -2;
+    }
 
     return 0;
 }
@@ -432,16 +458,36 @@ static int parse_subnet_option(char *line, struct dhcp_subnet_t *subnet)
     return 0;
 }
 
-static int parse_host_block(FILE *fp, struct dhcp_subnet_t *subnet)
+// option dhcp-client-identifier: a quoted string (octal escapes allowed) or colon-separated hex bytes
+static int parse_host_client_id(const char *value, struct dhcp_host_reservation_t *host)
 {
-    if (!fp || !subnet)
-        return -1;
+    if (value[0] == '"')
+        return parse_client_id_from_string(value, host->client_id, &host->client_id_len);
 
-    if (subnet->host_count >= MAX_HOSTS_PER_SUBNET)
-        return -3;
+    host->client_id_len = 0;
+    const char *ptr = value;
+    while (*ptr)
+    {
+        char *end;
+        unsigned long byte = strtoul(ptr, &end, 16);
+        if (end == ptr || byte > 0xFF || host->client_id_len >= MAX_CLIENT_ID_LEN)
+            return -1;
+        host->client_id[host->client_id_len++] = (uint8_t)byte;
+        ptr = end;
+        if (*ptr == ':')
+            ptr++;
+        else if (*ptr)
+            return -1;
+    }
+    return host->client_id_len > 0 ? 0 : -1;
+}
+
+static int parse_host_block(FILE *fp, struct dhcp_host_reservation_t *host)
+{
+    if (!fp || !host)
+        return -1;
 
     char line[MAX_LINE_LEN];
-    struct dhcp_host_reservation_t *host = &subnet->hosts[subnet->host_count];
 
     while (fgets(line, sizeof(line), fp))
     {
@@ -457,10 +503,7 @@ static int parse_host_block(FILE *fp, struct dhcp_subnet_t *subnet)
             continue;
 
         if (strchr(trimmed, '}'))
-        {
-            subnet->host_count++;
-            break;
-        }
+            return 0;
 
         char *token = strtok(trimmed, " \t");
         if (!token)
@@ -505,7 +548,17 @@ static int parse_host_block(FILE *fp, struct dhcp_subnet_t *subnet)
         else if (strcmp(token, "option") == 0)
         {
             char *opt_name = strtok(NULL, " \t");
-            if (opt_name && strcmp(opt_name, "host-name") == 0)
+            if (opt_name && strcmp(opt_name, "dhcp-client-identifier") == 0)
+            {
+                char *client_id = strtok(NULL, ";");
+                client_id = client_id ? trim(client_id) : NULL;
+                if (!client_id || parse_host_client_id(client_id, host) != 0)
+                {
+                    fprintf(stderr, "Warning: Failed to parse client identifier in host block\n");
+                    return -2;
+                }
+            }
+            else if (opt_name && strcmp(opt_name, "host-name") == 0)
             {
                 char *hostname = strtok(NULL, ";");
                 if (hostname)
@@ -528,7 +581,8 @@ static int parse_host_block(FILE *fp, struct dhcp_subnet_t *subnet)
         }
     }
 
-    return 0;
+    fprintf(stderr, "Warning: Host block not closed\n");
+    return -2;
 }
 
 static int parse_subnet_block(FILE *fp, struct dhcp_config_t *config, char *first_line)
@@ -598,7 +652,7 @@ static int parse_subnet_block(FILE *fp, struct dhcp_config_t *config, char *firs
         if (strncmp(trimmed, "host", 4) == 0)
         {
             char *host_name = strtok(trimmed + 4, " \t{");
-            if (host_name && subnet->host_count < MAX_HOSTS_PER_SUBNET)
+            if (host_name)
             {
                 host_name = trim(host_name);
                 if (!host_name)
@@ -607,16 +661,15 @@ static int parse_subnet_block(FILE *fp, struct dhcp_config_t *config, char *firs
                     advance_to_next_closed_brace(fp);
                     continue;
                 }
-                strncpy(subnet->hosts[subnet->host_count].name, host_name, MAX_HOSTNAME_LENGTH - 1);
-
-                int result = parse_host_block(fp, subnet);
-
-                // Note: host_count is only incremented in parse_host_block on success
-                // So if there was an error, we don't increment host_count and overwrite the same slot
-                if (result != 0)
-                {
-                    fprintf(stderr, "Warning: Host '%s' has errors, will be overwriten\n", host_name);
-                }
+                struct dhcp_host_reservation_t host;
+                memset(&host, 0, sizeof(host));
+                strncpy(host.name, host_name, MAX_HOSTNAME_LENGTH - 1);
+
+                // Hosts of this subnet follow each other in the table; a host with errors is skipped
+                if (parse_host_block(fp, &host) != 0)
+                    fprintf(stderr, "Warning: Host '%s' has errors, skipped\n", host.name);
+                else if (host_table_append(&config->host_table, &host) == 0)
+                    subnet->host_count++;
             }
         }
         else
@@ -702,6 +755,9 @@ int parse_config_file(const char *filename, struct dhcp_config_t *config)
     memset(config, 0, sizeof(struct dhcp_config_t));
     config->global.allow_unknown_clients = true; // Default
     config->global.allow_bootp = true;           // Default
+    config->global.worker_threads = 4;           // Default
+    config->global.lease_io_queue_size = LEASE_IO_DEFAULT_QUEUE_SIZE;
+    config->global.lease_io_backpressure = LEASE_IO_COALESCE;
 
     char line[MAX_LINE_LEN];
     while (fgets(line, sizeof(line), fp))
@@ -718,12 +774,15 @@ int parse_config_file(const char *filename, struct dhcp_config_t *config)
 
         if (strncmp(trimmed, "subnet", 6) == 0)
         {
+            uint32_t hosts_before = config->host_table.count;
             int result = parse_subnet_block(fp, config, trimmed);
 
             // Note: subnet_count is only incremented in parse_subnet_block on success
             // So if there was an error, we don't increment subnet_count and overwrite the same slot
+            // (the hosts it added are dropped with it)
             if (result != 0)
             {
+                config->host_table.count = hosts_before;
                 fprintf(stderr, "Warning: Failed to parse subnet block, continuing with other entries\n");
                 advance_to_next_closed_brace(fp); // Skip to the end of the faulty subnet block
                 // Continue parsing other subnets
@@ -742,14 +801,26 @@ int parse_config_file(const char *filename, struct dhcp_config_t *config)
 
     fclose(fp);
 
+    if (host_table_build(&config->host_table, config) != 0)
+    {
+        fprintf(stderr, "Failed to index host reservations\n");
+        free_config(config);
+        return -2;
+    }
+
+    // Encode each subnet's reply options once; OFFER/ACK copy them from here
+    for (uint32_t i = 0; i < config->subnet_count; i++)
+    {
+        if (dhcp_message_build_template(&config->subnets[i].reply_template, &config->subnets[i]) != 0)
+            fprintf(stderr, "Warning: Subnet %u has more options than fit in a reply\n", i);
+    }
+
     // Print summary
     fprintf(stderr, "\n=== Configuration Parse Summary ===\n");
     fprintf(stderr, "Subnets loaded: %u\n", config->subnet_count);
+    fprintf(stderr, "Host reservations: %u\n", config->host_table.count);
     fprintf(stderr, "===================================\n\n");
 
-
-    
-
     return 0;
 }
 
@@ -772,21 +843,6 @@ struct dhcp_subnet_t *find_subnet_for_ip(const struct dhcp_config_t *config, con
     return NULL;
 }
 
-struct dhcp_host_reservation_t *find_host_by_mac(const struct dhcp_subnet_t *subnet, const uint8_t mac[6])
-{
-    if (!subnet || !mac)
-        return NULL;
-
-    for (uint32_t i = 0; i < subnet->host_count; i++)
-    {
-        if (memcmp(subnet->hosts[i].mac_address, mac, 6) == 0)
-        {
-            return (struct dhcp_host_reservation_t *)&subnet->hosts[i];
-        }
-    }
-    return NULL;
-}
-
 void print_config(const struct dhcp_config_t *config)
 {
     char ip_str[INET_ADDRSTRLEN];
@@ -810,6 +866,19 @@ void print_config(const struct dhcp_config_t *config)
     printf("    DDNS Update Style:      %s\n", ddns_style_str);
     printf("\n");
 
+    // Worker Model
+    printf("  Packet Workers:\n");
+    printf("    Worker Threads:         %u\n", config->global.worker_threads);
+    printf("    SO_REUSEPORT Sockets:   %s\n", config->global.worker_reuseport ? "yes" : "no");
+    printf("    CPU Affinity:           %s\n", config->global.worker_cpu_affinity ? "yes" : "no");
+    printf("\n");
+
+    // Lease persistence
+    printf("  Lease I/O Queue:\n");
+    printf("    Queue Size:             %u\n", config->global.lease_io_queue_size);
+    printf("    Backpressure:           %s\n", lease_io_backpressure_to_string(config->global.lease_io_backpressure));
+    printf("\n");
+
     // Lease Times
     printf("  Lease Times:\n");
     printf("    Default Lease Time:     %u seconds (%f hours)\n",
@@ -1013,6 +1082,13 @@ void print_config(const struct dhcp_config_t *config)
                        subnet->hosts[j].mac_address[5]);
                 if (strlen(subnet->hosts[j].hostname) > 0)
                     printf("  Hostname: %s", subnet->hosts[j].hostname);
+                if (subnet->hosts[j].client_id_len > 0)
+                {
+                    char client_id_str[MAX_CLIENT_ID_LEN * 4 + 3]; // Quoted octal escapes
+                    format_client_id_to_string(subnet->hosts[j].client_id, subnet->hosts[j].client_id_len,
+                                               client_id_str, sizeof(client_id_str));
+                    printf("  Client ID: %s", client_id_str);
+                }
                 printf("\n");
             }
             printf("\n");
@@ -1024,5 +1100,6 @@ void print_config(const struct dhcp_config_t *config)
 
 void free_config(struct dhcp_config_t *config)
 {
+    host_table_free(&config->host_table);
     memset(config, 0, sizeof(struct dhcp_config_t));
 }
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/src/config_version.h"
+
+struct config_version_t *config_version_load(const char *filename)
+{
+    struct config_version_t *version = calloc(1, sizeof(struct config_version_t));
+    if (!version)
+    {
+        perror("Failed to allocate configuration");
+        return NULL;
+    }
+
+    if (parse_config_file(filename, &version->config) != 0)
+    {
+        free(version);
+        return NULL;
+    }
+    if (subnet_trie_build(&version->subnet_trie, &version->config) != 0)
+    {
+        fprintf(stderr, "Failed to build subnet index\n");
+        free_config(&version->config);
+        free(version);
+        return NULL;
+    }
+    return version;
+}
+
+// A pool can move to the new definition of a subnet when every address keeps
+// its place and its network/broadcast/gateway exclusion
+static bool same_address_plan(const struct dhcp_subnet_t *a, const struct dhcp_subnet_t *b)
+{
+    return a->network.s_addr == b->network.s_addr && a->netmask.s_addr == b->netmask.s_addr &&
+           a->range_start.s_addr == b->range_start.s_addr && a->range_end.s_addr == b->range_end.s_addr &&
+           a->router.s_addr == b->router.s_addr;
+}
+
+int config_version_attach_pools(struct config_version_t *next, struct config_version_t *current,
+                                struct lease_database_t *lease_db)
+{
+    if (!next)
+        return -1;
+
+    int carried_from[MAX_SUBNETS];
+    bool taken[MAX_SUBNETS] = {false};
+    next->generation = current ? current->generation + 1 : 1;
+    next->pool_count = (int)next->config.subnet_count;
+
+    // 1. Build pools for new and re-planned subnets; nothing is shared yet
+    for (int i = 0; i < next->pool_count; i++)
+    {
+        struct dhcp_subnet_t *subnet = &next->config.subnets[i];
+        carried_from[i] = -1;
+        for (int j = 0; current && j < current->pool_count; j++)
+        {
+            if (!taken[j] && current->owns_pool[j] && same_address_plan(&current->config.subnets[j], subnet))
+            {
+                carried_from[i] = j;
+                taken[j] = true;
+                break;
+            }
+        }
+        if (carried_from[i] >= 0)
+            continue;
+
+        struct ip_pool_t *pool = malloc(sizeof(struct ip_pool_t));
+        if (!pool || ip_pool_init(pool, subnet, NULL) != 0)
+        {
+            free(pool);
+            goto fail;
+        }
+        next->pools[i] = pool;
+        next->owns_pool[i] = true;
+        next->pool_rebuilt[i] = true;
+        if (lease_db)
+            ip_pool_sync_with_leases(pool, lease_db);
+    }
+
+    // 2. Take over the unchanged pools; this cannot fail
+    for (int i = 0; i < next->pool_count; i++)
+    {
+        int j = carried_from[i];
+        if (j < 0)
+            continue;
+        next->pools[i] = current->pools[j];
+        next->owns_pool[i] = true;
+        current->owns_pool[j] = false;
+        ip_pool_update_subnet(next->pools[i], &next->config.subnets[i], lease_db);
+    }
+    return 0;
+
+fail:
+    fprintf(stderr, "Failed to build IP pools for configuration generation %lu\n", (unsigned long)next->generation);
+    for (int i = 0; i < next->pool_count; i++)
+    {
+        if (next->owns_pool[i])
+        {
+            ip_pool_free(next->pools[i]);
+            free(next->pools[i]);
+        }
+        next->pools[i] = NULL;
+        next->owns_pool[i] = false;
+        next->pool_rebuilt[i] = false;
+    }
+    return -1;
+}
+
+void config_version_resync(struct config_version_t *version, struct lease_database_t *lease_db)
+{
+    if (!version || !lease_db)
+        return;
+
+    for (int i = 0; i < version->pool_count; i++)
+    {
+        if (version->pool_rebuilt[i])
+            ip_pool_sync_with_leases(version->pools[i], lease_db);
+    }
+}
+
+void config_version_free(struct config_version_t *version)
+{
+    if (!version)
+        return;
+
+    for (int i = 0; i < version->pool_count; i++)
+    {
+        if (version->owns_pool[i])
+        {
+            ip_pool_free(version->pools[i]);
+            free(version->pools[i]);
+        }
+    }
+    subnet_trie_free(&version->subnet_trie);
+    free_config(&version->config);
+    free(version);
+}
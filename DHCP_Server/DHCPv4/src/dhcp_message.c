@@ -1,5 +1,6 @@
 #include "../include/src/dhcp_message.h"
 #include <arpa/inet.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -74,54 +75,46 @@ int dhcp_message_add_option_ip(struct dhcp_packet *packet, uint8_t option_code,
 
 uint8_t *dhcp_message_get_option(const struct dhcp_packet *packet, uint8_t option_code, uint8_t *out_len)
 {
-    int offset = 4;
+    struct dhcp_option_index_t idx;
+    dhcp_options_parse(packet, sizeof(struct dhcp_packet), &idx);
+    return (uint8_t *)dhcp_options_get(packet, &idx, option_code, out_len);
+}
 
-    // Check magic cookie
-    uint32_t cookie;
-    memcpy(&cookie, packet->options, 4);
-    if (ntohl(cookie) != DHCP_MAGIC_COOKIE)
-    {
-        return NULL;
-    }
+uint8_t dhcp_message_get_type(const struct dhcp_packet *packet)
+{
+    struct dhcp_option_index_t idx;
+    dhcp_options_parse(packet, sizeof(struct dhcp_packet), &idx);
+    return dhcp_options_get_u8(packet, &idx, DHCP_OPT_MESSAGE_TYPE);
+}
 
-    while (offset < 312)
+// Zero-pad options[0, options_len) up to the BOOTP minimum; returns the bytes to send
+static size_t finish_length(struct dhcp_packet *packet, uint32_t options_len)
+{
+    size_t len = offsetof(struct dhcp_packet, options) + options_len;
+    if (len < DHCP_BOOTP_MIN_LEN)
     {
-        uint8_t code = packet->options[offset];
-
-        if (code == DHCP_OPT_END)
-        {
-            break;
-        }
-
-        if (code == DHCP_OPT_PAD)
-        {
-            offset++;
-            continue;
-        }
-
-        uint8_t len = packet->options[offset + 1];
-
-        if (code == option_code)
-        {
-            if (out_len)
-                *out_len = len;
-            return (uint8_t *)&packet->options[offset + 2];
-        }
-
-        offset += 2 + len;
+        memset((uint8_t *)packet + len, 0, DHCP_BOOTP_MIN_LEN - len);
+        len = DHCP_BOOTP_MIN_LEN;
     }
-
-    return NULL;
+    return len;
 }
 
-uint8_t dhcp_message_get_type(const struct dhcp_packet *packet)
+size_t dhcp_message_length(const struct dhcp_packet *packet)
 {
-    uint8_t *opt_ptr = dhcp_message_get_option(packet, DHCP_OPT_MESSAGE_TYPE, NULL);
-    if (opt_ptr)
+    uint32_t offset = 4;
+    while (offset < sizeof(packet->options) && packet->options[offset] != DHCP_OPT_END)
     {
-        return *opt_ptr;
+        if (packet->options[offset] == DHCP_OPT_PAD)
+            offset++;
+        else if (offset + 1 < sizeof(packet->options))
+            offset += 2u + packet->options[offset + 1];
+        else
+            break;
     }
-    return 0;
+    offset = offset < sizeof(packet->options) ? offset + 1 : sizeof(packet->options); // END included
+
+    size_t len = offsetof(struct dhcp_packet, options) + offset;
+    return len < DHCP_BOOTP_MIN_LEN ? DHCP_BOOTP_MIN_LEN : len;
 }
 
 int dhcp_message_validate(struct dhcp_packet *packet, ssize_t len)
@@ -141,55 +134,191 @@ int dhcp_message_validate(struct dhcp_packet *packet, ssize_t len)
     return 0;
 }
 
-void dhcp_message_make_offer(struct dhcp_packet *offer, const struct dhcp_packet *discover, struct dhcp_lease_t *lease,
-                             struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts)
-{
-    (void)global_opts;
-    dhcp_message_init(offer, BOOTREPLY, discover->xid, (uint8_t *)discover->chaddr);
-
-    // Standard fields
-    offer->yiaddr = lease->ip_address;
-    offer->siaddr = subnet->next_server; // Assuming next_server is filled
+// Per-lease option slots at the start of every template (offsets into options[])
+#define TPL_TYPE 6         // 53, 1, type
+#define TPL_SERVER_ID 9    // 54, 4, address
+#define TPL_LEASE_TIME 15  // 51, 4, seconds
+#define TPL_RENEWAL 21     // 58, 4, seconds
+#define TPL_REBINDING 27   // 59, 4, seconds
+#define TPL_FIXED_END 31   // First subnet option
 
-    // Options
-    uint8_t type = DHCP_OFFER;
-    dhcp_message_add_option(offer, DHCP_OPT_MESSAGE_TYPE, 1, &type);
+// Code and length in front of the slot whose data starts at pos
+static void template_put_fixed(uint8_t *options, uint32_t pos, uint8_t code, uint8_t len)
+{
+    options[pos - 2] = code;
+    options[pos - 1] = len;
+}
 
-    dhcp_message_add_option_ip(offer, DHCP_OPT_SUBNET_MASK, subnet->netmask);
-    dhcp_message_add_option_ip(offer, DHCP_OPT_ROUTER, subnet->router);
-    dhcp_message_add_option32(offer, DHCP_OPT_LEASE_TIME, (uint32_t)(lease->end_time - lease->start_time));
-    dhcp_message_add_option_ip(offer, DHCP_OPT_SERVER_ID, subnet->router); // Usually server IP
+// Append one subnet option to the template; options that do not fit are left out
+static int template_add(struct dhcp_option_template_t *tpl, uint8_t code, size_t len, const void *data)
+{
+    if (len == 0)
+        return 0;
 
-    if (subnet->dns_server_count > 0)
+    // Leave room for END
+    if (len > 255 || tpl->options_len + 2 + len + 1 > sizeof(tpl->packet.options))
     {
-        dhcp_message_add_option(offer, DHCP_OPT_DNS_SERVERS, subnet->dns_server_count * 4, subnet->dns_servers);
+        fprintf(stderr, "Warning: DHCP option %u does not fit in the reply, left out\n", code);
+        return -1;
     }
+
+    uint8_t *options = tpl->packet.options;
+    tpl->option_offset[code] = tpl->options_len;
+    options[tpl->options_len] = code;
+    options[tpl->options_len + 1] = (uint8_t)len;
+    memcpy(&options[tpl->options_len + 2], data, len);
+    tpl->options_len += (uint16_t)(2 + len);
+    return 0;
 }
 
-void dhcp_message_make_ack(struct dhcp_packet *ack, const struct dhcp_packet *request, struct dhcp_lease_t *lease,
-                           struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts)
+static int template_add_ip(struct dhcp_option_template_t *tpl, uint8_t code, struct in_addr ip)
 {
-    (void)global_opts;
-    dhcp_message_init(ack, BOOTREPLY, request->xid, (uint8_t *)request->chaddr);
+    return ip.s_addr != 0 ? template_add(tpl, code, 4, &ip.s_addr) : 0;
+}
 
-    ack->yiaddr = lease->ip_address;
+int dhcp_message_build_template(struct dhcp_option_template_t *tpl, const struct dhcp_subnet_t *subnet)
+{
+    if (!tpl || !subnet)
+        return -1;
 
-    // Options
-    uint8_t type = DHCP_ACK;
-    dhcp_message_add_option(ack, DHCP_OPT_MESSAGE_TYPE, 1, &type);
+    memset(tpl, 0, sizeof(struct dhcp_option_template_t));
+
+    struct dhcp_packet *packet = &tpl->packet;
+    packet->op = BOOTREPLY;
+    packet->htype = HTYPE_ETHER;
+    packet->hlen = 6;
+    packet->siaddr = subnet->next_server;
+    memcpy(packet->file, subnet->filename, strnlen(subnet->filename, sizeof(packet->file) - 1));
+
+    uint32_t cookie = htonl(DHCP_MAGIC_COOKIE);
+    memcpy(packet->options, &cookie, 4);
+
+    // Slots filled per reply (the server id is per subnet: the router, as before)
+    template_put_fixed(packet->options, TPL_TYPE, DHCP_OPT_MESSAGE_TYPE, 1);
+    template_put_fixed(packet->options, TPL_SERVER_ID, DHCP_OPT_SERVER_ID, 4);
+    memcpy(&packet->options[TPL_SERVER_ID], &subnet->router.s_addr, 4);
+    template_put_fixed(packet->options, TPL_LEASE_TIME, DHCP_OPT_LEASE_TIME, 4);
+    template_put_fixed(packet->options, TPL_RENEWAL, DHCP_OPT_RENEWAL_TIME, 4);
+    template_put_fixed(packet->options, TPL_REBINDING, DHCP_OPT_REBINDING_TIME, 4);
+    tpl->options_len = TPL_FIXED_END;
+
+    int result = 0;
+    struct in_addr mask = subnet->subnet_mask.s_addr != 0 ? subnet->subnet_mask : subnet->netmask;
+    result |= template_add_ip(tpl, DHCP_OPT_SUBNET_MASK, mask);
+    result |= template_add_ip(tpl, DHCP_OPT_ROUTER, subnet->router);
+    result |= template_add(tpl, DHCP_OPT_DNS_SERVERS, subnet->dns_server_count * 4, subnet->dns_servers);
+    result |= template_add(tpl, DHCP_OPT_DOMAIN_NAME, strnlen(subnet->domain_name, sizeof(subnet->domain_name)),
+                           subnet->domain_name);
+    result |= template_add_ip(tpl, DHCP_OPT_BROADCAST_ADDR, subnet->broadcast);
+    if (subnet->time_offset != 0)
+    {
+        uint32_t offset = htonl((uint32_t)subnet->time_offset);
+        result |= template_add(tpl, DHCP_OPT_TIME_OFFSET, 4, &offset);
+    }
+    result |= template_add(tpl, DHCP_OPT_NTP_SERVERS, subnet->ntp_server_count * 4, subnet->ntp_servers);
+    result |= template_add(tpl, DHCP_OPT_NETBIOS_SERVERS, subnet->netbios_server_count * 4, subnet->netbios_servers);
+    result |= template_add(tpl, DHCP_OPT_TFTP_SERVER_NAME,
+                           strnlen(subnet->tftp_server_name, sizeof(subnet->tftp_server_name)),
+                           subnet->tftp_server_name);
+    result |= template_add(tpl, DHCP_OPT_BOOTFILE_NAME, strnlen(subnet->bootfile_name, sizeof(subnet->bootfile_name)),
+                           subnet->bootfile_name);
+
+    packet->options[tpl->options_len++] = DHCP_OPT_END;
+    return result;
+}
 
-    dhcp_message_add_option_ip(ack, DHCP_OPT_SUBNET_MASK, subnet->netmask);
-    dhcp_message_add_option_ip(ack, DHCP_OPT_ROUTER, subnet->router);
-    dhcp_message_add_option32(ack, DHCP_OPT_LEASE_TIME, (uint32_t)(lease->end_time - lease->start_time));
-    dhcp_message_add_option_ip(ack, DHCP_OPT_SERVER_ID, subnet->router); // Usually server IP
+static void put_u32(uint8_t *dst, uint32_t value)
+{
+    uint32_t net_value = htonl(value);
+    memcpy(dst, &net_value, 4);
+}
 
-    if (subnet->dns_server_count > 0)
+// Copy the used part of the subnet's template and fill in the client and lease
+// specific fields; returns the number of bytes to send
+static size_t make_reply(struct dhcp_packet *reply, const struct dhcp_packet *request,
+                       const struct dhcp_option_index_t *request_options, uint8_t type,
+                       const struct dhcp_lease_t *lease, const struct dhcp_subnet_t *subnet)
+{
+    const struct dhcp_option_template_t *tpl = &subnet->reply_template;
+    uint8_t prl_len = 0;
+    const uint8_t *prl = dhcp_options_get(request, request_options, DHCP_OPT_PARAM_REQUEST_LIST, &prl_len);
+
+    uint32_t pos;
+    if (!prl)
+    {
+        memcpy(reply, &tpl->packet, offsetof(struct dhcp_packet, options) + tpl->options_len);
+        pos = tpl->options_len;
+    }
+    else
     {
-        dhcp_message_add_option(ack, DHCP_OPT_DNS_SERVERS, subnet->dns_server_count * 4, subnet->dns_servers);
+        // Header and per-lease slots, then Subnet Mask and Router, always sent
+        // and the mask first (RFC 2131 3.3), then the other requested subnet
+        // options in request order
+        memcpy(reply, &tpl->packet, offsetof(struct dhcp_packet, options) + TPL_FIXED_END);
+        pos = TPL_FIXED_END;
+        uint8_t seen[32] = {0};
+        static const uint8_t always[] = {DHCP_OPT_SUBNET_MASK, DHCP_OPT_ROUTER};
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const uint8_t *codes = pass == 0 ? always : prl;
+            uint8_t count = pass == 0 ? (uint8_t)sizeof(always) : prl_len;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                uint8_t code = codes[i];
+                uint16_t offset = tpl->option_offset[code];
+                if (offset == 0 || (seen[code >> 3] & (1u << (code & 7))))
+                    continue;
+                seen[code >> 3] |= (uint8_t)(1u << (code & 7));
+
+                uint32_t len = 2u + tpl->packet.options[offset + 1];
+                memcpy(&reply->options[pos], &tpl->packet.options[offset], len);
+                pos += len;
+            }
+        }
+        reply->options[pos++] = DHCP_OPT_END;
     }
+
+    reply->xid = request->xid;
+    reply->flags = request->flags;
+    reply->giaddr = request->giaddr;
+    memcpy(reply->chaddr, request->chaddr, 6);
+    reply->yiaddr = lease->ip_address;
+
+    // T1/T2: configured values when they fit inside the lease, else 1/2 and 7/8 of it
+    uint32_t lease_time = (uint32_t)(lease->end_time - lease->start_time);
+    uint32_t t1 = subnet->renewal_time;
+    uint32_t t2 = subnet->rebinding_time;
+    if (t1 == 0 || t1 >= lease_time)
+        t1 = lease_time / 2;
+    if (t2 == 0 || t2 >= lease_time || t2 <= t1)
+        t2 = (uint32_t)((uint64_t)lease_time * 7 / 8);
+    if (t1 >= t2)
+        t1 = lease_time / 2;
+
+    reply->options[TPL_TYPE] = type;
+    put_u32(&reply->options[TPL_LEASE_TIME], lease_time);
+    put_u32(&reply->options[TPL_RENEWAL], t1);
+    put_u32(&reply->options[TPL_REBINDING], t2);
+    return finish_length(reply, pos);
+}
+
+size_t dhcp_message_make_offer(struct dhcp_packet *offer, const struct dhcp_packet *discover,
+                             const struct dhcp_option_index_t *discover_options, struct dhcp_lease_t *lease,
+                             struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts)
+{
+    (void)global_opts;
+    return make_reply(offer, discover, discover_options, DHCP_OFFER, lease, subnet);
+}
+
+size_t dhcp_message_make_ack(struct dhcp_packet *ack, const struct dhcp_packet *request,
+                           const struct dhcp_option_index_t *request_options, struct dhcp_lease_t *lease,
+                           struct dhcp_subnet_t *subnet, struct dhcp_global_options_t *global_opts)
+{
+    (void)global_opts;
+    return make_reply(ack, request, request_options, DHCP_ACK, lease, subnet);
 }
 
-void dhcp_message_make_nak(struct dhcp_packet *nak, const struct dhcp_packet *request, struct in_addr server_id)
+size_t dhcp_message_make_nak(struct dhcp_packet *nak, const struct dhcp_packet *request, struct in_addr server_id)
 {
     dhcp_message_init(nak, BOOTREPLY, request->xid, (uint8_t *)request->chaddr);
 
@@ -199,4 +328,5 @@ void dhcp_message_make_nak(struct dhcp_packet *nak, const struct dhcp_packet *re
     uint8_t type = DHCP_NAK;
     dhcp_message_add_option(nak, DHCP_OPT_MESSAGE_TYPE, 1, &type);
     dhcp_message_add_option_ip(nak, DHCP_OPT_SERVER_ID, server_id);
+    return dhcp_message_length(nak);
 }
@@ -0,0 +1,78 @@
+#include <arpa/inet.h>
+#include <stddef.h>
+#include <string.h>
+#include "../include/src/dhcp_options.h"
+
+// Index the TLVs in [start, end) of the packet; stops at END. -1 on an overrun.
+static int index_area(const uint8_t *base, uint32_t start, uint32_t end, struct dhcp_option_index_t *idx)
+{
+    uint32_t pos = start;
+    while (pos < end)
+    {
+        uint8_t code = base[pos];
+        if (code == DHCP_OPT_END)
+            return 0;
+        if (code == DHCP_OPT_PAD)
+        {
+            pos++;
+            continue;
+        }
+
+        if (pos + 1 >= end)
+            return -1; // Length byte missing
+        uint8_t len = base[pos + 1];
+        if (pos + 2 + len > end)
+            return -1; // Data runs past the area
+
+        if (!dhcp_options_has(idx, code))
+        {
+            idx->present[code >> 6] |= 1ull << (code & 63);
+            idx->offset[code] = (uint16_t)(pos + 2);
+            idx->len[code] = len;
+        }
+        pos += 2 + len;
+    }
+    return 0; // No END: the area ends the list
+}
+
+int dhcp_options_parse(const struct dhcp_packet *packet, ssize_t len, struct dhcp_option_index_t *idx)
+{
+    memset(idx->present, 0, sizeof(idx->present));
+    idx->overload = 0;
+
+    const uint32_t options_start = offsetof(struct dhcp_packet, options);
+    if (!packet || len < (ssize_t)options_start + 4)
+        return -1;
+
+    uint32_t cookie;
+    memcpy(&cookie, packet->options, 4);
+    if (ntohl(cookie) != DHCP_MAGIC_COOKIE)
+        return -1;
+
+    uint32_t end = (uint32_t)len < sizeof(struct dhcp_packet) ? (uint32_t)len : sizeof(struct dhcp_packet);
+    const uint8_t *base = (const uint8_t *)packet;
+    if (index_area(base, options_start + 4, end, idx) != 0)
+        return -1;
+
+    // Option overload (RFC 2131 4.1): file first, then sname. Option 52
+    // only counts in the options area; copies in file/sname are ignored
+    // since the first instance of a code wins.
+    uint8_t overload = dhcp_options_get_u8(packet, idx, DHCP_OPT_OVERLOAD);
+    if (overload < DHCP_OVERLOAD_FILE || overload > DHCP_OVERLOAD_BOTH)
+        return 0;
+    idx->overload = overload;
+
+    if (overload & DHCP_OVERLOAD_FILE)
+    {
+        uint32_t start = offsetof(struct dhcp_packet, file);
+        if (index_area(base, start, start + sizeof(packet->file), idx) != 0)
+            return -1;
+    }
+    if (overload & DHCP_OVERLOAD_SNAME)
+    {
+        uint32_t start = offsetof(struct dhcp_packet, sname);
+        if (index_area(base, start, start + sizeof(packet->sname), idx) != 0)
+            return -1;
+    }
+    return 0;
+}
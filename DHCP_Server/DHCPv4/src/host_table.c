@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/host_table.h"
+#include "../include/src/config_v4.h"
+
+#define HOST_TABLE_MIN_CAPACITY 64
+
+static inline uint32_t hash_mac(const uint8_t mac[6])
+{
+    // MAC as a 48-bit integer (OUI in the high bits), as in the lease database
+    uint64_t key = ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) | ((uint64_t)mac[2] << 24) |
+                   ((uint64_t)mac[3] << 16) | ((uint64_t)mac[4] << 8) | mac[5];
+    return lease_index_hash_u64(key);
+}
+
+static inline bool mac_is_zero(const uint8_t mac[6])
+{
+    static const uint8_t zero[6] = {0};
+    return memcmp(mac, zero, 6) == 0;
+}
+
+// Whether slot of the table falls in this subnet's run of hosts
+static inline bool subnet_has_host(const struct dhcp_subnet_t *subnet, uint32_t slot)
+{
+    return slot - (uint32_t)(subnet->hosts - subnet->host_table->hosts) < subnet->host_count;
+}
+
+int host_table_append(struct dhcp_host_table_t *table, const struct dhcp_host_reservation_t *host)
+{
+    if (!table || !host)
+        return -1;
+
+    if (table->count == table->capacity)
+    {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : HOST_TABLE_MIN_CAPACITY;
+        struct dhcp_host_reservation_t *hosts = realloc(table->hosts, (size_t)capacity * sizeof(*hosts));
+        if (!hosts)
+        {
+            perror("Failed to grow host reservation table");
+            return -1;
+        }
+        table->hosts = hosts;
+        table->capacity = capacity;
+    }
+    table->hosts[table->count++] = *host;
+    return 0;
+}
+
+int host_table_build(struct dhcp_host_table_t *table, struct dhcp_config_t *config)
+{
+    if (!table || !config)
+        return -1;
+
+    if (lease_index_init(&table->by_mac, table->count) != 0 ||
+        lease_index_init(&table->by_client_id, table->count) != 0 ||
+        lease_index_init(&table->by_address, table->count) != 0)
+        return -1;
+
+    // Hosts without a MAC (or address) are simply not reachable through that index
+    for (uint32_t i = 0; i < table->count; i++)
+    {
+        const struct dhcp_host_reservation_t *host = &table->hosts[i];
+        if (!mac_is_zero(host->mac_address) && lease_index_insert(&table->by_mac, hash_mac(host->mac_address), i) != 0)
+            return -1;
+        if (host->client_id_len > 0 &&
+            lease_index_insert(&table->by_client_id, lease_index_hash_bytes(host->client_id, host->client_id_len),
+                               i) != 0)
+            return -1;
+        if (host->fixed_address.s_addr != 0 &&
+            lease_index_insert(&table->by_address, lease_index_hash_u64(host->fixed_address.s_addr), i) != 0)
+            return -1;
+    }
+
+    // The array no longer moves: subnets can keep pointers into it
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < config->subnet_count; i++)
+    {
+        struct dhcp_subnet_t *subnet = &config->subnets[i];
+        subnet->hosts = table->hosts ? table->hosts + first : NULL;
+        subnet->host_table = table;
+        first += subnet->host_count;
+    }
+    return 0;
+}
+
+void host_table_free(struct dhcp_host_table_t *table)
+{
+    if (!table)
+        return;
+
+    free(table->hosts);
+    lease_index_free(&table->by_mac);
+    lease_index_free(&table->by_client_id);
+    lease_index_free(&table->by_address);
+    memset(table, 0, sizeof(*table));
+}
+
+struct dhcp_host_reservation_t *find_host_by_mac(const struct dhcp_subnet_t *subnet, const uint8_t mac[6])
+{
+    if (!subnet || !mac || subnet->host_count == 0)
+        return NULL;
+
+    const struct dhcp_host_table_t *table = subnet->host_table;
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&table->by_mac, hash_mac(mac), &it);
+    while (lease_index_next(&table->by_mac, &it, &slot))
+    {
+        if (subnet_has_host(subnet, slot) && memcmp(table->hosts[slot].mac_address, mac, 6) == 0)
+            return &table->hosts[slot];
+    }
+    return NULL;
+}
+
+struct dhcp_host_reservation_t *find_host_by_client_id(const struct dhcp_subnet_t *subnet, const uint8_t *client_id,
+                                                       uint32_t len)
+{
+    if (!subnet || !client_id || len == 0 || subnet->host_count == 0)
+        return NULL;
+
+    const struct dhcp_host_table_t *table = subnet->host_table;
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&table->by_client_id, lease_index_hash_bytes(client_id, len), &it);
+    while (lease_index_next(&table->by_client_id, &it, &slot))
+    {
+        const struct dhcp_host_reservation_t *host = &table->hosts[slot];
+        if (subnet_has_host(subnet, slot) && host->client_id_len == len && memcmp(host->client_id, client_id, len) == 0)
+            return &table->hosts[slot];
+    }
+    return NULL;
+}
+
+struct dhcp_host_reservation_t *find_host_by_address(const struct dhcp_subnet_t *subnet, struct in_addr ip)
+{
+    if (!subnet || subnet->host_count == 0)
+        return NULL;
+
+    const struct dhcp_host_table_t *table = subnet->host_table;
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&table->by_address, lease_index_hash_u64(ip.s_addr), &it);
+    while (lease_index_next(&table->by_address, &it, &slot))
+    {
+        if (subnet_has_host(subnet, slot) && table->hosts[slot].fixed_address.s_addr == ip.s_addr)
+            return &table->hosts[slot];
+    }
+    return NULL;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/ip_bitmap.h"
+
+int ip_bitmap_init(struct ip_bitmap_t *bm, uint32_t bits)
+{
+    if (!bm || bits == 0)
+        return -1;
+
+    memset(bm, 0, sizeof(struct ip_bitmap_t));
+    bm->bits = bits;
+
+    uint64_t count = bits;
+    do
+    {
+        count = (count + 63) / 64;
+        bm->levels[bm->depth] = calloc(count, sizeof(uint64_t));
+        if (!bm->levels[bm->depth])
+        {
+            perror("Failed to allocate IP bitmap");
+            ip_bitmap_free(bm);
+            return -1;
+        }
+        bm->words[bm->depth] = (uint32_t)count;
+        bm->depth++;
+    } while (count > 1);
+
+    return 0;
+}
+
+void ip_bitmap_free(struct ip_bitmap_t *bm)
+{
+    if (!bm)
+        return;
+
+    for (uint32_t i = 0; i < IP_BITMAP_MAX_LEVELS; i++)
+        free(bm->levels[i]);
+    memset(bm, 0, sizeof(struct ip_bitmap_t));
+}
+
+// Mark word `bit` of levels[level - 1] non-empty, walking up while words become non-empty
+static void summary_set(struct ip_bitmap_t *bm, uint32_t level, uint32_t bit)
+{
+    for (; level < bm->depth; level++)
+    {
+        uint64_t mask = 1ULL << (bit & 63);
+        uint64_t old = __atomic_fetch_or(&bm->levels[level][bit >> 6], mask, __ATOMIC_SEQ_CST);
+
+        // The parent bit is already set unless this word just became non-empty
+        if (old != 0)
+            return;
+        bit >>= 6;
+    }
+}
+
+// Mark word `bit` of levels[level - 1] empty, walking up while words become empty.
+// After each clear the child word is read again: a set that raced with us
+// puts the summary bit back, so it is never lost.
+static void summary_clear(struct ip_bitmap_t *bm, uint32_t level, uint32_t bit)
+{
+    for (; level < bm->depth; level++)
+    {
+        uint64_t mask = 1ULL << (bit & 63);
+        uint64_t old = __atomic_fetch_and(&bm->levels[level][bit >> 6], ~mask, __ATOMIC_SEQ_CST);
+        if (!(old & mask))
+            return; // Someone else cleared it first and carries on upward
+
+        if (__atomic_load_n(&bm->levels[level - 1][bit], __ATOMIC_SEQ_CST) != 0)
+        {
+            summary_set(bm, level, bit);
+            return;
+        }
+
+        // Only propagate when the word ran empty
+        if (old & ~mask)
+            return;
+        bit >>= 6;
+    }
+}
+
+void ip_bitmap_set(struct ip_bitmap_t *bm, uint32_t bit)
+{
+    if (bit >= bm->bits)
+        return;
+
+    uint64_t mask = 1ULL << (bit & 63);
+    uint64_t old = __atomic_fetch_or(&bm->levels[0][bit >> 6], mask, __ATOMIC_SEQ_CST);
+    if (old & mask)
+        return;
+
+    __atomic_fetch_add(&bm->set_count, 1, __ATOMIC_RELAXED);
+    if (old == 0)
+        summary_set(bm, 1, bit >> 6);
+}
+
+bool ip_bitmap_test_and_clear(struct ip_bitmap_t *bm, uint32_t bit)
+{
+    if (bit >= bm->bits)
+        return false;
+
+    uint64_t mask = 1ULL << (bit & 63);
+    uint64_t old = __atomic_fetch_and(&bm->levels[0][bit >> 6], ~mask, __ATOMIC_SEQ_CST);
+    if (!(old & mask))
+        return false;
+
+    __atomic_fetch_sub(&bm->set_count, 1, __ATOMIC_RELAXED);
+    if ((old & ~mask) == 0)
+        summary_clear(bm, 1, bit >> 6);
+    return true;
+}
+
+void ip_bitmap_clear(struct ip_bitmap_t *bm, uint32_t bit)
+{
+    ip_bitmap_test_and_clear(bm, bit);
+}
+
+uint32_t ip_bitmap_find_first(struct ip_bitmap_t *bm)
+{
+    if (!bm || bm->depth == 0)
+        return IP_BITMAP_NONE;
+
+restart:;
+    uint32_t index = 0;
+    for (uint32_t level = bm->depth; level-- > 0;)
+    {
+        uint64_t word = __atomic_load_n(&bm->levels[level][index], __ATOMIC_SEQ_CST);
+        if (word == 0)
+        {
+            if (level == bm->depth - 1)
+                return IP_BITMAP_NONE;
+
+            // Stale summary bit over an empty word: drop it and search again
+            summary_clear(bm, level + 1, index);
+            goto restart;
+        }
+        index = (index << 6) | (uint32_t)__builtin_ctzll(word);
+    }
+    return index;
+}
+
+uint32_t ip_bitmap_claim_first(struct ip_bitmap_t *bm)
+{
+    for (;;)
+    {
+        uint32_t bit = ip_bitmap_find_first(bm);
+        if (bit == IP_BITMAP_NONE || ip_bitmap_test_and_clear(bm, bit))
+            return bit;
+    }
+}
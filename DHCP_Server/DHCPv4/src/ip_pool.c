@@ -2,15 +2,13 @@
 #include <netinet/in.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <arpa/inet.h>
-#include <netinet/ip_icmp.h>
 #include <string.h>
-#include <sys/socket.h>
 #include <unistd.h>
 #include "../include/src/config_v4.h"
 #include "../include/src/ip_pool.h"
 #include "../include/src/lease_v4.h"
-#include <sys/time.h>
 
 const char *ip_state_to_string(ip_state_t state)
 {
@@ -26,6 +24,8 @@ const char *ip_state_to_string(ip_state_t state)
         return "excluded";
     case IP_STATE_CONFLICT:
         return "conflict";
+    case IP_STATE_PROBING:
+        return "probing";
     default:
         return "unknown";
     }
@@ -43,6 +43,8 @@ ip_state_t ip_state_from_string(const char *str)
         return IP_STATE_EXCLUDED;
     if (strcmp(str, "conflict") == 0)
         return IP_STATE_CONFLICT;
+    if (strcmp(str, "probing") == 0)
+        return IP_STATE_PROBING;
 
     return IP_STATE_UNKNOWN;
 }
@@ -101,29 +103,24 @@ bool ip_is_loopback(struct in_addr ip)
 
 struct ip_pool_entry_t *ip_pool_find_entry(struct ip_pool_t *pool, struct in_addr ip)
 {
-    if (!pool)
+    if (!pool || !pool->entries)
         return NULL;
 
-    for (uint32_t i = 0; i < pool->pool_size; i++)
-    {
-        if (pool->entries[i].ip_address.s_addr == ip.s_addr)
-        {
-            return &pool->entries[i];
-        }
-    }
-    return NULL;
+    // Unsigned wrap-around sends addresses below range_start out of bounds too
+    uint32_t index = ntohl(ip.s_addr) - pool->range_start;
+    if (index >= pool->pool_size)
+        return NULL;
+
+    return &pool->entries[index];
 }
 
 bool ip_pool_is_in_range(struct ip_pool_t *pool, struct in_addr ip)
 {
-    if (!pool || !pool->subnet)
+    if (!pool || !pool->entries)
         return false;
 
-    uint32_t ip_val = ntohl(ip.s_addr);
-    uint32_t start_val = ntohl(pool->subnet->range_start.s_addr);
-    uint32_t end_val = ntohl(pool->subnet->range_end.s_addr);
-
-    return (ip_val >= start_val && ip_val <= end_val);
+    // entries[] spans exactly range_start..range_end of the subnet
+    return ntohl(ip.s_addr) - pool->range_start < pool->pool_size;
 }
 
 bool ip_pool_is_available(struct ip_pool_t *pool, struct in_addr ip)
@@ -132,81 +129,156 @@ bool ip_pool_is_available(struct ip_pool_t *pool, struct in_addr ip)
     if (!entry)
         return false;
 
-    return entry->state == IP_STATE_AVAILABLE;
+    // The free map is the lock-free view of AVAILABLE entries
+    return ip_bitmap_test(&pool->free_map, (uint32_t)(entry - pool->entries));
 }
 
-static uint16_t icmp_checksum(void *data, int len)
+//=============================================================================
+// Entry state bookkeeping
+//=============================================================================
+
+static uint32_t hash_mac(const uint8_t mac[6])
 {
-    uint16_t *buf = (uint16_t *)data;
-    uint32_t sum = 0;
+    uint64_t key = ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) | ((uint64_t)mac[2] << 24) |
+                   ((uint64_t)mac[3] << 16) | ((uint64_t)mac[4] << 8) | (uint64_t)mac[5];
+    return lease_index_hash_u64(key);
+}
 
-    for (; len > 1; len -= 2)
-    {
-        sum += *buf++;
-    }
+// Stripe of a client, from the high hash bits (its MAC index uses the low ones)
+static struct ip_pool_stripe_t *stripe_of(struct ip_pool_t *pool, const uint8_t mac[6])
+{
+    return &pool->stripes[hash_mac(mac) >> (32 - IP_POOL_STRIPE_BITS)];
+}
 
-    if (len == 1)
-    {
-        sum += *(uint8_t *)buf;
-    }
+// Admin changes (reservations, conflicts, lease sync) take every stripe, in order
+static void lock_all_stripes(struct ip_pool_t *pool)
+{
+    for (uint32_t i = 0; i < IP_POOL_STRIPES; i++)
+        pthread_mutex_lock(&pool->stripes[i].mutex);
+}
+
+static void unlock_all_stripes(struct ip_pool_t *pool)
+{
+    for (uint32_t i = IP_POOL_STRIPES; i-- > 0;)
+        pthread_mutex_unlock(&pool->stripes[i].mutex);
+}
 
-    sum = (sum >> 16) + (sum & 0xFFFF);
-    sum += (sum >> 16);
+static uint32_t entry_index(const struct ip_pool_t *pool, const struct ip_pool_entry_t *entry)
+{
+    return (uint32_t)(entry - pool->entries);
+}
 
-    return ~sum;
+// States whose holder is looked up by MAC
+static bool state_has_owner(ip_state_t state)
+{
+    return state == IP_STATE_ALLOCATED || state == IP_STATE_PROBING;
 }
 
-bool ip_ping_check(struct in_addr ip, uint32_t timeout_ms)
+/*
+ * Move an entry to a new state, keeping the counters, the free bitmap and the
+ * MAC indexes in step. mac (may be NULL) replaces the stored MAC; AVAILABLE
+ * entries without one are cleared. The caller owns the entry: it cleared its
+ * free bit, or holds the stripe of its current holder and of the new one
+ * (every stripe for entries without a holder).
+ */
+static void entry_set_state(struct ip_pool_t *pool, struct ip_pool_entry_t *entry, ip_state_t state,
+                            const uint8_t *mac)
 {
-    int sockfd;
-    struct sockaddr_in addr;
-    struct icmphdr icmp_hdr;
-    uint8_t packet[64];
-    struct timeval tv;
-    fd_set readfds;
+    uint32_t index = entry_index(pool, entry);
 
-    // Create raw socket (requires root/CAP_NET_RAW)
-    sockfd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
-    if (sockfd < 0)
+    if (entry->state == IP_STATE_AVAILABLE)
     {
-        // If we can't create raw socket, assume IP is available
-        // (ping check requires elevated privileges)
-        return false;
+        __atomic_fetch_sub(&pool->available_count, 1, __ATOMIC_RELAXED);
+        ip_bitmap_clear(&pool->free_map, index); // Already clear when the caller claimed it
     }
+    else if (entry->state == IP_STATE_ALLOCATED)
+    {
+        __atomic_fetch_sub(&pool->allocated_count, 1, __ATOMIC_RELAXED);
+    }
+    if (state_has_owner(entry->state))
+        lease_index_remove(&stripe_of(pool, entry->mac_address)->mac_index, hash_mac(entry->mac_address), index);
 
-    // Set timeout
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    entry->state = state;
+    if (mac)
+        memcpy(entry->mac_address, mac, 6);
+    else if (state == IP_STATE_AVAILABLE)
+        memset(entry->mac_address, 0, 6);
 
-    // Prepare destination
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_addr = ip;
+    if (state == IP_STATE_AVAILABLE)
+    {
+        __atomic_fetch_add(&pool->available_count, 1, __ATOMIC_RELAXED);
+        ip_bitmap_set(&pool->free_map, index); // Publishes the entry: last
+    }
+    else if (state == IP_STATE_ALLOCATED)
+    {
+        __atomic_fetch_add(&pool->allocated_count, 1, __ATOMIC_RELAXED);
+    }
+    if (state_has_owner(state) &&
+        lease_index_insert(&stripe_of(pool, entry->mac_address)->mac_index, hash_mac(entry->mac_address), index) != 0)
+        fprintf(stderr, "WARNING: IP pool MAC index insert failed\n");
+}
+
+// ALLOCATED or PROBING entry held by this MAC, or NULL. Caller holds the stripe of mac.
+static struct ip_pool_entry_t *find_owned_by_mac(struct ip_pool_t *pool, const uint8_t mac[6])
+{
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    struct lease_index_iter_t it;
+    uint32_t index;
 
-    // Prepare ICMP echo request
-    memset(&icmp_hdr, 0, sizeof(icmp_hdr));
-    icmp_hdr.type = ICMP_ECHO;
-    icmp_hdr.code = 0;
-    icmp_hdr.un.echo.id = getpid();
-    icmp_hdr.un.echo.sequence = 1;
+    lease_index_find(&stripe->mac_index, hash_mac(mac), &it);
+    while (lease_index_next(&stripe->mac_index, &it, &index))
+    {
+        struct ip_pool_entry_t *entry = &pool->entries[index];
+        if (state_has_owner(entry->state) && memcmp(entry->mac_address, mac, 6) == 0)
+            return entry;
+    }
+    return NULL;
+}
 
-    memcpy(packet, &icmp_hdr, sizeof(icmp_hdr));
-    icmp_hdr.checksum = icmp_checksum(packet, sizeof(icmp_hdr));
-    memcpy(packet, &icmp_hdr, sizeof(icmp_hdr));
+// Entry of ip if it is ALLOCATED or PROBING for this MAC, else NULL. Caller
+// holds the stripe of mac; only entries indexed there are read, so the state
+// of an entry held by a client of another stripe is never looked at.
+static struct ip_pool_entry_t *find_owned_entry(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6])
+{
+    struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, ip);
+    if (!entry)
+        return NULL;
 
-    if (sendto(sockfd, packet, sizeof(icmp_hdr), 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    struct lease_index_iter_t it;
+    uint32_t index;
+    lease_index_find(&stripe->mac_index, hash_mac(mac), &it);
+    while (lease_index_next(&stripe->mac_index, &it, &index))
     {
-        close(sockfd);
-        return false;
+        if (index == entry_index(pool, entry) && memcmp(entry->mac_address, mac, 6) == 0)
+            return entry;
     }
+    return NULL;
+}
 
-    FD_ZERO(&readfds);
-    FD_SET(sockfd, &readfds);
+// Subnet the pool serves now; a configuration reload may switch it (ip_pool_update_subnet())
+static struct dhcp_subnet_t *pool_subnet(const struct ip_pool_t *pool)
+{
+    return __atomic_load_n(&pool->subnet, __ATOMIC_ACQUIRE);
+}
 
-    int result = select(sockfd + 1, &readfds, NULL, NULL, &tv);
-    close(sockfd);
+// Host reservation of the subnet for this client, or NULL: by client identifier
+// when the client sent one that is reserved, else by MAC (config only: no lock needed)
+static struct dhcp_host_reservation_t *find_host(struct ip_pool_t *pool, const uint8_t mac[6],
+                                                 const uint8_t *client_id, uint32_t client_id_len)
+{
+    struct dhcp_subnet_t *subnet = pool_subnet(pool);
+    struct dhcp_host_reservation_t *host = find_host_by_client_id(subnet, client_id, client_id_len);
+    return host ? host : find_host_by_mac(subnet, mac);
+}
 
-    return (result > 0);
+// Whether the subnet still reserves host's address for the same client
+static bool subnet_reserves(const struct dhcp_subnet_t *subnet, const struct dhcp_host_reservation_t *host)
+{
+    const struct dhcp_host_reservation_t *same = find_host_by_address(subnet, host->fixed_address);
+    return same && memcmp(same->mac_address, host->mac_address, 6) == 0 &&
+           same->client_id_len == host->client_id_len &&
+           memcmp(same->client_id, host->client_id, host->client_id_len) == 0;
 }
 
 int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct lease_database_t *lease_db)
@@ -216,45 +288,67 @@ int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct le
 
     memset(pool, 0, sizeof(struct ip_pool_t));
 
-    // Initialize mutex
-    if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+    uint32_t start_ip = ntohl(subnet->range_start.s_addr);
+    uint32_t end_ip = ntohl(subnet->range_end.s_addr);
+    uint64_t range_size = (uint64_t)end_ip - start_ip + 1;
+
+    if (end_ip < start_ip || range_size > UINT32_MAX)
+    {
+        fprintf(stderr, "Invalid IP pool range (start after end)\n");
+        return -1;
+    }
+
+    // Initialize stripe mutexes
+    uint32_t initialized = 0;
+    while (initialized < IP_POOL_STRIPES && pthread_mutex_init(&pool->stripes[initialized].mutex, NULL) == 0)
+        initialized++;
+    if (initialized < IP_POOL_STRIPES)
     {
         perror("Failed to initialize IP pool mutex");
+        while (initialized > 0)
+            pthread_mutex_destroy(&pool->stripes[--initialized].mutex);
         return -1;
     }
+    pool->mutex_initialized = true;
 
     pool->subnet = subnet;
+    pool->range_start = start_ip;
 
-    uint32_t start_ip = ntohl(subnet->range_start.s_addr);
-    uint32_t end_ip = ntohl(subnet->range_end.s_addr);
-
-    pool->pool_size = 0;
-    for (uint32_t ip_val = start_ip; ip_val <= end_ip && pool->pool_size < MAX_POOL_SIZE; ip_val++)
+    pool->entries = calloc(range_size, sizeof(struct ip_pool_entry_t));
+    if (!pool->entries)
     {
-        struct ip_pool_entry_t *entry = &pool->entries[pool->pool_size];
-        entry->ip_address.s_addr = htonl(ip_val);
-        entry->state = IP_STATE_AVAILABLE;
-        memset(entry->mac_address, 0, 6);
-        entry->last_allocated = 0;
-        entry->lease_id = 0; // Initialize lease reference (0 = no lease)
-
-        if (ip_is_network_address(entry->ip_address, subnet->network, subnet->netmask))
-        {
-            entry->state = IP_STATE_EXCLUDED;
-        }
-        else if (ip_is_broadcast_address(entry->ip_address, subnet->network, subnet->netmask))
-        {
-            entry->state = IP_STATE_EXCLUDED;
-        }
-        else if (ip_is_gateway(entry->ip_address, subnet->router))
+        perror("Failed to allocate IP pool entries");
+        ip_pool_free(pool);
+        return -1;
+    }
+    if (ip_bitmap_init(&pool->free_map, (uint32_t)range_size) != 0)
+    {
+        ip_pool_free(pool);
+        return -1;
+    }
+    for (uint32_t i = 0; i < IP_POOL_STRIPES; i++)
+    {
+        if (lease_index_init(&pool->stripes[i].mac_index, 0) != 0)
         {
-            entry->state = IP_STATE_EXCLUDED;
+            ip_pool_free(pool);
+            return -1;
         }
-        else
+    }
+    pool->pool_size = (uint32_t)range_size;
+
+    for (uint32_t i = 0; i < pool->pool_size; i++)
+    {
+        struct ip_pool_entry_t *entry = &pool->entries[i];
+        entry->ip_address.s_addr = htonl(start_ip + i);
+        entry->state = IP_STATE_EXCLUDED; // Not counted until classified below
+
+        if (ip_is_network_address(entry->ip_address, subnet->network, subnet->netmask) ||
+            ip_is_broadcast_address(entry->ip_address, subnet->network, subnet->netmask) ||
+            ip_is_gateway(entry->ip_address, subnet->router))
         {
-            pool->available_count++;
+            continue;
         }
-        pool->pool_size++;
+        entry_set_state(pool, entry, IP_STATE_AVAILABLE, NULL);
     }
 
     for (uint32_t i = 0; i < subnet->host_count; i++)
@@ -264,19 +358,21 @@ int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct le
 
         if (entry)
         {
-            entry->state = IP_STATE_RESERVED;
-            memcpy(entry->mac_address, host->mac_address, 6);
-            pool->available_count--;
+            entry_set_state(pool, entry, IP_STATE_RESERVED, host->mac_address);
         }
     }
 
-    // Sync with lease database - handle all lease states
+    // Sync with lease database - handle all lease states. The pool is not
+    // shared yet, but the leases are: lease pointers only hold under their shard's lock
     if (lease_db)
     {
         time_t now = time(NULL);
-        for (uint32_t i = 0; i < lease_db->lease_count; i++)
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+        {
+        lease_db_lock_shard(lease_db, s);
+        for (uint32_t i = 0; i < lease_db->shards[s].lease_count; i++)
         {
-            struct dhcp_lease_t *lease = &lease_db->leases[i];
+            struct dhcp_lease_t *lease = lease_shard_get(&lease_db->shards[s], i);
 
             // Check if lease is expired and update state if needed
             if (lease->state == LEASE_STATE_ACTIVE && lease->end_time < now)
@@ -299,38 +395,24 @@ int ip_pool_init(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct le
             // Update pool entry based on lease state
             if (new_state == IP_STATE_ALLOCATED)
             {
-                if (entry->state == IP_STATE_AVAILABLE)
-                {
-                    pool->available_count--;
-                    pool->allocated_count++;
-                }
-                entry->state = IP_STATE_ALLOCATED;
-                memcpy(entry->mac_address, lease->mac_address, 6);
+                entry_set_state(pool, entry, IP_STATE_ALLOCATED, lease->mac_address);
                 entry->last_allocated = lease->start_time;
                 entry->lease_id = lease->lease_id;
             }
             else if (new_state == IP_STATE_CONFLICT)
             {
-                if (entry->state == IP_STATE_AVAILABLE)
-                {
-                    pool->available_count--;
-                }
-                entry->state = IP_STATE_CONFLICT;
+                entry_set_state(pool, entry, IP_STATE_CONFLICT, NULL);
                 entry->lease_id = lease->lease_id;
             }
             else if (new_state == IP_STATE_AVAILABLE)
             {
                 // Lease is expired/released/free - make IP available if not already
-                if (entry->state == IP_STATE_ALLOCATED)
-                {
-                    pool->allocated_count--;
-                    pool->available_count++;
-                }
-                entry->state = IP_STATE_AVAILABLE;
-                memset(entry->mac_address, 0, 6);
+                entry_set_state(pool, entry, IP_STATE_AVAILABLE, NULL);
                 entry->lease_id = lease->lease_id;
             }
         }
+        lease_db_unlock_shard(lease_db, s);
+        }
     }
 
     return 0;
@@ -340,21 +422,84 @@ void ip_pool_free(struct ip_pool_t *pool)
 {
     if (pool)
     {
-        pthread_mutex_destroy(&pool->mutex);
+        free(pool->entries);
+        ip_bitmap_free(&pool->free_map);
+        for (uint32_t i = 0; i < IP_POOL_STRIPES; i++)
+        {
+            lease_index_free(&pool->stripes[i].mac_index);
+            if (pool->mutex_initialized)
+                pthread_mutex_destroy(&pool->stripes[i].mutex);
+        }
         memset(pool, 0, sizeof(struct ip_pool_t));
     }
 }
 
+int ip_pool_update_subnet(struct ip_pool_t *pool, struct dhcp_subnet_t *subnet, struct lease_database_t *lease_db)
+{
+    if (!pool || !subnet)
+        return -1;
+
+    struct dhcp_subnet_t *old = pool_subnet(pool);
+    if (ntohl(subnet->range_start.s_addr) != pool->range_start ||
+        ntohl(subnet->range_end.s_addr) - pool->range_start + 1 != pool->pool_size)
+        return -1;
+
+    // Dropped reservations: an address with an ACTIVE lease stays with its holder
+    // as an ordinary allocation until the lease ends, otherwise it is freed
+    for (uint32_t i = 0; old && i < old->host_count; i++)
+    {
+        const struct dhcp_host_reservation_t *host = &old->hosts[i];
+        if (subnet_reserves(subnet, host))
+            continue;
+
+        if (lease_db)
+            lease_db_lock_ip(lease_db, host->fixed_address);
+        lock_all_stripes(pool);
+        struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, host->fixed_address);
+        if (entry && entry->state == IP_STATE_RESERVED && memcmp(entry->mac_address, host->mac_address, 6) == 0)
+        {
+            struct dhcp_lease_t *lease = lease_db ? lease_db_find_by_ip(lease_db, host->fixed_address) : NULL;
+            if (lease && lease->state == LEASE_STATE_ACTIVE && lease->end_time >= time(NULL))
+            {
+                entry_set_state(pool, entry, IP_STATE_ALLOCATED, lease->mac_address);
+                entry->lease_id = lease->lease_id;
+                entry->last_allocated = lease->start_time;
+            }
+            else
+            {
+                entry_set_state(pool, entry, IP_STATE_AVAILABLE, NULL);
+            }
+        }
+        unlock_all_stripes(pool);
+        if (lease_db)
+            lease_db_unlock_ip(lease_db, host->fixed_address);
+    }
+
+    // New reservations take their address whatever its state, as at startup
+    lock_all_stripes(pool);
+    for (uint32_t i = 0; i < subnet->host_count; i++)
+    {
+        const struct dhcp_host_reservation_t *host = &subnet->hosts[i];
+        struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, host->fixed_address);
+        if (!entry || (entry->state == IP_STATE_RESERVED && memcmp(entry->mac_address, host->mac_address, 6) == 0))
+            continue;
+        entry_set_state(pool, entry, IP_STATE_RESERVED, host->mac_address);
+    }
+    __atomic_store_n(&pool->subnet, subnet, __ATOMIC_RELEASE);
+    unlock_all_stripes(pool);
+    return 0;
+}
+
 int ip_pool_reserve_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6])
 {
     if (!pool || !mac)
         return -1;
 
-    pthread_mutex_lock(&pool->mutex);
+    lock_all_stripes(pool);
     struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, ip);
     if (!entry)
     {
-        pthread_mutex_unlock(&pool->mutex);
+        unlock_all_stripes(pool);
         return -1;
     }
 
@@ -365,14 +510,14 @@ int ip_pool_reserve_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t
         char ip_str[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &ip, ip_str, INET_ADDRSTRLEN);
         fprintf(stderr, "WARNING: IP %s already allocated to different MAC\n", ip_str);
-        pthread_mutex_unlock(&pool->mutex);
+        unlock_all_stripes(pool);
         return -1;
     }
 
-    // Don't allow reserving static reservations or excluded IPs
-    if (entry->state == IP_STATE_RESERVED || entry->state == IP_STATE_EXCLUDED)
+    // Don't allow reserving static reservations, excluded IPs or IPs held for a probe
+    if (entry->state == IP_STATE_RESERVED || entry->state == IP_STATE_EXCLUDED || entry->state == IP_STATE_PROBING)
     {
-        pthread_mutex_unlock(&pool->mutex);
+        unlock_all_stripes(pool);
         return -1;
     }
 
@@ -380,56 +525,40 @@ int ip_pool_reserve_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t
     if (entry->state == IP_STATE_ALLOCATED && memcmp(entry->mac_address, mac, 6) == 0)
     {
         entry->last_allocated = time(NULL);
-        pthread_mutex_unlock(&pool->mutex);
+        unlock_all_stripes(pool);
         return 0; // No counter change needed
     }
 
-    // Adjust counts based on state transition
-    ip_state_t old_state = entry->state;
-
-    if (old_state == IP_STATE_AVAILABLE)
-    {
-        pool->available_count--;
-        pool->allocated_count++;
-    }
-    else if (old_state == IP_STATE_CONFLICT)
-    {
-        // Moving from conflict to allocated
-        pool->allocated_count++;
-    }
-    // If already ALLOCATED, counts don't change (just updating MAC/time)
-
-    entry->state = IP_STATE_ALLOCATED;
-    memcpy(entry->mac_address, mac, 6);
+    // AVAILABLE or CONFLICT -> ALLOCATED
+    entry_set_state(pool, entry, IP_STATE_ALLOCATED, mac);
     entry->last_allocated = time(NULL);
 
-    pthread_mutex_unlock(&pool->mutex);
+    unlock_all_stripes(pool);
     return 0;
 }
 
-int ip_pool_release_ip(struct ip_pool_t *pool, struct in_addr ip)
+// Give an address back to the free map if this MAC holds it. Caller holds the stripe of mac.
+static int release_locked(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6])
 {
-    if (!pool)
-        return -1;
-
-    pthread_mutex_lock(&pool->mutex);
-    struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, ip);
-    if (!entry)
+    struct ip_pool_entry_t *entry = find_owned_entry(pool, ip, mac);
+    if (entry && entry->state == IP_STATE_ALLOCATED)
     {
-        pthread_mutex_unlock(&pool->mutex);
-        return -1;
+        entry_set_state(pool, entry, IP_STATE_AVAILABLE, NULL);
+        return 0;
     }
+    return -1;
+}
 
-    if (entry->state == IP_STATE_ALLOCATED)
-    {
-        entry->state = IP_STATE_AVAILABLE;
-        memset(entry->mac_address, 0, 6);
-        pool->allocated_count--;
-        pool->available_count++;
-    }
+int ip_pool_release_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6])
+{
+    if (!pool || !mac)
+        return -1;
 
-    pthread_mutex_unlock(&pool->mutex);
-    return 0;
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    pthread_mutex_lock(&stripe->mutex);
+    int result = release_locked(pool, ip, mac);
+    pthread_mutex_unlock(&stripe->mutex);
+    return result;
 }
 
 int ip_pool_mark_conflict(struct ip_pool_t *pool, struct in_addr ip)
@@ -437,32 +566,37 @@ int ip_pool_mark_conflict(struct ip_pool_t *pool, struct in_addr ip)
     if (!pool)
         return -1;
 
-    pthread_mutex_lock(&pool->mutex);
+    lock_all_stripes(pool);
     struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, ip);
     if (!entry)
     {
-        pthread_mutex_unlock(&pool->mutex);
+        unlock_all_stripes(pool);
         return -1;
     }
 
-    // Update counters based on previous state
-    if (entry->state == IP_STATE_AVAILABLE)
-    {
-        pool->available_count--;
-    }
-    else if (entry->state == IP_STATE_ALLOCATED)
-    {
-        pool->allocated_count--;
-    }
-    // EXCLUDED and RESERVED don't affect counters
-
-    entry->state = IP_STATE_CONFLICT;
-    pthread_mutex_unlock(&pool->mutex);
+    entry_set_state(pool, entry, IP_STATE_CONFLICT, NULL);
+    unlock_all_stripes(pool);
     return 0;
 }
 
-struct ip_allocation_result_t ip_pool_allocate(struct ip_pool_t *pool, const uint8_t mac[6],
-                                               struct in_addr requested_ip, struct dhcp_config_t *config)
+// Hand a claimed entry to a client, or hold it for a conflict probe first.
+// Caller cleared its free bit and holds the stripe of mac.
+static void allocate_entry(struct ip_pool_t *pool, struct ip_pool_entry_t *entry, const uint8_t mac[6],
+                           struct dhcp_config_t *config, struct ip_allocation_result_t *result)
+{
+    bool probe = config->global.ping_check && !ip_is_loopback(entry->ip_address);
+
+    entry_set_state(pool, entry, probe ? IP_STATE_PROBING : IP_STATE_ALLOCATED, mac);
+    entry->last_allocated = time(NULL);
+
+    result->success = true;
+    result->needs_probe = probe;
+    result->ip_address = entry->ip_address;
+}
+
+struct ip_allocation_result_t ip_pool_allocate(struct ip_pool_t *pool, const uint8_t mac[6], const uint8_t *client_id,
+                                               uint32_t client_id_len, struct in_addr requested_ip,
+                                               struct dhcp_config_t *config)
 {
     struct ip_allocation_result_t result = {0};
 
@@ -473,146 +607,138 @@ struct ip_allocation_result_t ip_pool_allocate(struct ip_pool_t *pool, const uin
         return result;
     }
 
-    pthread_mutex_lock(&pool->mutex);
-
     // Priority 1: check for static reservation
-    for (uint32_t i = 0; i < pool->subnet->host_count; i++)
+    struct dhcp_host_reservation_t *host = find_host(pool, mac, client_id, client_id_len);
+    if (host)
     {
-        struct dhcp_host_reservation_t *host = &pool->subnet->hosts[i];
-
-        if (memcmp(host->mac_address, mac, 6) == 0)
-        {
-            result.success = true;
-            result.ip_address = host->fixed_address;
-            pthread_mutex_unlock(&pool->mutex);
-            return result;
-        }
+        result.success = true;
+        result.ip_address = host->fixed_address;
+        return result;
     }
 
-    // Priority 2: check if client already has an allocated IP
-    for (uint32_t i = 0; i < pool->pool_size; i++)
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    pthread_mutex_lock(&stripe->mutex);
+
+    // Priority 2: check if client already has an allocated IP (or one being probed)
+    struct ip_pool_entry_t *entry = find_owned_by_mac(pool, mac);
+    if (entry && entry->state == IP_STATE_PROBING)
     {
-        struct ip_pool_entry_t *entry = &pool->entries[i];
+        result.success = false;
+        result.probe_pending = true;
+        snprintf(result.error_message, sizeof(result.error_message), "Conflict probe in progress");
+        pthread_mutex_unlock(&stripe->mutex);
+        return result;
+    }
+    if (entry)
+    {
+        result.success = true;
+        result.ip_address = entry->ip_address;
+        pthread_mutex_unlock(&stripe->mutex);
+        return result;
+    }
 
-        if (entry->state == IP_STATE_ALLOCATED && memcmp(entry->mac_address, mac, 6) == 0)
+    // Priority 3: If client requested a specific IP, try to honor it (if its
+    // free bit is still ours to clear)
+    if (requested_ip.s_addr != 0)
+    {
+        entry = ip_pool_find_entry(pool, requested_ip);
+        if (entry && ip_bitmap_test_and_clear(&pool->free_map, entry_index(pool, entry)))
         {
-            result.success = true;
-            result.ip_address = entry->ip_address;
-            pthread_mutex_unlock(&pool->mutex);
+            allocate_entry(pool, entry, mac, config, &result);
+            pthread_mutex_unlock(&stripe->mutex);
             return result;
         }
     }
 
-    // Priority 3: If client requested a specific IP, try to honor it
-    if (requested_ip.s_addr != 0)
+    // Priority 4: Lowest available IP, claimed from the free map
+    uint32_t index = ip_bitmap_claim_first(&pool->free_map);
+    if (index != IP_BITMAP_NONE)
     {
-        if (ip_pool_is_in_range(pool, requested_ip) && ip_pool_is_available(pool, requested_ip))
-        {
-            // Ping check if enabled and not a loopback address
-            if (config->global.ping_check && !ip_is_loopback(requested_ip))
-            {
-                if (ip_ping_check(requested_ip, config->global.ping_timeout * 1000))
-                {
-                    ip_pool_mark_conflict(pool, requested_ip);
-                }
-                else
-                {
-                    result.success = true;
-                    result.ip_address = requested_ip;
-                    // Note: ip_pool_reserve_ip locks internally, so we unlock here first?
-                    // No, ip_pool_reserve_ip is called from outside usually.
-                    // If we call it from here, we have a recursive lock problem unless we
-                    // use a recursive mutex or factor out the logic. Let's implement the
-                    // reservation logic directly here to avoid recursive lock issues.
-
-                    struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, requested_ip);
-                    if (entry)
-                    {
-                        if (entry->state == IP_STATE_AVAILABLE)
-                            pool->available_count--;
-                        entry->state = IP_STATE_ALLOCATED;
-                        memcpy(entry->mac_address, mac, 6);
-                        entry->last_allocated = time(NULL);
-                        pool->allocated_count++;
-                    }
-
-                    pthread_mutex_unlock(&pool->mutex);
-                    return result;
-                }
-            }
-            else
-            {
-                result.success = true;
-                result.ip_address = requested_ip;
-
-                struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, requested_ip);
-                if (entry)
-                {
-                    if (entry->state == IP_STATE_AVAILABLE)
-                        pool->available_count--;
-                    entry->state = IP_STATE_ALLOCATED;
-                    memcpy(entry->mac_address, mac, 6);
-                    entry->last_allocated = time(NULL);
-                    pool->allocated_count++;
-                }
-
-                pthread_mutex_unlock(&pool->mutex);
-                return result;
-            }
-        }
+        allocate_entry(pool, &pool->entries[index], mac, config, &result);
+        pthread_mutex_unlock(&stripe->mutex);
+        return result;
     }
 
-    // Priority 4: Find first available IP
-    for (uint32_t i = 0; i < pool->pool_size; i++)
+    // No available IPs
+    result.success = false;
+    snprintf(result.error_message, sizeof(result.error_message), "No available IPs in pool");
+    pthread_mutex_unlock(&stripe->mutex);
+    return result;
+}
+
+int ip_pool_resolve_probe(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6], ip_state_t new_state)
+{
+    if (!pool || !mac)
+        return -1;
+
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    pthread_mutex_lock(&stripe->mutex);
+    struct ip_pool_entry_t *entry = find_owned_entry(pool, ip, mac);
+    if (!entry || entry->state != IP_STATE_PROBING)
     {
-        struct ip_pool_entry_t *entry = &pool->entries[i];
+        pthread_mutex_unlock(&stripe->mutex);
+        return -1;
+    }
 
-        if (entry->state == IP_STATE_AVAILABLE)
-        {
-            // Ping check if enabled and not a loopback address
-            if (config->global.ping_check && !ip_is_loopback(entry->ip_address))
-            {
-                if (ip_ping_check(entry->ip_address, config->global.ping_timeout * 1000))
-                {
-                    ip_pool_mark_conflict(pool, entry->ip_address);
-                    continue;
-                }
-            }
+    entry_set_state(pool, entry, new_state, new_state == IP_STATE_ALLOCATED ? mac : NULL);
+    if (new_state == IP_STATE_ALLOCATED)
+        entry->last_allocated = time(NULL);
+
+    pthread_mutex_unlock(&stripe->mutex);
+    return 0;
+}
 
-            result.success = true;
-            result.ip_address = entry->ip_address;
+// Take an address for a client; see ip_pool_claim_ip(). Caller holds the stripe of mac.
+static int claim_locked(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6], const uint8_t *client_id,
+                        uint32_t client_id_len, struct ip_pool_entry_t **claimed)
+{
+    *claimed = NULL;
 
-            // Inline reservation logic
-            pool->available_count--;
-            entry->state = IP_STATE_ALLOCATED;
-            memcpy(entry->mac_address, mac, 6);
-            entry->last_allocated = time(NULL);
-            pool->allocated_count++;
+    struct dhcp_host_reservation_t *host = find_host(pool, mac, client_id, client_id_len);
+    if (host && host->fixed_address.s_addr == ip.s_addr)
+        return 0;
 
-            pthread_mutex_unlock(&pool->mutex);
-            return result;
-        }
+    struct ip_pool_entry_t *entry = find_owned_entry(pool, ip, mac);
+    if (entry)
+    {
+        if (entry->state != IP_STATE_ALLOCATED)
+            return -1; // Still being probed
+        *claimed = entry;
+        return 0;
     }
 
-    // No available IPs
-    result.success = false;
-    snprintf(result.error_message, sizeof(result.error_message), "No available IPs in pool");
-    pthread_mutex_unlock(&pool->mutex);
-    return result;
+    entry = ip_pool_find_entry(pool, ip);
+    if (!entry || !ip_bitmap_test_and_clear(&pool->free_map, entry_index(pool, entry)))
+        return -1;
+
+    entry_set_state(pool, entry, IP_STATE_ALLOCATED, mac);
+    entry->last_allocated = time(NULL);
+    *claimed = entry;
+    return 0;
 }
 
-// Update a single pool entry from a lease
-int ip_pool_update_from_lease(struct ip_pool_t *pool, struct dhcp_lease_t *lease)
+int ip_pool_claim_ip(struct ip_pool_t *pool, struct in_addr ip, const uint8_t mac[6])
 {
-    if (!pool || !lease)
+    if (!pool || !mac)
         return -1;
 
+    struct ip_pool_entry_t *entry;
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    pthread_mutex_lock(&stripe->mutex);
+    int result = claim_locked(pool, ip, mac, NULL, 0, &entry);
+    pthread_mutex_unlock(&stripe->mutex);
+    return result;
+}
+
+// Update a single pool entry from a lease. Caller holds every stripe.
+static int update_from_lease_locked(struct ip_pool_t *pool, struct dhcp_lease_t *lease)
+{
     struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, lease->ip_address);
     if (!entry)
         return -1; // IP not in this pool's range
 
-    // Skip if this is a static reservation (config takes priority)
-    if (entry->state == IP_STATE_RESERVED)
+    // Skip if this is a static reservation (config takes priority) or is being probed
+    if (entry->state == IP_STATE_RESERVED || entry->state == IP_STATE_PROBING)
         return 0;
 
     // Check if lease is expired
@@ -623,369 +749,262 @@ int ip_pool_update_from_lease(struct ip_pool_t *pool, struct dhcp_lease_t *lease
     }
 
     // Map lease state to IP state
-    ip_state_t old_state = entry->state;
     ip_state_t new_state = ip_state_from_lease_state(lease->state);
 
-    // Handle ALL state transitions by decrement-then-increment
-    // Decrement old state counter
-    if (old_state == IP_STATE_AVAILABLE)
-    {
-        pool->available_count--;
-    }
-    else if (old_state == IP_STATE_ALLOCATED)
-    {
-        pool->allocated_count--;
-    }
-    // CONFLICT, EXCLUDED, RESERVED don't have dedicated counters
-
-    // Increment new state counter
-    if (new_state == IP_STATE_AVAILABLE)
-    {
-        pool->available_count++;
-    }
-    else if (new_state == IP_STATE_ALLOCATED)
-    {
-        pool->allocated_count++;
-    }
-    // CONFLICT, EXCLUDED, RESERVED don't have dedicated counters
-
-    // Update entry
-    entry->state = new_state;
+    // Update entry (counters, free bitmap and MAC index follow the state)
+    entry_set_state(pool, entry, new_state, new_state == IP_STATE_ALLOCATED ? lease->mac_address : NULL);
     entry->lease_id = lease->lease_id;
 
     if (new_state == IP_STATE_ALLOCATED)
     {
-        memcpy(entry->mac_address, lease->mac_address, 6);
         entry->last_allocated = lease->start_time;
     }
-    else if (new_state == IP_STATE_AVAILABLE)
+
+    return 0;
+}
+
+int ip_pool_update_from_lease(struct ip_pool_t *pool, struct dhcp_lease_t *lease)
+{
+    if (!pool || !lease)
+        return -1;
+
+    lock_all_stripes(pool);
+    int result = update_from_lease_locked(pool, lease);
+    unlock_all_stripes(pool);
+    return result;
+}
+
+// Free the entry of a lease the timer has just expired
+int ip_pool_expire_lease(struct ip_pool_t *pool, const struct dhcp_lease_t *lease)
+{
+    if (!pool || !lease)
+        return -1;
+
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, lease->mac_address);
+    pthread_mutex_lock(&stripe->mutex);
+    struct ip_pool_entry_t *entry = find_owned_entry(pool, lease->ip_address, lease->mac_address);
+
+    // Reservations, probes and addresses already handed to someone else stay as they are
+    if (!entry || entry->state != IP_STATE_ALLOCATED)
     {
-        memset(entry->mac_address, 0, 6);
+        pthread_mutex_unlock(&stripe->mutex);
+        return -1;
     }
 
+    entry->lease_id = lease->lease_id;
+    entry_set_state(pool, entry, IP_STATE_AVAILABLE, NULL);
+
+    pthread_mutex_unlock(&stripe->mutex);
     return 0;
 }
 
-// Sync entire pool with lease database (useful after lease changes)
+// Sync entire pool with lease database (useful after lease changes). One
+// shard at a time: a worker committing a lease waits for one shard's scan at
+// most, never for the whole database.
 int ip_pool_sync_with_leases(struct ip_pool_t *pool, struct lease_database_t *lease_db)
 {
     if (!pool || !lease_db)
         return -1;
 
-    pthread_mutex_lock(&pool->mutex);
-
-    for (uint32_t i = 0; i < lease_db->lease_count; i++)
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        ip_pool_update_from_lease(pool, &lease_db->leases[i]);
+        lease_db_lock_shard(lease_db, s);
+        lock_all_stripes(pool);
+        for (uint32_t i = 0; i < lease_db->shards[s].lease_count; i++)
+        {
+            update_from_lease_locked(pool, lease_shard_get(&lease_db->shards[s], i));
+        }
+        unlock_all_stripes(pool);
+        lease_db_unlock_shard(lease_db, s);
     }
-
-    pthread_mutex_unlock(&pool->mutex);
     return 0;
 }
 
-// Allocate IP and create corresponding lease in database
-struct dhcp_lease_t *ip_pool_allocate_and_create_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db,
-                                                       const uint8_t mac[6], struct in_addr requested_ip,
-                                                       struct dhcp_config_t *config, uint32_t lease_time)
+// Create or renew the lease for an address the pool has allocated
+int ip_pool_commit_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, const uint8_t mac[6],
+                         const uint8_t *client_id, uint32_t client_id_len, struct in_addr ip, uint32_t lease_time,
+                         struct dhcp_lease_t *out_lease)
 {
-    if (!pool || !lease_db || !mac || !config)
-        return NULL;
+    if (!pool || !lease_db || !mac)
+        return -1;
 
-    // First, try to allocate from pool
-    struct ip_allocation_result_t result = ip_pool_allocate(pool, mac, requested_ip, config);
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    lease_db_lock_ip(lease_db, ip);
+    pthread_mutex_lock(&stripe->mutex);
 
-    if (!result.success)
+    // The address must be this client's before its lease becomes ACTIVE
+    struct ip_pool_entry_t *entry;
+    if (claim_locked(pool, ip, mac, client_id, client_id_len, &entry) != 0)
     {
-        return NULL;
+        pthread_mutex_unlock(&stripe->mutex);
+        lease_db_unlock_ip(lease_db, ip);
+        return -1;
     }
 
-    // Check if lease already exists for this IP
-    struct dhcp_lease_t *existing_lease = lease_db_find_by_ip(lease_db, result.ip_address);
+    // Renew the client's own lease; a lease another client left on the address
+    // is replaced once it has ended. While a reload publishes new pools, the
+    // old and the new pool may both hand out the same address: the lease
+    // already ACTIVE for the other client wins.
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(lease_db, ip);
+    if (lease && memcmp(lease->mac_address, mac, 6) != 0 && lease->state == LEASE_STATE_ACTIVE &&
+        lease->end_time >= time(NULL))
+    {
+        release_locked(pool, ip, mac);
+        pthread_mutex_unlock(&stripe->mutex);
+        lease_db_unlock_ip(lease_db, ip);
+        return -1;
+    }
+    if (lease && memcmp(lease->mac_address, mac, 6) == 0)
+        lease_db_renew_lease(lease_db, ip, lease_time);
+    else
+        lease = lease_db_add_lease(lease_db, ip, mac, lease_time);
 
-    if (existing_lease)
+    if (lease)
     {
-        // Update existing lease
-        if (lease_db_renew_lease(lease_db, result.ip_address, lease_time) == 0)
-        {
-            // Update pool entry reference
-            struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, result.ip_address);
-            if (entry)
-            {
-                entry->lease_id = existing_lease->lease_id;
-            }
-            return existing_lease;
-        }
-        else
-        {
-            // Rollback: release IP from pool
-            ip_pool_release_ip(pool, result.ip_address);
-            return NULL;
-        }
+        // Update pool entry reference
+        if (entry)
+            entry->lease_id = lease->lease_id;
+        if (out_lease)
+            *out_lease = *lease;
     }
     else
     {
-        // Create new lease
-        struct dhcp_lease_t *new_lease = lease_db_add_lease(lease_db, result.ip_address, mac, lease_time);
-
-        if (new_lease)
-        {
-            // Update pool entry reference
-            struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, result.ip_address);
-            if (entry)
-            {
-                entry->lease_id = new_lease->lease_id;
-            }
-            return new_lease;
-        }
-        else
-        {
-            // Rollback: release IP from pool
-            ip_pool_release_ip(pool, result.ip_address);
-            return NULL;
-        }
+        // Rollback: release IP from pool
+        release_locked(pool, ip, mac);
     }
-}
 
-void ip_pool_print_stats(const struct ip_pool_t *pool)
-{
-    if (!pool)
-        return;
-
-    char network_str[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &pool->subnet->network, network_str, INET_ADDRSTRLEN);
-
-    printf("\n--- IP Pool Statistics ---\n");
-    printf("Subnet: %s\n", network_str);
-    printf("Pool Size: %u\n", pool->pool_size);
-    printf("Available: %u\n", pool->available_count);
-    printf("Allocated: %u\n", pool->allocated_count);
-    printf("Utilization: %.1f%%\n", pool->pool_size > 0 ? (pool->allocated_count * 100.0 / pool->pool_size): 0.0);
+    pthread_mutex_unlock(&stripe->mutex);
+    lease_db_unlock_ip(lease_db, ip);
+    return lease ? 0 : -1;
 }
 
-void ip_pool_print_detailed(const struct ip_pool_t *pool)
+int ip_pool_renew_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, struct in_addr ip,
+                        const uint8_t mac[6], const uint8_t *client_id, uint32_t client_id_len, uint32_t lease_time,
+                        struct dhcp_lease_t *out_lease)
 {
-    if (!pool)
-        return;
+    if (!pool || !lease_db || !mac)
+        return -1;
 
-    ip_pool_print_stats(pool);
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    lease_db_lock_ip(lease_db, ip);
 
-    printf("\n--- IP Pool Entries ---\n");
-    for (uint32_t i = 0; i < pool->pool_size; i++)
+    int result = -1;
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(lease_db, ip);
+    if (lease && memcmp(lease->mac_address, mac, 6) == 0)
     {
-        const struct ip_pool_entry_t *entry = &pool->entries[i];
-        char ip_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &entry->ip_address, ip_str, INET_ADDRSTRLEN);
-
-        printf("%s - %s", ip_str, ip_state_to_string(entry->state));
-
-        if (entry->state == IP_STATE_ALLOCATED || entry->state == IP_STATE_RESERVED)
+        // An ended lease is only renewed while its address is still free or ours
+        struct ip_pool_entry_t *entry;
+        pthread_mutex_lock(&stripe->mutex);
+        if (claim_locked(pool, ip, mac, client_id, client_id_len, &entry) == 0 && lease_db_renew_lease(lease_db, ip, lease_time) == 0)
         {
-            printf(" - MAC: %02x:%02x:%02x:%02x:%02x:%02x", entry->mac_address[0],
-            entry->mac_address[1], entry->mac_address[2],
-            entry->mac_address[3], entry->mac_address[4],
-            entry->mac_address[5]);
+            if (entry)
+                entry->lease_id = lease->lease_id;
+            if (out_lease)
+                *out_lease = *lease;
+            result = 0;
         }
-
-        printf("\n");
+        pthread_mutex_unlock(&stripe->mutex);
     }
-}
-
-//=============================================================================
-// IP Pool Sync Thread Operations
-//=============================================================================
 
-// Forward declaration of sync thread function
-static void *ip_pool_sync_thread_func(void *arg);
+    lease_db_unlock_ip(lease_db, ip);
+    return result;
+}
 
-int ip_pool_sync_init(struct ip_pool_sync_t *sync, struct ip_pool_t *pool,
-                      struct lease_database_t *lease_db, uint32_t sync_interval_sec)
+int ip_pool_release_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, struct in_addr ip,
+                          const uint8_t mac[6], struct dhcp_lease_t *out_lease)
 {
-    if (!sync || !pool || !lease_db || sync_interval_sec == 0)
+    if (!pool || !lease_db || !mac)
         return -1;
 
-    memset(sync, 0, sizeof(struct ip_pool_sync_t));
-
-    sync->pool = pool;
-    sync->lease_db = lease_db;
-    sync->sync_interval_sec = sync_interval_sec;
-    sync->running = false;
-    sync->sync_count = 0;
-    sync->entries_updated = 0;
-
-    if (pthread_mutex_init(&sync->sync_mutex, NULL) != 0)
-    {
-        perror("Failed to initialize sync mutex");
-        return -1;
-    }
+    struct ip_pool_stripe_t *stripe = stripe_of(pool, mac);
+    lease_db_lock_ip(lease_db, ip);
 
-    if (pthread_cond_init(&sync->sync_cond, NULL) != 0)
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(lease_db, ip);
+    if (!lease || memcmp(lease->mac_address, mac, 6) != 0 || lease_db_release_lease(lease_db, ip) != 0)
     {
-        perror("Failed to initialize sync condition variable");
-        pthread_mutex_destroy(&sync->sync_mutex);
+        lease_db_unlock_ip(lease_db, ip);
         return -1;
     }
+    if (out_lease)
+        *out_lease = *lease;
 
-    sync->mutex_initialized = true;
+    pthread_mutex_lock(&stripe->mutex);
+    release_locked(pool, ip, mac);
+    pthread_mutex_unlock(&stripe->mutex);
 
-    printf("IP pool sync initialized (interval: %u seconds)\n", sync_interval_sec);
+    lease_db_unlock_ip(lease_db, ip);
     return 0;
 }
 
-int ip_pool_sync_start(struct ip_pool_sync_t *sync)
+// Allocate IP and create corresponding lease in database
+int ip_pool_allocate_and_create_lease(struct ip_pool_t *pool, struct lease_database_t *lease_db, const uint8_t mac[6],
+                                      const uint8_t *client_id, uint32_t client_id_len, struct in_addr requested_ip,
+                                      struct dhcp_config_t *config, uint32_t lease_time,
+                                      struct dhcp_lease_t *out_lease)
 {
-    if (!sync || !sync->mutex_initialized)
+    if (!pool || !lease_db || !mac || !config)
         return -1;
 
-    pthread_mutex_lock(&sync->sync_mutex);
-
-    if (sync->running)
-    {
-        pthread_mutex_unlock(&sync->sync_mutex);
-        return -1; // Already running
-    }
-
-    sync->running = true;
-    pthread_mutex_unlock(&sync->sync_mutex);
+    // First, try to allocate from pool
+    struct ip_allocation_result_t result = ip_pool_allocate(pool, mac, client_id, client_id_len, requested_ip, config);
 
-    if (pthread_create(&sync->sync_thread, NULL, ip_pool_sync_thread_func, sync) != 0)
+    if (!result.success)
     {
-        perror("Failed to create sync thread");
-        pthread_mutex_lock(&sync->sync_mutex);
-        sync->running = false;
-        pthread_mutex_unlock(&sync->sync_mutex);
         return -1;
     }
 
-    printf("IP pool sync thread started\n");
-    return 0;
-}
-
-void ip_pool_sync_stop(struct ip_pool_sync_t *sync)
-{
-    if (!sync || !sync->mutex_initialized)
-        return;
-
-    pthread_mutex_lock(&sync->sync_mutex);
-    if (!sync->running)
+    // No prober on this path: take the address as if the probe had timed out
+    if (result.needs_probe)
     {
-        pthread_mutex_unlock(&sync->sync_mutex);
-        return;
+        ip_pool_resolve_probe(pool, result.ip_address, mac, IP_STATE_ALLOCATED);
     }
 
-    sync->running = false;
-    pthread_cond_signal(&sync->sync_cond);
-    pthread_mutex_unlock(&sync->sync_mutex);
-
-    pthread_join(sync->sync_thread, NULL);
-
-    pthread_mutex_destroy(&sync->sync_mutex);
-    pthread_cond_destroy(&sync->sync_cond);
-    sync->mutex_initialized = false;
-
-    printf("IP pool sync thread stopped (syncs: %lu, entries updated: %lu)\n", sync->sync_count, sync->entries_updated);
+    return ip_pool_commit_lease(pool, lease_db, mac, client_id, client_id_len, result.ip_address, lease_time,
+                                out_lease);
 }
 
-void ip_pool_sync_wakeup(struct ip_pool_sync_t *sync)
+void ip_pool_print_stats(const struct ip_pool_t *pool)
 {
-    if (!sync || !sync->mutex_initialized)
+    if (!pool)
         return;
 
-    pthread_mutex_lock(&sync->sync_mutex);
-    pthread_cond_signal(&sync->sync_cond);
-    pthread_mutex_unlock(&sync->sync_mutex);
-}
-
-bool ip_pool_sync_is_running(const struct ip_pool_sync_t *sync)
-{
-    if (!sync || !sync->mutex_initialized)
-        return false;
+    char network_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &pool_subnet(pool)->network, network_str, INET_ADDRSTRLEN);
 
-    return sync->running;
+    printf("\n--- IP Pool Statistics ---\n");
+    printf("Subnet: %s\n", network_str);
+    printf("Pool Size: %u\n", pool->pool_size);
+    uint32_t available = __atomic_load_n(&pool->available_count, __ATOMIC_RELAXED);
+    uint32_t allocated = __atomic_load_n(&pool->allocated_count, __ATOMIC_RELAXED);
+    printf("Available: %u\n", available);
+    printf("Allocated: %u\n", allocated);
+    printf("Utilization: %.1f%%\n", pool->pool_size > 0 ? (allocated * 100.0 / pool->pool_size): 0.0);
 }
 
-// Sync thread function - runs in background
-static void *ip_pool_sync_thread_func(void *arg)
+void ip_pool_print_detailed(const struct ip_pool_t *pool)
 {
-    struct ip_pool_sync_t *sync = (struct ip_pool_sync_t *)arg;
-    if (!sync)
-        return NULL;
+    if (!pool)
+        return;
 
-    printf("IP pool sync thread started (PID: %d, TID: %lu)\n", getpid(), pthread_self());
+    ip_pool_print_stats(pool);
 
-    while (1)
+    printf("\n--- IP Pool Entries ---\n");
+    for (uint32_t i = 0; i < pool->pool_size; i++)
     {
-        struct timespec ts;
-        clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += sync->sync_interval_sec;
-
-        pthread_mutex_lock(&sync->sync_mutex);
-        pthread_cond_timedwait(&sync->sync_cond, &sync->sync_mutex, &ts);
-
-        bool should_run = sync->running;
-        pthread_mutex_unlock(&sync->sync_mutex);
-
-        if (!should_run)
-            break;
-
-        // Perform synchronization
-        pthread_mutex_lock(&sync->pool->mutex);
-        pthread_mutex_lock(&sync->lease_db->db_mutex);
+        const struct ip_pool_entry_t *entry = &pool->entries[i];
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &entry->ip_address, ip_str, INET_ADDRSTRLEN);
 
-        uint64_t updated = 0;
-        time_t now = time(NULL);
+        printf("%s - %s", ip_str, ip_state_to_string(entry->state));
 
-        for (uint32_t i = 0; i < sync->lease_db->lease_count; i++)
+        if (entry->state == IP_STATE_ALLOCATED || entry->state == IP_STATE_RESERVED)
         {
-            struct dhcp_lease_t *lease = &sync->lease_db->leases[i];
-            struct ip_pool_entry_t *entry = ip_pool_find_entry(sync->pool, lease->ip_address);
-
-            if (!entry || entry->state == IP_STATE_RESERVED || entry->state == IP_STATE_EXCLUDED)
-                continue;
-
-            // Check if lease expired and update if needed
-            if (lease->state == LEASE_STATE_ACTIVE && lease->end_time < now)
-            {
-                lease->state = LEASE_STATE_EXPIRED;
-            }
-
-            ip_state_t expected_state = ip_state_from_lease_state(lease->state);
-
-            if (entry->state != expected_state)
-            {
-                // Update counters
-                if (entry->state == IP_STATE_AVAILABLE)
-                    sync->pool->available_count--;
-                else if (entry->state == IP_STATE_ALLOCATED)
-                    sync->pool->allocated_count--;
-
-                if (expected_state == IP_STATE_AVAILABLE)
-                    sync->pool->available_count++;
-                else if (expected_state == IP_STATE_ALLOCATED)
-                    sync->pool->allocated_count++;
-
-                entry->state = expected_state;
-
-                if (expected_state == IP_STATE_AVAILABLE)
-                    memset(entry->mac_address, 0, 6);
-                else if (expected_state == IP_STATE_ALLOCATED)
-                    memcpy(entry->mac_address, lease->mac_address, 6);
-
-                updated++;
-            }
+            printf(" - MAC: %02x:%02x:%02x:%02x:%02x:%02x", entry->mac_address[0],
+            entry->mac_address[1], entry->mac_address[2],
+            entry->mac_address[3], entry->mac_address[4],
+            entry->mac_address[5]);
         }
 
-        pthread_mutex_unlock(&sync->lease_db->db_mutex);
-        pthread_mutex_unlock(&sync->pool->mutex);
-
-        sync->sync_count++;
-        sync->entries_updated += updated;
-
-        if (updated > 0)
-        {
-            printf("[Sync] Updated %lu pool entries\n", updated);
-        }
+        printf("\n");
     }
-
-    printf("IP pool sync thread exiting\n");
-    return NULL;
-}
\ No newline at end of file
+}
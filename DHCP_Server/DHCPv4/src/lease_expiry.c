@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/lease_expiry.h"
+
+static int grow(struct lease_expiry_heap_t *heap, uint32_t capacity)
+{
+    struct lease_expiry_entry_t *entries = realloc(heap->entries, capacity * sizeof(struct lease_expiry_entry_t));
+    if (!entries)
+    {
+        perror("Failed to grow lease expiry heap");
+        return -1;
+    }
+    heap->entries = entries;
+    heap->capacity = capacity;
+    return 0;
+}
+
+int lease_expiry_init(struct lease_expiry_heap_t *heap)
+{
+    if (!heap)
+        return -1;
+
+    memset(heap, 0, sizeof(struct lease_expiry_heap_t));
+    return grow(heap, LEASE_EXPIRY_MIN_CAPACITY);
+}
+
+void lease_expiry_free(struct lease_expiry_heap_t *heap)
+{
+    if (!heap)
+        return;
+
+    free(heap->entries);
+    memset(heap, 0, sizeof(struct lease_expiry_heap_t));
+}
+
+void lease_expiry_clear(struct lease_expiry_heap_t *heap)
+{
+    if (heap)
+        heap->count = 0;
+}
+
+int lease_expiry_reserve(struct lease_expiry_heap_t *heap, uint32_t entries)
+{
+    if (!heap)
+        return -1;
+    if (entries <= heap->capacity)
+        return 0;
+    return grow(heap, entries);
+}
+
+int lease_expiry_push(struct lease_expiry_heap_t *heap, time_t end_time, struct in_addr ip)
+{
+    if (!heap)
+        return -1;
+
+    if (heap->count == heap->capacity &&
+        grow(heap, heap->capacity ? heap->capacity * 2 : LEASE_EXPIRY_MIN_CAPACITY) != 0)
+        return -1;
+
+    // Sift up: move parents down until the new entry's place is found
+    uint32_t pos = heap->count++;
+    while (pos > 0)
+    {
+        uint32_t parent = (pos - 1) / 2;
+        if (heap->entries[parent].end_time <= end_time)
+            break;
+        heap->entries[pos] = heap->entries[parent];
+        pos = parent;
+    }
+    heap->entries[pos].end_time = end_time;
+    heap->entries[pos].ip = ip;
+    return 0;
+}
+
+bool lease_expiry_pop_due(struct lease_expiry_heap_t *heap, time_t before, struct lease_expiry_entry_t *entry)
+{
+    if (!heap || heap->count == 0 || heap->entries[0].end_time >= before)
+        return false;
+
+    *entry = heap->entries[0];
+
+    // Sift the last entry down from the root
+    struct lease_expiry_entry_t last = heap->entries[--heap->count];
+    uint32_t pos = 0;
+    for (;;)
+    {
+        uint32_t child = 2 * pos + 1;
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count && heap->entries[child + 1].end_time < heap->entries[child].end_time)
+            child++;
+        if (last.end_time <= heap->entries[child].end_time)
+            break;
+        heap->entries[pos] = heap->entries[child];
+        pos = child;
+    }
+    if (heap->count > 0)
+        heap->entries[pos] = last;
+    return true;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/lease_index.h"
+
+static uint32_t capacity_for(uint32_t entries)
+{
+    // Keep the table at most 1/4 full right after sizing so it can absorb
+    // as many inserts again before the next rehash
+    uint64_t wanted = (uint64_t)entries * 4;
+    uint64_t capacity = LEASE_INDEX_MIN_CAPACITY;
+    while (capacity < wanted)
+        capacity <<= 1;
+    return capacity > 0x80000000ULL ? 0x80000000u : (uint32_t)capacity;
+}
+
+static void place(struct lease_index_slot_t *slots, uint32_t mask, uint32_t hash, uint32_t ref)
+{
+    uint32_t pos = hash & mask;
+    while (slots[pos].ref != LEASE_INDEX_EMPTY)
+        pos = (pos + 1) & mask;
+    slots[pos].hash = hash;
+    slots[pos].ref = ref;
+}
+
+static int rehash(struct lease_index_t *idx, uint32_t new_capacity)
+{
+    struct lease_index_slot_t *slots = calloc(new_capacity, sizeof(struct lease_index_slot_t));
+    if (!slots)
+    {
+        perror("Failed to grow lease index");
+        return -1;
+    }
+
+    // Tombstones are dropped here
+    for (uint32_t i = 0; i < idx->capacity; i++)
+    {
+        uint32_t ref = idx->slots[i].ref;
+        if (ref != LEASE_INDEX_EMPTY && ref != LEASE_INDEX_TOMBSTONE)
+            place(slots, new_capacity - 1, idx->slots[i].hash, ref);
+    }
+
+    free(idx->slots);
+    idx->slots = slots;
+    idx->capacity = new_capacity;
+    idx->used = idx->live;
+    return 0;
+}
+
+int lease_index_init(struct lease_index_t *idx, uint32_t expected_entries)
+{
+    if (!idx)
+        return -1;
+
+    memset(idx, 0, sizeof(struct lease_index_t));
+    idx->capacity = capacity_for(expected_entries);
+    idx->slots = calloc(idx->capacity, sizeof(struct lease_index_slot_t));
+    if (!idx->slots)
+    {
+        perror("Failed to allocate lease index");
+        idx->capacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void lease_index_free(struct lease_index_t *idx)
+{
+    if (idx)
+    {
+        free(idx->slots);
+        memset(idx, 0, sizeof(struct lease_index_t));
+    }
+}
+
+void lease_index_clear(struct lease_index_t *idx)
+{
+    if (!idx || !idx->slots)
+        return;
+
+    memset(idx->slots, 0, (size_t)idx->capacity * sizeof(struct lease_index_slot_t));
+    idx->live = 0;
+    idx->used = 0;
+}
+
+int lease_index_reserve(struct lease_index_t *idx, uint32_t expected_entries)
+{
+    if (!idx || !idx->slots)
+        return -1;
+
+    uint32_t capacity = capacity_for(expected_entries);
+    if (capacity <= idx->capacity)
+        return 0;
+    return rehash(idx, capacity);
+}
+
+int lease_index_insert(struct lease_index_t *idx, uint32_t hash, uint32_t slot)
+{
+    if (!idx || !idx->slots || slot >= LEASE_INDEX_TOMBSTONE - 1)
+        return -1;
+
+    if ((uint64_t)(idx->used + 1) * 2 > idx->capacity)
+    {
+        // Mostly tombstones: rebuild in place; otherwise grow
+        if (rehash(idx, capacity_for(idx->live + 1)) != 0)
+            return -1;
+    }
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t pos = hash & mask;
+    while (idx->slots[pos].ref != LEASE_INDEX_EMPTY && idx->slots[pos].ref != LEASE_INDEX_TOMBSTONE)
+        pos = (pos + 1) & mask;
+
+    if (idx->slots[pos].ref == LEASE_INDEX_EMPTY)
+        idx->used++;
+    idx->slots[pos].hash = hash;
+    idx->slots[pos].ref = slot + 1;
+    idx->live++;
+    return 0;
+}
+
+bool lease_index_remove(struct lease_index_t *idx, uint32_t hash, uint32_t slot)
+{
+    if (!idx || !idx->slots)
+        return false;
+
+    uint32_t mask = idx->capacity - 1;
+    uint32_t pos = hash & mask;
+    for (uint32_t probes = 0; probes < idx->capacity; probes++)
+    {
+        struct lease_index_slot_t *s = &idx->slots[pos];
+        if (s->ref == LEASE_INDEX_EMPTY)
+            return false;
+        if (s->ref == slot + 1 && s->hash == hash)
+        {
+            s->ref = LEASE_INDEX_TOMBSTONE;
+            idx->live--;
+            return true;
+        }
+        pos = (pos + 1) & mask;
+    }
+    return false;
+}
+
+void lease_index_find(const struct lease_index_t *idx, uint32_t hash, struct lease_index_iter_t *iter)
+{
+    iter->hash = hash;
+    iter->pos = (idx && idx->capacity) ? (hash & (idx->capacity - 1)) : 0;
+    iter->probes = 0;
+}
+
+bool lease_index_next(const struct lease_index_t *idx, struct lease_index_iter_t *iter, uint32_t *slot)
+{
+    if (!idx || !idx->slots)
+        return false;
+
+    uint32_t mask = idx->capacity - 1;
+    while (iter->probes < idx->capacity)
+    {
+        const struct lease_index_slot_t *s = &idx->slots[iter->pos];
+        if (s->ref == LEASE_INDEX_EMPTY)
+            return false;
+
+        iter->pos = (iter->pos + 1) & mask;
+        iter->probes++;
+
+        if (s->ref != LEASE_INDEX_TOMBSTONE && s->hash == iter->hash)
+        {
+            *slot = s->ref - 1;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,522 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/src/lease_journal.h"
+#include "../include/src/lease_loader.h"
+#include "../include/src/lease_v4.h"
+#include "../include/utils/encoding_utils.h"
+
+#define SNAPSHOT_WRITE_BATCH 256 // Records per write() while writing a snapshot
+
+//=============================================================================
+// Record encoding
+//=============================================================================
+
+static uint32_t record_crc(const struct lease_journal_record_t *rec)
+{
+    struct lease_journal_record_t copy = *rec;
+    copy.crc32 = 0;
+    return crc32_update(0, &copy, sizeof(copy));
+}
+
+static uint32_t header_crc(const struct lease_snapshot_header_t *hdr)
+{
+    struct lease_snapshot_header_t copy = *hdr;
+    copy.crc32 = 0;
+    return crc32_update(0, &copy, sizeof(copy));
+}
+
+// Copy up to room bytes of a string field into data[], returning the bytes used
+static uint8_t pack_field(uint8_t *dst, uint32_t room, const void *src, size_t len)
+{
+    if (!src)
+        return 0;
+    if (len > room)
+        len = room;
+    if (len > UINT8_MAX)
+        len = UINT8_MAX;
+    memcpy(dst, src, len);
+    return (uint8_t)len;
+}
+
+static void encode_record(struct lease_journal_record_t *rec, const struct dhcp_lease_t *lease, uint64_t seq)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = LEASE_JOURNAL_MAGIC;
+    rec->seq = seq;
+    rec->lease_id = lease->lease_id;
+    rec->start_time = lease->start_time;
+    rec->end_time = lease->end_time;
+    rec->tstp = lease->tstp;
+    rec->cltt = lease->cltt;
+    rec->ip_address = lease->ip_address.s_addr;
+    memcpy(rec->mac_address, lease->mac_address, 6);
+    rec->state = lease->state;
+    rec->next_binding_state = lease->next_binding_state;
+    rec->rewind_binding_state = lease->rewind_binding_state;
+    rec->flags = (lease->is_abandoned ? LEASE_JOURNAL_FLAG_ABANDONED : 0) |
+                 (lease->is_bootp ? LEASE_JOURNAL_FLAG_BOOTP : 0);
+
+    uint32_t used = 0;
+    rec->client_id_len = pack_field(rec->data, LEASE_JOURNAL_DATA_SIZE, lease->client_id, lease->client_id_len);
+    used += rec->client_id_len;
+    if (lease->client_hostname)
+    {
+        rec->hostname_len = pack_field(rec->data + used, LEASE_JOURNAL_DATA_SIZE - used, lease->client_hostname,
+                                       strlen(lease->client_hostname));
+        used += rec->hostname_len;
+    }
+    if (lease->vendor_class_identifier)
+    {
+        rec->vendor_class_len = pack_field(rec->data + used, LEASE_JOURNAL_DATA_SIZE - used,
+                                           lease->vendor_class_identifier, strlen(lease->vendor_class_identifier));
+    }
+
+    rec->crc32 = record_crc(rec);
+}
+
+// Check a record read from disk
+static bool record_valid(const struct lease_journal_record_t *rec)
+{
+    if (rec->magic != LEASE_JOURNAL_MAGIC || rec->crc32 != record_crc(rec))
+        return false;
+    return (uint32_t)rec->client_id_len + rec->hostname_len + rec->vendor_class_len <= LEASE_JOURNAL_DATA_SIZE &&
+           rec->client_id_len <= MAX_CLIENT_ID_LEN;
+}
+
+// Rebuild a lease from a valid record and store it in db
+static int restore_record(struct lease_database_t *db, const struct lease_journal_record_t *rec)
+{
+    char hostname[LEASE_JOURNAL_DATA_SIZE + 1];
+    char vendor[LEASE_JOURNAL_DATA_SIZE + 1];
+    struct dhcp_lease_t lease;
+
+    memset(&lease, 0, sizeof(lease));
+    lease.lease_id = rec->lease_id;
+    lease.start_time = (time_t)rec->start_time;
+    lease.end_time = (time_t)rec->end_time;
+    lease.tstp = (time_t)rec->tstp;
+    lease.cltt = (time_t)rec->cltt;
+    lease.ip_address.s_addr = rec->ip_address;
+    memcpy(lease.mac_address, rec->mac_address, 6);
+    lease.state = rec->state;
+    lease.next_binding_state = rec->next_binding_state;
+    lease.rewind_binding_state = rec->rewind_binding_state;
+    lease.is_abandoned = (rec->flags & LEASE_JOURNAL_FLAG_ABANDONED) != 0;
+    lease.is_bootp = (rec->flags & LEASE_JOURNAL_FLAG_BOOTP) != 0;
+
+    const uint8_t *p = rec->data;
+    if (rec->client_id_len > 0)
+    {
+        lease.client_id = p;
+        lease.client_id_len = rec->client_id_len;
+        p += rec->client_id_len;
+    }
+    if (rec->hostname_len > 0)
+    {
+        memcpy(hostname, p, rec->hostname_len);
+        hostname[rec->hostname_len] = '\0';
+        lease.client_hostname = hostname;
+        p += rec->hostname_len;
+    }
+    if (rec->vendor_class_len > 0)
+    {
+        memcpy(vendor, p, rec->vendor_class_len);
+        vendor[rec->vendor_class_len] = '\0';
+        lease.vendor_class_identifier = vendor;
+    }
+
+    return lease_db_restore_lease(db, &lease);
+}
+
+//=============================================================================
+// File helpers
+//=============================================================================
+
+// write() the whole buffer, retrying on EINTR and short writes
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// read() exactly len bytes; returns bytes read (< len only at end of file) or -1
+static ssize_t read_full(int fd, void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = read(fd, p + done, len - done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+// fsync the directory holding path, so a rename() in it is durable
+static void sync_parent_dir(const char *path)
+{
+    char dir[288];
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    int fd = open(dirname(dir), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+//=============================================================================
+// Open / close
+//=============================================================================
+
+int lease_journal_open(struct lease_journal_t *journal, const char *lease_file)
+{
+    if (!journal || !lease_file)
+        return -1;
+
+    memset(journal, 0, sizeof(struct lease_journal_t));
+    journal->fd = -1;
+    journal->next_seq = 1;
+
+    if (snprintf(journal->journal_path, sizeof(journal->journal_path), "%s.journal", lease_file) >=
+            (int)sizeof(journal->journal_path) ||
+        snprintf(journal->snapshot_path, sizeof(journal->snapshot_path), "%s.snapshot", lease_file) >=
+            (int)sizeof(journal->snapshot_path))
+    {
+        fprintf(stderr, "Lease file path too long for journal: %s\n", lease_file);
+        return -1;
+    }
+
+    journal->fd = open(journal->journal_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journal->fd < 0)
+    {
+        fprintf(stderr, "Failed to open lease journal %s: %s\n", journal->journal_path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void lease_journal_close(struct lease_journal_t *journal)
+{
+    if (!journal)
+        return;
+
+    if (journal->fd >= 0)
+    {
+        lease_journal_commit(journal);
+        close(journal->fd);
+        journal->fd = -1;
+    }
+    free(journal->pending);
+    journal->pending = NULL;
+    journal->pending_count = 0;
+    journal->pending_capacity = 0;
+}
+
+//=============================================================================
+// Recovery
+//=============================================================================
+
+// Load the snapshot into db. Returns 1 if loaded, 0 if there is none, -1 if unusable.
+static int load_snapshot(struct lease_journal_t *journal, struct lease_database_t *db, uint64_t *journal_seq)
+{
+    // Records are used in place from the page cache; nothing is copied into a read buffer
+    struct lease_file_map_t map;
+    if (lease_file_map(journal->snapshot_path, &map) != 0)
+        return 0;
+
+    struct lease_snapshot_header_t hdr;
+    if (map.size < sizeof(hdr))
+        memset(&hdr, 0, sizeof(hdr));
+    else
+        memcpy(&hdr, map.data, sizeof(hdr));
+
+    if (hdr.magic != LEASE_SNAPSHOT_MAGIC || hdr.version != LEASE_SNAPSHOT_VERSION ||
+        hdr.record_size != LEASE_JOURNAL_RECORD_SIZE || hdr.crc32 != header_crc(&hdr))
+    {
+        fprintf(stderr, "Lease snapshot %s has an invalid header, ignoring it\n", journal->snapshot_path);
+        lease_file_unmap(&map);
+        return -1;
+    }
+
+    uint64_t present = (map.size - sizeof(hdr)) / LEASE_JOURNAL_RECORD_SIZE;
+    uint64_t count = hdr.record_count < present ? hdr.record_count : present;
+    const struct lease_journal_record_t *records =
+        (const struct lease_journal_record_t *)(const void *)(map.data + sizeof(hdr));
+
+    lease_db_reserve(db, (uint32_t)count);
+
+    uint64_t bad = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (!record_valid(&records[i]) || restore_record(db, &records[i]) != 0)
+            bad++;
+    }
+    lease_file_unmap(&map);
+
+    uint64_t missing = hdr.record_count - count;
+    if (missing > 0 || bad > 0)
+        fprintf(stderr, "Lease snapshot %s: %lu records missing, %lu damaged\n", journal->snapshot_path,
+                missing, bad);
+
+    if (hdr.next_lease_id > db->next_lease_id)
+        db->next_lease_id = hdr.next_lease_id;
+    *journal_seq = hdr.journal_seq;
+    return 1;
+}
+
+int lease_journal_recover(struct lease_journal_t *journal, struct lease_database_t *db)
+{
+    if (!journal || journal->fd < 0 || !db)
+        return -1;
+
+    uint64_t snapshot_seq = 0;
+    int loaded = load_snapshot(journal, db, &snapshot_seq);
+    if (loaded <= 0)
+        lease_db_load(db); // First start after an upgrade: import the text lease file
+    else
+        printf("Loaded %u leases from snapshot %s\n", lease_db_count(db), journal->snapshot_path);
+
+    // Replay the journal in order, stopping at the first incomplete or damaged record
+    if (lseek(journal->fd, 0, SEEK_SET) < 0)
+        return -1;
+
+    struct lease_journal_record_t batch[SNAPSHOT_WRITE_BATCH];
+    uint64_t valid = 0, replayed = 0;
+    uint64_t last_seq = snapshot_seq;
+    bool torn = false;
+    while (!torn)
+    {
+        ssize_t got = read_full(journal->fd, batch, sizeof(batch));
+        if (got <= 0)
+            break;
+
+        size_t n = (size_t)got / sizeof(batch[0]);
+        if ((size_t)got % sizeof(batch[0]) != 0)
+            torn = true; // Partial record at the end
+        for (size_t i = 0; i < n; i++)
+        {
+            if (!record_valid(&batch[i]))
+            {
+                torn = true;
+                break;
+            }
+            valid++;
+            if (batch[i].seq > last_seq)
+                last_seq = batch[i].seq;
+            // Records the snapshot already reflects are older than what it holds
+            if (batch[i].seq > snapshot_seq && restore_record(db, &batch[i]) == 0)
+                replayed++;
+        }
+    }
+
+    if (torn)
+    {
+        fprintf(stderr, "Lease journal %s: discarding damaged tail after %lu records\n", journal->journal_path,
+                valid);
+        if (ftruncate(journal->fd, (off_t)(valid * LEASE_JOURNAL_RECORD_SIZE)) != 0)
+        {
+            fprintf(stderr, "Failed to truncate lease journal: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    journal->record_count = valid;
+    journal->next_seq = last_seq + 1;
+    printf("Replayed %lu journal records (%u leases, next ID: %lu)\n", replayed, lease_db_count(db),
+           db->next_lease_id);
+    return 0;
+}
+
+//=============================================================================
+// Group commit
+//=============================================================================
+
+int lease_journal_append(struct lease_journal_t *journal, const struct dhcp_lease_t *lease)
+{
+    if (!journal || !lease)
+        return -1;
+
+    if (journal->pending_count == journal->pending_capacity)
+    {
+        uint32_t capacity = journal->pending_capacity ? journal->pending_capacity * 2 : 64;
+        struct lease_journal_record_t *pending = realloc(journal->pending, capacity * sizeof(*pending));
+        if (!pending)
+        {
+            journal->errors++;
+            return -1;
+        }
+        journal->pending = pending;
+        journal->pending_capacity = capacity;
+    }
+
+    encode_record(&journal->pending[journal->pending_count++], lease, journal->next_seq++);
+    return 0;
+}
+
+int lease_journal_commit(struct lease_journal_t *journal)
+{
+    if (!journal || journal->fd < 0)
+        return -1;
+    if (journal->pending_count == 0)
+        return 0;
+
+    size_t len = (size_t)journal->pending_count * sizeof(struct lease_journal_record_t);
+    off_t start = lseek(journal->fd, 0, SEEK_END);
+
+    if (write_all(journal->fd, journal->pending, len) != 0 || fdatasync(journal->fd) != 0)
+    {
+        fprintf(stderr, "Lease journal write failed: %s\n", strerror(errno));
+        journal->errors++;
+        // Do not leave a partial batch for later appends to follow
+        if (start >= 0 && ftruncate(journal->fd, start) != 0)
+            fprintf(stderr, "Failed to roll back lease journal: %s\n", strerror(errno));
+        journal->pending_count = 0;
+        return -1;
+    }
+
+    journal->record_count += journal->pending_count;
+    journal->records_written += journal->pending_count;
+    journal->commits++;
+    journal->pending_count = 0;
+    return 0;
+}
+
+//=============================================================================
+// Compaction
+//=============================================================================
+
+bool lease_journal_should_compact(const struct lease_journal_t *journal, uint32_t lease_count)
+{
+    if (!journal)
+        return false;
+    return journal->record_count >= LEASE_JOURNAL_COMPACT_MIN && journal->record_count > 2 * (uint64_t)lease_count;
+}
+
+int lease_journal_compact(struct lease_journal_t *journal, struct lease_database_t *db)
+{
+    if (!journal || journal->fd < 0 || !db)
+        return -1;
+
+    if (lease_journal_commit(journal) != 0)
+        return -1;
+
+    // Copy the compact lease records with every shard locked; encoding and disk
+    // I/O happen after they are released (interned strings stay valid without the lock)
+    lease_db_lock(db);
+    uint32_t count = lease_db_count(db);
+    uint64_t next_lease_id = db->next_lease_id;
+    struct dhcp_lease_t *leases = malloc((count ? count : 1) * sizeof(struct dhcp_lease_t));
+    if (!leases)
+    {
+        lease_db_unlock(db);
+        journal->errors++;
+        return -1;
+    }
+    uint32_t copied = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        const struct lease_shard_t *shard = &db->shards[s];
+        for (uint32_t c = 0; c * LEASE_CHUNK_SIZE < shard->lease_count; c++)
+        {
+            uint32_t n = shard->lease_count - c * LEASE_CHUNK_SIZE;
+            if (n > LEASE_CHUNK_SIZE)
+                n = LEASE_CHUNK_SIZE;
+            memcpy(&leases[copied], shard->chunks[c], n * sizeof(struct dhcp_lease_t));
+            copied += n;
+        }
+    }
+    lease_db_unlock(db);
+
+    // Every committed record is older than the copy just taken
+    struct lease_snapshot_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = LEASE_SNAPSHOT_MAGIC;
+    hdr.version = LEASE_SNAPSHOT_VERSION;
+    hdr.record_size = LEASE_JOURNAL_RECORD_SIZE;
+    hdr.record_count = count;
+    hdr.journal_seq = journal->next_seq - 1;
+    hdr.next_lease_id = next_lease_id;
+    hdr.crc32 = header_crc(&hdr);
+
+    char tmp_path[300];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", journal->snapshot_path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create lease snapshot %s: %s\n", tmp_path, strerror(errno));
+        free(leases);
+        journal->errors++;
+        return -1;
+    }
+
+    int rc = write_all(fd, &hdr, sizeof(hdr));
+    struct lease_journal_record_t batch[SNAPSHOT_WRITE_BATCH];
+    for (uint32_t i = 0; rc == 0 && i < count; i += SNAPSHOT_WRITE_BATCH)
+    {
+        uint32_t n = count - i < SNAPSHOT_WRITE_BATCH ? count - i : SNAPSHOT_WRITE_BATCH;
+        for (uint32_t k = 0; k < n; k++)
+            encode_record(&batch[k], &leases[i + k], 0);
+        rc = write_all(fd, batch, n * sizeof(batch[0]));
+    }
+    free(leases);
+
+    if (rc != 0 || fdatasync(fd) != 0)
+    {
+        fprintf(stderr, "Failed to write lease snapshot: %s\n", strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        journal->errors++;
+        return -1;
+    }
+    close(fd);
+
+    if (rename(tmp_path, journal->snapshot_path) != 0)
+    {
+        fprintf(stderr, "Failed to install lease snapshot: %s\n", strerror(errno));
+        unlink(tmp_path);
+        journal->errors++;
+        return -1;
+    }
+    sync_parent_dir(journal->snapshot_path);
+
+    // The snapshot is durable: the journal can start over (sequence numbers keep counting)
+    if (ftruncate(journal->fd, 0) != 0 || fdatasync(journal->fd) != 0)
+    {
+        fprintf(stderr, "Failed to truncate lease journal: %s\n", strerror(errno));
+        journal->errors++;
+        return -1;
+    }
+    journal->record_count = 0;
+    journal->compactions++;
+    return 0;
+}
@@ -0,0 +1,591 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/src/lease_loader.h"
+#include "../include/src/lease_v4.h"
+#include "../include/utils/encoding_utils.h"
+
+#define STMT_MAX_TOKENS 8 // Tokens kept per statement; longer statements are unknown ones anyway
+
+typedef enum lease_token_type_t
+{
+    TOK_EOF = 0,
+    TOK_WORD,    // Bare word: keyword, number, address, date part, '='
+    TOK_STRING,  // Quoted string, span excludes the quotes (escapes left as is)
+    TOK_SEMI,
+    TOK_LBRACE,
+    TOK_RBRACE
+} lease_token_type_t;
+
+struct lease_token_t
+{
+    lease_token_type_t type;
+    const char *text;
+    uint32_t len;
+};
+
+typedef enum stmt_end_t
+{
+    STMT_END_SEMI = 0, // ';'
+    STMT_END_OPEN,     // '{' (the block is not consumed)
+    STMT_END_CLOSE,    // '}' of the enclosing block (consumed)
+    STMT_END_EOF
+} stmt_end_t;
+
+struct lease_stmt_t
+{
+    struct lease_token_t tok[STMT_MAX_TOKENS];
+    uint32_t count;
+};
+
+struct lease_parser_t
+{
+    const char *pos;
+    const char *end;
+
+    // Local time of the last parsed date, to the hour: mktime() only runs when
+    // the hour changes, which in a lease file written in order is rarely
+    int cache_year, cache_mon, cache_mday, cache_hour;
+    time_t cache_base;
+};
+
+// Scratch for the variable-length fields of the lease being parsed
+struct lease_block_strings_t
+{
+    uint8_t client_id[MAX_CLIENT_ID_LEN];
+    char hostname[MAX_CLIENT_HOSTNAME];
+    char vendor_class[MAX_VENDOR_CLASS_LEN];
+};
+
+//=============================================================================
+// Tokenizer
+//=============================================================================
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool is_word_end(char c)
+{
+    return is_space(c) || c == ';' || c == '{' || c == '}' || c == '"' || c == '#';
+}
+
+static lease_token_type_t next_token(struct lease_parser_t *p, struct lease_token_t *tok)
+{
+    const char *s = p->pos;
+    const char *end = p->end;
+
+    // Whitespace and # comments
+    for (;;)
+    {
+        while (s < end && is_space(*s))
+            s++;
+        if (s < end && *s == '#')
+        {
+            const char *nl = memchr(s, '\n', (size_t)(end - s));
+            s = nl ? nl + 1 : end;
+            continue;
+        }
+        break;
+    }
+
+    if (s >= end)
+    {
+        p->pos = end;
+        return tok->type = TOK_EOF;
+    }
+
+    tok->text = s;
+    switch (*s)
+    {
+    case ';':
+        tok->type = TOK_SEMI;
+        s++;
+        break;
+    case '{':
+        tok->type = TOK_LBRACE;
+        s++;
+        break;
+    case '}':
+        tok->type = TOK_RBRACE;
+        s++;
+        break;
+    case '"':
+    {
+        const char *q = ++s;
+        while (q < end && *q != '"')
+            q += (*q == '\\' && q + 1 < end) ? 2 : 1;
+        tok->type = TOK_STRING;
+        tok->text = s;
+        tok->len = (uint32_t)((q < end ? q : end) - s);
+        p->pos = q < end ? q + 1 : end;
+        return TOK_STRING;
+    }
+    default:
+        tok->type = TOK_WORD;
+        while (s < end && !is_word_end(*s))
+            s++;
+        break;
+    }
+
+    tok->len = (uint32_t)(s - tok->text);
+    p->pos = s;
+    return tok->type;
+}
+
+// Collect the tokens of one statement, up to the token that ends it
+static stmt_end_t read_statement(struct lease_parser_t *p, struct lease_stmt_t *stmt)
+{
+    struct lease_token_t tok;
+    stmt->count = 0;
+
+    for (;;)
+    {
+        switch (next_token(p, &tok))
+        {
+        case TOK_SEMI:
+            return STMT_END_SEMI;
+        case TOK_LBRACE:
+            return STMT_END_OPEN;
+        case TOK_RBRACE:
+            return STMT_END_CLOSE;
+        case TOK_EOF:
+            return STMT_END_EOF;
+        default:
+            if (stmt->count < STMT_MAX_TOKENS)
+                stmt->tok[stmt->count++] = tok;
+            break;
+        }
+    }
+}
+
+// Consume a block whose '{' was just read, nested blocks included
+static bool skip_block(struct lease_parser_t *p)
+{
+    struct lease_token_t tok;
+    uint32_t depth = 1;
+
+    for (;;)
+    {
+        switch (next_token(p, &tok))
+        {
+        case TOK_LBRACE:
+            depth++;
+            break;
+        case TOK_RBRACE:
+            if (--depth == 0)
+                return true;
+            break;
+        case TOK_EOF:
+            return false;
+        default:
+            break;
+        }
+    }
+}
+
+//=============================================================================
+// Value parsers (spans, no NUL needed)
+//=============================================================================
+
+static inline bool tok_is(const struct lease_token_t *tok, const char *word)
+{
+    size_t len = strlen(word);
+    return tok->len == len && memcmp(tok->text, word, len) == 0;
+}
+
+// Parse up to max_digits decimal digits; *pos advances past them
+static bool parse_digits(const char **pos, const char *end, uint32_t max_digits, uint64_t *value)
+{
+    const char *s = *pos;
+    uint64_t v = 0;
+    uint32_t n = 0;
+
+    while (s < end && n < max_digits && *s >= '0' && *s <= '9')
+    {
+        v = v * 10 + (uint64_t)(*s - '0');
+        s++;
+        n++;
+    }
+    if (n == 0)
+        return false;
+    *pos = s;
+    *value = v;
+    return true;
+}
+
+static bool parse_u64(const struct lease_token_t *tok, uint64_t *value)
+{
+    const char *s = tok->text;
+    const char *end = tok->text + tok->len;
+    return parse_digits(&s, end, 20, value) && s == end;
+}
+
+static bool parse_ipv4(const struct lease_token_t *tok, struct in_addr *ip)
+{
+    const char *s = tok->text;
+    const char *end = tok->text + tok->len;
+    uint32_t addr = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t octet;
+        if (!parse_digits(&s, end, 3, &octet) || octet > 255)
+            return false;
+        addr = (addr << 8) | (uint32_t)octet;
+        if (i < 3)
+        {
+            if (s >= end || *s != '.')
+                return false;
+            s++;
+        }
+    }
+    if (s != end)
+        return false;
+
+    ip->s_addr = htonl(addr);
+    return true;
+}
+
+static inline int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool parse_mac(const struct lease_token_t *tok, uint8_t mac[6])
+{
+    const char *s = tok->text;
+    const char *end = tok->text + tok->len;
+
+    for (int i = 0; i < 6; i++)
+    {
+        int value = 0, digits = 0;
+        while (s < end && digits < 2 && hex_value(*s) >= 0)
+        {
+            value = value * 16 + hex_value(*s++);
+            digits++;
+        }
+        if (digits == 0)
+            return false;
+        mac[i] = (uint8_t)value;
+        if (i < 5)
+        {
+            if (s >= end || *s != ':')
+                return false;
+            s++;
+        }
+    }
+    return s == end;
+}
+
+// "<weekday> YYYY/MM/DD HH:MM:SS" (local time, as written by format_lease_time),
+// "epoch <seconds>", or a bare number of seconds. Anything else ("never") is 0.
+static time_t parse_time(struct lease_parser_t *p, const struct lease_token_t *tok, uint32_t count)
+{
+    uint64_t value;
+
+    if (count >= 2 && tok_is(&tok[0], "epoch"))
+        return parse_u64(&tok[1], &value) ? (time_t)value : 0;
+    if (count == 1)
+        return parse_u64(&tok[0], &value) ? (time_t)value : 0;
+    if (count < 3)
+        return 0;
+
+    uint64_t year, mon, mday, hour, min, sec;
+    const char *s = tok[1].text;
+    const char *end = tok[1].text + tok[1].len;
+    if (!parse_digits(&s, end, 4, &year) || s >= end || *s++ != '/' ||
+        !parse_digits(&s, end, 2, &mon) || s >= end || *s++ != '/' ||
+        !parse_digits(&s, end, 2, &mday))
+        return 0;
+
+    s = tok[2].text;
+    end = tok[2].text + tok[2].len;
+    if (!parse_digits(&s, end, 2, &hour) || s >= end || *s++ != ':' ||
+        !parse_digits(&s, end, 2, &min) || s >= end || *s++ != ':' ||
+        !parse_digits(&s, end, 2, &sec))
+        return 0;
+
+    if ((int)year != p->cache_year || (int)mon != p->cache_mon || (int)mday != p->cache_mday ||
+        (int)hour != p->cache_hour)
+    {
+        struct tm tm_info = {0};
+        tm_info.tm_year = (int)year - 1900;
+        tm_info.tm_mon = (int)mon - 1;
+        tm_info.tm_mday = (int)mday;
+        tm_info.tm_hour = (int)hour;
+        tm_info.tm_isdst = -1; // Auto-detect DST, like parse_lease_time()
+
+        p->cache_base = mktime(&tm_info);
+        p->cache_year = (int)year;
+        p->cache_mon = (int)mon;
+        p->cache_mday = (int)mday;
+        p->cache_hour = (int)hour;
+    }
+    return p->cache_base + (time_t)(min * 60 + sec);
+}
+
+static bool parse_state(const struct lease_token_t *tok, uint8_t *state)
+{
+    for (int s = LEASE_STATE_FREE; s < LEASE_STATE_UNKNOWN; s++)
+    {
+        if (tok_is(tok, lease_state_to_string((lease_state_t)s)))
+        {
+            *state = (uint8_t)s;
+            return true;
+        }
+    }
+    *state = LEASE_STATE_UNKNOWN;
+    return true;
+}
+
+// Copy a quoted value into a NUL-terminated scratch buffer, truncating it
+static const char *copy_string(const struct lease_token_t *tok, char *buf, size_t size)
+{
+    size_t len = tok->len < size - 1 ? tok->len : size - 1;
+    memcpy(buf, tok->text, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+//=============================================================================
+// Lease blocks
+//=============================================================================
+
+static void apply_statement(struct lease_parser_t *p, const struct lease_stmt_t *st, struct dhcp_lease_t *lease,
+                            struct lease_block_strings_t *buf)
+{
+    const struct lease_token_t *key = &st->tok[0];
+    const struct lease_token_t *args = &st->tok[1];
+    uint32_t nargs = st->count - 1;
+
+    if (key->type != TOK_WORD)
+        return;
+
+    switch (key->text[0])
+    {
+    case 's':
+        if (tok_is(key, "starts"))
+            lease->start_time = parse_time(p, args, nargs);
+        else if (tok_is(key, "set") && nargs >= 2 &&
+                 (tok_is(&args[0], "lease-id") || tok_is(&args[0], "lease-id=")))
+        {
+            // set lease-id = "123";
+            uint64_t id;
+            if (parse_u64(&args[nargs - 1], &id))
+                lease->lease_id = id;
+        }
+        break;
+
+    case 'e':
+        if (tok_is(key, "ends"))
+            lease->end_time = parse_time(p, args, nargs);
+        break;
+
+    case 't':
+        if (tok_is(key, "tstp"))
+            lease->tstp = parse_time(p, args, nargs);
+        break;
+
+    case 'c':
+        if (tok_is(key, "cltt"))
+            lease->cltt = parse_time(p, args, nargs);
+        else if (tok_is(key, "client-hostname") && nargs >= 1)
+            lease->client_hostname = copy_string(&args[0], buf->hostname, sizeof(buf->hostname));
+        break;
+
+    case 'h':
+        // hardware ethernet <mac>
+        if (tok_is(key, "hardware") && nargs >= 2)
+            parse_mac(&args[1], lease->mac_address);
+        break;
+
+    case 'u':
+        if (tok_is(key, "uid") && nargs >= 1)
+        {
+            uint32_t len = 0;
+            if (parse_client_id_from_span(args[0].text, args[0].len, buf->client_id, &len) == 0 && len > 0)
+            {
+                lease->client_id = buf->client_id;
+                lease->client_id_len = (uint8_t)len;
+            }
+        }
+        break;
+
+    case 'v':
+        if (tok_is(key, "vendor-class-identifier") && nargs >= 1)
+            lease->vendor_class_identifier = copy_string(&args[0], buf->vendor_class, sizeof(buf->vendor_class));
+        break;
+
+    case 'b':
+        // binding state <state>
+        if (tok_is(key, "binding") && nargs >= 2 && tok_is(&args[0], "state"))
+            parse_state(&args[1], &lease->state);
+        break;
+
+    case 'n':
+        // next binding state <state>
+        if (tok_is(key, "next") && nargs >= 3 && tok_is(&args[0], "binding") && tok_is(&args[1], "state"))
+            parse_state(&args[2], &lease->next_binding_state);
+        break;
+
+    case 'r':
+        // rewind binding state <state>
+        if (tok_is(key, "rewind") && nargs >= 3 && tok_is(&args[0], "binding") && tok_is(&args[1], "state"))
+            parse_state(&args[2], &lease->rewind_binding_state);
+        break;
+
+    case 'a':
+        if (tok_is(key, "abandoned"))
+            lease->is_abandoned = true;
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Parse the body of "lease <ip> {" up to its closing brace
+static bool parse_lease_block(struct lease_parser_t *p, const struct lease_token_t *ip_tok, struct dhcp_lease_t *lease,
+                              struct lease_block_strings_t *buf)
+{
+    memset(lease, 0, sizeof(struct dhcp_lease_t));
+    bool ip_ok = parse_ipv4(ip_tok, &lease->ip_address);
+
+    // Default state and transitions
+    lease->state = LEASE_STATE_FREE;
+    lease->next_binding_state = LEASE_STATE_FREE;
+    lease->rewind_binding_state = LEASE_STATE_FREE;
+
+    struct lease_stmt_t st;
+    for (;;)
+    {
+        stmt_end_t end = read_statement(p, &st);
+        if (end == STMT_END_EOF)
+            return false; // Truncated block
+        if (end == STMT_END_OPEN)
+        {
+            // Nested block (e.g. "on expiry { ... }"): not part of the lease record
+            if (!skip_block(p))
+                return false;
+            continue;
+        }
+        if (st.count > 0)
+            apply_statement(p, &st, lease, buf);
+        if (end == STMT_END_CLOSE)
+            return ip_ok;
+    }
+}
+
+uint32_t lease_loader_parse(struct lease_database_t *db, const char *data, size_t size)
+{
+    if (!db || (!data && size > 0))
+        return 0;
+
+    struct lease_parser_t p;
+    memset(&p, 0, sizeof(p));
+    p.pos = data;
+    p.end = data + size;
+    p.cache_year = -1;
+
+    struct lease_block_strings_t buf;
+    struct dhcp_lease_t lease;
+    struct lease_stmt_t st;
+    uint32_t parsed = 0;
+
+    for (;;)
+    {
+        stmt_end_t end = read_statement(&p, &st);
+        if (end == STMT_END_EOF)
+            break;
+        if (end != STMT_END_OPEN)
+            continue; // Top-level statements (authoring-byte-order, server-duid, ...)
+
+        if (st.count == 2 && tok_is(&st.tok[0], "lease"))
+        {
+            if (parse_lease_block(&p, &st.tok[1], &lease, &buf))
+            {
+                lease_db_restore_lease(db, &lease);
+                parsed++;
+            }
+        }
+        else if (!skip_block(&p))
+        {
+            break;
+        }
+    }
+    return parsed;
+}
+
+//=============================================================================
+// File mapping
+//=============================================================================
+
+int lease_file_map(const char *path, struct lease_file_map_t *map)
+{
+    if (!path || !map)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    map->data = NULL;
+    map->size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+
+    if (st.st_size > 0)
+    {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        // One front-to-back pass: let the kernel read ahead aggressively
+        posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+        map->data = (const char *)data;
+        map->size = (size_t)st.st_size;
+    }
+
+    close(fd); // The mapping keeps the file referenced
+    return 0;
+}
+
+void lease_file_unmap(struct lease_file_map_t *map)
+{
+    if (!map)
+        return;
+    if (map->data)
+        munmap((void *)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/lease_strings.h"
+
+int lease_strings_init(struct lease_strings_t *strings)
+{
+    if (!strings)
+        return -1;
+
+    memset(strings, 0, sizeof(struct lease_strings_t));
+    if (lease_index_init(&strings->index, 0) != 0)
+        return -1;
+    return 0;
+}
+
+void lease_strings_free(struct lease_strings_t *strings)
+{
+    if (!strings)
+        return;
+
+    for (uint32_t i = 0; i < strings->block_count; i++)
+        free(strings->blocks[i]);
+    free(strings->blocks);
+    free(strings->entries);
+    lease_index_free(&strings->index);
+    memset(strings, 0, sizeof(struct lease_strings_t));
+}
+
+// Reserve len bytes in the arena, opening a new block when the current one is full
+static uint8_t *arena_alloc(struct lease_strings_t *strings, uint32_t len)
+{
+    if (strings->block_count == 0 || strings->block_used + len > LEASE_STRINGS_BLOCK_SIZE)
+    {
+        if (strings->block_count == strings->block_capacity)
+        {
+            uint32_t capacity = strings->block_capacity ? strings->block_capacity * 2 : 8;
+            uint8_t **blocks = realloc(strings->blocks, capacity * sizeof(uint8_t *));
+            if (!blocks)
+                return NULL;
+            strings->blocks = blocks;
+            strings->block_capacity = capacity;
+        }
+
+        uint8_t *block = malloc(LEASE_STRINGS_BLOCK_SIZE);
+        if (!block)
+            return NULL;
+        strings->blocks[strings->block_count++] = block;
+        strings->block_used = 0;
+    }
+
+    uint8_t *p = strings->blocks[strings->block_count - 1] + strings->block_used;
+    strings->block_used += len;
+    return p;
+}
+
+const uint8_t *lease_strings_intern(struct lease_strings_t *strings, const void *data, uint32_t len)
+{
+    if (!strings || (!data && len > 0) || len >= LEASE_STRINGS_BLOCK_SIZE)
+        return NULL;
+
+    uint32_t hash = lease_index_hash_bytes(data, len);
+
+    struct lease_index_iter_t it;
+    uint32_t entry;
+    lease_index_find(&strings->index, hash, &it);
+    while (lease_index_next(&strings->index, &it, &entry))
+    {
+        const struct lease_string_entry_t *e = &strings->entries[entry];
+        if (e->len == len && memcmp(e->data, data, len) == 0)
+            return e->data;
+    }
+
+    if (strings->entry_count == strings->entry_capacity)
+    {
+        uint32_t capacity = strings->entry_capacity ? strings->entry_capacity * 2 : 256;
+        struct lease_string_entry_t *entries = realloc(strings->entries, capacity * sizeof(struct lease_string_entry_t));
+        if (!entries)
+        {
+            perror("Failed to grow lease string table");
+            return NULL;
+        }
+        strings->entries = entries;
+        strings->entry_capacity = capacity;
+    }
+
+    uint8_t *copy = arena_alloc(strings, len + 1);
+    if (!copy)
+    {
+        perror("Failed to allocate lease string block");
+        return NULL;
+    }
+    memcpy(copy, data, len);
+    copy[len] = '\0';
+
+    if (lease_index_insert(&strings->index, hash, strings->entry_count) != 0)
+        return NULL; // The arena bytes are simply left unused
+
+    strings->entries[strings->entry_count].data = copy;
+    strings->entries[strings->entry_count].len = len;
+    strings->entry_count++;
+    strings->bytes_stored += len + 1;
+    return copy;
+}
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 
+#include <errno.h>
 #include <netinet/in.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -12,12 +13,13 @@
 #include <signal.h>
 #include <pthread.h>
 #include "../include/src/lease_v4.h"
+#include "../include/src/lease_loader.h"
 #include "../include/utils/string_utils.h"
 #include "../include/utils/network_utils.h"
 #include "../include/utils/time_utils.h"
 #include "../include/utils/encoding_utils.h"
 
-#define MAX_LINE_LEN 1024
+#define LEASE_TEXT_BYTES_ESTIMATE 320 // Typical size of one lease block in the text file
 
 const char *lease_state_to_string(lease_state_t state)
 {
@@ -62,6 +64,263 @@ lease_state_t lease_state_from_string(const char *str)
     return LEASE_STATE_UNKNOWN;
 }
 
+const char *lease_io_backpressure_to_string(lease_io_backpressure_t policy)
+{
+    switch (policy)
+    {
+    case LEASE_IO_BLOCK:
+        return "block";
+    case LEASE_IO_COALESCE:
+        return "coalesce";
+    case LEASE_IO_DROP:
+        return "drop";
+    default:
+        return "unknown";
+    }
+}
+
+lease_io_backpressure_t lease_io_backpressure_from_string(const char *str)
+{
+    if (!str)
+        return LEASE_IO_BACKPRESSURE_UNKNOWN;
+
+    if (strcmp(str, "block") == 0)
+        return LEASE_IO_BLOCK;
+    else if (strcmp(str, "coalesce") == 0)
+        return LEASE_IO_COALESCE;
+    else if (strcmp(str, "drop") == 0)
+        return LEASE_IO_DROP;
+    else
+        return LEASE_IO_BACKPRESSURE_UNKNOWN;
+}
+
+//=============================================================================
+// Hash Indexes
+//=============================================================================
+
+static inline uint32_t hash_ip(struct in_addr ip)
+{
+    return lease_index_hash_u64(ip.s_addr);
+}
+
+static inline uint32_t hash_mac(const uint8_t mac[6])
+{
+    // MAC as a 48-bit integer (OUI in the high bits)
+    uint64_t key = ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) | ((uint64_t)mac[2] << 24) |
+                   ((uint64_t)mac[3] << 16) | ((uint64_t)mac[4] << 8) | mac[5];
+    return lease_index_hash_u64(key);
+}
+
+static inline uint32_t hash_lease_id(uint64_t lease_id)
+{
+    return lease_index_hash_u64(lease_id);
+}
+
+static inline uint32_t hash_client_id(const uint8_t *client_id, uint32_t len)
+{
+    return lease_index_hash_bytes(client_id, len);
+}
+
+static inline struct lease_shard_t *shard_for(struct lease_database_t *db, struct in_addr ip)
+{
+    return &db->shards[lease_db_shard_of(ip)];
+}
+
+// Remove every index entry pointing at the lease in slot
+static void index_unlink(struct lease_shard_t *shard, uint32_t slot)
+{
+    const struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+
+    lease_index_remove(&shard->ip_index, hash_ip(lease->ip_address), slot);
+    lease_index_remove(&shard->mac_index, hash_mac(lease->mac_address), slot);
+    lease_index_remove(&shard->id_index, hash_lease_id(lease->lease_id), slot);
+    if (lease->client_id_len > 0)
+        lease_index_remove(&shard->client_id_index, hash_client_id(lease->client_id, lease->client_id_len), slot);
+}
+
+// Add index entries for the lease in slot; on failure nothing stays linked
+static int index_link(struct lease_shard_t *shard, uint32_t slot)
+{
+    const struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+
+    if (lease_index_insert(&shard->ip_index, hash_ip(lease->ip_address), slot) != 0)
+        return -1;
+    if (lease_index_insert(&shard->mac_index, hash_mac(lease->mac_address), slot) != 0)
+        goto undo_ip;
+    if (lease_index_insert(&shard->id_index, hash_lease_id(lease->lease_id), slot) != 0)
+        goto undo_mac;
+    if (lease->client_id_len > 0 &&
+        lease_index_insert(&shard->client_id_index, hash_client_id(lease->client_id, lease->client_id_len), slot) != 0)
+        goto undo_id;
+    return 0;
+
+undo_id:
+    lease_index_remove(&shard->id_index, hash_lease_id(lease->lease_id), slot);
+undo_mac:
+    lease_index_remove(&shard->mac_index, hash_mac(lease->mac_address), slot);
+undo_ip:
+    lease_index_remove(&shard->ip_index, hash_ip(lease->ip_address), slot);
+    return -1;
+}
+
+// Rebuild all indexes of a shard from its store (after slots were moved)
+static int index_rebuild(struct lease_shard_t *shard)
+{
+    lease_index_clear(&shard->ip_index);
+    lease_index_clear(&shard->mac_index);
+    lease_index_clear(&shard->client_id_index);
+    lease_index_clear(&shard->id_index);
+
+    for (uint32_t i = 0; i < shard->lease_count; i++)
+    {
+        if (index_link(shard, i) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Position of a stored lease, found through the IP index (UINT32_MAX if not stored)
+static uint32_t lease_slot(const struct lease_shard_t *shard, const struct dhcp_lease_t *lease)
+{
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&shard->ip_index, hash_ip(lease->ip_address), &it);
+    while (lease_index_next(&shard->ip_index, &it, &slot))
+    {
+        if (lease_shard_get(shard, slot) == lease)
+            return slot;
+    }
+    return UINT32_MAX;
+}
+
+// Make room for one more lease, allocating a new chunk when the last one is full
+static int lease_store_reserve(struct lease_shard_t *shard)
+{
+    if (shard->lease_count < shard->chunk_count * LEASE_CHUNK_SIZE)
+        return 0;
+
+    if (shard->chunk_count == shard->chunk_capacity)
+    {
+        uint32_t capacity = shard->chunk_capacity ? shard->chunk_capacity * 2 : 8;
+        struct dhcp_lease_t **chunks = realloc(shard->chunks, capacity * sizeof(struct dhcp_lease_t *));
+        if (!chunks)
+        {
+            perror("Failed to grow lease store");
+            return -1;
+        }
+        shard->chunks = chunks;
+        shard->chunk_capacity = capacity;
+    }
+
+    struct dhcp_lease_t *chunk = malloc(LEASE_CHUNK_SIZE * sizeof(struct dhcp_lease_t));
+    if (!chunk)
+    {
+        perror("Failed to allocate lease chunk");
+        return -1;
+    }
+    shard->chunks[shard->chunk_count++] = chunk;
+    return 0;
+}
+
+int lease_db_reserve(struct lease_database_t *db, uint32_t lease_count)
+{
+    if (!db)
+        return -1;
+
+    // IPs spread evenly over the shards; leave some room for the unlucky ones
+    uint32_t per_shard = lease_count / LEASE_DB_SHARDS;
+    per_shard += per_shard / 8 + 1;
+
+    uint32_t chunks = (per_shard + LEASE_CHUNK_SIZE - 1) / LEASE_CHUNK_SIZE;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct lease_shard_t *shard = &db->shards[s];
+        if (chunks > shard->chunk_capacity)
+        {
+            struct dhcp_lease_t **grown = realloc(shard->chunks, chunks * sizeof(struct dhcp_lease_t *));
+            if (!grown)
+                return -1;
+            shard->chunks = grown;
+            shard->chunk_capacity = chunks;
+        }
+
+        if (lease_index_reserve(&shard->ip_index, per_shard) != 0 ||
+            lease_index_reserve(&shard->mac_index, per_shard) != 0 ||
+            lease_index_reserve(&shard->client_id_index, per_shard) != 0 ||
+            lease_index_reserve(&shard->id_index, per_shard) != 0 ||
+            lease_expiry_reserve(&shard->expiry, per_shard) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Reschedule every ACTIVE lease of a shard, dropping the stale entries left by renewals
+static void expiry_rebuild(struct lease_shard_t *shard)
+{
+    lease_expiry_clear(&shard->expiry);
+    for (uint32_t i = 0; i < shard->lease_count; i++)
+    {
+        const struct dhcp_lease_t *lease = lease_shard_get(shard, i);
+        if (lease->state == LEASE_STATE_ACTIVE && lease_expiry_push(&shard->expiry, lease->end_time, lease->ip_address) != 0)
+        {
+            char ip_str[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &lease->ip_address, ip_str, sizeof(ip_str));
+            fprintf(stderr, "WARNING: lease %s will not expire automatically\n", ip_str);
+        }
+    }
+}
+
+// Schedule the expiry of a stored lease that is ACTIVE with a new end_time
+static void expiry_schedule(struct lease_shard_t *shard, const struct dhcp_lease_t *lease)
+{
+    if (lease->state != LEASE_STATE_ACTIVE)
+        return;
+
+    // Every renewal leaves a stale entry behind; once they outnumber the
+    // leases, rebuilding costs no more than the pushes that created them
+    if (shard->expiry.count >= 2 * shard->lease_count + LEASE_EXPIRY_MIN_CAPACITY)
+    {
+        expiry_rebuild(shard);
+        return;
+    }
+
+    if (lease_expiry_push(&shard->expiry, lease->end_time, lease->ip_address) != 0)
+    {
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &lease->ip_address, ip_str, sizeof(ip_str));
+        fprintf(stderr, "WARNING: lease %s will not expire automatically\n", ip_str);
+    }
+}
+
+// Release chunks no longer needed after the store shrank (one spare is kept)
+static void lease_store_trim(struct lease_shard_t *shard)
+{
+    uint32_t needed = (shard->lease_count + LEASE_CHUNK_SIZE - 1) / LEASE_CHUNK_SIZE + 1;
+    while (shard->chunk_count > needed)
+    {
+        free(shard->chunks[--shard->chunk_count]);
+    }
+}
+
+// Intern bytes in the string table shared by all shards
+static const uint8_t *intern_bytes(struct lease_database_t *db, const void *data, uint32_t len)
+{
+    pthread_mutex_lock(&db->strings_mutex);
+    const uint8_t *stored = lease_strings_intern(&db->strings, data, len);
+    pthread_mutex_unlock(&db->strings_mutex);
+    return stored;
+}
+
+// Intern a string for a lease field; NULL for empty or on failure
+static const char *intern_field(struct lease_database_t *db, const char *value, size_t max_len)
+{
+    if (!value || value[0] == '\0')
+        return NULL;
+
+    size_t len = strnlen(value, max_len - 1);
+    return (const char *)intern_bytes(db, value, (uint32_t)len);
+}
+
 bool lease_is_expired(const struct dhcp_lease_t *lease)
 {
     time_t now = time(NULL);
@@ -77,10 +336,36 @@ int lease_db_init(struct lease_database_t *db, const char *filename)
     strncpy(db->filename, filename, sizeof(db->filename) - 1);
     db->next_lease_id = 1; // Start at 1 (0 = "no lease")
 
-    // Initialize mutex for thread safety
-    if (pthread_mutex_init(&db->db_mutex, NULL) != 0)
+    // Storage and indexes start small and grow with the lease count
+    if (lease_strings_init(&db->strings) != 0)
+    {
+        lease_db_free(db);
+        return -1;
+    }
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct lease_shard_t *shard = &db->shards[s];
+        if (lease_index_init(&shard->ip_index, 0) != 0 ||
+            lease_index_init(&shard->mac_index, 0) != 0 ||
+            lease_index_init(&shard->client_id_index, 0) != 0 ||
+            lease_index_init(&shard->id_index, 0) != 0 ||
+            lease_expiry_init(&shard->expiry) != 0)
+        {
+            lease_db_free(db);
+            return -1;
+        }
+    }
+
+    // Initialize mutexes for thread safety
+    uint32_t initialized = 0;
+    while (initialized < LEASE_DB_SHARDS && pthread_mutex_init(&db->shards[initialized].mutex, NULL) == 0)
+        initialized++;
+    if (initialized < LEASE_DB_SHARDS || pthread_mutex_init(&db->strings_mutex, NULL) != 0)
     {
         perror("Failed to initialize lease database mutex");
+        while (initialized > 0)
+            pthread_mutex_destroy(&db->shards[--initialized].mutex);
+        lease_db_free(db);
         return -1;
     }
     db->mutex_initialized = true;
@@ -92,12 +377,30 @@ void lease_db_free(struct lease_database_t *db)
 {
     if (db)
     {
-        // Destroy mutex if it was initialized
+        // Destroy mutexes if they were initialized
         if (db->mutex_initialized)
         {
-            pthread_mutex_destroy(&db->db_mutex);
+            for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+                pthread_mutex_destroy(&db->shards[s].mutex);
+            pthread_mutex_destroy(&db->strings_mutex);
             db->mutex_initialized = false;
         }
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+        {
+            struct lease_shard_t *shard = &db->shards[s];
+            for (uint32_t i = 0; i < shard->chunk_count; i++)
+            {
+                free(shard->chunks[i]);
+            }
+            free(shard->chunks);
+            lease_index_free(&shard->ip_index);
+            lease_index_free(&shard->mac_index);
+            lease_index_free(&shard->client_id_index);
+            lease_index_free(&shard->id_index);
+            lease_expiry_free(&shard->expiry);
+        }
+        lease_strings_free(&db->strings);
+        lease_strings_free(&db->retired_strings);
         memset(db, 0, sizeof(struct lease_database_t));
     }
 }
@@ -110,211 +413,107 @@ uint64_t lease_db_generate_id(struct lease_database_t *db)
         return 0;
 
     // Use atomic fetch-and-add to ensure thread-safety
-    // This works even if called without holding the db_mutex
+    // This works even if called without holding any lock
     return __atomic_fetch_add(&db->next_lease_id, 1, __ATOMIC_SEQ_CST);
 }
 
+static struct dhcp_lease_t *shard_find_by_id(struct lease_shard_t *shard, uint64_t lease_id)
+{
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&shard->id_index, hash_lease_id(lease_id), &it);
+    while (lease_index_next(&shard->id_index, &it, &slot))
+    {
+        struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+        if (lease->lease_id == lease_id)
+        {
+            return lease;
+        }
+    }
+    return NULL;
+}
+
 // Find lease by ID (stable reference)
 struct dhcp_lease_t *lease_db_find_by_id(struct lease_database_t *db, uint64_t lease_id)
 {
     if (!db || lease_id == 0)
         return NULL;
 
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        if (db->leases[i].lease_id == lease_id)
-        {
-            return &db->leases[i];
-        }
+        struct dhcp_lease_t *lease = shard_find_by_id(&db->shards[s], lease_id);
+        if (lease)
+            return lease;
     }
     return NULL;
 }
 
-static int parse_lease_block(FILE *fp, struct dhcp_lease_t *lease, char *first_line)
+int lease_db_restore_lease(struct lease_database_t *db, const struct dhcp_lease_t *lease)
 {
-    memset(lease, 0, sizeof(struct dhcp_lease_t));
-
-    // Parse "lease x.x.x.x {"
-    char *token = strtok(first_line, " \t{");
-    if (!token || strcmp(token, "lease") != 0)
+    if (!db || !lease)
         return -1;
 
-    char *ip_str = strtok(NULL, " \t{");
-    if (!ip_str || inet_pton(AF_INET, ip_str, &lease->ip_address) != 1)
+    struct dhcp_lease_t copy = *lease;
+
+    // Generate ID if not present in file (backward compatibility)
+    if (copy.lease_id == 0)
     {
-        return -1;
+        copy.lease_id = lease_db_generate_id(db);
     }
-
-    // Default state and transitions
-    lease->state = LEASE_STATE_FREE;
-    lease->next_binding_state = LEASE_STATE_FREE;
-    lease->rewind_binding_state = LEASE_STATE_FREE;
-
-    char line[MAX_LINE_LEN];
-    while (fgets(line, sizeof(line), fp))
+    else
     {
-        char *trimmed = trim(line);
+        // Update next_lease_id to be higher than any existing
+        // Use atomic operation for thread-safety
+        uint64_t current_id = copy.lease_id;
+        uint64_t expected = __atomic_load_n(&db->next_lease_id, __ATOMIC_SEQ_CST);
 
-        // Skip empty lines and comments
-        if (strlen(trimmed) == 0 || trimmed[0] == '#')
-            continue;
-        if (trimmed[0] == '}')
+        if (current_id >= expected)
         {
-            return 0;
+            __atomic_store_n(&db->next_lease_id, current_id + 1, __ATOMIC_SEQ_CST);
         }
+    }
 
-        char *key = strtok(trimmed, " \t");
-        if (!key)
-            continue;
-
-        if (strcmp(key, "starts") == 0)
-        {
-            char *value = strtok(NULL, ";");
-            if (value)
-            {
-                lease->start_time = parse_lease_time(trim(value));
-            }
-        }
-        else if (strcmp(key, "ends") == 0)
-        {
-            char *value = strtok(NULL, ";");
-            if (value)
-            {
-                lease->end_time = parse_lease_time(trim(value));
-            }
-        }
-        else if (strcmp(key, "tstp") == 0)
-        {
-            char *value = strtok(NULL, ";");
-            if (value)
-            {
-                lease->tstp = parse_lease_time(trim(value));
-            }
-        }
-        else if (strcmp(key, "cltt") == 0)
-        {
-            char *value = strtok(NULL, ";");
-            if (value)
-            {
-                lease->cltt = parse_lease_time(trim(value));
-            }
-        }
-        else if (strcmp(key, "hardware") == 0)
-        {
-            strtok(NULL, " \t"); // Skip hardware type (e.g., "ethernet")
-            char *mac_str = strtok(NULL, ";");
-            if (mac_str)
-            {
-                parse_mac_address(trim(mac_str), lease->mac_address);
-            }
-        }
-        else if (strcmp(key, "uid") == 0)
-        {
-            char *uid_str = strtok(NULL, ";");
-            if (uid_str)
-            {
-                parse_client_id_from_string(trim(uid_str), lease->client_id, &lease->client_id_len);
-            }
-        }
-        else if (strcmp(key, "client-hostname") == 0)
-        {
-            char *hostname = strtok(NULL, ";");
-            if (hostname)
-            {
-                hostname = trim(hostname);
+    // Strings may point into a parse buffer: keep the database's own copies
+    copy.client_id = NULL;
+    copy.client_id_len = 0;
+    if (lease->client_id_len > 0)
+    {
+        copy.client_id = intern_bytes(db, lease->client_id, lease->client_id_len);
+        copy.client_id_len = copy.client_id ? lease->client_id_len : 0;
+    }
+    copy.client_hostname = intern_field(db, lease->client_hostname, MAX_CLIENT_HOSTNAME);
+    copy.vendor_class_identifier = intern_field(db, lease->vendor_class_identifier, MAX_VENDOR_CLASS_LEN);
 
-                // Remove quotes
-                hostname = remove_quotes(hostname);
-                strncpy(lease->client_hostname, hostname, MAX_CLIENT_HOSTNAME - 1);
-            }
-        }
-        else if (strcmp(key, "vendor-class-identifier") == 0)
-        {
-            char *vendor = strtok(NULL, ";");
-            if (vendor)
-            {
-                vendor = trim(vendor);
+    // Lease files are append logs: a later record for the same IP supersedes
+    // the earlier one instead of taking another slot
+    struct lease_shard_t *shard = shard_for(db, copy.ip_address);
+    uint32_t slot;
+    struct dhcp_lease_t *existing = lease_db_find_by_ip(db, copy.ip_address);
+    if (existing)
+    {
+        slot = lease_slot(shard, existing);
+        index_unlink(shard, slot);
+    }
+    else if (lease_store_reserve(shard) == 0)
+    {
+        slot = shard->lease_count;
+        __atomic_store_n(&shard->lease_count, slot + 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        return -1;
+    }
 
-                // Remove quotes
-                vendor = remove_quotes(vendor);
-                strncpy(lease->vendor_class_identifier, vendor, MAX_VENDOR_CLASS_LEN - 1);
-            }
-        }
-        else if (strcmp(key, "set") == 0)
-        {
-            // Parse "set lease-id = "123";"
-            char *var_name = strtok(NULL, " \t=");
-            if (var_name && strcmp(trim(var_name), "lease-id") == 0)
-            {
-                char *value = strtok(NULL, ";\"");
-                if (value)
-                {
-                    value = trim(value);
-                    // Remove quotes if present
-                    if (value[0] == '"')
-                        value++;
-                    lease->lease_id = (uint64_t)strtoull(value, NULL, 10);
-                }
-            }
-        }
-        else if (strcmp(key, "binding") == 0)
-        {
-            char *binding_key = strtok(NULL, " \t");
-            if (binding_key && strcmp(binding_key, "state") == 0)
-            {
-                char *state_str = strtok(NULL, ";");
-                if (state_str)
-                {
-                    state_str = trim(state_str);
-                    lease->state = lease_state_from_string(state_str);
-                    strncpy(lease->binding_state, state_str, sizeof(lease->binding_state) - 1);
-                }
-            }
-        }
-        else if (strcmp(key, "next") == 0)
-        {
-            char *next_key = strtok(NULL, " \t");
-            if (next_key && strcmp(next_key, "binding") == 0)
-            {
-                char *state_key = strtok(NULL, " \t");
-                if (state_key && strcmp(state_key, "state") == 0)
-                {
-                    char *state_str = strtok(NULL, ";");
-                    if (state_str)
-                    {
-                        lease->next_binding_state = lease_state_from_string(trim(state_str));
-                    }
-                }
-            }
-        }
-        else if (strcmp(key, "rewind") == 0)
-        {
-            char *rewind_key = strtok(NULL, " \t");
-            if (rewind_key && strcmp(rewind_key, "binding") == 0)
-            {
-                char *state_key = strtok(NULL, " \t");
-                if (state_key && strcmp(state_key, "state") == 0)
-                {
-                    char *state_str = strtok(NULL, ";");
-                    if (state_str)
-                    {
-                        lease->rewind_binding_state = lease_state_from_string(trim(state_str));
-                    }
-                }
-            }
-        }
-        else if (strcmp(key, "abandoned;") == 0 || strcmp(key, "abandoned") == 0)
-        {
-            lease->is_abandoned = true;
-        }
-        else if (strcmp(key, "set") == 0)
-        {
-            // Parse vendor-specific options like: set vendor-string = "Cisco";
-            // For now, we'll skip these
-            continue;
-        }
+    *lease_shard_get(shard, slot) = copy;
+    if (index_link(shard, slot) != 0)
+    {
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &copy.ip_address, ip_str, sizeof(ip_str));
+        fprintf(stderr, "Failed to index lease %s\n", ip_str);
+        return -1;
     }
-    return -1;
+    expiry_schedule(shard, lease_shard_get(shard, slot));
+    return 0;
 }
 
 int lease_db_load(struct lease_database_t *db)
@@ -322,59 +521,35 @@ int lease_db_load(struct lease_database_t *db)
     if (!db)
         return -1;
 
-    FILE *fp = fopen(db->filename, "r");
-    if (!fp)
+    struct lease_file_map_t map;
+    if (lease_file_map(db->filename, &map) != 0)
     {
+        if (errno != ENOENT)
+        {
+            perror("Failed to map lease file");
+            return -1;
+        }
         printf("Lease file %s not found, starting with empty database\n", db->filename);
         db->next_lease_id = 1; // Initialize
         return 0;
     }
 
-    db->lease_count = 0;
     db->next_lease_id = 1; // Will be updated
-
-    char line[MAX_LINE_LEN];
-    while (fgets(line, sizeof(line), fp))
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        char *trimmed = trim(line);
+        db->shards[s].lease_count = 0;
+        index_rebuild(&db->shards[s]);
+        lease_expiry_clear(&db->shards[s].expiry);
+    }
 
-        // Skip empty lines and comments
-        if (strlen(trimmed) == 0 || trimmed[0] == '#')
-            continue;
+    // A lease block is a few hundred bytes: size the store and indexes once
+    // instead of growing them through every doubling
+    lease_db_reserve(db, (uint32_t)(map.size / LEASE_TEXT_BYTES_ESTIMATE));
 
-        // Look for lease blocks
-        if (strncmp(trimmed, "lease", 5) == 0)
-        {
-            if (db->lease_count < MAX_LEASES)
-            {
-                if (parse_lease_block(fp, &db->leases[db->lease_count], trimmed) == 0)
-                {
-                    // Generate ID if not present in file (backward compatibility)
-                    if (db->leases[db->lease_count].lease_id == 0)
-                    {
-                        db->leases[db->lease_count].lease_id = lease_db_generate_id(db);
-                    }
-                    else
-                    {
-                        // Update next_lease_id to be higher than any existing
-                        // Use atomic operation for thread-safety
-                        uint64_t current_id = db->leases[db->lease_count].lease_id;
-                        uint64_t expected = __atomic_load_n(&db->next_lease_id, __ATOMIC_SEQ_CST);
-
-                        if (current_id >= expected)
-                        {
-                            __atomic_store_n(&db->next_lease_id, current_id + 1, __ATOMIC_SEQ_CST);
-                        }
-                    }
-
-                    db->lease_count++;
-                }
-            }
-        }
-    }
+    lease_loader_parse(db, map.data, map.size);
+    lease_file_unmap(&map);
 
-    fclose(fp);
-    printf("Loaded %u leases from %s (next ID: %lu)\n", db->lease_count, db->filename, db->next_lease_id);
+    printf("Loaded %u leases from %s (next ID: %lu)\n", lease_db_count(db), db->filename, db->next_lease_id);
     return 0;
 }
 
@@ -423,9 +598,10 @@ int lease_db_save(struct lease_database_t *db)
     fprintf(fp, "# Last updated: %s\n", ctime(&now));
 
     // Write all leases
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
     {
-        struct dhcp_lease_t *lease = &db->leases[i];
+        struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
         char ip_str[INET_ADDRSTRLEN];
         char time_buf[64];
 
@@ -487,13 +663,13 @@ int lease_db_save(struct lease_database_t *db)
         }
 
         // Write hostname if present
-        if (strlen(lease->client_hostname) > 0)
+        if (lease->client_hostname)
         {
             fprintf(fp, "\tclient-hostname \"%s\";\n", lease->client_hostname);
         }
 
         // Write vendor class identifier if present
-        if (strlen(lease->vendor_class_identifier) > 0)
+        if (lease->vendor_class_identifier)
         {
             fprintf(fp, "\tvendor-class-identifier \"%s\";\n", lease->vendor_class_identifier);
         }
@@ -583,13 +759,13 @@ int lease_db_append_lease(struct lease_database_t *db, const struct dhcp_lease_t
     }
 
     // Write hostname if present
-    if (strlen(lease->client_hostname) > 0)
+    if (lease->client_hostname)
     {
         fprintf(fp, "\tclient-hostname \"%s\";\n", lease->client_hostname);
     }
 
     // Write vendor class identifier if present
-    if (strlen(lease->vendor_class_identifier) > 0)
+    if (lease->vendor_class_identifier)
     {
         fprintf(fp, "\tvendor-class-identifier \"%s\";\n", lease->vendor_class_identifier);
     }
@@ -608,10 +784,25 @@ int lease_db_append_lease(struct lease_database_t *db, const struct dhcp_lease_t
 
 struct dhcp_lease_t *lease_db_add_lease(struct lease_database_t *db, struct in_addr ip, const uint8_t mac[6], uint32_t lease_time)
 {
-    if (!db || db->lease_count >= MAX_LEASES)
+    if (!db || !mac)
         return NULL;
 
-    struct dhcp_lease_t *lease = &db->leases[db->lease_count];
+    // One lease per IP: reuse the slot of an existing lease for this address
+    struct lease_shard_t *shard = shard_for(db, ip);
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip);
+    bool reused = (lease != NULL);
+    uint32_t reused_slot = 0;
+    if (reused)
+    {
+        reused_slot = lease_slot(shard, lease);
+        index_unlink(shard, reused_slot);
+    }
+    else
+    {
+        if (lease_store_reserve(shard) != 0)
+            return NULL;
+        lease = lease_shard_get(shard, shard->lease_count);
+    }
     memset(lease, 0, sizeof(struct dhcp_lease_t));
 
     time_t now = time(NULL);
@@ -634,14 +825,26 @@ struct dhcp_lease_t *lease_db_add_lease(struct lease_database_t *db, struct in_a
     lease->next_binding_state = LEASE_STATE_FREE;   // After expiration
     lease->rewind_binding_state = LEASE_STATE_FREE; // On failure
 
-    // Update string representation
-    strncpy(lease->binding_state, "active", sizeof(lease->binding_state) - 1);
-
     // Flags
     lease->is_abandoned = false;
     lease->is_bootp = false;
 
-    db->lease_count++;
+    uint32_t slot = reused ? reused_slot : shard->lease_count;
+    if (index_link(shard, slot) != 0)
+    {
+        // Out of memory for the index: drop the lease rather than leave it unreachable
+        if (reused)
+        {
+            *lease = *lease_shard_get(shard, shard->lease_count - 1);
+            __atomic_store_n(&shard->lease_count, shard->lease_count - 1, __ATOMIC_RELAXED);
+            index_rebuild(shard);
+        }
+        return NULL;
+    }
+
+    if (!reused)
+        __atomic_store_n(&shard->lease_count, shard->lease_count + 1, __ATOMIC_RELAXED);
+    expiry_schedule(shard, lease);
 
     // Note: I/O is not performed here to keep the function fast and avoid
     // holding locks during disk operations. Caller should use lease_db_append_lease()
@@ -655,29 +858,123 @@ struct dhcp_lease_t *lease_db_find_by_ip(struct lease_database_t *db, struct in_
     if (!db)
         return NULL;
 
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    struct lease_shard_t *shard = shard_for(db, ip);
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&shard->ip_index, hash_ip(ip), &it);
+    while (lease_index_next(&shard->ip_index, &it, &slot))
     {
-        if (db->leases[i].ip_address.s_addr == ip.s_addr)
+        struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+        if (lease->ip_address.s_addr == ip.s_addr)
         {
-            return &db->leases[i];
+            return lease;
         }
     }
     return NULL;
 }
 
+// Lease for a MAC in one shard: the ACTIVE one if any, else the lowest slot
+static struct dhcp_lease_t *shard_find_by_mac(struct lease_shard_t *shard, const uint8_t mac[6])
+{
+    uint32_t found = UINT32_MAX;
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&shard->mac_index, hash_mac(mac), &it);
+    while (lease_index_next(&shard->mac_index, &it, &slot))
+    {
+        struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+        if (memcmp(lease->mac_address, mac, 6) != 0)
+            continue;
+
+        if (lease->state == LEASE_STATE_ACTIVE)
+            return lease;
+        if (slot < found)
+            found = slot;
+    }
+    return found != UINT32_MAX ? lease_shard_get(shard, found) : NULL;
+}
+
 struct dhcp_lease_t *lease_db_find_by_mac(struct lease_database_t *db, const uint8_t mac[6])
 {
-    if (!db)
+    if (!db || !mac)
         return NULL;
 
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    // A client's leases may sit in any shard: an ACTIVE one wins, otherwise
+    // the first one found
+    struct dhcp_lease_t *first = NULL;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        if (memcmp(db->leases[i].mac_address, mac, 6) == 0)
-        {
-            return &db->leases[i];
-        }
+        struct dhcp_lease_t *lease = shard_find_by_mac(&db->shards[s], mac);
+        if (lease && lease->state == LEASE_STATE_ACTIVE)
+            return lease;
+        if (lease && !first)
+            first = lease;
     }
-    return NULL;
+    return first;
+}
+
+static struct dhcp_lease_t *shard_find_by_client_id(struct lease_shard_t *shard, const uint8_t *client_id, uint32_t len)
+{
+    uint32_t found = UINT32_MAX;
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&shard->client_id_index, hash_client_id(client_id, len), &it);
+    while (lease_index_next(&shard->client_id_index, &it, &slot))
+    {
+        struct dhcp_lease_t *lease = lease_shard_get(shard, slot);
+        if (lease->client_id_len != len || memcmp(lease->client_id, client_id, len) != 0)
+            continue;
+
+        if (lease->state == LEASE_STATE_ACTIVE)
+            return lease;
+        if (slot < found)
+            found = slot;
+    }
+    return found != UINT32_MAX ? lease_shard_get(shard, found) : NULL;
+}
+
+struct dhcp_lease_t *lease_db_find_by_client_id(struct lease_database_t *db, const uint8_t *client_id, uint32_t len)
+{
+    if (!db || !client_id || len == 0 || len > MAX_CLIENT_ID_LEN)
+        return NULL;
+
+    struct dhcp_lease_t *first = NULL;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct dhcp_lease_t *lease = shard_find_by_client_id(&db->shards[s], client_id, len);
+        if (lease && lease->state == LEASE_STATE_ACTIVE)
+            return lease;
+        if (lease && !first)
+            first = lease;
+    }
+    return first;
+}
+
+int lease_db_set_client_id(struct lease_database_t *db, struct dhcp_lease_t *lease, const uint8_t *client_id, uint32_t len)
+{
+    if (!db || !lease || (len > 0 && !client_id) || len > MAX_CLIENT_ID_LEN)
+        return -1;
+
+    struct lease_shard_t *shard = shard_for(db, lease->ip_address);
+    uint32_t slot = lease_slot(shard, lease);
+    if (slot >= shard->lease_count)
+        return -1;
+
+    if (lease->client_id_len > 0)
+        lease_index_remove(&shard->client_id_index, hash_client_id(lease->client_id, lease->client_id_len), slot);
+
+    lease->client_id = NULL;
+    lease->client_id_len = 0;
+    if (len == 0)
+        return 0;
+
+    const uint8_t *stored = intern_bytes(db, client_id, len);
+    if (!stored || lease_index_insert(&shard->client_id_index, hash_client_id(stored, len), slot) != 0)
+        return -1;
+
+    lease->client_id = stored;
+    lease->client_id_len = (uint8_t)len;
+    return 0;
 }
 
 int lease_db_release_lease(struct lease_database_t *db, struct in_addr ip)
@@ -693,9 +990,6 @@ int lease_db_release_lease(struct lease_database_t *db, struct in_addr ip)
     lease->tstp = now;     // State changed
     lease->cltt = now;     // Last transaction
 
-    // Update string representation
-    strncpy(lease->binding_state, "released", sizeof(lease->binding_state) - 1);
-
     // Note: Caller should persist changes using lease_db_save() or I/O queue
     return 0;
 }
@@ -717,9 +1011,7 @@ int lease_db_renew_lease(struct lease_database_t *db, struct in_addr ip, uint32_
     {
         lease->tstp = now;
     }
-
-    // Update string representation
-    strncpy(lease->binding_state, "active", sizeof(lease->binding_state) - 1);
+    expiry_schedule(shard_for(db, ip), lease);
 
     // Note: Caller should persist changes using lease_db_save() or I/O queue
     return 0;
@@ -727,23 +1019,41 @@ int lease_db_renew_lease(struct lease_database_t *db, struct in_addr ip, uint32_
 
 int lease_db_expire_old_leases(struct lease_database_t *db)
 {
-    if (!db)
-        return -1;
+    return lease_db_expire_due(db, time(NULL), NULL, NULL);
+}
 
+// Expire the due leases of one shard (shard locked)
+static uint32_t shard_expire_due(struct lease_database_t *db, struct lease_shard_t *shard, time_t now,
+                                 lease_expiry_fn on_expire, void *arg)
+{
     uint32_t expired_count = 0;
-    time_t now = time(NULL);
+    struct lease_expiry_entry_t due;
 
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    while (lease_expiry_pop_due(&shard->expiry, now, &due))
     {
-        struct dhcp_lease_t *lease = &db->leases[i];
-        if (lease->state == LEASE_STATE_ACTIVE && lease->end_time < now)
-        {
-            lease->state = LEASE_STATE_EXPIRED;
-            lease->tstp = now; // State changed to expired
-            strncpy(lease->binding_state, "expired", sizeof(lease->binding_state) - 1);
-            expired_count++;
-        }
+        // Stale entry: the lease was renewed, released, removed or already expired
+        struct dhcp_lease_t *lease = lease_db_find_by_ip(db, due.ip);
+        if (!lease || lease->state != LEASE_STATE_ACTIVE || lease->end_time != due.end_time)
+            continue;
+
+        lease->state = LEASE_STATE_EXPIRED;
+        lease->tstp = now; // State changed to expired
+        expired_count++;
+
+        if (on_expire)
+            on_expire(arg, lease);
     }
+    return expired_count;
+}
+
+int lease_db_expire_due(struct lease_database_t *db, time_t now, lease_expiry_fn on_expire, void *arg)
+{
+    if (!db)
+        return -1;
+
+    uint32_t expired_count = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+        expired_count += shard_expire_due(db, &db->shards[s], now, on_expire, arg);
 
     // Note: Caller should persist changes using lease_db_save() or I/O queue
     // Removed automatic save to avoid slow I/O operations during lease expiration
@@ -751,34 +1061,129 @@ int lease_db_expire_old_leases(struct lease_database_t *db)
     return expired_count;
 }
 
+time_t lease_db_next_expiry(const struct lease_database_t *db)
+{
+    if (!db)
+        return 0;
+
+    time_t next = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        time_t due = lease_expiry_next(&db->shards[s].expiry);
+        if (due != 0 && (next == 0 || due < next))
+            next = due;
+    }
+    return next;
+}
+
+// Drop the EXPIRED and RELEASED leases of one shard (shard locked)
+static uint32_t shard_cleanup_expired(struct lease_shard_t *shard)
+{
+    // Compact in one pass, preserving order
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < shard->lease_count; i++)
+    {
+        struct dhcp_lease_t *lease = lease_shard_get(shard, i);
+
+        if (lease->state == LEASE_STATE_EXPIRED || lease->state == LEASE_STATE_RELEASED)
+            continue;
+
+        if (kept != i)
+            *lease_shard_get(shard, kept) = *lease;
+        kept++;
+    }
+
+    uint32_t removed = shard->lease_count - kept;
+    __atomic_store_n(&shard->lease_count, kept, __ATOMIC_RELAXED);
+
+    // Slots moved: re-point the indexes and give back emptied chunks
+    if (removed > 0)
+    {
+        index_rebuild(shard);
+        lease_store_trim(shard);
+    }
+    return removed;
+}
+
 int lease_db_cleanup_expired(struct lease_database_t *db)
 {
     if (!db)
         return -1;
 
     uint32_t removed = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+        removed += shard_cleanup_expired(&db->shards[s]);
 
-    uint32_t i = 0;
-    while (i < db->lease_count)
+    // Note: Caller should persist changes using lease_db_save() or I/O queue
+    // Removed automatic save to avoid slow I/O operations during cleanup
+
+    return removed;
+}
+
+// Intern the strings of a lease into table and, if repoint, point the lease at them
+static int lease_intern_into(struct lease_strings_t *table, struct dhcp_lease_t *lease, bool repoint)
+{
+    const uint8_t *client_id = NULL;
+    const char *hostname = NULL, *vendor_class = NULL;
+
+    if (lease->client_id && lease->client_id_len > 0 &&
+        !(client_id = lease_strings_intern(table, lease->client_id, lease->client_id_len)))
+        return -1;
+    if (lease->client_hostname && !(hostname = lease_strings_intern_str(table, lease->client_hostname)))
+        return -1;
+    if (lease->vendor_class_identifier &&
+        !(vendor_class = lease_strings_intern_str(table, lease->vendor_class_identifier)))
+        return -1;
+
+    if (repoint)
     {
-        struct dhcp_lease_t *lease = &db->leases[i];
+        lease->client_id = client_id;
+        lease->client_hostname = hostname;
+        lease->vendor_class_identifier = vendor_class;
+    }
+    return 0;
+}
 
-        if (lease->state == LEASE_STATE_EXPIRED || lease->state == LEASE_STATE_RELEASED)
+int lease_db_compact_strings(struct lease_database_t *db)
+{
+    if (!db)
+        return -1;
+
+    lease_db_lock(db);
+    pthread_mutex_lock(&db->strings_mutex);
+
+    int result = 0;
+    if (db->strings.bytes_stored > 2 * db->strings_live_bytes + LEASE_STRINGS_BLOCK_SIZE)
+    {
+        // Fill the new table first: should it fail half way, no lease has moved yet
+        struct lease_strings_t fresh;
+        result = lease_strings_init(&fresh);
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS && result == 0; s++)
+        for (uint32_t i = 0; i < db->shards[s].lease_count && result == 0; i++)
+            result = lease_intern_into(&fresh, lease_shard_get(&db->shards[s], i), false);
+
+        if (result == 0)
         {
-            memmove(&db->leases[i], &db->leases[i + 1], (db->lease_count - i - 1) * sizeof(struct dhcp_lease_t));
-            db->lease_count--;
-            removed++;
+            // Every value is in fresh now: these lookups cannot fail
+            for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+            for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
+                lease_intern_into(&fresh, lease_shard_get(&db->shards[s], i), true);
+
+            lease_strings_free(&db->retired_strings);
+            db->retired_strings = db->strings;
+            db->strings = fresh;
+            db->strings_live_bytes = fresh.bytes_stored;
+            result = 1;
         }
         else
         {
-            i++;
+            lease_strings_free(&fresh);
         }
     }
 
-    // Note: Caller should persist changes using lease_db_save() or I/O queue
-    // Removed automatic save to avoid slow I/O operations during cleanup
-
-    return removed;
+    pthread_mutex_unlock(&db->strings_mutex);
+    lease_db_unlock(db);
+    return result;
 }
 
 void lease_db_print(const struct lease_database_t *db)
@@ -788,15 +1193,17 @@ void lease_db_print(const struct lease_database_t *db)
 
     printf("--- Lease Database ---\n");
     printf("File: %s\n", db->filename);
-    printf("Total Leases: %u\n\n", db->lease_count);
+    printf("Total Leases: %u\n\n", lease_db_count(db));
 
-    for (uint32_t i = 0; i < db->lease_count; i++)
+    uint32_t number = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
     {
-        const struct dhcp_lease_t *lease = &db->leases[i];
+        const struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
         char ip_str[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &lease->ip_address, ip_str, INET_ADDRSTRLEN);
 
-        printf("Lease %u:\n", i + 1);
+        printf("Lease %u:\n", ++number);
         printf("  IP: %s\n", ip_str);
         printf("  MAC: %02x:%02x:%02x:%02x:%02x:%02x\n",
                lease->mac_address[0], lease->mac_address[1], lease->mac_address[2],
@@ -805,7 +1212,7 @@ void lease_db_print(const struct lease_database_t *db)
         printf("  Start: %s", ctime(&lease->start_time));
         printf("  End: %s", ctime(&lease->end_time));
 
-        if (strlen(lease->client_hostname) > 0)
+        if (lease->client_hostname)
         {
             printf("  Hostname: %s\n", lease->client_hostname);
         }
@@ -820,7 +1227,7 @@ void lease_db_print(const struct lease_database_t *db)
             printf("\n");
         }
 
-        if (strlen(lease->vendor_class_identifier) > 0)
+        if (lease->vendor_class_identifier)
         {
             printf("  Vendor: %s\n", lease->vendor_class_identifier);
         }
@@ -838,23 +1245,29 @@ void lease_db_print(const struct lease_database_t *db)
 // Helper Functions for Extended Lease Information
 //=============================================================================
 
-int lease_set_client_id(struct dhcp_lease_t *lease, const uint8_t *client_id, uint32_t len)
+int lease_db_set_vendor_class(struct lease_database_t *db, struct dhcp_lease_t *lease, const char *vendor_class)
 {
-    if (!lease || !client_id || len > MAX_CLIENT_ID_LEN)
+    if (!db || !lease)
         return -1;
 
-    memcpy(lease->client_id, client_id, len);
-    lease->client_id_len = len;
+    const char *stored = intern_field(db, vendor_class, MAX_VENDOR_CLASS_LEN);
+    if (!stored && vendor_class && vendor_class[0] != '\0')
+        return -1;
+
+    lease->vendor_class_identifier = stored;
     return 0;
 }
 
-int lease_set_vendor_class(struct dhcp_lease_t *lease, const char *vendor_class)
+int lease_db_set_hostname(struct lease_database_t *db, struct dhcp_lease_t *lease, const char *hostname)
 {
-    if (!lease || !vendor_class)
+    if (!db || !lease)
         return -1;
 
-    strncpy(lease->vendor_class_identifier, vendor_class, MAX_VENDOR_CLASS_LEN - 1);
-    lease->vendor_class_identifier[MAX_VENDOR_CLASS_LEN - 1] = '\0';
+    const char *stored = intern_field(db, hostname, MAX_CLIENT_HOSTNAME);
+    if (!stored && hostname && hostname[0] != '\0')
+        return -1;
+
+    lease->client_hostname = stored;
     return 0;
 }
 
@@ -879,10 +1292,6 @@ void lease_set_state_transition(struct dhcp_lease_t *lease, lease_state_t curren
     lease->next_binding_state = next;
     lease->rewind_binding_state = rewind;
     lease->tstp = now; // State changed now
-
-    // Update string representation for file format compatibility
-    strncpy(lease->binding_state, lease_state_to_string(current), sizeof(lease->binding_state) - 1);
-    lease->binding_state[sizeof(lease->binding_state) - 1] = '\0';
 }
 
 //=============================================================================
@@ -893,7 +1302,8 @@ void lease_db_lock(struct lease_database_t *db)
 {
     if (db && db->mutex_initialized)
     {
-        pthread_mutex_lock(&db->db_mutex);
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+            pthread_mutex_lock(&db->shards[s].mutex);
     }
 }
 
@@ -901,16 +1311,72 @@ void lease_db_unlock(struct lease_database_t *db)
 {
     if (db && db->mutex_initialized)
     {
-        pthread_mutex_unlock(&db->db_mutex);
+        for (uint32_t s = LEASE_DB_SHARDS; s-- > 0;)
+            pthread_mutex_unlock(&db->shards[s].mutex);
+    }
+}
+
+void lease_db_lock_ip(struct lease_database_t *db, struct in_addr ip)
+{
+    if (db && db->mutex_initialized)
+    {
+        pthread_mutex_lock(&shard_for(db, ip)->mutex);
+    }
+}
+
+void lease_db_unlock_ip(struct lease_database_t *db, struct in_addr ip)
+{
+    if (db && db->mutex_initialized)
+    {
+        pthread_mutex_unlock(&shard_for(db, ip)->mutex);
+    }
+}
+
+void lease_db_lock_shard(struct lease_database_t *db, uint32_t shard)
+{
+    if (db && db->mutex_initialized && shard < LEASE_DB_SHARDS)
+    {
+        pthread_mutex_lock(&db->shards[shard].mutex);
+    }
+}
+
+void lease_db_unlock_shard(struct lease_database_t *db, uint32_t shard)
+{
+    if (db && db->mutex_initialized && shard < LEASE_DB_SHARDS)
+    {
+        pthread_mutex_unlock(&db->shards[shard].mutex);
     }
 }
 
+uint32_t lease_db_count(const struct lease_database_t *db)
+{
+    if (!db)
+        return 0;
+
+    uint32_t count = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+        count += __atomic_load_n(&db->shards[s].lease_count, __ATOMIC_RELAXED);
+    return count;
+}
+
+static void shard_lock(const struct lease_database_t *db, struct lease_shard_t *shard)
+{
+    if (db->mutex_initialized)
+        pthread_mutex_lock(&shard->mutex);
+}
+
+static void shard_unlock(const struct lease_database_t *db, struct lease_shard_t *shard)
+{
+    if (db->mutex_initialized)
+        pthread_mutex_unlock(&shard->mutex);
+}
+
 uint64_t lease_db_add_lease_safe(struct lease_database_t *db, struct in_addr ip, const uint8_t mac[6], uint32_t lease_time, struct dhcp_lease_t *out_lease)
 {
     if (!db)
         return 0;
 
-    lease_db_lock(db);
+    lease_db_lock_ip(db, ip);
     struct dhcp_lease_t *result = lease_db_add_lease(db, ip, mac, lease_time);
     uint64_t lease_id = 0;
 
@@ -924,7 +1390,7 @@ uint64_t lease_db_add_lease_safe(struct lease_database_t *db, struct in_addr ip,
         }
     }
 
-    lease_db_unlock(db);
+    lease_db_unlock_ip(db, ip);
 
     return lease_id;
 }
@@ -934,20 +1400,17 @@ int lease_db_find_by_ip_safe(struct lease_database_t *db, struct in_addr ip, str
     if (!db || !out_lease)
         return -1;
 
-    lease_db_lock(db);
+    lease_db_lock_ip(db, ip);
 
     int result = -1;
-    for (uint32_t i = 0; i < db->lease_count; i++)
-    {
-        if (db->leases[i].ip_address.s_addr == ip.s_addr)
-        {
-            memcpy(out_lease, &db->leases[i], sizeof(struct dhcp_lease_t));
-            result = 0;
-            break;
-        }
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip);
+    if (lease)
+    {
+        memcpy(out_lease, lease, sizeof(struct dhcp_lease_t));
+        result = 0;
     }
 
-    lease_db_unlock(db);
+    lease_db_unlock_ip(db, ip);
     return result;
 }
 
@@ -956,36 +1419,45 @@ int lease_db_find_by_mac_safe(struct lease_database_t *db, const uint8_t mac[6],
     if (!db || !mac || !out_lease)
         return -1;
 
-    lease_db_lock(db);
-
-    struct dhcp_lease_t *lease = lease_db_find_by_mac(db, mac);
-    if (lease)
+    // Same preference as lease_db_find_by_mac(), one shard locked at a time
+    int result = -1;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        memcpy(out_lease, lease, sizeof(struct dhcp_lease_t));
-        lease_db_unlock(db);
-        return 0;
-    }
+        struct lease_shard_t *shard = &db->shards[s];
+        shard_lock(db, shard);
+        struct dhcp_lease_t *lease = shard_find_by_mac(shard, mac);
+        bool active = lease && lease->state == LEASE_STATE_ACTIVE;
+        if (lease && (active || result != 0))
+        {
+            memcpy(out_lease, lease, sizeof(struct dhcp_lease_t));
+            result = 0;
+        }
+        shard_unlock(db, shard);
 
-    lease_db_unlock(db);
-    return -1;
+        if (active)
+            break;
+    }
+    return result;
 }
 
 int lease_db_find_by_id_safe(struct lease_database_t *db, uint64_t lease_id, struct dhcp_lease_t *out_lease)
 {
-    if (!db || !out_lease)
+    if (!db || !out_lease || lease_id == 0)
         return -1;
 
-    lease_db_lock(db);
-
-    struct dhcp_lease_t *lease = lease_db_find_by_id(db, lease_id);
-    if (lease)
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
     {
-        memcpy(out_lease, lease, sizeof(struct dhcp_lease_t));
-        lease_db_unlock(db);
-        return 0;
+        struct lease_shard_t *shard = &db->shards[s];
+        shard_lock(db, shard);
+        struct dhcp_lease_t *lease = shard_find_by_id(shard, lease_id);
+        if (lease)
+        {
+            memcpy(out_lease, lease, sizeof(struct dhcp_lease_t));
+            shard_unlock(db, shard);
+            return 0;
+        }
+        shard_unlock(db, shard);
     }
-
-    lease_db_unlock(db);
     return -1;
 }
 
@@ -994,9 +1466,9 @@ int lease_db_release_lease_safe(struct lease_database_t *db, struct in_addr ip)
     if (!db)
         return -1;
 
-    lease_db_lock(db);
+    lease_db_lock_ip(db, ip);
     int result = lease_db_release_lease(db, ip);
-    lease_db_unlock(db);
+    lease_db_unlock_ip(db, ip);
 
     return result;
 }
@@ -1006,23 +1478,50 @@ int lease_db_renew_lease_safe(struct lease_database_t *db, struct in_addr ip, ui
     if (!db)
         return -1;
 
-    lease_db_lock(db);
+    lease_db_lock_ip(db, ip);
     int result = lease_db_renew_lease(db, ip, lease_time);
-    lease_db_unlock(db);
+    lease_db_unlock_ip(db, ip);
 
     return result;
 }
 
 int lease_db_expire_old_leases_safe(struct lease_database_t *db)
+{
+    return lease_db_expire_due_safe(db, time(NULL), NULL, NULL);
+}
+
+int lease_db_expire_due_safe(struct lease_database_t *db, time_t now, lease_expiry_fn on_expire, void *arg)
 {
     if (!db)
         return -1;
 
-    lease_db_lock(db);
-    int result = lease_db_expire_old_leases(db);
-    lease_db_unlock(db);
+    uint32_t expired_count = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct lease_shard_t *shard = &db->shards[s];
+        shard_lock(db, shard);
+        expired_count += shard_expire_due(db, shard, now, on_expire, arg);
+        shard_unlock(db, shard);
+    }
+    return expired_count;
+}
 
-    return result;
+time_t lease_db_next_expiry_safe(struct lease_database_t *db)
+{
+    if (!db)
+        return 0;
+
+    time_t next = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct lease_shard_t *shard = &db->shards[s];
+        shard_lock(db, shard);
+        time_t due = lease_expiry_next(&shard->expiry);
+        shard_unlock(db, shard);
+        if (due != 0 && (next == 0 || due < next))
+            next = due;
+    }
+    return next;
 }
 
 int lease_db_cleanup_expired_safe(struct lease_database_t *db)
@@ -1030,11 +1529,15 @@ int lease_db_cleanup_expired_safe(struct lease_database_t *db)
     if (!db)
         return -1;
 
-    lease_db_lock(db);
-    int result = lease_db_cleanup_expired(db);
-    lease_db_unlock(db);
-
-    return result;
+    uint32_t removed = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        struct lease_shard_t *shard = &db->shards[s];
+        shard_lock(db, shard);
+        removed += shard_cleanup_expired(shard);
+        shard_unlock(db, shard);
+    }
+    return removed;
 }
 
 int lease_db_save_safe(struct lease_database_t *db)
@@ -1087,6 +1590,15 @@ int lease_timer_init(struct lease_timer_t *timer, struct lease_database_t *db, u
     return 0;
 }
 
+void lease_timer_set_expiry_callback(struct lease_timer_t *timer, lease_expiry_fn on_expire, void *arg)
+{
+    if (!timer)
+        return;
+
+    timer->on_expire = on_expire;
+    timer->on_expire_arg = arg;
+}
+
 int lease_timer_start(struct lease_timer_t *timer)
 {
     if (!timer || !timer->mutex_initialized)
@@ -1177,14 +1689,23 @@ static void *lease_timer_thread_func(void *arg)
 
     while (1)
     {
-        // Calculate absolute time for timed wait
+        // Sleep until the earliest lease is due (a lease ending at T expires
+        // once T has passed), but never longer than the check interval
+        time_t next_expiry = lease_db_next_expiry_safe(timer->db);
+
         struct timespec ts;
         clock_gettime(CLOCK_REALTIME, &ts);
         ts.tv_sec += timer->check_interval_sec;
+        if (next_expiry != 0 && next_expiry + 1 < ts.tv_sec)
+        {
+            ts.tv_sec = next_expiry + 1;
+            ts.tv_nsec = 0;
+        }
 
         // Wait with timeout (can be woken up early)
         pthread_mutex_lock(&timer->timer_mutex);
-        pthread_cond_timedwait(&timer->timer_cond, &timer->timer_mutex, &ts);
+        if (timer->running)
+            pthread_cond_timedwait(&timer->timer_cond, &timer->timer_mutex, &ts);
 
         // Check if we should stop
         bool should_run = timer->running;
@@ -1195,11 +1716,13 @@ static void *lease_timer_thread_func(void *arg)
             break; // Exit loop
         }
 
-        // Perform lease expiration check (thread-safe)
-        int expired = lease_db_expire_old_leases_safe(timer->db);
+        // Expire what is due and report each lease to the registered sink,
+        // one shard at a time
+        int expired = lease_db_expire_due_safe(timer->db, time(NULL), timer->on_expire, timer->on_expire_arg);
 
         if (expired > 0)
         {
+            timer->expired_total += (uint64_t)expired;
             printf("[Timer] Auto-expired %d leases\n", expired);
 
             // Optional: Save to disk after expiration
@@ -1218,7 +1741,31 @@ static void *lease_timer_thread_func(void *arg)
 // Forward declaration of I/O thread function
 static void *lease_io_thread_func(void *arg);
 
-int lease_io_init(struct lease_io_queue_t *io_queue, struct lease_database_t *db)
+static uint64_t io_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void io_stat_add(volatile uint64_t *counter, uint64_t n)
+{
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+static void lease_io_release(struct lease_io_queue_t *io_queue)
+{
+    free(io_queue->slots);
+    free(io_queue->batch);
+    free(io_queue->overflow);
+    lease_index_free(&io_queue->overflow_index);
+    io_queue->slots = NULL;
+    io_queue->batch = NULL;
+    io_queue->overflow = NULL;
+}
+
+int lease_io_init(struct lease_io_queue_t *io_queue, struct lease_database_t *db,
+                  const struct lease_io_config_t *config)
 {
     if (!io_queue || !db)
         return -1;
@@ -1227,29 +1774,64 @@ int lease_io_init(struct lease_io_queue_t *io_queue, struct lease_database_t *db
 
     io_queue->db = db;
     io_queue->running = false;
-    io_queue->head = 0;
-    io_queue->tail = 0;
-    io_queue->count = 0;
-    io_queue->operations_processed = 0;
-    io_queue->operations_dropped = 0;
 
-    // Initialize mutex and condition variable
-    if (pthread_mutex_init(&io_queue->queue_mutex, NULL) != 0)
-    {
-        perror("Failed to initialize I/O queue mutex");
+    uint32_t wanted = (config && config->queue_size) ? config->queue_size : LEASE_IO_DEFAULT_QUEUE_SIZE;
+    if (wanted > LEASE_IO_MAX_QUEUE_SIZE)
+        wanted = LEASE_IO_MAX_QUEUE_SIZE;
+    uint32_t capacity = 2;
+    while (capacity < wanted)
+        capacity <<= 1;
+
+    io_queue->capacity = capacity;
+    io_queue->backpressure = (config && config->backpressure < LEASE_IO_BACKPRESSURE_UNKNOWN) ? config->backpressure
+                                                                                            : LEASE_IO_COALESCE;
+    io_queue->stats = (config && config->stats) ? config->stats : &io_queue->local_stats;
+    io_queue->overflow_min_stamp = UINT64_MAX;
+
+    // One batch holds a full ring plus everything set aside by the coalesce policy
+    io_queue->slots = calloc(capacity, sizeof(struct lease_io_slot_t));
+    io_queue->batch = malloc((size_t)capacity * 2 * sizeof(struct lease_delta_t));
+    if (!io_queue->slots || !io_queue->batch)
+    {
+        perror("Failed to allocate I/O queue");
+        lease_io_release(io_queue);
         return -1;
     }
+    if (io_queue->backpressure == LEASE_IO_COALESCE)
+    {
+        io_queue->overflow = malloc((size_t)capacity * sizeof(struct lease_io_overflow_t));
+        if (!io_queue->overflow || lease_index_init(&io_queue->overflow_index, capacity) != 0)
+        {
+            perror("Failed to allocate I/O queue overflow");
+            lease_io_release(io_queue);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < capacity; i++)
+        io_queue->slots[i].seq = i;
 
-    if (pthread_cond_init(&io_queue->queue_cond, NULL) != 0)
+    // Initialize mutexes and condition variables (only used to park threads)
+    if (pthread_mutex_init(&io_queue->wait_mutex, NULL) != 0 ||
+        pthread_mutex_init(&io_queue->overflow_mutex, NULL) != 0 ||
+        pthread_cond_init(&io_queue->data_cond, NULL) != 0 ||
+        pthread_cond_init(&io_queue->space_cond, NULL) != 0)
     {
-        perror("Failed to initialize I/O queue condition variable");
-        pthread_mutex_destroy(&io_queue->queue_mutex);
+        perror("Failed to initialize I/O queue synchronization");
+        lease_io_release(io_queue);
         return -1;
     }
 
     io_queue->mutex_initialized = true;
 
-    printf("I/O queue initialized (buffer size: %d)\n", IO_QUEUE_SIZE);
+    io_queue->stats->capacity = capacity;
+    io_queue->stats->backpressure = io_queue->backpressure;
+
+    // Without a journal the I/O thread falls back to appending to the text file
+    io_queue->journal_open = (lease_journal_open(&io_queue->journal, db->filename) == 0);
+
+    printf("I/O queue initialized (ring: %u slots, backpressure: %s, journal: %s)\n", capacity,
+           lease_io_backpressure_to_string(io_queue->backpressure),
+           io_queue->journal_open ? io_queue->journal.journal_path : "disabled");
     return 0;
 }
 
@@ -1258,25 +1840,25 @@ int lease_io_start(struct lease_io_queue_t *io_queue)
     if (!io_queue || !io_queue->mutex_initialized)
         return -1;
 
-    pthread_mutex_lock(&io_queue->queue_mutex);
+    pthread_mutex_lock(&io_queue->wait_mutex);
 
     // Check if already running
     if (io_queue->running)
     {
-        pthread_mutex_unlock(&io_queue->queue_mutex);
+        pthread_mutex_unlock(&io_queue->wait_mutex);
         return -1; // Already running
     }
 
-    io_queue->running = true;
-    pthread_mutex_unlock(&io_queue->queue_mutex);
+    __atomic_store_n(&io_queue->running, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&io_queue->wait_mutex);
 
     // Create the I/O thread
     if (pthread_create(&io_queue->io_thread, NULL, lease_io_thread_func, io_queue) != 0)
     {
         perror("Failed to create I/O thread");
-        pthread_mutex_lock(&io_queue->queue_mutex);
-        io_queue->running = false;
-        pthread_mutex_unlock(&io_queue->queue_mutex);
+        pthread_mutex_lock(&io_queue->wait_mutex);
+        __atomic_store_n(&io_queue->running, false, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&io_queue->wait_mutex);
         return -1;
     }
 
@@ -1289,102 +1871,222 @@ void lease_io_stop(struct lease_io_queue_t *io_queue)
     if (!io_queue || !io_queue->mutex_initialized)
         return;
 
-    // Queue a shutdown operation
-    struct io_operation_t shutdown_op;
-    shutdown_op.type = IO_OP_SHUTDOWN;
-    shutdown_op.timestamp = time(NULL);
+    pthread_mutex_lock(&io_queue->wait_mutex);
+    bool was_running = io_queue->running;
+    if (was_running)
+    {
+        // The thread drains the ring, writes a snapshot and exits
+        __atomic_store_n(&io_queue->stop_requested, true, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&io_queue->data_cond);
+    }
+    pthread_mutex_unlock(&io_queue->wait_mutex);
+
+    // Wait for thread to terminate
+    if (was_running)
+        pthread_join(io_queue->io_thread, NULL);
 
-    pthread_mutex_lock(&io_queue->queue_mutex);
+    // Clean up synchronization primitives
+    pthread_mutex_destroy(&io_queue->wait_mutex);
+    pthread_mutex_destroy(&io_queue->overflow_mutex);
+    pthread_cond_destroy(&io_queue->data_cond);
+    pthread_cond_destroy(&io_queue->space_cond);
+    io_queue->mutex_initialized = false;
 
-    if (!io_queue->running)
+    if (io_queue->journal_open)
     {
-        pthread_mutex_unlock(&io_queue->queue_mutex);
-        return; // Already stopped
+        lease_journal_close(&io_queue->journal);
+        io_queue->journal_open = false;
+    }
+
+    printf("I/O thread stopped (committed: %lu, coalesced: %lu, dropped: %lu, blocked: %lu)\n",
+           io_queue->stats->committed, io_queue->stats->coalesced, io_queue->stats->dropped,
+           io_queue->stats->blocked);
+
+    // Detach from shared memory that may outlive the queue
+    io_queue->stats = &io_queue->local_stats;
+    lease_io_release(io_queue);
+}
+
+//-----------------------------------------------------------------------------
+// Producer side
+//-----------------------------------------------------------------------------
+
+// Claim a ring position and publish the delta. Returns false when the ring is full.
+static bool io_ring_push(struct lease_io_queue_t *io_queue, const struct dhcp_lease_t *lease, uint64_t now)
+{
+    uint64_t mask = io_queue->capacity - 1;
+    uint64_t pos = __atomic_load_n(&io_queue->tail, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        struct lease_io_slot_t *slot = &io_queue->slots[pos & mask];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            // Free for this position: claim it (a failed CAS reloads pos)
+            if (__atomic_compare_exchange_n(&io_queue->tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                slot->delta.enqueue_ns = now;
+                slot->delta.lease = *lease;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // Still holds the delta from one lap ago: full
+        }
+        else
+        {
+            pos = __atomic_load_n(&io_queue->tail, __ATOMIC_RELAXED); // Another producer got there first
+        }
     }
+}
 
-    // Add shutdown operation to queue
-    if (io_queue->count < IO_QUEUE_SIZE)
+static bool io_ring_full(struct lease_io_queue_t *io_queue)
+{
+    uint64_t pos = __atomic_load_n(&io_queue->tail, __ATOMIC_RELAXED);
+    uint64_t seq = __atomic_load_n(&io_queue->slots[pos & (io_queue->capacity - 1)].seq, __ATOMIC_ACQUIRE);
+    return (int64_t)(seq - pos) < 0;
+}
+
+// Wake the I/O thread if it is parked. The fence pairs with the one in
+// io_wait_for_work(): either it sees our delta or we see it sleeping.
+static void io_wake_consumer(struct lease_io_queue_t *io_queue)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&io_queue->consumer_sleeping, __ATOMIC_RELAXED))
     {
-        io_queue->queue[io_queue->tail] = shutdown_op;
-        io_queue->tail = (io_queue->tail + 1) % IO_QUEUE_SIZE;
-        io_queue->count++;
+        pthread_mutex_lock(&io_queue->wait_mutex);
+        pthread_cond_signal(&io_queue->data_cond);
+        pthread_mutex_unlock(&io_queue->wait_mutex);
     }
+}
 
-    pthread_cond_signal(&io_queue->queue_cond); // Wake up thread
-    pthread_mutex_unlock(&io_queue->queue_mutex);
+// Block policy: park until the I/O thread frees a slot. False once it has stopped.
+static bool io_wait_for_space(struct lease_io_queue_t *io_queue)
+{
+    io_stat_add(&io_queue->stats->blocked, 1);
 
-    // Wait for thread to terminate
-    pthread_join(io_queue->io_thread, NULL);
+    pthread_mutex_lock(&io_queue->wait_mutex);
+    __atomic_add_fetch(&io_queue->producers_waiting, 1, __ATOMIC_SEQ_CST);
 
-    // Clean up synchronization primitives
-    pthread_mutex_destroy(&io_queue->queue_mutex);
-    pthread_cond_destroy(&io_queue->queue_cond);
-    io_queue->mutex_initialized = false;
+    bool running = __atomic_load_n(&io_queue->running, __ATOMIC_ACQUIRE);
+    if (running && io_ring_full(io_queue))
+        pthread_cond_wait(&io_queue->space_cond, &io_queue->wait_mutex);
 
-    printf("I/O thread stopped (processed: %lu, dropped: %lu)\n",
-           io_queue->operations_processed, io_queue->operations_dropped);
+    __atomic_sub_fetch(&io_queue->producers_waiting, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&io_queue->wait_mutex);
+    return running;
 }
 
-int lease_io_queue_save_lease(struct lease_io_queue_t *io_queue, const struct dhcp_lease_t *lease)
+// Coalesce policy: keep the delta aside, replacing a pending one for the same IP.
+// Returns -1 when the table already holds as many IPs as the ring has slots.
+static int io_overflow_put(struct lease_io_queue_t *io_queue, const struct dhcp_lease_t *lease, uint64_t now)
 {
-    if (!io_queue || !lease || !io_queue->mutex_initialized)
-        return -1;
+    uint32_t hash = hash_ip(lease->ip_address);
+    struct lease_io_overflow_t *entry = NULL;
 
-    pthread_mutex_lock(&io_queue->queue_mutex);
+    pthread_mutex_lock(&io_queue->overflow_mutex);
 
-    // Check if queue is full
-    if (io_queue->count >= IO_QUEUE_SIZE)
+    // Every delta that claimed a ring position before now is older than this one
+    uint64_t stamp = __atomic_load_n(&io_queue->tail, __ATOMIC_ACQUIRE);
+
+    struct lease_index_iter_t it;
+    uint32_t ref;
+    lease_index_find(&io_queue->overflow_index, hash, &it);
+    while (lease_index_next(&io_queue->overflow_index, &it, &ref))
     {
-        io_queue->operations_dropped++;
-        pthread_mutex_unlock(&io_queue->queue_mutex);
-        fprintf(stderr, "[I/O Queue] Queue full, operation dropped\n");
-        return -1;
+        if (io_queue->overflow[ref].delta.lease.ip_address.s_addr == lease->ip_address.s_addr)
+        {
+            entry = &io_queue->overflow[ref];
+            break;
+        }
     }
 
-    // Add operation to queue
-    struct io_operation_t op;
-    op.type = IO_OP_SAVE_LEASE;
-    op.lease = *lease; // Copy lease data
-    op.timestamp = time(NULL);
-
-    io_queue->queue[io_queue->tail] = op;
-    io_queue->tail = (io_queue->tail + 1) % IO_QUEUE_SIZE;
-    io_queue->count++;
+    if (entry)
+    {
+        io_stat_add(&io_queue->stats->coalesced, 1);
+    }
+    else if (io_queue->overflow_count < io_queue->capacity &&
+             lease_index_insert(&io_queue->overflow_index, hash, io_queue->overflow_count) == 0)
+    {
+        entry = &io_queue->overflow[io_queue->overflow_count];
+        __atomic_store_n(&io_queue->overflow_count, io_queue->overflow_count + 1, __ATOMIC_RELEASE);
+        io_stat_add(&io_queue->stats->enqueued, 1);
+    }
+    else
+    {
+        pthread_mutex_unlock(&io_queue->overflow_mutex);
+        return -1; // Set-aside table full
+    }
 
-    pthread_cond_signal(&io_queue->queue_cond); // Wake up I/O thread
-    pthread_mutex_unlock(&io_queue->queue_mutex);
+    entry->stamp = stamp;
+    entry->delta.enqueue_ns = now;
+    entry->delta.lease = *lease;
+    if (stamp < io_queue->overflow_min_stamp)
+        __atomic_store_n(&io_queue->overflow_min_stamp, stamp, __ATOMIC_RELEASE);
 
+    pthread_mutex_unlock(&io_queue->overflow_mutex);
+    io_wake_consumer(io_queue);
     return 0;
 }
 
-int lease_io_queue_save_all(struct lease_io_queue_t *io_queue)
+int lease_io_queue_save_lease(struct lease_io_queue_t *io_queue, const struct dhcp_lease_t *lease)
 {
-    if (!io_queue || !io_queue->mutex_initialized)
+    if (!io_queue || !lease || !io_queue->mutex_initialized)
         return -1;
 
-    pthread_mutex_lock(&io_queue->queue_mutex);
-
-    // Check if queue is full
-    if (io_queue->count >= IO_QUEUE_SIZE)
+    uint64_t now = io_now_ns();
+    for (;;)
     {
-        io_queue->operations_dropped++;
-        pthread_mutex_unlock(&io_queue->queue_mutex);
-        fprintf(stderr, "[I/O Queue] Queue full, save all operation dropped\n");
-        return -1;
-    }
+        if (io_ring_push(io_queue, lease, now))
+        {
+            io_stat_add(&io_queue->stats->enqueued, 1);
+            io_wake_consumer(io_queue);
+            return 0;
+        }
+
+        switch (io_queue->backpressure)
+        {
+        case LEASE_IO_COALESCE:
+            if (io_overflow_put(io_queue, lease, now) == 0)
+                return 0;
+            // As many distinct IPs set aside as the ring holds: wait like the block policy
+            if (io_wait_for_space(io_queue))
+                continue;
+            io_stat_add(&io_queue->stats->dropped, 1);
+            break;
+
+        case LEASE_IO_BLOCK:
+            if (io_wait_for_space(io_queue))
+                continue;
+            io_stat_add(&io_queue->stats->dropped, 1);
+            break;
 
-    // Add operation to queue
-    struct io_operation_t op;
-    op.type = IO_OP_SAVE_ALL;
-    op.timestamp = time(NULL);
+        default:
+            io_stat_add(&io_queue->stats->dropped, 1);
+            break;
+        }
 
-    io_queue->queue[io_queue->tail] = op;
-    io_queue->tail = (io_queue->tail + 1) % IO_QUEUE_SIZE;
-    io_queue->count++;
+        // Report at 1, 2, 4, 8... drops: a saturated disk must not also flood stderr
+        uint64_t dropped = __atomic_load_n(&io_queue->stats->dropped, __ATOMIC_RELAXED);
+        if ((dropped & (dropped - 1)) == 0)
+            fprintf(stderr, "[I/O Queue] Queue full, %lu lease updates dropped so far\n", dropped);
+        return -1;
+    }
+}
 
-    pthread_cond_signal(&io_queue->queue_cond); // Wake up I/O thread
-    pthread_mutex_unlock(&io_queue->queue_mutex);
+int lease_io_queue_save_all(struct lease_io_queue_t *io_queue)
+{
+    if (!io_queue || !io_queue->mutex_initialized)
+        return -1;
 
+    __atomic_store_n(&io_queue->save_all_requested, true, __ATOMIC_RELEASE);
+    io_wake_consumer(io_queue);
     return 0;
 }
 
@@ -1393,16 +2095,16 @@ void lease_io_get_stats(struct lease_io_queue_t *io_queue, uint64_t *processed,
     if (!io_queue || !io_queue->mutex_initialized)
         return;
 
-    pthread_mutex_lock(&io_queue->queue_mutex);
-
     if (processed)
-        *processed = io_queue->operations_processed;
+        *processed = __atomic_load_n(&io_queue->stats->committed, __ATOMIC_RELAXED);
     if (dropped)
-        *dropped = io_queue->operations_dropped;
+        *dropped = __atomic_load_n(&io_queue->stats->dropped, __ATOMIC_RELAXED);
     if (pending)
-        *pending = io_queue->count;
-
-    pthread_mutex_unlock(&io_queue->queue_mutex);
+    {
+        uint64_t tail = __atomic_load_n(&io_queue->tail, __ATOMIC_RELAXED);
+        uint64_t head = __atomic_load_n(&io_queue->head, __ATOMIC_RELAXED);
+        *pending = (uint32_t)(tail - head) + __atomic_load_n(&io_queue->overflow_count, __ATOMIC_RELAXED);
+    }
 }
 
 bool lease_io_is_running(const struct lease_io_queue_t *io_queue)
@@ -1410,88 +2112,237 @@ bool lease_io_is_running(const struct lease_io_queue_t *io_queue)
     if (!io_queue || !io_queue->mutex_initialized)
         return false;
 
-    return io_queue->running;
+    return __atomic_load_n(&io_queue->running, __ATOMIC_ACQUIRE);
 }
 
-// I/O thread function - processes operations from queue
-static void *lease_io_thread_func(void *arg)
+//-----------------------------------------------------------------------------
+// Consumer side (I/O thread)
+//-----------------------------------------------------------------------------
+
+static bool io_overflow_ready(struct lease_io_queue_t *io_queue)
 {
-    struct lease_io_queue_t *io_queue = (struct lease_io_queue_t *)arg;
-    if (!io_queue)
-        return NULL;
+    return __atomic_load_n(&io_queue->overflow_count, __ATOMIC_ACQUIRE) > 0 &&
+           __atomic_load_n(&io_queue->overflow_min_stamp, __ATOMIC_ACQUIRE) <= io_queue->head;
+}
 
-    printf("I/O thread started (PID: %d, TID: %lu)\n", getpid(), pthread_self());
+static bool io_has_work(struct lease_io_queue_t *io_queue)
+{
+    const struct lease_io_slot_t *slot = &io_queue->slots[io_queue->head & (io_queue->capacity - 1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == io_queue->head + 1 || io_overflow_ready(io_queue) ||
+           __atomic_load_n(&io_queue->save_all_requested, __ATOMIC_ACQUIRE) ||
+           __atomic_load_n(&io_queue->stop_requested, __ATOMIC_ACQUIRE);
+}
 
-    while (1)
+static void io_wait_for_work(struct lease_io_queue_t *io_queue)
+{
+    pthread_mutex_lock(&io_queue->wait_mutex);
+    __atomic_store_n(&io_queue->consumer_sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!io_has_work(io_queue))
+        pthread_cond_wait(&io_queue->data_cond, &io_queue->wait_mutex);
+    __atomic_store_n(&io_queue->consumer_sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&io_queue->wait_mutex);
+}
+
+// Let producers parked by the block policy retry
+static void io_release_space(struct lease_io_queue_t *io_queue)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&io_queue->producers_waiting, __ATOMIC_RELAXED) > 0)
     {
-        pthread_mutex_lock(&io_queue->queue_mutex);
+        pthread_mutex_lock(&io_queue->wait_mutex);
+        pthread_cond_broadcast(&io_queue->space_cond);
+        pthread_mutex_unlock(&io_queue->wait_mutex);
+    }
+}
+
+// Move set-aside deltas whose turn has come (stamp <= head) into out[]
+static uint32_t io_overflow_drain(struct lease_io_queue_t *io_queue, struct lease_delta_t *out, uint32_t room)
+{
+    uint32_t n = 0;
+    uint64_t min_stamp = UINT64_MAX;
 
-        // Wait for operations in queue
-        while (io_queue->count == 0 && io_queue->running)
+    pthread_mutex_lock(&io_queue->overflow_mutex);
+    for (uint32_t i = 0; i < io_queue->overflow_count;)
+    {
+        struct lease_io_overflow_t *entry = &io_queue->overflow[i];
+        if (entry->stamp > io_queue->head || n == room)
         {
-            pthread_cond_wait(&io_queue->queue_cond, &io_queue->queue_mutex);
+            if (entry->stamp < min_stamp)
+                min_stamp = entry->stamp;
+            i++;
+            continue;
         }
 
-        // Check if we should exit (shutdown operation or stopped)
-        if (io_queue->count == 0 && !io_queue->running)
+        out[n++] = entry->delta;
+        lease_index_remove(&io_queue->overflow_index, hash_ip(entry->delta.lease.ip_address), i);
+
+        // Swap the last entry into the hole
+        uint32_t last = io_queue->overflow_count - 1;
+        if (i != last)
         {
-            pthread_mutex_unlock(&io_queue->queue_mutex);
-            break;
+            uint32_t hash = hash_ip(io_queue->overflow[last].delta.lease.ip_address);
+            lease_index_remove(&io_queue->overflow_index, hash, last);
+            io_queue->overflow[i] = io_queue->overflow[last];
+            lease_index_insert(&io_queue->overflow_index, hash, i);
         }
+        __atomic_store_n(&io_queue->overflow_count, last, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&io_queue->overflow_min_stamp, min_stamp, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&io_queue->overflow_mutex);
+    return n;
+}
+
+// Take every published delta, in ring order, into io_queue->batch
+static uint32_t io_collect(struct lease_io_queue_t *io_queue)
+{
+    uint64_t mask = io_queue->capacity - 1;
+    uint32_t room = io_queue->capacity * 2;
+    uint32_t from_ring = 0;
+    uint32_t n = 0;
 
-        // Dequeue operation
-        struct io_operation_t op = io_queue->queue[io_queue->head];
-        io_queue->head = (io_queue->head + 1) % IO_QUEUE_SIZE;
-        io_queue->count--;
+    for (;;)
+    {
+        // A set-aside delta goes out before any ring position at or after its stamp
+        // (room for the rest of the ring is kept free)
+        uint32_t overflow_room = room - n - (io_queue->capacity - from_ring);
+        if (overflow_room > 0 && io_overflow_ready(io_queue))
+            n += io_overflow_drain(io_queue, io_queue->batch + n, overflow_room);
+
+        struct lease_io_slot_t *slot = &io_queue->slots[io_queue->head & mask];
+        if (from_ring == io_queue->capacity || __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != io_queue->head + 1)
+            break;
+
+        io_queue->batch[n++] = slot->delta;
+        __atomic_store_n(&slot->seq, io_queue->head + io_queue->capacity, __ATOMIC_RELEASE);
+        __atomic_store_n(&io_queue->head, io_queue->head + 1, __ATOMIC_RELAXED);
+        from_ring++;
+    }
+    return n;
+}
+
+// Rebuild the string table before a snapshot. Deltas queued before the
+// previous rebuild may point into the table it retired, which this one frees:
+// wait until they are all written.
+static void io_compact_strings(struct lease_io_queue_t *io_queue)
+{
+    if (io_queue->head < io_queue->strings_rebuilt_tail ||
+        __atomic_load_n(&io_queue->overflow_count, __ATOMIC_RELAXED) > 0)
+        return;
 
-        pthread_mutex_unlock(&io_queue->queue_mutex);
+    if (lease_db_compact_strings(io_queue->db) == 1)
+        io_queue->strings_rebuilt_tail = __atomic_load_n(&io_queue->tail, __ATOMIC_ACQUIRE);
+}
 
-        // Process operation (outside lock to avoid blocking producers)
-        switch (op.type)
+// Persist one batch of deltas, then snapshot the database if asked to (or due)
+static void lease_io_process_batch(struct lease_io_queue_t *io_queue, const struct lease_delta_t *deltas, uint32_t n,
+                                   bool compact)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (io_queue->journal_open)
         {
-        case IO_OP_SAVE_LEASE:
-            // Append single lease to file
-            if (lease_db_append_lease(io_queue->db, &op.lease) == 0)
+            if (lease_journal_append(&io_queue->journal, &deltas[i].lease) != 0)
             {
-                printf("[I/O] Saved lease: %s\n", inet_ntoa(op.lease.ip_address));
+                char ip_str[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &deltas[i].lease.ip_address, ip_str, sizeof(ip_str));
+                fprintf(stderr, "[I/O] Failed to journal lease %s\n", ip_str);
             }
-            else
-            {
-                fprintf(stderr, "[I/O] Failed to save lease\n");
-            }
-            break;
+        }
+        else if (lease_db_append_lease(io_queue->db, &deltas[i].lease) != 0)
+        {
+            fprintf(stderr, "[I/O] Failed to save lease\n");
+        }
+    }
 
-        case IO_OP_SAVE_ALL:
-            // Save entire database
-            if (lease_db_save_safe(io_queue->db) == 0)
-            {
-                printf("[I/O] Saved full database\n");
-            }
-            else
-            {
+    // Group commit: every lease of the batch in one write() + fdatasync()
+    if (io_queue->journal_open && n > 0)
+    {
+        uint64_t start = io_now_ns();
+        if (lease_journal_commit(&io_queue->journal) != 0)
+            fprintf(stderr, "[I/O] Failed to commit %u leases to the journal\n", n);
+        io_stat_add(&io_queue->stats->fsync_ns_hist[shm_stats_hdr_bucket(io_now_ns() - start)], 1);
+    }
+
+    if (n > 0)
+    {
+        struct io_queue_stats_t *stats = io_queue->stats;
+        uint64_t done = io_now_ns();
+        for (uint32_t i = 0; i < n; i++)
+            io_stat_add(&stats->latency_us_hist[shm_stats_bucket((done - deltas[i].enqueue_ns) / 1000)], 1);
+        io_stat_add(&stats->committed, n);
+    }
+
+    if (!io_queue->journal_open)
+    {
+        // Legacy path: full rewrite of the text file
+        if (compact)
+        {
+            io_compact_strings(io_queue);
+            if (lease_db_save_safe(io_queue->db) != 0)
                 fprintf(stderr, "[I/O] Failed to save database\n");
-            }
-            break;
+        }
+        return;
+    }
 
-        case IO_OP_SHUTDOWN:
-            printf("[I/O] Shutdown signal received\n");
-            pthread_mutex_lock(&io_queue->queue_mutex);
-            io_queue->running = false;
-            pthread_mutex_unlock(&io_queue->queue_mutex);
-            goto exit_loop; // Exit cleanly
+    uint32_t lease_count = lease_db_count(io_queue->db);
+    if (compact || lease_journal_should_compact(&io_queue->journal, lease_count))
+    {
+        io_compact_strings(io_queue);
+        if (lease_journal_compact(&io_queue->journal, io_queue->db) == 0)
+            printf("[I/O] Lease journal compacted into %s\n", io_queue->journal.snapshot_path);
+        else
+            fprintf(stderr, "[I/O] Lease journal compaction failed\n");
+    }
+}
 
-        default:
-            fprintf(stderr, "[I/O] Unknown operation type: %d\n", op.type);
+// I/O thread function - drains the ring in batches
+static void *lease_io_thread_func(void *arg)
+{
+    struct lease_io_queue_t *io_queue = (struct lease_io_queue_t *)arg;
+    if (!io_queue)
+        return NULL;
+
+    printf("I/O thread started (PID: %d, TID: %lu)\n", getpid(), pthread_self());
+
+    while (1)
+    {
+        bool stop = __atomic_load_n(&io_queue->stop_requested, __ATOMIC_ACQUIRE);
+
+        uint64_t depth = __atomic_load_n(&io_queue->tail, __ATOMIC_RELAXED) - io_queue->head +
+                         __atomic_load_n(&io_queue->overflow_count, __ATOMIC_RELAXED);
+        __atomic_store_n(&io_queue->stats->depth, depth, __ATOMIC_RELAXED);
+        uint32_t n = io_collect(io_queue);
+        bool save_all = __atomic_exchange_n(&io_queue->save_all_requested, false, __ATOMIC_ACQ_REL);
+
+        if (n > 0)
+        {
+            io_stat_add(&io_queue->stats->depth_hist[shm_stats_bucket(depth)], 1);
+            io_stat_add(&io_queue->stats->batches, 1);
+            io_release_space(io_queue);
+        }
+
+        // Process deltas (producers keep filling the ring meanwhile)
+        if (n > 0 || save_all)
+            lease_io_process_batch(io_queue, io_queue->batch, n, save_all);
+
+        if (stop && n == 0)
+        {
+            printf("[I/O] Shutdown signal received\n");
+            lease_io_process_batch(io_queue, io_queue->batch, 0, true); // Final snapshot
             break;
         }
 
-        // Update statistics
-        pthread_mutex_lock(&io_queue->queue_mutex);
-        io_queue->operations_processed++;
-        pthread_mutex_unlock(&io_queue->queue_mutex);
+        if (n == 0 && !save_all)
+            io_wait_for_work(io_queue);
     }
 
-exit_loop:
+    // Producers still parked by the block policy give up from now on
+    pthread_mutex_lock(&io_queue->wait_mutex);
+    __atomic_store_n(&io_queue->running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&io_queue->space_cond);
+    pthread_mutex_unlock(&io_queue->wait_mutex);
+
     printf("I/O thread exiting\n");
     return NULL;
 }
@@ -1536,7 +2387,8 @@ static void dhcp_server_signal_handler(int signum)
     }
 }
 
-int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint32_t timer_interval, bool enable_async_io)
+int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint32_t timer_interval,
+                     const struct lease_io_config_t *io_config)
 {
     if (!server || !lease_file)
         return -1;
@@ -1557,9 +2409,6 @@ int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint3
         return -1;
     }
 
-    // Load existing leases
-    lease_db_load(server->lease_db);
-
     // Initialize timer if interval > 0
     if (timer_interval > 0)
     {
@@ -1583,7 +2432,7 @@ int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint3
     }
 
     // Initialize I/O queue if enabled
-    if (enable_async_io)
+    if (io_config)
     {
         server->io_queue = malloc(sizeof(struct lease_io_queue_t));
         if (!server->io_queue)
@@ -1598,7 +2447,7 @@ int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint3
             return -1;
         }
 
-        if (lease_io_init(server->io_queue, server->lease_db) != 0)
+        if (lease_io_init(server->io_queue, server->lease_db, io_config) != 0)
         {
             free(server->io_queue);
             server->io_queue = NULL;
@@ -1612,6 +2461,12 @@ int dhcp_server_init(struct dhcp_server_t *server, const char *lease_file, uint3
         }
     }
 
+    // Load existing leases: snapshot + journal replay, or the text file alone
+    if (server->io_queue && server->io_queue->journal_open)
+        lease_journal_recover(&server->io_queue->journal, server->lease_db);
+    else
+        lease_db_load(server->lease_db);
+
     // Initialize synchronization
     if (pthread_mutex_init(&server->server_mutex, NULL) != 0)
     {
@@ -1788,7 +2643,13 @@ void dhcp_server_print_stats(const struct dhcp_server_t *server)
     if (server->lease_db)
     {
         printf("Lease Database:\n");
-        printf("  Total leases: %u\n", server->lease_db->lease_count);
+        uint32_t chunks = 0;
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+            chunks += server->lease_db->shards[s].chunk_count;
+        printf("  Total leases: %u\n", lease_db_count(server->lease_db));
+        printf("  Storage chunks: %u (%u leases each, %u shards)\n", chunks, LEASE_CHUNK_SIZE, LEASE_DB_SHARDS);
+        printf("  Interned strings: %u (%lu bytes)\n", server->lease_db->strings.entry_count,
+               server->lease_db->strings.bytes_stored);
         printf("  Next lease ID: %lu\n", server->lease_db->next_lease_id);
     }
 
@@ -1798,20 +2659,35 @@ void dhcp_server_print_stats(const struct dhcp_server_t *server)
         printf("Timer Thread:\n");
         printf("  Status: %s\n", lease_timer_is_running(server->timer) ? "Running" : "Stopped");
         printf("  Check interval: %u seconds\n", server->timer->check_interval_sec);
+        printf("  Leases expired: %lu\n", server->timer->expired_total);
+        uint32_t scheduled = 0;
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+            scheduled += server->lease_db->shards[s].expiry.count;
+        printf("  Scheduled expiries: %u\n", scheduled);
     }
 
     // I/O queue stats
     if (server->io_queue)
     {
-        uint64_t processed, dropped;
-        uint32_t pending;
+        uint64_t processed = 0, dropped = 0;
+        uint32_t pending = 0;
         lease_io_get_stats(server->io_queue, &processed, &dropped, &pending);
 
+        const struct io_queue_stats_t *stats = server->io_queue->stats;
         printf("I/O Queue:\n");
         printf("  Status: %s\n", lease_io_is_running(server->io_queue) ? "Running" : "Stopped");
-        printf("  Operations processed: %lu\n", processed);
+        printf("  Ring: %u slots, backpressure: %s\n", server->io_queue->capacity,
+               lease_io_backpressure_to_string(server->io_queue->backpressure));
+        printf("  Operations processed: %lu (%lu batches)\n", processed, stats->batches);
         printf("  Operations dropped: %lu\n", dropped);
+        printf("  Operations coalesced: %lu, producer waits: %lu\n", stats->coalesced, stats->blocked);
         printf("  Operations pending: %u\n", pending);
+        if (server->io_queue->journal_open)
+        {
+            const struct lease_journal_t *journal = &server->io_queue->journal;
+            printf("  Journal records: %lu (%lu commits, %lu compactions, %lu errors)\n",
+                   journal->records_written, journal->commits, journal->compactions, journal->errors);
+        }
     }
 
     printf("==============================\n\n");
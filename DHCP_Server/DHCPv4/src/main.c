@@ -1,19 +1,29 @@
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <net/if.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "../include/src/config_v4.h"
+#include "../include/src/config_version.h"
 #include "../include/src/dhcp_common.h"
 #include "../include/src/dhcp_message.h"
 #include "../include/src/ip_pool.h"
 #include "../include/src/lease_v4.h"
+#include "../include/src/packet_pool.h"
+#include "../include/src/ping_probe.h"
+#include "../include/src/stats_v4.h"
+#include "../include/src/subnet_trie.h"
+#include "../include/utils/epoch.h"
 #include "../include/utils/network_utils.h"
 #include "../include/utils/thread_pool.h"
 #include "../../logger/logger.h"
@@ -22,6 +32,9 @@
 #define RECV_BUF_SIZE 1024
 #define SERVER_CONFIG_FILE "DHCPv4/config/dhcpv4.conf"
 #define LEASE_DB_FILE "DHCPv4/data/dhcpv4.leases"
+#define FALLBACK_SERVER_PORT 6767
+#define MAX_WORKERS 64 // Matches MAX_THREADS of the shared thread pool
+#define PROBE_MAX_ATTEMPTS 3 // Addresses probed per DISCOVER before giving up on conflicts
 
 // Global state
 static volatile int g_running = 1;
@@ -29,10 +42,50 @@ struct server_context_t
 {
     int sockfd;
     struct dhcp_server_t dhcp;  // Unified lease management (db + timer + I/O queue)
-    struct dhcp_config_t config;
-    struct ip_pool_t pools[MAX_SUBNETS];
-    struct ip_pool_sync_t pool_syncs[MAX_SUBNETS];
-    int pool_count;
+    const char *config_file;
+    // Current configuration generation (config, pools, subnet index). Read
+    // inside config_epoch; replaced on SIGHUP by reload_config().
+    _Atomic(struct config_version_t *) config;
+    struct epoch_domain_t config_epoch;
+    atomic_flag reload_busy;
+    struct dhcp_global_options_t startup; // Settings that only take effect at startup
+    struct packet_pool_t packet_pool; // Preallocated receive slots
+    struct ping_prober_t prober;      // Asynchronous ICMP conflict probes (ping-check)
+    bool prober_running;
+    struct server_v4_stats_t *stats;  // Live statistics for the monitor (NULL if unavailable)
+    pthread_t stats_thread;           // Refreshes the subnet table of stats once a second
+    bool stats_thread_running;
+};
+
+// DISCOVER parked while the address picked for it is being probed. The probe
+// outlives the read section it started in, so the subnet is found again from
+// the probed address in whatever generation is current when it completes.
+struct parked_offer_t
+{
+    struct packet_task_t task; // Copy of the request and where it came from
+    int attempts;              // Addresses probed so far
+};
+
+// Replies produced while handling one receive batch, sent with a single
+// sendmmsg() once the batch is done (worker-reuseport mode)
+struct reply_batch_t
+{
+    int sockfd;
+    int count;
+    struct dhcp_packet packets[PACKET_RECV_BATCH];
+    struct sockaddr_in dests[PACKET_RECV_BATCH];
+    struct iovec iovecs[PACKET_RECV_BATCH];
+    struct mmsghdr msgs[PACKET_RECV_BATCH];
+};
+
+// Per-core worker owning its own SO_REUSEPORT socket (worker-reuseport mode)
+struct packet_worker_t
+{
+    int id;
+    int sockfd;
+    bool pin_cpu;
+    pthread_t thread;
+    bool started;
 };
 
 struct server_context_t g_server;
@@ -40,50 +93,476 @@ struct server_context_t g_server;
 // Signal handler
 void handle_signal(int sig)
 {
-    (void)sig;
+    if (sig == SIGHUP)
+    {
+        g_server.dhcp.reload_requested = 1; // Picked up by the main loop
+        return;
+    }
     g_running = 0;
 }
 
-// Task argument structure
-struct packet_task_t
+// Enter a read section and return the current configuration generation; it
+// stays valid until config_release()
+static struct config_version_t *config_acquire(void)
 {
-    struct dhcp_packet packet;
-    ssize_t len;
-    struct sockaddr_in client_addr;
-};
+    epoch_enter(&g_server.config_epoch);
+    return atomic_load(&g_server.config);
+}
 
-// Worker function to process DHCP packets
-void packet_processor(void *arg)
+static void config_release(void)
+{
+    epoch_exit(&g_server.config_epoch);
+}
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Create the shared-memory statistics segment read by the monitor
+static void open_stats_shm(void)
+{
+    g_server.stats = stats_v4_open();
+    if (g_server.stats)
+        log_info("Live statistics published at %s", SHM_STATS_V4_NAME);
+    else
+        log_warn("Live statistics unavailable, running without them");
+}
+
+// Stats thread: publish pool usage of the current generation once a second.
+// Packet workers only ever touch their own counters; anything that needs a
+// look at shared state is gathered here, off the packet path.
+static void *stats_publisher(void *arg)
+{
+    (void)arg;
+    while (g_running)
+    {
+        stats_v4_publish(config_acquire());
+        config_release();
+        for (int i = 0; i < 10 && g_running; i++)
+            usleep(100 * 1000);
+    }
+    return NULL;
+}
+
+// Open, configure and bind one server socket. Returns the fd or -1.
+static int open_server_socket(const char *interface, uint16_t port, bool reuseport)
+{
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0)
+    {
+        log_error("socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int broadcast_on = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_BROADCAST, &broadcast_on, sizeof(broadcast_on));
+
+    int reuse_addr = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(reuse_addr));
+
+    if (reuseport)
+    {
+        // Every worker binds the same port; the kernel hashes each flow to one socket
+        int reuse_port = 1;
+        if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port)) < 0)
+        {
+            log_error("Failed to set SO_REUSEPORT: %s", strerror(errno));
+            close(sockfd);
+            return -1;
+        }
+    }
+
+    // Report the local address each datagram arrived on (subnet selection)
+    int pktinfo_on = 1;
+    if (setsockopt(sockfd, IPPROTO_IP, IP_PKTINFO, &pktinfo_on, sizeof(pktinfo_on)) < 0)
+        log_warn("Failed to enable IP_PKTINFO: %s", strerror(errno));
+
+    // Wake up once a second so receive loops notice shutdown even when idle
+    struct timeval tv = {.tv_sec = 1, .tv_usec = 0};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // Bind to specific interface if provided
+    // This is CRITICAL for systems with multiple interfaces to ensure
+    // broadcast replies go out the correct interface
+    if (interface)
+    {
+        if (setsockopt(sockfd, SOL_SOCKET, SO_BINDTODEVICE, interface, strlen(interface) + 1) < 0)
+        {
+            log_error("Failed to bind to interface %s: %s", interface, strerror(errno));
+            log_info("Note: SO_BINDTODEVICE requires root/CAP_NET_RAW");
+            close(sockfd);
+            return -1;
+        }
+    }
+
+    struct sockaddr_in server_addr = {0};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        log_warn("Failed to bind port %u: %s", port, strerror(errno));
+        close(sockfd);
+        return -1;
+    }
+
+    return sockfd;
+}
+
+// Point one recvmmsg() entry at a packet slot: payload, source address and ancillary data
+static void prepare_recv_msg(struct mmsghdr *msg, struct iovec *iov, struct packet_task_t *task)
+{
+    iov->iov_base = &task->packet;
+    iov->iov_len = sizeof(struct dhcp_packet);
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_hdr.msg_name = &task->client_addr;
+    msg->msg_hdr.msg_namelen = sizeof(task->client_addr);
+    msg->msg_hdr.msg_iov = iov;
+    msg->msg_hdr.msg_iovlen = 1;
+    msg->msg_hdr.msg_control = task->control;
+    msg->msg_hdr.msg_controllen = sizeof(task->control);
+}
+
+// Fill in the per-datagram fields of a slot once recvmmsg() returned it
+static void complete_recv_msg(struct packet_task_t *task, struct mmsghdr *msg, int sockfd)
+{
+    task->len = msg->msg_len;
+    task->sockfd = sockfd;
+    task->recv_ns = monotonic_ns();
+    task->local_addr.s_addr = 0;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg->msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msg->msg_hdr, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+        {
+            struct in_pktinfo info;
+            memcpy(&info, CMSG_DATA(cmsg), sizeof(info));
+            task->local_addr = info.ipi_spec_dst; // Interface address, also for broadcasts
+        }
+    }
+}
+
+// Client identifier (Option 61) of a request, or NULL; host reservations may be keyed on it
+static const uint8_t *client_id_of(const struct packet_task_t *task, uint32_t *len)
+{
+    uint8_t opt_len = 0;
+    const uint8_t *client_id = dhcp_options_get(&task->packet, &task->options, DHCP_OPT_CLIENT_ID, &opt_len);
+    *len = client_id ? opt_len : 0;
+    return client_id;
+}
+
+// Choose the subnet (and pool, same index) a packet belongs to, or -1 to drop it.
+// A relayed packet is placed by giaddr only; a local one by the client's address
+// when it has one, else by the address of the interface it arrived on.
+// A local packet matching nothing goes to the first subnet only when there is
+// no choice to get wrong: a single subnet is configured, or it came in over
+// loopback (test setups, whose interface is in no configured subnet).
+static int select_subnet(const struct config_version_t *cfg, const struct packet_task_t *task)
+{
+    const struct dhcp_packet *req = &task->packet;
+
+    if (req->giaddr.s_addr != 0)
+        return subnet_trie_lookup(&cfg->subnet_trie, req->giaddr);
+
+    int index = -1;
+    if (req->ciaddr.s_addr != 0)
+        index = subnet_trie_lookup(&cfg->subnet_trie, req->ciaddr);
+    if (index < 0 && task->local_addr.s_addr != 0)
+        index = subnet_trie_lookup(&cfg->subnet_trie, task->local_addr);
+
+    if (index < 0 && cfg->pool_count > 0 &&
+        (cfg->pool_count == 1 || (ntohl(task->local_addr.s_addr) >> 24) == IN_LOOPBACKNET))
+        index = 0;
+    return index;
+}
+
+// Buffer to build a reply in: the next free slot of the batch, or fallback when
+// there is no batch (thread pool, prober thread) or it is full
+static struct dhcp_packet *reply_buffer(struct reply_batch_t *batch, struct dhcp_packet *fallback)
+{
+    if (batch && batch->count < PACKET_RECV_BATCH)
+        return &batch->packets[batch->count];
+    return fallback;
+}
+
+// Send the first len bytes of a reply built in reply_buffer(): queued when it
+// sits in the batch, sent right away otherwise
+static void send_reply(const struct packet_task_t *task, struct reply_batch_t *batch, struct dhcp_packet *res,
+                       size_t len, const struct sockaddr_in *dest)
+{
+    if (batch && batch->count < PACKET_RECV_BATCH && res == &batch->packets[batch->count])
+    {
+        int i = batch->count++;
+        batch->dests[i] = *dest;
+        batch->iovecs[i].iov_base = res;
+        batch->iovecs[i].iov_len = len;
+        memset(&batch->msgs[i], 0, sizeof(batch->msgs[i]));
+        batch->msgs[i].msg_hdr.msg_name = &batch->dests[i];
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->dests[i]);
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovecs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        return;
+    }
+    sendto(task->sockfd, res, len, 0, (const struct sockaddr *)dest, sizeof(*dest));
+}
+
+// Send every queued reply; a datagram the kernel refuses is dropped like a failed sendto()
+static void flush_replies(struct reply_batch_t *batch)
+{
+    int sent = 0;
+    while (sent < batch->count)
+    {
+        int n = sendmmsg(batch->sockfd, &batch->msgs[sent], (unsigned int)(batch->count - sent), 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            log_warn("sendmmsg: %s", strerror(errno));
+            n = 1; // Skip the datagram that failed
+        }
+        sent += n;
+    }
+    batch->count = 0;
+}
+
+// Hand a lease change to the I/O thread, which group-commits it to the journal
+static void persist_lease(const struct dhcp_lease_t *lease)
+{
+    if (lease && g_server.dhcp.io_queue)
+        lease_io_queue_save_lease(g_server.dhcp.io_queue, lease);
+}
+
+// Build the OFFER for a lease and send it to the client (or its relay)
+static void send_offer(const struct packet_task_t *task, struct config_version_t *cfg, struct dhcp_lease_t *lease,
+                       struct dhcp_subnet_t *subnet, struct reply_batch_t *batch)
+{
+    const struct dhcp_packet *req = &task->packet;
+    struct dhcp_packet local;
+    struct dhcp_packet *res = reply_buffer(batch, &local);
+    struct sockaddr_in dest = task->client_addr;
+
+    size_t len = dhcp_message_make_offer(res, req, &task->options, lease, subnet, &cfg->config.global);
+    if (req->giaddr.s_addr != 0)
+    {
+        dest.sin_port = htons(DHCP_CLIENT_PORT);
+        dest.sin_addr = req->giaddr; // Unicast to relay
+    }
+    else if ((ntohl(task->client_addr.sin_addr.s_addr) & 0xFF000000) == 0x7F000000)
+    {
+        // Loopback - keep original client address AND port for unicast reply
+        dest.sin_port = task->client_addr.sin_port;
+    }
+    else
+    {
+        dest.sin_port = htons(DHCP_CLIENT_PORT);
+        dest.sin_addr.s_addr = INADDR_BROADCAST; // Broadcast
+    }
+
+    send_reply(task, batch, res, len, &dest);
+    stats_v4_count_message(DHCP_OFFER);
+    char ip_buf[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &lease->ip_address, ip_buf, sizeof(ip_buf));
+    log_info(">>> OFFER: Allocated IP %s to client (lease %us)", ip_buf, subnet->default_lease_time);
+}
+
+// Create the lease for an address allocated to a DISCOVER and OFFER it
+static void commit_and_offer(const struct packet_task_t *task, struct config_version_t *cfg, int subnet_index,
+                             struct in_addr ip, struct reply_batch_t *batch)
+{
+    struct dhcp_subnet_t *subnet = &cfg->config.subnets[subnet_index];
+    struct dhcp_lease_t lease;
+    uint32_t client_id_len;
+    const uint8_t *client_id = client_id_of(task, &client_id_len);
+    if (ip_pool_commit_lease(cfg->pools[subnet_index], g_server.dhcp.lease_db, task->packet.chaddr, client_id,
+                             client_id_len, ip, subnet->default_lease_time, &lease) == 0)
+        send_offer(task, cfg, &lease, subnet, batch);
+    else
+    {
+        stats_v4_add(&stats_v4_slot()->errors, 1);
+        log_warn(">>> OFFER FAILED: Could not create lease for client");
+    }
+}
+
+static void probe_done(void *arg, struct in_addr ip, ping_probe_result_t result);
+
+// Pick a new address for a DISCOVER and OFFER it. When ping-check wants the
+// address probed first, the request is parked and the OFFER goes out from
+// probe_done() on the prober thread, so the worker moves on immediately.
+// parked is NULL for a fresh DISCOVER or the parked request being retried
+// after a conflict (task then points into it); either way it is consumed.
+// An OFFER sent right away goes into batch (may be NULL).
+static void offer_new_address(const struct packet_task_t *task, struct config_version_t *cfg, int subnet_index,
+                              struct in_addr req_ip, struct parked_offer_t *parked, struct reply_batch_t *batch)
+{
+    struct ip_pool_t *pool = cfg->pools[subnet_index];
+    const uint8_t *mac = task->packet.chaddr;
+    uint32_t client_id_len;
+    const uint8_t *client_id = client_id_of(task, &client_id_len);
+
+    struct ip_allocation_result_t result = ip_pool_allocate(pool, mac, client_id, client_id_len, req_ip, &cfg->config);
+    if (result.probe_pending)
+    {
+        log_debug("DISCOVER retransmitted while its conflict probe is in flight, ignored");
+        free(parked);
+        return;
+    }
+    if (!result.success)
+    {
+        stats_v4_add(&stats_v4_slot()->errors, 1);
+        log_warn(">>> OFFER FAILED: No IP available for client");
+        free(parked);
+        return;
+    }
+
+    if (result.needs_probe)
+    {
+        if (!parked)
+        {
+            parked = malloc(sizeof(struct parked_offer_t));
+            if (!parked)
+            {
+                stats_v4_add(&stats_v4_slot()->errors, 1);
+                log_error("Failed to park DISCOVER for conflict probe");
+                ip_pool_resolve_probe(pool, result.ip_address, mac, IP_STATE_AVAILABLE);
+                return;
+            }
+            parked->task = *task;
+            parked->attempts = 0;
+            task = &parked->task;
+            mac = task->packet.chaddr;
+        }
+        parked->attempts++;
+
+        if (g_server.prober_running &&
+            ping_prober_submit(&g_server.prober, result.ip_address, cfg->config.global.ping_timeout * 1000,
+                               probe_done, parked) == 0)
+            return; // OFFER completes in probe_done()
+
+        // No prober (no raw socket) or too many probes in flight: offer unprobed
+        ip_pool_resolve_probe(pool, result.ip_address, mac, IP_STATE_ALLOCATED);
+    }
+
+    commit_and_offer(task, cfg, subnet_index, result.ip_address, batch);
+    free(parked);
+}
+
+// Prober callback: finish (or retry) a parked DISCOVER
+static void probe_done(void *arg, struct in_addr ip, ping_probe_result_t result)
+{
+    struct parked_offer_t *parked = (struct parked_offer_t *)arg;
+    const uint8_t *mac = parked->task.packet.chaddr;
+
+    // A reload may have replaced the pool the hold was taken in; a new pool has
+    // no hold, so the OFFER is dropped and the client's retransmission starts over
+    struct config_version_t *cfg = config_acquire();
+    int subnet_index = subnet_trie_lookup(&cfg->subnet_trie, ip);
+    if (subnet_index < 0 || subnet_index >= cfg->pool_count)
+    {
+        config_release();
+        free(parked);
+        return;
+    }
+    struct ip_pool_t *pool = cfg->pools[subnet_index];
+
+    if (result == PING_PROBE_CANCELLED)
+    {
+        ip_pool_resolve_probe(pool, ip, mac, IP_STATE_AVAILABLE);
+        free(parked);
+    }
+    else if (result == PING_PROBE_IN_USE)
+    {
+        ip_pool_resolve_probe(pool, ip, mac, IP_STATE_CONFLICT);
+        char ip_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &ip, ip_str, sizeof(ip_str));
+        log_warn("Address %s answered the conflict probe, marked as conflict", ip_str);
+
+        if (parked->attempts >= PROBE_MAX_ATTEMPTS)
+        {
+            stats_v4_add(&stats_v4_slot()->errors, 1);
+            log_warn(">>> OFFER FAILED: %d probed addresses were in use", parked->attempts);
+            free(parked);
+        }
+        else
+        {
+            struct in_addr none = {0};
+            offer_new_address(&parked->task, cfg, subnet_index, none, parked, NULL);
+        }
+    }
+    else
+    {
+        // No reply: the address is free, unless the hold was dropped meanwhile
+        if (ip_pool_resolve_probe(pool, ip, mac, IP_STATE_ALLOCATED) == 0)
+            commit_and_offer(&parked->task, cfg, subnet_index, ip, NULL);
+        free(parked);
+    }
+    config_release();
+}
+
+// Lease timer callback: give the address of an expired lease back to its pool
+static void lease_expired(void *arg, struct dhcp_lease_t *lease)
+{
+    (void)arg;
+    struct config_version_t *cfg = config_acquire();
+    int subnet_index = subnet_trie_lookup(&cfg->subnet_trie, lease->ip_address);
+    if (subnet_index >= 0 && subnet_index < cfg->pool_count)
+        ip_pool_expire_lease(cfg->pools[subnet_index], lease);
+    config_release();
+}
+
+// Handle one received DHCP packet with configuration generation cfg and send
+// the reply, if any. With a batch the reply is queued there for the caller to flush.
+static void handle_packet(struct packet_task_t *task, struct config_version_t *cfg, struct reply_batch_t *batch)
 {
-    struct packet_task_t *task = (struct packet_task_t *)arg;
     struct dhcp_packet *req = &task->packet;
-    struct dhcp_packet res;
+    struct dhcp_packet local;
+    struct dhcp_packet *res = reply_buffer(batch, &local);
     struct sockaddr_in dest = task->client_addr;
 
     // Validate packet
     if (dhcp_message_validate(req, task->len) != 0)
     {
+        stats_v4_add(&stats_v4_slot()->pkt_invalid, 1);
         log_warn("Received invalid DHCP packet");
-        free(task);
         return;
     }
 
-    uint8_t msg_type = dhcp_message_get_type(req);
-
-    // Identify subnet based on GIADDR or Interface (simplified to assume local
-    // subnet) For a real server, we'd match the interface IP or giaddr to a
-    // subnet in config
-    struct dhcp_subnet_t *subnet = &g_server.config.subnets[0]; // Naive: use first subnet
-    struct ip_pool_t *pool = &g_server.pools[0];
+    // Index the options once; every lookup below is a table read
+    if (dhcp_options_parse(req, task->len, &task->options) != 0)
+    {
+        stats_v4_add(&stats_v4_slot()->pkt_invalid, 1);
+        log_warn("Received DHCP packet with malformed options");
+        return;
+    }
+    uint8_t msg_type = dhcp_options_get_u8(req, &task->options, DHCP_OPT_MESSAGE_TYPE);
+    stats_v4_count_message(msg_type);
 
-    // Find correct subnet/pool if multiple exist
-    // Implementation omitted for brevity - would check if giaddr matches a subnet
+    int subnet_index = select_subnet(cfg, task);
+    if (subnet_index < 0)
+    {
+        stats_v4_add(&stats_v4_slot()->pkt_dropped, 1);
+        stats_v4_add(&stats_v4_slot()->pkt_no_subnet, 1);
+        char giaddr_str[INET_ADDRSTRLEN], local_str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &req->giaddr, giaddr_str, sizeof(giaddr_str));
+        inet_ntop(AF_INET, &task->local_addr, local_str, sizeof(local_str));
+        log_warn("Dropping DHCP packet from unknown network segment (giaddr %s, interface %s)", giaddr_str,
+                 local_str);
+        return;
+    }
+    struct dhcp_subnet_t *subnet = &cfg->config.subnets[subnet_index];
+    struct ip_pool_t *pool = cfg->pools[subnet_index];
+    stats_v4_add(&stats_v4_slot()->pkt_processed, 1);
 
+    char from_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &dest.sin_addr, from_str, sizeof(from_str));
     log_info("Processing DHCP %s from %s (MAC: %02x:%02x:%02x:%02x:%02x:%02x)",
            msg_type == DHCP_DISCOVER ? "DISCOVER" :
            msg_type == DHCP_REQUEST ? "REQUEST" :
            msg_type == DHCP_RELEASE ? "RELEASE" : "UNKNOWN",
-           inet_ntoa(dest.sin_addr),
+           from_str,
            req->chaddr[0], req->chaddr[1], req->chaddr[2],
            req->chaddr[3], req->chaddr[4], req->chaddr[5]);
 
@@ -91,69 +570,41 @@ void packet_processor(void *arg)
     {
     case DHCP_DISCOVER:
     {
-        struct dhcp_lease_t *lease = NULL;
-        // 1. Try to find existing lease for MAC
-        lease = lease_db_find_by_mac(g_server.dhcp.lease_db, req->chaddr);
+        // 1. Try to find existing lease for MAC (only one on this segment counts);
+        // a copy, since other workers may change it once the lookup returns
+        struct dhcp_lease_t lease;
+        bool found = lease_db_find_by_mac_safe(g_server.dhcp.lease_db, req->chaddr, &lease) == 0 &&
+                     ip_pool_is_in_range(pool, lease.ip_address);
 
-        // 2. Or allocate new IP
-        if (!lease)
+        if (found && lease.state == LEASE_STATE_ACTIVE)
         {
-            struct in_addr req_ip = {0};
-            uint8_t *req_ip_opt = dhcp_message_get_option(req, DHCP_OPT_REQUESTED_IP, NULL);
-            if (req_ip_opt)
-                memcpy(&req_ip.s_addr, req_ip_opt, 4);
-
-            lease = ip_pool_allocate_and_create_lease(
-                pool, g_server.dhcp.lease_db, req->chaddr, req_ip, &g_server.config,
-                subnet->default_lease_time);
+            send_offer(task, cfg, &lease, subnet, batch);
+            break;
         }
 
-        if (lease)
-        {
-            dhcp_message_make_offer(&res, req, lease, subnet, &g_server.config.global);
-            // Send OFFER
-            if (req->giaddr.s_addr != 0)
-            {
-                dest.sin_port = htons(DHCP_CLIENT_PORT);
-                dest.sin_addr = req->giaddr; // Unicast to relay
-            }
-            else if ((ntohl(task->client_addr.sin_addr.s_addr) & 0xFF000000) == 0x7F000000)
-            {
-                // Loopback - keep original client address AND port for unicast reply
-                dest.sin_port = task->client_addr.sin_port;
-            }
-            else
-            {
-                dest.sin_port = htons(DHCP_CLIENT_PORT);
-                dest.sin_addr.s_addr = INADDR_BROADCAST; // Broadcast
-            }
-
-            sendto(g_server.sockfd, &res, sizeof(res), 0, (struct sockaddr *)&dest, sizeof(dest));
-            char ip_buf[INET_ADDRSTRLEN];   
-            inet_ntop(AF_INET, &lease->ip_address, ip_buf, sizeof(ip_buf));
-            log_info(">>> OFFER: Allocated IP %s to client (lease %us)", ip_buf, subnet->default_lease_time);
-        }
+        // 2. Or allocate new IP (possibly completing later, after a conflict probe),
+        // preferring the client's previous address, then the one it asks for
+        struct in_addr req_ip = {0};
+        if (found)
+            req_ip = lease.ip_address;
         else
-        {
-            log_warn(">>> OFFER FAILED: No IP available for client");
-        }
+            dhcp_options_get_ip(req, &task->options, DHCP_OPT_REQUESTED_IP, &req_ip);
+
+        offer_new_address(task, cfg, subnet_index, req_ip, NULL, batch);
         break;
     }
 
     case DHCP_REQUEST:
     {
-        struct dhcp_lease_t *lease = NULL;
+        struct dhcp_lease_t lease;
         struct in_addr req_ip = {0}, server_id = {0};
-        uint8_t *req_ip_opt = dhcp_message_get_option(req, DHCP_OPT_REQUESTED_IP, NULL);
-        uint8_t *sid_opt = dhcp_message_get_option(req, DHCP_OPT_SERVER_ID, NULL);
-
-        if (req_ip_opt)
-            memcpy(&req_ip.s_addr, req_ip_opt, 4);
-        if (sid_opt)
-            memcpy(&server_id.s_addr, sid_opt, 4);
+        uint32_t client_id_len;
+        const uint8_t *client_id = client_id_of(task, &client_id_len);
+        dhcp_options_get_ip(req, &task->options, DHCP_OPT_REQUESTED_IP, &req_ip);
+        bool selecting = dhcp_options_get_ip(req, &task->options, DHCP_OPT_SERVER_ID, &server_id);
 
         // If selecting (SERVER ID present)
-        if (sid_opt)
+        if (selecting)
         {
             // Verify we are the server
             // (skip check for now or match against our IP)
@@ -165,12 +616,12 @@ void packet_processor(void *arg)
             }
             */
 
-            lease = lease_db_find_by_ip(g_server.dhcp.lease_db, req_ip);
-            if (lease && memcmp(lease->mac_address, req->chaddr, 6) == 0)
+            // Confirm the client's lease, unless its address went to someone else
+            if (ip_pool_renew_lease(pool, g_server.dhcp.lease_db, req_ip, req->chaddr, client_id, client_id_len,
+                                    subnet->default_lease_time, &lease) == 0)
             {
-                // Confirm lease
-                lease_db_renew_lease(g_server.dhcp.lease_db, lease->ip_address, subnet->default_lease_time);
-                dhcp_message_make_ack(&res, req, lease, subnet, &g_server.config.global);
+                persist_lease(&lease);
+                size_t len = dhcp_message_make_ack(res, req, &task->options, &lease, subnet, &cfg->config.global);
 
                 if (req->giaddr.s_addr != 0)
                 {
@@ -188,15 +639,16 @@ void packet_processor(void *arg)
                     dest.sin_addr.s_addr = INADDR_BROADCAST;
                 }
 
-                sendto(g_server.sockfd, &res, sizeof(res), 0, (struct sockaddr *)&dest, sizeof(dest));
+                send_reply(task, batch, res, len, &dest);
+                stats_v4_count_message(DHCP_ACK);
                 char ack_ip_buf[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &lease->ip_address, ack_ip_buf, sizeof(ack_ip_buf));
+                inet_ntop(AF_INET, &lease.ip_address, ack_ip_buf, sizeof(ack_ip_buf));
                 log_info(">>> ACK: Confirmed IP %s to client", ack_ip_buf);
             }
             else
             {
                 // Send NAK
-                dhcp_message_make_nak(&res, req, subnet->router); // Use router IP as server ID
+                size_t len = dhcp_message_make_nak(res, req, subnet->router); // Use router IP as server ID
                 if (ip_is_loopback(task->client_addr.sin_addr))
                 {
                     // Loopback - keep original client address AND port
@@ -207,18 +659,21 @@ void packet_processor(void *arg)
                     dest.sin_port = htons(DHCP_CLIENT_PORT);
                     dest.sin_addr.s_addr = INADDR_BROADCAST;
                 }
-                sendto(g_server.sockfd, &res, sizeof(res), 0, (struct sockaddr *)&dest, sizeof(dest));
-                log_info("Sent DHCPNAK for IP %s", inet_ntoa(req_ip));
+                send_reply(task, batch, res, len, &dest);
+                stats_v4_count_message(DHCP_NAK);
+                char ip_str[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &req_ip, ip_str, sizeof(ip_str));
+                log_info("Sent DHCPNAK for IP %s", ip_str);
             }
         }
         // Renewing / Rebinding (Request IP but no Server ID)
         else if (req->ciaddr.s_addr != 0)
         {
-            lease = lease_db_find_by_ip(g_server.dhcp.lease_db, req->ciaddr);
-            if (lease)
+            if (ip_pool_renew_lease(pool, g_server.dhcp.lease_db, req->ciaddr, req->chaddr, client_id,
+                                    client_id_len, subnet->default_lease_time, &lease) == 0)
             {
-                lease_db_renew_lease(g_server.dhcp.lease_db, lease->ip_address, subnet->default_lease_time);
-                dhcp_message_make_ack(&res, req, lease, subnet, &g_server.config.global);
+                persist_lease(&lease);
+                size_t len = dhcp_message_make_ack(res, req, &task->options, &lease, subnet, &cfg->config.global);
 
                 // For loopback testing, keep original port; otherwise use standard port
                 if (ip_is_loopback(task->client_addr.sin_addr))
@@ -226,9 +681,12 @@ void packet_processor(void *arg)
                 else
                     dest.sin_port = htons(DHCP_CLIENT_PORT);
                 dest.sin_addr = req->ciaddr; // Unicast to client
-                sendto(g_server.sockfd, &res, sizeof(res), 0, (struct sockaddr *)&dest, sizeof(dest));
-                log_info("Sent DHCPACK (renewal) for IP %s to %s:%d", inet_ntoa(lease->ip_address),
-                         inet_ntoa(dest.sin_addr), ntohs(dest.sin_port));
+                send_reply(task, batch, res, len, &dest);
+                stats_v4_count_message(DHCP_ACK);
+                char ip_str[INET_ADDRSTRLEN], dest_str[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &lease.ip_address, ip_str, sizeof(ip_str));
+                inet_ntop(AF_INET, &dest.sin_addr, dest_str, sizeof(dest_str));
+                log_info("Sent DHCPACK (renewal) for IP %s to %s:%d", ip_str, dest_str, ntohs(dest.sin_port));
             }
         }
         break;
@@ -237,9 +695,18 @@ void packet_processor(void *arg)
     case DHCP_RELEASE:
         if (req->ciaddr.s_addr != 0)
         {
-            lease_db_release_lease(g_server.dhcp.lease_db, req->ciaddr);
-            ip_pool_release_ip(pool, req->ciaddr);
-            log_info("Released IP %s", inet_ntoa(req->ciaddr));
+            struct dhcp_lease_t lease;
+            char ip_str[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &req->ciaddr, ip_str, sizeof(ip_str));
+            if (ip_pool_release_lease(pool, g_server.dhcp.lease_db, req->ciaddr, req->chaddr, &lease) == 0)
+            {
+                persist_lease(&lease);
+                log_info("Released IP %s", ip_str);
+            }
+            else
+            {
+                log_warn("DHCPRELEASE for IP %s not held by this client, ignored", ip_str);
+            }
         }
         break;
 
@@ -247,8 +714,168 @@ void packet_processor(void *arg)
         log_warn("Unhandled message type: %d", msg_type);
         break;
     }
+}
+
+// Handle one received packet with the configuration generation current when it arrived
+static void process_packet(struct packet_task_t *task, struct reply_batch_t *batch)
+{
+    struct config_version_t *cfg = config_acquire();
+    handle_packet(task, cfg, batch);
+    config_release();
+    stats_v4_record_processing(monotonic_ns() - task->recv_ns);
+}
+
+// Thread pool task: process a packet received by the main loop, then recycle its slot
+void packet_processor(void *arg)
+{
+    struct packet_task_t *task = (struct packet_task_t *)arg;
+    process_packet(task, NULL);
+    packet_pool_release(&g_server.packet_pool, task);
+}
+
+// One line per thread pool worker: how the load spread and how often it had to steal
+static void log_thread_pool_stats(struct thread_pool_t *tpool)
+{
+    struct thread_pool_stats_t stats[MAX_WORKERS];
+    int n = thread_pool_get_stats(tpool, stats, MAX_WORKERS);
+    for (int i = 0; i < n; i++)
+    {
+        log_info("Worker %d: %llu tasks, %llu steals, %llu parks, %.3f s idle", i,
+                 (unsigned long long)stats[i].tasks_run, (unsigned long long)stats[i].steals,
+                 (unsigned long long)stats[i].parks, stats[i].idle_ns / 1e9);
+    }
+}
+
+// Pin the calling thread to one CPU, chosen round-robin by worker id
+static void pin_worker_to_cpu(int worker_id)
+{
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count <= 0)
+        return;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker_id % cpu_count, &cpus);
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0)
+        log_warn("Worker %d: failed to set CPU affinity: %s", worker_id, strerror(err));
+    else
+        log_info("Worker %d pinned to CPU %ld", worker_id, worker_id % cpu_count);
+}
+
+// worker-reuseport mode: receive a batch -> process it -> send all its replies
+// with one sendmmsg() on the worker's own socket. The batch buffers are private
+// to the worker, so nothing is shared on the hot path.
+static void *reuseport_worker(void *arg)
+{
+    struct packet_worker_t *worker = (struct packet_worker_t *)arg;
+
+    if (worker->pin_cpu)
+        pin_worker_to_cpu(worker->id);
+
+    struct packet_task_t *tasks = calloc(PACKET_RECV_BATCH, sizeof(struct packet_task_t));
+    struct reply_batch_t *replies = calloc(1, sizeof(struct reply_batch_t));
+    if (!tasks || !replies)
+    {
+        log_error("Worker %d: failed to allocate receive batch", worker->id);
+        free(tasks);
+        free(replies);
+        return NULL;
+    }
+    replies->sockfd = worker->sockfd;
+
+    struct mmsghdr msgs[PACKET_RECV_BATCH];
+    struct iovec iovecs[PACKET_RECV_BATCH];
+
+    while (g_running)
+    {
+        for (int i = 0; i < PACKET_RECV_BATCH; i++)
+            prepare_recv_msg(&msgs[i], &iovecs[i], &tasks[i]);
+
+        int received = recvmmsg(worker->sockfd, msgs, PACKET_RECV_BATCH, MSG_WAITFORONE, NULL);
+        if (received < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+                continue;
+            log_error("Worker %d: recvmmsg: %s", worker->id, strerror(errno));
+            break;
+        }
+        stats_v4_add(&stats_v4_slot()->pkt_received, (uint64_t)received);
+
+        for (int i = 0; i < received; i++)
+        {
+            complete_recv_msg(&tasks[i], &msgs[i], worker->sockfd);
+            process_packet(&tasks[i], replies);
+        }
+        flush_replies(replies);
+    }
+
+    free(replies);
+    free(tasks);
+    return NULL;
+}
+
+// Settings read once at startup: a reload that changes them only logs a warning
+static void warn_startup_settings(const struct dhcp_global_options_t *next)
+{
+    const struct dhcp_global_options_t *cur = &g_server.startup;
+    if (next->worker_threads != cur->worker_threads || next->worker_reuseport != cur->worker_reuseport ||
+        next->worker_cpu_affinity != cur->worker_cpu_affinity)
+        log_warn("Reload: packet worker settings changed, restart to apply");
+    if (next->lease_io_queue_size != cur->lease_io_queue_size ||
+        next->lease_io_backpressure != cur->lease_io_backpressure)
+        log_warn("Reload: lease I/O queue settings changed, restart to apply");
+    if (next->ping_check && !g_server.prober_running)
+        log_warn("Reload: ping-check enabled but the conflict prober is not running, restart to start it");
+}
+
+// SIGHUP: parse the configuration file into a new generation, give it its
+// pools (keeping those of unchanged subnets), publish it with one pointer
+// swap and free the previous generation once no reader can still hold it.
+// Runs off the packet path (a pool worker or the idle main thread); packet
+// workers never wait for it.
+static void reload_config(void)
+{
+    struct config_version_t *current = atomic_load(&g_server.config);
+    log_info("Reloading configuration from %s", g_server.config_file);
+
+    struct config_version_t *next = config_version_load(g_server.config_file);
+    if (!next)
+    {
+        log_error("Reload failed: cannot parse %s, keeping generation %lu", g_server.config_file,
+                  (unsigned long)current->generation);
+        return;
+    }
+    if (config_version_attach_pools(next, current, g_server.dhcp.lease_db) != 0)
+    {
+        log_error("Reload failed: cannot build IP pools, keeping generation %lu", (unsigned long)current->generation);
+        config_version_free(next);
+        return;
+    }
+    warn_startup_settings(&next->config.global);
 
-    free(task);
+    atomic_store(&g_server.config, next);
+    epoch_synchronize(&g_server.config_epoch);
+
+    // Nobody uses the old generation now; leases committed through its pools
+    // while the new ones were being built are picked up, then it goes
+    config_version_resync(next, g_server.dhcp.lease_db);
+    config_version_free(current);
+
+    int rebuilt = 0;
+    for (int i = 0; i < next->pool_count; i++)
+        rebuilt += next->pool_rebuilt[i];
+    log_info("Configuration generation %lu active: %d subnets (%d pools kept, %d built)",
+             (unsigned long)next->generation, next->pool_count, next->pool_count - rebuilt, rebuilt);
+}
+
+// Thread pool task wrapping reload_config()
+static void reload_task(void *arg)
+{
+    (void)arg;
+    reload_config();
+    atomic_flag_clear(&g_server.reload_busy);
 }
 
 int main(int argc, char *argv[])
@@ -262,47 +889,89 @@ int main(int argc, char *argv[])
     log_info("  interface: bind to specific interface (e.g., vmnet1, eth0)");
 
     // 1. Initialize Signal Handlers
-    signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal);
+    // No SA_RESTART: a signal must interrupt the blocking receive in the main thread.
+    // SIGINT/SIGTERM/SIGHUP stay blocked in every helper thread (they inherit this
+    // mask) and are unblocked in the main thread once all threads are running.
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
 
-    // 2. Load Configuration
-    const char *config_file = SERVER_CONFIG_FILE;
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+    // 2. Load Configuration (generation 1; SIGHUP builds the next ones)
+    g_server.config_file = SERVER_CONFIG_FILE;
     if (argc > 1)
-        config_file = argv[1];
+        g_server.config_file = argv[1];
 
-    if (parse_config_file(config_file, &g_server.config) != 0)
+    epoch_domain_init(&g_server.config_epoch);
+    atomic_flag_clear(&g_server.reload_busy);
+    struct config_version_t *initial = config_version_load(g_server.config_file);
+    if (!initial)
     {
         log_error("Failed to load configuration");
         close_logger();
         return 1;
     }
-    print_config(&g_server.config);
+    print_config(&initial->config);
+    g_server.startup = initial->config.global;
 
     // 3. Initialize DHCP server (lease DB + timer + I/O queue)
-    // Timer interval: 60 seconds, async I/O: enabled
-    if (dhcp_server_init(&g_server.dhcp, LEASE_DB_FILE, 60, true) != 0)
+    // Timer interval: 60 seconds, async I/O: enabled, statistics in shared memory
+    open_stats_shm();
+    struct lease_io_config_t io_config = {
+        .queue_size = g_server.startup.lease_io_queue_size,
+        .backpressure = g_server.startup.lease_io_backpressure,
+        .stats = g_server.stats ? &g_server.stats->lease_io : NULL,
+    };
+    if (dhcp_server_init(&g_server.dhcp, LEASE_DB_FILE, 60, &io_config) != 0)
     {
         log_error("Failed to initialize DHCP server");
+        config_version_free(initial);
+        stats_v4_close();
         close_logger();
         return 1;
     }
 
-    // 4. Initialize IP Pools for each subnet
-    g_server.pool_count = g_server.config.subnet_count;
-    for (int i = 0; i < g_server.pool_count; i++)
+    // 4. Initialize IP Pools for each subnet, plus the subnet selection index
+    if (config_version_attach_pools(initial, NULL, g_server.dhcp.lease_db) != 0)
     {
-        ip_pool_init(&g_server.pools[i], &g_server.config.subnets[i], g_server.dhcp.lease_db);
+        log_error("Failed to initialize IP pools");
+        config_version_free(initial);
+        dhcp_server_stop(&g_server.dhcp);
+        stats_v4_close();
+        close_logger();
+        return 1;
     }
+    atomic_store(&g_server.config, initial);
+    log_info("Subnet index built (%d subnets, %u trie nodes)", initial->pool_count, initial->subnet_trie.node_count);
 
-    // 5. Initialize and start IP Pool sync threads (sync every 30 seconds)
-    for (int i = 0; i < g_server.pool_count; i++)
+    if (g_server.startup.ping_check)
     {
-        if (ip_pool_sync_init(&g_server.pool_syncs[i], &g_server.pools[i], g_server.dhcp.lease_db, 30) == 0)
+        if (ping_prober_init(&g_server.prober) == 0)
         {
-            ip_pool_sync_start(&g_server.pool_syncs[i]);
+            if (ping_prober_start(&g_server.prober) == 0)
+                g_server.prober_running = true;
+            else
+                ping_prober_stop(&g_server.prober);
         }
+        if (g_server.prober_running)
+            log_info("ICMP conflict prober started (timeout %us)", g_server.startup.ping_timeout);
+        else
+            log_warn("ICMP conflict probing unavailable (needs CAP_NET_RAW), offering without ping-check");
     }
 
+    // 5. Route lease expiry events to the owning pool (replaces periodic pool/lease re-scans)
+    if (g_server.dhcp.timer)
+        lease_timer_set_expiry_callback(g_server.dhcp.timer, lease_expired, NULL);
+
     // 6. Start DHCP server (timer thread + I/O queue thread)
     if (dhcp_server_start(&g_server.dhcp) != 0)
     {
@@ -310,121 +979,216 @@ int main(int argc, char *argv[])
         close_logger();
         return 1;
     }
-
-    // 7. Initialize Worker Thread Pool
-    struct thread_pool_t *tpool = thread_pool_create(4, 1024);
-    if (!tpool)
+    if (g_server.stats)
     {
-        log_error("Failed to create thread pool");
-        close_logger();
-        return 1;
+        if (pthread_create(&g_server.stats_thread, NULL, stats_publisher, NULL) == 0)
+            g_server.stats_thread_running = true;
+        else
+            log_warn("Failed to start statistics thread, pool usage will not be published");
     }
-    log_info("Thread pool initialized with 4 workers");
 
-    // 8. Bind Socket
-    if ((g_server.sockfd = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+    const char *interface = (argc > 2) ? argv[2] : NULL;
+    uint32_t worker_count = g_server.startup.worker_threads;
+    if (worker_count == 0)
+        worker_count = 1;
+    if (worker_count > MAX_WORKERS)
     {
-        perror("socket");
-        return 1;
+        log_warn("worker-threads %u exceeds limit, using %d", worker_count, MAX_WORKERS);
+        worker_count = MAX_WORKERS;
     }
 
-    int broadcast_on = 1;
-    setsockopt(g_server.sockfd, SOL_SOCKET, SO_BROADCAST, &broadcast_on,
-               sizeof(broadcast_on));
-
-    int reuse_addr = 1;
-    setsockopt(g_server.sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr,
-               sizeof(reuse_addr));
+    struct thread_pool_t *tpool = NULL;
+    struct packet_worker_t workers[MAX_WORKERS] = {0};
+    struct packet_task_t *batch[PACKET_RECV_BATCH] = {0};
 
-    // Bind to specific interface if provided (argv[2])
-    // This is CRITICAL for systems with multiple interfaces to ensure
-    // broadcast replies go out the correct interface
-    if (argc > 2)
+    // 7. Bind Socket(s)
+    // worker-reuseport: one SO_REUSEPORT socket per worker, otherwise a single shared socket
+    uint32_t socket_count = g_server.startup.worker_reuseport ? worker_count : 1;
+    uint16_t port = DHCP_SERVER_PORT;
+    for (uint32_t i = 0; i < socket_count; i++)
     {
-        const char *interface = argv[2];
-        if (setsockopt(g_server.sockfd, SOL_SOCKET, SO_BINDTODEVICE,
-                       interface, strlen(interface) + 1) < 0)
+        workers[i].id = (int)i;
+        workers[i].sockfd = open_server_socket(interface, port, g_server.startup.worker_reuseport);
+        if (workers[i].sockfd < 0 && i == 0 && port == DHCP_SERVER_PORT)
         {
-            log_error("Failed to bind to interface %s: %s", interface, strerror(errno));
-            log_info("Note: SO_BINDTODEVICE requires root/CAP_NET_RAW");
-            close(g_server.sockfd);
-            close_logger();
-            return 1;
+            log_info("Trying to bind to non-privileged port %d for testing...", FALLBACK_SERVER_PORT);
+            port = FALLBACK_SERVER_PORT;
+            workers[i].sockfd = open_server_socket(interface, port, g_server.startup.worker_reuseport);
+        }
+        if (workers[i].sockfd < 0)
+        {
+            log_error("Failed to open server socket %u", i);
+            socket_count = i;
+            g_running = 0;
+            goto cleanup;
         }
-        log_info("Socket bound to interface: %s", interface);
     }
+    g_server.sockfd = workers[0].sockfd;
+    if (interface)
+        log_info("Socket(s) bound to interface: %s", interface);
+    log_info("Server listening on port %d (%u socket%s)...", port, socket_count, socket_count > 1 ? "s" : "");
 
-    struct sockaddr_in server_addr = {0};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(DHCP_SERVER_PORT);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-
-    if (bind(g_server.sockfd, (struct sockaddr *)&server_addr,
-             sizeof(server_addr)) < 0)
+    if (g_server.startup.worker_reuseport)
     {
-        log_warn("Failed to bind port 67: %s (needs root/CAP_NET_BIND_SERVICE)", strerror(errno));
-        log_info("Trying to bind to non-privileged port 6767 for testing...");
-        server_addr.sin_port = htons(6767); // Fallback
-        if (bind(g_server.sockfd, (struct sockaddr *)&server_addr,
-                 sizeof(server_addr)) < 0)
+        // 8. Start per-core workers, each running its own receive loop
+        for (uint32_t i = 0; i < worker_count; i++)
+        {
+            workers[i].pin_cpu = g_server.startup.worker_cpu_affinity;
+            if (pthread_create(&workers[i].thread, NULL, reuseport_worker, &workers[i]) != 0)
+            {
+                log_error("Failed to start worker %u", i);
+                g_running = 0;
+                goto cleanup;
+            }
+            workers[i].started = true;
+        }
+        log_info("Started %u SO_REUSEPORT workers%s", worker_count,
+                 g_server.startup.worker_cpu_affinity ? " (CPU pinned)" : "");
+
+        // 9. Main thread only waits for signals: stop, or reload the configuration.
+        // The signals stay blocked outside sigsuspend(), so none slips in between.
+        sigset_t wait_mask;
+        pthread_sigmask(SIG_BLOCK, NULL, &wait_mask);
+        sigdelset(&wait_mask, SIGINT);
+        sigdelset(&wait_mask, SIGTERM);
+        sigdelset(&wait_mask, SIGHUP);
+        while (g_running)
         {
-            log_error("Failed to bind fallback port 6767: %s", strerror(errno));
-            close_logger();
-            return 1;
+            sigsuspend(&wait_mask);
+            if (g_running && dhcp_server_check_reload(&g_server.dhcp))
+                reload_config();
         }
+        goto cleanup;
+    }
+
+    // 8. Initialize packet slab and Worker Thread Pool
+    if (packet_pool_init(&g_server.packet_pool, PACKET_POOL_SIZE) != 0)
+    {
+        log_error("Failed to allocate packet pool");
+        goto cleanup;
+    }
+
+    tpool = thread_pool_create((int)worker_count, 1024);
+    if (!tpool)
+    {
+        log_error("Failed to create thread pool");
+        goto cleanup;
     }
-    log_info("Server listening on port %d...", ntohs(server_addr.sin_port));
+    log_info("Thread pool initialized with %u workers", worker_count);
+    pthread_sigmask(SIG_UNBLOCK, &stop_signals, NULL);
 
     // 9. Main Loop
+    // Each recvmmsg() call fills up to PACKET_RECV_BATCH preallocated slots;
+    // slots not filled by a call stay owned by the loop for the next one.
+    struct mmsghdr msgs[PACKET_RECV_BATCH];
+    struct iovec iovecs[PACKET_RECV_BATCH];
+
     while (g_running)
     {
-        struct packet_task_t *task = malloc(sizeof(struct packet_task_t));
-        if (!task)
+        // SIGHUP interrupted the receive: rebuild the configuration on a pool worker
+        if (dhcp_server_check_reload(&g_server.dhcp))
         {
-            usleep(10000); // Backoff on OOM
-            continue;
+            if (atomic_flag_test_and_set(&g_server.reload_busy))
+                log_warn("Configuration reload already running, SIGHUP ignored");
+            else if (thread_pool_add(tpool, reload_task, NULL) != 0)
+            {
+                atomic_flag_clear(&g_server.reload_busy);
+                log_warn("Thread pool full, configuration reload skipped");
+            }
         }
 
-        socklen_t addr_len = sizeof(task->client_addr);
-        task->len = recvfrom(g_server.sockfd, &task->packet, sizeof(struct dhcp_packet), 0,
-                             (struct sockaddr *)&task->client_addr, &addr_len);
+        int ready = 0;
+        for (int i = 0; i < PACKET_RECV_BATCH; i++)
+        {
+            if (!batch[i])
+                batch[i] = packet_pool_acquire(&g_server.packet_pool);
+            if (!batch[i])
+                continue;
 
-        if (task->len < 0)
+            // Compact acquired slots to the front so msgs[] maps 1:1 onto batch[]
+            struct packet_task_t *task = batch[i];
+            batch[i] = NULL;
+            batch[ready] = task;
+
+            prepare_recv_msg(&msgs[ready], &iovecs[ready], task);
+            ready++;
+        }
+
+        if (ready == 0)
         {
-            free(task);
-            if (errno == EINTR)
+            usleep(1000); // Backoff: every slot is still queued or being processed
+            continue;
+        }
+
+        // MSG_WAITFORONE: block for the first datagram, then drain without blocking
+        int received = recvmmsg(g_server.sockfd, msgs, ready, MSG_WAITFORONE, NULL);
+        if (received < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
                 continue;
-            perror("recvfrom");
+            perror("recvmmsg");
             break;
         }
+        stats_v4_add(&stats_v4_slot()->pkt_received, (uint64_t)received);
 
-        // Dispatch to thread pool
-        if (thread_pool_add(tpool, packet_processor, task) != 0)
+        for (int i = 0; i < received; i++)
+            complete_recv_msg(batch[i], &msgs[i], g_server.sockfd);
+
+        // Dispatch the whole batch to the thread pool with one wakeup
+        int queued = thread_pool_add_batch(tpool, packet_processor, (void *const *)batch, received);
+        if (queued < received)
         {
-            log_warn("Failed to add task to pool (queue full), dropping packet");
-            free(task);
+            log_warn("Failed to add %d task(s) to pool (queue full), dropping packet(s)",
+                     received - (queued < 0 ? 0 : queued));
+            stats_v4_add(&stats_v4_slot()->pkt_dropped, (uint64_t)(received - (queued < 0 ? 0 : queued)));
+            for (int i = queued < 0 ? 0 : queued; i < received; i++)
+                packet_pool_release(&g_server.packet_pool, batch[i]);
         }
+
+        // Keep unfilled slots for the next call, shifted down over the consumed ones
+        memmove(&batch[0], &batch[received], (ready - received) * sizeof(batch[0]));
+        memset(&batch[ready - received], 0, (PACKET_RECV_BATCH - (ready - received)) * sizeof(batch[0]));
     }
 
+cleanup:
     // 10. Cleanup
     log_info("Shutting down...");
-    thread_pool_destroy(tpool, 0);
-    close(g_server.sockfd);
-
-    // Stop sync threads first
-    for (int i = 0; i < g_server.pool_count; i++)
+    g_running = 0;
+    for (uint32_t i = 0; i < worker_count; i++)
     {
-        ip_pool_sync_stop(&g_server.pool_syncs[i]);
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
     }
-
-    // Free IP pools
-    for (int i = 0; i < g_server.pool_count; i++)
+    if (tpool)
+    {
+        log_thread_pool_stats(tpool);
+        thread_pool_destroy(tpool, 0);
+    }
+    if (g_server.stats_thread_running)
+        pthread_join(g_server.stats_thread, NULL);
+    // Parked OFFERs use the sockets and pools, so the prober goes before both
+    if (g_server.prober_running)
+        ping_prober_stop(&g_server.prober);
+    for (int i = 0; i < PACKET_RECV_BATCH; i++)
     {
-        ip_pool_free(&g_server.pools[i]);
+        if (batch[i])
+            packet_pool_release(&g_server.packet_pool, batch[i]);
     }
+    for (uint32_t i = 0; i < socket_count; i++)
+    {
+        close(workers[i].sockfd);
+    }
+    packet_pool_free(&g_server.packet_pool);
+
+    // The timer reports expiries into the pools: stop it before they go
+    lease_timer_stop(g_server.dhcp.timer);
+
+    // Free the configuration generation with its IP pools; every reader is gone
+    config_version_free(atomic_exchange(&g_server.config, NULL));
 
     // Stop DHCP server (stops timer, I/O queue, saves & frees lease DB)
     dhcp_server_stop(&g_server.dhcp);
+    stats_v4_close();
 
     log_info("Server stopped.");
     close_logger();
@@ -1,3 +1,4 @@
+#include <arpa/inet.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,22 +10,253 @@
 
 #include "../include/src/shm_stats.h"
 
+// Sum of every thread slot, taken once per refresh
+struct totals_t
+{
+    uint64_t pkt_received;
+    uint64_t pkt_processed;
+    uint64_t pkt_invalid;
+    uint64_t pkt_dropped;
+    uint64_t pkt_no_subnet;
+    uint64_t errors;
+    uint64_t msg_count[SHM_STATS_MSG_TYPES];
+    uint64_t processing_ns_hist[SHM_STATS_HDR_BUCKETS];
+};
+
+static const char *const msg_names[SHM_STATS_MSG_TYPES] = {
+    "Other", "DISCOVER", "OFFER", "REQUEST", "DECLINE", "ACK", "NAK", "RELEASE", "INFORM",
+};
+
 void clrscr()
 {
     printf("\033[H\033[J");
 }
 
-int main()
+static uint64_t load(const volatile uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static uint32_t thread_count(const struct server_v4_stats_t *stats)
+{
+    uint32_t n = __atomic_load_n(&stats->thread_count, __ATOMIC_RELAXED);
+    return n < SHM_STATS_MAX_THREADS ? n : SHM_STATS_MAX_THREADS;
+}
+
+static void collect(const struct server_v4_stats_t *stats, struct totals_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    uint32_t n = thread_count(stats);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const struct worker_stats_v4_t *w = &stats->threads[i];
+        t->pkt_received += load(&w->pkt_received);
+        t->pkt_processed += load(&w->pkt_processed);
+        t->pkt_invalid += load(&w->pkt_invalid);
+        t->pkt_dropped += load(&w->pkt_dropped);
+        t->pkt_no_subnet += load(&w->pkt_no_subnet);
+        t->errors += load(&w->errors);
+        for (int m = 0; m < SHM_STATS_MSG_TYPES; m++)
+            t->msg_count[m] += load(&w->msg_count[m]);
+        for (int b = 0; b < SHM_STATS_HDR_BUCKETS; b++)
+            t->processing_ns_hist[b] += load(&w->processing_ns_hist[b]);
+    }
+}
+
+// Consistent copy of the subnet table (the server rewrites it on every refresh)
+static uint32_t copy_subnets(const struct server_v4_stats_t *stats, struct subnet_stats_v4_t *out)
+{
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&stats->subnet_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            usleep(100);
+            continue;
+        }
+        uint32_t count = __atomic_load_n(&stats->subnet_count, __ATOMIC_RELAXED);
+        if (count > SHM_STATS_MAX_SUBNETS)
+            count = SHM_STATS_MAX_SUBNETS;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const struct subnet_stats_v4_t *s = &stats->subnets[i];
+            out[i].network = __atomic_load_n(&s->network, __ATOMIC_RELAXED);
+            out[i].prefix_len = __atomic_load_n(&s->prefix_len, __ATOMIC_RELAXED);
+            out[i].pool_size = __atomic_load_n(&s->pool_size, __ATOMIC_RELAXED);
+            out[i].allocated = __atomic_load_n(&s->allocated, __ATOMIC_RELAXED);
+            out[i].available = __atomic_load_n(&s->available, __ATOMIC_RELAXED);
+            out[i].reserved = __atomic_load_n(&s->reserved, __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&stats->subnet_seq, __ATOMIC_RELAXED) == seq)
+            return count;
+    }
+}
+
+// Duration in the most readable unit
+static void format_ns(char *buf, size_t len, uint64_t ns)
+{
+    if (ns < 10000)
+        snprintf(buf, len, "%lu ns", ns);
+    else if (ns < 10000000)
+        snprintf(buf, len, "%.1f us", ns / 1e3);
+    else if (ns < 10000000000ull)
+        snprintf(buf, len, "%.1f ms", ns / 1e6);
+    else
+        snprintf(buf, len, "%.1f s", ns / 1e9);
+}
+
+// Upper bound of the HDR bucket holding quantile q, 0 if the histogram is empty
+static uint64_t hdr_percentile(const uint64_t *hist, uint64_t total, double q)
+{
+    if (total == 0)
+        return 0;
+    uint64_t rank = q < 1.0 ? (uint64_t)(q * total) : total - 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < SHM_STATS_HDR_BUCKETS - 1; b++)
+    {
+        seen += hist[b];
+        if (seen > rank)
+            return shm_stats_hdr_lower(b + 1) - 1;
+    }
+    return shm_stats_hdr_lower(SHM_STATS_HDR_BUCKETS - 1);
+}
+
+static void print_latency(const char *title, const uint64_t *hist)
+{
+    uint64_t total = 0;
+    for (int b = 0; b < SHM_STATS_HDR_BUCKETS; b++)
+        total += hist[b];
+
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    static const char *const labels[] = {"p50", "p90", "p99", "p99.9", "max"};
+    printf("%-22s %lu samples\n", title, total);
+    if (total == 0)
+        return;
+    printf(" ");
+    for (int i = 0; i < 5; i++)
+    {
+        char buf[32];
+        format_ns(buf, sizeof(buf), hdr_percentile(hist, total, quantiles[i]));
+        printf(" %s <= %s", labels[i], buf);
+    }
+    printf("\n");
+}
+
+// One line per non-empty log2 bucket, labelled with its upper bound
+static void print_histogram(const char *title, const char *unit, const volatile uint64_t *hist)
+{
+    printf("%s\n", title);
+    for (int i = 0; i < SHM_STATS_HIST_BUCKETS; i++)
+    {
+        if (hist[i] == 0)
+            continue;
+        if (i == SHM_STATS_HIST_BUCKETS - 1)
+            printf("  >= %-10lu %-3s %lu\n", (uint64_t)1 << (i - 1), unit, hist[i]);
+        else
+            printf("  <  %-10lu %-3s %lu\n", (uint64_t)1 << i, unit, hist[i]);
+    }
+}
+
+static void render(const struct server_v4_stats_t *stats, const struct totals_t *now, const struct totals_t *prev,
+                   double interval)
+{
+    time_t start_time = stats->start_time;
+    double uptime = difftime(time(NULL), start_time);
+
+    printf("========================================\n");
+    printf("   DHCPv4 Server Live Dashboard (SHM)   \n");
+    printf("========================================\n");
+    printf("Uptime:          %.0f sec\n", uptime);
+    printf("Start Time:      %s", ctime(&start_time));
+    printf("Config:          generation %lu\n", (uint64_t)__atomic_load_n(&stats->config_generation, __ATOMIC_RELAXED));
+    printf("----------------------------------------\n");
+    printf("Packets RX:      %lu (%.0f/s)\n", now->pkt_received,
+           prev ? (now->pkt_received - prev->pkt_received) / interval : 0.0);
+    printf("Packets Proc:    %lu (%.0f/s)\n", now->pkt_processed,
+           prev ? (now->pkt_processed - prev->pkt_processed) / interval : 0.0);
+    printf("Invalid:         %lu\n", now->pkt_invalid);
+    printf("Dropped:         %lu (no subnet: %lu)\n", now->pkt_dropped, now->pkt_no_subnet);
+    printf("Errors:          %lu\n", now->errors);
+    printf("Active Leases:   %lu\n", (uint64_t)__atomic_load_n(&stats->leases_active, __ATOMIC_RELAXED));
+    printf("----------------------------------------\n");
+    printf("Messages:\n");
+    for (int m = 1; m <= SHM_STATS_MSG_TYPES; m++)
+    {
+        int type = m % SHM_STATS_MSG_TYPES; // "Other" last
+        if (type == 0 && now->msg_count[0] == 0)
+            continue;
+        printf("  %-9s %12lu (%.0f/s)\n", msg_names[type], now->msg_count[type],
+               prev ? (now->msg_count[type] - prev->msg_count[type]) / interval : 0.0);
+    }
+    print_latency("Packet processing:", now->processing_ns_hist);
+
+    uint32_t threads = thread_count(stats);
+    printf("Threads (%u):\n", threads);
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        const struct worker_stats_v4_t *w = &stats->threads[i];
+        printf("  [%2u] rx %-10lu processed %lu\n", i, load(&w->pkt_received), load(&w->pkt_processed));
+    }
+    printf("----------------------------------------\n");
+
+    struct subnet_stats_v4_t subnets[SHM_STATS_MAX_SUBNETS];
+    uint32_t subnet_count = copy_subnets(stats, subnets);
+    printf("Pools:\n");
+    for (uint32_t i = 0; i < subnet_count; i++)
+    {
+        const struct subnet_stats_v4_t *s = &subnets[i];
+        char network[INET_ADDRSTRLEN];
+        struct in_addr addr = {.s_addr = s->network};
+        inet_ntop(AF_INET, &addr, network, sizeof(network));
+        printf("  %15s/%-2u %5.1f%% used  %u allocated, %u free, %u other of %u\n", network, s->prefix_len,
+               s->pool_size ? 100.0 * s->allocated / s->pool_size : 0.0, s->allocated, s->available, s->reserved,
+               s->pool_size);
+    }
+    printf("----------------------------------------\n");
+
+    const struct io_queue_stats_t *io = &stats->lease_io;
+    printf("Lease I/O ring:  %u slots\n", io->capacity);
+    printf("  Depth:         %lu\n", load(&io->depth));
+    printf("  Enqueued:      %lu\n", io->enqueued);
+    printf("  Committed:     %lu (%lu batches)\n", io->committed, io->batches);
+    printf("  Pending:       %lu\n", io->enqueued - io->committed);
+    printf("  Coalesced:     %lu\n", io->coalesced);
+    printf("  Dropped:       %lu\n", io->dropped);
+    printf("  Blocked:       %lu\n", io->blocked);
+    print_histogram("Queue depth per batch:", "", io->depth_hist);
+    print_histogram("Enqueue -> durable latency:", "us", io->latency_us_hist);
+
+    uint64_t fsync_hist[SHM_STATS_HDR_BUCKETS];
+    for (int b = 0; b < SHM_STATS_HDR_BUCKETS; b++)
+        fsync_hist[b] = load(&io->fsync_ns_hist[b]);
+    print_latency("Journal commit (fsync):", fsync_hist);
+    printf("========================================\n");
+}
+
+int main(int argc, char *argv[])
 {
+    // --once: print a single snapshot and exit (for scripts)
+    int once = argc > 1 && strcmp(argv[1], "--once") == 0;
+
     // 1. Open the shared memory read-only (we only want to watch not edit)
-    int fd = shm_open(SHM_STATS_V4_NAME, O_RDONLY | O_CREAT, 0666);
+    int fd = shm_open(SHM_STATS_V4_NAME, O_RDONLY, 0);
     if (fd < 0)
     {
-        fprintf(stderr, "Failed to open SHM '%s'. Is server running?\nError: %s\n", 
+        fprintf(stderr, "Failed to open SHM '%s'. Is server running?\nError: %s\n",
                 SHM_STATS_V4_NAME, strerror(errno));
         return -1;
     }
 
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct server_v4_stats_t))
+    {
+        fprintf(stderr, "SHM '%s' is %ld bytes, expected %zu: server and monitor are from different builds\n",
+                SHM_STATS_V4_NAME, (long)st.st_size, sizeof(struct server_v4_stats_t));
+        close(fd);
+        return -1;
+    }
+
     // 2. Map it to our memory space
     // Now 'stats' points directly to the server's live data in RAM.
     struct server_v4_stats_t* stats = mmap(NULL, sizeof(struct server_v4_stats_t), PROT_READ, MAP_SHARED, fd, 0);
@@ -35,32 +267,62 @@ int main()
         return -1;
     }
 
-    printf("Connected to DHCPv4 Server Dashboard.\n");
-    sleep(1);
-
-    while(1)
-    {
-        clrscr();
-        time_t now = time(NULL);
-        double uptime = difftime(now, stats->start_time);
-        
-        printf("========================================\n");
-        printf("   DHCPv4 Server Live Dashboard (SHM)   \n");
-        printf("========================================\n");
-        printf("Uptime:          %.0f sec\n", uptime);
-        printf("Start Time:      %s", ctime(&stats->start_time));
-        printf("----------------------------------------\n");
-        printf("Packets RX:      %lu\n", stats->pkt_received);
-        printf("Packets Proc:    %lu\n", stats->pkt_processed);
-        printf("Active Leases:   %lu\n", stats->leases_active);
-        printf("Errors:          %lu\n", stats->errors_count);
-        printf("========================================\n");
+    // 3. Check the layout; a zero magic means the server is still setting it up
+    for (int i = 0; __atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) != SHM_STATS_V4_MAGIC; i++)
+    {
+        if (i == 20)
+        {
+            fprintf(stderr, "SHM '%s' is not a DHCPv4 statistics segment\n", SHM_STATS_V4_NAME);
+            munmap(stats, sizeof(struct server_v4_stats_t));
+            close(fd);
+            return -1;
+        }
+        usleep(100 * 1000);
+    }
+    if (stats->version != SHM_STATS_V4_VERSION || stats->size != sizeof(struct server_v4_stats_t))
+    {
+        fprintf(stderr, "SHM '%s' has layout version %u (%lu bytes), this monitor reads version %u (%zu bytes)\n",
+                SHM_STATS_V4_NAME, stats->version, stats->size, SHM_STATS_V4_VERSION,
+                sizeof(struct server_v4_stats_t));
+        munmap(stats, sizeof(struct server_v4_stats_t));
+        close(fd);
+        return -1;
+    }
+
+    // Two totals, swapped every refresh, for the per-second rates
+    struct totals_t *totals = calloc(2, sizeof(struct totals_t));
+    if (!totals)
+    {
+        perror("calloc");
+        munmap(stats, sizeof(struct server_v4_stats_t));
+        close(fd);
+        return -1;
+    }
+
+    if (!once)
+    {
+        printf("Connected to DHCPv4 Server Dashboard.\n");
+        sleep(1);
+    }
+
+    for (int tick = 0;; tick++)
+    {
+        struct totals_t *now = &totals[tick & 1];
+        struct totals_t *prev = tick > 0 ? &totals[(tick - 1) & 1] : NULL;
+        collect(stats, now);
+
+        if (!once)
+            clrscr();
+        render(stats, now, prev, 1.0);
+        if (once)
+            break;
         printf("Press Ctrl+C to exit monitor.\n");
-        
+
         sleep(1);
     }
 
+    free(totals);
     munmap(stats, sizeof(struct server_v4_stats_t));
     close(fd);
     return 0;
-}
\ No newline at end of file
+}
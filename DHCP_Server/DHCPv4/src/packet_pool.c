@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/packet_pool.h"
+
+static inline uint32_t head_index(uint64_t head)
+{
+    return (uint32_t)(head & 0xFFFFFFFFu);
+}
+
+static inline uint64_t make_head(uint64_t old_head, uint32_t index)
+{
+    // Bump the generation tag on every successful CAS to defeat ABA
+    return (((old_head >> 32) + 1) << 32) | index;
+}
+
+int packet_pool_init(struct packet_pool_t *pool, uint32_t capacity)
+{
+    if (!pool || capacity == 0 || capacity >= PACKET_POOL_NIL)
+        return -1;
+
+    memset(pool, 0, sizeof(struct packet_pool_t));
+
+    pool->slots = calloc(capacity, sizeof(struct packet_task_t));
+    if (!pool->slots)
+    {
+        perror("Failed to allocate packet pool");
+        return -1;
+    }
+    pool->capacity = capacity;
+
+    // Chain every slot: 0 -> 1 -> ... -> capacity-1 -> NIL
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        pool->slots[i].next = (i + 1 < capacity) ? i + 1 : PACKET_POOL_NIL;
+    }
+    pool->free_head = 0;
+
+    return 0;
+}
+
+void packet_pool_free(struct packet_pool_t *pool)
+{
+    if (pool)
+    {
+        free(pool->slots);
+        memset(pool, 0, sizeof(struct packet_pool_t));
+    }
+}
+
+struct packet_task_t *packet_pool_acquire(struct packet_pool_t *pool)
+{
+    if (!pool || !pool->slots)
+        return NULL;
+
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        uint32_t index = head_index(head);
+        if (index == PACKET_POOL_NIL)
+        {
+            __atomic_fetch_add(&pool->exhausted_count, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+
+        // Reading next of a slot another thread may pop concurrently is fine:
+        // the tagged CAS below fails if the head moved in the meantime.
+        uint32_t next = __atomic_load_n(&pool->slots[index].next, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&pool->free_head, &head, make_head(head, next), true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return &pool->slots[index];
+        }
+    }
+}
+
+void packet_pool_release(struct packet_pool_t *pool, struct packet_task_t *task)
+{
+    if (!pool || !task)
+        return;
+
+    uint32_t index = (uint32_t)(task - pool->slots);
+    if (index >= pool->capacity)
+        return; // Not one of ours
+
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+    do
+    {
+        __atomic_store_n(&task->next, head_index(head), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &head, make_head(head, index), true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,382 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/src/ping_probe.h"
+
+#define SLOT_MASK (PING_PROBE_MAX - 1)
+#define GENERATION_MASK ((1u << (16 - PING_PROBE_SLOT_BITS)) - 1)
+
+static uint16_t icmp_checksum(void *data, int len)
+{
+    uint16_t *buf = (uint16_t *)data;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2)
+    {
+        sum += *buf++;
+    }
+
+    if (len == 1)
+    {
+        sum += *(uint8_t *)buf;
+    }
+
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum += (sum >> 16);
+
+    return ~sum;
+}
+
+static uint64_t now_tick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / PING_PROBE_TICK_MS;
+}
+
+//=============================================================================
+// Timer wheel (caller holds prober->mutex)
+//=============================================================================
+
+static void wheel_link(struct ping_prober_t *prober, uint32_t slot)
+{
+    struct ping_probe_t *probe = &prober->probes[slot];
+    uint32_t *head = &prober->wheel[probe->expire_tick % PING_PROBE_WHEEL_SLOTS];
+
+    probe->prev = PING_PROBE_NIL;
+    probe->next = *head;
+    if (*head != PING_PROBE_NIL)
+        prober->probes[*head].prev = slot;
+    *head = slot;
+}
+
+static void wheel_unlink(struct ping_prober_t *prober, uint32_t slot)
+{
+    struct ping_probe_t *probe = &prober->probes[slot];
+
+    if (probe->prev != PING_PROBE_NIL)
+        prober->probes[probe->prev].next = probe->next;
+    else
+        prober->wheel[probe->expire_tick % PING_PROBE_WHEEL_SLOTS] = probe->next;
+    if (probe->next != PING_PROBE_NIL)
+        prober->probes[probe->next].prev = probe->prev;
+}
+
+// Take a probe off the wheel, queue its completion and recycle the slot
+static void finish_probe(struct ping_prober_t *prober, uint32_t slot, ping_probe_result_t result, uint32_t *done)
+{
+    struct ping_probe_t *probe = &prober->probes[slot];
+
+    wheel_unlink(prober, slot);
+
+    struct ping_probe_completion_t *c = &prober->completions[(*done)++];
+    c->cb = probe->cb;
+    c->arg = probe->arg;
+    c->ip = probe->ip;
+    c->result = result;
+
+    probe->active = false;
+    probe->generation = (probe->generation + 1) & GENERATION_MASK;
+    probe->next = prober->free_head;
+    prober->free_head = slot;
+    prober->in_flight--;
+}
+
+// Expire every probe due up to now
+static void advance_wheel(struct ping_prober_t *prober, uint64_t now, uint32_t *done)
+{
+    // After a long stall one lap of the wheel covers every bucket
+    if (now - prober->current_tick > PING_PROBE_WHEEL_SLOTS)
+        prober->current_tick = now - PING_PROBE_WHEEL_SLOTS;
+
+    while (prober->current_tick < now)
+    {
+        prober->current_tick++;
+        uint32_t slot = prober->wheel[prober->current_tick % PING_PROBE_WHEEL_SLOTS];
+        while (slot != PING_PROBE_NIL)
+        {
+            uint32_t next = prober->probes[slot].next;
+            if (prober->probes[slot].expire_tick <= now)
+            {
+                prober->timeouts++;
+                finish_probe(prober, slot, PING_PROBE_FREE, done);
+            }
+            slot = next;
+        }
+    }
+}
+
+//=============================================================================
+// Prober thread
+//=============================================================================
+
+// Match one received datagram against the outstanding probes
+static void handle_reply(struct ping_prober_t *prober, const uint8_t *buf, ssize_t len,
+                         const struct sockaddr_in *from, uint32_t *done)
+{
+    // Raw ICMP sockets deliver the IP header as well
+    if (len < (ssize_t)sizeof(struct iphdr))
+        return;
+    const struct iphdr *ip = (const struct iphdr *)buf;
+    size_t ip_len = (size_t)ip->ihl * 4;
+    if (len < (ssize_t)(ip_len + sizeof(struct icmphdr)))
+        return;
+
+    struct icmphdr icmp;
+    memcpy(&icmp, buf + ip_len, sizeof(icmp));
+    if (icmp.type != ICMP_ECHOREPLY || ntohs(icmp.un.echo.id) != prober->echo_id)
+        return;
+
+    uint16_t seq = ntohs(icmp.un.echo.sequence);
+    uint32_t slot = seq & SLOT_MASK;
+    struct ping_probe_t *probe = &prober->probes[slot];
+
+    if (!probe->active || probe->generation != (seq >> PING_PROBE_SLOT_BITS) ||
+        probe->ip.s_addr != from->sin_addr.s_addr)
+        return; // Late reply to an expired probe, or spoofed
+
+    prober->conflicts++;
+    finish_probe(prober, slot, PING_PROBE_IN_USE, done);
+}
+
+static void *prober_thread_func(void *arg)
+{
+    struct ping_prober_t *prober = (struct ping_prober_t *)arg;
+    uint8_t buf[1500];
+
+    while (1)
+    {
+        pthread_mutex_lock(&prober->mutex);
+        bool running = prober->running;
+        int timeout = prober->in_flight ? PING_PROBE_TICK_MS : PING_PROBE_IDLE_MS;
+        pthread_mutex_unlock(&prober->mutex);
+
+        if (!running)
+            break;
+
+        struct pollfd fds[2] = {
+            {.fd = prober->sockfd, .events = POLLIN},
+            {.fd = prober->wake_fd, .events = POLLIN},
+        };
+        poll(fds, 2, timeout);
+
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t count;
+            if (read(prober->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                perror("ping prober eventfd read");
+        }
+
+        uint32_t done = 0;
+        pthread_mutex_lock(&prober->mutex);
+
+        // Drain replies (the socket is non-blocking)
+        while (done < PING_PROBE_MAX)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t len = recvfrom(prober->sockfd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (len < 0)
+                break;
+            handle_reply(prober, buf, len, &from, &done);
+        }
+
+        advance_wheel(prober, now_tick(), &done);
+        pthread_mutex_unlock(&prober->mutex);
+
+        // Callbacks run unlocked so they can submit follow-up probes
+        for (uint32_t i = 0; i < done; i++)
+        {
+            struct ping_probe_completion_t *c = &prober->completions[i];
+            c->cb(c->arg, c->ip, c->result);
+        }
+    }
+
+    return NULL;
+}
+
+//=============================================================================
+// Public API
+//=============================================================================
+
+int ping_prober_init(struct ping_prober_t *prober)
+{
+    if (!prober)
+        return -1;
+
+    memset(prober, 0, sizeof(struct ping_prober_t));
+    prober->sockfd = -1;
+    prober->wake_fd = -1;
+
+    // Requires root/CAP_NET_RAW
+    prober->sockfd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (prober->sockfd < 0)
+    {
+        perror("Failed to open ICMP probe socket");
+        return -1;
+    }
+
+    prober->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (prober->wake_fd < 0)
+    {
+        perror("Failed to create prober eventfd");
+        close(prober->sockfd);
+        return -1;
+    }
+
+    if (pthread_mutex_init(&prober->mutex, NULL) != 0)
+    {
+        perror("Failed to initialize prober mutex");
+        close(prober->wake_fd);
+        close(prober->sockfd);
+        return -1;
+    }
+    prober->mutex_initialized = true;
+
+    prober->echo_id = (uint16_t)getpid();
+    for (uint32_t i = 0; i < PING_PROBE_MAX; i++)
+        prober->probes[i].next = (i + 1 < PING_PROBE_MAX) ? i + 1 : PING_PROBE_NIL;
+    prober->free_head = 0;
+    for (uint32_t i = 0; i < PING_PROBE_WHEEL_SLOTS; i++)
+        prober->wheel[i] = PING_PROBE_NIL;
+    prober->current_tick = now_tick();
+
+    return 0;
+}
+
+int ping_prober_start(struct ping_prober_t *prober)
+{
+    if (!prober || !prober->mutex_initialized)
+        return -1;
+
+    pthread_mutex_lock(&prober->mutex);
+    if (prober->running)
+    {
+        pthread_mutex_unlock(&prober->mutex);
+        return -1;
+    }
+    prober->running = true;
+    pthread_mutex_unlock(&prober->mutex);
+
+    if (pthread_create(&prober->thread, NULL, prober_thread_func, prober) != 0)
+    {
+        perror("Failed to create prober thread");
+        pthread_mutex_lock(&prober->mutex);
+        prober->running = false;
+        pthread_mutex_unlock(&prober->mutex);
+        return -1;
+    }
+
+    return 0;
+}
+
+void ping_prober_stop(struct ping_prober_t *prober)
+{
+    if (!prober || !prober->mutex_initialized)
+        return;
+
+    pthread_mutex_lock(&prober->mutex);
+    bool was_running = prober->running;
+    prober->running = false;
+    pthread_mutex_unlock(&prober->mutex);
+
+    if (was_running)
+    {
+        uint64_t one = 1;
+        if (write(prober->wake_fd, &one, sizeof(one)) < 0)
+            perror("ping prober eventfd write");
+        pthread_join(prober->thread, NULL);
+    }
+
+    // The thread is gone: cancel whatever is still in flight
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < PING_PROBE_MAX; i++)
+    {
+        if (prober->probes[i].active)
+            finish_probe(prober, i, PING_PROBE_CANCELLED, &done);
+    }
+    for (uint32_t i = 0; i < done; i++)
+    {
+        struct ping_probe_completion_t *c = &prober->completions[i];
+        c->cb(c->arg, c->ip, c->result);
+    }
+
+    close(prober->wake_fd);
+    close(prober->sockfd);
+    pthread_mutex_destroy(&prober->mutex);
+    prober->mutex_initialized = false;
+
+    printf("ICMP prober stopped (sent: %lu, conflicts: %lu, timeouts: %lu, rejected: %lu)\n",
+           prober->probes_sent, prober->conflicts, prober->timeouts, prober->rejected);
+}
+
+int ping_prober_submit(struct ping_prober_t *prober, struct in_addr ip, uint32_t timeout_ms,
+                       ping_probe_cb_t cb, void *arg)
+{
+    if (!prober || !cb || !prober->mutex_initialized)
+        return -1;
+
+    pthread_mutex_lock(&prober->mutex);
+
+    if (!prober->running || prober->free_head == PING_PROBE_NIL)
+    {
+        prober->rejected++;
+        pthread_mutex_unlock(&prober->mutex);
+        return -1;
+    }
+
+    uint32_t slot = prober->free_head;
+    struct ping_probe_t *probe = &prober->probes[slot];
+
+    struct icmphdr icmp;
+    memset(&icmp, 0, sizeof(icmp));
+    icmp.type = ICMP_ECHO;
+    icmp.code = 0;
+    icmp.un.echo.id = htons(prober->echo_id);
+    icmp.un.echo.sequence = htons((uint16_t)((probe->generation << PING_PROBE_SLOT_BITS) | slot));
+    icmp.checksum = icmp_checksum(&icmp, sizeof(icmp));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = ip;
+
+    if (sendto(prober->sockfd, &icmp, sizeof(icmp), 0, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        prober->rejected++;
+        pthread_mutex_unlock(&prober->mutex);
+        return -1;
+    }
+
+    prober->free_head = probe->next;
+    probe->ip = ip;
+    probe->cb = cb;
+    probe->arg = arg;
+    probe->active = true;
+    // Round up, plus one tick so a probe never expires early
+    probe->expire_tick = now_tick() + (timeout_ms + PING_PROBE_TICK_MS - 1) / PING_PROBE_TICK_MS + 1;
+    wheel_link(prober, slot);
+
+    bool was_idle = (prober->in_flight++ == 0);
+    prober->probes_sent++;
+    pthread_mutex_unlock(&prober->mutex);
+
+    // The thread sleeps up to PING_PROBE_IDLE_MS when idle; get it onto the short tick
+    if (was_idle)
+    {
+        uint64_t one = 1;
+        if (write(prober->wake_fd, &one, sizeof(one)) < 0)
+            perror("ping prober eventfd write");
+    }
+
+    return 0;
+}
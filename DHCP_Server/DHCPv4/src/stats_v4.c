@@ -0,0 +1,129 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include/src/stats_v4.h"
+
+_Static_assert(SHM_STATS_MAX_SUBNETS >= MAX_SUBNETS, "subnet table of the stats segment too small");
+
+_Thread_local struct worker_stats_v4_t *stats_v4_thread_slot;
+
+// Slot of a thread that did not get one in the segment
+static _Thread_local struct worker_stats_v4_t private_slot;
+
+static struct server_v4_stats_t *g_stats;
+static int g_stats_fd = -1;
+
+struct server_v4_stats_t *stats_v4_open(void)
+{
+    g_stats_fd = shm_open(SHM_STATS_V4_NAME, O_CREAT | O_RDWR, 0666);
+    if (g_stats_fd < 0)
+    {
+        fprintf(stderr, "shm_open %s failed: %s\n", SHM_STATS_V4_NAME, strerror(errno));
+        return NULL;
+    }
+    if (ftruncate(g_stats_fd, sizeof(struct server_v4_stats_t)) < 0)
+    {
+        fprintf(stderr, "ftruncate %s failed: %s\n", SHM_STATS_V4_NAME, strerror(errno));
+        close(g_stats_fd);
+        g_stats_fd = -1;
+        return NULL;
+    }
+
+    void *stats = mmap(NULL, sizeof(struct server_v4_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED, g_stats_fd, 0);
+    if (stats == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap %s failed: %s\n", SHM_STATS_V4_NAME, strerror(errno));
+        close(g_stats_fd);
+        g_stats_fd = -1;
+        return NULL;
+    }
+
+    // A segment left by a crashed server may be mapped by a monitor: hide it
+    // behind a zero magic while it is reset
+    struct server_v4_stats_t *s = stats;
+    __atomic_store_n(&s->magic, 0, __ATOMIC_RELEASE);
+    memset(s, 0, sizeof(*s));
+    s->version = SHM_STATS_V4_VERSION;
+    s->size = sizeof(*s);
+    s->start_time = time(NULL);
+    __atomic_store_n(&s->magic, SHM_STATS_V4_MAGIC, __ATOMIC_RELEASE);
+
+    g_stats = s;
+    return s;
+}
+
+void stats_v4_close(void)
+{
+    stats_v4_thread_slot = NULL;
+    if (g_stats)
+        munmap(g_stats, sizeof(struct server_v4_stats_t));
+    g_stats = NULL;
+    if (g_stats_fd >= 0)
+    {
+        close(g_stats_fd);
+        shm_unlink(SHM_STATS_V4_NAME);
+    }
+    g_stats_fd = -1;
+}
+
+struct worker_stats_v4_t *stats_v4_claim_slot(void)
+{
+    struct worker_stats_v4_t *slot = &private_slot;
+    if (g_stats)
+    {
+        uint32_t index = __atomic_fetch_add(&g_stats->thread_count, 1, __ATOMIC_RELAXED);
+        if (index < SHM_STATS_MAX_THREADS) // thread_count keeps counting past the end; readers clamp it
+            slot = &g_stats->threads[index];
+    }
+    stats_v4_thread_slot = slot;
+    return slot;
+}
+
+static uint32_t prefix_len(struct in_addr netmask)
+{
+    return (uint32_t)__builtin_popcount(netmask.s_addr);
+}
+
+void stats_v4_publish(const struct config_version_t *version)
+{
+    struct server_v4_stats_t *s = g_stats;
+    if (!s || !version)
+        return;
+
+    uint64_t leases = 0;
+    uint32_t seq = s->subnet_seq;
+    __atomic_store_n(&s->subnet_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint32_t count = (uint32_t)version->pool_count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const struct ip_pool_t *pool = version->pools[i];
+        const struct dhcp_subnet_t *subnet = &version->config.subnets[i];
+        struct subnet_stats_v4_t *out = &s->subnets[i];
+        uint32_t allocated = __atomic_load_n(&pool->allocated_count, __ATOMIC_RELAXED);
+        uint32_t available = __atomic_load_n(&pool->available_count, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&out->network, subnet->network.s_addr, __ATOMIC_RELAXED);
+        __atomic_store_n(&out->prefix_len, prefix_len(subnet->netmask), __ATOMIC_RELAXED);
+        __atomic_store_n(&out->pool_size, pool->pool_size, __ATOMIC_RELAXED);
+        __atomic_store_n(&out->allocated, allocated, __ATOMIC_RELAXED);
+        __atomic_store_n(&out->available, available, __ATOMIC_RELAXED);
+        // The two counters are read apart, so their sum may briefly exceed the pool
+        __atomic_store_n(&out->reserved,
+                         allocated + available < pool->pool_size ? pool->pool_size - allocated - available : 0,
+                         __ATOMIC_RELAXED);
+        leases += allocated;
+    }
+    __atomic_store_n(&s->subnet_count, count, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->config_generation, version->generation, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&s->subnet_seq, seq + 2, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&s->leases_active, leases, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->published_at, time(NULL), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,136 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/src/subnet_trie.h"
+
+// Append an empty node and return its number, or 0 on failure
+static uint32_t new_node(struct subnet_trie_t *trie)
+{
+    if (trie->node_count == trie->node_capacity)
+    {
+        uint32_t capacity = trie->node_capacity ? trie->node_capacity * 2 : 4;
+        struct subnet_trie_node_t *nodes = realloc(trie->nodes, capacity * sizeof(struct subnet_trie_node_t));
+        if (!nodes)
+        {
+            perror("Failed to grow subnet trie");
+            return 0;
+        }
+        trie->nodes = nodes;
+        trie->node_capacity = capacity;
+    }
+
+    struct subnet_trie_node_t *node = &trie->nodes[trie->node_count];
+    for (uint32_t i = 0; i < SUBNET_TRIE_FANOUT; i++)
+    {
+        node->slots[i].subnet = -1;
+        node->slots[i].prefix_len = 0;
+        node->slots[i].child = 0;
+    }
+    return trie->node_count++;
+}
+
+static int insert(struct subnet_trie_t *trie, uint32_t prefix, uint8_t prefix_len, int32_t subnet)
+{
+    uint32_t node = 0;
+
+    for (uint32_t level = 0;; level++)
+    {
+        uint32_t level_end = (level + 1) * SUBNET_TRIE_STRIDE; // Bits resolved after this level
+        uint32_t byte = (prefix >> (32 - level_end)) & (SUBNET_TRIE_FANOUT - 1);
+
+        if (prefix_len <= level_end)
+        {
+            // Prefix ends in this node: expand it over every slot it covers.
+            // Longer prefixes keep their slots; equal ones keep the first subnet.
+            uint32_t span = 1u << (level_end - prefix_len);
+            byte &= ~(span - 1);
+            for (uint32_t i = byte; i < byte + span; i++)
+            {
+                struct subnet_trie_slot_t *slot = &trie->nodes[node].slots[i];
+                if (slot->subnet < 0 || slot->prefix_len < prefix_len)
+                {
+                    slot->subnet = subnet;
+                    slot->prefix_len = prefix_len;
+                }
+            }
+            return 0;
+        }
+
+        if (trie->nodes[node].slots[byte].child == 0)
+        {
+            uint32_t child = new_node(trie); // May move trie->nodes
+            if (child == 0)
+                return -1;
+            trie->nodes[node].slots[byte].child = child;
+        }
+        node = trie->nodes[node].slots[byte].child;
+    }
+}
+
+int subnet_trie_build(struct subnet_trie_t *trie, const struct dhcp_config_t *config)
+{
+    if (!trie || !config)
+        return -1;
+
+    memset(trie, 0, sizeof(struct subnet_trie_t));
+    if (new_node(trie) != 0) // Root must be node 0
+    {
+        subnet_trie_free(trie);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < config->subnet_count; i++)
+    {
+        const struct dhcp_subnet_t *subnet = &config->subnets[i];
+        uint32_t mask = ntohl(subnet->netmask.s_addr);
+        uint8_t prefix_len = (mask == 0xFFFFFFFFu) ? 32 : (uint8_t)__builtin_clz(~mask);
+
+        if (prefix_len < 32 && (mask & (0xFFFFFFFFu >> prefix_len)) != 0)
+        {
+            char net_str[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &subnet->network, net_str, sizeof(net_str));
+            fprintf(stderr, "WARNING: subnet %s has a non-contiguous netmask, using /%u\n", net_str, prefix_len);
+        }
+
+        uint32_t prefix = prefix_len ? ntohl(subnet->network.s_addr) & (0xFFFFFFFFu << (32 - prefix_len)) : 0;
+        if (insert(trie, prefix, prefix_len, (int32_t)i) != 0)
+        {
+            subnet_trie_free(trie);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void subnet_trie_free(struct subnet_trie_t *trie)
+{
+    if (trie)
+    {
+        free(trie->nodes);
+        memset(trie, 0, sizeof(struct subnet_trie_t));
+    }
+}
+
+int subnet_trie_lookup(const struct subnet_trie_t *trie, struct in_addr ip)
+{
+    if (!trie || !trie->nodes)
+        return -1;
+
+    uint32_t addr = ntohl(ip.s_addr);
+    uint32_t node = 0;
+    int best = -1;
+
+    for (uint32_t shift = 32 - SUBNET_TRIE_STRIDE;; shift -= SUBNET_TRIE_STRIDE)
+    {
+        const struct subnet_trie_slot_t *slot = &trie->nodes[node].slots[(addr >> shift) & (SUBNET_TRIE_FANOUT - 1)];
+        if (slot->subnet >= 0)
+            best = slot->subnet;
+        if (slot->child == 0 || shift == 0)
+            break;
+        node = slot->child;
+    }
+
+    return best;
+}
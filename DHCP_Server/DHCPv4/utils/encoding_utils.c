@@ -1,30 +1,40 @@
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "../include/utils/encoding_utils.h"
 
 int parse_client_id_from_string(const char *str, uint8_t *client_id, uint32_t *len)
+{
+    if (!str)
+        return -1;
+    return parse_client_id_from_span(str, strlen(str), client_id, len);
+}
+
+int parse_client_id_from_span(const char *str, size_t str_len, uint8_t *client_id, uint32_t *len)
 {
     if (!str || !client_id || !len)
         return -1;
 
     *len = 0;
     const char *ptr = str;
+    const char *end = str + str_len;
 
     // Skip leading whitespace and quotes
-    while (*ptr && (isspace(*ptr) || *ptr == '"'))
+    while (ptr < end && (isspace((unsigned char)*ptr) || *ptr == '"'))
         ptr++;
 
     // Parse octal escapes (\NNN) and regular characters
-    while (*ptr && *ptr != '"' && *len < MAX_CLIENT_ID_LEN)
+    while (ptr < end && *ptr != '"' && *len < MAX_CLIENT_ID_LEN)
     {
-        if (*ptr == '\\')
+        if (*ptr == '\\' && ptr + 1 < end)
         {
             ptr++;
             if (*ptr >= '0' && *ptr <= '7')
             {
                 // Octal escape sequence \NNN
                 int value = 0;
-                for (int i = 0; i < 3 && *ptr >= '0' && *ptr <= '7'; i++, ptr++)
+                for (int i = 0; i < 3 && ptr < end && *ptr >= '0' && *ptr <= '7'; i++, ptr++)
                 {
                     value = value * 8 + (*ptr - '0');
                 }
@@ -35,9 +45,9 @@ int parse_client_id_from_string(const char *str, uint8_t *client_id, uint32_t *l
                 // Hex escape sequence \xNN
                 ptr++;
                 int value = 0;
-                for (int i = 0; i < 2 && isxdigit(*ptr); i++, ptr++)
+                for (int i = 0; i < 2 && ptr < end && isxdigit((unsigned char)*ptr); i++, ptr++)
                 {
-                    value = value * 16 + (isdigit(*ptr) ? (*ptr - '0') : (tolower(*ptr) - 'a' + 10));
+                    value = value * 16 + (isdigit((unsigned char)*ptr) ? (*ptr - '0') : (tolower((unsigned char)*ptr) - 'a' + 10));
                 }
                 client_id[(*len)++] = (uint8_t)value;
             }
@@ -90,3 +100,49 @@ void format_client_id_to_string(const uint8_t *client_id, uint32_t len, char *ou
         *ptr = '\0';
     }
 }
+
+// Reflected CRC-32 tables (polynomial 0xEDB88320), built on first use.
+// crc32_table[k] advances a byte through k further zero bytes, so eight
+// input bytes are folded per step (slicing-by-8) instead of one.
+static uint32_t crc32_table[8][256];
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void crc32_build_table(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_table[0][i] = c;
+    }
+    for (int k = 1; k < 8; k++)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = crc32_table[k - 1][i];
+            crc32_table[k][i] = crc32_table[0][c & 0xFF] ^ (c >> 8);
+        }
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len)
+{
+    pthread_once(&crc32_once, crc32_build_table);
+
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len >= 8)
+    {
+        uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crc32_table[7][lo & 0xFF] ^ crc32_table[6][(lo >> 8) & 0xFF] ^ crc32_table[5][(lo >> 16) & 0xFF] ^
+              crc32_table[4][lo >> 24] ^ crc32_table[3][hi & 0xFF] ^ crc32_table[2][(hi >> 8) & 0xFF] ^
+              crc32_table[1][(hi >> 16) & 0xFF] ^ crc32_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = crc32_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,125 @@
+#include "../include/utils/epoch.h"
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#define DOMAINS_PER_THREAD 4
+#define SYNC_POLL_NS 100000 // 100 us between scans while readers drain
+
+// Per-thread state for one domain: the slot it claimed and the nesting depth
+struct epoch_thread_t
+{
+    struct epoch_domain_t *domain;
+    struct epoch_slot_t *slot; // NULL: counted in overflow_readers
+    unsigned int depth;
+};
+
+static _Thread_local struct epoch_thread_t thread_state[DOMAINS_PER_THREAD];
+
+void epoch_domain_init(struct epoch_domain_t *domain)
+{
+    memset(domain, 0, sizeof(*domain));
+    atomic_init(&domain->global, 1); // 0 marks a slot outside any read section
+    atomic_init(&domain->overflow_readers, 0);
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++)
+    {
+        atomic_init(&domain->slots[i].epoch, 0);
+        atomic_init(&domain->slots[i].in_use, false);
+    }
+}
+
+static struct epoch_thread_t *thread_entry(struct epoch_domain_t *domain)
+{
+    struct epoch_thread_t *free_entry = NULL;
+    for (int i = 0; i < DOMAINS_PER_THREAD; i++)
+    {
+        if (thread_state[i].domain == domain)
+            return &thread_state[i];
+        if (!thread_state[i].domain && !free_entry)
+            free_entry = &thread_state[i];
+    }
+    if (!free_entry)
+        return NULL;
+
+    // First use by this thread: claim a free slot
+    free_entry->domain = domain;
+    free_entry->slot = NULL;
+    free_entry->depth = 0;
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++)
+    {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&domain->slots[i].in_use, &expected, true))
+        {
+            free_entry->slot = &domain->slots[i];
+            break;
+        }
+    }
+    return free_entry;
+}
+
+void epoch_enter(struct epoch_domain_t *domain)
+{
+    struct epoch_thread_t *t = thread_entry(domain);
+    if (!t || !t->slot)
+    {
+        // No slot of our own: hold off every synchronize until we leave
+        atomic_fetch_add(&domain->overflow_readers, 1);
+        return;
+    }
+
+    if (t->depth++ == 0)
+    {
+        // seq_cst: the slot is visible before the caller loads the published pointer
+        atomic_store(&t->slot->epoch, atomic_load(&domain->global));
+    }
+}
+
+void epoch_exit(struct epoch_domain_t *domain)
+{
+    struct epoch_thread_t *t = thread_entry(domain);
+    if (!t || !t->slot)
+    {
+        atomic_fetch_sub(&domain->overflow_readers, 1);
+        return;
+    }
+
+    if (t->depth > 0 && --t->depth == 0)
+        atomic_store_explicit(&t->slot->epoch, 0, memory_order_release);
+}
+
+void epoch_synchronize(struct epoch_domain_t *domain)
+{
+    // Readers entering from here on see the epoch after target and whatever was published before it
+    uint_fast64_t target = atomic_fetch_add(&domain->global, 1) + 1;
+    struct timespec poll = {0, SYNC_POLL_NS};
+
+    for (int i = 0; i < EPOCH_MAX_THREADS; i++)
+    {
+        struct epoch_slot_t *slot = &domain->slots[i];
+        for (;;)
+        {
+            uint_fast64_t seen = atomic_load(&slot->epoch);
+            if (seen == 0 || seen >= target)
+                break;
+            nanosleep(&poll, NULL);
+        }
+    }
+    while (atomic_load(&domain->overflow_readers) != 0)
+        nanosleep(&poll, NULL);
+}
+
+void epoch_thread_exit(struct epoch_domain_t *domain)
+{
+    for (int i = 0; i < DOMAINS_PER_THREAD; i++)
+    {
+        struct epoch_thread_t *t = &thread_state[i];
+        if (t->domain != domain)
+            continue;
+        if (t->slot)
+        {
+            atomic_store(&t->slot->epoch, 0);
+            atomic_store(&t->slot->in_use, false);
+        }
+        memset(t, 0, sizeof(*t));
+    }
+}
@@ -1,209 +1,513 @@
 #include "../include/utils/thread_pool.h"
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #define MAX_THREADS 64
 #define MAX_QUEUE 65536
+#define MIN_WORKER_QUEUE 16
+#define SPIN_ROUNDS 128 // Scans with a pause in between before yielding
+#define YIELD_ROUNDS 8  // Scans with sched_yield() in between before parking
 
-static void *thread_pool_worker(void *thread_pool);
+static void *thread_pool_worker(void *arg);
 
-struct thread_pool_t *thread_pool_create(int num_threads, int queue_size)
+// Worker running the calling thread, NULL outside any pool
+static _Thread_local struct thread_pool_worker_t *current_worker;
+
+static inline void cpu_relax(void)
 {
-    if (num_threads <= 0 || num_threads > MAX_THREADS || queue_size <= 0 || queue_size > MAX_QUEUE)
-        return NULL;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
 
-    struct thread_pool_t *pool = (struct thread_pool_t *)malloc(sizeof(struct thread_pool_t));
-    if (pool == NULL)
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t round_up_pow2(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+// =============================================================================
+// Inbox: bounded MPMC ring. A cell is free for the producer at position pos
+// when seq == pos and holds a task for the consumer when seq == pos + 1.
+// =============================================================================
+
+static bool inbox_push(struct thread_pool_worker_t *w, thread_func_t function, void *argument)
+{
+    size_t pos = atomic_load_explicit(&w->enqueue_pos, memory_order_relaxed);
+    for (;;)
     {
-        fprintf(stderr, "Failed to allocate thread pool\n");
-        return NULL;
+        struct thread_inbox_cell_t *cell = &w->inbox[pos & w->inbox_mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&w->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                cell->task.function = function;
+                cell->task.argument = argument;
+                atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+            return false; // Full
+        else
+            pos = atomic_load_explicit(&w->enqueue_pos, memory_order_relaxed);
     }
+}
 
-    // Initialize counters
-    pool->thread_count = 0;
-    pool->queue_size = queue_size;
-    pool->head = 0;
-    pool->tail = 0;
-    pool->count = 0;
-    pool->shutdown = 0;
-    pool->started = 0;
+static bool inbox_pop(struct thread_pool_worker_t *w, struct thread_task_t *task)
+{
+    size_t pos = atomic_load_explicit(&w->dequeue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        struct thread_inbox_cell_t *cell = &w->inbox[pos & w->inbox_mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&w->dequeue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                *task = cell->task;
+                atomic_store_explicit(&cell->seq, pos + w->inbox_mask + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+            return false; // Empty (or the producer has not finished writing)
+        else
+            pos = atomic_load_explicit(&w->dequeue_pos, memory_order_relaxed);
+    }
+}
 
-    // Allocate thread and queue arrays
-    pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
-    pool->queue = (struct thread_task_t *)malloc(sizeof(struct thread_task_t) * queue_size);
+// =============================================================================
+// Deque: Chase-Lev with a fixed ring. Only the owner calls deque_push and
+// deque_pop; any worker may call deque_steal. A full deque refuses the push
+// and the caller falls back to an inbox.
+// =============================================================================
 
-    if (pool->threads == NULL || pool->queue == NULL)
+static bool deque_push(struct thread_pool_worker_t *w, thread_func_t function, void *argument)
+{
+    long long b = atomic_load_explicit(&w->bottom, memory_order_relaxed);
+    long long t = atomic_load_explicit(&w->top, memory_order_acquire);
+    if (b - t > w->deque_mask)
+        return false;
+
+    struct thread_deque_slot_t *slot = &w->deque[b & w->deque_mask];
+    atomic_store_explicit(&slot->function, function, memory_order_relaxed);
+    atomic_store_explicit(&slot->argument, argument, memory_order_relaxed);
+    atomic_store_explicit(&w->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+static bool deque_pop(struct thread_pool_worker_t *w, struct thread_task_t *task)
+{
+    long long b = atomic_load_explicit(&w->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&w->bottom, b, memory_order_seq_cst);
+    long long t = atomic_load_explicit(&w->top, memory_order_seq_cst);
+    if (t > b)
     {
-        if (pool->threads)
-            free(pool->threads);
-        if (pool->queue)
-            free(pool->queue);
-        free(pool);
-        return NULL;
+        atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+        return false; // Empty
     }
 
-    // Initialize mutex and condition variable
-    if ((pthread_mutex_init(&(pool->lock), NULL) != 0) || (pthread_cond_init(&(pool->notify), NULL) != 0))
+    struct thread_deque_slot_t *slot = &w->deque[b & w->deque_mask];
+    task->function = atomic_load_explicit(&slot->function, memory_order_relaxed);
+    task->argument = atomic_load_explicit(&slot->argument, memory_order_relaxed);
+    if (t == b)
     {
-        free(pool->threads);
-        free(pool->queue);
-        free(pool);
-        return NULL;
+        // Last task: race the thieves for it through top
+        bool won = atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst,
+                                                           memory_order_relaxed);
+        atomic_store_explicit(&w->bottom, b + 1, memory_order_relaxed);
+        return won;
     }
+    return true;
+}
 
-    // Start worker threads
-    for (int i = 0; i < num_threads; i++)
+static bool deque_steal(struct thread_pool_worker_t *w, struct thread_task_t *task)
+{
+    long long t = atomic_load_explicit(&w->top, memory_order_seq_cst);
+    long long b = atomic_load_explicit(&w->bottom, memory_order_seq_cst);
+    if (t >= b)
+        return false;
+
+    // The slot may be rewritten once top moves on; the CAS then fails and the read is discarded
+    struct thread_deque_slot_t *slot = &w->deque[t & w->deque_mask];
+    task->function = atomic_load_explicit(&slot->function, memory_order_relaxed);
+    task->argument = atomic_load_explicit(&slot->argument, memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&w->top, &t, t + 1, memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+static bool worker_has_queued(struct thread_pool_worker_t *w)
+{
+    return atomic_load(&w->bottom) > atomic_load(&w->top) ||
+           atomic_load(&w->enqueue_pos) != atomic_load(&w->dequeue_pos);
+}
+
+// =============================================================================
+// Scheduling
+// =============================================================================
+
+// Own deque (newest first), own inbox, then the other workers from a random start
+static bool find_task(struct thread_pool_worker_t *w, struct thread_task_t *task)
+{
+    if (deque_pop(w, task) || inbox_pop(w, task))
+        return true;
+
+    struct thread_pool_t *pool = w->pool;
+    int n = pool->thread_count;
+    if (n < 2)
+        return false;
+
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 17;
+    w->rng ^= w->rng << 5;
+    int start = (int)(w->rng % (uint32_t)n);
+    for (int k = 0; k < n; k++)
     {
-        if (pthread_create(&(pool->threads[i]), NULL, thread_pool_worker, (void *)pool) != 0)
+        struct thread_pool_worker_t *victim = &pool->workers[(start + k) % n];
+        if (victim == w)
+            continue;
+        if (inbox_pop(victim, task) || deque_steal(victim, task))
         {
-            thread_pool_destroy(pool, 0); // Cleanup
-            return NULL;
+            atomic_store_explicit(&w->steals, atomic_load_explicit(&w->steals, memory_order_relaxed) + 1,
+                                  memory_order_relaxed);
+            return true;
         }
-        pool->thread_count++;
-        pool->started++;
     }
-
-    return pool;
+    return false;
 }
 
-int thread_pool_add(struct thread_pool_t *pool, thread_func_t function, void *argument)
+static bool pool_has_queued(struct thread_pool_t *pool)
 {
-    int next, err = 0;
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        if (worker_has_queued(&pool->workers[i]))
+            return true;
+    }
+    return false;
+}
 
-    if (pool == NULL || function == NULL)
+// Wake up to n parked workers. Pairs with the sleepers check in worker_park().
+static void wake_workers(struct thread_pool_t *pool, int n)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    int sleepers = atomic_load(&pool->sleepers);
+    if (sleepers == 0)
+        return;
+
+    pthread_mutex_lock(&pool->park_lock);
+    if (n >= sleepers)
+        pthread_cond_broadcast(&pool->park_cond);
+    else
     {
-        return -1;
+        for (int i = 0; i < n; i++)
+            pthread_cond_signal(&pool->park_cond);
     }
+    pthread_mutex_unlock(&pool->park_lock);
+}
 
-    if (pthread_mutex_lock(&(pool->lock)) != 0)
+static void worker_park(struct thread_pool_worker_t *w)
+{
+    struct thread_pool_t *pool = w->pool;
+
+    pthread_mutex_lock(&pool->park_lock);
+    atomic_fetch_add(&pool->sleepers, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    // A submitter either sees sleepers > 0 and signals under park_lock, or
+    // published its task before this check
+    if (!pool_has_queued(pool) && !atomic_load(&pool->shutdown))
     {
-        return -1;
+        atomic_store_explicit(&w->parks, atomic_load_explicit(&w->parks, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        pthread_cond_wait(&pool->park_cond, &pool->park_lock);
     }
+    atomic_fetch_sub(&pool->sleepers, 1);
+    pthread_mutex_unlock(&pool->park_lock);
+}
 
-    next = (pool->tail + 1) % pool->queue_size;
+// Spin, then yield, then park until a task turns up. false: time to exit.
+static bool worker_wait_for_task(struct thread_pool_worker_t *w, struct thread_task_t *task)
+{
+    struct thread_pool_t *pool = w->pool;
+    uint64_t idle_start = now_ns();
+    bool found = false;
 
-    // Check if queue is full
-    if (pool->count == pool->queue_size)
+    for (;;)
     {
-        err = -1;
+        int shutdown = atomic_load(&pool->shutdown);
+        if (shutdown == 2)
+            break;
+
+        for (int i = 0; i < SPIN_ROUNDS && !found; i++)
+        {
+            cpu_relax();
+            found = find_task(w, task);
+        }
+        for (int i = 0; i < YIELD_ROUNDS && !found; i++)
+        {
+            sched_yield();
+            found = find_task(w, task);
+        }
+        if (found)
+            break;
+
+        // Graceful shutdown: leave once every queue is drained. A task still
+        // being written or contended counts as queued, so nothing is left behind.
+        if (shutdown == 1)
+        {
+            if (!pool_has_queued(pool))
+                break;
+            continue;
+        }
+        worker_park(w);
+        found = find_task(w, task);
+        if (found)
+            break;
     }
-    else if (pool->shutdown)
+
+    uint64_t idle = now_ns() - idle_start;
+    atomic_store_explicit(&w->idle_ns, atomic_load_explicit(&w->idle_ns, memory_order_relaxed) + idle,
+                          memory_order_relaxed);
+    return found;
+}
+
+static void *thread_pool_worker(void *arg)
+{
+    struct thread_pool_worker_t *w = (struct thread_pool_worker_t *)arg;
+    struct thread_pool_t *pool = w->pool;
+    struct thread_task_t task;
+    current_worker = w;
+
+    for (;;)
     {
-        err = -1;
+        if (atomic_load_explicit(&pool->shutdown, memory_order_relaxed) == 2)
+            break;
+        if (!find_task(w, &task) && !worker_wait_for_task(w, &task))
+            break;
+
+        (*(task.function))(task.argument);
+        atomic_store_explicit(&w->tasks_run, atomic_load_explicit(&w->tasks_run, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
     }
-    else
-    {
-        // Add task to queue
-        pool->queue[pool->tail].function = function;
-        pool->queue[pool->tail].argument = argument;
-        pool->tail = next;
-        pool->count++;
 
-        // Signal waiting threads
-        pthread_cond_signal(&(pool->notify));
+    current_worker = NULL;
+    return NULL;
+}
+
+// =============================================================================
+// Public API
+// =============================================================================
+
+static void thread_pool_free(struct thread_pool_t *pool)
+{
+    if (pool->workers)
+    {
+        for (int i = 0; i < pool->thread_count; i++)
+        {
+            free(pool->workers[i].deque);
+            free(pool->workers[i].inbox);
+        }
+        free(pool->workers);
     }
+    pthread_mutex_destroy(&pool->park_lock);
+    pthread_cond_destroy(&pool->park_cond);
+    free(pool);
+}
 
-    pthread_mutex_unlock(&(pool->lock));
+// Stop and join the first pool->started workers
+static int thread_pool_stop(struct thread_pool_t *pool, int shutdown)
+{
+    int err = 0;
+
+    atomic_store(&pool->shutdown, shutdown);
+    pthread_mutex_lock(&pool->park_lock);
+    pthread_cond_broadcast(&pool->park_cond);
+    pthread_mutex_unlock(&pool->park_lock);
 
+    for (int i = 0; i < pool->started; i++)
+    {
+        if (pthread_join(pool->workers[i].thread, NULL) != 0)
+            err = -1;
+    }
     return err;
 }
 
-int thread_pool_destroy(struct thread_pool_t *pool, int flags)
+struct thread_pool_t *thread_pool_create(int num_threads, int queue_size)
 {
-    int i, err = 0;
+    if (num_threads <= 0 || num_threads > MAX_THREADS || queue_size <= 0 || queue_size > MAX_QUEUE)
+        return NULL;
 
+    struct thread_pool_t *pool = aligned_alloc(_Alignof(struct thread_pool_t), sizeof(struct thread_pool_t));
     if (pool == NULL)
     {
-        return -1;
+        fprintf(stderr, "Failed to allocate thread pool\n");
+        return NULL;
     }
+    memset(pool, 0, sizeof(*pool));
+    atomic_init(&pool->shutdown, 0);
+    atomic_init(&pool->next_inbox, 0);
+    atomic_init(&pool->sleepers, 0);
 
-    if (pthread_mutex_lock(&(pool->lock)) != 0)
+    if ((pthread_mutex_init(&(pool->park_lock), NULL) != 0) || (pthread_cond_init(&(pool->park_cond), NULL) != 0))
     {
-        return -1;
+        free(pool);
+        return NULL;
     }
 
-    do
-    {
-        // Already shutting down
-        if (pool->shutdown)
-        {
-            err = -1;
-            break;
-        }
+    // queue_size is the total; each worker gets its share for both its inbox and its deque
+    size_t per_worker = ((size_t)queue_size + (size_t)num_threads - 1) / (size_t)num_threads;
+    size_t capacity = round_up_pow2(per_worker < MIN_WORKER_QUEUE ? MIN_WORKER_QUEUE : per_worker);
 
-        pool->shutdown = (flags & 1) ? 2 : 1;
+    pool->workers = aligned_alloc(_Alignof(struct thread_pool_worker_t),
+                                  sizeof(struct thread_pool_worker_t) * (size_t)num_threads);
+    if (pool->workers == NULL)
+    {
+        thread_pool_free(pool);
+        return NULL;
+    }
+    memset(pool->workers, 0, sizeof(struct thread_pool_worker_t) * (size_t)num_threads);
+    pool->thread_count = num_threads;
 
-        // Wake up all worker threads
-        if ((pthread_cond_broadcast(&(pool->notify)) != 0) || (pthread_mutex_unlock(&(pool->lock)) != 0))
+    for (int i = 0; i < num_threads; i++)
+    {
+        struct thread_pool_worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->id = i;
+        w->rng = 0x9e3779b9u * (uint32_t)(i + 1);
+        w->deque = calloc(capacity, sizeof(struct thread_deque_slot_t));
+        w->deque_mask = (int64_t)capacity - 1;
+        w->inbox = calloc(capacity, sizeof(struct thread_inbox_cell_t));
+        w->inbox_mask = capacity - 1;
+        if (w->deque == NULL || w->inbox == NULL)
         {
-            err = -1;
-            break;
+            thread_pool_free(pool);
+            return NULL;
         }
+        for (size_t c = 0; c < capacity; c++)
+            atomic_init(&w->inbox[c].seq, c);
+        atomic_init(&w->top, 0);
+        atomic_init(&w->bottom, 0);
+        atomic_init(&w->enqueue_pos, 0);
+        atomic_init(&w->dequeue_pos, 0);
+        atomic_init(&w->tasks_run, 0);
+        atomic_init(&w->steals, 0);
+        atomic_init(&w->parks, 0);
+        atomic_init(&w->idle_ns, 0);
+    }
 
-        // Join all worker threads
-        for (i = 0; i < pool->thread_count; i++)
+    // Start worker threads
+    for (int i = 0; i < num_threads; i++)
+    {
+        if (pthread_create(&(pool->workers[i].thread), NULL, thread_pool_worker, &pool->workers[i]) != 0)
         {
-            if (pthread_join(pool->threads[i], NULL) != 0)
-            {
-                err = -1;
-            }
+            thread_pool_stop(pool, 2); // Cleanup
+            thread_pool_free(pool);
+            return NULL;
         }
-    } while (0);
+        pool->started++;
+    }
+
+    return pool;
+}
 
-    if (!err)
+// Queue one task without waking anyone
+static bool thread_pool_push(struct thread_pool_t *pool, thread_func_t function, void *argument, unsigned int slot)
+{
+    struct thread_pool_worker_t *self = current_worker;
+    if (self && self->pool == pool && deque_push(self, function, argument))
+        return true;
+
+    // Next inbox round-robin; a full one passes the task on to the next
+    for (int k = 0; k < pool->thread_count; k++)
     {
-        pthread_mutex_destroy(&(pool->lock));
-        pthread_cond_destroy(&(pool->notify));
-        free(pool->threads);
-        free(pool->queue);
-        free(pool);
+        if (inbox_push(&pool->workers[(slot + (unsigned int)k) % (unsigned int)pool->thread_count], function,
+                       argument))
+            return true;
     }
-    return err;
+    return false;
 }
 
-static void *thread_pool_worker(void *thread_pool)
+int thread_pool_add(struct thread_pool_t *pool, thread_func_t function, void *argument)
 {
-    struct thread_pool_t *pool = (struct thread_pool_t *)thread_pool;
-    struct thread_task_t task;
+    if (pool == NULL || function == NULL || atomic_load(&pool->shutdown))
+        return -1;
 
-    for (;;)
-    {
-        // Lock must be taken to wait on conditional variable
-        pthread_mutex_lock(&(pool->lock));
+    unsigned int slot = atomic_fetch_add_explicit(&pool->next_inbox, 1, memory_order_relaxed);
+    if (!thread_pool_push(pool, function, argument, slot))
+        return -1; // Every queue is full
 
-        // Wait on condition variable, check for spurious wakeups.
-        // When returning from pthread_cond_wait(), we own the lock.
-        while ((pool->count == 0) && (!pool->shutdown))
-        {
-            pthread_cond_wait(&(pool->notify), &(pool->lock));
-        }
+    wake_workers(pool, 1);
+    return 0;
+}
 
-        if ((pool->shutdown == 1 && pool->count == 0) || (pool->shutdown == 2))
-        {
-            break;
-        }
+int thread_pool_add_batch(struct thread_pool_t *pool, thread_func_t function, void *const *arguments, int count)
+{
+    if (pool == NULL || function == NULL || (count > 0 && arguments == NULL) || atomic_load(&pool->shutdown))
+        return -1;
+    if (count <= 0)
+        return 0;
 
-        // Grab our task
-        task.function = pool->queue[pool->head].function;
-        task.argument = pool->queue[pool->head].argument;
-        pool->head = (pool->head + 1) % pool->queue_size;
-        pool->count--;
+    unsigned int slot = atomic_fetch_add_explicit(&pool->next_inbox, (unsigned int)count, memory_order_relaxed);
+    int queued = 0;
+    while (queued < count && thread_pool_push(pool, function, arguments[queued], slot + (unsigned int)queued))
+        queued++;
 
-        // Unlock
-        pthread_mutex_unlock(&(pool->lock));
+    if (queued > 0)
+        wake_workers(pool, queued);
+    return queued;
+}
 
-        // Execute the task
-        (*(task.function))(task.argument);
+int thread_pool_get_stats(struct thread_pool_t *pool, struct thread_pool_stats_t *stats, int max)
+{
+    if (pool == NULL || stats == NULL)
+        return 0;
+
+    int n = pool->thread_count < max ? pool->thread_count : max;
+    for (int i = 0; i < n; i++)
+    {
+        struct thread_pool_worker_t *w = &pool->workers[i];
+        stats[i].tasks_run = atomic_load_explicit(&w->tasks_run, memory_order_relaxed);
+        stats[i].steals = atomic_load_explicit(&w->steals, memory_order_relaxed);
+        stats[i].parks = atomic_load_explicit(&w->parks, memory_order_relaxed);
+        stats[i].idle_ns = atomic_load_explicit(&w->idle_ns, memory_order_relaxed);
     }
+    return n;
+}
+
+int thread_pool_destroy(struct thread_pool_t *pool, int flags)
+{
+    if (pool == NULL)
+        return -1;
 
-    pool->started--; // safe? thread is ending anyway. strictly should be atomic
-    // or locked but we are holding lock on break above... handle
-    // shutdown logic carefully
+    // Already shutting down
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&pool->shutdown, &expected, (flags & 1) ? 2 : 1))
+        return -1;
+
+    if (thread_pool_stop(pool, (flags & 1) ? 2 : 1) != 0)
+        return -1;
 
-    // In the break path, we hold the lock.
-    pthread_mutex_unlock(&(pool->lock));
-    pthread_exit(NULL);
-    return (NULL);
+    thread_pool_free(pool);
+    return 0;
 }
@@ -39,7 +39,9 @@ void format_lease_time(time_t timestamp, char *output, size_t output_len)
     if (!output || output_len == 0)
         return;
 
-    struct tm *tm_info = localtime(&timestamp);
+    // localtime() shares one static struct tm between threads
+    struct tm tm_buf;
+    struct tm *tm_info = localtime_r(&timestamp, &tm_buf);
     if (!tm_info)
     {
         snprintf(output, output_len, "0");
@@ -66,6 +66,9 @@ typedef struct
    char pd_pool_start[Ip6_STR_MAX];
    char pd_pool_end[Ip6_STR_MAX];
    uint8_t pd_prefix_len;
+   uint8_t pd_hint_min_plen;     // prefix6-hint-lengths: client hints honoured
+   uint8_t pd_hint_max_plen;     // from /min to /max (default pd_prefix_len../64)
+   bool has_pd_hint_lengths;
    struct in6_addr pd_pool_start_bin;
    struct in6_addr pd_pool_end_bin;
    bool has_pd_pool;
@@ -5,11 +5,13 @@
 #include <time.h>
 #include <stdbool.h>
 #include <netinet/in.h>
+#include <pthread.h>
 
 #include "config_v6.h"
 #include "leases6.h"
 
-#define MAX_POOL6_SIZE 4096
+#define IP6_POOL_HASH_PROBES 16   /* Hashed candidates tried before walking the range */
+#define IP6_POOL_MAX_CLAIMS 16    /* Addresses tried per allocation when probes find them in use */
 
 
 /**
@@ -43,15 +45,30 @@ struct ip6_pool_entry_t
 /**
  * @brief IPv6 pool container for a specific subnet.
  *
- * Holds all generated pool entries derived from subnet pool_start/pool_end and
- * keeps counters for fast statistics.
+ * Sparse: only the addresses of subnet pool_start..pool_end that are not
+ * AVAILABLE have an entry, so memory follows the allocations and not the
+ * size of the range (a /64 costs no more than a /120). Entries are found
+ * through hash indexes by address and by DUID. A free address is picked by
+ * hashing the client's DUID and IAID to an offset in the range, the next
+ * hash on a collision; in a crowded range the search walks on from the last
+ * candidate.
+ *
+ * Each pool has its own lock, taken by the functions below, so packets for
+ * different subnets never wait for each other. The lock is taken before any
+ * lease DB lock.
  */
 struct ip6_pool_t
 {
+    pthread_mutex_t lock;       /**< Protects everything below. */
     dhcpv6_subnet_t* subnet;    /**< Owning subnet configuration. */
-    struct ip6_pool_entry_t entries[MAX_POOL6_SIZE];   /**< Pool entries (capped). */
-    uint32_t pool_size;         /**< Number of entries in the pool. */
-    uint32_t available_count;   /**< Number of available addresses. */
+    struct ip6_pool_entry_t* entries;  /**< Addresses that are not AVAILABLE, packed. */
+    uint32_t entry_count;       /**< Entries in use. */
+    uint32_t entry_capacity;    /**< Size of entries[]. */
+    struct lease_index_t addr_index;   /**< Address -> entry, unique. */
+    struct lease_index_t duid_index;   /**< DUID -> entries. */
+    uint64_t range_span;        /**< pool_end - pool_start, capped at 2^64 - 1: offsets 0..range_span are picked from. */
+    uint64_t pool_size;         /**< Number of addresses in the range (saturates at UINT64_MAX). */
+    uint64_t available_count;   /**< Number of available addresses. */
     uint32_t allocated_count;   /**< Number of allocated addresses. */
     uint32_t reserved_count;    /**< Number of reserved addresses. */
 };
@@ -80,21 +97,21 @@ struct ip6_allocation_result_t
 /**
  * @brief Initialize an IPv6 pool for a subnet.
  *
- * Builds the pool entries from subnet->pool_start_bin to subnet->pool_end_bin (inclusive),
- * caps the pool at MAX_POOL6_SIZE, and optionally synchronizes states with an existing
+ * The pool covers subnet->pool_start_bin to subnet->pool_end_bin (inclusive)
+ * without enumerating it, and optionally synchronizes states with an existing
  * lease database. Also reserves static host fixed addresses found in subnet->hosts[].
  *
  * @param pool     Pool object to initialize (output).
  * @param subnet   Subnet configuration providing pool range and static hosts.
  * @param lease_db Optional lease database used to sync existing allocations (may be NULL).
- * @return 0 on success, -1 on error (e.g., missing/invalid pool range).
+ * @return 0 on success, -1 on error (missing/invalid pool range, out of memory).
  */
 int  ip6_pool_init(struct ip6_pool_t* pool, dhcpv6_subnet_t* subnet, lease_v6_db_t* lease_db);
 
 /**
  * @brief Reset/free an IPv6 pool structure.
  *
- * This implementation clears the pool structure in-place.
+ * Frees the entries and indexes and clears the pool structure in-place.
  *
  * @param pool Pool to reset.
  */
@@ -115,12 +132,13 @@ int  ip6_pool_sync_with_leases(struct ip6_pool_t* pool, lease_v6_db_t* lease_db)
  * @brief Update a single pool entry from a lease record.
  *
  * Maps the lease state to an ip6_state_t and updates counters accordingly.
+ * Leases outside the pool range are ignored.
  *
  * @param pool  Pool to update.
  * @param lease Lease record used to update a matching entry.
  * @return 0 on success (including "not found" entry), -1 on invalid parameters.
  */
-int  ip6_pool_update_from_lease(struct ip6_pool_t* pool, dhcpv6_lease_t* lease);
+int  ip6_pool_update_from_lease(struct ip6_pool_t* pool, const dhcpv6_lease_t* lease);
 
 /**
  * @brief Allocate an IPv6 address for a client (IA_NA).
@@ -129,10 +147,14 @@ int  ip6_pool_update_from_lease(struct ip6_pool_t* pool, dhcpv6_lease_t* lease);
  * 1) If client matches a static host entry by DUID -> allocate its fixed address.
  * 2) If client already has an allocated address in this pool -> return it.
  * 3) If client requested a specific address and it is available -> allocate it.
- * 4) Otherwise allocate the first available address from the pool.
+ * 4) Otherwise allocate a free address picked from the hash of DUID and IAID
+ *    (the same client gets the same candidates), trying at most
+ *    IP6_POOL_MAX_CLAIMS addresses when probes find them in use.
  *
  * When probing is enabled, an ICMPv6 echo check may be performed before allocation
- * and conflicts will be marked via @ref ip6_pool_mark_conflict.
+ * and conflicts will be marked via @ref ip6_pool_mark_conflict. The candidate
+ * is claimed first and probed with the pool unlocked, so a probe timeout does
+ * not hold up the other clients of the subnet.
  *
  * On successful allocation, a lease is persisted to the lease DB (IA_NA).
  *
@@ -152,12 +174,13 @@ struct ip6_allocation_result_t ip6_pool_allocate(struct ip6_pool_t* pool, const
 /**
  * @brief Reserve a specific IPv6 address in the pool (e.g., static host).
  *
- * Marks the entry as RESERVED and optionally associates it with a DUID string.
+ * Marks the address as RESERVED and optionally associates it with a DUID string.
  *
  * @param pool Pool to modify.
  * @param ip   IPv6 address to reserve.
  * @param duid Optional DUID string to associate (may be NULL).
- * @return 0 on success, -1 if the entry was not found or invalid params.
+ * @return 0 on success, -1 if the address is outside the pool, on invalid
+ *         params or when out of memory.
  */
 int  ip6_pool_reserve_ip(struct ip6_pool_t* pool, struct in6_addr ip, const char* duid);
 
@@ -169,7 +192,7 @@ int  ip6_pool_reserve_ip(struct ip6_pool_t* pool, struct in6_addr ip, const char
  * @param pool Pool to modify.
  * @param ip   IPv6 address to release.
  * @param db   Lease database (may be NULL).
- * @return 0 on success, -1 if the entry was not found or invalid params.
+ * @return 0 on success, -1 if the address is outside the pool or invalid params.
  */
 int  ip6_pool_release_ip(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db);
 
@@ -182,7 +205,8 @@ int  ip6_pool_release_ip(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_d
  * @param ip     IPv6 address that is conflicting.
  * @param db     Lease database (may be NULL).
  * @param reason Human-readable reason (may be NULL).
- * @return 0 on success, -1 if entry not found or invalid params.
+ * @return 0 on success, -1 if the address is outside the pool, on invalid
+ *         params or when out of memory.
  */
 int  ip6_pool_mark_conflict(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db, const char* reason);
 
@@ -191,7 +215,7 @@ int  ip6_pool_mark_conflict(struct ip6_pool_t* pool, struct in6_addr ip, lease_v
  *
  * @param pool Pool to query.
  * @param ip   IPv6 address to test.
- * @return true if address exists in pool and state is AVAILABLE, otherwise false.
+ * @return true if address is in the pool range and AVAILABLE, otherwise false.
  */
 bool ip6_pool_is_available(struct ip6_pool_t* pool, struct in6_addr ip);
 
@@ -209,9 +233,13 @@ bool ip6_pool_is_in_range(struct ip6_pool_t* pool, struct in6_addr ip);
 /**
  * @brief Find the pool entry that matches a given IPv6 address.
  *
+ * The caller holds pool->lock (or owns the pool exclusively). AVAILABLE
+ * addresses have no entry; the pointer is valid until the pool changes.
+ *
  * @param pool Pool to search.
  * @param ip   IPv6 address to find.
- * @return Pointer to the pool entry, or NULL if not found.
+ * @return Pointer to the pool entry, or NULL if the address is available or
+ *         not in the pool.
  */
 struct ip6_pool_entry_t* ip6_pool_find_entry(struct ip6_pool_t* pool, struct in6_addr ip);
 
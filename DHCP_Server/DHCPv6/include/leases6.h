@@ -5,10 +5,15 @@
 #include <time.h>
 #include <stdbool.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include "utilsv6.h"
 #include "../../DHCPv4/include/utils/time_utils.h"
+#include "../../DHCPv4/include/src/lease_index.h"
 
-#define LEASES6_MAX 4096
+#define LEASES6_MAX 4096            /* Leases the DB is sized for at start; it grows past it */
+#define LEASE_V6_SHARDS 16          /* Lock stripes of the lease DB */
+#define LEASE_V6_CHUNK_SHIFT 8
+#define LEASE_V6_CHUNK_SIZE (1u << LEASE_V6_CHUNK_SHIFT) /* Leases per storage chunk */
 #define DUID_MAX_LEN 128
 #define IP6_STR_MAX 80
 #define HOSTNAME6_MAX 128
@@ -81,16 +86,58 @@ typedef struct dhcpv6_lease_t{
     char fqdn[MAX_V6_FQDN_LEN];                  /**< Optional FQDN string. */
 }dhcpv6_lease_t;
 
+/**
+ * @brief One lock stripe of the lease database.
+ *
+ * A lease lives in the shard its address (IA_NA) or prefix and length (IA_PD)
+ * hashes to, so every lookup or change by address touches one shard only.
+ * Records are stored in chunks of LEASE_V6_CHUNK_SIZE allocated as the shard
+ * grows; slot numbers in the indexes are positions in this store.
+ */
+typedef struct lease_v6_shard_t{
+    pthread_mutex_t lock;                /**< Protects everything below. */
+    uint32_t count;                      /**< Number of leases in this shard. */
+    dhcpv6_lease_t** chunks;             /**< Lease records, packed, LEASE_V6_CHUNK_SIZE per chunk. */
+    uint32_t chunk_count;                /**< Chunks allocated. */
+    uint32_t chunk_capacity;             /**< Size of chunks[]. */
+    struct lease_index_t key_index;      /**< Address (IA_NA) or prefix and length (IA_PD) -> lease, unique. */
+}lease_v6_shard_t;
+
+/**
+ * @brief One lock stripe of the client directory.
+ *
+ * Leases are sharded by address, so the directory tells where a client's
+ * leases are: it is striped by the hash of DUID, IAID and type, and maps
+ * that hash to the shard and slot of each lease. A lookup by client takes
+ * one stripe and then the shards it points to, instead of every shard.
+ */
+typedef struct lease_v6_client_stripe_t{
+    pthread_mutex_t lock;                /**< Protects the index. */
+    struct lease_index_t index;          /**< DUID, IAID and type -> shard and slot of each lease. */
+}lease_v6_client_stripe_t;
+
 /**
  * @brief Lease database container.
  *
- * Holds a fixed-size array of lease entries and the path of the backing file.
+ * Holds the lease records split over LEASE_V6_SHARDS shards and the backing
+ * file. Every change is appended to the file as one record (the loader keeps
+ * the last record of each address or prefix); lease_v6_db_save() compacts it.
+ *
+ * Lock order: a pool lock, then one shard lock, then file_lock. save_lock and
+ * the exclusive side of file_lock are never held together with a shard lock.
+ * A client stripe lock is taken last and held alone: no other lock is taken
+ * under it.
  */
 typedef struct lease_v6_db_t{
     char filename[LEASE6_PATH_MAX];    /**< Path to the lease database file. */
-    uint32_t count;                    /**< Number of leases in the database. */
-    uint32_t capacity;                 /**< Maximum number of leases supported. */
-    dhcpv6_lease_t leases[LEASES6_MAX]; /**< Array of lease records. */
+    uint32_t count;                    /**< Number of leases in the database (all shards, atomic). */
+    uint32_t capacity;                 /**< Lease records allocated (all shards, atomic); grows on demand. */
+    lease_v6_shard_t shards[LEASE_V6_SHARDS]; /**< Lease records by address/prefix hash. */
+    lease_v6_client_stripe_t clients[LEASE_V6_SHARDS]; /**< Where each client's leases are. */
+
+    int append_fd;                     /**< The file, opened for appending records. */
+    pthread_rwlock_t file_lock;        /**< Shared: appending/syncing. Exclusive: replacing the file. */
+    pthread_mutex_t save_lock;         /**< One lease_v6_db_save() at a time. */
 }lease_v6_db_t;
 
 /**
@@ -120,17 +167,32 @@ bool lease_v6_is_expired(const dhcpv6_lease_t* lease);
 /**
  * @brief Initialize a lease database structure.
  *
- * Sets filename and resets counters. Does not load from disk automatically.
+ * Sets filename, resets counters, sets up the locks and opens the file for
+ * appending (creating it if needed). Does not load from disk automatically.
  *
  * @param db       Lease DB object to initialize.
  * @param filename Path to the lease DB file.
- * @return 0 on success, -1 on invalid parameters.
+ * @return 0 on success, -1 on invalid parameters or allocation failure.
  */
 int lease_v6_db_init(lease_v6_db_t *db, const char* filename);
 
+/**
+ * @brief Size the store and indexes for a number of leases up front.
+ *
+ * The database grows on its own; this only saves the rehashes and chunk
+ * allocations on the way. Meant for startup.
+ *
+ * @param db          Lease DB.
+ * @param lease_count Number of leases to make room for.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int lease_v6_db_reserve(lease_v6_db_t *db, uint32_t lease_count);
+
 /**
  * @brief Free resources associated with a lease database.
  *
+ * No other thread may use the database any more.
+ *
  * @param db Lease DB object to free.
  */
 void lease_v6_db_free(lease_v6_db_t *db);
@@ -138,6 +200,8 @@ void lease_v6_db_free(lease_v6_db_t *db);
 /**
  * @brief Load leases from the database file into memory.
  *
+ * Meant for startup, before other threads use the database.
+ *
  * @param db Lease DB object to load into.
  * @return 0 on success, -1 on failure.
  */
@@ -146,13 +210,22 @@ int lease_v6_db_load(lease_v6_db_t *db);
 /**
  * @brief Save leases from memory to the database file.
  *
+ * Snapshot then write: each shard is copied under its lock, one at a time,
+ * and the file is written from the copy with no shard locked. Records
+ * appended meanwhile are carried over behind the snapshot before the new
+ * file replaces the old one, so packet workers only wait for the copy of
+ * one shard and for the final rename.
+ *
  * @param db Lease DB object to save from.
  * @return 0 on success, -1 on failure.
  */
 int lease_v6_db_save(lease_v6_db_t *db);
 
 /**
- * @brief Append a lease to the database.
+ * @brief Append a lease record to the database file.
+ *
+ * The record is written with one write(); it reaches the disk on the next
+ * lease_v6_db_sync() or lease_v6_db_save().
  *
  * @param db     Lease DB object to append to.
  * @param lease  Lease record to append.
@@ -170,9 +243,9 @@ int lease_v6_db_append(lease_v6_db_t *db, const dhcpv6_lease_t *lease);
  * @param ip6_addr     IPv6 address (binary).
  * @param lease_sec    Lease duration in seconds.
  * @param hostname     Optional client hostname.
- * @return Pointer to the added lease, or NULL on failure.
+ * @return 0 on success, -1 on failure (invalid DUID or out of memory).
  */
-dhcpv6_lease_t* lease_v6_add_ia_na(lease_v6_db_t *db, const char* duid, uint16_t duid_len, uint32_t iaid, const struct in6_addr* ip6_addr, uint32_t lease_sec, const char* hostname);
+int lease_v6_add_ia_na(lease_v6_db_t *db, const char* duid, uint16_t duid_len, uint32_t iaid, const struct in6_addr* ip6_addr, uint32_t lease_sec, const char* hostname);
 
 /**
  * @brief Add an IA_PD lease (delegated prefix) to the database.
@@ -187,9 +260,9 @@ dhcpv6_lease_t* lease_v6_add_ia_na(lease_v6_db_t *db, const char* duid, uint16_t
  * @param plen      Prefix length.
  * @param lease_sec Lease lifetime in seconds.
  * @param hostname  Optional hostname (may be NULL).
- * @return Pointer to the created lease on success, NULL on failure.
+ * @return 0 on success, -1 on failure (invalid DUID or out of memory).
  */
-dhcpv6_lease_t* lease_v6_add_ia_pd(lease_v6_db_t* db, const char* duid, uint16_t duid_len, uint32_t iaid, const struct in6_addr* prefix_v6, uint8_t plen, uint32_t lease_sec, const char* hostname);
+int lease_v6_add_ia_pd(lease_v6_db_t* db, const char* duid, uint16_t duid_len, uint32_t iaid, const struct in6_addr* prefix_v6, uint8_t plen, uint32_t lease_sec, const char* hostname);
 
 
 /**
@@ -197,9 +270,10 @@ dhcpv6_lease_t* lease_v6_add_ia_pd(lease_v6_db_t* db, const char* duid, uint16_t
  *
  * @param db       Lease DB.
  * @param ip6_addr IPv6 address to search for.
- * @return Pointer to lease if found, otherwise NULL.
+ * @param out      Receives a copy of the lease (records may move once the shard is unlocked).
+ * @return 0 if found, otherwise -1.
  */
-dhcpv6_lease_t* lease_v6_find_by_ip(lease_v6_db_t *db, const struct in6_addr* ip6_addr);
+int lease_v6_find_by_ip(lease_v6_db_t *db, const struct in6_addr* ip6_addr, dhcpv6_lease_t* out);
 
 /**
  * @brief Find an IA_PD lease by prefix.
@@ -207,21 +281,51 @@ dhcpv6_lease_t* lease_v6_find_by_ip(lease_v6_db_t *db, const struct in6_addr* ip
  * @param db       Lease DB.
  * @param prefix_v6 Prefix to search for.
  * @param plen     Prefix length.
- * @return Pointer to lease if found, otherwise NULL.
+ * @param out      Receives a copy of the lease.
+ * @return 0 if found, otherwise -1.
  */
-dhcpv6_lease_t* lease_v6_find_by_prefix(lease_v6_db_t* db, const struct in6_addr* prefix_v6, uint8_t plen);
+int lease_v6_find_by_prefix(lease_v6_db_t* db, const struct in6_addr* prefix_v6, uint8_t plen, dhcpv6_lease_t* out);
 
 /**
  * @brief Find a lease by DUID and IAID.
  *
+ * The client directory gives the shards and slots of the client's leases,
+ * and each is confirmed under its shard lock, so this locks one stripe and
+ * usually one shard. Should the candidates have moved in the meantime
+ * (lease_v6_cleanup() compacting a shard), the lookup is repeated.
+ *
  * @param db       Lease DB.
  * @param duid     Client DUID (binary).
  * @param duid_len DUID length.
  * @param iaid     IAID.
  * @param type     Lease type (IA_NA or IA_PD).
- * @return Pointer to lease if found, otherwise NULL.
+ * @param out      Receives a copy of the lease.
+ * @return 0 if found, otherwise -1.
  */
-dhcpv6_lease_t* lease_v6_find_by_duid_iaid(lease_v6_db_t *db, const uint8_t* duid, uint16_t duid_len, uint32_t iaid, lease_v6_type_t type);
+int lease_v6_find_by_duid_iaid(lease_v6_db_t *db, const uint8_t* duid, uint16_t duid_len, uint32_t iaid, lease_v6_type_t type, dhcpv6_lease_t* out);
+
+/**
+ * @brief Call a function for every lease in the database.
+ *
+ * Shards are visited one at a time, each under its lock: the callback must
+ * not call back into the database.
+ *
+ * @param db  Lease DB.
+ * @param fn  Callback, given each lease and @p arg.
+ * @param arg Passed through to @p fn.
+ */
+void lease_v6_db_for_each(lease_v6_db_t* db, void (*fn)(const dhcpv6_lease_t* lease, void* arg), void* arg);
+
+/**
+ * @brief Flush appended lease records to disk (fdatasync).
+ *
+ * Called once per packet, after the pool locks are released and before the
+ * reply goes out; concurrent callers share the disk flush.
+ *
+ * @param db Lease DB.
+ * @return 0 on success, -1 on failure.
+ */
+int lease_v6_db_sync(lease_v6_db_t* db);
 
 /**
  * @brief Release an IA_NA lease by IPv6 address.
@@ -264,18 +368,23 @@ int lease_v6_renew_ip(lease_v6_db_t* db, const struct in6_addr* ip6_addr, uint32
 int lease_v6_renew_prefix(lease_v6_db_t* db, const struct in6_addr* prefix_v6, uint8_t plen, uint32_t lease_sec);
 
 /**
- * @brief Mark expired leases older than a given time (mark as EXPIRED and persist).
+ * @brief Mark expired leases older than a given time (mark as EXPIRED).
+ *
+ * Not persisted: the state follows from the end time when the file is
+ * loaded, and the caller saves after lease_v6_cleanup().
  *
  * @param db Lease DB.
- * @return 0 on success, -1 on failure.
+ * @return Number of leases marked, -1 on failure.
  */
 int lease_v6_mark_expired_older(lease_v6_db_t* db);
 
 /**
- * @brief Clean up expired leases (mark as EXPIRED and persist).
+ * @brief Remove expired and released leases from memory.
+ *
+ * The file still holds them until the next lease_v6_db_save().
  *
  * @param db Lease DB.
- * @return 0 on success, -1 on failure.
+ * @return Number of leases removed, -1 on failure.
  */
 int lease_v6_cleanup(lease_v6_db_t* db);
 
@@ -296,7 +405,7 @@ int lease_v6_mark_reserved(lease_v6_db_t* db, const struct in6_addr* ip6, const
  *
  * @param lease Lease DB to print.
  */
-void lease_v6_db_print(const lease_v6_db_t* lease);
+void lease_v6_db_print(lease_v6_db_t* lease);
 
 /**
  * @brief Set the state of a lease (mark as state and persist).
@@ -0,0 +1,147 @@
+#ifndef PACKET_QUEUE6_H
+#define PACKET_QUEUE6_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#define PKT6_BUF_SIZE 4096     /* Largest datagram accepted */
+#define PKT6_RECV_BATCH 32     /* Max datagrams pulled per recvmmsg() call */
+#define PKT6_POOL_NIL 0xFFFFFFFFu
+
+
+/**
+ * @brief One received DHCPv6 datagram.
+ *
+ * Packets live in a slab owned by pkt6_pool_t. recvmmsg() writes straight
+ * into buf, and the packet travels to a worker by pointer: nothing is copied
+ * between the socket and process_packet().
+ */
+typedef struct pkt6_t {
+    uint8_t buf[PKT6_BUF_SIZE];       /**< Datagram payload. */
+    ssize_t len;                      /**< Payload length. */
+    struct sockaddr_in6 client_addr;  /**< Sender. */
+    uint32_t next;                    /**< Free-list link (slot index), only while free. */
+} pkt6_t;
+
+/**
+ * @brief Fixed slab of packets recycled through a lock-free free list.
+ *
+ * The free list is a Treiber stack over slot indices; the head packs a
+ * 32-bit generation tag with the index so that concurrent pops and pushes
+ * cannot suffer from ABA.
+ */
+typedef struct pkt6_pool_t {
+    pkt6_t*  slots;           /**< The slab. */
+    uint32_t capacity;        /**< Number of slots. */
+    uint64_t free_head;       /**< (tag << 32) | index, PKT6_POOL_NIL when empty. */
+    uint64_t exhausted_count; /**< acquire() calls that found the pool empty. */
+} pkt6_pool_t;
+
+/**
+ * @brief One cell of the descriptor ring.
+ */
+typedef struct pkt6_cell_t {
+    uint64_t seq;   /**< Turn counter: tells producers and consumers whose turn the cell is. */
+    pkt6_t*  pkt;   /**< The queued packet. */
+} pkt6_cell_t;
+
+/**
+ * @brief Bounded lock-free multi-producer / multi-consumer queue of packets.
+ *
+ * Only packet pointers go through the ring. Producers and consumers claim
+ * cells with a CAS on their own cursor (each on its own cache line), and
+ * publish them through the cell's sequence number. Workers that find the
+ * ring empty sleep on a condition variable; a producer only touches it when
+ * some worker sleeps, and then once per batch.
+ */
+typedef struct pkt6_ring_t {
+    pkt6_cell_t* cells;       /**< capacity cells, capacity a power of two. */
+    uint64_t     mask;        /**< capacity - 1. */
+    _Alignas(64) uint64_t enqueue_pos;  /**< Next cell to fill. */
+    _Alignas(64) uint64_t dequeue_pos;  /**< Next cell to drain. */
+    _Alignas(64) int sleepers;          /**< Workers asleep or about to sleep. */
+    int          shutdown;    /**< Set by pkt6_ring_shutdown(). */
+    pthread_mutex_t wait_lock;/**< Protects the sleep/wake handshake. */
+    pthread_cond_t  wait_cond;/**< Idle workers wait here. */
+} pkt6_ring_t;
+
+
+/**
+ * @brief Allocate the slab and thread every slot onto the free list.
+ *
+ * @param pool The pool to initialize.
+ * @param capacity Number of packets to preallocate.
+ * @return 0 on success, -1 on failure.
+ */
+int pkt6_pool_init(pkt6_pool_t* pool, uint32_t capacity);
+
+/**
+ * @brief Release the slab. No packet may be in use.
+ *
+ * @param pool The pool to free.
+ */
+void pkt6_pool_free(pkt6_pool_t* pool);
+
+/**
+ * @brief Take a free packet. Lock-free, safe from any thread.
+ *
+ * @param pool The pool to take from.
+ * @return A packet, or NULL if every packet is queued or being processed.
+ */
+pkt6_t* pkt6_pool_acquire(pkt6_pool_t* pool);
+
+/**
+ * @brief Give a packet back. Lock-free, safe from any thread.
+ *
+ * @param pool The pool the packet came from.
+ * @param pkt A packet obtained from pkt6_pool_acquire().
+ */
+void pkt6_pool_release(pkt6_pool_t* pool, pkt6_t* pkt);
+
+/**
+ * @brief Allocate the ring.
+ *
+ * @param ring The ring to initialize.
+ * @param capacity Number of cells; rounded up to a power of two.
+ * @return 0 on success, -1 on failure.
+ */
+int pkt6_ring_init(pkt6_ring_t* ring, uint32_t capacity);
+
+/**
+ * @brief Free the ring. Packets still queued are not released.
+ *
+ * @param ring The ring to free.
+ */
+void pkt6_ring_free(pkt6_ring_t* ring);
+
+/**
+ * @brief Queue packets and wake up to as many idle workers.
+ *
+ * @param ring The ring to push to.
+ * @param pkts The packets, queued in order.
+ * @param n Number of packets.
+ * @return Number of packets queued: less than n when the ring is full, and
+ *         the caller still owns pkts[return value .. n-1].
+ */
+int pkt6_ring_push(pkt6_ring_t* ring, pkt6_t* const* pkts, int n);
+
+/**
+ * @brief Take the oldest packet, sleeping while the ring is empty.
+ *
+ * @param ring The ring to pop from.
+ * @return A packet, or NULL once the ring is shut down and empty.
+ */
+pkt6_t* pkt6_ring_pop_wait(pkt6_ring_t* ring);
+
+/**
+ * @brief Make pkt6_ring_pop_wait() return NULL once the ring is empty, and
+ *        wake every waiting worker.
+ *
+ * @param ring The ring to shut down.
+ */
+void pkt6_ring_shutdown(pkt6_ring_t* ring);
+
+#endif // PACKET_QUEUE6_H
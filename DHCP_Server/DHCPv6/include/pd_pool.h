@@ -5,18 +5,23 @@
 #include <time.h>
 #include <netinet/in.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #include "config_v6.h"
 #include "leases6.h"
 #include "ip6_pool.h"   
 
-#define MAX_PD_POOL_SIZE 1024
+#define PD_POOL_MAX_PLEN 64   /* Longest prefix, and the allocation unit. */
+#define PD_POOL_ORDERS   64   /* Block orders 0 (/64) .. 63 (/1). */
+#define PD_POOL_NIL      0xFFFFFFFFu
 
 
 /**
- * @brief Single Prefix Delegation (PD) pool entry.
+ * @brief One block of the Prefix Delegation (PD) buddy allocator.
  *
- * Represents one delegatable IPv6 prefix chunk (prefix/plen) and its state.
+ * A block is an aligned prefix/plen of the pool, plen between 1 and 64. A
+ * free block (AVAILABLE) sits on the free list of its order (64 - plen); any
+ * other block is delegated (or reserved, or in conflict) as a whole.
  * The entry stores the owning client DUID (hex string form, as used by your code),
  * allocation timestamp, and pool state (available/allocated/reserved/conflict).
  */
@@ -26,29 +31,53 @@ typedef struct pd_pool_entry_t {
     ip6_state_t     state;     /**< Pool state (available/allocated/reserved/conflict). */
     char            duid[DUID_MAX_LEN]; /**< Owner DUID in hex string form ("" if none). */
     time_t          last_allocated; /**< Last allocation time (0 if never allocated). */
+    uint32_t        free_prev; /**< Previous block on the free list (slot), only while AVAILABLE. */
+    uint32_t        free_next; /**< Next block on the free list (slot), only while AVAILABLE. */
 } pd_pool_entry_t;
 
 
 /**
  * @brief Prefix Delegation pool.
  *
- * The PD pool is derived from a subnet's PD range (pd_pool_start_bin .. pd_pool_end_bin).
- * It is split into fixed-size delegated prefixes (delegated_plen). Each entry corresponds
- * to one chunk that can be leased as IA_PD.
+ * The PD pool covers a subnet's PD range, from pd_pool_start_bin to the end
+ * of the delegated_plen prefix at pd_pool_end_bin. It is a buddy allocator
+ * counted in /64s: the range starts as the fewest aligned blocks that tile
+ * it, a request for a /n takes the smallest free block that holds one and
+ * splits it in halves down to /n, and a release merges the block back with
+ * its free buddy as far as it goes. Prefixes of different lengths (/56, /60,
+ * /64 ...) come from the same range, and nothing is enumerated: memory
+ * follows the number of blocks, not the size of the range.
+ *
+ * Blocks are found by prefix/plen and by DUID through hash indexes; the
+ * free lists of non-empty orders are flagged in a bitmap, so the smallest
+ * fitting block is found in one bit scan.
+ *
+ * Like the address pool, each PD pool has its own lock, taken by
+ * pd_pool_allocate() and pd_pool_release() before any lease DB lock.
  */
 typedef struct pd_pool_t {
+    pthread_mutex_t lock;    /**< Protects the blocks, free lists and counters. */
     dhcpv6_subnet_t *subnet; /**< Subnet this pool belongs to. */
 
-    struct in6_addr base_prefix;    /**< Base prefix for the pool (binary). */
-    uint8_t         base_plen;      /**< Base prefix length. */
-    uint8_t         delegated_plen; /**< Delegated prefix length. */
-
-    pd_pool_entry_t entries[MAX_PD_POOL_SIZE];   /**< Pool entries (prefix chunks). */
-    uint32_t        pool_size;      /**< Number of entries in the pool. */
-
-    uint32_t        available_count;  /**< Number of available entries. */
-    uint32_t        allocated_count;  /**< Number of allocated entries. */
-    uint32_t        reserved_count;   /**< Number of reserved entries. */
+    struct in6_addr base_prefix;    /**< First prefix of the range (binary). */
+    uint8_t         delegated_plen; /**< Prefix length delegated when the client has no usable hint. */
+    uint8_t         hint_min_plen;  /**< Shortest hinted length honoured (default delegated_plen). */
+    uint8_t         hint_max_plen;  /**< Longest hinted length honoured (default PD_POOL_MAX_PLEN). */
+    uint64_t        first_unit;     /**< First /64 of the range (upper 64 bits of the address). */
+    uint64_t        last_unit;      /**< Last /64 of the range. */
+
+    pd_pool_entry_t* entries;       /**< Blocks, free and delegated, packed. */
+    uint32_t        entry_count;    /**< Blocks in use. */
+    uint32_t        entry_capacity; /**< Blocks allocated. */
+    struct lease_index_t block_index; /**< prefix/plen -> slot in entries. */
+    struct lease_index_t duid_index;  /**< Owner DUID -> slot in entries. */
+    uint32_t        free_head[PD_POOL_ORDERS]; /**< Free list per order, PD_POOL_NIL when empty. */
+    uint64_t        free_orders;    /**< Bit n set when free_head[n] is not empty. */
+
+    uint64_t        pool_size;      /**< /64s in the range. */
+    uint64_t        available_count;  /**< /64s in free blocks. */
+    uint32_t        allocated_count;  /**< Number of delegated prefixes. */
+    uint32_t        reserved_count;   /**< Number of reserved prefixes. */
 } pd_pool_t;
 
 /**
@@ -69,7 +98,11 @@ typedef struct pd_allocation_result_t {
  * @brief Initialize a PD pool.
  *
  * Initializes a PD pool based on the subnet's PD range and delegated prefix length.
- * Populates the pool with available prefixes and syncs with the lease database.
+ * Tiles the range with free blocks, then carves out the prefixes the lease
+ * database holds. A delegated_plen above PD_POOL_MAX_PLEN is clamped to it.
+ * Client hints are honoured for the subnet's prefix6-hint-lengths, by
+ * default delegated_plen../64: no client gets more than delegated_plen
+ * unless the configuration allows it.
  *
  * @param pool The PD pool to initialize.
  * @param subnet The subnet this pool belongs to.
@@ -85,7 +118,7 @@ int  pd_pool_init(pd_pool_t *pool,
 /**
  * @brief Free a PD pool.
  *
- * Frees a PD pool and sets all its fields to 0.
+ * Frees the blocks and indexes of a PD pool and sets all its fields to 0.
  *
  * @param pool The PD pool to free.
  */
@@ -94,7 +127,9 @@ void pd_pool_free(pd_pool_t *pool);
 /**
  * @brief Find a PD pool entry.
  *
- * Finds a PD pool entry based on the prefix and prefix length.
+ * Finds the block with exactly this prefix and prefix length. A free
+ * prefix that lies inside a larger free block has no entry of its own.
+ * The caller holds pool->lock (or owns the pool exclusively).
  *
  * @param pool The PD pool to search in.
  * @param prefix The prefix to search for.
@@ -108,7 +143,8 @@ pd_pool_entry_t* pd_pool_find_entry(pd_pool_t *pool,
 /**
  * @brief Check if a PD pool entry is available.
  *
- * Checks if a PD pool entry is available for allocation.
+ * Checks if a prefix is available for allocation, that is, lies inside a
+ * free block.
  *
  * @param pool The PD pool to check.
  * @param prefix The prefix to check.
@@ -120,12 +156,21 @@ bool pd_pool_is_available(pd_pool_t *pool, const struct in6_addr *prefix, uint8_
 /**
  * @brief Allocate a PD pool entry.
  *
- * Allocates a PD pool entry for a client.
+ * Allocates a prefix for a client:
+ * 1. The prefix the client already holds, found by DUID.
+ * 2. The prefix the client hints at, if it is free.
+ * 3. The smallest free block that holds a prefix of the wanted length,
+ *    split down to it.
+ *
+ * The wanted length is the hint's when it lies in
+ * hint_min_plen..hint_max_plen, delegated_plen otherwise.
  *
  * @param pool The PD pool to allocate from.
  * @param duid_hex The client's DUID in hex string form.
  * @param duid_len The length of the DUID.
  * @param iaid The IAID for the allocation.
+ * @param hint_prefix The prefix from the client's IAPREFIX, NULL or :: if none.
+ * @param hint_plen The prefix length from the client's IAPREFIX, 0 if none.
  * @param hostname_opt The hostname option for the allocation.
  * @param db The lease database to sync with.
  * @param lease_time The lease time for the allocation.
@@ -135,6 +180,8 @@ pd_allocation_result_t pd_pool_allocate(pd_pool_t *pool,
                                         const char *duid_hex,
                                         uint16_t duid_len,
                                         uint32_t iaid,
+                                        const struct in6_addr *hint_prefix,
+                                        uint8_t hint_plen,
                                         const char *hostname_opt,
                                         lease_v6_db_t *db,
                                         uint32_t lease_time);
@@ -142,7 +189,8 @@ pd_allocation_result_t pd_pool_allocate(pd_pool_t *pool,
 /**
  * @brief Release a PD pool entry.
  *
- * Releases a PD pool entry for a client.
+ * Releases a prefix for a client. Its block becomes free and merges with
+ * its buddy as long as the buddy is free too.
  *
  * @param pool The PD pool to release from.
  * @param prefix The prefix to release.
@@ -158,8 +206,8 @@ int  pd_pool_release(pd_pool_t *pool,
 /**
  * @brief Print statistics for a PD pool.
  *
- * Prints statistics for a PD pool, including the number of available,
- * allocated, reserved, and conflict entries.
+ * Prints statistics for a PD pool: /64s in the range and free, delegated
+ * and reserved prefixes, and free blocks per prefix length.
  *
  * @param pool The PD pool to print statistics for.
  */
@@ -168,8 +216,8 @@ void pd_pool_print_stats(const pd_pool_t *pool);
 /**
  * @brief Print detailed information for a PD pool.
  *
- * Prints detailed information for a PD pool, including the prefix,
- * prefix length, state, and owner DUID.
+ * Prints every block of a PD pool, free or not: prefix, prefix length,
+ * state, and owner DUID.
  *
  * @param pool The PD pool to print detailed information for.
  */
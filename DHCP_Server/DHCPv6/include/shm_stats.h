@@ -15,6 +15,7 @@ typedef struct {
     
     volatile uint64_t pkt_received;     // Total UDP packets received
     volatile uint64_t pkt_processed;    // Valid DHCPv6 packets processed
+    volatile uint64_t pkt_dropped;      // Lost before a worker saw them (queue full, socket overflow)
     volatile uint64_t leases_active;    // Current number of active leases (NA + PD)
     volatile uint64_t errors_count;     // Total error events logged
 } server_stats_t;
@@ -49,6 +49,7 @@ int main() {
         printf("----------------------------------------\n");
         printf("Packets RX:      %lu\n", stats->pkt_received);
         printf("Packets Proc:    %lu\n", stats->pkt_processed);
+        printf("Packets Dropped: %lu\n", stats->pkt_dropped);
         printf("Active Leases:   %lu\n", stats->leases_active);
         printf("Errors:          %lu\n", stats->errors_count);
         printf("========================================\n");
@@ -359,6 +359,24 @@ static void parse_prefix6(dhcpv6_subnet_t *subnet, char *line)
     }
 }
 
+static void parse_prefix6_hint_lengths(dhcpv6_subnet_t *subnet, char *line)
+{
+    strip_semicolon(line);
+
+    unsigned min_plen, max_plen;
+    if(sscanf(line, "prefix6-hint-lengths /%u /%u",&min_plen,&max_plen)==2 &&
+       min_plen>=1 && min_plen<=max_plen && max_plen<=128)
+    {
+        subnet->pd_hint_min_plen=(uint8_t)min_plen;
+        subnet->pd_hint_max_plen=(uint8_t)max_plen;
+        subnet->has_pd_hint_lengths=true;
+    }
+    else
+    {
+        fprintf(stderr, "[WARN] Ignoring malformed '%s'\n", line);
+    }
+}
+
 static void parse_subnet_option(dhcpv6_subnet_t *subnet, char *line)
 {
     strip_semicolon(line);
@@ -699,6 +717,11 @@ int load_config_v6(const char *path, dhcpv6_config_t *cfg)
                 parse_range(current_subnet,p);
                 continue;
             }
+            if(starts_with(p,"prefix6-hint-lengths"))
+            {
+                parse_prefix6_hint_lengths(current_subnet,p);
+                continue;
+            }
             if(starts_with(p,"prefix6"))
             {
                 parse_prefix6(current_subnet,p);
@@ -770,6 +793,8 @@ void dump_config_v6(const dhcpv6_config_t *cfg)
         if(s->pd_enabled)
         {
             printf("  PD Pool: %s - %s/%u\n",s->pd_pool_start,s->pd_pool_end,s->pd_prefix_len);
+            if(s->has_pd_hint_lengths)
+                printf("  PD hint lengths: /%u - /%u\n",s->pd_hint_min_plen,s->pd_hint_max_plen);
         }
 
         printf("  DNS servers: %s\n",s->dns_servers);
@@ -57,6 +57,11 @@ static void validate_pd_pool(const dhcpv6_subnet_t *s)
         fprintf(stderr, "[WARN] Subnet %s/%u: PD end not in prefix\n",
                 s->prefix, s->prefix_len);
     }
+
+    if (s->has_pd_hint_lengths && s->pd_hint_max_plen > 64) {
+        fprintf(stderr, "[WARN] Subnet %s/%u: PD hint lengths beyond /64 are not delegated\n",
+                s->prefix, s->prefix_len);
+    }
 }
 
 static void validate_hosts(const dhcpv6_subnet_t *s)
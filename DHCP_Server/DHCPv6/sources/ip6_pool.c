@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <netinet/in.h>
 
 static const char* S_UNKNOWN = "unknown";
@@ -165,14 +166,194 @@ bool ip6_ping_check(struct in6_addr ip, uint32_t timeout_ms)
 }
 
 
+/* ---- sparse entry table ---- */
+
+static inline uint32_t hash_addr(const struct in6_addr* ip)
+{
+    uint64_t hi, lo;
+    memcpy(&hi, ip->s6_addr, sizeof(hi));
+    memcpy(&lo, ip->s6_addr + 8, sizeof(lo));
+    return lease_index_hash_u64(lease_index_hash_u64(hi) ^ lo);
+}
+
+static inline uint32_t hash_duid(const char* duid)
+{
+    return lease_index_hash_bytes((const uint8_t*)duid, (uint32_t)strlen(duid));
+}
+
+// Caller holds pool->lock. Slot of the entry of an address, UINT32_MAX if none.
+static uint32_t entry_slot(const struct ip6_pool_t* pool, const struct in6_addr* ip)
+{
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&pool->addr_index, hash_addr(ip), &it);
+    while (lease_index_next(&pool->addr_index, &it, &slot)) {
+        if (memcmp(&pool->entries[slot].ip_address, ip, sizeof(*ip)) == 0) return slot;
+    }
+    return UINT32_MAX;
+}
+
 struct ip6_pool_entry_t* ip6_pool_find_entry(struct ip6_pool_t* pool, struct in6_addr ip)
 {
-    if (!pool) return NULL;
-    for (uint32_t i = 0; i < pool->pool_size; ++i) {
-        if (memcmp(&pool->entries[i].ip_address, &ip, sizeof(struct in6_addr)) == 0)
-            return &pool->entries[i];
+    if (!pool || !pool->entries) return NULL;
+    uint32_t slot = entry_slot(pool, &ip);
+    return slot == UINT32_MAX ? NULL : &pool->entries[slot];
+}
+
+static void count_state(struct ip6_pool_t* pool, ip6_state_t state, int delta)
+{
+    if (state == IP6_STATE_ALLOCATED) pool->allocated_count += delta;
+    else if (state == IP6_STATE_RESERVED) pool->reserved_count += delta;
+}
+
+// Caller holds pool->lock. The entry's DUID is about to change: unlink it
+// from duid_index before, relink after.
+static void duid_unlink(struct ip6_pool_t* pool, uint32_t slot)
+{
+    const struct ip6_pool_entry_t* e = &pool->entries[slot];
+    if (e->duid[0]) lease_index_remove(&pool->duid_index, hash_duid(e->duid), slot);
+}
+
+static void duid_relink(struct ip6_pool_t* pool, uint32_t slot)
+{
+    const struct ip6_pool_entry_t* e = &pool->entries[slot];
+    if (e->duid[0] && lease_index_insert(&pool->duid_index, hash_duid(e->duid), slot) != 0)
+        log_error("ip6_pool: out of memory, client %s not found by DUID", e->duid);
+}
+
+// Caller holds pool->lock. Gives @p ip an AVAILABLE entry to change, unless
+// it has one. Returns its slot, UINT32_MAX when out of memory.
+static uint32_t entry_materialize(struct ip6_pool_t* pool, const struct in6_addr* ip)
+{
+    uint32_t slot = entry_slot(pool, ip);
+    if (slot != UINT32_MAX) return slot;
+
+    if (pool->entry_count == pool->entry_capacity) {
+        uint32_t cap = pool->entry_capacity ? pool->entry_capacity * 2 : 64;
+        struct ip6_pool_entry_t* grown = realloc(pool->entries, (size_t)cap * sizeof(*grown));
+        if (!grown) return UINT32_MAX;
+        pool->entries = grown;
+        pool->entry_capacity = cap;
     }
-    return NULL;
+    slot = pool->entry_count;
+    struct ip6_pool_entry_t* e = &pool->entries[slot];
+    memset(e, 0, sizeof(*e));
+    e->ip_address = *ip;
+    e->state = IP6_STATE_AVAILABLE;
+    if (lease_index_insert(&pool->addr_index, hash_addr(ip), slot) != 0) return UINT32_MAX;
+    pool->entry_count++;
+    return slot;
+}
+
+// Caller holds pool->lock. Drops the entry in @p slot, now AVAILABLE: the
+// last entry moves into its place.
+static void entry_drop(struct ip6_pool_t* pool, uint32_t slot)
+{
+    struct ip6_pool_entry_t* e = &pool->entries[slot];
+    duid_unlink(pool, slot);
+    lease_index_remove(&pool->addr_index, hash_addr(&e->ip_address), slot);
+
+    uint32_t last = --pool->entry_count;
+    if (slot != last) {
+        duid_unlink(pool, last);
+        lease_index_remove(&pool->addr_index, hash_addr(&pool->entries[last].ip_address), last);
+        *e = pool->entries[last];
+        if (lease_index_insert(&pool->addr_index, hash_addr(&e->ip_address), slot) != 0)
+            log_error("ip6_pool: out of memory, lost track of a used address");
+        duid_relink(pool, slot);
+    }
+}
+
+// Caller holds pool->lock. Moves the entry in @p slot to @p state, counters
+// follow; an entry that becomes AVAILABLE is dropped. Returns the entry, or
+// NULL once dropped.
+static struct ip6_pool_entry_t* entry_set_state(struct ip6_pool_t* pool, uint32_t slot, ip6_state_t state)
+{
+    struct ip6_pool_entry_t* e = &pool->entries[slot];
+    if (e->state == IP6_STATE_AVAILABLE && state != IP6_STATE_AVAILABLE && pool->available_count)
+        pool->available_count--;
+    if (e->state != IP6_STATE_AVAILABLE && state == IP6_STATE_AVAILABLE)
+        pool->available_count++;
+    count_state(pool, e->state, -1);
+    count_state(pool, state, +1);
+    e->state = state;
+
+    if (state == IP6_STATE_AVAILABLE) {
+        entry_drop(pool, slot);
+        return NULL;
+    }
+    return e;
+}
+
+// Caller holds pool->lock. Sets the DUID of the entry in @p slot.
+static void entry_set_duid(struct ip6_pool_t* pool, uint32_t slot, const char* duid)
+{
+    struct ip6_pool_entry_t* e = &pool->entries[slot];
+    duid_unlink(pool, slot);
+    snprintf(e->duid, sizeof(e->duid), "%s", duid ? duid : "");
+    duid_relink(pool, slot);
+}
+
+/* ---- range arithmetic ---- */
+
+static inline void addr_split(const struct in6_addr* a, uint64_t* hi, uint64_t* lo)
+{
+    *hi = 0; *lo = 0;
+    for (int i = 0; i < 8; i++) *hi = (*hi << 8) | a->s6_addr[i];
+    for (int i = 8; i < 16; i++) *lo = (*lo << 8) | a->s6_addr[i];
+}
+
+// pool_start + offset
+static struct in6_addr addr_at(const struct ip6_pool_t* pool, uint64_t offset)
+{
+    uint64_t hi, lo;
+    addr_split(&pool->subnet->pool_start_bin, &hi, &lo);
+    if (lo + offset < lo) hi++;
+    lo += offset;
+
+    struct in6_addr a;
+    for (int i = 7; i >= 0; i--) { a.s6_addr[i] = (uint8_t)hi; hi >>= 8; }
+    for (int i = 15; i >= 8; i--) { a.s6_addr[i] = (uint8_t)lo; lo >>= 8; }
+    return a;
+}
+
+static inline uint64_t mix64(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static inline uint64_t offset_wrap(const struct ip6_pool_t* pool, uint64_t x)
+{
+    return pool->range_span == UINT64_MAX ? x : x % (pool->range_span + 1);
+}
+
+// Caller holds pool->lock. Picks an AVAILABLE address for the client whose
+// DUID and IAID gave @p seed; false if the range is full.
+static bool pick_free(const struct ip6_pool_t* pool, uint64_t seed, struct in6_addr* out)
+{
+    if (pool->available_count == 0) return false;
+
+    // Hashed candidates: O(1) expected while the range is not crowded
+    uint64_t off = 0;
+    for (uint32_t i = 0; i < IP6_POOL_HASH_PROBES; i++) {
+        off = offset_wrap(pool, mix64(seed + i));
+        *out = addr_at(pool, off);
+        if (entry_slot(pool, out) == UINT32_MAX) return true;
+    }
+
+    // Crowded: walk on. Every entry_count + 1 consecutive addresses hold a free one.
+    for (uint32_t i = 0; i <= pool->entry_count; i++) {
+        off = (off == pool->range_span) ? 0 : off + 1;
+        *out = addr_at(pool, off);
+        if (entry_slot(pool, out) == UINT32_MAX) return true;
+    }
+    return false;
 }
 
 bool ip6_pool_is_in_range(struct ip6_pool_t* pool, struct in6_addr ip)
@@ -184,10 +365,19 @@ bool ip6_pool_is_in_range(struct ip6_pool_t* pool, struct in6_addr ip)
     return (ipv6_compare(&ip, A) >= 0 && ipv6_compare(&ip, B) <= 0);
 }
 
+// Caller holds pool->lock
+static bool is_available_locked(struct ip6_pool_t* pool, struct in6_addr ip)
+{
+    return ip6_pool_is_in_range(pool, ip) && entry_slot(pool, &ip) == UINT32_MAX;
+}
+
 bool ip6_pool_is_available(struct ip6_pool_t* pool, struct in6_addr ip)
 {
-    struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, ip);
-    return (e && e->state == IP6_STATE_AVAILABLE);
+    if (!pool) return false;
+    pthread_mutex_lock(&pool->lock);
+    bool available = is_available_locked(pool, ip);
+    pthread_mutex_unlock(&pool->lock);
+    return available;
 }
 
 
@@ -195,47 +385,30 @@ int ip6_pool_init(struct ip6_pool_t* pool, dhcpv6_subnet_t* subnet, lease_v6_db_
 {
     if (!pool || !subnet) return -1;
     memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
     pool->subnet = subnet;
 
-    if (!subnet->has_pool_range) {
+    if (!subnet->has_pool_range || ipv6_compare(&subnet->pool_start_bin, &subnet->pool_end_bin) > 0) {
         log_error("ip6_pool_init: subnet has no pool range");
         return -1;
     }
+    if (lease_index_init(&pool->addr_index, 0) != 0 || lease_index_init(&pool->duid_index, 0) != 0) {
+        lease_index_free(&pool->addr_index);
+        log_error("ip6_pool_init: out of memory");
+        return -1;
+    }
 
-    struct in6_addr cur = subnet->pool_start_bin;
-    struct in6_addr end = subnet->pool_end_bin;
-
-    char s_start[INET6_ADDRSTRLEN], s_end[INET6_ADDRSTRLEN];
-    inet_ntop(AF_INET6, &cur, s_start, sizeof(s_start));
-    inet_ntop(AF_INET6, &end, s_end, sizeof(s_end));
-    int iterations = 0;
-
-   while (ipv6_compare(&cur, &end) <= 0) {
-        
-
-        
-        // Limit processing to prevent infinite loops on large ranges
-        if (iterations++ > 50000) {
-            log_warn("Pool init limit reached (50k IPs), stopping.");
-            break;
-        }
-
-        if (pool->pool_size >= MAX_POOL6_SIZE) {
-            log_info("Pool full (capped at %d)", MAX_POOL6_SIZE);
-            break;
-        }
-
-        struct ip6_pool_entry_t* e = &pool->entries[pool->pool_size++];
-        memset(e, 0, sizeof(*e));
-        e->ip_address = cur;
-        e->state = IP6_STATE_AVAILABLE;
-        pool->available_count++;
-
-        // Increment
-        if (!ipv6_increment(&cur)) {
-            break; 
-        }
+    uint64_t s_hi, s_lo, e_hi, e_lo;
+    addr_split(&subnet->pool_start_bin, &s_hi, &s_lo);
+    addr_split(&subnet->pool_end_bin, &e_hi, &e_lo);
+    uint64_t span_hi = e_hi - s_hi - (e_lo < s_lo);
+    pool->range_span = e_lo - s_lo;
+    if (span_hi) {
+        pool->range_span = UINT64_MAX;
+        log_warn("ip6_pool_init: range wider than 2^64 addresses, picking from the first 2^64");
     }
+    pool->pool_size = pool->range_span == UINT64_MAX ? UINT64_MAX : pool->range_span + 1;
+    pool->available_count = pool->pool_size;
 
     if (db) (void)ip6_pool_sync_with_leases(pool, db);
 
@@ -248,8 +421,8 @@ int ip6_pool_init(struct ip6_pool_t* pool, dhcpv6_subnet_t* subnet, lease_v6_db_
                                   h->duid[0] ? h->duid : NULL);
     }
 
-    log_info("ip6_pool_init: size=%u available=%u allocated=%u reserved=%u",
-             pool->pool_size, pool->available_count,
+    log_info("ip6_pool_init: size=%llu available=%llu allocated=%u reserved=%u",
+             (unsigned long long)pool->pool_size, (unsigned long long)pool->available_count,
              pool->allocated_count, pool->reserved_count);
     return 0;
 }
@@ -257,108 +430,98 @@ int ip6_pool_init(struct ip6_pool_t* pool, dhcpv6_subnet_t* subnet, lease_v6_db_
 void ip6_pool_free(struct ip6_pool_t* pool)
 {
     if (!pool) return;
+    free(pool->entries);
+    lease_index_free(&pool->addr_index);
+    lease_index_free(&pool->duid_index);
+    pthread_mutex_destroy(&pool->lock);
     memset(pool, 0, sizeof(*pool));
 }
 
 
-int ip6_pool_update_from_lease(struct ip6_pool_t* pool, dhcpv6_lease_t* L)
+// Caller holds pool->lock
+static int update_from_lease_locked(struct ip6_pool_t* pool, const dhcpv6_lease_t* L)
 {
-    if (!pool || !L) return -1;
-    struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, L->ip6_addr);
-    if (!e) return 0; 
-
-   
-    switch (e->state) {
-        case IP6_STATE_AVAILABLE:
-            if (pool->available_count) pool->available_count--;
-            break;
-        case IP6_STATE_ALLOCATED:
-            if (pool->allocated_count) pool->allocated_count--;
-            break;
-        case IP6_STATE_RESERVED:
-            if (pool->reserved_count) pool->reserved_count--;
-            break;
-        default:
-            break;
-    }
+    if (!ip6_pool_is_in_range(pool, L->ip6_addr)) return 0;
 
     ip6_state_t ns = ip6_state_from_lease_state(L->state);
-    e->state = ns;
-
-   if (ns == IP6_STATE_ALLOCATED || ns == IP6_STATE_RESERVED) {
-        if (L->duid_len > 0) {
-            if (duid_bin_to_hex(L->duid, L->duid_len, e->duid, sizeof(e->duid)) < 0) {
-                e->duid[0] = '\0';
-            }
-        } else {
-            e->duid[0] = '\0';
-        }
-    } else {
-        e->duid[0] = '\0';
+    uint32_t slot = entry_slot(pool, &L->ip6_addr);
+    if (slot == UINT32_MAX) {
+        if (ns == IP6_STATE_AVAILABLE) return 0;
+        slot = entry_materialize(pool, &L->ip6_addr);
+        if (slot == UINT32_MAX) return -1;
     }
 
-    switch (ns) {
-        case IP6_STATE_AVAILABLE:
-            pool->available_count++;
-            break;
-        case IP6_STATE_ALLOCATED:
-            pool->allocated_count++;
-            e->last_allocated = L->starts;
-            break;
-        case IP6_STATE_RESERVED:
-            pool->reserved_count++;
-            break;
-        default:
-            break;
+    char duid[DUID_MAX_LEN];
+    duid[0] = '\0';
+    if ((ns == IP6_STATE_ALLOCATED || ns == IP6_STATE_RESERVED) && L->duid_len > 0) {
+        if (duid_bin_to_hex(L->duid, L->duid_len, duid, sizeof(duid)) < 0) duid[0] = '\0';
     }
+    entry_set_duid(pool, slot, duid);
 
-   
+    struct ip6_pool_entry_t* e = entry_set_state(pool, slot, ns);
+    if (e && ns == IP6_STATE_ALLOCATED) e->last_allocated = L->starts;
     return 0;
 }
 
+int ip6_pool_update_from_lease(struct ip6_pool_t* pool, const dhcpv6_lease_t* L)
+{
+    if (!pool || !L) return -1;
+    pthread_mutex_lock(&pool->lock);
+    int rc = update_from_lease_locked(pool, L);
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
+static void sync_one_lease(const dhcpv6_lease_t* L, void* arg)
+{
+    (void)update_from_lease_locked((struct ip6_pool_t*)arg, L);
+}
+
 int ip6_pool_sync_with_leases(struct ip6_pool_t* pool, lease_v6_db_t* db)
 {
     if (!pool || !db) return -1;
-    for (uint32_t i = 0; i < db->count; ++i) {
-        if (!db->leases[i].in_use) continue;
-        (void)ip6_pool_update_from_lease(pool, &db->leases[i]);
-    }
+    pthread_mutex_lock(&pool->lock);
+    lease_v6_db_for_each(db, sync_one_lease, pool);
+    pthread_mutex_unlock(&pool->lock);
     return 0;
 }
 
 
 
-int ip6_pool_mark_conflict(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db, const char* reason)
+// Caller holds pool->lock
+static int mark_conflict_locked(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db, const char* reason)
 {
-    if (!pool) return -1;
-    struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, ip);
-    if (!e) return -1;
+    if (!ip6_pool_is_in_range(pool, ip)) return -1;
+    uint32_t slot = entry_materialize(pool, &ip);
+    if (slot == UINT32_MAX) return -1;
 
-    if (e->state == IP6_STATE_AVAILABLE && pool->available_count) pool->available_count--;
-    if (e->state == IP6_STATE_ALLOCATED && pool->allocated_count) pool->allocated_count--;
-    if (e->state == IP6_STATE_RESERVED  && pool->reserved_count)  pool->reserved_count--;
-
-    e->state = IP6_STATE_CONFLICT;
+    (void)entry_set_state(pool, slot, IP6_STATE_CONFLICT);
 
     if (db) (void)lease_v6_mark_conflict(db, &ip, reason ? reason : "probe");
     return 0;
 }
 
+int ip6_pool_mark_conflict(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db, const char* reason)
+{
+    if (!pool) return -1;
+    pthread_mutex_lock(&pool->lock);
+    int rc = mark_conflict_locked(pool, ip, db, reason);
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
 int ip6_pool_release_ip(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db_t* db)
 {
     if (!pool) return -1;
-    struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, ip);
-    if (!e) return -1;
+    pthread_mutex_lock(&pool->lock);
+    if (!ip6_pool_is_in_range(pool, ip)) { pthread_mutex_unlock(&pool->lock); return -1; }
 
-    if (e->state == IP6_STATE_ALLOCATED) {
-        if (pool->allocated_count) pool->allocated_count--;
-        pool->available_count++;
-        e->state = IP6_STATE_AVAILABLE;
-        e->duid[0] = '\0';
-        e->last_allocated = 0;
-    }
+    uint32_t slot = entry_slot(pool, &ip);
+    if (slot != UINT32_MAX && pool->entries[slot].state == IP6_STATE_ALLOCATED)
+        (void)entry_set_state(pool, slot, IP6_STATE_AVAILABLE);
 
     if (db) (void)lease_v6_release_ip(db, &ip);
+    pthread_mutex_unlock(&pool->lock);
     return 0;
 }
 
@@ -367,27 +530,68 @@ int ip6_pool_release_ip(struct ip6_pool_t* pool, struct in6_addr ip, lease_v6_db
 int ip6_pool_reserve_ip(struct ip6_pool_t* pool, struct in6_addr ip, const char* duid)
 {
     if (!pool) return -1;
-    struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, ip);
-    if (!e) return -1;
+    pthread_mutex_lock(&pool->lock);
+    uint32_t slot = ip6_pool_is_in_range(pool, ip) ? entry_materialize(pool, &ip) : UINT32_MAX;
+    if (slot == UINT32_MAX) { pthread_mutex_unlock(&pool->lock); return -1; }
 
-    if (e->state == IP6_STATE_AVAILABLE && pool->available_count) pool->available_count--;
-    if (e->state == IP6_STATE_ALLOCATED && pool->allocated_count) pool->allocated_count--;
-    if (e->state == IP6_STATE_RESERVED  && pool->reserved_count)  pool->reserved_count--;
-
-    e->state = IP6_STATE_RESERVED;
+    struct ip6_pool_entry_t* e = entry_set_state(pool, slot, IP6_STATE_RESERVED);
     e->last_allocated = time(NULL);
 
-    if (duid && *duid) {
-        e->duid[0] = '\0';
-        strncpy(e->duid, duid, sizeof(e->duid)-1);
-    }
+    if (duid && *duid) entry_set_duid(pool, slot, duid);
 
-    pool->reserved_count++;
+    pthread_mutex_unlock(&pool->lock);
     return 0;
 }
 
 
 
+// Caller holds pool->lock. Hands the address to the client, counters
+// follow. Returns the entry, NULL when out of memory.
+static struct ip6_pool_entry_t* claim_entry(struct ip6_pool_t* pool, struct in6_addr ip, const char* duid)
+{
+    uint32_t slot = entry_materialize(pool, &ip);
+    if (slot == UINT32_MAX) return NULL;
+    struct ip6_pool_entry_t* e = entry_set_state(pool, slot, IP6_STATE_ALLOCATED);
+    e->last_allocated = time(NULL);
+    entry_set_duid(pool, slot, duid);
+    return e;
+}
+
+// Caller holds pool->lock. Undoes claim_entry() when the lease cannot be stored.
+static void drop_claim(struct ip6_pool_t* pool, struct in6_addr ip)
+{
+    uint32_t slot = entry_slot(pool, &ip);
+    if (slot != UINT32_MAX) (void)entry_set_state(pool, slot, IP6_STATE_AVAILABLE);
+}
+
+// Caller holds pool->lock and has claimed the address: nobody else picks it
+// while the probe runs with the pool unlocked. Returns with the lock held;
+// *lost is set if the address changed hands meanwhile (a lease sync).
+static bool probe_claimed(struct ip6_pool_t* pool, struct in6_addr ip, const char* duid,
+                          uint32_t timeout_ms, bool* lost)
+{
+    pthread_mutex_unlock(&pool->lock);
+    bool conflict = ip6_ping_check(ip, timeout_ms);
+    pthread_mutex_lock(&pool->lock);
+    // Entries move while the pool is unlocked: look the address up again
+    const struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, ip);
+    *lost = !(e && e->state == IP6_STATE_ALLOCATED && strncmp(e->duid, duid, sizeof(e->duid)-1) == 0);
+    return conflict && !*lost;
+}
+
+// Caller holds pool->lock. Entry of the address allocated to a DUID, if any.
+static struct ip6_pool_entry_t* find_by_duid(struct ip6_pool_t* pool, const char* duid)
+{
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&pool->duid_index, hash_duid(duid), &it);
+    while (lease_index_next(&pool->duid_index, &it, &slot)) {
+        struct ip6_pool_entry_t* e = &pool->entries[slot];
+        if (e->state == IP6_STATE_ALLOCATED && strcmp(e->duid, duid) == 0) return e;
+    }
+    return NULL;
+}
+
 struct ip6_allocation_result_t
 ip6_pool_allocate(struct ip6_pool_t* pool,
                   const char* duid,
@@ -409,127 +613,115 @@ ip6_pool_allocate(struct ip6_pool_t* pool,
     bool do_probe=false;
     uint32_t tmo=0;
     get_effective_probe(config, pool->subnet, &do_probe, &tmo);
+    bool lost = false;
 
+    pthread_mutex_lock(&pool->lock);
   
     for (uint16_t i = 0; i < pool->subnet->host_count; ++i) {
         const dhcpv6_static_host_t* h = &pool->subnet->hosts[i];
         if (!h->has_fixed_address6_bin) continue;
         if (h->duid[0] && strcmp(h->duid, duid) == 0) {
-            struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, h->fixed_addr6_bin);
-            if (!e) break;
+            struct in6_addr ip = h->fixed_addr6_bin;
+            if (!ip6_pool_is_in_range(pool, ip)) break;
 
-            if (do_probe && ip6_ping_check(e->ip_address, tmo)) {
-                R.err_is_conflict = true; R.conflict_ip = e->ip_address; R.conflict_reason = "icmp6 echo reply";
-                (void)ip6_pool_mark_conflict(pool, e->ip_address, db, R.conflict_reason);
+            if (!claim_entry(pool, ip, duid)) {
+                snprintf(R.error_message, sizeof(R.error_message), "out of memory");
+                goto out;
+            }
+            if (do_probe && probe_claimed(pool, ip, duid, tmo, &lost)) {
+                R.err_is_conflict = true; R.conflict_ip = ip; R.conflict_reason = "icmp6 echo reply";
+                (void)mark_conflict_locked(pool, ip, db, R.conflict_reason);
                 snprintf(R.error_message, sizeof(R.error_message), "conflict on reserved address");
-                return R;
+                goto out;
+            }
+            if (lost) {
+                snprintf(R.error_message, sizeof(R.error_message), "reserved address changed during probe");
+                goto out;
             }
 
-           
-            if (e->state == IP6_STATE_AVAILABLE && pool->available_count) pool->available_count--;
-            if (e->state == IP6_STATE_RESERVED  && pool->reserved_count)  pool->reserved_count--;
-            if (e->state != IP6_STATE_ALLOCATED) pool->allocated_count++;
-            e->state = IP6_STATE_ALLOCATED;
-            e->last_allocated = time(NULL);
-            strncpy(e->duid, duid, sizeof(e->duid)-1);
-
-          
-            if (!lease_v6_add_ia_na(db, duid, duid_len, iaid, &e->ip_address, lease_time, hostname_opt)) {
-              
-                e->state = IP6_STATE_AVAILABLE;
-                e->duid[0] = '\0';
-                if (pool->allocated_count) pool->allocated_count--;
-                pool->available_count++;
+            if (lease_v6_add_ia_na(db, duid, duid_len, iaid, &ip, lease_time, hostname_opt) != 0) {
+                drop_claim(pool, ip);
                 snprintf(R.error_message, sizeof(R.error_message), "lease persist failed");
-                return R;
+                goto out;
             }
-            R.success = true; R.ip_address = e->ip_address;
-            return R;
+            R.success = true; R.ip_address = ip;
+            goto out;
         }
     }
 
    
     // Check for existing allocation for this DUID
-    for (uint32_t i = 0; i < pool->pool_size; ++i) {
-        struct ip6_pool_entry_t* e = &pool->entries[i];
-        if (e->state == IP6_STATE_ALLOCATED && e->duid[0] && strcmp(e->duid, duid) == 0) {
-             if (!lease_v6_add_ia_na(db, duid, duid_len, iaid, &e->ip_address, lease_time, hostname_opt)) {
-                    snprintf(R.error_message, sizeof(R.error_message), "lease refresh failed");
-             }
-            R.success = true; 
-            R.is_new = false; 
-            R.ip_address = e->ip_address; 
-            return R;
+    struct ip6_pool_entry_t* cur = find_by_duid(pool, duid);
+    if (cur) {
+        if (lease_v6_add_ia_na(db, duid, duid_len, iaid, &cur->ip_address, lease_time, hostname_opt) != 0) {
+            snprintf(R.error_message, sizeof(R.error_message), "lease refresh failed");
         }
+        R.success = true; 
+        R.is_new = false; 
+        R.ip_address = cur->ip_address; 
+        goto out;
     }
 
    
     if (!IN6_IS_ADDR_UNSPECIFIED(&requested_ip)) {
-        if (ip6_pool_is_in_range(pool, requested_ip) && ip6_pool_is_available(pool, requested_ip)) {
-            if (do_probe && ip6_ping_check(requested_ip, tmo)) {
+        if (is_available_locked(pool, requested_ip)) {
+            if (!claim_entry(pool, requested_ip, duid)) {
+                snprintf(R.error_message, sizeof(R.error_message), "out of memory");
+                goto out;
+            }
+            if (do_probe && probe_claimed(pool, requested_ip, duid, tmo, &lost)) {
                 R.err_is_conflict=true; R.conflict_ip=requested_ip; R.conflict_reason="icmp6 echo reply";
-                (void)ip6_pool_mark_conflict(pool, requested_ip, db, R.conflict_reason);
+                (void)mark_conflict_locked(pool, requested_ip, db, R.conflict_reason);
                 snprintf(R.error_message, sizeof(R.error_message), "conflict on requested address");
-                return R;
+                goto out;
             }
 
-            struct ip6_pool_entry_t* e = ip6_pool_find_entry(pool, requested_ip);
-            if (e) {
-                
-                if (e->state == IP6_STATE_AVAILABLE && pool->available_count) pool->available_count--;
-                if (e->state == IP6_STATE_RESERVED  && pool->reserved_count)  pool->reserved_count--;
-                pool->allocated_count++;
-                e->state = IP6_STATE_ALLOCATED;
-                e->last_allocated = time(NULL);
-                strncpy(e->duid, duid, sizeof(e->duid)-1);
-
-                if (!lease_v6_add_ia_na(db, duid, duid_len, iaid, &e->ip_address, lease_time, hostname_opt)) {
-                    e->state = IP6_STATE_AVAILABLE;
-                    e->duid[0] = '\0';
-                    if (pool->allocated_count) pool->allocated_count--;
-                    pool->available_count++;
+            // A lost claim falls through to picking another address
+            if (!lost) {
+                if (lease_v6_add_ia_na(db, duid, duid_len, iaid, &requested_ip, lease_time, hostname_opt) != 0) {
+                    drop_claim(pool, requested_ip);
                     snprintf(R.error_message, sizeof(R.error_message), "lease persist failed");
-                    return R;
+                    goto out;
                 }
                 R.success = true; 
                 R.is_new = true;
-                R.ip_address = e->ip_address; return R;
+                R.ip_address = requested_ip;
+                goto out;
             }
         }
     }
 
-    for (uint32_t i = 0; i < pool->pool_size; ++i) {
-        struct ip6_pool_entry_t* e = &pool->entries[i];
-        if (e->state != IP6_STATE_AVAILABLE) continue;
-
-        if (do_probe && ip6_ping_check(e->ip_address, tmo)) {
-            (void)ip6_pool_mark_conflict(pool, e->ip_address, db, "icmp6 echo reply");
+    // Candidates follow from the client: it is offered the same address
+    // again as long as that address stays free
+    uint64_t seed = ((uint64_t)hash_duid(duid) << 32) | iaid;
+    struct in6_addr ip;
+    for (uint32_t claims = 0; claims < IP6_POOL_MAX_CLAIMS && pick_free(pool, seed, &ip); claims++) {
+        if (!claim_entry(pool, ip, duid)) {
+            snprintf(R.error_message, sizeof(R.error_message), "out of memory");
+            goto out;
+        }
+        if (do_probe && probe_claimed(pool, ip, duid, tmo, &lost)) {
+            // Now CONFLICT: the next pick skips it
+            (void)mark_conflict_locked(pool, ip, db, "icmp6 echo reply");
             continue;
         }
+        if (lost) continue;
 
-        if (pool->available_count) pool->available_count--;
-        pool->allocated_count++;
-        e->state = IP6_STATE_ALLOCATED;
-        e->last_allocated = time(NULL);
-        strncpy(e->duid, duid, sizeof(e->duid)-1);
-
-        if (!lease_v6_add_ia_na(db, duid, duid_len, iaid, &e->ip_address, lease_time, hostname_opt)) {
-            e->state = IP6_STATE_AVAILABLE;
-            e->duid[0] = '\0';
-            if (pool->allocated_count) pool->allocated_count--;
-            pool->available_count++;
+        if (lease_v6_add_ia_na(db, duid, duid_len, iaid, &ip, lease_time, hostname_opt) != 0) {
+            drop_claim(pool, ip);
             snprintf(R.error_message, sizeof(R.error_message), "lease persist failed");
-            continue;
+            goto out;
         }
         R.success = true;
         R.is_new = true;
-        R.ip_address = e->ip_address; 
-        goto end_and_save;
+        R.ip_address = ip; 
+        goto out;
     }
     
     snprintf(R.error_message, sizeof(R.error_message), "no free addresses");
 
-end_and_save:
+out:
+    pthread_mutex_unlock(&pool->lock);
     return R;
 }
 
@@ -543,12 +735,13 @@ void ip6_pool_print_stats(const struct ip6_pool_t* pool)
     inet_ntop(AF_INET6, &pool->subnet->prefix_bin, pfx, sizeof(pfx));
     printf("\n--- IPv6 Pool Statistics ---\n");
     printf("Subnet: %s/%u\n", pfx, pool->subnet->prefix_len);
-    printf("Pool Size: %u\n", pool->pool_size);
-    printf("Available: %u\n", pool->available_count);
+    printf("Pool Size: %llu\n", (unsigned long long)pool->pool_size);
+    printf("Available: %llu\n", (unsigned long long)pool->available_count);
     printf("Allocated: %u\n", pool->allocated_count);
     printf("Reserved:  %u\n", pool->reserved_count);
+    printf("Tracked entries: %u\n", pool->entry_count);
     printf("Utilization: %.1f%%\n",
-           pool->pool_size ? (pool->allocated_count * 100.0 / pool->pool_size) : 0.0);
+           pool->pool_size ? (pool->allocated_count * 100.0 / (double)pool->pool_size) : 0.0);
 }
 
 void ip6_pool_print_detailed(const struct ip6_pool_t* pool)
@@ -556,8 +749,8 @@ void ip6_pool_print_detailed(const struct ip6_pool_t* pool)
     if (!pool) return;
     ip6_pool_print_stats(pool);
 
-    printf("\n--- IPv6 Pool Entries ---\n");
-    for (uint32_t i = 0; i < pool->pool_size; ++i) {
+    printf("\n--- IPv6 Pool Entries (all other addresses available) ---\n");
+    for (uint32_t i = 0; i < pool->entry_count; ++i) {
         const struct ip6_pool_entry_t* e = &pool->entries[i];
         char ip[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &e->ip_address, ip, sizeof(ip));
@@ -567,4 +760,4 @@ void ip6_pool_print_detailed(const struct ip6_pool_t* pool)
         }
         printf("\n");
     }
-}
\ No newline at end of file
+}
@@ -18,6 +18,7 @@
 
 #define READ_BUF_SZ (1<<16)
 #define WR_TMP_MAX 8192
+#define LEASE6_TEXT_BYTES_ESTIMATE 200 // Typical size of one record in the file
 
 typedef struct
 {
@@ -56,8 +57,10 @@ static time_t parse_lease_time_any(const char* s)
 
     // 1) epoch numeric: "starts %lld;"
     {
+        // The whole value: "5 2025/..." is a weekday and a date, not epoch 5
         long long t = 0;
-        if (sscanf(s, "%lld", &t) == 1 && t > 0) {
+        int n = 0;
+        if (sscanf(s, "%lld%n", &t, &n) == 1 && s[n] == '\0' && t > 0) {
             return (time_t)t;
         }
     }
@@ -227,21 +230,326 @@ bool lease_v6_is_expired(const dhcpv6_lease_t* L)
     return (L->state == LEASE_STATE_ACTIVE && L->ends < now);
 }
 
+/* ---- shards ---- */
+
+// Shard of an address (IA_NA, plen 128) or of a delegated prefix
+static lease_v6_shard_t* shard_for(lease_v6_db_t* db, const struct in6_addr* key, uint8_t plen)
+{
+    uint64_t hi, lo;
+    memcpy(&hi, key->s6_addr, sizeof(hi));
+    memcpy(&lo, key->s6_addr + 8, sizeof(lo));
+    // Pool addresses differ only in a few bytes, anywhere in the 128 bits:
+    // mix every input bit into the shard index (murmur3 finalizer)
+    uint64_t h = hi * 0x9E3779B97F4A7C15ULL ^ lo ^ plen;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return &db->shards[h % LEASE_V6_SHARDS];
+}
+
+static inline const struct in6_addr* lease_key(const dhcpv6_lease_t* L, uint8_t* plen)
+{
+    *plen = (L->type == Lease6_IA_NA) ? 128 : L->plen;
+    return (L->type == Lease6_IA_NA) ? &L->ip6_addr : &L->prefix_v6;
+}
+
+static inline dhcpv6_lease_t* shard_get(const lease_v6_shard_t* sh, uint32_t slot)
+{
+    return &sh->chunks[slot >> LEASE_V6_CHUNK_SHIFT][slot & (LEASE_V6_CHUNK_SIZE - 1)];
+}
+
+/* ---- hash indexes ---- */
+
+static inline uint32_t hash_key(lease_v6_type_t type, const struct in6_addr* key, uint8_t plen)
+{
+    uint64_t hi, lo;
+    memcpy(&hi, key->s6_addr, sizeof(hi));
+    memcpy(&lo, key->s6_addr + 8, sizeof(lo));
+    return lease_index_hash_u64(lease_index_hash_u64(hi) ^ lo ^ ((uint64_t)plen << 1 | type));
+}
+
+static inline uint32_t hash_client(const uint8_t* duid, uint16_t duid_len, uint32_t iaid, lease_v6_type_t type)
+{
+    uint64_t h = (uint64_t)(lease_index_hash_bytes(duid, duid_len) ^ type) << 32 | iaid;
+    return lease_index_hash_u64(h);
+}
+
+static inline uint32_t lease_hash_key(const dhcpv6_lease_t* L)
+{
+    uint8_t plen;
+    const struct in6_addr* key = lease_key(L, &plen);
+    return hash_key(L->type, key, plen);
+}
+
+static inline uint32_t lease_hash_client(const dhcpv6_lease_t* L)
+{
+    return hash_client(L->duid, L->duid_len, L->iaid, L->type);
+}
+
+/* ---- client directory ---- */
+
+// A directory entry packs the slot and the shard of a lease
+#define CLIENT_SHARD_BITS 4
+_Static_assert(LEASE_V6_SHARDS == 1 << CLIENT_SHARD_BITS, "client directory entries hold a shard number");
+
+static inline uint32_t client_loc(const lease_v6_db_t* db, const lease_v6_shard_t* sh, uint32_t slot)
+{
+    return slot << CLIENT_SHARD_BITS | (uint32_t)(sh - db->shards);
+}
+
+// The top bits pick the stripe: the stripe's index probes from the low ones
+static inline lease_v6_client_stripe_t* client_stripe(lease_v6_db_t* db, uint32_t hash)
+{
+    return &db->clients[hash >> (32 - CLIENT_SHARD_BITS)];
+}
+
+// Caller holds sh->lock
+static int client_link(lease_v6_db_t* db, lease_v6_shard_t* sh, uint32_t slot, uint32_t hash)
+{
+    lease_v6_client_stripe_t* cs = client_stripe(db, hash);
+    pthread_mutex_lock(&cs->lock);
+    int rc = lease_index_insert(&cs->index, hash, client_loc(db, sh, slot));
+    pthread_mutex_unlock(&cs->lock);
+    return rc;
+}
+
+// Caller holds sh->lock
+static void client_unlink(lease_v6_db_t* db, lease_v6_shard_t* sh, uint32_t slot, uint32_t hash)
+{
+    lease_v6_client_stripe_t* cs = client_stripe(db, hash);
+    pthread_mutex_lock(&cs->lock);
+    lease_index_remove(&cs->index, hash, client_loc(db, sh, slot));
+    pthread_mutex_unlock(&cs->lock);
+}
+
+static void client_link_or_log(lease_v6_db_t* db, lease_v6_shard_t* sh, uint32_t slot)
+{
+    const dhcpv6_lease_t* L = shard_get(sh, slot);
+    if (client_link(db, sh, slot, lease_hash_client(L)) != 0)
+        log_error("v6-db: out of memory, lease %s not found by DUID until the next load",
+                  L->type == Lease6_IA_NA ? L->ip6_addr_str : L->prefix_str);
+}
+
+// The DUID, IAID or type of a stored lease may change: take client_hash()
+// before and pass it to client_relink() after. The entry is only replaced
+// when the client did change, so a renewal never hides the lease from
+// lookups by client.
+static inline uint32_t client_hash(const lease_v6_shard_t* sh, uint32_t slot)
+{
+    return lease_hash_client(shard_get(sh, slot));
+}
+
+static void client_relink(lease_v6_db_t* db, lease_v6_shard_t* sh, uint32_t slot, uint32_t old_hash)
+{
+    if (client_hash(sh, slot) == old_hash) return;
+    client_link_or_log(db, sh, slot);
+    client_unlink(db, sh, slot, old_hash);
+}
+
+// Add the index entries of the lease in slot; on failure nothing stays linked
+static int index_link(lease_v6_db_t* db, lease_v6_shard_t* sh, uint32_t slot)
+{
+    const dhcpv6_lease_t* L = shard_get(sh, slot);
+    if (lease_index_insert(&sh->key_index, lease_hash_key(L), slot) != 0) return -1;
+    if (client_link(db, sh, slot, lease_hash_client(L)) != 0) {
+        lease_index_remove(&sh->key_index, lease_hash_key(L), slot);
+        return -1;
+    }
+    return 0;
+}
+
+// Rebuild the key index of a shard from its store (after slots were moved)
+static int key_index_rebuild(lease_v6_shard_t* sh)
+{
+    lease_index_clear(&sh->key_index);
+    for (uint32_t i = 0; i < sh->count; i++)
+        if (lease_index_insert(&sh->key_index, lease_hash_key(shard_get(sh, i)), i) != 0) return -1;
+    return 0;
+}
+
+/* ---- shards ---- */
+
+// Caller holds sh->lock. Returns the slot, or UINT32_MAX if not stored.
+static uint32_t shard_find(const lease_v6_shard_t* sh, lease_v6_type_t type, const struct in6_addr* key, uint8_t plen)
+{
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&sh->key_index, hash_key(type, key, plen), &it);
+    while (lease_index_next(&sh->key_index, &it, &slot)) {
+        const dhcpv6_lease_t* L = shard_get(sh, slot);
+        if (!L->in_use || L->type != type) continue;
+        if (type == Lease6_IA_NA) {
+            if (memcmp(&L->ip6_addr, key, sizeof(*key)) == 0) return slot;
+        } else if (L->plen == plen && memcmp(&L->prefix_v6, key, sizeof(*key)) == 0) {
+            return slot;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Make room for one more lease, allocating a new chunk when the last one is full
+static int shard_reserve(lease_v6_db_t* db, lease_v6_shard_t* sh)
+{
+    if (sh->count < sh->chunk_count * LEASE_V6_CHUNK_SIZE) return 0;
+
+    if (sh->chunk_count == sh->chunk_capacity) {
+        uint32_t cap = sh->chunk_capacity ? sh->chunk_capacity * 2 : 8;
+        dhcpv6_lease_t** chunks = realloc(sh->chunks, cap * sizeof(*chunks));
+        if (!chunks) return -1;
+        sh->chunks = chunks;
+        sh->chunk_capacity = cap;
+    }
+    dhcpv6_lease_t* chunk = malloc(LEASE_V6_CHUNK_SIZE * sizeof(*chunk));
+    if (!chunk) return -1;
+    sh->chunks[sh->chunk_count++] = chunk;
+    __atomic_add_fetch(&db->capacity, LEASE_V6_CHUNK_SIZE, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// Release chunks no longer needed after the shard shrank (one spare is kept)
+static void shard_trim(lease_v6_db_t* db, lease_v6_shard_t* sh)
+{
+    uint32_t needed = (sh->count + LEASE_V6_CHUNK_SIZE - 1) / LEASE_V6_CHUNK_SIZE + 1;
+    while (sh->chunk_count > needed) {
+        free(sh->chunks[--sh->chunk_count]);
+        __atomic_sub_fetch(&db->capacity, LEASE_V6_CHUNK_SIZE, __ATOMIC_RELAXED);
+    }
+}
+
+// Caller holds sh->lock. Stores a copy of @p tmp and indexes it. Returns the
+// slot, or UINT32_MAX when out of memory.
+static uint32_t shard_add(lease_v6_db_t* db, lease_v6_shard_t* sh, const dhcpv6_lease_t* tmp)
+{
+    if (shard_reserve(db, sh) != 0) return UINT32_MAX;
+    uint32_t slot = sh->count;
+    *shard_get(sh, slot) = *tmp;
+    if (index_link(db, sh, slot) != 0) return UINT32_MAX;
+    sh->count++;
+    __atomic_add_fetch(&db->count, 1, __ATOMIC_RELAXED);
+    return slot;
+}
+
+// Caller holds sh->lock. Returns the lease stored under the key, or a new
+// one holding just the key, in use; NULL when out of memory. *slot_out
+// receives its slot.
+static dhcpv6_lease_t* shard_find_or_add(lease_v6_db_t* db, lease_v6_shard_t* sh, lease_v6_type_t type,
+                                         const struct in6_addr* key, uint8_t plen, uint32_t* slot_out)
+{
+    uint32_t slot = shard_find(sh, type, key, plen);
+    if (slot == UINT32_MAX) {
+        dhcpv6_lease_t tmp;
+        memset(&tmp, 0, sizeof(tmp));
+        tmp.in_use = 1;
+        tmp.type = type;
+        if (type == Lease6_IA_NA) {
+            tmp.ip6_addr = *key;
+            in6_to_str(key, tmp.ip6_addr_str, sizeof(tmp.ip6_addr_str));
+        } else {
+            tmp.prefix_v6 = *key;
+            tmp.plen = plen;
+            in6_to_str(key, tmp.prefix_str, sizeof(tmp.prefix_str));
+        }
+        slot = shard_add(db, sh, &tmp);
+        if (slot == UINT32_MAX) return NULL;
+    }
+    *slot_out = slot;
+    return shard_get(sh, slot);
+}
+
 int lease_v6_db_init(lease_v6_db_t* db, const char* path)
 {
     if(!db || !path) return -1;
     memset(db, 0, sizeof(*db));
     strncpy(db->filename,path, sizeof(db->filename)-1);
-    db->capacity=128;
+
+    for (int i = 0; i < LEASE_V6_SHARDS; i++) {
+        lease_v6_shard_t* sh = &db->shards[i];
+        lease_v6_client_stripe_t* cs = &db->clients[i];
+        if (lease_index_init(&sh->key_index, LEASES6_MAX / LEASE_V6_SHARDS) != 0 ||
+            lease_index_init(&cs->index, LEASES6_MAX / LEASE_V6_SHARDS) != 0) {
+            for (int j = 0; j <= i; j++) {
+                lease_index_free(&db->shards[j].key_index);
+                lease_index_free(&db->clients[j].index);
+            }
+            log_error("v6-db: out of memory");
+            return -1;
+        }
+        pthread_mutex_init(&sh->lock, NULL);
+        pthread_mutex_init(&cs->lock, NULL);
+    }
+    pthread_mutex_init(&db->save_lock, NULL);
+
+    // A save waiting to swap the file must not starve behind a stream of appends
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&db->file_lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    // Read-write so that a save can copy what was appended while it wrote
+    db->append_fd = open(db->filename, O_RDWR|O_CREAT|O_APPEND|O_CLOEXEC, 0644);
+    if (db->append_fd < 0)
+        log_warn("v6-db: open(%s) for append failed: %s", db->filename, strerror(errno));
+
     log_info("v6-db init file=%s", db->filename);
     return 0;
 }
 
+int lease_v6_db_reserve(lease_v6_db_t* db, uint32_t lease_count)
+{
+    if (!db) return -1;
+
+    // Keys spread evenly over the shards; leave some room for the unlucky ones
+    uint32_t per_shard = lease_count / LEASE_V6_SHARDS;
+    per_shard += per_shard / 8 + 1;
+
+    uint32_t chunks = (per_shard + LEASE_V6_CHUNK_SIZE - 1) / LEASE_V6_CHUNK_SIZE;
+    for (int i = 0; i < LEASE_V6_SHARDS; i++) {
+        lease_v6_shard_t* sh = &db->shards[i];
+        pthread_mutex_lock(&sh->lock);
+        int rc = 0;
+        if (chunks > sh->chunk_capacity) {
+            dhcpv6_lease_t** grown = realloc(sh->chunks, chunks * sizeof(*grown));
+            if (grown) {
+                sh->chunks = grown;
+                sh->chunk_capacity = chunks;
+            } else rc = -1;
+        }
+        if (rc == 0 && lease_index_reserve(&sh->key_index, per_shard) != 0)
+            rc = -1;
+        pthread_mutex_unlock(&sh->lock);
+        if (rc != 0) return -1;
+
+        // Clients spread over the stripes as evenly as keys over the shards
+        lease_v6_client_stripe_t* cs = &db->clients[i];
+        pthread_mutex_lock(&cs->lock);
+        rc = lease_index_reserve(&cs->index, per_shard);
+        pthread_mutex_unlock(&cs->lock);
+        if (rc != 0) return -1;
+    }
+    return 0;
+}
+
 void lease_v6_db_free(lease_v6_db_t* db)
 {
     if(!db) return;
     log_info("v6-db free (count=%u)",db->count);
+    if (db->append_fd >= 0) close(db->append_fd);
+    for (int i = 0; i < LEASE_V6_SHARDS; i++) {
+        lease_v6_shard_t* sh = &db->shards[i];
+        for (uint32_t c = 0; c < sh->chunk_count; c++) free(sh->chunks[c]);
+        free(sh->chunks);
+        lease_index_free(&sh->key_index);
+        pthread_mutex_destroy(&sh->lock);
+        lease_index_free(&db->clients[i].index);
+        pthread_mutex_destroy(&db->clients[i].lock);
+    }
+    pthread_mutex_destroy(&db->save_lock);
+    pthread_rwlock_destroy(&db->file_lock);
     memset(db,0,sizeof(*db));
+    db->append_fd = -1;
 }
 
 static int rd_open(rd_ctx_t* R, const char* path)
@@ -369,7 +677,7 @@ static int parse_block_ia_na(rd_ctx_t* R, dhcpv6_lease_t* L, char* line0)
             char hn[HOSTNAME6_MAX];
             if(sscanf(s,"client-hostname \"%127[^\"]\";",hn)==1)
             {
-                strncpy(L->client_hostname,hn,sizeof(L->client_hostname)-1);
+                snprintf(L->client_hostname, sizeof(L->client_hostname), "%s", hn);
             }
         }
         if(!strncmp(s,"binding state",13))
@@ -379,7 +687,7 @@ static int parse_block_ia_na(rd_ctx_t* R, dhcpv6_lease_t* L, char* line0)
             {
                 trim(st);
                 L->state=lease_v6_state_from_string(st);
-                strncpy(L->binding_state,st,sizeof(L->binding_state)-1);
+                snprintf(L->binding_state, sizeof(L->binding_state), "%s", st);
             }
         }
     }
@@ -454,7 +762,7 @@ static int parse_block_ia_pd(rd_ctx_t* R, dhcpv6_lease_t* L, char* line0)
         {
             char hn[HOSTNAME6_MAX];
             if(sscanf(s,"client-hostname \"%127[^\"]\";",hn)==1)
-                strncpy(L->client_hostname,hn,sizeof(L->client_hostname)-1);
+                snprintf(L->client_hostname, sizeof(L->client_hostname), "%s", hn);
         }
         if(!strncmp(s,"binding state",13))
         {
@@ -463,12 +771,36 @@ static int parse_block_ia_pd(rd_ctx_t* R, dhcpv6_lease_t* L, char* line0)
             {
                 trim(st);
                 L->state=lease_v6_state_from_string(st);
-                strncpy(L->binding_state, st, sizeof(L->binding_state)-1);
+                snprintf(L->binding_state, sizeof(L->binding_state), "%s", st);
             }
         }
     }
 }
 
+// Keeps the last record of each address/prefix: the file is a log of changes
+static int load_one(lease_v6_db_t* db, const dhcpv6_lease_t* tmp)
+{
+    uint8_t plen;
+    const struct in6_addr* key = lease_key(tmp, &plen);
+    lease_v6_shard_t* sh = shard_for(db, key, plen);
+
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, tmp->type, key, plen);
+    if (slot != UINT32_MAX) {
+        // Overwrite existing (newer entry in log)
+        uint32_t client = client_hash(sh, slot);
+        *shard_get(sh, slot) = *tmp;
+        shard_get(sh, slot)->in_use = 1;
+        client_relink(db, sh, slot, client);
+    } else {
+        dhcpv6_lease_t rec = *tmp;
+        rec.in_use = 1;
+        slot = shard_add(db, sh, &rec);
+    }
+    pthread_mutex_unlock(&sh->lock);
+    return slot != UINT32_MAX ? 0 : -1;
+}
+
 int lease_v6_db_load(lease_v6_db_t* db)
 {
     if(!db) return -1;
@@ -478,7 +810,12 @@ int lease_v6_db_load(lease_v6_db_t* db)
         log_warn("v6-db: %s not found, starting empty",db->filename);
         return 0;
     }
-    db->count=0;
+
+    // Size the store and indexes once instead of growing them through every
+    // doubling. The file is a log, so this may overshoot until it is compacted.
+    struct stat st;
+    if (fstat(R.fd, &st) == 0 && st.st_size / LEASE6_TEXT_BYTES_ESTIMATE > LEASES6_MAX)
+        (void)lease_v6_db_reserve(db, (uint32_t)(st.st_size / LEASE6_TEXT_BYTES_ESTIMATE));
 
     char line[READ_BUF_SZ];
     while(1)
@@ -493,27 +830,8 @@ int lease_v6_db_load(lease_v6_db_t* db)
             dhcpv6_lease_t tmp;
             if (parse_block_ia_na(&R, &tmp, s) == 0) {
                  if (tmp.starts && tmp.ends) {
-                     // Check for existing
-                     int found = -1;
-                     for(uint32_t i=0; i<db->count; i++) {
-                         if (db->leases[i].type == Lease6_IA_NA && 
-                             memcmp(&db->leases[i].ip6_addr, &tmp.ip6_addr, sizeof(tmp.ip6_addr))==0) {
-                             found = i;
-                             break;
-                         }
-                     }
-                     if (found >= 0) {
-                         // Overwrite existing (newer entry in log)
-                         db->leases[found] = tmp;
-                         db->leases[found].in_use = 1;
-                     } else {
-                         if (db->count < LEASES6_MAX) {
-                             db->leases[db->count++] = tmp; 
-                             db->leases[db->count-1].in_use=1; 
-                         } else {
-                             log_warn("v6-db: DB full, dropping lease %s", s);
-                         }
-                     }
+                     if (load_one(db, &tmp) != 0)
+                         log_warn("v6-db: out of memory, dropping lease %s", tmp.ip6_addr_str);
                  }
                  else log_warn("v6-db: dropping NA w/o time");
             }
@@ -524,28 +842,8 @@ int lease_v6_db_load(lease_v6_db_t* db)
             dhcpv6_lease_t tmp;
             if (parse_block_ia_pd(&R, &tmp, s) == 0) {
                  if (tmp.starts && tmp.ends) {
-                     // Check for existing
-                     int found = -1;
-                     for(uint32_t i=0; i<db->count; i++) {
-                         if (db->leases[i].type == Lease6_IA_PD && 
-                             db->leases[i].plen == tmp.plen &&
-                             memcmp(&db->leases[i].prefix_v6, &tmp.prefix_v6, sizeof(tmp.prefix_v6))==0) {
-                             found = i;
-                             break;
-                         }
-                     }
-                     if (found >= 0) {
-                         // Overwrite
-                         db->leases[found] = tmp;
-                         db->leases[found].in_use = 1;
-                     } else {
-                         if (db->count < LEASES6_MAX) {
-                             db->leases[db->count++] = tmp; 
-                             db->leases[db->count-1].in_use=1; 
-                         } else {
-                             log_warn("v6-db: DB full, dropping prefix %s", s);
-                         }
-                     }
+                     if (load_one(db, &tmp) != 0)
+                         log_warn("v6-db: out of memory, dropping prefix %s/%u", tmp.prefix_str, tmp.plen);
                  }
                  else log_warn("v6-db: dropping PD w/o time");
             }
@@ -557,17 +855,94 @@ int lease_v6_db_load(lease_v6_db_t* db)
     return 0;
 }
 
+// Copies every shard, one at a time under its lock. Returns a malloc'd array.
+static dhcpv6_lease_t* snapshot_leases(lease_v6_db_t* db, uint32_t* out_n)
+{
+    uint32_t cap = __atomic_load_n(&db->count, __ATOMIC_RELAXED) + 64, n = 0;
+    dhcpv6_lease_t* snap = malloc((size_t)cap * sizeof(*snap));
+    if (!snap) return NULL;
+
+    for (int i = 0; i < LEASE_V6_SHARDS; i++) {
+        lease_v6_shard_t* sh = &db->shards[i];
+        pthread_mutex_lock(&sh->lock);
+        if (n + sh->count > cap) {
+            uint32_t ncap = cap * 2 > n + sh->count ? cap * 2 : n + sh->count;
+            dhcpv6_lease_t* grown = realloc(snap, (size_t)ncap * sizeof(*snap));
+            if (!grown) {
+                pthread_mutex_unlock(&sh->lock);
+                free(snap);
+                return NULL;
+            }
+            snap = grown;
+            cap = ncap;
+        }
+        for (uint32_t c = 0; c * LEASE_V6_CHUNK_SIZE < sh->count; c++) {
+            uint32_t k = sh->count - c * LEASE_V6_CHUNK_SIZE;
+            if (k > LEASE_V6_CHUNK_SIZE) k = LEASE_V6_CHUNK_SIZE;
+            memcpy(&snap[n], sh->chunks[c], (size_t)k * sizeof(*snap));
+            n += k;
+        }
+        pthread_mutex_unlock(&sh->lock);
+    }
+    *out_n = n;
+    return snap;
+}
+
+// Caller holds file_lock exclusively
+static off_t journal_size(const lease_v6_db_t* db)
+{
+    struct stat st;
+    if (db->append_fd < 0 || fstat(db->append_fd, &st) < 0) return 0;
+    return st.st_size;
+}
+
+// Copies what was appended to the current file since @p from to @p out_fd.
+// Caller holds file_lock exclusively.
+static int copy_journal_tail(const lease_v6_db_t* db, off_t from, int out_fd)
+{
+    if (db->append_fd < 0) return 0;
+    char buf[WR_TMP_MAX];
+    for (;;) {
+        ssize_t n = pread(db->append_fd, buf, sizeof(buf), from);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return 0;
+        if (write_all(out_fd, buf, (size_t)n) < 0) return -1;
+        from += n;
+    }
+}
+
 int lease_v6_db_save(lease_v6_db_t* db)
 {
     if(!db) return -1;
 
+    pthread_mutex_lock(&db->save_lock);
+
+    // Records appended from here on may be missing from the snapshot: they
+    // are carried over behind it
+    pthread_rwlock_wrlock(&db->file_lock);
+    off_t journal_mark = journal_size(db);
+    pthread_rwlock_unlock(&db->file_lock);
+
+    uint32_t snap_count = 0;
+    dhcpv6_lease_t* snap = snapshot_leases(db, &snap_count);
+    if (!snap) {
+        pthread_mutex_unlock(&db->save_lock);
+        log_error("v6-db: save failed: out of memory");
+        return -1;
+    }
+
     char tmp_path[LEASE6_PATH_MAX + 8];
     snprintf(tmp_path,sizeof(tmp_path),"%s.tmp",db->filename);
 
-    int fd=open(tmp_path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    int fd=open(tmp_path,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
     if(fd<0)
     {
         log_error("v6-db: open(%s) failed:%s",tmp_path, strerror(errno));
+        free(snap);
+        pthread_mutex_unlock(&db->save_lock);
         return -1;
     }
 
@@ -575,6 +950,8 @@ int lease_v6_db_save(lease_v6_db_t* db)
 
     char tbuf[64];
     format_lease_time(now, tbuf, sizeof(tbuf));
+    char now_str[32];
+    ctime_r(&now, now_str);
 
     write_fmt(fd, "# The format of this file is documented in the dhcpd.leases(5) manual page.\n");
     write_fmt(fd, "# This lease file was written by DHCPv6 Server\n#\n");
@@ -591,11 +968,11 @@ int lease_v6_db_save(lease_v6_db_t* db)
     write_fmt(fd, "#   client-hostname \"...\"; vendor-class \"...\"; fqdn \"...\";\n");
     write_fmt(fd, "# }\n");
     write_fmt(fd, "# prefix <ipv6>/<plen> { ... }  # for IA_PD\n");
-    if (write_fmt(fd, "# Last updated: %s\n", ctime(&now)) < 0) goto fail;
+    if (write_fmt(fd, "# Last updated: %s\n", now_str) < 0) goto fail;
     char duid_hex[3*DUID_MAX_LEN];
-    for(uint32_t i=0;i<db->count;i++)
+    for(uint32_t i=0;i<snap_count;i++)
     {
-        dhcpv6_lease_t* L = &db->leases[i];
+        dhcpv6_lease_t* L = &snap[i];
         if (!L->in_use) continue;
         char tb[64];
 
@@ -648,30 +1025,71 @@ int lease_v6_db_save(lease_v6_db_t* db)
         }
     }
 
-    if (fsync(fd) < 0){ log_warn("v6-db: fsync file failed: %s", strerror(errno)); }
-    if(close(fd)<0) return -1;
-    
+    // Flush the snapshot body before blocking appenders, so that under the
+    // lock only the journal tail is left to reach the disk
+    if (fdatasync(fd) < 0){ log_warn("v6-db: fdatasync file failed: %s", strerror(errno)); }
+
+    // Carry over what was appended while writing, then swap the files
+    pthread_rwlock_wrlock(&db->file_lock);
+    if (copy_journal_tail(db, journal_mark, fd) < 0) {
+        pthread_rwlock_unlock(&db->file_lock);
+        goto fail;
+    }
+    if (fdatasync(fd) < 0){ log_warn("v6-db: fdatasync file failed: %s", strerror(errno)); }
+    if(close(fd)<0) {
+        pthread_rwlock_unlock(&db->file_lock);
+        fd = -1;
+        goto fail;
+    }
+    fd = -1;
 
     if (rename(tmp_path, db->filename) < 0){
-        log_error("v6-db: rename(%s->%s) failed: %s", tmp_path, db->filename, strerror(errno));
+        int e = errno;
+        pthread_rwlock_unlock(&db->file_lock);
+        unlink(tmp_path);
+        free(snap);
+        pthread_mutex_unlock(&db->save_lock);
+        log_error("v6-db: rename(%s->%s) failed: %s", tmp_path, db->filename, strerror(e));
         return -1;
     }
+    if (db->append_fd >= 0) close(db->append_fd);
+    db->append_fd = open(db->filename, O_RDWR|O_APPEND|O_CLOEXEC);
+    int reopen_errno = errno;
+    pthread_rwlock_unlock(&db->file_lock);
+
+    if (db->append_fd < 0)
+        log_error("v6-db: reopen(%s) for append failed: %s", db->filename, strerror(reopen_errno));
     (void)fsync_dirname(db->filename);
-    log_info("v6-db saved %u entries to %s", db->count, db->filename);
+    free(snap);
+    pthread_mutex_unlock(&db->save_lock);
+    log_info("v6-db saved %u entries to %s", snap_count, db->filename);
     return 0;
 
 fail:
-    { int e=errno; close(fd); unlink(tmp_path); errno=e; }
+    { int e=errno; if (fd >= 0) close(fd); unlink(tmp_path); errno=e; }
+    free(snap);
+    pthread_mutex_unlock(&db->save_lock);
     log_error("v6-db: save failed: %s", strerror(errno));
     return -1;
 }
 
+static void rec_fmt(char* buf, size_t cap, size_t* len, const char* fmt, ...)
+{
+    if (*len + 1 >= cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, cap - *len, fmt, ap);
+    va_end(ap);
+    if (n > 0) *len += ((size_t)n < cap - *len) ? (size_t)n : cap - *len - 1;
+}
 
 int lease_v6_db_append(lease_v6_db_t* db, const dhcpv6_lease_t* L){
     if (!db || !L) return -1;
 
-    int fd = open(db->filename, O_WRONLY|O_CREAT|O_APPEND, 0644);
-    if (fd < 0){ log_error("v6-db: open(%s) append failed: %s", db->filename, strerror(errno)); return -1; }
+    // Formatted first so that the record goes out in one write(): appends
+    // from other threads never interleave with it
+    char rec[WR_TMP_MAX];
+    size_t len = 0;
     char addr[IP6_STR_MAX], tbuf[64];
     char duid_hex[3*DUID_MAX_LEN]; duid_hex[0]='\0';
     if (L->duid_len){
@@ -680,74 +1098,87 @@ int lease_v6_db_append(lease_v6_db_t* db, const dhcpv6_lease_t* L){
 
     if (L->type == Lease6_IA_NA) {
         inet_ntop(AF_INET6, &L->ip6_addr, addr, sizeof(addr));
-        write_fmt(fd, "lease %s {\n", addr);
+        rec_fmt(rec, sizeof(rec), &len, "lease %s {\n", addr);
     } else {
          inet_ntop(AF_INET6, &L->prefix_v6, addr, sizeof(addr));
-         write_fmt(fd, "prefix %s/%u {\n", addr, (unsigned)L->plen);
+         rec_fmt(rec, sizeof(rec), &len, "prefix %s/%u {\n", addr, (unsigned)L->plen);
      }
-     write_fmt(fd, "\tduid %s;\n", duid_hex);
-     write_fmt(fd, "\tiaid %u;\n", (unsigned)L->iaid);
+     rec_fmt(rec, sizeof(rec), &len, "\tduid %s;\n", duid_hex);
+     rec_fmt(rec, sizeof(rec), &len, "\tiaid %u;\n", (unsigned)L->iaid);
      format_lease_time(L->starts, tbuf, sizeof(tbuf));
-     write_fmt(fd, "\tstarts %s;\n", tbuf);
+     rec_fmt(rec, sizeof(rec), &len, "\tstarts %s;\n", tbuf);
      format_lease_time(L->ends, tbuf, sizeof(tbuf));
-     write_fmt(fd, "\tends %s;\n", tbuf);
-     if (L->tstp) { format_lease_time(L->tstp, tbuf, sizeof(tbuf)); write_fmt(fd, "\ttstp %s;\n", tbuf); }
-     if (L->cltt) { format_lease_time(L->cltt, tbuf, sizeof(tbuf)); write_fmt(fd, "\tcltt %s;\n", tbuf); }
+     rec_fmt(rec, sizeof(rec), &len, "\tends %s;\n", tbuf);
+     if (L->tstp) { format_lease_time(L->tstp, tbuf, sizeof(tbuf)); rec_fmt(rec, sizeof(rec), &len, "\ttstp %s;\n", tbuf); }
+     if (L->cltt) { format_lease_time(L->cltt, tbuf, sizeof(tbuf)); rec_fmt(rec, sizeof(rec), &len, "\tcltt %s;\n", tbuf); }
  
-     write_fmt(fd, "\tbinding state %s;\n", lease_v6_state_to_string(L->state));
-     if (L->next_state)   write_fmt(fd, "\tnext binding state %s;\n",   lease_v6_state_to_string(L->next_state));
-     if (L->rewind_state) write_fmt(fd, "\trewind binding state %s;\n", lease_v6_state_to_string(L->rewind_state));
+     rec_fmt(rec, sizeof(rec), &len, "\tbinding state %s;\n", lease_v6_state_to_string(L->state));
+     if (L->next_state)   rec_fmt(rec, sizeof(rec), &len, "\tnext binding state %s;\n",   lease_v6_state_to_string(L->next_state));
+     if (L->rewind_state) rec_fmt(rec, sizeof(rec), &len, "\trewind binding state %s;\n", lease_v6_state_to_string(L->rewind_state));
  
-     if (L->client_hostname[0])     write_fmt(fd, "\tclient-hostname \"%s\";\n", L->client_hostname);
-     if (L->vendor_class[0]) write_fmt(fd, "\tvendor-class \"%s\";\n", L->vendor_class);
-     if (L->fqdn[0])   write_fmt(fd, "\tfqdn \"%s\";\n", L->fqdn);
-     write_fmt(fd, "}\n\n");
-    if (fsync(fd) < 0)
-    { 
-        log_warn("v6-db: fsync append file failed: %s", strerror(errno)); 
+     if (L->client_hostname[0])     rec_fmt(rec, sizeof(rec), &len, "\tclient-hostname \"%s\";\n", L->client_hostname);
+     if (L->vendor_class[0]) rec_fmt(rec, sizeof(rec), &len, "\tvendor-class \"%s\";\n", L->vendor_class);
+     if (L->fqdn[0])   rec_fmt(rec, sizeof(rec), &len, "\tfqdn \"%s\";\n", L->fqdn);
+     rec_fmt(rec, sizeof(rec), &len, "}\n\n");
+
+    pthread_rwlock_rdlock(&db->file_lock);
+    ssize_t w = db->append_fd >= 0 ? write_all(db->append_fd, rec, len) : -1;
+    int e = db->append_fd >= 0 ? errno : EBADF;
+    pthread_rwlock_unlock(&db->file_lock);
+    if (w < 0) {
+        log_error("v6-db: append to %s failed: %s", db->filename, strerror(e));
+        return -1;
     }
-    close(fd);
-  
-    log_info("v6-db append one (%s)", (L->type==Lease6_IA_NA)?"IA_NA":"IA_PD");
+
+    log_debug("v6-db append one (%s)", (L->type==Lease6_IA_NA)?"IA_NA":"IA_PD");
     return 0;
 }
 
-dhcpv6_lease_t* lease_v6_add_ia_na(lease_v6_db_t* db,
-                                   const char* duid_hex, uint16_t duid_len, uint32_t iaid,
-                                   const struct in6_addr* ip,
-                                   uint32_t lease_secs,
-                                   const char* hostname_opt)
+int lease_v6_db_sync(lease_v6_db_t* db)
+{
+    if (!db) return -1;
+    pthread_rwlock_rdlock(&db->file_lock);
+    int rc = db->append_fd >= 0 ? fdatasync(db->append_fd) : 0;
+    int e = errno;
+    pthread_rwlock_unlock(&db->file_lock);
+    if (rc < 0) log_warn("v6-db: fsync append file failed: %s", strerror(e));
+    return rc;
+}
+
+int lease_v6_add_ia_na(lease_v6_db_t* db,
+                       const char* duid_hex, uint16_t duid_len, uint32_t iaid,
+                       const struct in6_addr* ip,
+                       uint32_t lease_secs,
+                       const char* hostname_opt)
 {
    (void)duid_len;
-   if (!db || !duid_hex || !ip) return NULL;
-
-   // Search for existing lease for this IP
-   dhcpv6_lease_t* L = NULL;
-   for(uint32_t i=0; i<db->count; i++) {
-       if (db->leases[i].in_use && 
-           db->leases[i].type == Lease6_IA_NA &&
-           memcmp(&db->leases[i].ip6_addr, ip, sizeof(*ip)) == 0) {
-           L = &db->leases[i];
-           break;
-       }
+   if (!db || !duid_hex || !ip) return -1;
+
+   uint8_t duid[DUID_MAX_LEN];
+   int duid_n = 0;
+   if (*duid_hex) {
+       duid_n = duid_hex_to_bin(duid_hex, duid, DUID_MAX_LEN);
+       if (duid_n < 0) { log_error("v6 add IA_NA: invalid DUID hex"); return -1; }
    }
 
+   lease_v6_shard_t* sh = shard_for(db, ip, 128);
+   pthread_mutex_lock(&sh->lock);
+
+   // Reuse the existing lease for this IP
+   uint32_t slot;
+   dhcpv6_lease_t* L = shard_find_or_add(db, sh, Lease6_IA_NA, ip, 128, &slot);
    if (!L) {
-       if (db->count >= LEASES6_MAX) {
-            log_error("v6 add IA_NA: lease DB full");
-            return NULL;
-        }
-        L = &db->leases[db->count];
-        memset(L,0,sizeof(*L));
-        db->count++;
+        pthread_mutex_unlock(&sh->lock);
+        log_error("v6 add IA_NA: out of memory");
+        return -1;
    }
 
+    uint32_t client = client_hash(sh, slot);
     L->in_use=1; 
     L->type=Lease6_IA_NA;
-    if (duid_hex && *duid_hex){
-        int n = duid_hex_to_bin(duid_hex, L->duid, DUID_MAX_LEN);
-        if (n < 0) { log_error("v6 add IA_NA: invalid DUID hex"); return NULL; }
-        L->duid_len = (uint16_t)n;
+    if (*duid_hex){
+        memcpy(L->duid, duid, (size_t)duid_n);
+        L->duid_len = (uint16_t)duid_n;
     }
     time_t now=time(NULL);
     L->iaid = iaid;
@@ -759,54 +1190,56 @@ dhcpv6_lease_t* lease_v6_add_ia_na(lease_v6_db_t* db,
     L->cltt   = now;
     L->state  = LEASE_STATE_ACTIVE;
     if (hostname_opt) strncpy(L->client_hostname, hostname_opt, sizeof(L->client_hostname)-1);
+    client_relink(db, sh, slot, client);
     
     // Always append to disk log
     (void)lease_v6_db_append(db, L);
     
     char duid_dbg[3*DUID_MAX_LEN]; duid_dbg[0]='\0';
     (void)duid_bin_to_hex(L->duid, L->duid_len, duid_dbg, sizeof(duid_dbg));
-    log_info("v6 add IA_NA duid=%s iaid=%u ip=%s lease=%us", duid_dbg, L->iaid, L->ip6_addr_str, (unsigned)lease_secs);
-    return L;
+    char ip_str[IP6_STR_MAX];
+    memcpy(ip_str, L->ip6_addr_str, sizeof(ip_str));
+    pthread_mutex_unlock(&sh->lock);
+
+    log_info("v6 add IA_NA duid=%s iaid=%u ip=%s lease=%us", duid_dbg, iaid, ip_str, (unsigned)lease_secs);
+    return 0;
 }
 
 
-dhcpv6_lease_t* lease_v6_add_ia_pd(lease_v6_db_t* db,
-                                   const char* duid_hex, uint16_t duid_len, uint32_t iaid,
-                                   const struct in6_addr* prefix_base,
-                                   uint8_t plen,
-                                   uint32_t lease_secs,
-                                   const char* hostname_opt)
+int lease_v6_add_ia_pd(lease_v6_db_t* db,
+                       const char* duid_hex, uint16_t duid_len, uint32_t iaid,
+                       const struct in6_addr* prefix_base,
+                       uint8_t plen,
+                       uint32_t lease_secs,
+                       const char* hostname_opt)
 {
    (void) duid_len;
-    if (!db || !prefix_base) return NULL;
-
-   // Search for existing lease for this Prefix
-   dhcpv6_lease_t* L = NULL;
-   for(uint32_t i=0; i<db->count; i++) {
-       if (db->leases[i].in_use && 
-           db->leases[i].type == Lease6_IA_PD &&
-           db->leases[i].plen == plen &&
-           memcmp(&db->leases[i].prefix_v6, prefix_base, sizeof(*prefix_base)) == 0) {
-           L = &db->leases[i];
-           break;
-       }
+    if (!db || !prefix_base) return -1;
+
+   uint8_t duid[DUID_MAX_LEN];
+   int duid_n = 0;
+   if (duid_hex && *duid_hex) {
+       duid_n = duid_hex_to_bin(duid_hex, duid, DUID_MAX_LEN);
+       if (duid_n < 0) { log_error("v6 add IA_PD: invalid DUID hex"); return -1; }
    }
 
+   lease_v6_shard_t* sh = shard_for(db, prefix_base, plen);
+   pthread_mutex_lock(&sh->lock);
+
+   // Reuse the existing lease for this Prefix
+    uint32_t slot;
+    dhcpv6_lease_t* L = shard_find_or_add(db, sh, Lease6_IA_PD, prefix_base, plen, &slot);
     if (!L) {
-        if (db->count >= LEASES6_MAX) {
-            log_error("v6 add IA_PD: lease DB full");
-            return NULL;
-        }
-        L = &db->leases[db->count];
-        memset(L,0,sizeof(*L));
-        db->count++;
+        pthread_mutex_unlock(&sh->lock);
+        log_error("v6 add IA_PD: out of memory");
+        return -1;
     }
 
+    uint32_t client = client_hash(sh, slot);
     L->in_use=1; L->type=Lease6_IA_PD;
     if (duid_hex && *duid_hex){
-        int n = duid_hex_to_bin(duid_hex, L->duid, DUID_MAX_LEN);
-        if (n < 0) { log_error("v6 add IA_PD: invalid DUID hex"); return NULL; }
-        L->duid_len = (uint16_t)n;
+        memcpy(L->duid, duid, (size_t)duid_n);
+        L->duid_len = (uint16_t)duid_n;
     }
     L->iaid = iaid;
     L->prefix_v6 = *prefix_base; in6_to_str(prefix_base, L->prefix_str, sizeof(L->prefix_str));
@@ -818,124 +1251,234 @@ dhcpv6_lease_t* lease_v6_add_ia_pd(lease_v6_db_t* db,
     L->cltt   = now;
     L->state  = LEASE_STATE_ACTIVE;
     if (hostname_opt) strncpy(L->client_hostname, hostname_opt, sizeof(L->client_hostname)-1);
+    client_relink(db, sh, slot, client);
 
     // Always append to disk log
     (void)lease_v6_db_append(db, L);
 
     char duid_dbg[3*DUID_MAX_LEN]; duid_dbg[0]='\0';
     (void)duid_bin_to_hex(L->duid, L->duid_len, duid_dbg, sizeof(duid_dbg));
-    log_info("v6 add IA_PD duid=%s iaid=%u prefix=%s/%u lease=%us", duid_dbg, L->iaid, L->prefix_str, L->plen, (unsigned)lease_secs);
-    return L;
+    char pfx_str[IP6_STR_MAX];
+    memcpy(pfx_str, L->prefix_str, sizeof(pfx_str));
+    pthread_mutex_unlock(&sh->lock);
+
+    log_info("v6 add IA_PD duid=%s iaid=%u prefix=%s/%u lease=%us", duid_dbg, iaid, pfx_str, plen, (unsigned)lease_secs);
+    return 0;
 }
 
 
-dhcpv6_lease_t* lease_v6_find_by_ip(lease_v6_db_t* db, const struct in6_addr* ip){
-    if (!db || !ip) return NULL;
-    for (uint32_t i=0;i<db->count;i++){
-        dhcpv6_lease_t* L=&db->leases[i];
-        if (!L->in_use || L->type!=Lease6_IA_NA) continue;
-        if (memcmp(&L->ip6_addr, ip, sizeof(struct in6_addr))==0) return L;
-    }
-    return NULL;
+int lease_v6_find_by_ip(lease_v6_db_t* db, const struct in6_addr* ip, dhcpv6_lease_t* out){
+    if (!db || !ip || !out) return -1;
+    lease_v6_shard_t* sh = shard_for(db, ip, 128);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_NA, ip, 128);
+    if (slot != UINT32_MAX) *out = *shard_get(sh, slot);
+    pthread_mutex_unlock(&sh->lock);
+    return slot != UINT32_MAX ? 0 : -1;
 }
 
 
-dhcpv6_lease_t* lease_v6_find_by_prefix(lease_v6_db_t* db, const struct in6_addr* pfx, uint8_t plen){
-    if (!db || !pfx) return NULL;
-    for (uint32_t i=0;i<db->count;i++){
-        dhcpv6_lease_t* L=&db->leases[i];
-        if (!L->in_use || L->type!=Lease6_IA_PD) continue;
-        if (L->plen!=plen) continue;
-        if (memcmp(&L->prefix_v6, pfx, sizeof(struct in6_addr))==0) return L;
+int lease_v6_find_by_prefix(lease_v6_db_t* db, const struct in6_addr* pfx, uint8_t plen, dhcpv6_lease_t* out){
+    if (!db || !pfx || !out) return -1;
+    lease_v6_shard_t* sh = shard_for(db, pfx, plen);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_PD, pfx, plen);
+    if (slot != UINT32_MAX) *out = *shard_get(sh, slot);
+    pthread_mutex_unlock(&sh->lock);
+    return slot != UINT32_MAX ? 0 : -1;
+}
+
+static inline bool client_matches(const dhcpv6_lease_t* L, const uint8_t* duid, uint16_t duid_len, uint32_t iaid,
+                                  lease_v6_type_t type)
+{
+    return L->in_use && L->type == type && L->iaid == iaid && L->duid_len == duid_len &&
+           memcmp(L->duid, duid, duid_len) == 0;
+}
+
+#define CLIENT_CANDIDATES 8 // Directory entries confirmed per lookup
+#define CLIENT_ATTEMPTS 3   // Lookups before giving up on leases that keep moving
+
+int lease_v6_find_by_duid_iaid(lease_v6_db_t* db, const uint8_t* duid, uint16_t duid_len, uint32_t iaid, lease_v6_type_t type, dhcpv6_lease_t* out){
+    if (!db || !duid || !out) return -1;
+    uint32_t hash = hash_client(duid, duid_len, iaid, type);
+    lease_v6_client_stripe_t* cs = client_stripe(db, hash);
+
+    for (int attempt = 0; attempt < CLIENT_ATTEMPTS; attempt++){
+        // Where the client's leases are; no shard lock is taken under the stripe's
+        uint32_t locs[CLIENT_CANDIDATES], n = 0, loc;
+        struct lease_index_iter_t it;
+        pthread_mutex_lock(&cs->lock);
+        lease_index_find(&cs->index, hash, &it);
+        while (n < CLIENT_CANDIDATES && lease_index_next(&cs->index, &it, &loc)) locs[n++] = loc;
+        pthread_mutex_unlock(&cs->lock);
+        if (n == 0) return -1;
+
+        // Confirm each against the lease: a cleanup may have moved it since,
+        // and then the next attempt finds the directory updated
+        for (uint32_t i = 0; i < n; i++){
+            lease_v6_shard_t* sh = &db->shards[locs[i] & (LEASE_V6_SHARDS - 1)];
+            uint32_t slot = locs[i] >> CLIENT_SHARD_BITS;
+            pthread_mutex_lock(&sh->lock);
+            if (slot < sh->count && client_matches(shard_get(sh, slot), duid, duid_len, iaid, type)) {
+                *out = *shard_get(sh, slot);
+                pthread_mutex_unlock(&sh->lock);
+                return 0;
+            }
+            pthread_mutex_unlock(&sh->lock);
+        }
     }
-    return NULL;
+    return -1;
 }
 
-dhcpv6_lease_t* lease_v6_find_by_duid_iaid(lease_v6_db_t* db, const uint8_t* duid, uint16_t duid_len, uint32_t iaid, lease_v6_type_t type){
-    if (!db || !duid) return NULL;
-    for (uint32_t i=0;i<db->count;i++){
-        dhcpv6_lease_t* L=&db->leases[i];
-        if (!L->in_use || L->type!=type) continue;
-        if (L->iaid!=iaid) continue;
-        if (L->duid_len==duid_len && memcmp(L->duid, duid, duid_len)==0) return L;
+void lease_v6_db_for_each(lease_v6_db_t* db, void (*fn)(const dhcpv6_lease_t* lease, void* arg), void* arg)
+{
+    if (!db || !fn) return;
+    for (int s = 0; s < LEASE_V6_SHARDS; s++){
+        lease_v6_shard_t* sh = &db->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        for (uint32_t i = 0; i < sh->count; i++)
+            if (shard_get(sh, i)->in_use) fn(shard_get(sh, i), arg);
+        pthread_mutex_unlock(&sh->lock);
     }
-    return NULL;
 }
 
 int lease_v6_release_ip(lease_v6_db_t* db, const struct in6_addr* ip){
     if (!db || !ip) return -1;
-    dhcpv6_lease_t* L = lease_v6_find_by_ip(db, ip);
-    if (!L) return -1;
+    lease_v6_shard_t* sh = shard_for(db, ip, 128);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_NA, ip, 128);
+    if (slot == UINT32_MAX) { pthread_mutex_unlock(&sh->lock); return -1; }
+    dhcpv6_lease_t* L = shard_get(sh, slot);
     L->state = LEASE_STATE_RELEASED;
     L->ends  = time(NULL);
-    log_info("v6 release IA_NA ip=%s", L->ip6_addr_str);
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+
+    char ip_str[INET6_ADDRSTRLEN];
+    in6_to_str(ip, ip_str, sizeof(ip_str));
+    log_info("v6 release IA_NA ip=%s", ip_str);
+    return rc;
 }
 
 int lease_v6_release_prefix(lease_v6_db_t* db, const struct in6_addr* pfx, uint8_t plen){
     if (!db || !pfx) return -1;
-    dhcpv6_lease_t* L = lease_v6_find_by_prefix(db, pfx, plen);
-    if (!L) return -1;
+    lease_v6_shard_t* sh = shard_for(db, pfx, plen);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_PD, pfx, plen);
+    if (slot == UINT32_MAX) { pthread_mutex_unlock(&sh->lock); return -1; }
+    dhcpv6_lease_t* L = shard_get(sh, slot);
     L->state = LEASE_STATE_RELEASED;
     L->ends  = time(NULL);
-    log_info("v6 release IA_PD %s/%u", L->prefix_str, L->plen);
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+
+    char pfx_str[INET6_ADDRSTRLEN];
+    in6_to_str(pfx, pfx_str, sizeof(pfx_str));
+    log_info("v6 release IA_PD %s/%u", pfx_str, plen);
+    return rc;
 }
 
 int lease_v6_renew_ip(lease_v6_db_t* db, const struct in6_addr* ip, uint32_t lease_secs){
     if (!db || !ip) return -1;
-    dhcpv6_lease_t* L = lease_v6_find_by_ip(db, ip);
-    if (!L) return -1;
+    lease_v6_shard_t* sh = shard_for(db, ip, 128);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_NA, ip, 128);
+    if (slot == UINT32_MAX) { pthread_mutex_unlock(&sh->lock); return -1; }
+    dhcpv6_lease_t* L = shard_get(sh, slot);
     time_t now=time(NULL);
     L->starts = now; L->ends = now + lease_secs; L->state=LEASE_STATE_ACTIVE;
-    log_info("v6 renew IA_NA ip=%s lease=%us", L->ip6_addr_str, (unsigned)lease_secs);
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+
+    char ip_str[INET6_ADDRSTRLEN];
+    in6_to_str(ip, ip_str, sizeof(ip_str));
+    log_info("v6 renew IA_NA ip=%s lease=%us", ip_str, (unsigned)lease_secs);
+    return rc;
 }
 
 int lease_v6_renew_prefix(lease_v6_db_t* db, const struct in6_addr* pfx, uint8_t plen, uint32_t lease_secs){
     if (!db || !pfx) return -1;
-    dhcpv6_lease_t* L = lease_v6_find_by_prefix(db, pfx, plen);
-    if (!L) return -1;
+    lease_v6_shard_t* sh = shard_for(db, pfx, plen);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_PD, pfx, plen);
+    if (slot == UINT32_MAX) { pthread_mutex_unlock(&sh->lock); return -1; }
+    dhcpv6_lease_t* L = shard_get(sh, slot);
     time_t now=time(NULL);
     L->starts = now; L->ends = now + lease_secs; L->state=LEASE_STATE_ACTIVE;
-    log_info("v6 renew IA_PD %s/%u lease=%us", L->prefix_str, L->plen, (unsigned)lease_secs);
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+
+    char pfx_str[INET6_ADDRSTRLEN];
+    in6_to_str(pfx, pfx_str, sizeof(pfx_str));
+    log_info("v6 renew IA_PD %s/%u lease=%us", pfx_str, plen, (unsigned)lease_secs);
+    return rc;
 }
 
 
 int lease_v6_mark_expired_older(lease_v6_db_t* db){
     if (!db) return -1;
     time_t now=time(NULL); uint32_t n=0;
-    for (uint32_t i=0;i<db->count;i++){
-        dhcpv6_lease_t* L=&db->leases[i];
-        if (!L->in_use) continue;
-        if (L->state==LEASE_STATE_ACTIVE && L->ends < now){ L->state=LEASE_STATE_EXPIRED; n++; }
+    for (int s = 0; s < LEASE_V6_SHARDS; s++){
+        lease_v6_shard_t* sh = &db->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        for (uint32_t i=0;i<sh->count;i++){
+            dhcpv6_lease_t* L=shard_get(sh, i);
+            if (!L->in_use) continue;
+            if (L->state==LEASE_STATE_ACTIVE && L->ends < now){ L->state=LEASE_STATE_EXPIRED; n++; }
+        }
+        pthread_mutex_unlock(&sh->lock);
     }
-    if (n) (void)lease_v6_db_save(db);
     log_info("v6 mark-expired: %u", n);
     return (int)n;
 }
 
 int lease_v6_cleanup(lease_v6_db_t* db){
     if (!db) return -1;
-    uint32_t removed=0, i=0;
-    while(i<db->count){
-        dhcpv6_lease_t* L=&db->leases[i];
-        if (L->in_use && (L->state==LEASE_STATE_EXPIRED || L->state==LEASE_STATE_RELEASED)){
-            memmove(&db->leases[i], &db->leases[i+1], (db->count-i-1)*sizeof(dhcpv6_lease_t));
-            db->count--; removed++;
-        } else i++;
+    uint32_t removed=0;
+    for (int s = 0; s < LEASE_V6_SHARDS; s++){
+        lease_v6_shard_t* sh = &db->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        // Compact in one pass, preserving order; the client directory
+        // follows every lease that goes or moves
+        uint32_t kept=0;
+        for (uint32_t i=0;i<sh->count;i++){
+            dhcpv6_lease_t* L=shard_get(sh, i);
+            if (L->in_use && (L->state==LEASE_STATE_EXPIRED || L->state==LEASE_STATE_RELEASED)) {
+                client_unlink(db, sh, i, lease_hash_client(L));
+                continue;
+            }
+            if (kept!=i) {
+                *shard_get(sh, kept)=*L;
+                client_link_or_log(db, sh, kept);
+                client_unlink(db, sh, i, lease_hash_client(L));
+            }
+            kept++;
+        }
+        uint32_t n=sh->count-kept;
+        if (n>0){
+            sh->count=kept;
+            removed+=n;
+            __atomic_sub_fetch(&db->count, n, __ATOMIC_RELAXED);
+            // Slots moved: re-point the key index and give back emptied chunks.
+            // The index only shrinks here, so the rebuild needs no memory.
+            (void)key_index_rebuild(sh);
+            shard_trim(db, sh);
+        }
+        pthread_mutex_unlock(&sh->lock);
     }
-    if (removed) (void)lease_v6_db_save(db);
     log_info("v6 cleanup removed=%u", removed);
     return (int)removed;
 }
 
-void lease_v6_db_print(const lease_v6_db_t* db){
+void lease_v6_db_print(lease_v6_db_t* db){
     if (!db) return;
     printf("--- DHCPv6 Lease DB ---\nFile: %s\nTotal: %u\n\n", db->filename, db->count);
-     for (uint32_t i=0;i<db->count;i++){
-         const dhcpv6_lease_t *L = &db->leases[i];
+    uint32_t idx = 0;
+    for (int s = 0; s < LEASE_V6_SHARDS; s++){
+        lease_v6_shard_t* sh = &db->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        for (uint32_t i=0;i<sh->count;i++){
+         const dhcpv6_lease_t *L = shard_get(sh, i);
          char a[INET6_ADDRSTRLEN], sb[64], eb[64];
          if (L->type == Lease6_IA_NA) {
              inet_ntop(AF_INET6, &L->ip6_addr, a, sizeof(a));
@@ -945,8 +1488,10 @@ void lease_v6_db_print(const lease_v6_db_t* db){
          format_lease_time(L->starts, sb, sizeof(sb));
          format_lease_time(L->ends,   eb, sizeof(eb));
          dprintf(STDOUT_FILENO, "[%u] %s %s  iaid=%u  starts=%s  ends=%s  state=%d\n",
-                 i, (L->type==Lease6_IA_NA?"IA_NA":"IA_PD"),
+                 idx++, (L->type==Lease6_IA_NA?"IA_NA":"IA_PD"),
                  a, (unsigned)L->iaid, sb, eb, (int)L->state);
+        }
+        pthread_mutex_unlock(&sh->lock);
     }
 }
 
@@ -958,21 +1503,21 @@ int lease_v6_mark_reserved(lease_v6_db_t *db,
 {
     if (!db || !ip6 || !duid_hex) return -1;
 
-    dhcpv6_lease_t *L = lease_v6_find_by_ip(db, ip6);
+    uint8_t duid[DUID_MAX_LEN];
+    int n = duid_hex_to_bin(duid_hex, duid, DUID_MAX_LEN);
+    if (n < 0) return -1;
 
-    if(!L) {
-        if (db->count >= LEASES6_MAX) return -1;
-        L = &db->leases[db->count++];
-        memset(L, 0, sizeof(*L));
-        L->in_use   = 1;
-        L->type     = Lease6_IA_NA;
-        L->ip6_addr = *ip6;
-    }
+    lease_v6_shard_t* sh = shard_for(db, ip6, 128);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot;
+    dhcpv6_lease_t *L = shard_find_or_add(db, sh, Lease6_IA_NA, ip6, 128, &slot);
+    if (!L) { pthread_mutex_unlock(&sh->lock); return -1; }
 
-    int n = duid_hex_to_bin(duid_hex, L->duid, DUID_MAX_LEN);
-    if (n < 0) return -1;
+    uint32_t client = client_hash(sh, slot);
+    memcpy(L->duid, duid, (size_t)n);
     L->duid_len = (uint16_t)n;
     L->iaid = iaid;
+    client_relink(db, sh, slot, client);
 
     if (hostname)
     {
@@ -990,26 +1535,27 @@ int lease_v6_mark_reserved(lease_v6_db_t *db,
     L->next_state = LEASE_STATE_FREE;
     L->rewind_state = LEASE_STATE_FREE;
 
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+    return rc;
 }
 
 int lease_v6_set_state(lease_v6_db_t* db, const struct in6_addr* ip6_addr, lease_state_t new_state)
 {
      if (!db || !ip6_addr) return -1;
-    dhcpv6_lease_t* L = lease_v6_find_by_ip(db, ip6_addr);
-
-    if (!L) {
-        if (new_state == LEASE_STATE_ACTIVE || new_state == LEASE_STATE_RESERVED) {
-            if (db->count >= LEASES6_MAX) return -1;
-            L = &db->leases[db->count++];
-            memset(L, 0, sizeof(*L));
-            L->in_use   = 1;
-            L->type     = Lease6_IA_NA;
-            L->ip6_addr = *ip6_addr;
-            in6_to_str(&L->ip6_addr, L->ip6_addr_str, sizeof(L->ip6_addr_str));
-        } else {
-            return 0;
-        }
+    lease_v6_shard_t* sh = shard_for(db, ip6_addr, 128);
+    pthread_mutex_lock(&sh->lock);
+    uint32_t slot = shard_find(sh, Lease6_IA_NA, ip6_addr, 128);
+    dhcpv6_lease_t* L = NULL;
+
+    if (slot != UINT32_MAX) {
+        L = shard_get(sh, slot);
+    } else if (new_state == LEASE_STATE_ACTIVE || new_state == LEASE_STATE_RESERVED) {
+        L = shard_find_or_add(db, sh, Lease6_IA_NA, ip6_addr, 128, &slot);
+        if (!L) { pthread_mutex_unlock(&sh->lock); return -1; }
+    } else {
+        pthread_mutex_unlock(&sh->lock);
+        return 0;
     }
 
     L->state = new_state;
@@ -1025,8 +1571,9 @@ int lease_v6_set_state(lease_v6_db_t* db, const struct in6_addr* ip6_addr, lease
         L->ends = now;
 }
 
-
-    return lease_v6_db_save(db);
+    int rc = lease_v6_db_append(db, L);
+    pthread_mutex_unlock(&sh->lock);
+    return rc;
 }
 
 int lease_v6_mark_conflict(lease_v6_db_t* db, const struct in6_addr* ip6_addr, const char* reason)
@@ -1037,4 +1584,3 @@ int lease_v6_mark_conflict(lease_v6_db_t* db, const struct in6_addr* ip6_addr, c
     log_warn("v6 conflict on %s (%s)", ipstr, reason ? reason : "probe");
     return lease_v6_set_state(db, ip6_addr, LEASE_STATE_ABANDONED);
 }
-
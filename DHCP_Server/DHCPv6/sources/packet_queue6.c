@@ -0,0 +1,209 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packet_queue6.h"
+
+// --- Packet pool ---
+
+static inline uint32_t head_index(uint64_t head)
+{
+    return (uint32_t)(head & 0xFFFFFFFFu);
+}
+
+static inline uint64_t make_head(uint64_t old_head, uint32_t index)
+{
+    // Bump the generation tag on every successful CAS to defeat ABA
+    return (((old_head >> 32) + 1) << 32) | index;
+}
+
+int pkt6_pool_init(pkt6_pool_t* pool, uint32_t capacity)
+{
+    if (!pool || capacity == 0 || capacity >= PKT6_POOL_NIL) return -1;
+    memset(pool, 0, sizeof(*pool));
+
+    pool->slots = calloc(capacity, sizeof(pkt6_t));
+    if (!pool->slots) {
+        perror("Failed to allocate packet pool");
+        return -1;
+    }
+    pool->capacity = capacity;
+
+    // Chain every slot: 0 -> 1 -> ... -> capacity-1 -> NIL
+    for (uint32_t i = 0; i < capacity; i++)
+        pool->slots[i].next = (i + 1 < capacity) ? i + 1 : PKT6_POOL_NIL;
+    pool->free_head = 0;
+    return 0;
+}
+
+void pkt6_pool_free(pkt6_pool_t* pool)
+{
+    if (!pool) return;
+    free(pool->slots);
+    memset(pool, 0, sizeof(*pool));
+}
+
+pkt6_t* pkt6_pool_acquire(pkt6_pool_t* pool)
+{
+    if (!pool || !pool->slots) return NULL;
+
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t index = head_index(head);
+        if (index == PKT6_POOL_NIL) {
+            __atomic_fetch_add(&pool->exhausted_count, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        // next may be stale if another thread popped this slot meanwhile:
+        // the tagged CAS fails then
+        uint32_t next = __atomic_load_n(&pool->slots[index].next, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&pool->free_head, &head, make_head(head, next), true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return &pool->slots[index];
+    }
+}
+
+void pkt6_pool_release(pkt6_pool_t* pool, pkt6_t* pkt)
+{
+    if (!pool || !pkt) return;
+    uint32_t index = (uint32_t)(pkt - pool->slots);
+    if (index >= pool->capacity) return; // Not one of ours
+
+    uint64_t head = __atomic_load_n(&pool->free_head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(&pkt->next, head_index(head), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->free_head, &head, make_head(head, index), true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// --- Descriptor ring ---
+//
+// Cell i starts with seq == i. A producer at position pos may fill the cell
+// when seq == pos and publishes it with seq = pos + 1; a consumer at pos may
+// drain it when seq == pos + 1 and hands it back with seq = pos + capacity,
+// the position of the producer one lap later.
+
+int pkt6_ring_init(pkt6_ring_t* ring, uint32_t capacity)
+{
+    if (!ring || capacity == 0 || capacity > (1u << 30)) return -1;
+    memset(ring, 0, sizeof(*ring));
+
+    uint32_t cap = 1;
+    while (cap < capacity) cap <<= 1;
+
+    ring->cells = calloc(cap, sizeof(pkt6_cell_t));
+    if (!ring->cells) {
+        perror("Failed to allocate packet ring");
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; i++) ring->cells[i].seq = i;
+    ring->mask = cap - 1;
+
+    pthread_mutex_init(&ring->wait_lock, NULL);
+    pthread_cond_init(&ring->wait_cond, NULL);
+    return 0;
+}
+
+void pkt6_ring_free(pkt6_ring_t* ring)
+{
+    if (!ring || !ring->cells) return;
+    pthread_mutex_destroy(&ring->wait_lock);
+    pthread_cond_destroy(&ring->wait_cond);
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+static bool ring_enqueue(pkt6_ring_t* ring, pkt6_t* pkt)
+{
+    uint64_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        pkt6_cell_t* cell = &ring->cells[pos & ring->mask];
+        uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->pkt = pkt;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; // Full: the cell still holds the packet of the previous lap
+        } else {
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static pkt6_t* ring_dequeue(pkt6_ring_t* ring)
+{
+    uint64_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        pkt6_cell_t* cell = &ring->cells[pos & ring->mask];
+        uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                pkt6_t* pkt = cell->pkt;
+                __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+                return pkt;
+            }
+        } else if (diff < 0) {
+            return NULL; // Empty
+        } else {
+            pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Sleeping and waking pair up like this: a worker counts itself in
+// sleepers, then looks at the ring once more; a producer publishes, then
+// looks at sleepers. With a full fence between the two steps on both sides,
+// at least one of them sees the other, so no packet waits for a sleeping
+// worker. The lock only serves the condition variable.
+
+int pkt6_ring_push(pkt6_ring_t* ring, pkt6_t* const* pkts, int n)
+{
+    int queued = 0;
+    while (queued < n && ring_enqueue(ring, pkts[queued])) queued++;
+    if (queued == 0) return 0;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_RELAXED) > 0) {
+        // One wakeup per batch, not per packet
+        pthread_mutex_lock(&ring->wait_lock);
+        if (queued >= ring->sleepers) pthread_cond_broadcast(&ring->wait_cond);
+        else for (int i = 0; i < queued; i++) pthread_cond_signal(&ring->wait_cond);
+        pthread_mutex_unlock(&ring->wait_lock);
+    }
+    return queued;
+}
+
+pkt6_t* pkt6_ring_pop_wait(pkt6_ring_t* ring)
+{
+    for (;;) {
+        pkt6_t* pkt = ring_dequeue(ring);
+        if (pkt) return pkt;
+        if (__atomic_load_n(&ring->shutdown, __ATOMIC_ACQUIRE)) return NULL;
+
+        pthread_mutex_lock(&ring->wait_lock);
+        __atomic_store_n(&ring->sleepers, ring->sleepers + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        pkt = ring_dequeue(ring);
+        if (!pkt && !__atomic_load_n(&ring->shutdown, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&ring->wait_cond, &ring->wait_lock);
+        __atomic_store_n(&ring->sleepers, ring->sleepers - 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&ring->wait_lock);
+        if (pkt) return pkt;
+    }
+}
+
+void pkt6_ring_shutdown(pkt6_ring_t* ring)
+{
+    __atomic_store_n(&ring->shutdown, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&ring->wait_lock);
+    pthread_cond_broadcast(&ring->wait_cond);
+    pthread_mutex_unlock(&ring->wait_lock);
+}
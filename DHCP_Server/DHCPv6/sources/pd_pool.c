@@ -1,147 +1,417 @@
 #include "pd_pool.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include "utilsv6.h"
 #include "logger.h"
 
-// Helper to increment IPv6 address at a specific bit position
-// Example: incrementing 2001:db8:1:: at /48 will act on the bits from 0 to 47?
-// Actually this function increments the value of the prefix treating it as an integer.
-// But the `plen` argument specifies the boundary.
-// If we have a /60 prefix, and we want to find the next /60, we increment at the 60th bit position.
-//
-// Logic:
-// 1. Identify which byte contains the bit at `plen`.
-// 2. Identify the bit offset within that byte.
-// 3. Add 1 to that bit position, handling carry-over to previous bytes.
-static void increment_prefix(struct in6_addr* ip, uint8_t plen) {
-    if (plen == 0 || plen > 128) return;
-    
-    // We want to increment the prefix such that we get the next prefix of length `plen`.
-    // Effectively, we are creating a sequence of prefixes: P, P + 2^(128-plen), ...
-    // This is equivalent to adding 1 at the bit position `plen - 1`.
-    
-    int byte_idx = (plen - 1) / 8;
-    int bit_in_byte = 7 - ((plen - 1) % 8);
-    
-    // We add 1 at the specific bit.
-    // If bit_in_byte is 0 (LSB of byte), we add 1.
-    // If bit_in_byte is 7 (MSB of byte), we add 128 (0x80).
-    
-    uint16_t add = 1 << bit_in_byte;
-    
-    // Working correctly with carry from the specified byte backwards
-    for (int i = byte_idx; i >= 0; i--) {
-        uint16_t val = (uint16_t)ip->s6_addr[i] + add;
-        ip->s6_addr[i] = (uint8_t)(val & 0xFF);
-        add = val >> 8; // Carry
-        if (add == 0) break;
+/* ---- units and blocks ----
+ *
+ * Prefixes are counted in /64s: a prefix of length <= 64 is its upper 64
+ * bits, and a block of order n holds 2^n of them (plen = 64 - n). The buddy
+ * of a block is the other half of its parent, unit ^ 2^n.
+ */
+
+static inline uint64_t prefix_unit(const struct in6_addr* p) {
+    uint64_t u = 0;
+    for (int i = 0; i < 8; i++) u = (u << 8) | p->s6_addr[i];
+    return u;
+}
+
+static inline struct in6_addr unit_prefix(uint64_t unit) {
+    struct in6_addr p;
+    memset(&p, 0, sizeof(p));
+    for (int i = 7; i >= 0; i--) { p.s6_addr[i] = (uint8_t)unit; unit >>= 8; }
+    return p;
+}
+
+static inline uint64_t order_size(uint32_t order) {
+    return 1ULL << order;
+}
+
+static inline uint32_t block_order(const pd_pool_entry_t* e) {
+    return PD_POOL_MAX_PLEN - e->plen;
+}
+
+static inline uint32_t hash_block(uint64_t unit, uint8_t plen) {
+    return lease_index_hash_u64(unit ^ plen);
+}
+
+static inline uint32_t hash_duid(const char* duid) {
+    return lease_index_hash_bytes((const uint8_t*)duid, (uint32_t)strlen(duid));
+}
+
+// Caller holds pool->lock. Slot of the block unit/plen, PD_POOL_NIL if none.
+static uint32_t block_slot(const pd_pool_t* pool, uint64_t unit, uint8_t plen) {
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&pool->block_index, hash_block(unit, plen), &it);
+    while (lease_index_next(&pool->block_index, &it, &slot)) {
+        const pd_pool_entry_t* e = &pool->entries[slot];
+        if (e->plen == plen && prefix_unit(&e->prefix) == unit) return slot;
+    }
+    return PD_POOL_NIL;
+}
+
+static void count_state(pd_pool_t* pool, ip6_state_t state, int delta) {
+    if (state == IP6_STATE_ALLOCATED) pool->allocated_count += delta;
+    else if (state == IP6_STATE_RESERVED) pool->reserved_count += delta;
+}
+
+static void duid_unlink(pd_pool_t* pool, uint32_t slot) {
+    const pd_pool_entry_t* e = &pool->entries[slot];
+    if (e->duid[0]) lease_index_remove(&pool->duid_index, hash_duid(e->duid), slot);
+}
+
+static void duid_relink(pd_pool_t* pool, uint32_t slot) {
+    const pd_pool_entry_t* e = &pool->entries[slot];
+    if (e->duid[0] && lease_index_insert(&pool->duid_index, hash_duid(e->duid), slot) != 0)
+        log_error("pd_pool: out of memory, client %s not found by DUID", e->duid);
+}
+
+/* ---- free lists ---- */
+
+static bool on_free_list(const pd_pool_t* pool, uint32_t slot) {
+    const pd_pool_entry_t* e = &pool->entries[slot];
+    return e->state == IP6_STATE_AVAILABLE &&
+           (e->free_prev != PD_POOL_NIL || pool->free_head[block_order(e)] == slot);
+}
+
+static void free_push(pd_pool_t* pool, uint32_t slot) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    uint32_t order = block_order(e);
+    e->free_prev = PD_POOL_NIL;
+    e->free_next = pool->free_head[order];
+    if (e->free_next != PD_POOL_NIL) pool->entries[e->free_next].free_prev = slot;
+    pool->free_head[order] = slot;
+    pool->free_orders |= order_size(order);
+}
+
+static void free_unlink(pd_pool_t* pool, uint32_t slot) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    uint32_t order = block_order(e);
+    if (e->free_prev != PD_POOL_NIL) pool->entries[e->free_prev].free_next = e->free_next;
+    else pool->free_head[order] = e->free_next;
+    if (e->free_next != PD_POOL_NIL) pool->entries[e->free_next].free_prev = e->free_prev;
+    if (pool->free_head[order] == PD_POOL_NIL) pool->free_orders &= ~order_size(order);
+    e->free_prev = e->free_next = PD_POOL_NIL;
+}
+
+// A free block leaves its free list to be split, merged or delegated
+static void take_block(pd_pool_t* pool, uint32_t slot) {
+    free_unlink(pool, slot);
+    pool->available_count -= order_size(block_order(&pool->entries[slot]));
+}
+
+static void put_block(pd_pool_t* pool, uint32_t slot) {
+    free_push(pool, slot);
+    pool->available_count += order_size(block_order(&pool->entries[slot]));
+}
+
+/* ---- block table ---- */
+
+static int entries_reserve(pd_pool_t* pool, uint32_t more) {
+    if (pool->entry_count + more <= pool->entry_capacity) return 0;
+    uint32_t cap = pool->entry_capacity ? pool->entry_capacity : 64;
+    while (cap < pool->entry_count + more) cap *= 2;
+    pd_pool_entry_t* grown = realloc(pool->entries, (size_t)cap * sizeof(*grown));
+    if (!grown) return -1;
+    pool->entries = grown;
+    pool->entry_capacity = cap;
+    return 0;
+}
+
+// Caller holds pool->lock. Adds the free block unit/order. Returns its slot,
+// PD_POOL_NIL when out of memory.
+static uint32_t block_new_free(pd_pool_t* pool, uint64_t unit, uint32_t order) {
+    if (entries_reserve(pool, 1) != 0) return PD_POOL_NIL;
+    uint32_t slot = pool->entry_count;
+    pd_pool_entry_t* e = &pool->entries[slot];
+    memset(e, 0, sizeof(*e));
+    e->prefix = unit_prefix(unit);
+    e->plen = (uint8_t)(PD_POOL_MAX_PLEN - order);
+    e->state = IP6_STATE_AVAILABLE;
+    if (lease_index_insert(&pool->block_index, hash_block(unit, e->plen), slot) != 0) return PD_POOL_NIL;
+    pool->entry_count++;
+    put_block(pool, slot);
+    return slot;
+}
+
+// Caller holds pool->lock. The block in @p slot becomes unit/order.
+static void block_move(pd_pool_t* pool, uint32_t slot, uint64_t unit, uint32_t order) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    lease_index_remove(&pool->block_index, hash_block(prefix_unit(&e->prefix), e->plen), slot);
+    e->prefix = unit_prefix(unit);
+    e->plen = (uint8_t)(PD_POOL_MAX_PLEN - order);
+    if (lease_index_insert(&pool->block_index, hash_block(unit, e->plen), slot) != 0)
+        log_error("pd_pool: out of memory, lost track of a prefix block");
+}
+
+// Caller holds pool->lock. Drops the block in @p slot, off its free list and
+// without owner: the last block moves into its place. Returns the slot the
+// moved block had.
+static uint32_t block_drop(pd_pool_t* pool, uint32_t slot) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    lease_index_remove(&pool->block_index, hash_block(prefix_unit(&e->prefix), e->plen), slot);
+
+    uint32_t last = --pool->entry_count;
+    if (slot != last) {
+        pd_pool_entry_t* moved = &pool->entries[last];
+        bool listed = on_free_list(pool, last);
+        if (listed) free_unlink(pool, last);
+        duid_unlink(pool, last);
+        lease_index_remove(&pool->block_index, hash_block(prefix_unit(&moved->prefix), moved->plen), last);
+        *e = *moved;
+        if (lease_index_insert(&pool->block_index, hash_block(prefix_unit(&e->prefix), e->plen), slot) != 0)
+            log_error("pd_pool: out of memory, lost track of a prefix block");
+        duid_relink(pool, slot);
+        if (listed) free_push(pool, slot);
+    }
+    return last;
+}
+
+/* ---- buddy allocator ---- */
+
+// Caller holds pool->lock. Slot of the free block that holds the aligned
+// block unit/order, PD_POOL_NIL if any of it is delegated or out of range.
+static uint32_t free_container(const pd_pool_t* pool, uint64_t unit, uint32_t order) {
+    for (uint32_t o = order; o < PD_POOL_ORDERS; o++) {
+        uint64_t base = unit & ~(order_size(o) - 1);
+        uint32_t slot = block_slot(pool, base, (uint8_t)(PD_POOL_MAX_PLEN - o));
+        if (slot != PD_POOL_NIL)
+            return pool->entries[slot].state == IP6_STATE_AVAILABLE ? slot : PD_POOL_NIL;
+    }
+    return PD_POOL_NIL;
+}
+
+// Caller holds pool->lock. Halves the taken block in @p slot down to @p order,
+// keeping the half that holds @p unit and freeing the other one each time.
+static int split_down(pd_pool_t* pool, uint32_t slot, uint64_t unit, uint32_t order) {
+    uint32_t o = block_order(&pool->entries[slot]);
+    if (entries_reserve(pool, o - order) != 0) return -1;
+    while (o > order) {
+        o--;
+        uint64_t half = order_size(o);
+        uint64_t keep = prefix_unit(&pool->entries[slot].prefix) | (unit & half);
+        block_move(pool, slot, keep, o);
+        if (block_new_free(pool, keep ^ half, o) == PD_POOL_NIL)
+            log_error("pd_pool: out of memory, lost track of a free prefix block");
+    }
+    return 0;
+}
+
+// Caller holds pool->lock. Takes the aligned block unit/order if it is free.
+// Returns its slot, PD_POOL_NIL if not.
+static uint32_t take_exact(pd_pool_t* pool, uint64_t unit, uint32_t order) {
+    uint32_t slot = free_container(pool, unit, order);
+    if (slot == PD_POOL_NIL) return PD_POOL_NIL;
+    take_block(pool, slot);
+    if (split_down(pool, slot, unit, order) != 0) {
+        put_block(pool, slot);
+        return PD_POOL_NIL;
+    }
+    return slot;
+}
+
+// Caller holds pool->lock. Takes a block of @p order from the smallest free
+// block that holds one. Returns its slot, PD_POOL_NIL if none.
+static uint32_t take_smallest(pd_pool_t* pool, uint32_t order) {
+    uint64_t fit = pool->free_orders & ~(order_size(order) - 1);
+    if (!fit) return PD_POOL_NIL;
+    uint32_t slot = pool->free_head[__builtin_ctzll(fit)];
+    take_block(pool, slot);
+    if (split_down(pool, slot, prefix_unit(&pool->entries[slot].prefix), order) != 0) {
+        put_block(pool, slot);
+        return PD_POOL_NIL;
+    }
+    return slot;
+}
+
+// Caller holds pool->lock. Hands the taken block in @p slot to a client.
+static void block_claim(pd_pool_t* pool, uint32_t slot, ip6_state_t state, const char* duid, time_t when) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    e->state = state;
+    e->last_allocated = when;
+    snprintf(e->duid, sizeof(e->duid), "%s", duid ? duid : "");
+    duid_relink(pool, slot);
+    count_state(pool, state, +1);
+}
+
+// Caller holds pool->lock. Frees the delegated block in @p slot and merges it
+// with its buddy while the buddy is free and the parent lies in the range.
+static void block_free(pd_pool_t* pool, uint32_t slot) {
+    pd_pool_entry_t* e = &pool->entries[slot];
+    count_state(pool, e->state, -1);
+    duid_unlink(pool, slot);
+    e->duid[0] = '\0';
+    e->state = IP6_STATE_AVAILABLE;
+    e->free_prev = e->free_next = PD_POOL_NIL;
+
+    for (;;) {
+        e = &pool->entries[slot];
+        uint32_t order = block_order(e);
+        if (order + 1 >= PD_POOL_ORDERS) break;
+        uint64_t unit = prefix_unit(&e->prefix);
+        uint64_t parent = unit & ~(order_size(order + 1) - 1);
+        if (parent < pool->first_unit || parent + (order_size(order + 1) - 1) > pool->last_unit) break;
+
+        uint32_t buddy = block_slot(pool, unit ^ order_size(order), e->plen);
+        if (buddy == PD_POOL_NIL || pool->entries[buddy].state != IP6_STATE_AVAILABLE) break;
+        take_block(pool, buddy);
+        if (block_drop(pool, buddy) == slot) slot = buddy;
+        block_move(pool, slot, parent, order + 1);
+    }
+    put_block(pool, slot);
+}
+
+static uint32_t find_by_duid(const pd_pool_t* pool, const char* duid) {
+    struct lease_index_iter_t it;
+    uint32_t slot;
+    lease_index_find(&pool->duid_index, hash_duid(duid), &it);
+    while (lease_index_next(&pool->duid_index, &it, &slot)) {
+        const pd_pool_entry_t* e = &pool->entries[slot];
+        if (e->state == IP6_STATE_ALLOCATED && strcmp(e->duid, duid) == 0) return slot;
+    }
+    return PD_POOL_NIL;
+}
+
+static void sync_one_lease(const dhcpv6_lease_t* L, void* arg) {
+    pd_pool_t* pool = arg;
+    if (L->type != Lease6_IA_PD) return;
+    if (L->plen == 0 || L->plen > PD_POOL_MAX_PLEN) return;
+
+    ip6_state_t state = ip6_state_from_lease_state(L->state);
+    if (state == IP6_STATE_AVAILABLE || state == IP6_STATE_UNKNOWN) return;
+
+    uint64_t unit = prefix_unit(&L->prefix_v6);
+    uint32_t order = PD_POOL_MAX_PLEN - L->plen;
+    if (unit < pool->first_unit || unit > pool->last_unit) return;
+
+    uint32_t slot = (unit & (order_size(order) - 1)) ? PD_POOL_NIL : take_exact(pool, unit, order);
+    if (slot == PD_POOL_NIL) {
+        char pfx[INET6_ADDRSTRLEN];
+        inet_ntop(AF_INET6, &L->prefix_v6, pfx, sizeof(pfx));
+        log_warn("PD Pool: lease %s/%u is misaligned or overlaps another one, skipped", pfx, L->plen);
+        return;
+    }
+
+    char duid[DUID_MAX_LEN] = "";
+    if (L->duid_len > 0) {
+         duid_bin_to_hex(L->duid, L->duid_len, duid, sizeof(duid));
     }
+    block_claim(pool, slot, state, duid, L->starts);
 }
 
 int pd_pool_init(pd_pool_t *pool, dhcpv6_subnet_t *subnet, lease_v6_db_t *db, uint8_t delegated_plen) {
     if (!pool || !subnet) return -1;
     memset(pool, 0, sizeof(*pool));
-    
+    pthread_mutex_init(&pool->lock, NULL);
+    for (uint32_t o = 0; o < PD_POOL_ORDERS; o++) pool->free_head[o] = PD_POOL_NIL;
+
     pool->subnet = subnet;
     pool->delegated_plen = delegated_plen;
-    
+
     if (!subnet->pd_enabled || !subnet->has_pd_pool) {
         return 0;
     }
-    
-    struct in6_addr cur = subnet->pd_pool_start_bin;
+
+    struct in6_addr start = subnet->pd_pool_start_bin;
     struct in6_addr end = subnet->pd_pool_end_bin;
-    
-    if (ipv6_compare(&cur, &end) > 0) {
+
+    if (ipv6_compare(&start, &end) > 0) {
         return -1;
     }
 
-    pool->base_prefix = cur;
-    pool->base_plen = delegated_plen;
-    
-    while (ipv6_compare(&cur, &end) <= 0) {
-        if (pool->pool_size >= MAX_PD_POOL_SIZE) {
-            fprintf(stderr, "PD Pool full, capping at %d\n", MAX_PD_POOL_SIZE);
-            break;
+    if (delegated_plen == 0 || delegated_plen > PD_POOL_MAX_PLEN) {
+        log_warn("PD Pool: delegated length /%u not in /1../%d, using /%d",
+                 delegated_plen, PD_POOL_MAX_PLEN, PD_POOL_MAX_PLEN);
+        delegated_plen = PD_POOL_MAX_PLEN;
+        pool->delegated_plen = delegated_plen;
+    }
+
+    // Hints may ask for a smaller prefix, a bigger one only when configured
+    pool->hint_min_plen = subnet->has_pd_hint_lengths ? subnet->pd_hint_min_plen : delegated_plen;
+    pool->hint_max_plen = subnet->has_pd_hint_lengths ? subnet->pd_hint_max_plen : PD_POOL_MAX_PLEN;
+    if (pool->hint_max_plen > PD_POOL_MAX_PLEN) pool->hint_max_plen = PD_POOL_MAX_PLEN;
+
+    // The range runs to the end of the last delegated_plen prefix
+    pool->base_prefix = start;
+    pool->first_unit = prefix_unit(&start);
+    pool->last_unit = prefix_unit(&end) + (order_size(PD_POOL_MAX_PLEN - delegated_plen) - 1);
+    if (pool->last_unit < prefix_unit(&end)) pool->last_unit = UINT64_MAX;
+    pool->pool_size = pool->last_unit - pool->first_unit + 1;
+    if (pool->pool_size == 0) pool->pool_size = UINT64_MAX;
+
+    if (lease_index_init(&pool->block_index, 64) != 0 || lease_index_init(&pool->duid_index, 64) != 0) {
+        log_error("PD Pool: out of memory");
+        pd_pool_free(pool);
+        return -1;
+    }
+
+    // Tile the range with the largest aligned blocks that fit
+    uint64_t cur = pool->first_unit;
+    for (;;) {
+        uint32_t order = cur ? (uint32_t)__builtin_ctzll(cur) : PD_POOL_ORDERS - 1;
+        if (order > PD_POOL_ORDERS - 1) order = PD_POOL_ORDERS - 1;
+        while (order > 0 && cur + (order_size(order) - 1) > pool->last_unit) order--;
+
+        if (block_new_free(pool, cur, order) == PD_POOL_NIL) {
+            log_error("PD Pool: out of memory");
+            pd_pool_free(pool);
+            return -1;
         }
-        
-        pd_pool_entry_t* e = &pool->entries[pool->pool_size];
-        e->prefix = cur;
-        e->plen = delegated_plen;
-        e->state = IP6_STATE_AVAILABLE;
-        e->last_allocated = 0;
-        e->duid[0] = '\0';
-        
-        pool->pool_size++;
-        pool->available_count++;
-        
-        struct in6_addr next = cur;
-        increment_prefix(&next, delegated_plen);
-        
-        if (ipv6_compare(&next, &cur) <= 0) break; // Overflow
+        uint64_t next = cur + order_size(order);
+        if (next <= cur || next > pool->last_unit) break;
         cur = next;
     }
-    
+
     char pfx_start[INET6_ADDRSTRLEN], pfx_end[INET6_ADDRSTRLEN];
     inet_ntop(AF_INET6, &subnet->pd_pool_start_bin, pfx_start, sizeof(pfx_start));
     inet_ntop(AF_INET6, &subnet->pd_pool_end_bin, pfx_end, sizeof(pfx_end));
-    log_info("PD Pool initialized: %s - %s / %d (Size: %u)", 
-             pfx_start, pfx_end, delegated_plen, pool->pool_size);
-    
+    log_info("PD Pool initialized: %s - %s / %d (Size: %llu /64s in %u blocks)",
+             pfx_start, pfx_end, delegated_plen, (unsigned long long)pool->pool_size, pool->entry_count);
+
     // Sync with DB
-    if (db) {
-        for (uint32_t i = 0; i < db->count; i++) {
-            dhcpv6_lease_t* L = &db->leases[i];
-            if (L->type != Lease6_IA_PD) continue;
-            if (!L->in_use) continue;
-            
-            pd_pool_entry_t* e = pd_pool_find_entry(pool, &L->prefix_v6, L->plen);
-            if (!e) continue;
-            
-            if (e->state == IP6_STATE_AVAILABLE && pool->available_count > 0) pool->available_count--;
-            else if (e->state == IP6_STATE_ALLOCATED && pool->allocated_count > 0) pool->allocated_count--;
-            
-            e->state = ip6_state_from_lease_state(L->state);
-            e->last_allocated = L->starts;
-            
-            if (L->duid_len > 0) {
-                 duid_bin_to_hex(L->duid, L->duid_len, e->duid, sizeof(e->duid));
-            }
-            
-            if (e->state == IP6_STATE_ALLOCATED) pool->allocated_count++;
-            else if (e->state == IP6_STATE_AVAILABLE) pool->available_count++;
-        }
-    }
-    
+    if (db) lease_v6_db_for_each(db, sync_one_lease, pool);
+
     return 0;
 }
 
 void pd_pool_free(pd_pool_t *pool) {
-    if (pool) memset(pool, 0, sizeof(*pool));
+    if (!pool) return;
+    free(pool->entries);
+    lease_index_free(&pool->block_index);
+    lease_index_free(&pool->duid_index);
+    pthread_mutex_destroy(&pool->lock);
+    memset(pool, 0, sizeof(*pool));
 }
 
 pd_pool_entry_t* pd_pool_find_entry(pd_pool_t *pool, const struct in6_addr *prefix, uint8_t plen) {
-    if (!pool || !prefix) return NULL;
-    for (uint32_t i=0; i<pool->pool_size; i++) {
-        pd_pool_entry_t* e = &pool->entries[i];
-        if (e->plen == plen && ipv6_compare(&e->prefix, prefix) == 0) {
-            return e;
-        }
-    }
-    return NULL;
+    if (!pool || !prefix || !pool->entries) return NULL;
+    if (plen == 0 || plen > PD_POOL_MAX_PLEN) return NULL;
+    uint32_t slot = block_slot(pool, prefix_unit(prefix), plen);
+    return slot == PD_POOL_NIL ? NULL : &pool->entries[slot];
 }
 
 bool pd_pool_is_available(pd_pool_t *pool, const struct in6_addr *prefix, uint8_t plen) {
-    pd_pool_entry_t* e = pd_pool_find_entry(pool, prefix, plen);
-    return (e && e->state == IP6_STATE_AVAILABLE);
+    if (!pool || !prefix || plen == 0 || plen > PD_POOL_MAX_PLEN) return false;
+    uint64_t unit = prefix_unit(prefix);
+    uint32_t order = PD_POOL_MAX_PLEN - plen;
+    if (unit & (order_size(order) - 1)) return false;
+
+    pthread_mutex_lock(&pool->lock);
+    bool available = pool->entries && free_container(pool, unit, order) != PD_POOL_NIL;
+    pthread_mutex_unlock(&pool->lock);
+    return available;
 }
 
 pd_allocation_result_t pd_pool_allocate(pd_pool_t *pool,
                                         const char *duid_hex,
                                         uint16_t duid_len,
                                         uint32_t iaid,
+                                        const struct in6_addr *hint_prefix,
+                                        uint8_t hint_plen,
                                         const char *hostname_opt,
                                         lease_v6_db_t *db,
                                         uint32_t lease_time) {
@@ -150,94 +420,102 @@ pd_allocation_result_t pd_pool_allocate(pd_pool_t *pool,
         snprintf(res.error_message, sizeof(res.error_message), "Invalid pool or db");
         return res;
     }
-    
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (!pool->entries) {
+        pthread_mutex_unlock(&pool->lock);
+        snprintf(res.error_message, sizeof(res.error_message), "No prefixes available");
+        return res;
+    }
+
     // Check existing
-    for (uint32_t i=0; i<pool->pool_size; i++) {
-        pd_pool_entry_t* e = &pool->entries[i];
-        if (e->state == IP6_STATE_ALLOCATED && strcmp(e->duid, duid_hex) == 0) {
-             // Refresh lease
-             if (!lease_v6_add_ia_pd(db, duid_hex, duid_len, iaid, &e->prefix, e->plen, lease_time, hostname_opt)) {
-             }
-             res.success = true;
-             res.is_new = false;
-             res.prefix = e->prefix;
-             res.plen = e->plen;
-             return res;
-        }
+    uint32_t slot = find_by_duid(pool, duid_hex);
+    if (slot != PD_POOL_NIL) {
+         pd_pool_entry_t* e = &pool->entries[slot];
+         // Refresh lease
+         (void)lease_v6_add_ia_pd(db, duid_hex, duid_len, iaid, &e->prefix, e->plen, lease_time, hostname_opt);
+         res.success = true;
+         res.is_new = false;
+         res.prefix = e->prefix;
+         res.plen = e->plen;
+         pthread_mutex_unlock(&pool->lock);
+         return res;
     }
-    
-    // Find free
-    pd_pool_entry_t* victim = NULL;
-    for (uint32_t i=0; i<pool->pool_size; i++) {
-        if (pool->entries[i].state == IP6_STATE_AVAILABLE) {
-            victim = &pool->entries[i];
-            break;
-        }
+
+    // The hinted length if it is one we delegate, the configured one otherwise
+    bool hinted = hint_plen != 0 && hint_plen >= pool->hint_min_plen && hint_plen <= pool->hint_max_plen;
+    uint8_t plen = hinted ? hint_plen : pool->delegated_plen;
+    uint32_t order = PD_POOL_MAX_PLEN - plen;
+
+    slot = PD_POOL_NIL;
+    if (hint_prefix && !IN6_IS_ADDR_UNSPECIFIED(hint_prefix)) {
+        uint64_t unit = prefix_unit(hint_prefix);
+        if ((unit & (order_size(order) - 1)) == 0) slot = take_exact(pool, unit, order);
     }
-    
-    if (!victim) {
-        snprintf(res.error_message, sizeof(res.error_message), "No prefixes available");
+    if (slot == PD_POOL_NIL) slot = take_smallest(pool, order);
+
+    if (slot == PD_POOL_NIL) {
+        pthread_mutex_unlock(&pool->lock);
+        snprintf(res.error_message, sizeof(res.error_message), "No /%u prefixes available", plen);
         return res;
     }
-    
+
     // Allocate
-    victim->state = IP6_STATE_ALLOCATED;
-    strncpy(victim->duid, duid_hex, sizeof(victim->duid)-1);
-    victim->last_allocated = time(NULL);
-    
-    pool->available_count--;
-    pool->allocated_count++;
-    
-    // Persist
-    if (!lease_v6_add_ia_pd(db, duid_hex, duid_len, iaid, &victim->prefix, victim->plen, lease_time, hostname_opt)) {
-        victim->state = IP6_STATE_AVAILABLE;
-        victim->duid[0] = 0;
-        pool->available_count++;
-        pool->allocated_count--;
+    block_claim(pool, slot, IP6_STATE_ALLOCATED, duid_hex, time(NULL));
+    pd_pool_entry_t* e = &pool->entries[slot];
+
+    // Persist (appended to the lease file)
+    if (lease_v6_add_ia_pd(db, duid_hex, duid_len, iaid, &e->prefix, e->plen, lease_time, hostname_opt) != 0) {
+        block_free(pool, slot);
+        pthread_mutex_unlock(&pool->lock);
         snprintf(res.error_message, sizeof(res.error_message), "DB error");
         return res;
     }
-    
-    if (lease_v6_db_save(db) != 0) {
-    }
-    
+
     res.success = true;
     res.is_new = true;
-    res.prefix = victim->prefix;
-    res.plen = victim->plen;
-    
+    res.prefix = e->prefix;
+    res.plen = e->plen;
+
+    pthread_mutex_unlock(&pool->lock);
     return res;
 }
 
 int pd_pool_release(pd_pool_t *pool, const struct in6_addr *prefix, uint8_t plen, lease_v6_db_t *db) {
+     if (!pool) return -1;
+     pthread_mutex_lock(&pool->lock);
      pd_pool_entry_t* e = pd_pool_find_entry(pool, prefix, plen);
-     if (!e) return -1;
-     
+     if (!e) { pthread_mutex_unlock(&pool->lock); return -1; }
+
      if (e->state == IP6_STATE_ALLOCATED) {
-         e->state = IP6_STATE_AVAILABLE;
-         e->duid[0] = 0;
-         if (pool->allocated_count > 0) pool->allocated_count--;
-         pool->available_count++;
-     }
-     
-     if (db) {
-         lease_v6_release_prefix(db, prefix, plen);
-         lease_v6_db_save(db);
+         block_free(pool, (uint32_t)(e - pool->entries));
      }
+
+     if (db) lease_v6_release_prefix(db, prefix, plen);
+     pthread_mutex_unlock(&pool->lock);
      return 0;
 }
 
 void pd_pool_print_stats(const pd_pool_t *pool) {
     if (!pool) return;
     printf("\n--- PD Pool Stats ---\n");
-    printf("Total: %u, Avail: %u, Alloc: %u\n", 
-           pool->pool_size, pool->available_count, pool->allocated_count);
+    printf("Total /64s: %llu, Avail /64s: %llu, Delegated: %u, Reserved: %u, Blocks: %u\n",
+           (unsigned long long)pool->pool_size, (unsigned long long)pool->available_count,
+           pool->allocated_count, pool->reserved_count, pool->entry_count);
+    printf("Free blocks:");
+    for (uint32_t o = PD_POOL_ORDERS; o-- > 0;) {
+        uint32_t n = 0;
+        for (uint32_t s = pool->free_head[o]; s != PD_POOL_NIL; s = pool->entries[s].free_next) n++;
+        if (n) printf(" /%u x%u", PD_POOL_MAX_PLEN - o, n);
+    }
+    printf("\n");
 }
 
 void pd_pool_print_detailed(const pd_pool_t *pool) {
     if (!pool) return;
     printf("\n--- PD Pool Detailed ---\n");
-    for (uint32_t i=0; i<pool->pool_size; i++) {
+    for (uint32_t i=0; i<pool->entry_count; i++) {
         const pd_pool_entry_t* e = &pool->entries[i];
         char pfx[INET6_ADDRSTRLEN];
         inet_ntop(AF_INET6, &e->prefix, pfx, sizeof(pfx));
@@ -14,6 +14,7 @@
 #include <fcntl.h>
 #include <ifaddrs.h>
 #include <net/if.h>
+#include <linux/sock_diag.h>
 
 #include "logger.h"
 #include "config_v6.h"
@@ -23,10 +24,15 @@
 #include "protocol_v6.h"
 #include "utilsv6.h"
 #include "shm_stats.h"
+#include "packet_queue6.h"
 
-#define BUF_SIZE 4096
+#define BUF_SIZE PKT6_BUF_SIZE
 #define THREAD_POOL_SIZE 8
 #define QUEUE_SIZE 256
+// Buffers: a full queue, one per worker and one receive batch. The ring has
+// a cell for each of them, so a received packet always finds a place in it;
+// when the buffers run out the socket buffer takes the excess.
+#define PKT_POOL_SIZE (QUEUE_SIZE + THREAD_POOL_SIZE + PKT6_RECV_BATCH)
 
 #include "dhcpv6_agent.h"
 
@@ -36,37 +42,19 @@ void dhcpv6_agent_stop() {
     running = 0;
 }
 
-// --- Thread Pool Structs ---
-typedef struct {
-    uint8_t buf[BUF_SIZE];
-    ssize_t len;
-    struct sockaddr_in6 client_addr;
-} task_t;
-
-/**
- * @brief Thread-safe task queue for distributing DHCPv6 packets to worker threads.
- */
-typedef struct {
-    task_t tasks[QUEUE_SIZE];
-    int head;
-    int tail;
-    int count;
-    pthread_mutex_t lock;   // Protects queue access
-    pthread_cond_t  cond;   // Signals workers when new tasks arrive
-    int shutdown;           // Flag to signal server shutdown
-} task_queue_t;
-
 // Structs Definition
 
 // Main server context.
-// Holds the config, database, IP pools, and the socket/sync primitives.
+// Holds the config, database, IP pools, and the socket.
+// The config is read-only once the workers run; each pool locks itself
+// (per subnet) and the lease DB locks per shard, so workers only contend
+// when they touch the same subnet or the same lease shard.
 typedef struct {
     dhcpv6_config_t config;             // Parsed config settings
     lease_v6_db_t   db;                 // Database for persisting leases
     struct ip6_pool_t pools[MAX_SUBNET_V6]; // In-memory bitmaps (fast lookup)
     pd_pool_t       pd_pools[MAX_SUBNET_V6];// Prefix Delegation pools
     int             server_sock;        // Main UDP socket
-    pthread_mutex_t     db_lock;        // Big lock for DB and Pool access
     
     // Shared Memory for the Dashboard
     int shm_fd;
@@ -74,41 +62,11 @@ typedef struct {
 } server_ctx_t;
 
 static server_ctx_t ctx;
-static task_queue_t queue;
+static pkt6_pool_t pkt_pool;   // Receive buffers, recycled by the workers
+static pkt6_ring_t queue;      // Received packets waiting for a worker
 static pthread_t threads[THREAD_POOL_SIZE];
 static pthread_t cleaner_thread;
 
-// Thread Pool / Task Queue Logic
-
-// Initialize the task queue.
-// Just zeroes out indices and sets up the synchronization primitives.
-void queue_init(task_queue_t* q) {
-    q->head = 0;
-    q->tail = 0;
-    q->count = 0;
-    q->shutdown = 0;
-    pthread_mutex_init(&q->lock, NULL);
-    pthread_cond_init(&q->cond, NULL);
-}
-
-// Add a new packet to the queue.
-// It's thread-safe: locks the queue, copies data, and signals a worker.
-void queue_push(task_queue_t* q, const uint8_t* buf, ssize_t len, const struct sockaddr_in6* addr) {
-    pthread_mutex_lock(&q->lock);
-    if (q->count < QUEUE_SIZE && !q->shutdown) {
-        task_t* t = &q->tasks[q->tail];
-        memcpy(t->buf, buf, len);
-        t->len = len;
-        t->client_addr = *addr;
-        q->tail = (q->tail + 1) % QUEUE_SIZE;
-        q->count++;
-        pthread_cond_signal(&q->cond); // Wake up a sleeping worker
-    } else {
-        log_warn("Queue full or shutting down, dropping packet.");
-    }
-    pthread_mutex_unlock(&q->lock);
-}
-
 // Helpers
 dhcpv6_subnet_t* find_subnet(const struct in6_addr* src_ip) {
     if (!src_ip) return &ctx.config.subnets[0];
@@ -148,9 +106,6 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
     uint8_t out_buf[BUF_SIZE];
     size_t out_len = 0; // Current offset
     
-
-    pthread_mutex_lock(&ctx.db_lock);
-    
     dhcpv6_subnet_t* subnet = find_subnet(&client_addr->sin6_addr);
     struct ip6_pool_t* pool = get_pool_by_subnet(subnet);
     pd_pool_t* pd_pool = get_pd_pool_by_subnet(subnet);
@@ -167,7 +122,7 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
     
     if (reply_type != 0) {
         // Init Header
-        if (sizeof(dhcpv6_header_t) > BUF_SIZE) { pthread_mutex_unlock(&ctx.db_lock); return; }
+        if (sizeof(dhcpv6_header_t) > BUF_SIZE) return;
         
         dhcpv6_header_t *hdr = (dhcpv6_header_t *)out_buf;
         hdr->msg_type = reply_type;
@@ -185,7 +140,7 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
         
         // Handle RELEASE / DECLINE Actions (Pre-processing before building reply)
         if (meta.msg_type == MSG_RELEASE || meta.msg_type == MSG_DECLINE) {
-             if (meta.has_ia_na && ctx.db.count > 0) {
+             if (meta.has_ia_na) {
                  if (meta.msg_type == MSG_RELEASE) {
                      lease_v6_release_ip(&ctx.db, &meta.requested_ip); 
                  } else {
@@ -249,8 +204,10 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
                                       0, 0, 0, 0, STATUS_SUCCESS);
                     if(ctx.stats) __sync_fetch_and_sub(&ctx.stats->leases_active, 1);
              } else {
-                 pd_allocation_result_t res = pd_pool_allocate(pd_pool, duid_hex, meta.client_duid_len, 
-                                                               meta.iaid_pd, NULL, &ctx.db, subnet->default_lease_time);
+                 pd_allocation_result_t res = pd_pool_allocate(pd_pool, duid_hex, meta.client_duid_len, meta.iaid_pd,
+                                                               meta.has_requested_prefix ? &meta.requested_prefix : NULL,
+                                                               meta.has_requested_prefix ? meta.requested_plen : 0,
+                                                               NULL, &ctx.db, subnet->default_lease_time);
                  
                  if (res.success) {
                       dhcpv6_append_ia_pd(out_buf, BUF_SIZE, &out_len, meta.iaid_pd, &res.prefix, res.plen,
@@ -265,8 +222,11 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
         }
     }
     
-    // Done with DB, unlock.
-    pthread_mutex_unlock(&ctx.db_lock);
+    // Lease records were appended with the pools locked; flush them to disk
+    // now, before the client is told about them
+    if (reply_type != 0 && (meta.has_ia_na || meta.has_ia_pd)) {
+        (void)lease_v6_db_sync(&ctx.db);
+    }
     
     if (out_len > sizeof(dhcpv6_header_t)) {
         char dest_str[INET6_ADDRSTRLEN];
@@ -281,8 +241,44 @@ void process_packet(uint8_t* buf, ssize_t len, struct sockaddr_in6* client_addr)
     }
 }
 
+// Packets the receive loop lost, reported at most once a second
+typedef struct {
+    uint64_t queue_full;      // Received, but the queue to the workers was full
+    uint64_t socket_overflow; // Dropped by the kernel, the socket buffer was full
+    uint32_t sk_drops_seen;   // Last SK_MEMINFO_DROPS (the socket's total drops)
+    uint64_t reported;        // queue_full + socket_overflow at the last report
+    time_t   last_report;
+} rx_drops_t;
+
+static void report_drops(rx_drops_t* d) {
+    time_t now = time(NULL);
+    if (now == d->last_report) return;
+    d->last_report = now;
+    
+    // The kernel's count of datagrams it could not queue on the socket
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t mlen = sizeof(meminfo);
+    if (getsockopt(ctx.server_sock, SOL_SOCKET, SO_MEMINFO, meminfo, &mlen) == 0 && mlen > SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+        d->socket_overflow += (uint32_t)(meminfo[SK_MEMINFO_DROPS] - d->sk_drops_seen);
+        d->sk_drops_seen = meminfo[SK_MEMINFO_DROPS];
+    }
+    
+    uint64_t total = d->queue_full + d->socket_overflow;
+    if (total == d->reported) return;
+    if (ctx.stats) __sync_fetch_and_add(&ctx.stats->pkt_dropped, total - d->reported);
+    log_warn("Dropped %lu packet(s) since the last report (total: %lu queue full, %lu socket overflow)",
+             total - d->reported, d->queue_full, d->socket_overflow);
+    d->reported = total;
+}
+
+static void count_active(const dhcpv6_lease_t* lease, void* arg) {
+    if (lease->state == LEASE_STATE_ACTIVE) (*(uint64_t*)arg)++;
+}
+
 // Cleanup / Garbage Collector Thread.
 // Runs once a minute to expire old leases.
+// Takes one pool or one lease shard at a time, and writes the lease file
+// from a snapshot, so the workers keep running meanwhile.
 void* cleanup_thread(void* arg) {
     (void)arg;
     log_info("Cleanup thread started.");
@@ -293,55 +289,41 @@ void* cleanup_thread(void* arg) {
         
         log_debug("Running cleanup...");
         
-        pthread_mutex_lock(&ctx.db_lock);
+        // Shutdown cancels this thread: only while it sleeps, never with a
+        // lease DB lock held
+        int cancel_state;
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
         
         // 1. Mark old leases as expired
-        int expired = lease_v6_mark_expired_older(&ctx.db);
-        
-        // 2. Actually remove them from memory
-        if (expired > 0) {
-             lease_v6_cleanup(&ctx.db);
-        }
+        (void)lease_v6_mark_expired_older(&ctx.db);
         
-        // 3. Sync ip pools (bitmaps) with the DB reality
+        // 2. Sync ip pools (bitmaps) with the DB reality, while the expired
+        //    and released leases are still there to free their addresses
         for(int i=0; i<ctx.config.subnet_count; i++) {
             ip6_pool_sync_with_leases(&ctx.pools[i], &ctx.db);
             // PD pools check DB directly
         }
         
+        // 3. Actually remove them from memory
+        (void)lease_v6_cleanup(&ctx.db);
+        
         // 4. Update Dashboard stats (Shared Memory)
         uint64_t active_count = 0;
-        for(uint32_t j=0; j<ctx.db.count; j++) {
-            if(ctx.db.leases[j].state == LEASE_STATE_ACTIVE) active_count++;
-        }
+        lease_v6_db_for_each(&ctx.db, count_active, &active_count);
         if(ctx.stats) ctx.stats->leases_active = active_count;
 
-        lease_v6_db_save(&ctx.db); // Persist to disk
-        pthread_mutex_unlock(&ctx.db_lock);
+        lease_v6_db_save(&ctx.db); // Persist to disk (compacts the appended records)
+        pthread_setcancelstate(cancel_state, NULL);
     }
     return NULL;
 }
 
 void* worker_thread(void* arg) {
     (void)arg;
-    while (1) {
-        pthread_mutex_lock(&queue.lock);
-        while (queue.count == 0 && !queue.shutdown) {
-            pthread_cond_wait(&queue.cond, &queue.lock);
-        }
-        if (queue.shutdown) {
-            pthread_mutex_unlock(&queue.lock);
-            break;
-        }
-        
-        task_t task = queue.tasks[queue.head];
-        queue.head = (queue.head + 1) % QUEUE_SIZE;
-        queue.count--;
-        
-        pthread_mutex_unlock(&queue.lock);
-        
-        // Removed early increment. Moved to process_packet success path.
-        process_packet(task.buf, task.len, &task.client_addr);
+    pkt6_t* pkt;
+    while ((pkt = pkt6_ring_pop_wait(&queue)) != NULL) {
+        process_packet(pkt->buf, pkt->len, &pkt->client_addr);
+        pkt6_pool_release(&pkt_pool, pkt);
     }
     return NULL;
 }
@@ -364,9 +346,6 @@ void* dhcpv6_agent_start(void* arg) {
     convert_all_to_binary(&ctx.config);
     log_info("Config loaded.");
     
-    // Init DB usage Mutex
-    pthread_mutex_init(&ctx.db_lock, NULL);
-
     // Init DB
     if (lease_v6_db_init(&ctx.db, "DHCPv6/leases/dhcpd6.leases") != 0) {
         log_error("Failed to init lease DB");
@@ -403,8 +382,11 @@ void* dhcpv6_agent_start(void* arg) {
         pd_pool_init(&ctx.pd_pools[i], &ctx.config.subnets[i], &ctx.db, ctx.config.subnets[i].pd_prefix_len);
     }
 
-    // Init Thread Pool
-    queue_init(&queue);
+    // Init Thread Pool and the buffers it is fed from
+    if (pkt6_pool_init(&pkt_pool, PKT_POOL_SIZE) != 0 || pkt6_ring_init(&queue, PKT_POOL_SIZE) != 0) {
+        log_error("Failed to allocate the packet queue");
+        return NULL;
+    }
     
     for (int i=0; i<THREAD_POOL_SIZE; i++) {
         if (pthread_create(&threads[i], NULL, worker_thread, NULL) != 0) {
@@ -478,12 +460,20 @@ void* dhcpv6_agent_start(void* arg) {
 
     log_info("Listening on port %d...", DHCPV6_PORT_SERVER);
     
-    uint8_t buf[BUF_SIZE];
     struct pollfd pfd;
     pfd.fd = ctx.server_sock;
     pfd.events = POLLIN;
     
+    // Each recvmmsg() call fills up to PKT6_RECV_BATCH pool buffers in place;
+    // buffers not filled by a call stay with the loop for the next one.
+    pkt6_t* batch[PKT6_RECV_BATCH] = {0};
+    struct mmsghdr msgs[PKT6_RECV_BATCH];
+    struct iovec iovecs[PKT6_RECV_BATCH];
+    rx_drops_t drops = { .last_report = time(NULL) };
+    
     while (running) {
+        report_drops(&drops);
+        
         int ret = poll(&pfd, 1, 1000); // 1 sec timeout
         
         if (ret < 0) {
@@ -493,37 +483,73 @@ void* dhcpv6_agent_start(void* arg) {
         }
         
         if (ret == 0) continue; // Timeout, check running
+        if (!(pfd.revents & POLLIN)) continue;
         
-        if (pfd.revents & POLLIN) {
-            struct sockaddr_in6 client_addr;
-            socklen_t slen = sizeof(client_addr);
-            
-            ssize_t len = recvfrom(ctx.server_sock, buf, BUF_SIZE, 0, (struct sockaddr*)&client_addr, &slen);
-            if (len < 0) {
-                if (errno == EINTR) continue;
-                perror("recvfrom");
-                break;
-            }
+        int ready = 0;
+        for (int i = 0; i < PKT6_RECV_BATCH; i++) {
+            if (!batch[i]) batch[i] = pkt6_pool_acquire(&pkt_pool);
+            if (!batch[i]) continue;
             
-            if (ctx.stats) __sync_fetch_and_add(&ctx.stats->pkt_received, 1);
+            // Compact the buffers to the front so that msgs[] maps 1:1 onto batch[]
+            pkt6_t* pkt = batch[i];
+            batch[i] = NULL;
+            batch[ready] = pkt;
             
-            // Push to Queue instead of processing directly
-            queue_push(&queue, buf, len, &client_addr);
+            iovecs[ready].iov_base = pkt->buf;
+            iovecs[ready].iov_len = sizeof(pkt->buf);
+            memset(&msgs[ready], 0, sizeof(msgs[ready]));
+            msgs[ready].msg_hdr.msg_name = &pkt->client_addr;
+            msgs[ready].msg_hdr.msg_namelen = sizeof(pkt->client_addr);
+            msgs[ready].msg_hdr.msg_iov = &iovecs[ready];
+            msgs[ready].msg_hdr.msg_iovlen = 1;
+            ready++;
+        }
+        
+        if (ready == 0) {
+            // Every buffer is queued or with a worker. The socket buffer takes
+            // the burst meanwhile; what it cannot take, report_drops() counts.
+            usleep(1000);
+            continue;
+        }
+        
+        int received = recvmmsg(ctx.server_sock, msgs, ready, MSG_DONTWAIT, NULL);
+        if (received < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            perror("recvmmsg");
+            break;
         }
+        
+        if (ctx.stats) __sync_fetch_and_add(&ctx.stats->pkt_received, received);
+        
+        for (int i = 0; i < received; i++) batch[i]->len = msgs[i].msg_len;
+        
+        // Hand the buffers themselves to the workers
+        int queued = pkt6_ring_push(&queue, batch, received);
+        for (int i = queued; i < received; i++) {
+            pkt6_pool_release(&pkt_pool, batch[i]);
+            drops.queue_full++;
+        }
+        
+        // Keep the unfilled buffers for the next call, shifted down over the consumed ones
+        memmove(&batch[0], &batch[received], (ready - received) * sizeof(batch[0]));
+        memset(&batch[ready - received], 0, (PKT6_RECV_BATCH - (ready - received)) * sizeof(batch[0]));
     }
+    report_drops(&drops);
     
     // Cleanup
     log_info("Shutting down...");
     
-    // Stop threads
-    pthread_mutex_lock(&queue.lock);
-    queue.shutdown = 1;
-    pthread_cond_broadcast(&queue.cond);
-    pthread_mutex_unlock(&queue.lock);
+    // Stop threads, once they have answered what is queued
+    pkt6_ring_shutdown(&queue);
     
     for (int i=0; i<THREAD_POOL_SIZE; i++) {
         pthread_join(threads[i], NULL);
     }
+    for (int i = 0; i < PKT6_RECV_BATCH; i++) {
+        if (batch[i]) pkt6_pool_release(&pkt_pool, batch[i]);
+    }
+    pkt6_ring_free(&queue);
+    pkt6_pool_free(&pkt_pool);
     pthread_cancel(cleaner_thread);
     pthread_join(cleaner_thread, NULL);
     
@@ -536,7 +562,6 @@ void* dhcpv6_agent_start(void* arg) {
         pd_pool_free(&ctx.pd_pools[i]);
     }
     close(ctx.server_sock);
-    pthread_mutex_destroy(&ctx.db_lock);
     
     // Unlink SHM (Cleanup)
     if (ctx.stats) munmap(ctx.stats, sizeof(server_stats_t));
@@ -24,6 +24,7 @@
 #include <time.h>
 
 #include "../DHCPv4/include/src/dhcp_common.h"
+#include "../DHCPv4/include/src/dhcp_options.h"
 #include "client_v4.h"
 #include "../logger/logger.h"
 
@@ -62,81 +63,15 @@ int get_if_index_v4(const char* ifname)
 }
 
 /**
- * @brief Parse DHCP options to extract message type
+ * @brief Index the options of a received packet and return its message type
  */
-uint8_t get_dhcp_message_type(const struct dhcp_packet* packet)
+static uint8_t index_reply(const struct dhcp_packet* packet, ssize_t len, struct dhcp_option_index_t* options)
 {
-    int offset = 4; // Skip magic cookie
-    
-    // Verify magic cookie
-    uint32_t cookie;
-    memcpy(&cookie, packet->options, 4);
-    if (ntohl(cookie) != DHCP_MAGIC_COOKIE)
+    if (dhcp_options_parse(packet, len, options) != 0)
     {
         return 0;
     }
-    
-    while (offset < DHCP_OPTIONS_SIZE)
-    {
-        uint8_t code = packet->options[offset];
-        
-        if (code == DHCP_OPT_END) break;
-        if (code == DHCP_OPT_PAD)
-        {
-            offset++;
-            continue;
-        }
-        
-        uint8_t len = packet->options[offset + 1];
-        
-        if (code == DHCP_OPT_MESSAGE_TYPE && len == 1)
-        {
-            return packet->options[offset + 2];
-        }
-        
-        offset += 2 + len;
-    }
-    
-    return 0;
-}
-
-/**
- * @brief Get requested IP address from DHCP option
- */
-int get_dhcp_requested_ip(const struct dhcp_packet* packet, struct in_addr* ip)
-{
-    int offset = 4;
-    
-    uint32_t cookie;
-    memcpy(&cookie, packet->options, 4);
-    if (ntohl(cookie) != DHCP_MAGIC_COOKIE)
-    {
-        return -1;
-    }
-    
-    while (offset < DHCP_OPTIONS_SIZE)
-    {
-        uint8_t code = packet->options[offset];
-        
-        if (code == DHCP_OPT_END) break;
-        if (code == DHCP_OPT_PAD)
-        {
-            offset++;
-            continue;
-        }
-        
-        uint8_t len = packet->options[offset + 1];
-        
-        if (code == DHCP_OPT_SERVER_ID && len == 4)
-        {
-            memcpy(&ip->s_addr, &packet->options[offset + 2], 4);
-            return 0;
-        }
-        
-        offset += 2 + len;
-    }
-    
-    return -1;
+    return dhcp_options_get_u8(packet, options, DHCP_OPT_MESSAGE_TYPE);
 }
 
 /**
@@ -416,6 +351,7 @@ int main(int argc, char** argv)
     
     struct dhcp_packet tx_packet;
     struct dhcp_packet rx_packet;
+    struct dhcp_option_index_t rx_options;
     
     struct in_addr offered_ip = {0};
     struct in_addr server_id = {0};
@@ -468,14 +404,14 @@ int main(int argc, char** argv)
             if (len > 0)
             {
                 uint32_t rx_xid = ntohl(rx_packet.xid);
-                uint8_t msg_type = get_dhcp_message_type(&rx_packet);
+                uint8_t msg_type = index_reply(&rx_packet, len, &rx_options);
 
                 log_debug("[DEBUG] Received message type=%d, XID=0x%x (Expected=0x%x)", msg_type, rx_xid, xid);
 
                 if (msg_type == DHCP_OFFER && rx_xid == xid)
                 {
                     offered_ip = rx_packet.yiaddr;
-                    get_dhcp_requested_ip(&rx_packet, &server_id);
+                    dhcp_options_get_ip(&rx_packet, &rx_options, DHCP_OPT_SERVER_ID, &server_id);
 
                     log_info("<<< OFFER RECEIVED: Server offers IP %s", inet_ntoa(offered_ip));
 
@@ -522,7 +458,7 @@ int main(int argc, char** argv)
             if (len > 0)
             {
                 uint32_t rx_xid = ntohl(rx_packet.xid);
-                uint8_t msg_type = get_dhcp_message_type(&rx_packet);
+                uint8_t msg_type = index_reply(&rx_packet, len, &rx_options);
 
                 if (msg_type == DHCP_ACK && rx_xid == xid)
                 {
@@ -611,7 +547,7 @@ int main(int argc, char** argv)
             if (len > 0)
             {
                 uint32_t rx_xid = ntohl(rx_packet.xid);
-                uint8_t msg_type = get_dhcp_message_type(&rx_packet);
+                uint8_t msg_type = index_reply(&rx_packet, len, &rx_options);
 
                 if (msg_type == DHCP_ACK && rx_xid == xid)
                 {
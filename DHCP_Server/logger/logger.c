@@ -3,18 +3,79 @@
 #include <string.h>
 #include <time.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include <stdio.h>
 #include "logger.h"
 
-static log_level_t g_level = LOG_INFO;
+#define LOG_LINE_MAX 1024                 /* Longest line, newline included */
+#define LOG_RING_SIZE (256 * 1024)        /* Bytes of ring per thread, power of two */
+#define LOG_MAX_THREADS 256               /* Threads with a ring; others log synchronously */
+#define LOG_WRITER_IOV 64                 /* Lines per writev() */
+#define LOG_WRITER_IDLE_NS (20 * 1000000) /* Writer sleep when there is nothing to write */
+
+int g_log_level = LOG_INFO;
 static char g_prefix[32];  // ex [DHCPv6]
 static int g_fd = -1;       /* file descriptor for file logging */
 static int g_use_file = 0; /* 1 -> use g_fd; 0 -> stdout/stderr */
 static int g_inited = 0;   /* 1 -> init_logger() succeeded at least once */
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * One ring per logging thread: a byte ring of records, each an 8-byte
+ * header and the formatted line, padded to 8 bytes. A record never wraps;
+ * when it does not fit before the end the producer fills the rest with a
+ * skip record. Only the owning thread moves tail and only the writer moves
+ * head, so neither side takes a lock.
+ */
+struct log_record_t
+{
+    uint32_t size;  /* Header + line + padding */
+    uint16_t len;   /* Line bytes */
+    uint8_t level;
+    uint8_t skip;   /* Padding up to the end of the ring */
+};
+
+struct log_ring_t
+{
+    _Alignas(64) uint64_t tail;    /* Producer position */
+    uint64_t dropped;              /* Lines dropped on a full ring (LOG_OVERFLOW_DROP_VERBOSE) */
+    _Alignas(64) uint64_t head;    /* Writer position */
+    uint64_t dropped_reported;     /* Writer-private */
+    int dead;                      /* Owning thread exited: free once drained */
+    _Alignas(64) char data[LOG_RING_SIZE];
+};
+
+static struct log_ring_t *g_rings[LOG_MAX_THREADS];
+static pthread_mutex_t g_rings_lock = PTHREAD_MUTEX_INITIALIZER; /* Slot changes only */
+static int g_async = 1;            /* 0 -> log_set_async(false) */
+static int g_overflow = LOG_OVERFLOW_WAIT;
+static int g_writer_running = 0;
+static int g_writer_stop = 0;
+static int g_writer_idle = 0;      /* Writer is (about to be) asleep: producers may wake it */
+static uint64_t g_drain_passes = 0; /* Completed drain_all() passes */
+static int g_pass_waiters = 0;     /* Threads in log_flush() or waiting for room: the writer reports each pass */
+static int g_writer_done = 0;      /* Writer wrote its last lines and is leaving */
+static pthread_t g_writer;
+static pthread_mutex_t g_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_ring_key;
+
+static _Thread_local struct log_ring_t *t_ring;
+static _Thread_local int t_ring_failed;   /* No ring for this thread: log synchronously */
+static int g_prefix_gen = 0;       /* Bumped by init_logger(): cached line heads are stale */
+static _Thread_local time_t t_ts_second = -1;
+static _Thread_local int t_ts_gen = -1;
+static _Thread_local char t_ts[32];
+static _Thread_local char t_head[64];    /* "<timestamp> <prefix> " */
+static _Thread_local size_t t_head_len;
+
+static const char *const LEVEL_TAG[] = { "[DEBUG] ", "[INFO] ", "[WARN] ", "[ERROR] " };
+
 //Internal helpers (minimal and allocation-free)
 
 /** Choose output FD (file, stderr for WARN/ERROR, stdout for INFO/DEBUG) */
@@ -32,10 +93,9 @@ static int pick_fd_for_level(log_level_t level)
     }
 }
 
-/** Build UTC timestamp "YYYY-MM-DD HH:MM:SS" */
-static void build_timestamp(char *dst, size_t dst_sz)
+/** Build local timestamp "YYYY-MM-DD HH:MM:SS" */
+static void build_timestamp(char *dst, size_t dst_sz, time_t now)
 {
-    time_t now = time(NULL);
     struct tm tmbuf;
     struct tm *tm = localtime_r(&now, &tmbuf);
     if (!tm)
@@ -47,49 +107,427 @@ static void build_timestamp(char *dst, size_t dst_sz)
     strftime(dst, dst_sz, "%Y-%m-%d %H:%M:%S", tm);
 }
 
+/** Timestamp of the current second, rebuilt by each thread once a second */
+static const char *cached_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    int gen = __atomic_load_n(&g_prefix_gen, __ATOMIC_RELAXED);
+    if (ts.tv_sec != t_ts_second || gen != t_ts_gen)
+    {
+        build_timestamp(t_ts, sizeof(t_ts), ts.tv_sec);
+        int len = snprintf(t_head, sizeof(t_head), "%s %s ", t_ts, (g_prefix[0] ? g_prefix : ""));
+        t_head_len = len < 0 ? 0 : (size_t)len < sizeof(t_head) ? (size_t)len : sizeof(t_head) - 1;
+        t_ts_second = ts.tv_sec;
+        t_ts_gen = gen;
+    }
+    return t_ts;
+}
 
-/** Append formatted string to buffer, truncating if necessary */
-__attribute__((unused))
-static void buff_append_format(char *buf, int buf_sz, int *len, const char *fmt, va_list ap)
+/** Format a complete line, newline included; returns its length */
+static size_t format_line(char *line, log_level_t level, const char *format, va_list ap)
 {
+    // Only the message itself goes through printf: the head is reused for a second
+    cached_timestamp();
+    size_t tag_len = strlen(LEVEL_TAG[level]);
+    memcpy(line, t_head, t_head_len);
+    memcpy(line + t_head_len, LEVEL_TAG[level], tag_len);
+    int len = (int)(t_head_len + tag_len);
+
+    int written = vsnprintf(line + len, LOG_LINE_MAX - len, format, ap);
+    if (written > 0)
+        len += written;
+    if (len > LOG_LINE_MAX - 2)
+        len = LOG_LINE_MAX - 2; /* Truncated */
+    line[len++] = '\n';
+    line[len] = '\0';
+    return (size_t)len;
+}
 
-    if (*len >= buf_sz) return;
-    int written = vsnprintf(buf + *len, buf_sz - *len, fmt, ap);
-    if (written < 0)
+/** write() all of a buffer list, resuming after short writes */
+static void writev_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
     {
-        /* Ignore formatting errors, keep what we have. */
-        return;
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+            return; /* Nowhere left to report it */
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+}
+
+/** Write one line from the calling thread (synchronous mode and fallback) */
+static void write_line_sync(log_level_t level, const char *line, size_t len)
+{
+    int fd = pick_fd_for_level(level);
+    if (fd >= 0) write(fd, line, len);
+
+    // If writing to file, also mirror to console (stdout/stderr)
+    if (g_use_file && g_fd >= 0) {
+        if (level == LOG_ERROR || level == LOG_WARN) {
+             write(2, line, len);
+        } else {
+             write(1, line, len);
+        }
     }
-    if (written >= (buf_sz - *len))
+}
+
+/** Broadcast: log_flush() callers wait on g_wake too, a signal could wake one of them instead */
+static void wake_writer(void)
+{
+    pthread_mutex_lock(&g_wake_lock);
+    pthread_cond_broadcast(&g_wake);
+    pthread_mutex_unlock(&g_wake_lock);
+}
+
+/** pthread key destructor: the thread is gone, the writer frees its ring once drained */
+static void ring_orphan(void *arg)
+{
+    struct log_ring_t *ring = arg;
+    t_ring = NULL;
+    __atomic_store_n(&ring->dead, 1, __ATOMIC_RELEASE);
+}
+
+static void logger_at_exit(void);
+
+static void logger_once(void)
+{
+    pthread_key_create(&g_ring_key, ring_orphan);
+    atexit(logger_at_exit);
+}
+
+/** Give the calling thread a ring, or NULL to make it log synchronously */
+static struct log_ring_t *ring_register(void)
+{
+    struct log_ring_t *ring = NULL;
+    if (posix_memalign((void **)&ring, 64, sizeof(struct log_ring_t)) != 0)
     {
-        /* Truncated */
-        *len = buf_sz - 1;
+        t_ring_failed = 1;
+        return NULL;
     }
-    else
+    ring->tail = ring->head = 0;
+    ring->dropped = ring->dropped_reported = 0;
+    ring->dead = 0;
+
+    pthread_mutex_lock(&g_rings_lock);
+    int slot = -1;
+    for (int i = 0; i < LOG_MAX_THREADS && slot < 0; i++)
     {
-        *len += written;
+        if (!g_rings[i])
+            slot = i;
     }
-}                                                                                                   
+    if (slot >= 0)
+        __atomic_store_n(&g_rings[slot], ring, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_rings_lock);
 
+    if (slot < 0)
+    {
+        free(ring);
+        t_ring_failed = 1;
+        return NULL;
+    }
+    pthread_setspecific(g_ring_key, ring);
+    t_ring = ring;
+    return ring;
+}
 
-log_level_t log_get_level()
+/** Append a line to a ring; false if it is full */
+static bool ring_push(struct log_ring_t *ring, log_level_t level, const char *line, size_t len)
+{
+    uint32_t size = (uint32_t)((sizeof(struct log_record_t) + len + 7) & ~(size_t)7);
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t offset = (uint32_t)(tail & (LOG_RING_SIZE - 1));
+    uint32_t pad = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+
+    if (tail + pad + size - head > LOG_RING_SIZE)
+        return false;
+    if (pad)
+    {
+        struct log_record_t *skip = (struct log_record_t *)&ring->data[offset];
+        skip->size = pad;
+        skip->skip = 1;
+        offset = 0;
+    }
+
+    struct log_record_t *rec = (struct log_record_t *)&ring->data[offset];
+    rec->size = size;
+    rec->len = (uint16_t)len;
+    rec->level = (uint8_t)level;
+    rec->skip = 0;
+    memcpy(rec + 1, line, len);
+
+    __atomic_store_n(&ring->tail, tail + pad + size, __ATOMIC_RELEASE);
+
+    // The writer wakes up on its own every few ms; hurry it only when the
+    // ring fills up or something went wrong
+    if (__atomic_load_n(&g_writer_idle, __ATOMIC_RELAXED) &&
+        (level >= LOG_WARN || tail + pad + size - head > LOG_RING_SIZE / 2))
+        wake_writer();
+    return true;
+}
+
+/** Queued lines for one destination, written with writev() once full */
+struct iov_batch_t
+{
+    int fd;
+    int count;
+    struct iovec iov[LOG_WRITER_IOV];
+};
+
+static void batch_add(struct iov_batch_t *batch, const void *base, size_t len)
+{
+    if (batch->count == LOG_WRITER_IOV)
+    {
+        writev_all(batch->fd, batch->iov, batch->count);
+        batch->count = 0;
+    }
+    batch->iov[batch->count].iov_base = (void *)base;
+    batch->iov[batch->count].iov_len = len;
+    batch->count++;
+}
+
+static void batch_flush(struct iov_batch_t *batch)
+{
+    if (batch->count > 0)
+        writev_all(batch->fd, batch->iov, batch->count);
+    batch->count = 0;
+}
+
+/** Write everything a ring holds; returns the number of lines */
+static size_t ring_drain(struct log_ring_t *ring)
+{
+    struct iov_batch_t out = {.fd = pick_fd_for_level(LOG_INFO)};
+    struct iov_batch_t console_out = {.fd = 1};
+    struct iov_batch_t console_err = {.fd = 2};
+    bool mirror = g_use_file && g_fd >= 0;
+    size_t lines = 0;
+
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    for (uint64_t pos = head; pos != tail;)
+    {
+        const struct log_record_t *rec = (const struct log_record_t *)&ring->data[pos & (LOG_RING_SIZE - 1)];
+        pos += rec->size;
+        if (rec->skip)
+            continue;
+
+        bool err = rec->level == LOG_ERROR || rec->level == LOG_WARN;
+        if (mirror)
+        {
+            batch_add(&out, rec + 1, rec->len);
+            batch_add(err ? &console_err : &console_out, rec + 1, rec->len);
+        }
+        else
+        {
+            batch_add(err ? &console_err : &console_out, rec + 1, rec->len);
+        }
+        lines++;
+    }
+    batch_flush(&out);
+    batch_flush(&console_out);
+    batch_flush(&console_err);
+    __atomic_store_n(&ring->head, tail, __ATOMIC_RELEASE);
+
+    uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    if (dropped != ring->dropped_reported)
+    {
+        char line[128];
+        int len = snprintf(line, sizeof(line), "%s %s [WARN] Logger: %lu message(s) dropped, log ring full\n",
+                           cached_timestamp(), (g_prefix[0] ? g_prefix : ""),
+                           (unsigned long)(dropped - ring->dropped_reported));
+        write_line_sync(LOG_WARN, line, (size_t)len);
+        ring->dropped_reported = dropped;
+    }
+    return lines;
+}
+
+/** Drain every ring once, freeing those of exited threads; returns the number of lines */
+static size_t drain_all(void)
+{
+    size_t lines = 0;
+    for (int i = 0; i < LOG_MAX_THREADS; i++)
+    {
+        struct log_ring_t *ring = __atomic_load_n(&g_rings[i], __ATOMIC_ACQUIRE);
+        if (!ring)
+            continue;
+        bool dead = __atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE);
+        lines += ring_drain(ring);
+        if (dead)
+        {
+            pthread_mutex_lock(&g_rings_lock);
+            __atomic_store_n(&g_rings[i], NULL, __ATOMIC_RELEASE);
+            pthread_mutex_unlock(&g_rings_lock);
+            free(ring);
+        }
+    }
+    return lines;
+}
+
+/**
+ * Count a finished pass and wake log_flush() callers and producers waiting
+ * for room in their ring. As with the packet
+ * ring's sleepers: a waiter counts itself in, then reads the pass count;
+ * the writer bumps the count, then reads the waiters. The full fences make
+ * at least one side see the other, and the lock is only taken when someone
+ * waits.
+ */
+static void pass_completed(void)
+{
+    __atomic_fetch_add(&g_drain_passes, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_pass_waiters, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&g_wake_lock);
+        pthread_cond_broadcast(&g_wake);
+        pthread_mutex_unlock(&g_wake_lock);
+    }
+}
+
+/** Writer thread: drain the rings, sleep when there is nothing to write */
+static void *writer_main(void *arg)
+{
+    (void)arg;
+    for (;;)
+    {
+        bool stop = __atomic_load_n(&g_writer_stop, __ATOMIC_ACQUIRE);
+        size_t lines = drain_all();
+        pass_completed();
+        if (lines > 0)
+            continue;
+        if (stop)
+            break;
+
+        pthread_mutex_lock(&g_wake_lock);
+        __atomic_store_n(&g_writer_idle, 1, __ATOMIC_RELAXED);
+        if (!__atomic_load_n(&g_writer_stop, __ATOMIC_ACQUIRE))
+        {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += LOG_WRITER_IDLE_NS;
+            if (until.tv_nsec >= 1000000000L)
+            {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&g_wake, &g_wake_lock, &until);
+        }
+        __atomic_store_n(&g_writer_idle, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_wake_lock);
+    }
+
+    // Everything is written: nobody is left to count passes for log_flush()
+    pthread_mutex_lock(&g_wake_lock);
+    __atomic_store_n(&g_writer_done, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&g_wake);
+    pthread_mutex_unlock(&g_wake_lock);
+    return NULL;
+}
+
+/** Start the writer with every signal blocked; called with g_lock held */
+static void writer_start(void)
+{
+    if (g_writer_running)
+        return;
+
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    __atomic_store_n(&g_writer_stop, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_writer_done, 0, __ATOMIC_RELEASE);
+    if (pthread_create(&g_writer, NULL, writer_main, NULL) == 0)
+        __atomic_store_n(&g_writer_running, 1, __ATOMIC_RELEASE);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/** Stop the writer once it has written everything; called with g_lock held */
+static void writer_stop(void)
+{
+    if (!g_writer_running)
+        return;
+
+    __atomic_store_n(&g_writer_stop, 1, __ATOMIC_RELEASE);
+    wake_writer();
+    pthread_join(g_writer, NULL);
+    __atomic_store_n(&g_writer_running, 0, __ATOMIC_RELEASE);
+}
+
+static void logger_at_exit(void)
 {
     pthread_mutex_lock(&g_lock);
-    log_level_t lvl = g_level;
+    writer_stop();
     pthread_mutex_unlock(&g_lock);
-    return lvl;
+}
+
+
+log_level_t log_get_level()
+{
+    return (log_level_t)__atomic_load_n(&g_log_level, __ATOMIC_RELAXED);
 }
 
 void log_set_level(log_level_t level)
 {
-    pthread_mutex_lock(&g_lock);
-    g_level = level;
-    pthread_mutex_unlock(&g_lock);
+    __atomic_store_n(&g_log_level, (int)level, __ATOMIC_RELAXED);
+}
+
+void log_set_async(bool async)
+{
+    __atomic_store_n(&g_async, async ? 1 : 0, __ATOMIC_RELAXED);
+    if (!async)
+        log_flush();
+}
+
+void log_set_overflow(log_overflow_t policy)
+{
+    __atomic_store_n(&g_overflow, (int)policy, __ATOMIC_RELAXED);
+}
+
+/** Wait for the writer to complete passes; false if it stopped first */
+static bool wait_passes(uint64_t passes)
+{
+    __atomic_fetch_add(&g_pass_waiters, 1, __ATOMIC_SEQ_CST);
+    uint64_t target = __atomic_load_n(&g_drain_passes, __ATOMIC_SEQ_CST) + passes;
+
+    pthread_mutex_lock(&g_wake_lock);
+    while (__atomic_load_n(&g_drain_passes, __ATOMIC_SEQ_CST) < target &&
+           __atomic_load_n(&g_writer_running, __ATOMIC_ACQUIRE) &&
+           !__atomic_load_n(&g_writer_done, __ATOMIC_ACQUIRE))
+    {
+        if (__atomic_load_n(&g_writer_idle, __ATOMIC_RELAXED))
+            pthread_cond_broadcast(&g_wake); /* Hurry the writer */
+        pthread_cond_wait(&g_wake, &g_wake_lock);
+    }
+    bool reached = __atomic_load_n(&g_drain_passes, __ATOMIC_SEQ_CST) >= target;
+    pthread_mutex_unlock(&g_wake_lock);
+    __atomic_fetch_sub(&g_pass_waiters, 1, __ATOMIC_SEQ_CST);
+    return reached;
+}
+
+void log_flush(void)
+{
+    // The rings belong to the writer, which frees them and hands their slots
+    // to new threads: wait for its passes instead of looking at them. A pass
+    // under way at the call may have gone by a ring before the line landed
+    // in it, the one after it cannot have.
+    wait_passes(2);
 }
 
 int init_logger(const char *prefix, log_level_t level, bool to_file, const char *path)
 {
+    pthread_once(&g_once, logger_once);
     pthread_mutex_lock(&g_lock);
+    /* Lines queued for the previous target go there first */
+    writer_stop();
+
     /* Close previous file if re-initializing to a different target */
     if(g_use_file && g_fd >= 0)
     {
@@ -99,7 +537,9 @@ int init_logger(const char *prefix, log_level_t level, bool to_file, const char
 
     g_inited = 0;
     g_use_file = 0;
-    g_level = level;
+    __atomic_store_n(&g_log_level, (int)level, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&g_prefix_gen, 1, __ATOMIC_RELAXED);
 
     /* Copy prefix safely */
     g_prefix[0] = '\0';
@@ -141,70 +581,65 @@ int init_logger(const char *prefix, log_level_t level, bool to_file, const char
         g_fd = -1;
     }
 
-    g_inited = 1;
+    writer_start();
+    __atomic_store_n(&g_inited, 1, __ATOMIC_RELEASE);
     pthread_mutex_unlock(&g_lock);
     return 0;
 }
 
 void log_msg(log_level_t level, const char *format, ...)
 {
-    pthread_mutex_lock(&g_lock);
-
-    if (!g_inited)
-        (void)init_logger("[UNINITIALIZED]", LOG_INFO, false, NULL);
-
-    if (level < g_level)
-    {
-        pthread_mutex_unlock(&g_lock);
+    if (!log_enabled(level))
         return;
-    }
-
-    static const char *LEVEL_STR[] = { "DEBUG", "INFO", "WARN", "ERROR" };
-
-    char line[1024];
-    char ts[32];
-    build_timestamp(ts, sizeof(ts));
-
-    int len = snprintf(line, sizeof(line),
-                       "%s %s [%s] ",
-                       ts,
-                       (g_prefix[0] ? g_prefix : ""),
-                       LEVEL_STR[level]);
+    if (!__atomic_load_n(&g_inited, __ATOMIC_ACQUIRE))
+        (void)init_logger("[UNINITIALIZED]", log_get_level(), false, NULL);
 
+    char line[LOG_LINE_MAX];
     va_list ap;
     va_start(ap, format);
-    vsnprintf(line + len, sizeof(line) - len, format, ap);
+    size_t len = format_line(line, level, format, ap);
     va_end(ap);
 
-    strncat(line, "\n", sizeof(line) - strlen(line) - 1);
-
-    int fd = pick_fd_for_level(level);
-    if (fd >= 0) write(fd, line, strlen(line));
-
-    // If writing to file, also mirror to console (stdout/stderr)
-    if (g_use_file && g_fd >= 0) {
-        if (level == LOG_ERROR || level == LOG_WARN) {
-             write(2, line, strlen(line));
-        } else {
-             write(1, line, strlen(line));
+    // Fast path: the calling thread's own ring, drained by the writer
+    if (__atomic_load_n(&g_async, __ATOMIC_RELAXED) && __atomic_load_n(&g_writer_running, __ATOMIC_ACQUIRE))
+    {
+        struct log_ring_t *ring = t_ring;
+        if (!ring && !t_ring_failed)
+            ring = ring_register();
+        // A full ring is emptied by the writer's next pass; until then the
+        // line waits, unless it is DEBUG/INFO and the policy drops those
+        while (ring)
+        {
+            if (ring_push(ring, level, line, len))
+                return;
+            if (level < LOG_WARN && __atomic_load_n(&g_overflow, __ATOMIC_RELAXED) == LOG_OVERFLOW_DROP_VERBOSE)
+            {
+                __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+                return;
+            }
+            if (!wait_passes(1))
+                break; /* Writer stopped: its last pass emptied the ring, write directly */
         }
     }
 
+    pthread_mutex_lock(&g_lock);
+    write_line_sync(level, line, len);
     pthread_mutex_unlock(&g_lock);
 }
 
 
-/* Close and reset logger state */
+/* Flush, then close and reset logger state */
 void close_logger()
 {
     pthread_mutex_lock(&g_lock);
+    writer_stop();
     if(g_use_file && g_fd >= 0)
     {
         close(g_fd);
     }
 
     g_fd = -1;
-    g_inited = 0;
+    __atomic_store_n(&g_inited, 0, __ATOMIC_RELEASE);
     g_use_file = 0;
     pthread_mutex_unlock(&g_lock);
-}
\ No newline at end of file
+}
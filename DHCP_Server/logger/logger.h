@@ -4,9 +4,11 @@
  * Features
  * - Levels: DEBUG, INFO, WARN, ERROR
  * - Output to stdout/stderr or to file (append mode)
- * - Timestamp in UTC (YYYY-MM-DD HH:MM:SS)
+ * - Timestamp in local time (YYYY-MM-DD HH:MM:SS)
  * - Optional static prefix (e.g., "[DHCPv6]")
- * - Thread-safe (POSIX mutex)
+ * - Thread-safe, and asynchronous: the calling thread only formats the line
+ *   into a ring buffer of its own; a background writer thread drains every
+ *   ring and writes the lines in batches with writev()
  *
  * Usage
  *   init_logger("[DHCPv6]", LOG_INFO, true, "/var/log/dhcpv6.log");
@@ -32,7 +34,7 @@ typedef enum
 
 /**
  * init_logger
- * Initializes the global logger instance.
+ * Initializes the global logger instance and starts its writer thread.
  *
  * @param prefix   Optional short tag printed before level (e.g., "[DHCPv6]").
  *                 Pass NULL or "" to omit.
@@ -42,7 +44,8 @@ typedef enum
  * @return 0 on success, -1 on error (e.g., cannot open file).
  *
  * Thread-safety: safe to call concurrently, the function locks internally.
- * Re-initializing closes any previously opened file descriptor.
+ * Re-initializing flushes pending lines and closes any previously opened file descriptor.
+ * The writer thread blocks every signal, so signals keep reaching the application's threads.
  */
 int init_logger(const char *prefix, log_level_t level, bool to_file, const char *path);
 
@@ -56,9 +59,19 @@ int init_logger(const char *prefix, log_level_t level, bool to_file, const char
  *
  * Notes:
  * - Full printf formatting is supported (via vsnprintf).
- * - Thread-safe.
+ * - Thread-safe and lock-free: the line goes to the calling thread's ring.
+ *   When the ring is full the caller waits for the writer to make room, so
+ *   no line is lost; see log_set_overflow() to drop DEBUG/INFO lines instead.
  */
-void log_msg(log_level_t level, const char *format, ...);
+void log_msg(log_level_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+/** What log_msg() does with a line when its thread's ring is full */
+typedef enum
+{
+    LOG_OVERFLOW_WAIT = 0,        /* Wait for the writer to make room (default) */
+    LOG_OVERFLOW_DROP_VERBOSE = 1 /* Drop DEBUG/INFO lines (counted, the writer reports
+                                     the count); WARN/ERROR still wait */
+} log_overflow_t;
 
 /**
  * log_set_level / log_get_level
@@ -66,20 +79,57 @@ void log_msg(log_level_t level, const char *format, ...);
  */
 void log_set_level(log_level_t level);
 
+/**
+ * log_set_async
+ * Choose between the background writer (default) and writing every line
+ * synchronously from the calling thread under a global lock.
+ *
+ * @param async  false: each log_msg() returns once its line is written.
+ */
+void log_set_async(bool async);
+
+/**
+ * log_set_overflow
+ * Choose what happens to a line logged while the calling thread's ring is
+ * full (the writer cannot keep up with the output). WARN and ERROR lines
+ * are never dropped.
+ *
+ * @param policy  LOG_OVERFLOW_WAIT (default) or LOG_OVERFLOW_DROP_VERBOSE.
+ */
+void log_set_overflow(log_overflow_t policy);
+
+/**
+ * log_flush
+ * Wait until every line logged before the call has been written.
+ */
+void log_flush(void);
+
 /**
  * close_logger
- * Close resources (file descriptor) and mark logger as uninitialized.
+ * Flush pending lines, stop the writer thread, close resources (file
+ * descriptor) and mark logger as uninitialized.
  *
  * Safe to call multiple times.
  */
 void close_logger();
 log_level_t log_get_level();
 
+/* Minimum level, read without a lock by the macros below */
+extern int g_log_level;
 
-/** Convenience macros for readability and zero varargs overhead at call site */
-#define log_error(...) log_msg(LOG_ERROR, __VA_ARGS__)
-#define log_warn(...)  log_msg(LOG_WARN,  __VA_ARGS__)
-#define log_info(...)  log_msg(LOG_INFO,  __VA_ARGS__)
-#define log_debug(...) log_msg(LOG_DEBUG, __VA_ARGS__)
+/** Whether a message of this level would be printed; a single relaxed load */
+static inline bool log_enabled(log_level_t level)
+{
+    return (int)level >= __atomic_load_n(&g_log_level, __ATOMIC_RELAXED);
+}
+
+/**
+ * Convenience macros for readability. Disabled levels cost one comparison:
+ * the arguments are not even evaluated.
+ */
+#define log_error(...) (log_enabled(LOG_ERROR) ? log_msg(LOG_ERROR, __VA_ARGS__) : (void)0)
+#define log_warn(...)  (log_enabled(LOG_WARN)  ? log_msg(LOG_WARN,  __VA_ARGS__) : (void)0)
+#define log_info(...)  (log_enabled(LOG_INFO)  ? log_msg(LOG_INFO,  __VA_ARGS__) : (void)0)
+#define log_debug(...) (log_enabled(LOG_DEBUG) ? log_msg(LOG_DEBUG, __VA_ARGS__) : (void)0)
 
 #endif // LOGGER_H
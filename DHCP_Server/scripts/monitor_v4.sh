@@ -0,0 +1,3 @@
+#!/bin/bash
+cd "$(dirname "$0")/.."
+./build/bin/dhcpv4_monitor
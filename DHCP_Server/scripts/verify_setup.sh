@@ -79,6 +79,7 @@ BINARIES=(
     "build/bin/dhcpv4_client"
     "build/bin/dhcpv6_server"
     "build/bin/dhcpv6_client"
+    "build/bin/dhcpv4_monitor"
     "build/bin/dhcpv6_monitor"
 )
 
@@ -0,0 +1,132 @@
+/*
+ * Option lookup micro-benchmark.
+ *
+ * For each sample client packet, does the lookups the server makes while
+ * answering it (message type, requested address, server identifier,
+ * parameter request list) plus the client identifier and host name that
+ * host reservations and logging look at, two ways: one linear walk over the
+ * options per lookup, as dhcp_message_get_option() did before, and one
+ * dhcp_options_parse() followed by table reads.
+ *
+ * Build: make bench_dhcp_options
+ * Run:   ./build/bin/bench_dhcp_options
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/dhcp_options.h"
+#include "dhcp_sample_packets.h"
+
+#define ROUNDS 2000000
+
+static const uint8_t lookups[] = {DHCP_OPT_MESSAGE_TYPE, DHCP_OPT_REQUESTED_IP, DHCP_OPT_SERVER_ID,
+                                  DHCP_OPT_PARAM_REQUEST_LIST, DHCP_OPT_CLIENT_ID, DHCP_OPT_HOST_NAME};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// dhcp_message_get_option() before the option index: one walk per lookup
+static const uint8_t *scan_option(const struct dhcp_packet *packet, uint8_t option_code, uint8_t *out_len)
+{
+    int offset = 4;
+
+    uint32_t cookie;
+    memcpy(&cookie, packet->options, 4);
+    if (ntohl(cookie) != DHCP_MAGIC_COOKIE)
+        return NULL;
+
+    while (offset < 312)
+    {
+        uint8_t code = packet->options[offset];
+        if (code == DHCP_OPT_END)
+            break;
+        if (code == DHCP_OPT_PAD)
+        {
+            offset++;
+            continue;
+        }
+
+        uint8_t len = packet->options[offset + 1];
+        if (code == option_code)
+        {
+            if (out_len)
+                *out_len = len;
+            return &packet->options[offset + 2];
+        }
+        offset += 2 + len;
+    }
+    return NULL;
+}
+
+static uint32_t lookup_scan(const struct dhcp_packet *packet)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sizeof(lookups); i++)
+    {
+        uint8_t len = 0;
+        if (scan_option(packet, lookups[i], &len))
+            sum += len;
+    }
+    return sum;
+}
+
+static uint32_t lookup_index(const struct dhcp_packet *packet, ssize_t len)
+{
+    struct dhcp_option_index_t idx;
+    if (dhcp_options_parse(packet, len, &idx) != 0)
+        return 0;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sizeof(lookups); i++)
+    {
+        uint8_t opt_len = 0;
+        if (dhcp_options_get(packet, &idx, lookups[i], &opt_len))
+            sum += opt_len;
+    }
+    return sum;
+}
+
+int main(void)
+{
+    printf("Option lookups: %zu per packet, %d rounds per sample\n\n", sizeof(lookups), ROUNDS);
+    printf("packet              | bytes | scan ns/pkt | index ns/pkt\n");
+    printf("--------------------+-------+-------------+-------------\n");
+
+    for (size_t s = 0; s < DHCP_SAMPLE_COUNT; s++)
+    {
+        const struct dhcp_sample_packet *sample = &dhcp_sample_packets[s];
+        struct dhcp_packet packet;
+        size_t len = dhcp_sample_build(sample, &packet);
+
+        // The scan never looks into file/sname, so it misses overloaded options
+        uint32_t expected = lookup_index(&packet, (ssize_t)len);
+        assert(sample->file || lookup_scan(&packet) == expected);
+
+        volatile uint32_t sink = 0;
+        double t0 = now_ns();
+        for (uint32_t r = 0; r < ROUNDS; r++)
+        {
+            packet.xid = r;
+            sink += lookup_scan(&packet);
+        }
+        double scan_ns = (now_ns() - t0) / ROUNDS;
+
+        t0 = now_ns();
+        for (uint32_t r = 0; r < ROUNDS; r++)
+        {
+            packet.xid = r;
+            sink += lookup_index(&packet, (ssize_t)len);
+        }
+        double index_ns = (now_ns() - t0) / ROUNDS;
+        (void)sink;
+
+        printf("%-19s | %5zu | %11.1f | %12.1f\n", sample->name, len, scan_ns, index_ns);
+    }
+    return 0;
+}
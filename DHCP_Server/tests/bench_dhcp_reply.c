@@ -0,0 +1,232 @@
+/*
+ * OFFER/ACK construction micro-benchmark.
+ *
+ * Builds replies for a subnet that carries the usual options (router, DNS,
+ * domain, broadcast, NTP, NetBIOS, TFTP server and bootfile) three ways:
+ * option by option with dhcp_message_add_option(), which walks the options
+ * area to the END marker on every call, and from the subnet's pre-encoded
+ * template, for a DISCOVER with and without a parameter request list. The
+ * template replies are checked against the option-by-option one first,
+ * and Subnet Mask then Router must lead the subnet options whatever the
+ * request list asks for (RFC 2131 3.3), or whether it asks for them at all.
+ *
+ * Build: make bench_dhcp_reply
+ * Run:   ./build/bin/bench_dhcp_reply
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/dhcp_message.h"
+
+#define REPLIES 2000000
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct in_addr ip(const char *text)
+{
+    struct in_addr addr;
+    assert(inet_pton(AF_INET, text, &addr) == 1);
+    return addr;
+}
+
+static void setup_subnet(struct dhcp_subnet_t *subnet)
+{
+    memset(subnet, 0, sizeof(struct dhcp_subnet_t));
+    subnet->network = ip("192.168.1.0");
+    subnet->netmask = ip("255.255.255.0");
+    subnet->router = ip("192.168.1.1");
+    subnet->broadcast = ip("192.168.1.255");
+    strcpy(subnet->domain_name, "office.example.com");
+    subnet->dns_servers[0] = ip("192.168.1.10");
+    subnet->dns_servers[1] = ip("192.168.1.11");
+    subnet->dns_server_count = 2;
+    subnet->ntp_servers[0] = ip("192.168.1.12");
+    subnet->ntp_server_count = 1;
+    subnet->netbios_servers[0] = ip("192.168.1.13");
+    subnet->netbios_server_count = 1;
+    strcpy(subnet->tftp_server_name, "192.168.1.20");
+    strcpy(subnet->bootfile_name, "pxelinux.0");
+    subnet->default_lease_time = 3600;
+}
+
+// The same reply built the way make_offer did before templates
+static void legacy_offer(struct dhcp_packet *offer, const struct dhcp_packet *discover, const struct dhcp_lease_t *lease,
+                         struct dhcp_subnet_t *subnet)
+{
+    dhcp_message_init(offer, BOOTREPLY, discover->xid, (uint8_t *)discover->chaddr);
+    offer->yiaddr = lease->ip_address;
+    offer->siaddr = subnet->next_server;
+
+    uint32_t lease_time = (uint32_t)(lease->end_time - lease->start_time);
+    uint8_t type = DHCP_OFFER;
+    dhcp_message_add_option(offer, DHCP_OPT_MESSAGE_TYPE, 1, &type);
+    dhcp_message_add_option_ip(offer, DHCP_OPT_SERVER_ID, subnet->router);
+    dhcp_message_add_option32(offer, DHCP_OPT_LEASE_TIME, lease_time);
+    dhcp_message_add_option32(offer, DHCP_OPT_RENEWAL_TIME, lease_time / 2);
+    dhcp_message_add_option32(offer, DHCP_OPT_REBINDING_TIME, lease_time * 7 / 8);
+    dhcp_message_add_option_ip(offer, DHCP_OPT_SUBNET_MASK, subnet->netmask);
+    dhcp_message_add_option_ip(offer, DHCP_OPT_ROUTER, subnet->router);
+    dhcp_message_add_option(offer, DHCP_OPT_DNS_SERVERS, subnet->dns_server_count * 4, subnet->dns_servers);
+    dhcp_message_add_option(offer, DHCP_OPT_DOMAIN_NAME, strlen(subnet->domain_name), subnet->domain_name);
+    dhcp_message_add_option_ip(offer, DHCP_OPT_BROADCAST_ADDR, subnet->broadcast);
+    dhcp_message_add_option(offer, DHCP_OPT_NTP_SERVERS, subnet->ntp_server_count * 4, subnet->ntp_servers);
+    dhcp_message_add_option(offer, DHCP_OPT_NETBIOS_SERVERS, subnet->netbios_server_count * 4, subnet->netbios_servers);
+    dhcp_message_add_option(offer, DHCP_OPT_TFTP_SERVER_NAME, strlen(subnet->tftp_server_name), subnet->tftp_server_name);
+    dhcp_message_add_option(offer, DHCP_OPT_BOOTFILE_NAME, strlen(subnet->bootfile_name), subnet->bootfile_name);
+}
+
+// Every option of expected must be in actual with the same bytes
+static void check_options(const struct dhcp_packet *expected, const struct dhcp_packet *actual, const uint8_t *only,
+                          uint32_t only_len)
+{
+    static const uint8_t codes[] = {DHCP_OPT_MESSAGE_TYPE, DHCP_OPT_SERVER_ID, DHCP_OPT_LEASE_TIME,
+                                    DHCP_OPT_RENEWAL_TIME, DHCP_OPT_REBINDING_TIME, DHCP_OPT_SUBNET_MASK,
+                                    DHCP_OPT_ROUTER, DHCP_OPT_DNS_SERVERS, DHCP_OPT_DOMAIN_NAME,
+                                    DHCP_OPT_BROADCAST_ADDR, DHCP_OPT_NTP_SERVERS, DHCP_OPT_NETBIOS_SERVERS,
+                                    DHCP_OPT_TFTP_SERVER_NAME, DHCP_OPT_BOOTFILE_NAME};
+
+    assert(actual->xid == expected->xid && actual->yiaddr.s_addr == expected->yiaddr.s_addr);
+    assert(memcmp(actual->chaddr, expected->chaddr, 16) == 0);
+    for (uint32_t i = 0; i < sizeof(codes); i++)
+    {
+        uint8_t expected_len = 0, actual_len = 0;
+        uint8_t *e = dhcp_message_get_option(expected, codes[i], &expected_len);
+        uint8_t *a = dhcp_message_get_option(actual, codes[i], &actual_len);
+        // Per-lease slots, then Subnet Mask and Router, are always sent
+        bool wanted = i < 7 || !only || memchr(only, codes[i], only_len) != NULL;
+        assert(e);
+        if (!wanted)
+        {
+            assert(!a);
+            continue;
+        }
+        assert(a && actual_len == expected_len && memcmp(a, e, expected_len) == 0);
+    }
+}
+
+// Index of an option among the reply's options, -1 if absent
+static int option_position(const struct dhcp_packet *packet, uint8_t code)
+{
+    int index = 0;
+    for (uint32_t pos = 4; pos < sizeof(packet->options) && packet->options[pos] != DHCP_OPT_END; index++)
+    {
+        if (packet->options[pos] == DHCP_OPT_PAD)
+        {
+            pos++;
+            continue;
+        }
+        if (packet->options[pos] == code)
+            return index;
+        pos += 2u + packet->options[pos + 1];
+    }
+    return -1;
+}
+
+// A reply to a DISCOVER asking for the options in @p prl
+static void offer_for_prl(struct dhcp_packet *reply, const struct dhcp_packet *discover, uint8_t *prl,
+                          uint8_t prl_len, struct dhcp_lease_t *lease, struct dhcp_subnet_t *subnet)
+{
+    struct dhcp_packet request = *discover;
+    struct dhcp_option_index_t options;
+    dhcp_message_add_option(&request, DHCP_OPT_PARAM_REQUEST_LIST, prl_len, prl);
+    assert(dhcp_options_parse(&request, sizeof(request), &options) == 0);
+    dhcp_message_make_offer(reply, &request, &options, lease, subnet, NULL);
+}
+
+int main(void)
+{
+    struct dhcp_subnet_t *subnet = malloc(sizeof(struct dhcp_subnet_t));
+    assert(subnet);
+    setup_subnet(subnet);
+    assert(dhcp_message_build_template(&subnet->reply_template, subnet) == 0);
+
+    struct dhcp_lease_t lease;
+    memset(&lease, 0, sizeof(lease));
+    lease.ip_address = ip("192.168.1.100");
+    lease.start_time = time(NULL);
+    lease.end_time = lease.start_time + subnet->default_lease_time;
+
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    struct dhcp_packet discover, discover_prl;
+    dhcp_message_init(&discover, BOOTREQUEST, 0x12345678, mac);
+    uint8_t type = DHCP_DISCOVER;
+    dhcp_message_add_option(&discover, DHCP_OPT_MESSAGE_TYPE, 1, &type);
+    discover_prl = discover;
+    // What a typical Linux client asks for
+    uint8_t prl[] = {DHCP_OPT_SUBNET_MASK, DHCP_OPT_BROADCAST_ADDR, DHCP_OPT_ROUTER, DHCP_OPT_DOMAIN_NAME,
+                     DHCP_OPT_DNS_SERVERS, DHCP_OPT_HOST_NAME, DHCP_OPT_NTP_SERVERS};
+    dhcp_message_add_option(&discover_prl, DHCP_OPT_PARAM_REQUEST_LIST, sizeof(prl), prl);
+
+    // Indexed once on receipt, as the workers do
+    struct dhcp_option_index_t discover_options, discover_prl_options;
+    assert(dhcp_options_parse(&discover, sizeof(discover), &discover_options) == 0);
+    assert(dhcp_options_parse(&discover_prl, sizeof(discover_prl), &discover_prl_options) == 0);
+
+    struct dhcp_packet expected, reply;
+    legacy_offer(&expected, &discover, &lease, subnet);
+    dhcp_message_make_offer(&reply, &discover, &discover_options, &lease, subnet, NULL);
+    check_options(&expected, &reply, NULL, 0);
+    dhcp_message_make_offer(&reply, &discover_prl, &discover_prl_options, &lease, subnet, NULL);
+    check_options(&expected, &reply, prl, sizeof(prl));
+
+    // Router listed before Subnet Mask: the mask still goes first
+    uint8_t router_first[] = {DHCP_OPT_ROUTER, DHCP_OPT_DNS_SERVERS, DHCP_OPT_SUBNET_MASK};
+    offer_for_prl(&reply, &discover, router_first, sizeof(router_first), &lease, subnet);
+    check_options(&expected, &reply, router_first, sizeof(router_first));
+    int mask_at = option_position(&reply, DHCP_OPT_SUBNET_MASK);
+    int router_at = option_position(&reply, DHCP_OPT_ROUTER);
+    int dns_at = option_position(&reply, DHCP_OPT_DNS_SERVERS);
+    assert(mask_at >= 0 && mask_at < router_at && router_at < dns_at);
+
+    // Neither listed: both sent anyway, as without a request list
+    uint8_t dns_only[] = {DHCP_OPT_DNS_SERVERS};
+    offer_for_prl(&reply, &discover, dns_only, sizeof(dns_only), &lease, subnet);
+    check_options(&expected, &reply, dns_only, sizeof(dns_only));
+    assert(option_position(&reply, DHCP_OPT_SUBNET_MASK) < option_position(&reply, DHCP_OPT_ROUTER));
+
+    printf("OFFER construction: %d replies, %u option bytes in the full reply\n\n", REPLIES,
+           subnet->reply_template.options_len);
+    printf("method                      |  ns/reply\n");
+    printf("----------------------------+----------\n");
+
+    volatile uint8_t sink = 0;
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < REPLIES; i++)
+    {
+        discover.xid = i;
+        legacy_offer(&reply, &discover, &lease, subnet);
+        sink ^= reply.options[6];
+    }
+    printf("%-27s | %9.1f\n", "add_option per option", (now_ns() - t0) / REPLIES);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < REPLIES; i++)
+    {
+        discover.xid = i;
+        dhcp_message_make_offer(&reply, &discover, &discover_options, &lease, subnet, NULL);
+        sink ^= reply.options[6];
+    }
+    printf("%-27s | %9.1f\n", "template", (now_ns() - t0) / REPLIES);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < REPLIES; i++)
+    {
+        discover_prl.xid = i;
+        dhcp_message_make_offer(&reply, &discover_prl, &discover_prl_options, &lease, subnet, NULL);
+        sink ^= reply.options[6];
+    }
+    printf("%-27s | %9.1f\n", "template + request list", (now_ns() - t0) / REPLIES);
+    (void)sink;
+
+    free(subnet);
+    return 0;
+}
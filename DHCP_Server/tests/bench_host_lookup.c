@@ -0,0 +1,177 @@
+/*
+ * Host reservation lookup micro-benchmark.
+ *
+ * Fills the host table of a one-subnet configuration with N reservations
+ * (10, 1k, 100k) and measures find_host_by_mac / _by_client_id / _by_address,
+ * a MAC without a reservation (what most DISCOVERs look up), and a plain
+ * linear scan of the subnet's hosts by MAC (what the lookups did before they
+ * were indexed).
+ *
+ * Build: make bench_host_lookup
+ * Run:   ./build/bin/bench_host_lookup
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/config_v4.h"
+
+#define LOOKUPS 1000000
+#define LINEAR_LOOKUPS 20000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct in_addr ip_for(uint32_t i)
+{
+    struct in_addr ip;
+    ip.s_addr = htonl(0x0A000000u + 10 + i); // 10.0.0.10 + i
+    return ip;
+}
+
+static void mac_for(uint32_t i, uint8_t mac[6])
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(i >> 24);
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static void client_id_for(uint32_t i, uint8_t id[7])
+{
+    id[0] = 0x01; // Hardware type ethernet + MAC, as most clients send
+    mac_for(i, &id[1]);
+}
+
+static void run(uint32_t n)
+{
+    struct dhcp_config_t *config = calloc(1, sizeof(struct dhcp_config_t));
+    assert(config);
+    struct dhcp_subnet_t *subnet = &config->subnets[0];
+    subnet->network.s_addr = htonl(0x0A000000u);
+    subnet->netmask.s_addr = htonl(0xFF000000u);
+    config->subnet_count = 1;
+
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        struct dhcp_host_reservation_t host;
+        memset(&host, 0, sizeof(host));
+        snprintf(host.name, sizeof(host.name), "host-%u", i);
+        mac_for(i, host.mac_address);
+        client_id_for(i, host.client_id);
+        host.client_id_len = 7;
+        host.fixed_address = ip_for(i);
+        assert(host_table_append(&config->host_table, &host) == 0);
+        subnet->host_count++;
+    }
+    assert(host_table_build(&config->host_table, config) == 0);
+    double build_ns = (now_ns() - t0) / n;
+
+    uint32_t *keys = malloc(LOOKUPS * sizeof(uint32_t));
+    assert(keys);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        keys[i] = next_random() % n;
+
+    uint64_t check = 0;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t mac[6];
+        mac_for(keys[i], mac);
+        check += find_host_by_mac(subnet, mac) - subnet->hosts;
+    }
+    double mac_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t cid[7];
+        client_id_for(keys[i], cid);
+        check += find_host_by_client_id(subnet, cid, sizeof(cid)) - subnet->hosts;
+    }
+    double cid_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        check += find_host_by_address(subnet, ip_for(keys[i])) - subnet->hosts;
+    double addr_ns = (now_ns() - t0) / LOOKUPS;
+
+    // Clients without a reservation: MACs past the last host
+    uint32_t misses = 0;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t mac[6];
+        mac_for(n + keys[i], mac);
+        misses += find_host_by_mac(subnet, mac) == NULL;
+    }
+    double miss_ns = (now_ns() - t0) / LOOKUPS;
+    assert(misses == LOOKUPS);
+
+    // Reference: linear scan over the subnet's hosts by MAC
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+    {
+        uint8_t mac[6];
+        mac_for(keys[i], mac);
+        for (uint32_t j = 0; j < subnet->host_count; j++)
+        {
+            if (memcmp(subnet->hosts[j].mac_address, mac, 6) == 0)
+            {
+                check += j;
+                break;
+            }
+        }
+    }
+    double linear_ns = (now_ns() - t0) / LINEAR_LOOKUPS;
+
+    // Every lookup must have hit the expected host
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        expected += 3 * (uint64_t)keys[i];
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+        expected += keys[i];
+    assert(check == expected);
+
+    printf("%8u | %8.1f | %8.1f | %9.1f | %8.1f | %8.1f | %13.1f\n",
+           n, build_ns, mac_ns, cid_ns, addr_ns, miss_ns, linear_ns);
+
+    free(keys);
+    host_table_free(&config->host_table);
+    free(config);
+}
+
+int main(void)
+{
+    printf("Host reservation lookup cost (ns per operation, %d random lookups per key)\n\n", LOOKUPS);
+    printf("   hosts |    build |   by mac | by cli-id |  by addr |     miss | linear by mac\n");
+    printf("---------+----------+----------+-----------+----------+----------+--------------\n");
+
+    run(10);
+    run(1000);
+    run(100 * 1000);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * DHCPv6 address pool micro-benchmark.
+ *
+ * Builds pools over a /120, a /112 and a whole /64 and measures
+ * ip6_pool_init, ip6_pool_allocate while handing out addresses to new
+ * clients, when a client asks again (existing allocation by DUID), and for
+ * release + allocate churn. Allocation persists a lease, so its time
+ * includes the append to the lease file. The /120 is filled completely, so
+ * its last clients get their address from the walk after the hashed probes.
+ *
+ * The pool used to be a dense array of MAX_POOL6_SIZE (4096) entries, built
+ * address by address from the start of the range: a /64 was silently cut to
+ * its first 4096 addresses. Reported here: the memory the sparse pool holds
+ * (entries and indexes), which follows the allocations. Every address handed
+ * out must be in range and unique, and releasing all of them must leave the
+ * pool without entries.
+ *
+ * Build: make bench_ip6_pool
+ * Run:   ./build/bin/bench_ip6_pool [directory]   (default /tmp)
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ip6_pool.h"
+#include "logger.h"
+
+#define AGAIN 200000
+#define CHURN 20000
+
+static dhcpv6_config_t config;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void duid_for(uint32_t client, char *out, size_t outsz)
+{
+    snprintf(out, outsz, "00:01:00:01:2a:1b:3c:4d:02:00:%02x:%02x:%02x:%02x", client >> 24, (client >> 16) & 0xFF,
+             (client >> 8) & 0xFF, client & 0xFF);
+}
+
+static int addr_cmp(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(struct in6_addr));
+}
+
+static size_t pool_memory(const struct ip6_pool_t *pool)
+{
+    return (size_t)pool->entry_capacity * sizeof(struct ip6_pool_entry_t) +
+           ((size_t)pool->addr_index.capacity + pool->duid_index.capacity) * sizeof(struct lease_index_slot_t);
+}
+
+static void run(const char *dir, const char *start, const char *end, const char *label, uint32_t clients)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_ip6_pool.%d.leases", dir, getpid());
+    unlink(path);
+
+    dhcpv6_subnet_t *sn = &config.subnets[0];
+    memset(sn, 0, sizeof(*sn));
+    inet_pton(AF_INET6, "2001:db8::", &sn->prefix_bin);
+    sn->prefix_len = 64;
+    inet_pton(AF_INET6, start, &sn->pool_start_bin);
+    inet_pton(AF_INET6, end, &sn->pool_end_bin);
+    sn->has_pool_range = true;
+    config.subnet_count = 1;
+
+    lease_v6_db_t *db = malloc(sizeof(*db));
+    assert(db && lease_v6_db_init(db, path) == 0);
+    struct ip6_pool_t pool;
+    struct in6_addr none = {0};
+
+    double t0 = now_ns();
+    assert(ip6_pool_init(&pool, sn, db) == 0);
+    double init_us = (now_ns() - t0) / 1e3;
+
+    struct in6_addr *given = malloc((size_t)clients * sizeof(*given));
+    assert(given);
+    char duid[64];
+
+    t0 = now_ns();
+    for (uint32_t c = 0; c < clients; c++)
+    {
+        duid_for(c, duid, sizeof(duid));
+        struct ip6_allocation_result_t r = ip6_pool_allocate(&pool, duid, 14, 1, NULL, none, &config, db, 3600);
+        assert(r.success && r.is_new);
+        assert(ip6_pool_is_in_range(&pool, r.ip_address));
+        given[c] = r.ip_address;
+    }
+    double fill_ns = (now_ns() - t0) / clients;
+    assert(pool.allocated_count == clients && pool.entry_count == clients);
+    size_t memory = pool_memory(&pool);
+
+    // No address handed out twice
+    struct in6_addr *sorted = malloc((size_t)clients * sizeof(*sorted));
+    assert(sorted);
+    memcpy(sorted, given, (size_t)clients * sizeof(*sorted));
+    qsort(sorted, clients, sizeof(*sorted), addr_cmp);
+    for (uint32_t c = 1; c < clients; c++)
+        assert(memcmp(&sorted[c - 1], &sorted[c], sizeof(*sorted)) != 0);
+    free(sorted);
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < AGAIN; i++)
+    {
+        uint32_t c = next_random() % clients;
+        duid_for(c, duid, sizeof(duid));
+        struct ip6_allocation_result_t r = ip6_pool_allocate(&pool, duid, 14, 1, NULL, none, &config, db, 3600);
+        assert(r.success && !r.is_new && memcmp(&r.ip_address, &given[c], sizeof(given[c])) == 0);
+    }
+    double again_ns = (now_ns() - t0) / AGAIN;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < CHURN; i++)
+    {
+        uint32_t c = next_random() % clients;
+        duid_for(c, duid, sizeof(duid));
+        assert(ip6_pool_release_ip(&pool, given[c], db) == 0);
+        struct ip6_allocation_result_t r = ip6_pool_allocate(&pool, duid, 14, 1, NULL, none, &config, db, 3600);
+        assert(r.success);
+        given[c] = r.ip_address;
+    }
+    double churn_ns = (now_ns() - t0) / CHURN;
+    assert(pool.allocated_count == clients);
+
+    for (uint32_t c = 0; c < clients; c++)
+        assert(ip6_pool_release_ip(&pool, given[c], db) == 0);
+    assert(pool.allocated_count == 0 && pool.entry_count == 0 && pool.available_count == pool.pool_size);
+
+    printf("%-5s | %7u | %7.1f | %8.0f | %8.0f | %8.0f | %9.1f\n", label, clients, init_us, fill_ns, again_ns,
+           churn_ns, memory / 1024.0);
+
+    free(given);
+    ip6_pool_free(&pool);
+    lease_v6_db_free(db);
+    free(db);
+    unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    init_logger("[bench]", LOG_ERROR, false, NULL);
+
+    printf("DHCPv6 address pool (ns per operation, lease append included)\n\n");
+    printf("range | clients | init us | allocate |    again |    churn | memory KiB\n");
+    printf("------+---------+---------+----------+----------+----------+-----------\n");
+
+    run(dir, "2001:db8::100", "2001:db8::1ff", "/120", 256);
+    run(dir, "2001:db8::1:0", "2001:db8::1:ffff", "/112", 50000);
+    run(dir, "2001:db8::", "2001:db8::ffff:ffff:ffff:ffff", "/64", 100000);
+
+    printf("\nall addresses in range and unique, pools empty after release\n");
+    close_logger();
+    return 0;
+}
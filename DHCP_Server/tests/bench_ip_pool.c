@@ -0,0 +1,159 @@
+/*
+ * IP pool allocation micro-benchmark.
+ *
+ * Builds pools for a /24, /20 and /16 range and measures ip_pool_allocate
+ * while filling the pool, when a client asks again (existing allocation by
+ * MAC), and for release + allocate churn on a full pool. The last column is
+ * the linear walk over entries[] that found a free slot before the free
+ * bitmap, timed on the same full-but-one pool.
+ *
+ * Build: make bench_ip_pool
+ * Run:   ./build/bin/bench_ip_pool
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/ip_pool.h"
+
+#define LOOKUPS 1000000
+#define CHURN 200000
+#define LINEAR_SCANS 2000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void mac_for(uint32_t i, uint8_t mac[6])
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(i >> 24);
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static void run(struct dhcp_config_t *config, uint32_t prefix_len)
+{
+    struct dhcp_subnet_t *subnet = &config->subnets[0];
+    uint32_t mask = 0xFFFFFFFFu << (32 - prefix_len);
+    uint32_t network = 0x0A000000u; // 10.0.0.0
+
+    memset(subnet, 0, sizeof(struct dhcp_subnet_t));
+    subnet->network.s_addr = htonl(network);
+    subnet->netmask.s_addr = htonl(mask);
+    subnet->range_start.s_addr = htonl(network + 1);
+    subnet->range_end.s_addr = htonl((network | ~mask) - 1);
+
+    struct ip_pool_t pool;
+    assert(ip_pool_init(&pool, subnet, NULL) == 0);
+
+    uint32_t free_count = pool.available_count;
+    struct in_addr none = {0};
+
+    // Fill the pool, one new client per address
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < free_count; i++)
+    {
+        uint8_t mac[6];
+        mac_for(i, mac);
+        struct ip_allocation_result_t r = ip_pool_allocate(&pool, mac, NULL, 0, none, config);
+        assert(r.success);
+        assert(ntohl(r.ip_address.s_addr) == network + 1 + i); // Lowest free address first
+    }
+    double fill_ns = (now_ns() - t0) / free_count;
+    assert(pool.available_count == 0 && pool.allocated_count == free_count);
+
+    // Known clients asking again
+    uint64_t check = 0;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint32_t client = next_random() % free_count;
+        uint8_t mac[6];
+        mac_for(client, mac);
+        struct ip_allocation_result_t r = ip_pool_allocate(&pool, mac, NULL, 0, none, config);
+        check += ntohl(r.ip_address.s_addr) - (network + 1) - client;
+    }
+    double again_ns = (now_ns() - t0) / LOOKUPS;
+    assert(check == 0);
+
+    // Release one address and hand it to a new client
+    uint32_t next_client = free_count;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < CHURN; i++)
+    {
+        struct in_addr ip;
+        ip.s_addr = htonl(network + 1 + next_random() % free_count);
+        uint8_t holder[6];
+        memcpy(holder, ip_pool_find_entry(&pool, ip)->mac_address, 6);
+        assert(ip_pool_release_ip(&pool, ip, holder) == 0);
+
+        uint8_t mac[6];
+        mac_for(next_client++, mac);
+        struct ip_allocation_result_t r = ip_pool_allocate(&pool, mac, NULL, 0, none, config);
+        assert(r.success && r.ip_address.s_addr == ip.s_addr);
+    }
+    double churn_ns = (now_ns() - t0) / CHURN;
+
+    // Reference: first-free linear walk with a single random hole
+    uint64_t expected = 0;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_SCANS; i++)
+    {
+        uint32_t hole = next_random() % free_count;
+        expected += hole;
+        pool.entries[hole].state = IP_STATE_AVAILABLE;
+        for (uint32_t j = 0; j < pool.pool_size; j++)
+        {
+            if (pool.entries[j].state == IP_STATE_AVAILABLE)
+            {
+                check += j;
+                break;
+            }
+        }
+        pool.entries[hole].state = IP_STATE_ALLOCATED;
+    }
+    double linear_ns = (now_ns() - t0) / LINEAR_SCANS;
+    assert(check == expected);
+
+    printf("   /%-2u | %8u | %8.1f | %8.1f | %13.1f | %17.1f\n",
+           prefix_len, pool.pool_size, fill_ns, again_ns, churn_ns, linear_ns);
+
+    ip_pool_free(&pool);
+}
+
+int main(void)
+{
+    struct dhcp_config_t *config = calloc(1, sizeof(struct dhcp_config_t));
+    assert(config);
+
+    printf("IP pool allocation cost (ns per operation)\n\n");
+    printf(" range |  entries |     fill |    again | release+alloc | linear first-free\n");
+    printf("-------+----------+----------+----------+---------------+------------------\n");
+
+    run(config, 24);
+    run(config, 20);
+    run(config, 16);
+
+    free(config);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Lease expiry micro-benchmark.
+ *
+ * Fills a pool and the lease database with one lease per address, lease
+ * times spread over 100 minutes, then advances the clock one minute at a
+ * time: every step expires ~1% of the leases through lease_db_expire_due()
+ * and returns their addresses to the pool from the expiry callback, as the
+ * server's timer does. Half of the leases are renewed once before that so
+ * the heap also has stale entries to skip.
+ *
+ * The last column is what every timer tick cost before the expiry heap: a
+ * walk over the whole database (lease_db_expire_old_leases) followed by one
+ * more over the whole database for the pool sync thread, timed read-only on
+ * the same data.
+ *
+ * Build: make bench_lease_expiry
+ * Run:   ./build/bin/bench_lease_expiry
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/ip_pool.h"
+
+#define STEPS 100        // One-minute steps until every lease has expired
+#define SCAN_ROUNDS 20
+
+static FILE *out; // Results table; stdout carries the timer's progress messages
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void on_expire(void *arg, struct dhcp_lease_t *lease)
+{
+    ip_pool_expire_lease((struct ip_pool_t *)arg, lease);
+}
+
+// Old per-tick cost: expiry scan plus pool sync scan over every lease
+static uint32_t full_scan(struct lease_database_t *db, struct ip_pool_t *pool, time_t now)
+{
+    uint32_t due = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
+    {
+        const struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
+        if (lease->state == LEASE_STATE_ACTIVE && lease->end_time < now)
+            due++;
+    }
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
+    {
+        const struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
+        struct ip_pool_entry_t *entry = ip_pool_find_entry(pool, lease->ip_address);
+        if (entry && entry->state != ip_state_from_lease_state(lease->state))
+            due++;
+    }
+    return due;
+}
+
+static void run(struct dhcp_config_t *config, uint32_t prefix_len)
+{
+    struct dhcp_subnet_t *subnet = &config->subnets[0];
+    uint32_t mask = 0xFFFFFFFFu << (32 - prefix_len);
+    uint32_t network = 0x0A000000u; // 10.0.0.0
+
+    memset(subnet, 0, sizeof(struct dhcp_subnet_t));
+    subnet->network.s_addr = htonl(network);
+    subnet->netmask.s_addr = htonl(mask);
+    subnet->range_start.s_addr = htonl(network + 1);
+    subnet->range_end.s_addr = htonl((network | ~mask) - 1);
+
+    struct ip_pool_t pool;
+    assert(ip_pool_init(&pool, subnet, NULL) == 0);
+
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db && lease_db_init(db, "/dev/null") == 0);
+
+    // One lease per address, ending 1..100 minutes from now
+    uint32_t count = pool.available_count;
+    struct in_addr none = {0};
+    struct in_addr *ips = malloc(count * sizeof(struct in_addr));
+    assert(ips);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t mac[6] = {0x02, 0, (uint8_t)(i >> 24), (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+        struct ip_allocation_result_t r = ip_pool_allocate(&pool, mac, NULL, 0, none, config);
+        assert(r.success);
+        assert(lease_db_add_lease(db, r.ip_address, mac, 60 * (1 + i % STEPS)));
+        ips[i] = r.ip_address;
+    }
+    for (uint32_t i = 0; i < count; i += 2)
+    {
+        assert(lease_db_renew_lease(db, ips[i], 60 * (1 + i % STEPS)) == 0);
+    }
+    free(ips);
+    time_t base = time(NULL);
+
+    double t0 = now_ns();
+    volatile uint32_t sink = 0;
+    for (int r = 0; r < SCAN_ROUNDS; r++)
+        sink += full_scan(db, &pool, base);
+    double scan_ns = (now_ns() - t0) / SCAN_ROUNDS;
+
+    uint32_t expired = 0;
+    t0 = now_ns();
+    for (int step = 1; step <= STEPS + 1; step++)
+        expired += (uint32_t)lease_db_expire_due(db, base + 60 * step + 1, on_expire, &pool);
+    double heap_ns = (now_ns() - t0) / STEPS;
+    (void)sink;
+
+    assert(expired == count);
+    assert(pool.available_count == count && pool.allocated_count == 0);
+
+    fprintf(out, "/%-5u | %8u | %9u | %12.1f | %14.1f | %12.1f\n", prefix_len, count, count / STEPS,
+            heap_ns / 1e3, heap_ns / (count / STEPS), scan_ns / 1e3);
+    fflush(out);
+
+    lease_db_free(db);
+    free(db);
+    ip_pool_free(&pool);
+}
+
+int main(void)
+{
+    // Keep only the table on stdout
+    fflush(stdout);
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!out || !freopen("/dev/null", "w", stdout))
+    {
+        perror("Failed to redirect stdout");
+        return 1;
+    }
+
+    struct dhcp_config_t *config = calloc(1, sizeof(struct dhcp_config_t));
+    assert(config);
+    config->subnet_count = 1;
+
+    fprintf(out, "Lease expiry: %d one-minute steps, ~1%% of the leases due per step\n\n", STEPS);
+    fprintf(out, "pool   |   leases | due/step | heap us/step | heap ns/lease | old scan us/tick\n");
+    fprintf(out, "-------+----------+----------+--------------+----------------+------------------\n");
+
+    run(config, 20);
+    run(config, 16);
+    run(config, 12);
+
+    free(config);
+    return 0;
+}
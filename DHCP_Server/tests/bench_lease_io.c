@@ -0,0 +1,229 @@
+/*
+ * Lease I/O queue benchmark.
+ *
+ * Four producer threads stand in for the packet workers and push lease
+ * updates through lease_io_queue_save_lease() while the I/O thread group-
+ * commits them to the journal. Each producer owns a disjoint set of IPs and
+ * stamps every update with an increasing version (tstp), so once the queue
+ * has drained the journal is replayed into an empty database and every IP
+ * must come back with its last version (block and coalesce policies; drop
+ * may lose the last update by design).
+ *
+ * The ring is kept small so that the backpressure policy actually engages.
+ * Reports enqueue rate, what happened to the updates, and the enqueue ->
+ * durable latency percentiles from the exported histogram.
+ *
+ * Build: make bench_lease_io
+ * Run:   ./build/bin/bench_lease_io [directory]   (default /tmp)
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/lease_v4.h"
+
+#define PRODUCERS 4
+#define IPS 65536                // Leases in the database (keeps the journal below auto-compaction)
+#define UPDATES_PER_PRODUCER 32768
+
+struct producer_t
+{
+    pthread_t thread;
+    uint32_t id;
+    struct lease_io_queue_t *io_queue;
+    uint64_t *last_version; // Indexed by IP offset, written by the owning producer only
+};
+
+static FILE *out; // Results table; stdout carries the queue's progress messages
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct in_addr ip_for(uint32_t i)
+{
+    struct in_addr ip;
+    ip.s_addr = htonl(0x0A000000u + i); // 10.0.0.0 + i
+    return ip;
+}
+
+static void *producer_main(void *arg)
+{
+    struct producer_t *p = (struct producer_t *)arg;
+    struct dhcp_lease_t lease;
+    memset(&lease, 0, sizeof(lease));
+    lease.state = LEASE_STATE_ACTIVE;
+
+    for (uint32_t v = 1; v <= UPDATES_PER_PRODUCER; v++)
+    {
+        // Cycle over a small slice of this producer's IPs so updates to one IP pile up
+        uint32_t offset = p->id + PRODUCERS * (v % 512);
+        lease.ip_address = ip_for(offset);
+        lease.lease_id = offset + 1;
+        lease.tstp = v;
+        lease_io_queue_save_lease(p->io_queue, &lease);
+        p->last_version[offset] = v;
+    }
+    return NULL;
+}
+
+// Percentile from a log2 histogram, reported as the bucket's upper bound
+static uint64_t percentile(const volatile uint64_t *hist, double q)
+{
+    uint64_t total = 0, seen = 0;
+    for (int i = 0; i < SHM_STATS_HIST_BUCKETS; i++)
+        total += hist[i];
+    for (int i = 0; i < SHM_STATS_HIST_BUCKETS; i++)
+    {
+        seen += hist[i];
+        if (total && seen >= q * total)
+            return (uint64_t)1 << i;
+    }
+    return 0;
+}
+
+// Replay a copy of the journal into an empty database and check the last versions
+static void verify(const char *lease_file, const uint64_t *last_version)
+{
+    char copy_file[300], cmd[700];
+    snprintf(copy_file, sizeof(copy_file), "%s.verify", lease_file);
+    snprintf(cmd, sizeof(cmd), "cp %s.journal %s.journal", lease_file, copy_file);
+    assert(system(cmd) == 0);
+
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    struct lease_journal_t journal;
+    assert(db && lease_db_init(db, copy_file) == 0);
+    assert(lease_journal_open(&journal, copy_file) == 0);
+    assert(lease_journal_recover(&journal, db) == 0);
+
+    for (uint32_t i = 0; i < IPS; i++)
+    {
+        if (last_version[i] == 0)
+            continue;
+        struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip_for(i));
+        assert(lease && (uint64_t)lease->tstp == last_version[i]);
+    }
+
+    lease_journal_close(&journal);
+    lease_db_free(db);
+    free(db);
+    snprintf(cmd, sizeof(cmd), "%s.journal", copy_file);
+    unlink(cmd);
+}
+
+static void run(const char *dir, lease_io_backpressure_t policy, uint32_t queue_size)
+{
+    char lease_file[256], path[300];
+    snprintf(lease_file, sizeof(lease_file), "%s/bench_lease_io.%u", dir, getpid());
+
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db && lease_db_init(db, lease_file) == 0);
+    for (uint32_t i = 0; i < IPS; i++)
+    {
+        uint8_t mac[6] = {0x02, 0, 0, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+        assert(lease_db_add_lease(db, ip_for(i), mac, 3600));
+    }
+
+    struct io_queue_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    struct lease_io_config_t config = {.queue_size = queue_size, .backpressure = policy, .stats = &stats};
+    struct lease_io_queue_t *io_queue = malloc(sizeof(struct lease_io_queue_t));
+    assert(io_queue && lease_io_init(io_queue, db, &config) == 0);
+    assert(lease_io_start(io_queue) == 0);
+
+    uint64_t *last_version = calloc(IPS, sizeof(uint64_t));
+    struct producer_t producers[PRODUCERS];
+    assert(last_version);
+
+    // The queue reports drops on stderr as they happen; the counters are checked below instead
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    assert(saved_stderr >= 0 && freopen("/dev/null", "w", stderr));
+
+    double t0 = now_sec();
+    for (uint32_t i = 0; i < PRODUCERS; i++)
+    {
+        producers[i] = (struct producer_t){.id = i, .io_queue = io_queue, .last_version = last_version};
+        assert(pthread_create(&producers[i].thread, NULL, producer_main, &producers[i]) == 0);
+    }
+    for (uint32_t i = 0; i < PRODUCERS; i++)
+        pthread_join(producers[i].thread, NULL);
+    double enqueue_sec = now_sec() - t0;
+
+    // Wait until the I/O thread has made everything durable
+    uint32_t pending = 1;
+    while (pending > 0)
+    {
+        lease_io_get_stats(io_queue, NULL, NULL, &pending);
+        usleep(1000);
+    }
+    double drain_sec = now_sec() - t0;
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    // Block and coalesce never lose an update; drop accounts for every one it loses
+    uint64_t total = (uint64_t)PRODUCERS * UPDATES_PER_PRODUCER;
+    if (policy == LEASE_IO_DROP)
+        assert(stats.dropped > 0 && stats.committed + stats.coalesced + stats.dropped == total);
+    else
+        assert(stats.dropped == 0 && stats.committed + stats.coalesced == total);
+
+    if (policy != LEASE_IO_DROP)
+        verify(lease_file, last_version);
+
+    fprintf(out, "%-8s | %6u | %12.0f | %9.3f | %9lu | %9lu | %7lu | %7lu | %6lu | %6lu\n",
+            lease_io_backpressure_to_string(policy), io_queue->capacity, total / enqueue_sec, drain_sec,
+            stats.committed, stats.coalesced, stats.dropped, stats.blocked, percentile(stats.latency_us_hist, 0.5),
+            percentile(stats.latency_us_hist, 0.99));
+    fflush(out);
+
+    lease_io_stop(io_queue);
+    free(io_queue);
+    lease_db_free(db);
+    free(db);
+    free(last_version);
+
+    snprintf(path, sizeof(path), "%s.journal", lease_file);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s.snapshot", lease_file);
+    unlink(path);
+    unlink(lease_file);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+
+    // The queue reports progress on stdout; keep only the table there
+    fflush(stdout);
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!out || !freopen("/dev/null", "w", stdout))
+    {
+        perror("Failed to redirect stdout");
+        return 1;
+    }
+
+    fprintf(out, "Lease I/O queue: %d producers x %d updates over %d IPs (journal in %s)\n\n", PRODUCERS,
+            UPDATES_PER_PRODUCER, PRODUCERS * 512, dir);
+    fprintf(out, "policy   |   ring |  enqueue/s   |  drain s  | committed | coalesced | dropped | blocked | p50 us "
+                 "| p99 us\n");
+    fprintf(out, "---------+--------+--------------+-----------+-----------+-----------+---------+---------+--------"
+                 "+-------\n");
+
+    run(dir, LEASE_IO_BLOCK, 256);
+    run(dir, LEASE_IO_COALESCE, 256);
+    run(dir, LEASE_IO_DROP, 256);
+    run(dir, LEASE_IO_COALESCE, 4096);
+
+    return 0;
+}
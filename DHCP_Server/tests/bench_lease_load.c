@@ -0,0 +1,228 @@
+/*
+ * Lease file startup load benchmark.
+ *
+ * Writes a lease database of N leases (100k, 1M) to a temporary directory,
+ * once as the ISC-style text file (lease_db_save) and once as a binary
+ * snapshot (lease_journal_compact), then measures how fast each is loaded
+ * back into an empty database: lease_db_load for the text file and
+ * lease_journal_recover for the snapshot. Every lease has a client-id and
+ * one in four a hostname, as on a typical office segment.
+ *
+ * Then the interned string table is checked under hostname churn: every
+ * round renames each host, and lease_db_compact_strings() (run before each
+ * snapshot) must keep the table bounded while every lease still reads back
+ * its current name.
+ *
+ * Build: make bench_lease_load
+ * Run:   ./build/bin/bench_lease_load [directory]   (default /tmp)
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/lease_v4.h"
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct in_addr ip_for(uint32_t i)
+{
+    struct in_addr ip;
+    ip.s_addr = htonl(0x0A000000u + i); // 10.0.0.0 + i
+    return ip;
+}
+
+static void mac_for(uint32_t i, uint8_t mac[6])
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(i >> 24);
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static long file_size(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// Build the source database and write both on-disk forms
+static void write_files(const char *lease_file, uint32_t n)
+{
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db && lease_db_init(db, lease_file) == 0);
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t mac[6], cid[7];
+        mac_for(i, mac);
+        cid[0] = 0x01;
+        memcpy(&cid[1], mac, 6);
+
+        struct dhcp_lease_t *lease = lease_db_add_lease(db, ip_for(i), mac, 3600);
+        assert(lease);
+        assert(lease_db_set_client_id(db, lease, cid, sizeof(cid)) == 0);
+        if (i % 4 == 0)
+        {
+            char hostname[32];
+            snprintf(hostname, sizeof(hostname), "host-%u", i);
+            assert(lease_db_set_hostname(db, lease, hostname) == 0);
+        }
+    }
+    assert(lease_db_save(db) == 0);
+
+    struct lease_journal_t journal;
+    assert(lease_journal_open(&journal, lease_file) == 0);
+    assert(lease_journal_compact(&journal, db) == 0);
+    lease_journal_close(&journal);
+
+    lease_db_free(db);
+    free(db);
+}
+
+// Check the loaded database against what write_files() produced
+static void verify(struct lease_database_t *db, uint32_t n)
+{
+    assert(lease_db_count(db) == n);
+    for (uint32_t i = 0; i < n; i += 997)
+    {
+        struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip_for(i));
+        uint8_t mac[6];
+        mac_for(i, mac);
+        assert(lease && memcmp(lease->mac_address, mac, 6) == 0);
+        assert(lease->lease_id == (uint64_t)i + 1);
+        assert(lease->client_id_len == 7);
+        assert((i % 4 == 0) == (lease->client_hostname != NULL));
+    }
+}
+
+static FILE *out; // Results table; stdout carries the loaders' progress messages
+
+static void run(const char *dir, uint32_t n)
+{
+    char lease_file[256], journal_file[300], snapshot_file[300];
+    snprintf(lease_file, sizeof(lease_file), "%s/bench_lease_load.%u", dir, getpid());
+    snprintf(journal_file, sizeof(journal_file), "%s.journal", lease_file);
+    snprintf(snapshot_file, sizeof(snapshot_file), "%s.snapshot", lease_file);
+
+    write_files(lease_file, n);
+
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db);
+
+    // Text file
+    assert(lease_db_init(db, lease_file) == 0);
+    double t0 = now_sec();
+    assert(lease_db_load(db) == 0);
+    double text_sec = now_sec() - t0;
+    verify(db, n);
+    lease_db_free(db);
+
+    // Binary snapshot (empty journal)
+    struct lease_journal_t journal;
+    assert(lease_db_init(db, lease_file) == 0);
+    assert(lease_journal_open(&journal, lease_file) == 0);
+    t0 = now_sec();
+    assert(lease_journal_recover(&journal, db) == 0);
+    double snap_sec = now_sec() - t0;
+    verify(db, n);
+    lease_journal_close(&journal);
+    lease_db_free(db);
+    free(db);
+
+    fprintf(out, "%8u | %8.1f MB | %12.0f | %8.1f MB | %12.0f\n", n, file_size(lease_file) / 1e6, n / text_sec,
+           file_size(snapshot_file) / 1e6, n / snap_sec);
+    fflush(out);
+
+    unlink(lease_file);
+    unlink(journal_file);
+    unlink(snapshot_file);
+}
+
+// Rename every host for a number of rounds, rebuilding the string table after each
+static void check_string_churn(const char *dir)
+{
+    const uint32_t n = 10000, rounds = 50;
+    char lease_file[256];
+    snprintf(lease_file, sizeof(lease_file), "%s/bench_lease_load.%u.churn", dir, getpid());
+
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db && lease_db_init(db, lease_file) == 0);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t mac[6];
+        mac_for(i, mac);
+        assert(lease_db_add_lease(db, ip_for(i), mac, 3600));
+    }
+
+    uint64_t peak = 0;
+    uint32_t rebuilds = 0;
+    for (uint32_t r = 0; r < rounds; r++)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            char hostname[32];
+            snprintf(hostname, sizeof(hostname), "host-%u-%u", i, r);
+            assert(lease_db_set_hostname(db, lease_db_find_by_ip(db, ip_for(i)), hostname) == 0);
+        }
+        if (db->strings.bytes_stored > peak)
+            peak = db->strings.bytes_stored;
+        int rebuilt = lease_db_compact_strings(db);
+        assert(rebuilt >= 0);
+        rebuilds += rebuilt;
+
+        for (uint32_t i = 0; i < n; i += 97)
+        {
+            char hostname[32];
+            snprintf(hostname, sizeof(hostname), "host-%u-%u", i, r);
+            struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip_for(i));
+            assert(lease && lease->client_hostname && strcmp(lease->client_hostname, hostname) == 0);
+        }
+    }
+
+    // One round of names is ~150 KB: without rebuilds the table would hold all 50
+    uint64_t live = db->strings_live_bytes;
+    assert(rebuilds > 0);
+    assert(peak <= 3 * live + LEASE_STRINGS_BLOCK_SIZE);
+    fprintf(out, "\nHostname churn: %u leases renamed %u times, %u rebuilds, string table peak %.2f MB "
+                 "(live %.2f MB)\n",
+            n, rounds, rebuilds, peak / 1e6, live / 1e6);
+
+    lease_db_free(db);
+    free(db);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+
+    // The loaders report progress on stdout; keep only the table there
+    fflush(stdout);
+    out = fdopen(dup(STDOUT_FILENO), "w");
+    if (!out || !freopen("/dev/null", "w", stdout))
+    {
+        perror("Failed to redirect stdout");
+        return 1;
+    }
+
+    fprintf(out, "Lease file load rate (leases per second, files in %s)\n\n", dir);
+    fprintf(out, "  leases |  text size |  text load/s | snap size  |  snap load/s\n");
+    fprintf(out, "---------+------------+--------------+------------+-------------\n");
+
+    run(dir, 100 * 1000);
+    run(dir, 1000 * 1000);
+    check_string_churn(dir);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Lease lookup micro-benchmark.
+ *
+ * Fills a lease_database_t with N leases (1k, 64k, 1M) and measures the cost
+ * of lease_db_find_by_ip / _by_mac / _by_client_id / _by_id, next to a plain
+ * linear scan of the lease store (what the lookups did before they were indexed).
+ *
+ * Build: make bench_lease_lookup
+ * Run:   ./build/bin/bench_lease_lookup
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/lease_v4.h"
+
+#define LOOKUPS 1000000
+#define LINEAR_LOOKUPS 2000
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct in_addr ip_for(uint32_t i)
+{
+    struct in_addr ip;
+    ip.s_addr = htonl(0x0A000000u + i); // 10.0.0.0 + i
+    return ip;
+}
+
+static void mac_for(uint32_t i, uint8_t mac[6])
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(i >> 24);
+    mac[3] = (uint8_t)(i >> 16);
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+}
+
+static void client_id_for(uint32_t i, uint8_t id[7])
+{
+    id[0] = 0x01; // Hardware type ethernet + MAC, as most clients send
+    mac_for(i, &id[1]);
+}
+
+static void run(uint32_t n)
+{
+    struct lease_database_t *db = malloc(sizeof(struct lease_database_t));
+    assert(db);
+    assert(lease_db_init(db, "/dev/null") == 0);
+
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t mac[6], cid[7];
+        mac_for(i, mac);
+        client_id_for(i, cid);
+
+        struct dhcp_lease_t *lease = lease_db_add_lease(db, ip_for(i), mac, 3600);
+        assert(lease);
+        assert(lease_db_set_client_id(db, lease, cid, sizeof(cid)) == 0);
+    }
+    double insert_ns = (now_ns() - t0) / n;
+
+    uint32_t *keys = malloc(LOOKUPS * sizeof(uint32_t));
+    assert(keys);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        keys[i] = next_random() % n;
+
+    uint64_t check = 0;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip_for(keys[i]));
+        check += lease->lease_id;
+    }
+    double ip_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t mac[6];
+        mac_for(keys[i], mac);
+        struct dhcp_lease_t *lease = lease_db_find_by_mac(db, mac);
+        check += lease->lease_id;
+    }
+    double mac_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t cid[7];
+        client_id_for(keys[i], cid);
+        struct dhcp_lease_t *lease = lease_db_find_by_client_id(db, cid, sizeof(cid));
+        check += lease->lease_id;
+    }
+    double cid_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        // IDs are handed out 1..n in insertion order
+        struct dhcp_lease_t *lease = lease_db_find_by_id(db, (uint64_t)keys[i] + 1);
+        check += lease->lease_id;
+    }
+    double id_ns = (now_ns() - t0) / LOOKUPS;
+
+    // Reference: linear scan over the lease store by IP
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+    {
+        struct in_addr ip = ip_for(keys[i]);
+        const struct dhcp_lease_t *found = NULL;
+        for (uint32_t s = 0; s < LEASE_DB_SHARDS && !found; s++)
+        {
+            for (uint32_t j = 0; j < db->shards[s].lease_count; j++)
+            {
+                if (lease_shard_get(&db->shards[s], j)->ip_address.s_addr == ip.s_addr)
+                {
+                    found = lease_shard_get(&db->shards[s], j);
+                    break;
+                }
+            }
+        }
+        check += found->lease_id;
+    }
+    double linear_ns = (now_ns() - t0) / LINEAR_LOOKUPS;
+
+    // Every indexed lookup must have hit the expected lease
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        expected += 4 * ((uint64_t)keys[i] + 1);
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+        expected += (uint64_t)keys[i] + 1;
+    assert(check == expected);
+
+    printf("%8u | %8.1f | %8.1f | %8.1f | %9.1f | %8.1f | %12.1f\n",
+           n, insert_ns, ip_ns, mac_ns, cid_ns, id_ns, linear_ns);
+
+    free(keys);
+    lease_db_free(db);
+    free(db);
+}
+
+int main(void)
+{
+    printf("Lease lookup cost (ns per operation, %d random lookups per key)\n\n", LOOKUPS);
+    printf("  leases |   insert |    by ip |   by mac | by cli-id |    by id | linear by ip\n");
+    printf("---------+----------+----------+----------+-----------+----------+-------------\n");
+
+    run(1000);
+    run(64 * 1024);
+    run(1024 * 1024);
+
+    return 0;
+}
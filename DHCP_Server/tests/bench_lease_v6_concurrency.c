@@ -0,0 +1,346 @@
+/*
+ * DHCPv6 pool / lease database concurrency benchmark.
+ *
+ * Worker threads run the lease operations of the DHCPv6 packet path: IA_NA
+ * and IA_PD allocation (which also refreshes an existing binding), release
+ * of IA_NA and IA_PD bindings, and the flush of appended records before the
+ * reply. Clients are spread over several subnets. Meanwhile a saver thread
+ * rewrites the lease file in a loop, as the cleanup thread does once a minute.
+ *
+ * Two modes:
+ * - global: every operation and every save under one mutex, as the server
+ *   used to do with ctx.db_lock (the flush included);
+ * - fine:   per-subnet pool locks, lease shards, snapshot-then-write saves.
+ *
+ * Reported: operations per second, and the 99th percentile and worst
+ * latency of one operation (the worst case is what a save costs a worker).
+ *
+ * After each fine-grained run the lease file, as the concurrent saves and
+ * appends left it, is loaded into a fresh database and must match memory
+ * lease by lease; every pool's allocated count must match its active leases.
+ *
+ * Build: make bench_lease_v6_concurrency
+ * Run:   ./build/bin/bench_lease_v6_concurrency [directory]   (default /tmp)
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ip6_pool.h"
+#include "leases6.h"
+#include "logger.h"
+#include "pd_pool.h"
+
+#define SUBNETS 8
+#define CLIENTS_PER_SUBNET 128 // Fits the pools below
+#define OPS_PER_THREAD 20000
+#define LAT_BUCKETS 64 // log2 histogram of latencies in ns
+
+struct binding_t
+{
+    struct in6_addr addr;
+    struct in6_addr prefix;
+    uint8_t plen;
+    bool has_addr;
+    bool has_prefix;
+};
+
+struct worker_t
+{
+    pthread_t thread;
+    uint32_t id;
+    uint64_t rng;
+    uint64_t lat_hist[LAT_BUCKETS];
+    uint64_t lat_max;
+};
+
+static dhcpv6_config_t config;
+static struct ip6_pool_t pools[SUBNETS];
+static pd_pool_t pd_pools[SUBNETS];
+static struct binding_t bindings[SUBNETS][CLIENTS_PER_SUBNET];
+static lease_v6_db_t *db;
+static bool global_mode;
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t threads;
+static volatile int saver_stop;
+static uint64_t saves;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t next_random(struct worker_t *w)
+{
+    // xorshift64*
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return (uint32_t)((w->rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void setup_config(void)
+{
+    memset(&config, 0, sizeof(config));
+    config.subnet_count = SUBNETS;
+    for (int s = 0; s < SUBNETS; s++)
+    {
+        dhcpv6_subnet_t *sn = &config.subnets[s];
+        char buf[INET6_ADDRSTRLEN];
+        snprintf(buf, sizeof(buf), "2001:db8:%x::", s + 1);
+        inet_pton(AF_INET6, buf, &sn->prefix_bin);
+        sn->prefix_len = 64;
+        snprintf(buf, sizeof(buf), "2001:db8:%x::1000", s + 1);
+        inet_pton(AF_INET6, buf, &sn->pool_start_bin);
+        snprintf(buf, sizeof(buf), "2001:db8:%x::10ff", s + 1);
+        inet_pton(AF_INET6, buf, &sn->pool_end_bin);
+        sn->has_pool_range = true;
+        sn->default_lease_time = 3600;
+        sn->max_lease_time = 7200;
+
+        sn->pd_enabled = true;
+        sn->has_pd_pool = true;
+        sn->pd_prefix_len = 60;
+        snprintf(buf, sizeof(buf), "2001:db8:%x:1000::", 0x100 + s);
+        inet_pton(AF_INET6, buf, &sn->pd_pool_start_bin);
+        snprintf(buf, sizeof(buf), "2001:db8:%x:17f0::", 0x100 + s);
+        inet_pton(AF_INET6, buf, &sn->pd_pool_end_bin);
+    }
+}
+
+static void duid_for(uint32_t subnet, uint32_t client, char *out, size_t outsz)
+{
+    snprintf(out, outsz, "00:01:00:01:00:00:%02x:%02x:02:00:00:%02x:%02x:%02x", subnet, (client >> 8) & 0xFF,
+             subnet, (client >> 8) & 0xFF, client & 0xFF);
+}
+
+static void one_op(struct worker_t *w)
+{
+    // Workers own disjoint clients, so a client's bindings need no lock here
+    uint32_t s = next_random(w) % SUBNETS;
+    uint32_t client = (next_random(w) % (CLIENTS_PER_SUBNET / threads)) * threads + w->id;
+    uint32_t kind = next_random(w) % 10;
+    struct binding_t *b = &bindings[s][client];
+    char duid[64];
+    duid_for(s, client, duid, sizeof(duid));
+    struct in6_addr none = {0};
+
+    if (kind < 6)
+    {
+        struct ip6_allocation_result_t r =
+            ip6_pool_allocate(&pools[s], duid, 14, client, NULL, none, &config, db, 3600);
+        if (r.success)
+        {
+            b->addr = r.ip_address;
+            b->has_addr = true;
+        }
+    }
+    else if (kind < 8)
+    {
+        pd_allocation_result_t r = pd_pool_allocate(&pd_pools[s], duid, 14, client, NULL, 0, NULL, db, 3600);
+        if (r.success)
+        {
+            b->prefix = r.prefix;
+            b->plen = r.plen;
+            b->has_prefix = true;
+        }
+    }
+    else if (kind < 9 && b->has_addr)
+    {
+        (void)ip6_pool_release_ip(&pools[s], b->addr, db);
+        b->has_addr = false;
+    }
+    else if (b->has_prefix)
+    {
+        (void)pd_pool_release(&pd_pools[s], &b->prefix, b->plen, db);
+        b->has_prefix = false;
+    }
+    (void)lease_v6_db_sync(db);
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker_t *w = arg;
+    for (uint32_t i = 0; i < OPS_PER_THREAD; i++)
+    {
+        uint64_t t0 = now_ns();
+        if (global_mode)
+            pthread_mutex_lock(&global_lock);
+        one_op(w);
+        if (global_mode)
+            pthread_mutex_unlock(&global_lock);
+        uint64_t ns = now_ns() - t0;
+        w->lat_hist[ns ? 63 - __builtin_clzll(ns) : 0]++;
+        if (ns > w->lat_max)
+            w->lat_max = ns;
+    }
+    return NULL;
+}
+
+static void *saver_main(void *arg)
+{
+    (void)arg;
+    while (!saver_stop)
+    {
+        if (global_mode)
+            pthread_mutex_lock(&global_lock);
+        assert(lease_v6_db_save(db) == 0);
+        if (global_mode)
+            pthread_mutex_unlock(&global_lock);
+        saves++;
+        usleep(20000);
+    }
+    return NULL;
+}
+
+static void count_state(const dhcpv6_lease_t *L, void *arg)
+{
+    uint32_t *active = arg;
+    if (L->type != Lease6_IA_NA || L->state != LEASE_STATE_ACTIVE)
+        return;
+    for (int s = 0; s < SUBNETS; s++)
+        if (ip6_pool_is_in_range(&pools[s], L->ip6_addr))
+            active[s]++;
+}
+
+static lease_v6_db_t *reloaded;
+
+static void compare_with_reloaded(const dhcpv6_lease_t *L, void *arg)
+{
+    uint32_t *checked = arg;
+    dhcpv6_lease_t R;
+    if (L->type == Lease6_IA_NA)
+        assert(lease_v6_find_by_ip(reloaded, &L->ip6_addr, &R) == 0);
+    else
+        assert(lease_v6_find_by_prefix(reloaded, &L->prefix_v6, L->plen, &R) == 0);
+    assert(R.state == L->state && R.iaid == L->iaid && R.ends == L->ends);
+    assert(R.duid_len == L->duid_len && memcmp(R.duid, L->duid, L->duid_len) == 0);
+    (*checked)++;
+}
+
+static void verify(const char *path)
+{
+    // Pools against the leases
+    uint32_t active[SUBNETS] = {0};
+    lease_v6_db_for_each(db, count_state, active);
+    for (int s = 0; s < SUBNETS; s++)
+        assert(pools[s].allocated_count == active[s]);
+
+    // The file as the concurrent saves and appends left it
+    reloaded = malloc(sizeof(*reloaded));
+    assert(reloaded);
+    assert(lease_v6_db_init(reloaded, path) == 0);
+    assert(lease_v6_db_load(reloaded) == 0);
+    assert(reloaded->count == db->count);
+    uint32_t checked = 0;
+    lease_v6_db_for_each(db, compare_with_reloaded, &checked);
+    assert(checked == db->count);
+    lease_v6_db_free(reloaded);
+    free(reloaded);
+}
+
+static void run(const char *dir, bool global, uint32_t nthreads)
+{
+    char path[512], tmp[600];
+    snprintf(path, sizeof(path), "%s/bench_lease_v6.%d.leases", dir, getpid());
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    unlink(path);
+
+    global_mode = global;
+    threads = nthreads;
+    memset(bindings, 0, sizeof(bindings));
+    db = malloc(sizeof(*db));
+    assert(db);
+    assert(lease_v6_db_init(db, path) == 0);
+    for (int s = 0; s < SUBNETS; s++)
+    {
+        assert(ip6_pool_init(&pools[s], &config.subnets[s], db) == 0);
+        assert(pd_pool_init(&pd_pools[s], &config.subnets[s], db, 60) == 0);
+    }
+
+    struct worker_t workers[16];
+    saver_stop = 0;
+    saves = 0;
+    pthread_t saver;
+    uint64_t t0 = now_ns();
+    assert(pthread_create(&saver, NULL, saver_main, NULL) == 0);
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        memset(&workers[t], 0, sizeof(workers[t]));
+        workers[t].id = t;
+        workers[t].rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+        assert(pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) == 0);
+    }
+
+    uint64_t hist[LAT_BUCKETS] = {0}, lat_max = 0;
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t].thread, NULL);
+        for (int b = 0; b < LAT_BUCKETS; b++)
+            hist[b] += workers[t].lat_hist[b];
+        if (workers[t].lat_max > lat_max)
+            lat_max = workers[t].lat_max;
+    }
+    double secs = (now_ns() - t0) / 1e9;
+    saver_stop = 1;
+    pthread_join(saver, NULL);
+
+    uint64_t total = (uint64_t)threads * OPS_PER_THREAD, seen = 0;
+    int p99 = 0;
+    for (; p99 < LAT_BUCKETS; p99++)
+    {
+        seen += hist[p99];
+        if (seen * 100 >= total * 99)
+            break;
+    }
+
+    // Upper bound of the percentile's bucket, no more than the worst case
+    uint64_t p99_ns = 2ull << p99;
+    if (p99_ns > lat_max)
+        p99_ns = lat_max;
+
+    if (!global)
+        verify(path);
+
+    printf("%-6s | %7u | %9.0f | %9.1f | %9.1f | %5lu | %6u\n", global ? "global" : "fine", threads, total / secs,
+           p99_ns / 1000.0, lat_max / 1000.0, saves, db->count);
+
+    for (int s = 0; s < SUBNETS; s++)
+    {
+        ip6_pool_free(&pools[s]);
+        pd_pool_free(&pd_pools[s]);
+    }
+    lease_v6_db_free(db);
+    free(db);
+    unlink(path);
+    unlink(tmp);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    init_logger("[bench]", LOG_ERROR, false, NULL);
+    setup_config();
+
+    printf("DHCPv6 lease operations, %d subnets, %d ops per thread, lease file saved every 20 ms\n\n", SUBNETS,
+           OPS_PER_THREAD);
+    printf("mode   | threads | ops/s     | p99 (us)  | max (us)  | saves | leases\n");
+    printf("-------+---------+-----------+-----------+-----------+-------+-------\n");
+
+    uint32_t thread_counts[] = {1, 4, 8};
+    for (int t = 0; t < 3; t++)
+    {
+        run(dir, true, thread_counts[t]);
+        run(dir, false, thread_counts[t]);
+    }
+    printf("\nfine-grained runs verified: pools match leases, lease file matches memory\n");
+    close_logger();
+    return 0;
+}
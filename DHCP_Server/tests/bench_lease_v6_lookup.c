@@ -0,0 +1,287 @@
+/*
+ * DHCPv6 lease lookup micro-benchmark.
+ *
+ * Fills a lease database with N IA_NA leases and N/4 IA_PD leases (N = 1k,
+ * 4k, 100k: the last is far past the LEASES6_MAX the database used to be
+ * capped at) and measures lease_v6_find_by_ip / _by_prefix / _by_duid_iaid,
+ * an address without a lease (what most SOLICITs look up) and a renewal.
+ * Two linear scans are the reference, over copies of the leases: by address
+ * over one shard's share (what find_by_ip and every add did before the
+ * indexes) and by DUID+IAID over all of them (what find_by_duid_iaid did).
+ *
+ * Then every other address and prefix is released, and
+ * after lease_v6_cleanup() every lease left must be found by each key and
+ * every lease removed by none.
+ *
+ * Build: make bench_lease_v6_lookup
+ * Run:   ./build/bin/bench_lease_v6_lookup [directory]   (default /tmp)
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "leases6.h"
+#include "logger.h"
+
+#define LOOKUPS 1000000
+#define LINEAR_LOOKUPS 2000
+#define DUID_LEN 14 // DUID-LLT
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(void)
+{
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// 2001:db8::1:0 + i, as a pool hands them out
+static struct in6_addr addr_for(uint32_t i)
+{
+    struct in6_addr a;
+    inet_pton(AF_INET6, "2001:db8::1:0", &a);
+    uint32_t low;
+    memcpy(&low, &a.s6_addr[12], sizeof(low));
+    low = htonl(ntohl(low) + i);
+    memcpy(&a.s6_addr[12], &low, sizeof(low));
+    return a;
+}
+
+// 2001:db8:1000::/56 + i
+static struct in6_addr prefix_for(uint32_t i)
+{
+    struct in6_addr p;
+    inet_pton(AF_INET6, "2001:db8:1000::", &p);
+    p.s6_addr[5] = (uint8_t)(i >> 8);
+    p.s6_addr[6] = (uint8_t)i;
+    return p;
+}
+
+// DUID-LLT of client i; the same client asks for its address and its prefix
+static void duid_for(uint32_t i, uint8_t duid[DUID_LEN])
+{
+    static const uint8_t head[8] = {0x00, 0x01, 0x00, 0x01, 0x2a, 0x1b, 0x3c, 0x4d};
+    memcpy(duid, head, sizeof(head));
+    duid[8] = 0x02;
+    duid[9] = 0x00;
+    duid[10] = (uint8_t)(i >> 24);
+    duid[11] = (uint8_t)(i >> 16);
+    duid[12] = (uint8_t)(i >> 8);
+    duid[13] = (uint8_t)i;
+}
+
+static void duid_hex_for(uint32_t i, char *out, size_t out_size)
+{
+    uint8_t duid[DUID_LEN];
+    duid_for(i, duid);
+    for (int k = 0; k < DUID_LEN; k++)
+        snprintf(out + 3 * k, out_size - 3 * k, "%02x%s", duid[k], k + 1 < DUID_LEN ? ":" : "");
+}
+
+struct copy_t
+{
+    dhcpv6_lease_t *leases;
+    uint32_t count;
+};
+
+static void copy_lease(const dhcpv6_lease_t *lease, void *arg)
+{
+    struct copy_t *copy = arg;
+    copy->leases[copy->count++] = *lease;
+}
+
+static void run(const char *dir, uint32_t n)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_lease_v6_lookup.%d.leases", dir, getpid());
+    unlink(path);
+
+    lease_v6_db_t *db = malloc(sizeof(*db));
+    assert(db && lease_v6_db_init(db, path) == 0);
+    uint32_t pd_n = n / 4;
+
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        char duid_hex[3 * DUID_LEN];
+        duid_hex_for(i, duid_hex, sizeof(duid_hex));
+        struct in6_addr a = addr_for(i);
+        assert(lease_v6_add_ia_na(db, duid_hex, DUID_LEN, 1, &a, 3600, NULL) == 0);
+        if (i < pd_n)
+        {
+            struct in6_addr p = prefix_for(i);
+            assert(lease_v6_add_ia_pd(db, duid_hex, DUID_LEN, 1, &p, 56, 3600, NULL) == 0);
+        }
+    }
+    double add_ns = (now_ns() - t0) / (n + pd_n);
+    assert(db->count == n + pd_n);
+
+    uint32_t *keys = malloc(LOOKUPS * sizeof(uint32_t));
+    assert(keys);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        keys[i] = next_random() % n;
+
+    dhcpv6_lease_t out;
+    uint64_t check = 0;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        struct in6_addr a = addr_for(keys[i]);
+        check += lease_v6_find_by_ip(db, &a, &out) == 0 && out.duid[13] == (uint8_t)keys[i];
+    }
+    double ip_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        struct in6_addr p = prefix_for(keys[i] % pd_n);
+        check += lease_v6_find_by_prefix(db, &p, 56, &out) == 0;
+    }
+    double pfx_ns = (now_ns() - t0) / LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        uint8_t duid[DUID_LEN];
+        duid_for(keys[i], duid);
+        struct in6_addr a = addr_for(keys[i]);
+        check += lease_v6_find_by_duid_iaid(db, duid, DUID_LEN, 1, Lease6_IA_NA, &out) == 0 &&
+                 memcmp(&out.ip6_addr, &a, sizeof(a)) == 0;
+    }
+    double duid_ns = (now_ns() - t0) / LOOKUPS;
+
+    // Addresses past the last lease
+    uint32_t misses = 0;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+    {
+        struct in6_addr a = addr_for(n + keys[i]);
+        misses += lease_v6_find_by_ip(db, &a, &out) != 0;
+    }
+    double miss_ns = (now_ns() - t0) / LOOKUPS;
+    assert(misses == LOOKUPS);
+
+    // Renewals append a record each: file I/O included, as in the server
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+    {
+        struct in6_addr a = addr_for(keys[i]);
+        check += lease_v6_renew_ip(db, &a, 7200) == 0;
+    }
+    double renew_ns = (now_ns() - t0) / LINEAR_LOOKUPS;
+
+    // References: linear scans over copies of the leases
+    struct copy_t copy = {malloc((size_t)db->count * sizeof(dhcpv6_lease_t)), 0};
+    assert(copy.leases);
+    lease_v6_db_for_each(db, copy_lease, &copy);
+    assert(copy.count == n + pd_n);
+
+    uint32_t shard_share = copy.count / LEASE_V6_SHARDS;
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+    {
+        // A shard's worth of leases, the one looked for anywhere among them
+        const dhcpv6_lease_t *want = &copy.leases[keys[i] % shard_share];
+        for (uint32_t j = 0; j < shard_share; j++)
+        {
+            const dhcpv6_lease_t *L = &copy.leases[j];
+            if (L->in_use && L->type == want->type && memcmp(&L->ip6_addr, &want->ip6_addr, sizeof(L->ip6_addr)) == 0)
+            {
+                check++;
+                break;
+            }
+        }
+    }
+    double linear_ip_ns = (now_ns() - t0) / LINEAR_LOOKUPS;
+
+    t0 = now_ns();
+    for (uint32_t i = 0; i < LINEAR_LOOKUPS; i++)
+    {
+        uint8_t duid[DUID_LEN];
+        duid_for(keys[i], duid);
+        for (uint32_t j = 0; j < copy.count; j++)
+        {
+            const dhcpv6_lease_t *L = &copy.leases[j];
+            if (L->in_use && L->type == Lease6_IA_NA && L->iaid == 1 && L->duid_len == DUID_LEN &&
+                memcmp(L->duid, duid, DUID_LEN) == 0)
+            {
+                check++;
+                break;
+            }
+        }
+    }
+    double linear_duid_ns = (now_ns() - t0) / LINEAR_LOOKUPS;
+    free(copy.leases);
+
+    // Every lookup must have hit the expected lease
+    assert(check == 3ull * LOOKUPS + 3ull * LINEAR_LOOKUPS);
+
+    printf("%7u | %7.0f | %7.1f | %7.1f | %8.1f | %7.1f | %7.0f | %9.0f | %11.0f\n", n, add_ns, ip_ns, pfx_ns,
+           duid_ns, miss_ns, renew_ns, linear_ip_ns, linear_duid_ns);
+
+    // Remove every other lease, then check the indexes against the rest
+    for (uint32_t i = 0; i < n; i += 2)
+    {
+        struct in6_addr a = addr_for(i);
+        assert(lease_v6_release_ip(db, &a) == 0);
+    }
+    for (uint32_t i = 0; i < pd_n; i += 2)
+    {
+        struct in6_addr p = prefix_for(i);
+        assert(lease_v6_release_prefix(db, &p, 56) == 0);
+    }
+    assert(lease_v6_cleanup(db) == (int)((n + 1) / 2 + (pd_n + 1) / 2));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        bool kept = i % 2;
+        uint8_t duid[DUID_LEN];
+        duid_for(i, duid);
+        struct in6_addr a = addr_for(i);
+        assert((lease_v6_find_by_ip(db, &a, &out) == 0) == kept);
+        assert((lease_v6_find_by_duid_iaid(db, duid, DUID_LEN, 1, Lease6_IA_NA, &out) == 0) == kept);
+        if (i < pd_n)
+        {
+            struct in6_addr p = prefix_for(i);
+            assert((lease_v6_find_by_prefix(db, &p, 56, &out) == 0) == kept);
+            assert((lease_v6_find_by_duid_iaid(db, duid, DUID_LEN, 1, Lease6_IA_PD, &out) == 0) == kept);
+        }
+    }
+
+    free(keys);
+    lease_v6_db_free(db);
+    free(db);
+    unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    init_logger("[bench]", LOG_ERROR, false, NULL);
+
+    printf("DHCPv6 lease lookup cost (ns per operation, %d random lookups per key)\n\n", LOOKUPS);
+    printf(" leases |     add |   by ip | by pfx  | by duid  |    miss |   renew | scan ip/16 | scan duid\n");
+    printf("--------+---------+---------+---------+----------+---------+---------+------------+----------\n");
+
+    run(dir, 1000);
+    run(dir, LEASES6_MAX);
+    run(dir, 100 * 1000);
+
+    printf("\nindexes verified after release and cleanup\n");
+    close_logger();
+    return 0;
+}
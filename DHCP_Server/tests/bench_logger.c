@@ -0,0 +1,227 @@
+/*
+ * Logger overhead micro-benchmark.
+ *
+ * Every handled packet logs one INFO line ("Processing DHCP ... from ...
+ * (MAC: ...)"), so this measures what that line costs the packet worker:
+ * with the synchronous path (lock, format, write() to the file plus the
+ * console mirror, as every call used to), with the asynchronous path
+ * (format into the thread's ring, the writer thread batches with writev()),
+ * and with the level disabled. Reported per call from the caller's side,
+ * plus the wall time until everything is on disk and the lines that made it.
+ * A full ring makes the caller wait for the writer, so every line must be
+ * written; with the drop policy (LOG_OVERFLOW_DROP_VERBOSE) INFO lines may
+ * be lost instead, but the WARN lines logged among them must all be there.
+ *
+ * Console output is sent to /dev/null while measuring.
+ *
+ * Then log_flush() is checked against ring slots being recycled: short-lived
+ * threads log a line each and exit, their rings are freed by the writer and
+ * the slots handed to the next threads, and after every log_flush() each
+ * line logged so far must be in the file.
+ *
+ * Build: make bench_logger
+ * Run:   ./build/bin/bench_logger [directory]   (default /tmp)
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define LINES_PER_THREAD 200000
+#define PACE_EVERY 64 // Lines between pauses in the paced runs
+#define PACE_NS 20000 // Pause: roughly the rest of the work of 64 packets
+#define WARN_EVERY 1024 // Drop runs: one WARN line among this many INFO lines
+
+struct producer_t
+{
+    pthread_t thread;
+    uint32_t id;
+    bool paced;
+    bool warn;
+    log_level_t level;
+    double ns_per_call;
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void pause_ns(long ns)
+{
+    struct timespec ts = {0, ns};
+    nanosleep(&ts, NULL);
+}
+
+static void *producer_main(void *arg)
+{
+    struct producer_t *p = arg;
+    double spent = 0;
+    for (uint32_t i = 0; i < LINES_PER_THREAD; i += PACE_EVERY)
+    {
+        double t0 = now_ns();
+        for (uint32_t j = i; j < i + PACE_EVERY && j < LINES_PER_THREAD; j++)
+        {
+            if (p->level == LOG_DEBUG)
+                log_debug("Processing DHCP %s from %s (MAC: %02x:%02x:%02x:%02x:%02x:%02x)", "DISCOVER",
+                          "127.0.0.1", 0x02, 0, p->id, (j >> 16) & 0xFF, (j >> 8) & 0xFF, j & 0xFF);
+            else
+                log_info("Processing DHCP %s from %s (MAC: %02x:%02x:%02x:%02x:%02x:%02x)", "DISCOVER",
+                         "127.0.0.1", 0x02, 0, p->id, (j >> 16) & 0xFF, (j >> 8) & 0xFF, j & 0xFF);
+            if (p->warn && j % WARN_EVERY == 0)
+                log_warn("Address check line %u", j);
+        }
+        spent += now_ns() - t0;
+        if (p->paced)
+            pause_ns(PACE_NS);
+    }
+    p->ns_per_call = spent / LINES_PER_THREAD;
+    return NULL;
+}
+
+static uint64_t count_lines(const char *path, const char *needle)
+{
+    FILE *fp = fopen(path, "r");
+    assert(fp);
+    char line[1024];
+    uint64_t n = 0;
+    while (fgets(line, sizeof(line), fp))
+        n += strstr(line, needle) != NULL;
+    fclose(fp);
+    return n;
+}
+
+static void run(const char *dir, const char *mode, bool async, log_overflow_t overflow, log_level_t level,
+                uint32_t threads, bool paced)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_logger.%d.log", dir, getpid());
+    unlink(path);
+
+    // The logger mirrors file output to the console: keep it off the terminal
+    fflush(stdout);
+    int saved_out = dup(1), saved_err = dup(2);
+    int null_fd = open("/dev/null", O_WRONLY);
+    assert(saved_out >= 0 && saved_err >= 0 && null_fd >= 0);
+    dup2(null_fd, 1);
+    dup2(null_fd, 2);
+
+    assert(init_logger("[bench]", LOG_INFO, true, path) == 0);
+    log_set_async(async);
+    log_set_overflow(overflow);
+    bool warn = overflow == LOG_OVERFLOW_DROP_VERBOSE;
+
+    struct producer_t producers[16];
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        producers[i] = (struct producer_t){.id = i, .paced = paced, .warn = warn, .level = level};
+        assert(pthread_create(&producers[i].thread, NULL, producer_main, &producers[i]) == 0);
+    }
+    double per_call = 0;
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        pthread_join(producers[i].thread, NULL);
+        per_call += producers[i].ns_per_call / threads;
+    }
+    log_flush();
+    double wall_ms = (now_ns() - t0) / 1e6;
+    close_logger();
+    log_set_overflow(LOG_OVERFLOW_WAIT);
+
+    dup2(saved_out, 1);
+    dup2(saved_err, 2);
+    close(saved_out);
+    close(saved_err);
+    close(null_fd);
+
+    uint64_t expected = level == LOG_DEBUG ? 0 : (uint64_t)threads * LINES_PER_THREAD;
+    uint64_t written = count_lines(path, "Processing DHCP");
+    if (warn)
+        assert(count_lines(path, "Address check line") ==
+               (uint64_t)threads * ((LINES_PER_THREAD + WARN_EVERY - 1) / WARN_EVERY));
+    else
+        assert(written == expected);
+    printf("%-8s | %-6s | %7u | %11.1f | %9.1f | %9lu / %-9lu\n", mode, paced ? "paced" : "burst", threads, per_call,
+           wall_ms, written, expected);
+    unlink(path);
+}
+
+static void *one_line_main(void *arg)
+{
+    log_info("Flush check line %u", *(uint32_t *)arg);
+    return NULL;
+}
+
+static void check_flush(const char *dir)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_logger.%d.flush.log", dir, getpid());
+    unlink(path);
+
+    fflush(stdout);
+    int saved_out = dup(1), saved_err = dup(2);
+    int null_fd = open("/dev/null", O_WRONLY);
+    assert(saved_out >= 0 && saved_err >= 0 && null_fd >= 0);
+    dup2(null_fd, 1);
+    dup2(null_fd, 2);
+
+    assert(init_logger("[bench]", LOG_INFO, true, path) == 0);
+    log_set_async(true);
+    double t0 = now_ns();
+    const uint32_t rounds = 200;
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+        pthread_t thread;
+        assert(pthread_create(&thread, NULL, one_line_main, &i) == 0);
+        pthread_join(thread, NULL);
+        if (i % 3 == 0)
+            pause_ns(PACE_NS); // Now and then the writer frees the ring before the next thread comes
+        log_flush();
+        assert(count_lines(path, "Flush check line") == i + 1);
+    }
+    double flush_us = (now_ns() - t0) / 1e3 / rounds;
+    close_logger();
+
+    dup2(saved_out, 1);
+    dup2(saved_err, 2);
+    close(saved_out);
+    close(saved_err);
+    close(null_fd);
+    printf("\nlog_flush after a thread's last line: %.0f us per round, %u rounds, every line written\n", flush_us,
+           rounds);
+    unlink(path);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+
+    printf("Logger cost per packet line (%d lines per thread; paced: %d ns pause every %d lines)\n\n",
+           LINES_PER_THREAD, PACE_NS, PACE_EVERY);
+    printf("mode     | load   | threads | ns per call | wall (ms) | lines written\n");
+    printf("---------+--------+---------+-------------+-----------+----------------------\n");
+
+    uint32_t thread_counts[] = {1, 4};
+    for (int t = 0; t < 2; t++)
+    {
+        for (int paced = 1; paced >= 0; paced--)
+        {
+            run(dir, "sync", false, LOG_OVERFLOW_WAIT, LOG_INFO, thread_counts[t], paced);
+            run(dir, "async", true, LOG_OVERFLOW_WAIT, LOG_INFO, thread_counts[t], paced);
+        }
+        run(dir, "drop", true, LOG_OVERFLOW_DROP_VERBOSE, LOG_INFO, thread_counts[t], false);
+        run(dir, "disabled", true, LOG_OVERFLOW_WAIT, LOG_DEBUG, thread_counts[t], false);
+    }
+    printf("\nsync and async wrote every line; drop lost INFO lines only (every WARN line written)\n");
+    check_flush(dir);
+    return 0;
+}
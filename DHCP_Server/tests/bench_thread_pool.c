@@ -0,0 +1,160 @@
+/*
+ * Thread pool micro-benchmark.
+ *
+ * Runs small tasks through the work-stealing pool three ways: one
+ * thread_pool_add() per task from an outside thread (as the receive loop
+ * used to), thread_pool_add_batch() with PACKET_RECV_BATCH-sized batches (as
+ * the receive loop does now), and a task tree where every task submits its
+ * children from inside the pool, which goes through the worker deques and is
+ * spread by stealing. Each run checks that every task ran exactly once and
+ * prints the per-worker counters.
+ *
+ * Build: make bench_thread_pool
+ * Run:   ./build/bin/bench_thread_pool [threads]
+ */
+#include <assert.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/packet_pool.h"
+#include "utils/thread_pool.h"
+
+#define DEFAULT_THREADS 4
+#define TASKS 1000000
+#define QUEUE_SIZE 1024
+#define TREE_DEPTH 18 // 2^19 - 1 tasks
+#define TASK_WORK 200 // Loop iterations per task, roughly a short packet
+
+static atomic_ulong tasks_done;
+static struct thread_pool_t *tree_pool;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void do_work(void)
+{
+    volatile unsigned int x = 0;
+    for (int i = 0; i < TASK_WORK; i++)
+        x += (unsigned int)i;
+}
+
+static void small_task(void *arg)
+{
+    (void)arg;
+    do_work();
+    atomic_fetch_add_explicit(&tasks_done, 1, memory_order_relaxed);
+}
+
+static void tree_task(void *arg)
+{
+    uintptr_t depth = (uintptr_t)arg;
+    if (depth > 0)
+    {
+        // Children go to this worker's deque; idle workers steal them
+        while (thread_pool_add(tree_pool, tree_task, (void *)(depth - 1)) != 0)
+            sched_yield();
+        while (thread_pool_add(tree_pool, tree_task, (void *)(depth - 1)) != 0)
+            sched_yield();
+    }
+    do_work();
+    atomic_fetch_add_explicit(&tasks_done, 1, memory_order_relaxed);
+}
+
+static void wait_for(unsigned long expected)
+{
+    while (atomic_load(&tasks_done) < expected)
+        sched_yield();
+    assert(atomic_load(&tasks_done) == expected);
+}
+
+static void print_stats(struct thread_pool_t *pool, int threads, unsigned long expected)
+{
+    struct thread_pool_stats_t stats[64];
+    int n;
+    unsigned long total;
+    for (;;)
+    {
+        // A worker counts a task just after running it
+        n = thread_pool_get_stats(pool, stats, threads);
+        total = 0;
+        for (int i = 0; i < n; i++)
+            total += stats[i].tasks_run;
+        if (total >= expected)
+            break;
+        sched_yield();
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        printf("  worker %2d: %8llu tasks %8llu steals %6llu parks %8.3f s idle\n", i,
+               (unsigned long long)stats[i].tasks_run, (unsigned long long)stats[i].steals,
+               (unsigned long long)stats[i].parks, stats[i].idle_ns / 1e9);
+    }
+    assert(total == expected);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    assert(threads > 0 && threads <= 64);
+    printf("Thread pool: %d workers, queue %d, %d loop iterations per task\n\n", threads, QUEUE_SIZE, TASK_WORK);
+
+    // 1. One thread_pool_add() per task from the main thread
+    struct thread_pool_t *pool = thread_pool_create(threads, QUEUE_SIZE);
+    assert(pool);
+    atomic_store(&tasks_done, 0);
+    double t0 = now_ns();
+    for (int i = 0; i < TASKS; i++)
+    {
+        while (thread_pool_add(pool, small_task, NULL) != 0)
+            sched_yield(); // Queues full: let the workers catch up
+    }
+    wait_for(TASKS);
+    printf("thread_pool_add:       %8.1f ns/task\n", (now_ns() - t0) / TASKS);
+    assert(thread_pool_destroy(pool, 0) == 0);
+
+    // 2. Batches of PACKET_RECV_BATCH, like the receive loop
+    pool = thread_pool_create(threads, QUEUE_SIZE);
+    assert(pool);
+    void *args[PACKET_RECV_BATCH] = {0};
+    atomic_store(&tasks_done, 0);
+    t0 = now_ns();
+    for (int i = 0; i < TASKS; i += PACKET_RECV_BATCH)
+    {
+        int count = TASKS - i < PACKET_RECV_BATCH ? TASKS - i : PACKET_RECV_BATCH;
+        for (int done = 0; done < count;)
+        {
+            int n = thread_pool_add_batch(pool, small_task, args + done, count - done);
+            assert(n >= 0);
+            done += n;
+            if (done < count)
+                sched_yield();
+        }
+    }
+    wait_for(TASKS);
+    printf("thread_pool_add_batch: %8.1f ns/task (batches of %d)\n", (now_ns() - t0) / TASKS, PACKET_RECV_BATCH);
+    print_stats(pool, threads, TASKS);
+    assert(thread_pool_destroy(pool, 0) == 0);
+
+    // 3. Task tree submitted from inside the pool
+    unsigned long tree_tasks = (2ul << TREE_DEPTH) - 1;
+    tree_pool = thread_pool_create(threads, QUEUE_SIZE);
+    assert(tree_pool);
+    atomic_store(&tasks_done, 0);
+    t0 = now_ns();
+    assert(thread_pool_add(tree_pool, tree_task, (void *)(uintptr_t)TREE_DEPTH) == 0);
+    wait_for(tree_tasks);
+    printf("nested submit (tree):  %8.1f ns/task (%lu tasks)\n", (now_ns() - t0) / tree_tasks, tree_tasks);
+    print_stats(tree_pool, threads, tree_tasks);
+    assert(thread_pool_destroy(tree_pool, 0) == 0);
+
+    return 0;
+}
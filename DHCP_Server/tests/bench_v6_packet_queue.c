@@ -0,0 +1,265 @@
+/*
+ * DHCPv6 receive queue benchmark.
+ *
+ * One producer stands in for the receive loop: it takes batches of 32
+ * datagrams (a typical 120-byte SOLICIT) and hands them to worker threads,
+ * which read the payload and give the buffer back. Compared:
+ * - copy: the former task_queue_t, the datagram copied into the queue under
+ *   its mutex, and the whole task copied out again by the worker;
+ * - ring: buffers from pkt6_pool_t, pointers through the lock-free pkt6_ring_t.
+ *
+ * The producer waits instead of dropping when the queue is full, so both
+ * modes move every packet; each packet carries a sequence number and the
+ * workers' sums must add up. Reported: packets per second and the
+ * producer's time per packet (the receive loop's share of the work).
+ *
+ * Build: make bench_v6_packet_queue
+ * Run:   ./build/bin/bench_v6_packet_queue
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "packet_queue6.h"
+
+#define PACKETS 2000000
+#define PACKET_LEN 120
+#define QUEUE_SIZE 256
+#define MAX_WORKERS 8
+
+// --- The former queue, as server.c had it ---
+
+typedef struct
+{
+    uint8_t buf[PKT6_BUF_SIZE];
+    ssize_t len;
+    struct sockaddr_in6 client_addr;
+} task_t;
+
+typedef struct
+{
+    task_t tasks[QUEUE_SIZE];
+    int head;
+    int tail;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int shutdown;
+} task_queue_t;
+
+static task_queue_t *copy_queue;
+
+static int copy_push(const uint8_t *buf, ssize_t len, const struct sockaddr_in6 *addr)
+{
+    int ok = 0;
+    pthread_mutex_lock(&copy_queue->lock);
+    if (copy_queue->count < QUEUE_SIZE)
+    {
+        task_t *t = &copy_queue->tasks[copy_queue->tail];
+        memcpy(t->buf, buf, len);
+        t->len = len;
+        t->client_addr = *addr;
+        copy_queue->tail = (copy_queue->tail + 1) % QUEUE_SIZE;
+        copy_queue->count++;
+        pthread_cond_signal(&copy_queue->cond);
+        ok = 1;
+    }
+    pthread_mutex_unlock(&copy_queue->lock);
+    return ok;
+}
+
+// --- Shared ---
+
+struct worker_t
+{
+    pthread_t thread;
+    uint64_t packets;
+    uint64_t seq_sum;
+};
+
+static pkt6_pool_t pool;
+static pkt6_ring_t ring;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// What process_packet() would look at first: the header and the length
+static void consume(struct worker_t *w, const uint8_t *buf, ssize_t len)
+{
+    uint64_t seq;
+    memcpy(&seq, buf + 4, sizeof(seq));
+    assert(buf[0] == 1 && len == PACKET_LEN);
+    w->packets++;
+    w->seq_sum += seq;
+}
+
+static void fill(uint8_t *buf, uint64_t seq)
+{
+    buf[0] = 1; // SOLICIT
+    memcpy(buf + 4, &seq, sizeof(seq));
+}
+
+static void *copy_worker(void *arg)
+{
+    struct worker_t *w = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&copy_queue->lock);
+        while (copy_queue->count == 0 && !copy_queue->shutdown)
+            pthread_cond_wait(&copy_queue->cond, &copy_queue->lock);
+        if (copy_queue->count == 0)
+        {
+            pthread_mutex_unlock(&copy_queue->lock);
+            break;
+        }
+        task_t task = copy_queue->tasks[copy_queue->head];
+        copy_queue->head = (copy_queue->head + 1) % QUEUE_SIZE;
+        copy_queue->count--;
+        pthread_mutex_unlock(&copy_queue->lock);
+
+        consume(w, task.buf, task.len);
+    }
+    return NULL;
+}
+
+static void *ring_worker(void *arg)
+{
+    struct worker_t *w = arg;
+    pkt6_t *pkt;
+    while ((pkt = pkt6_ring_pop_wait(&ring)) != NULL)
+    {
+        consume(w, pkt->buf, pkt->len);
+        pkt6_pool_release(&pool, pkt);
+    }
+    return NULL;
+}
+
+// Producer of the copy mode: the socket's datagram lands in a stack buffer first
+static void copy_produce(void)
+{
+    uint8_t buf[PKT6_BUF_SIZE] = {0};
+    struct sockaddr_in6 addr = {.sin6_family = AF_INET6};
+    for (uint64_t seq = 1; seq <= PACKETS; seq++)
+    {
+        fill(buf, seq);
+        while (!copy_push(buf, PACKET_LEN, &addr))
+            sched_yield();
+    }
+}
+
+// Producer of the ring mode: datagrams land in pool buffers, pushed a batch at a time
+static void ring_produce(void)
+{
+    pkt6_t *batch[PKT6_RECV_BATCH];
+    uint64_t seq = 1;
+    while (seq <= PACKETS)
+    {
+        int n = 0;
+        while (n < PKT6_RECV_BATCH && seq <= PACKETS)
+        {
+            pkt6_t *pkt = pkt6_pool_acquire(&pool);
+            if (!pkt)
+                break;
+            fill(pkt->buf, seq++);
+            pkt->len = PACKET_LEN;
+            batch[n++] = pkt;
+        }
+        if (n == 0)
+        {
+            sched_yield(); // Every buffer is queued or with a worker
+            continue;
+        }
+        int done = 0;
+        while ((done += pkt6_ring_push(&ring, batch + done, n - done)) < n)
+            sched_yield();
+    }
+}
+
+static void run(bool zero_copy, uint32_t threads)
+{
+    struct worker_t workers[MAX_WORKERS];
+    memset(workers, 0, sizeof(workers));
+
+    if (zero_copy)
+    {
+        assert(pkt6_pool_init(&pool, QUEUE_SIZE + threads + PKT6_RECV_BATCH) == 0);
+        assert(pkt6_ring_init(&ring, QUEUE_SIZE) == 0);
+    }
+    else
+    {
+        copy_queue = calloc(1, sizeof(*copy_queue));
+        assert(copy_queue);
+        pthread_mutex_init(&copy_queue->lock, NULL);
+        pthread_cond_init(&copy_queue->cond, NULL);
+    }
+
+    double t0 = now_ns();
+    for (uint32_t i = 0; i < threads; i++)
+        assert(pthread_create(&workers[i].thread, NULL, zero_copy ? ring_worker : copy_worker, &workers[i]) == 0);
+
+    if (zero_copy)
+        ring_produce();
+    else
+        copy_produce();
+    double produced = now_ns();
+
+    if (zero_copy)
+        pkt6_ring_shutdown(&ring);
+    else
+    {
+        pthread_mutex_lock(&copy_queue->lock);
+        copy_queue->shutdown = 1;
+        pthread_cond_broadcast(&copy_queue->cond);
+        pthread_mutex_unlock(&copy_queue->lock);
+    }
+
+    uint64_t packets = 0, seq_sum = 0;
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        packets += workers[i].packets;
+        seq_sum += workers[i].seq_sum;
+    }
+    double secs = (now_ns() - t0) / 1e9;
+    assert(packets == PACKETS);
+    assert(seq_sum == (uint64_t)PACKETS * (PACKETS + 1) / 2);
+
+    printf("%-5s | %7u | %12.0f | %13.1f\n", zero_copy ? "ring" : "copy", threads, PACKETS / secs,
+           (produced - t0) / PACKETS);
+
+    if (zero_copy)
+    {
+        pkt6_ring_free(&ring);
+        pkt6_pool_free(&pool);
+    }
+    else
+    {
+        pthread_mutex_destroy(&copy_queue->lock);
+        pthread_cond_destroy(&copy_queue->cond);
+        free(copy_queue);
+    }
+}
+
+int main(void)
+{
+    printf("DHCPv6 receive queue, %d packets of %d bytes\n\n", PACKETS, PACKET_LEN);
+    printf("mode  | workers | packets/s    | producer ns/pkt\n");
+    printf("------+---------+--------------+----------------\n");
+
+    uint32_t thread_counts[] = {1, 4, 8};
+    for (int t = 0; t < 3; t++)
+    {
+        run(false, thread_counts[t]);
+        run(true, thread_counts[t]);
+    }
+    printf("\nevery packet delivered exactly once in every run\n");
+    return 0;
+}
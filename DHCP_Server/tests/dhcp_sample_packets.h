@@ -0,0 +1,140 @@
+/*
+ * Client packets for the option parsing tests and benchmarks.
+ *
+ * Each sample carries the options, in the order, that the named client
+ * sends: the set and order of options is what makes the lookup cost differ
+ * between them.
+ */
+#ifndef DHCP_SAMPLE_PACKETS_H
+#define DHCP_SAMPLE_PACKETS_H
+
+#include <arpa/inet.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "src/dhcp_common.h"
+
+struct dhcp_sample_packet
+{
+    const char *name;
+    const uint8_t *options; // After the magic cookie, END included
+    uint16_t options_len;
+    const uint8_t *file;    // Overloaded file field (NULL if not used)
+    uint16_t file_len;
+    const uint8_t *sname;   // Overloaded sname field (NULL if not used)
+    uint16_t sname_len;
+    uint32_t giaddr;        // Host order, 0 = not relayed
+};
+
+// ISC dhclient DISCOVER
+static const uint8_t sample_dhclient_discover[] = {
+    53, 1, 1,
+    50, 4, 192, 168, 1, 100,
+    12, 7, 'l', 'a', 'p', 't', 'o', 'p', '1',
+    55, 13, 1, 28, 2, 3, 15, 6, 119, 12, 44, 47, 26, 121, 42,
+    255};
+
+// systemd-networkd REQUEST (SELECTING)
+static const uint8_t sample_networkd_request[] = {
+    53, 1, 3,
+    61, 19, 255, 0x8e, 0x3a, 0x1c, 0x55, 0x00, 0x02, 0x00, 0x00, 0xab, 0x11, 0x5f, 0x8d, 0x10, 0x72, 0x4e, 0x2b,
+    0x91, 0x0c,
+    57, 2, 0x05, 0xdc,
+    54, 4, 192, 168, 1, 1,
+    50, 4, 192, 168, 1, 100,
+    12, 6, 'w', 'o', 'r', 'k', 'e', 'r',
+    55, 9, 1, 3, 6, 15, 26, 28, 51, 58, 59,
+    255};
+
+// Windows 10 REQUEST (SELECTING)
+static const uint8_t sample_windows_request[] = {
+    53, 1, 3,
+    61, 7, 1, 0x00, 0x15, 0x5d, 0x01, 0x02, 0x03,
+    50, 4, 192, 168, 1, 100,
+    54, 4, 192, 168, 1, 1,
+    12, 15, 'D', 'E', 'S', 'K', 'T', 'O', 'P', '-', '4', 'K', 'Q', '2', 'M', 'V', '1',
+    81, 18, 0, 0, 0, 'D', 'E', 'S', 'K', 'T', 'O', 'P', '-', '4', 'K', 'Q', '2', 'M', 'V', '1',
+    60, 8, 'M', 'S', 'F', 'T', ' ', '5', '.', '0',
+    55, 14, 1, 3, 6, 15, 31, 33, 43, 44, 46, 47, 119, 121, 249, 252,
+    255};
+
+// DISCOVER relayed by a switch that inserts relay agent information (82)
+static const uint8_t sample_relayed_discover[] = {
+    53, 1, 1,
+    61, 7, 1, 0x00, 0x1b, 0x21, 0x0a, 0x0b, 0x0c,
+    55, 4, 1, 3, 6, 15,
+    82, 18, 1, 6, 0, 4, 0, 10, 0, 7, 2, 8, 0, 6, 0x00, 0x1b, 0x21, 0x00, 0x00, 0x01,
+    255};
+
+// PXE boot ROM DISCOVER
+static const uint8_t sample_pxe_discover[] = {
+    53, 1, 1,
+    57, 2, 0x04, 0xec,
+    93, 2, 0, 7,
+    94, 3, 1, 3, 16,
+    97, 17, 0, 0x4c, 0x4c, 0x45, 0x44, 0x00, 0x10, 0x30, 0x80, 0x43, 0xb5, 0xc4, 0xc0, 0x4f, 0x30, 0x5a, 0x31,
+    55, 36, 1, 2, 3, 4, 5, 6, 11, 12, 13, 15, 16, 17, 18, 22, 23, 28, 40, 41, 42, 43, 50, 51, 54, 58, 59, 60,
+    66, 67, 128, 129, 130, 131, 132, 133, 134, 135,
+    60, 32, 'P', 'X', 'E', 'C', 'l', 'i', 'e', 'n', 't', ':', 'A', 'r', 'c', 'h', ':', '0', '0', '0', '0', '7',
+    ':', 'U', 'N', 'D', 'I', ':', '0', '0', '3', '0', '1', '6',
+    255};
+
+// REQUEST that spilled its options into file and sname (option 52 = 3)
+static const uint8_t sample_overload_request[] = {
+    53, 1, 3,
+    52, 1, 3,
+    54, 4, 192, 168, 1, 1,
+    255};
+static const uint8_t sample_overload_file[] = {
+    50, 4, 192, 168, 1, 100,
+    55, 6, 1, 3, 6, 15, 42, 119,
+    255};
+static const uint8_t sample_overload_sname[] = {
+    12, 8, 'o', 'v', 'e', 'r', 'l', 'o', 'a', 'd',
+    255};
+
+#define SAMPLE(opts) (opts), sizeof(opts)
+
+static const struct dhcp_sample_packet dhcp_sample_packets[] = {
+    {"dhclient DISCOVER", SAMPLE(sample_dhclient_discover), NULL, 0, NULL, 0, 0},
+    {"networkd REQUEST", SAMPLE(sample_networkd_request), NULL, 0, NULL, 0, 0},
+    {"Windows REQUEST", SAMPLE(sample_windows_request), NULL, 0, NULL, 0, 0},
+    {"relayed DISCOVER", SAMPLE(sample_relayed_discover), NULL, 0, NULL, 0, 0x0A000001},
+    {"PXE DISCOVER", SAMPLE(sample_pxe_discover), NULL, 0, NULL, 0, 0},
+    {"overloaded REQUEST", SAMPLE(sample_overload_request), SAMPLE(sample_overload_file),
+     SAMPLE(sample_overload_sname), 0},
+};
+
+#define DHCP_SAMPLE_COUNT (sizeof(dhcp_sample_packets) / sizeof(dhcp_sample_packets[0]))
+
+/**
+ * @brief Lay a sample out as a BOOTREQUEST.
+ * @param sample Sample to use.
+ * @param packet Output packet.
+ * @return Number of bytes a client would send (header, cookie and options).
+ */
+static inline size_t dhcp_sample_build(const struct dhcp_sample_packet *sample, struct dhcp_packet *packet)
+{
+    memset(packet, 0, sizeof(struct dhcp_packet));
+    packet->op = BOOTREQUEST;
+    packet->htype = 1;
+    packet->hlen = 6;
+    packet->xid = htonl(0x3903F326);
+    packet->giaddr.s_addr = htonl(sample->giaddr);
+    if (sample->giaddr)
+        packet->hops = 1;
+    static const uint8_t mac[6] = {0x00, 0x1b, 0x21, 0x0a, 0x0b, 0x0c};
+    memcpy(packet->chaddr, mac, 6);
+    if (sample->file)
+        memcpy(packet->file, sample->file, sample->file_len);
+    if (sample->sname)
+        memcpy(packet->sname, sample->sname, sample->sname_len);
+
+    uint32_t cookie = htonl(DHCP_MAGIC_COOKIE);
+    memcpy(packet->options, &cookie, 4);
+    memcpy(packet->options + 4, sample->options, sample->options_len);
+    return offsetof(struct dhcp_packet, options) + 4 + sample->options_len;
+}
+
+#endif // DHCP_SAMPLE_PACKETS_H
@@ -0,0 +1,225 @@
+/*
+ * Option index robustness test.
+ *
+ * Mutates the sample client packets (random bytes, length bytes, option 52
+ * values, truncation at any length) and runs dhcp_options_parse() on each
+ * result, copied into a heap buffer of exactly the received size so the
+ * address sanitizer stops on any read past it. Every index is checked
+ * against a plain reference scan of the same bytes, and every option it
+ * reports must lie inside the area it was found in.
+ *
+ * Build: make fuzz_dhcp_options
+ * Run:   ./build/bin/fuzz_dhcp_options [iterations] [seed]
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/dhcp_options.h"
+#include "dhcp_sample_packets.h"
+
+#define DEFAULT_ITERATIONS 2000000
+
+#define SNAME_AT offsetof(struct dhcp_packet, sname)
+#define FILE_AT offsetof(struct dhcp_packet, file)
+#define OPTIONS_AT offsetof(struct dhcp_packet, options)
+
+struct reference_t
+{
+    int result;
+    uint16_t offset[256];
+    uint8_t len[256];
+};
+
+static uint64_t rng_state;
+
+static uint32_t rnd(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+// Walk one area byte by byte; 0 at END or the end of the area, -1 on overrun
+static int reference_area(const uint8_t *bytes, size_t from, size_t to, struct reference_t *ref)
+{
+    size_t i = from;
+    while (i < to && bytes[i] != DHCP_OPT_END)
+    {
+        uint8_t code = bytes[i];
+        if (code == DHCP_OPT_PAD)
+        {
+            i += 1;
+            continue;
+        }
+        if (i + 1 == to)
+            return -1;
+        size_t data = i + 2, data_len = bytes[i + 1];
+        if (data + data_len > to)
+            return -1;
+        if (!ref->offset[code])
+        {
+            ref->offset[code] = (uint16_t)data;
+            ref->len[code] = (uint8_t)data_len;
+        }
+        i = data + data_len;
+    }
+    return 0;
+}
+
+static void reference_parse(const uint8_t *bytes, size_t len, struct reference_t *ref)
+{
+    memset(ref, 0, sizeof(*ref));
+    ref->result = -1;
+    if (len < OPTIONS_AT + 4 || bytes[OPTIONS_AT] != 99 || bytes[OPTIONS_AT + 1] != 130 ||
+        bytes[OPTIONS_AT + 2] != 83 || bytes[OPTIONS_AT + 3] != 99)
+        return;
+
+    size_t to = len < sizeof(struct dhcp_packet) ? len : sizeof(struct dhcp_packet);
+    if (reference_area(bytes, OPTIONS_AT + 4, to, ref) != 0)
+        return;
+
+    uint8_t overload = 0;
+    if (ref->offset[DHCP_OPT_OVERLOAD] && ref->len[DHCP_OPT_OVERLOAD] == 1)
+        overload = bytes[ref->offset[DHCP_OPT_OVERLOAD]];
+    if ((overload == 1 || overload == 3) && reference_area(bytes, FILE_AT, FILE_AT + 128, ref) != 0)
+        return;
+    if ((overload == 2 || overload == 3) && reference_area(bytes, SNAME_AT, SNAME_AT + 64, ref) != 0)
+        return;
+    ref->result = 0;
+}
+
+// Parse len bytes of packet from a buffer of exactly that size and compare
+static void check(const struct dhcp_packet *packet, size_t len, uint64_t *parsed)
+{
+    uint8_t *buf = malloc(len ? len : 1);
+    assert(buf);
+    memcpy(buf, packet, len);
+
+    struct dhcp_option_index_t idx;
+    int result = dhcp_options_parse((const struct dhcp_packet *)buf, (ssize_t)len, &idx);
+
+    struct reference_t ref;
+    reference_parse(buf, len, &ref);
+    assert(result == ref.result);
+    if (result == 0)
+        (*parsed)++;
+
+    for (int code = 0; code < 256; code++)
+    {
+        assert(dhcp_options_has(&idx, (uint8_t)code) == (ref.offset[code] != 0));
+        if (!ref.offset[code])
+            continue;
+        assert(idx.offset[code] == ref.offset[code]);
+        assert(idx.len[code] == ref.len[code]);
+
+        // Data lies inside the bytes received and inside a single area
+        size_t start = idx.offset[code], end = start + idx.len[code];
+        assert(end <= len);
+        assert((start >= OPTIONS_AT && end <= sizeof(struct dhcp_packet)) ||
+               (start >= FILE_AT && end <= FILE_AT + 128) || (start >= SNAME_AT && end <= SNAME_AT + 64));
+
+        uint8_t opt_len = 0;
+        const uint8_t *data = dhcp_options_get((const struct dhcp_packet *)buf, &idx, (uint8_t)code, &opt_len);
+        assert(data == buf + start && opt_len == idx.len[code]);
+        volatile uint8_t sink = opt_len ? data[opt_len - 1] : 0; // Touch the last byte under ASan
+        (void)sink;
+    }
+    free(buf);
+}
+
+static void mutate(struct dhcp_packet *packet, size_t *len)
+{
+    uint8_t *bytes = (uint8_t *)packet;
+    int edits = 1 + rnd() % 8;
+    for (int e = 0; e < edits; e++)
+    {
+        // Mostly hit the option areas (sname, file, options)
+        size_t at = SNAME_AT + rnd() % (sizeof(struct dhcp_packet) - SNAME_AT);
+        switch (rnd() % 6)
+        {
+        case 0: // Random byte
+            bytes[at] = (uint8_t)rnd();
+            break;
+        case 1: // Length byte near or past the end of its area
+            bytes[at] = (uint8_t)(200 + rnd() % 56);
+            break;
+        case 2: // Option 52 with a random value at the start of the options
+            bytes[OPTIONS_AT + 4] = DHCP_OPT_OVERLOAD;
+            bytes[OPTIONS_AT + 5] = (uint8_t)(rnd() % 3 ? 1 : rnd() % 4);
+            bytes[OPTIONS_AT + 6] = (uint8_t)(rnd() % 5);
+            break;
+        case 3: // Drop the END marker
+            for (size_t i = OPTIONS_AT + 4; i < *len; i++)
+                if (bytes[i] == DHCP_OPT_END)
+                {
+                    bytes[i] = DHCP_OPT_PAD;
+                    break;
+                }
+            break;
+        case 4: // Random option
+            if (at + 2 < sizeof(struct dhcp_packet))
+            {
+                bytes[at] = (uint8_t)rnd();
+                bytes[at + 1] = (uint8_t)(rnd() % 16);
+            }
+            break;
+        default: // Received length anywhere from nothing to a full packet
+            *len = rnd() % (sizeof(struct dhcp_packet) + 1);
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 0x9E3779B97F4A7C15ull;
+    if (rng_state == 0)
+        rng_state = 1;
+
+    // The samples themselves parse completely
+    uint64_t parsed = 0;
+    for (size_t s = 0; s < DHCP_SAMPLE_COUNT; s++)
+    {
+        struct dhcp_packet packet;
+        size_t len = dhcp_sample_build(&dhcp_sample_packets[s], &packet);
+        struct dhcp_option_index_t idx;
+        assert(dhcp_options_parse(&packet, (ssize_t)len, &idx) == 0);
+        assert(dhcp_options_get_u8(&packet, &idx, DHCP_OPT_MESSAGE_TYPE) != 0);
+        assert(dhcp_options_get(&packet, &idx, DHCP_OPT_PARAM_REQUEST_LIST, NULL) != NULL);
+        check(&packet, len, &parsed);
+        check(&packet, sizeof(packet), &parsed);
+    }
+
+    // Overloaded options are found in file and sname; not without option 52
+    {
+        struct dhcp_packet packet;
+        size_t len = dhcp_sample_build(&dhcp_sample_packets[DHCP_SAMPLE_COUNT - 1], &packet);
+        struct dhcp_option_index_t idx;
+        struct in_addr ip;
+        assert(dhcp_options_parse(&packet, (ssize_t)len, &idx) == 0 && idx.overload == DHCP_OVERLOAD_BOTH);
+        assert(dhcp_options_get_ip(&packet, &idx, DHCP_OPT_REQUESTED_IP, &ip) && ip.s_addr == htonl(0xC0A80164));
+        assert(dhcp_options_get(&packet, &idx, DHCP_OPT_HOST_NAME, NULL) == (const uint8_t *)packet.sname + 2);
+        packet.options[9] = 0; // 52 -> invalid overload value
+        assert(dhcp_options_parse(&packet, (ssize_t)len, &idx) == 0 && idx.overload == 0);
+        assert(!dhcp_options_get(&packet, &idx, DHCP_OPT_REQUESTED_IP, NULL));
+    }
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        struct dhcp_packet packet;
+        const struct dhcp_sample_packet *sample = &dhcp_sample_packets[rnd() % DHCP_SAMPLE_COUNT];
+        size_t len = dhcp_sample_build(sample, &packet);
+        if (rnd() % 2)
+            len = sizeof(packet); // Padded to a full packet, as many clients send
+        mutate(&packet, &len);
+        check(&packet, len, &parsed);
+    }
+
+    printf("fuzz_dhcp_options: %llu packets checked, %llu parsed without error\n",
+           (unsigned long long)(iterations + 2 * DHCP_SAMPLE_COUNT), (unsigned long long)parsed);
+    return 0;
+}
@@ -0,0 +1,428 @@
+/*
+ * Lease database / IP pool concurrency stress test.
+ *
+ * Worker threads share one pool and one lease database and hammer them the
+ * way the packet workers do: DISCOVER (lookup by MAC, allocate, commit),
+ * REQUEST (renew) and RELEASE, for a set of clients shared by all threads so
+ * that the same client and the same address are fought over. A timer thread
+ * expires leases (lease times are a few seconds) and frees their addresses
+ * through the expiry callback, as the server's lease timer does.
+ *
+ * After the run the pool and the database must agree: every ACTIVE lease
+ * sits on an entry ALLOCATED to the same MAC and every ALLOCATED entry has
+ * that lease; counters, free bitmap and MAC stripe indexes must match the
+ * entry states. A first phase has all threads claim bits of one bitmap
+ * without a lock; each bit must be claimed exactly once.
+ *
+ * Last, a pool that missed the database's bindings (the other generation
+ * during a configuration reload) must not commit over another client's
+ * ACTIVE lease.
+ *
+ * Build: make stress_lease_concurrency (with -fsanitize=thread)
+ * Run:   ./build/bin/stress_lease_concurrency [threads] [ops per thread]
+ */
+#include <arpa/inet.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/ip_pool.h"
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_OPS 50000
+#define CLIENTS 1536          // More clients than addresses: the pool runs dry
+#define BITMAP_BITS (1u << 18)
+#define EXPIRE_AHEAD 5        // The timer expires leases up to 5 s early
+
+struct stats_t
+{
+    uint64_t offers;
+    uint64_t acks;
+    uint64_t naks;
+    uint64_t releases;
+    uint64_t exhausted;
+};
+
+struct worker_t
+{
+    pthread_t thread;
+    uint32_t id;
+    uint64_t rng;
+    struct stats_t stats;
+};
+
+static struct dhcp_config_t *config;
+static struct ip_pool_t pool;
+static struct lease_database_t *db;
+static uint32_t ops_per_thread = DEFAULT_OPS;
+static volatile int timer_stop;
+static struct ip_bitmap_t bitmap;
+static uint8_t *claimed;
+
+static uint32_t next_random(struct worker_t *w)
+{
+    // xorshift64*
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return (uint32_t)((w->rng * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void mac_for(uint32_t client, uint8_t mac[6])
+{
+    mac[0] = 0x02;
+    mac[1] = 0x00;
+    mac[2] = (uint8_t)(client >> 24);
+    mac[3] = (uint8_t)(client >> 16);
+    mac[4] = (uint8_t)(client >> 8);
+    mac[5] = (uint8_t)client;
+}
+
+//=============================================================================
+// Phase 1: lock-free bitmap claims
+//=============================================================================
+
+static void *bitmap_worker(void *arg)
+{
+    struct worker_t *w = (struct worker_t *)arg;
+    for (;;)
+    {
+        uint32_t bit = ip_bitmap_claim_first(&bitmap);
+        if (bit == IP_BITMAP_NONE)
+            break;
+        assert(__atomic_fetch_add(&claimed[bit], 1, __ATOMIC_RELAXED) == 0);
+        w->stats.offers++;
+
+        // Give some back now and then so words empty and fill while others search
+        if (next_random(w) % 4 == 0)
+        {
+            __atomic_fetch_sub(&claimed[bit], 1, __ATOMIC_RELAXED);
+            ip_bitmap_set(&bitmap, bit);
+            w->stats.offers--;
+        }
+    }
+    return NULL;
+}
+
+static void run_bitmap_phase(struct worker_t *workers, uint32_t threads)
+{
+    assert(ip_bitmap_init(&bitmap, BITMAP_BITS) == 0);
+    claimed = calloc(BITMAP_BITS, 1);
+    assert(claimed);
+    for (uint32_t i = 0; i < BITMAP_BITS; i++)
+        ip_bitmap_set(&bitmap, i);
+
+    for (uint32_t t = 0; t < threads; t++)
+        assert(pthread_create(&workers[t].thread, NULL, bitmap_worker, &workers[t]) == 0);
+    uint64_t total = 0;
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t].thread, NULL);
+        total += workers[t].stats.offers;
+        workers[t].stats.offers = 0;
+    }
+
+    assert(total == BITMAP_BITS);
+    assert(bitmap.set_count == 0 && ip_bitmap_find_first(&bitmap) == IP_BITMAP_NONE);
+    for (uint32_t i = 0; i < BITMAP_BITS; i++)
+        assert(claimed[i] == 1);
+    printf("bitmap: %u bits claimed exactly once by %u threads\n", BITMAP_BITS, threads);
+
+    free(claimed);
+    ip_bitmap_free(&bitmap);
+}
+
+//=============================================================================
+// Phase 2: DISCOVER / REQUEST / RELEASE against one pool and database
+//=============================================================================
+
+static void on_expire(void *arg, struct dhcp_lease_t *lease)
+{
+    ip_pool_expire_lease((struct ip_pool_t *)arg, lease);
+}
+
+static void *timer_worker(void *arg)
+{
+    (void)arg;
+    struct timespec pause = {0, 2 * 1000 * 1000};
+    while (!__atomic_load_n(&timer_stop, __ATOMIC_ACQUIRE))
+    {
+        lease_db_expire_due_safe(db, time(NULL) + EXPIRE_AHEAD, on_expire, &pool);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static void check_lease(const struct dhcp_lease_t *lease, const uint8_t mac[6])
+{
+    assert(memcmp(lease->mac_address, mac, 6) == 0);
+    assert(lease->state == LEASE_STATE_ACTIVE);
+    assert(ip_pool_is_in_range(&pool, lease->ip_address));
+}
+
+static void discover(struct worker_t *w, const uint8_t mac[6])
+{
+    // As process_packet(): re-offer an ACTIVE lease, else allocate and commit
+    struct dhcp_lease_t lease;
+    bool found = lease_db_find_by_mac_safe(db, mac, &lease) == 0;
+    if (found && lease.state == LEASE_STATE_ACTIVE)
+    {
+        w->stats.offers++;
+        return;
+    }
+
+    struct in_addr req_ip = {0};
+    if (found)
+        req_ip = lease.ip_address;
+    struct ip_allocation_result_t r = ip_pool_allocate(&pool, mac, NULL, 0, req_ip, config);
+    if (!r.success)
+    {
+        w->stats.exhausted++;
+        return;
+    }
+
+    uint32_t lease_time = 1 + next_random(w) % 10;
+    if (ip_pool_commit_lease(&pool, db, mac, NULL, 0, r.ip_address, lease_time, &lease) == 0)
+    {
+        check_lease(&lease, mac);
+        assert(lease.ip_address.s_addr == r.ip_address.s_addr);
+        w->stats.offers++;
+    }
+}
+
+static void request(struct worker_t *w, const uint8_t mac[6])
+{
+    struct dhcp_lease_t lease;
+    if (lease_db_find_by_mac_safe(db, mac, &lease) != 0)
+        return;
+
+    struct in_addr ip = lease.ip_address;
+    if (ip_pool_renew_lease(&pool, db, ip, mac, NULL, 0, 1 + next_random(w) % 10, &lease) == 0)
+    {
+        check_lease(&lease, mac);
+        assert(lease.ip_address.s_addr == ip.s_addr);
+        w->stats.acks++;
+    }
+    else
+    {
+        w->stats.naks++;
+    }
+}
+
+static void release(struct worker_t *w, const uint8_t mac[6])
+{
+    struct dhcp_lease_t lease;
+    if (lease_db_find_by_mac_safe(db, mac, &lease) != 0)
+        return;
+
+    if (ip_pool_release_lease(&pool, db, lease.ip_address, mac, &lease) == 0)
+    {
+        assert(memcmp(lease.mac_address, mac, 6) == 0 && lease.state == LEASE_STATE_RELEASED);
+        w->stats.releases++;
+    }
+}
+
+static void *packet_worker(void *arg)
+{
+    struct worker_t *w = (struct worker_t *)arg;
+    for (uint32_t i = 0; i < ops_per_thread; i++)
+    {
+        uint8_t mac[6];
+        mac_for(next_random(w) % CLIENTS, mac);
+
+        uint32_t action = next_random(w) % 8;
+        if (action < 4)
+            discover(w, mac);
+        else if (action < 7)
+            request(w, mac);
+        else
+            release(w, mac);
+    }
+    return NULL;
+}
+
+// Entry i is in the MAC index of the stripe of its MAC (same hash as ip_pool.c)
+static bool stripe_indexes(uint32_t i)
+{
+    const uint8_t *mac = pool.entries[i].mac_address;
+    uint64_t key = ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) | ((uint64_t)mac[2] << 24) |
+                   ((uint64_t)mac[3] << 16) | ((uint64_t)mac[4] << 8) | (uint64_t)mac[5];
+    uint32_t hash = lease_index_hash_u64(key);
+    struct lease_index_t *index = &pool.stripes[hash >> (32 - IP_POOL_STRIPE_BITS)].mac_index;
+
+    struct lease_index_iter_t it;
+    uint32_t ref;
+    lease_index_find(index, hash, &it);
+    while (lease_index_next(index, &it, &ref))
+    {
+        if (ref == i)
+            return true;
+    }
+    return false;
+}
+
+// Pool and database must describe the same bindings
+static void check_consistency(void)
+{
+    uint32_t active = 0;
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS; s++)
+    {
+        for (uint32_t i = 0; i < db->shards[s].lease_count; i++)
+        {
+            const struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
+            assert(lease_db_shard_of(lease->ip_address) == s);
+            if (lease->state != LEASE_STATE_ACTIVE)
+                continue;
+            active++;
+
+            const struct ip_pool_entry_t *entry = ip_pool_find_entry(&pool, lease->ip_address);
+            assert(entry && entry->state == IP_STATE_ALLOCATED);
+            assert(memcmp(entry->mac_address, lease->mac_address, 6) == 0);
+        }
+    }
+
+    uint32_t states[IP_STATE_UNKNOWN + 1] = {0};
+    uint32_t owned = 0, free_bits = 0;
+    for (uint32_t i = 0; i < pool.pool_size; i++)
+    {
+        const struct ip_pool_entry_t *entry = &pool.entries[i];
+        states[entry->state]++;
+        assert(ip_bitmap_test(&pool.free_map, i) == (entry->state == IP_STATE_AVAILABLE));
+        free_bits += ip_bitmap_test(&pool.free_map, i);
+
+        if (entry->state == IP_STATE_ALLOCATED)
+        {
+            struct dhcp_lease_t *lease = lease_db_find_by_ip(db, entry->ip_address);
+            assert(lease && lease->state == LEASE_STATE_ACTIVE);
+            assert(memcmp(lease->mac_address, entry->mac_address, 6) == 0);
+        }
+        if (entry->state == IP_STATE_ALLOCATED || entry->state == IP_STATE_PROBING)
+        {
+            owned++;
+            assert(stripe_indexes(i));
+        }
+    }
+    assert(states[IP_STATE_ALLOCATED] == active);
+    assert(states[IP_STATE_AVAILABLE] == pool.available_count && pool.free_map.set_count == free_bits);
+    assert(free_bits == pool.available_count);
+    assert(states[IP_STATE_ALLOCATED] == pool.allocated_count);
+
+    uint32_t indexed = 0;
+    for (uint32_t i = 0; i < IP_POOL_STRIPES; i++)
+        indexed += pool.stripes[i].mac_index.live;
+    assert(indexed == owned);
+
+    printf("consistent: %u active leases on %u allocated entries, %u available, %u leases stored\n", active,
+           pool.allocated_count, pool.available_count, lease_db_count(db));
+}
+
+// A pool built before a lease was committed (the old and the new generation
+// during a reload) hands its address to someone else: the commit must fail
+static void check_stale_pool(struct dhcp_subnet_t *subnet)
+{
+    struct dhcp_lease_t *taken = NULL;
+    time_t now = time(NULL);
+    for (uint32_t s = 0; s < LEASE_DB_SHARDS && !taken; s++)
+    {
+        for (uint32_t i = 0; i < db->shards[s].lease_count && !taken; i++)
+        {
+            struct dhcp_lease_t *lease = lease_shard_get(&db->shards[s], i);
+            if (lease->state == LEASE_STATE_ACTIVE && lease->end_time >= now)
+                taken = lease;
+        }
+    }
+    assert(taken);
+    struct in_addr ip = taken->ip_address;
+    uint8_t owner[6];
+    memcpy(owner, taken->mac_address, 6);
+
+    struct ip_pool_t stale;
+    assert(ip_pool_init(&stale, subnet, NULL) == 0);
+    uint8_t mac[6];
+    mac_for(CLIENTS, mac); // Not one of the workers' clients
+    struct ip_allocation_result_t r = ip_pool_allocate(&stale, mac, NULL, 0, ip, config);
+    assert(r.success && r.ip_address.s_addr == ip.s_addr);
+
+    assert(ip_pool_commit_lease(&stale, db, mac, NULL, 0, ip, 3600, NULL) != 0);
+    struct dhcp_lease_t *lease = lease_db_find_by_ip(db, ip);
+    assert(lease && lease->state == LEASE_STATE_ACTIVE && memcmp(lease->mac_address, owner, 6) == 0);
+    assert(ip_pool_find_entry(&stale, ip)->state == IP_STATE_AVAILABLE);
+    ip_pool_free(&stale);
+
+    printf("stale pool: commit over another client's ACTIVE lease refused\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t threads = argc > 1 ? (uint32_t)atoi(argv[1]) : DEFAULT_THREADS;
+    if (argc > 2)
+        ops_per_thread = (uint32_t)atoi(argv[2]);
+    if (threads == 0)
+        threads = 1;
+
+    struct worker_t *workers = calloc(threads, sizeof(struct worker_t));
+    assert(workers);
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        workers[t].id = t;
+        workers[t].rng = 0x9E3779B97F4A7C15ULL * (t + 1);
+    }
+
+    run_bitmap_phase(workers, threads);
+
+    // 10.0.0.0/22: 1021 addresses for CLIENTS clients
+    config = calloc(1, sizeof(struct dhcp_config_t));
+    assert(config);
+    struct dhcp_subnet_t *subnet = &config->subnets[0];
+    subnet->network.s_addr = htonl(0x0A000000u);
+    subnet->netmask.s_addr = htonl(0xFFFFFC00u);
+    subnet->router.s_addr = htonl(0x0A000001u);
+    subnet->range_start.s_addr = htonl(0x0A000001u);
+    subnet->range_end.s_addr = htonl(0x0A0003FEu);
+    config->subnet_count = 1;
+
+    db = malloc(sizeof(struct lease_database_t));
+    assert(db && lease_db_init(db, "/dev/null") == 0);
+    assert(ip_pool_init(&pool, subnet, db) == 0);
+
+    pthread_t timer;
+    assert(pthread_create(&timer, NULL, timer_worker, NULL) == 0);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t t = 0; t < threads; t++)
+        assert(pthread_create(&workers[t].thread, NULL, packet_worker, &workers[t]) == 0);
+
+    struct stats_t total = {0};
+    for (uint32_t t = 0; t < threads; t++)
+    {
+        pthread_join(workers[t].thread, NULL);
+        total.offers += workers[t].stats.offers;
+        total.acks += workers[t].stats.acks;
+        total.naks += workers[t].stats.naks;
+        total.releases += workers[t].stats.releases;
+        total.exhausted += workers[t].stats.exhausted;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    __atomic_store_n(&timer_stop, 1, __ATOMIC_RELEASE);
+    pthread_join(timer, NULL);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%u threads x %u ops in %.2f s (%.0f ops/s): %lu offers, %lu acks, %lu naks, %lu releases, "
+           "%lu pool exhausted\n",
+           threads, ops_per_thread, secs, threads * (double)ops_per_thread / secs, total.offers, total.acks,
+           total.naks, total.releases, total.exhausted);
+
+    check_consistency();
+    check_stale_pool(subnet);
+
+    ip_pool_free(&pool);
+    lease_db_free(db);
+    free(db);
+    free(config);
+    free(workers);
+    return 0;
+}